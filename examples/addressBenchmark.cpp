@@ -0,0 +1,226 @@
+// This program validates ProtoCompactAddress against ProtoAddress
+// (conversion, comparison and prefix operations) and compares their
+// memory footprint and comparison/lookup performance, including the
+// address-keyed tables (ProtoAddressList, ProtoRouteTable) that now
+// store compact addresses
+
+#include "protoAddress.h"
+#include "protoRouteTable.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi()
+
+static void MakeAddress(unsigned int index, bool ipv6, ProtoAddress& addr)
+{
+    char addrString[64];
+    if (ipv6)
+        sprintf(addrString, "2001:db8:%x:%x::%x", (index >> 16) & 0xffff, (index >> 8) & 0xff, index & 0xff);
+    else
+        sprintf(addrString, "10.%u.%u.%u", (index >> 16) & 0xff, (index >> 8) & 0xff, index & 0xff);
+    addr.ResolveFromString(addrString);
+    addr.SetPort((UINT16)(5000 + (index & 0xff)));
+}  // end MakeAddress()
+
+static bool Validate(const ProtoAddress* addrList, unsigned int count)
+{
+    ProtoAddress ethAddr;
+    ethAddr.ResolveEthFromString("02:00:00:aa:bb:cc");
+    ProtoCompactAddress ethCompact(ethAddr);
+    if (!ethCompact.GetAddress().HostIsEqual(ethAddr) || (6 != ethCompact.GetLength()))
+    {
+        fprintf(stderr, "addressBenchmark: ETH conversion mismatch\n");
+        return false;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const ProtoAddress& a = addrList[i];
+        const ProtoAddress& b = addrList[(i * 7 + 3) % count];
+        ProtoCompactAddress ca(a);
+        ProtoCompactAddress cb(b);
+        // Round trip
+        if (!ca.GetAddress().IsEqual(a) || (ca.GetType() != a.GetType()) ||
+            (ca.GetLength() != a.GetLength()) || (ca.GetPort() != a.GetPort()))
+        {
+            fprintf(stderr, "addressBenchmark: conversion mismatch for %s\n", a.GetHostString());
+            return false;
+        }
+        // Comparison and prefix operations
+        if ((ca.HostIsEqual(cb) != a.HostIsEqual(b)) || (ca.IsEqual(cb) != a.IsEqual(b)))
+        {
+            fprintf(stderr, "addressBenchmark: comparison mismatch\n");
+            return false;
+        }
+        if ((a.GetType() == b.GetType()) &&
+            ((ca.CompareHostAddr(cb) < 0) != (a.CompareHostAddr(b) < 0)))
+        {
+            fprintf(stderr, "addressBenchmark: ordering mismatch\n");
+            return false;
+        }
+        for (UINT8 prefixLen = 0; prefixLen <= (a.GetLength() << 3); prefixLen += 5)
+        {
+            if (ca.PrefixIsEqual(cb, prefixLen) != a.PrefixIsEqual(b, prefixLen))
+            {
+                fprintf(stderr, "addressBenchmark: prefix mismatch\n");
+                return false;
+            }
+            ProtoAddress masked = a;
+            masked.ApplyPrefixMask(prefixLen);
+            ProtoCompactAddress cmasked = ca;
+            cmasked.ApplyPrefixMask(prefixLen);
+            if (!cmasked.HostIsEqual(ProtoCompactAddress(masked)))
+            {
+                fprintf(stderr, "addressBenchmark: prefix mask mismatch\n");
+                return false;
+            }
+        }
+    }
+    return true;
+}  // end Validate()
+
+// Simple open-addressing hash set of compact addresses
+class CompactHashSet
+{
+    public:
+        CompactHashSet(unsigned int count)
+         : mask(1), table(NULL)
+        {
+            while (mask < (2 * count)) mask <<= 1;
+            table = new ProtoCompactAddress[mask];
+            mask -= 1;
+        }
+        ~CompactHashSet()
+            {delete[] table;}
+        void Insert(const ProtoCompactAddress& addr)
+        {
+            unsigned int index = addr.GetHash() & mask;
+            while (table[index].IsValid()) index = (index + 1) & mask;
+            table[index] = addr;
+        }
+        bool Contains(const ProtoCompactAddress& addr) const
+        {
+            unsigned int index = addr.GetHash() & mask;
+            while (table[index].IsValid())
+            {
+                if (table[index].HostIsEqual(addr)) return true;
+                index = (index + 1) & mask;
+            }
+            return false;
+        }
+    private:
+        unsigned int            mask;
+        ProtoCompactAddress*    table;
+};  // end class CompactHashSet
+
+int main(int argc, char* argv[])
+{
+    unsigned int count = (argc > 1) ? atoi(argv[1]) : 100000;
+    unsigned int rounds = 10;
+    if (count < 16) count = 16;
+    ProtoAddress* addrList = new ProtoAddress[count];
+    ProtoCompactAddress* compactList = new ProtoCompactAddress[count];
+    for (unsigned int i = 0; i < count; i++)
+    {
+        MakeAddress(i, (0 != (i & 0x01)), addrList[i]);
+        compactList[i] = addrList[i];
+    }
+
+    // 1) Validate compact address operations against ProtoAddress
+    if (!Validate(addrList, count))
+    {
+        fprintf(stderr, "addressBenchmark: validation FAILED\n");
+        return -1;
+    }
+    printf("validation passed (%u addresses)\n", count);
+
+    // 2) Memory footprint
+    printf("sizeof: ProtoAddress %u  ProtoCompactAddress %u\n",
+           (unsigned int)sizeof(ProtoAddress), (unsigned int)sizeof(ProtoCompactAddress));
+    printf("sizeof: ProtoAddressList::Item %u (was %u)  ProtoRouteTable::Entry %u (was %u)\n",
+           (unsigned int)sizeof(ProtoAddressList::Item),
+           (unsigned int)(sizeof(ProtoAddressList::Item) - sizeof(ProtoCompactAddress) + sizeof(ProtoAddress)),
+           (unsigned int)sizeof(ProtoRouteTable::Entry),
+           (unsigned int)(sizeof(ProtoRouteTable::Entry) + 2*(sizeof(ProtoAddress) - sizeof(ProtoCompactAddress))));
+
+    // 3) Comparison throughput
+    ProtoTime startTime, endTime;
+    unsigned long matches = 0;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        for (unsigned int i = 0; i < count; i++)
+            if (addrList[i].HostIsEqual(addrList[(i + r) % count])) matches++;
+    endTime.GetCurrentTime();
+    double addrCompareTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        for (unsigned int i = 0; i < count; i++)
+            if (compactList[i].HostIsEqual(compactList[(i + r) % count])) matches++;
+    endTime.GetCurrentTime();
+    double compactCompareTime = ProtoTime::Delta(endTime, startTime);
+    printf("compare: ProtoAddress %.1lf M/sec  ProtoCompactAddress %.1lf M/sec\n",
+           1.0e-06 * rounds * count / addrCompareTime, 1.0e-06 * rounds * count / compactCompareTime);
+
+    // 4) Lookup throughput (ProtoAddressList tree vs. compact address hash)
+    ProtoAddressList addrTable;
+    CompactHashSet hashTable(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        addrTable.Insert(addrList[i]);
+        hashTable.Insert(compactList[i]);
+    }
+    ProtoAddress missAddr;
+    missAddr.ResolveFromString("192.168.1.1");
+    ProtoCompactAddress missCompact(missAddr);
+    if (addrTable.Contains(missAddr) || hashTable.Contains(missCompact))
+    {
+        fprintf(stderr, "addressBenchmark: lookup validation FAILED\n");
+        return -1;
+    }
+    unsigned long found = 0;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        for (unsigned int i = 0; i < count; i++)
+            if (addrTable.Contains(addrList[i])) found++;
+    endTime.GetCurrentTime();
+    double treeLookupTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        for (unsigned int i = 0; i < count; i++)
+            if (hashTable.Contains(compactList[i])) found++;
+    endTime.GetCurrentTime();
+    double hashLookupTime = ProtoTime::Delta(endTime, startTime);
+    printf("lookup: ProtoAddressList %.2lf M/sec  compact hash %.2lf M/sec\n",
+           1.0e-06 * rounds * count / treeLookupTime, 1.0e-06 * rounds * count / hashLookupTime);
+
+    // 5) Route table longest-prefix match
+    ProtoRouteTable routeTable;
+    ProtoAddress gwAddr;
+    gwAddr.ResolveFromString("10.0.0.1");
+    unsigned int routeCount = count / 256 + 1;
+    for (unsigned int i = 0; i < routeCount; i++)
+    {
+        ProtoAddress dst;
+        MakeAddress(i << 8, false, dst);
+        routeTable.SetRoute(dst, 24, gwAddr, 1, 1);
+    }
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+    {
+        for (unsigned int i = 0; i < count; i += 2)
+        {
+            ProtoAddress gw;
+            unsigned int ifIndex;
+            int metric;
+            if (routeTable.FindRoute(addrList[i], 32, gw, ifIndex, metric)) found++;
+        }
+    }
+    endTime.GetCurrentTime();
+    double routeTime = ProtoTime::Delta(endTime, startTime);
+    printf("route: %u prefixes, FindRoute() %.2lf M/sec\n",
+           routeCount, 1.0e-06 * rounds * (count / 2) / routeTime);
+    printf("(matches: %lu found: %lu)\n", matches, found);
+    routeTable.Destroy();
+    addrTable.Destroy();
+    delete[] compactList;
+    delete[] addrList;
+    return 0;
+}  // end main()
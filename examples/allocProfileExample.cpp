@@ -0,0 +1,92 @@
+// This program illustrates the ProtoAllocProfile sampling allocation profiler
+// with a ProtoTree workload (tree items and their payload buffers allocated
+// and deleted at different call sites).  It measures the cost per allocation
+// with sampling stopped, at the default interval and with every allocation
+// sampled (about what ProtoCheck costs), then writes the report sorted by
+// allocated bytes and by live bytes, and writes it again in response to a
+// signal.  Build the library with USE_PROTO_ALLOC_PROFILE (e.g. cmake
+// -DPROTOKIT_ALLOC_PROFILE=ON) to enable the profiler.
+
+// Usage: allocProfileExample [<iterations>]
+
+#include "protoAllocProfile.h"
+#include "protoTree.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi()
+#include <signal.h>     // for raise()
+
+class Flow : public ProtoTree::Item
+{
+    public:
+        Flow(UINT32 flowId, unsigned int payloadSize)
+         : flow_id(flowId), payload(new char[payloadSize]) {}
+        ~Flow()
+            {delete[] payload;}
+
+        const char* GetKey() const
+            {return (const char*)&flow_id;}
+        unsigned int GetKeysize() const
+            {return (sizeof(UINT32) << 3);}
+
+    private:
+        UINT32  flow_id;
+        char*   payload;
+};  // end class Flow
+
+// Each iteration replaces a pseudo-random flow (so the tree holds about
+// "FLOW_COUNT" live items) and returns the nsec per new/delete pair
+static double RunWorkload(ProtoTree& tree, unsigned int iterations)
+{
+    const unsigned int FLOW_COUNT = 4096;
+    unsigned int state = 12345;
+    ProtoTime t0, t1;
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        state = state * 1103515245 + 12345;
+        UINT32 flowId = (state >> 8) % FLOW_COUNT;
+        Flow* flow = static_cast<Flow*>(tree.Find((const char*)&flowId, sizeof(UINT32) << 3));
+        if (NULL != flow)
+        {
+            tree.Remove(*flow);
+            delete flow;
+        }
+        // (mostly small payloads with the occasional large one)
+        unsigned int payloadSize = (0 == (state & 0x3f)) ? 9000 : (64 + (state & 0x1ff));
+        tree.Insert(*new Flow(flowId, payloadSize));
+    }
+    t1.GetCurrentTime();
+    return (1.0e+09 * ProtoTime::Delta(t1, t0) / (2.0 * iterations));
+}  // end RunWorkload()
+
+int main(int argc, char* argv[])
+{
+    unsigned int iterations = (argc > 1) ? atoi(argv[1]) : 2000000;
+    if (0 == iterations) iterations = 1;
+    if (!ProtoAllocProfile::IsEnabled())
+        printf("allocProfileExample: profiler not enabled (build with USE_PROTO_ALLOC_PROFILE)\n");
+
+    ProtoTree tree;
+    unsigned long defaultInterval = ProtoAllocProfile::GetSampleInterval();
+    ProtoAllocProfile::SetSampleInterval(0);
+    RunWorkload(tree, iterations / 4);  // (warm up)
+    printf("sampling stopped:       %6.1f nsec per allocation\n", RunWorkload(tree, iterations));
+    ProtoAllocProfile::SetSampleInterval(1);
+    printf("every allocation:       %6.1f nsec per allocation\n", RunWorkload(tree, iterations / 10));
+    ProtoAllocProfile::SetSampleInterval(defaultInterval);
+    ProtoAllocProfile::Reset();
+    printf("interval %7lu bytes: %6.1f nsec per allocation\n", defaultInterval, RunWorkload(tree, iterations));
+
+    ProtoAllocProfile::Report(stdout, 5, ProtoAllocProfile::SORT_ALLOC_BYTES);
+    ProtoAllocProfile::Report(stdout, 3, ProtoAllocProfile::SORT_LIVE_BYTES);
+
+    // The report is written to stderr by the profiler's thread
+    if (ProtoAllocProfile::EnableSignalReport(SIGUSR2))
+    {
+        raise(SIGUSR2);
+        ProtoAllocProfile::DisableSignalReport();  // (after the pending report is written)
+    }
+    tree.Destroy();
+    return 0;
+}  // end main()
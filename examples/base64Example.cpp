@@ -1,40 +1,185 @@
 #include "protoBase64.h"
+#include "protoTime.h"
 
 #include <stdio.h> // for printf() ...
-#include <string.h>  // for strlen() 
+#include <stdlib.h>  // for atoi()
+#include <string.h>  // for strlen(), memcmp()
+
+// This example encodes and decodes a short text string, then checks that each
+// available codec (and the streaming Encoder/Decoder) produces the same results
+// as the byte-at-a-time codec for random data, and reports the throughput of each.
+
+// Usage: base64Example [<benchmarkMBytes>]
+
+static const char* CODEC_NAME[] = {"auto", "byte", "swar", "ssse3", "avx2"};
+
+static void FillRandom(char* buffer, unsigned int numBytes)
+{
+    unsigned int state = 12345;
+    for (unsigned int i = 0; i < numBytes; i++)
+    {
+        state = state * 1103515245 + 12345;
+        buffer[i] = (char)(state >> 16);
+    }
+}  // end FillRandom()
+
+// Compares encoding/decoding with the given codec to the reference (byte) codec
+static bool CheckCodec(ProtoBase64::Codec codec, const char* data, unsigned int maxSize)
+{
+    const unsigned int lineLengths[] = {0, 64, 76, 10, 1};
+    const ProtoBase64::Alphabet alphabets[] = {ProtoBase64::STANDARD, ProtoBase64::URL_SAFE};
+    unsigned int textSize = ProtoBase64::ComputeEncodedSize(maxSize, 1) + 1;
+    char* refText = new char[textSize];
+    char* text = new char[textSize];
+    char* result = new char[maxSize + 1];
+    bool ok = true;
+    for (unsigned int size = 0; ok && (size <= maxSize); size += ((size < 100) ? 1 : 97))
+    {
+        for (unsigned int i = 0; ok && (i < sizeof(lineLengths) / sizeof(unsigned int)); i++)
+        {
+            for (unsigned int a = 0; ok && (a < 2); a++)
+            {
+                for (int pad = 0; ok && (pad < 2); pad++)
+                {
+                    ProtoBase64::SetCodec(ProtoBase64::CODEC_BYTE);
+                    unsigned int refLen = ProtoBase64::Encode(data, size, refText, textSize, lineLengths[i], (0 != pad), alphabets[a]);
+                    ProtoBase64::SetCodec(codec);
+                    unsigned int len = ProtoBase64::Encode(data, size, text, textSize, lineLengths[i], (0 != pad), alphabets[a]);
+                    unsigned int decodeLen = ProtoBase64::Decode(text, len, result, size + 1, alphabets[a]);
+                    if ((len != refLen) || (0 != memcmp(text, refText, len)) ||
+                        (decodeLen != size) || (0 != memcmp(result, data, size)) ||
+                        (decodeLen != ProtoBase64::DetermineDecodedSize(text, len, alphabets[a])))
+                    {
+                        fprintf(stderr, "base64Example: %s codec mismatch (size:%u lineLength:%u alphabet:%u padding:%d)\n",
+                                CODEC_NAME[codec], size, lineLengths[i], a, pad);
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+    // Stream the data in odd-sized chunks
+    for (unsigned int chunk = 1; ok && (chunk < 40); chunk += 7)
+    {
+        ProtoBase64::Encoder encoder(76);
+        ProtoBase64::Decoder decoder;
+        unsigned int len = 0;
+        unsigned int outputBytes;
+        for (unsigned int index = 0; index < maxSize; index += chunk)
+        {
+            unsigned int count = ((maxSize - index) < chunk) ? (maxSize - index) : chunk;
+            encoder.Update(data + index, count, text + len, textSize - len, outputBytes);
+            len += outputBytes;
+        }
+        encoder.Finish(text + len, textSize - len, outputBytes);
+        len += outputBytes;
+        ProtoBase64::SetCodec(ProtoBase64::CODEC_BYTE);
+        unsigned int refLen = ProtoBase64::Encode(data, maxSize, refText, textSize, 76);
+        ProtoBase64::SetCodec(codec);
+        unsigned int decodeLen = 0;
+        for (unsigned int index = 0; index < len; index += chunk)
+        {
+            unsigned int count = ((len - index) < chunk) ? (len - index) : chunk;
+            decoder.Update(text + index, count, result + decodeLen, maxSize + 1 - decodeLen, outputBytes);
+            decodeLen += outputBytes;
+        }
+        if ((len != refLen) || (0 != memcmp(text, refText, len)) ||
+            (decodeLen != maxSize) || (0 != memcmp(result, data, maxSize)) || !decoder.IsComplete())
+        {
+            fprintf(stderr, "base64Example: %s codec streaming mismatch (chunk:%u)\n", CODEC_NAME[codec], chunk);
+            ok = false;
+        }
+    }
+    delete[] result;
+    delete[] text;
+    delete[] refText;
+    return ok;
+}  // end CheckCodec()
 
 int main(int argc, char* argv[])
 {
-    
+
     char text[] = "Hello, ProtoBase64 ...";
-    
+
     unsigned int tlen = strlen(text);
-    
+
     unsigned int maxLineLength = 0;
     bool includePadding = true;
-    
+
     char encodeBuffer[256];
     char decodeBuffer[256];
-    
+
     unsigned int encodeEst = ProtoBase64::ComputeEncodedSize(tlen, maxLineLength, includePadding);
-    
-    
+
+
     printf("base64 encoding text: \"%s\"\n", text);
     unsigned int encodeLen = ProtoBase64::Encode(text, tlen, encodeBuffer, 256, maxLineLength, includePadding);
     encodeBuffer[encodeLen] = '\0';
-    
+
     unsigned int decodeEst = ProtoBase64::EstimateDecodedSize(encodeLen, maxLineLength);
-    
+
     unsigned int decodeSize = ProtoBase64::DetermineDecodedSize(encodeBuffer, encodeLen);
-    
+
     printf("base64 decoding data:  \"%s\"\n", encodeBuffer);
     unsigned int decodeLen = ProtoBase64::Decode(encodeBuffer, encodeLen, decodeBuffer, 256);
     decodeBuffer[decodeLen] = '\0';
-    
+
     printf("base64 encode/decode sizes:: orig:%u encodeEst:%u encodeLen:%u decodeEst:%u decodeSize:%u decodeLen:%u\n",
             tlen, encodeEst, encodeLen, decodeEst, decodeSize, decodeLen);
-    
+
     printf("base64 decoding result: \"%s\"\n", decodeBuffer);
-    
-}  // end main()
 
+    const char binary[] = "\xfb\xff\xbf?>";
+    encodeLen = ProtoBase64::Encode(binary, 5, encodeBuffer, 256, 0, false, ProtoBase64::URL_SAFE);
+    printf("base64 URL-safe encoding (no padding) of \"\\xfb\\xff\\xbf?>\": \"%s\"\n", encodeBuffer);
+
+    // Check each supported codec against the byte-at-a-time codec
+    const unsigned int CHECK_SIZE = 4000;
+    char* data = new char[CHECK_SIZE];
+    FillRandom(data, CHECK_SIZE);
+    ProtoBase64::Codec bestCodec = ProtoBase64::GetCodec();
+    for (int c = ProtoBase64::CODEC_SWAR; c <= ProtoBase64::CODEC_AVX2; c++)
+    {
+        if (!ProtoBase64::SetCodec((ProtoBase64::Codec)c)) continue;  // (not supported)
+        if (!CheckCodec((ProtoBase64::Codec)c, data, CHECK_SIZE))
+        {
+            delete[] data;
+            return 1;
+        }
+        printf("base64 %s codec matches byte codec\n", CODEC_NAME[c]);
+    }
+    delete[] data;
+
+    // Throughput benchmark (1 MByte buffer encoded/decoded repeatedly)
+    unsigned int benchmarkMBytes = (argc > 1) ? atoi(argv[1]) : 256;
+    const unsigned int BENCH_SIZE = 1 << 20;
+    unsigned int textSize = ProtoBase64::ComputeEncodedSize(BENCH_SIZE) + 1;
+    data = new char[BENCH_SIZE];
+    char* benchText = new char[textSize];
+    FillRandom(data, BENCH_SIZE);
+    printf("codec   encode MB/s   decode MB/s   (%u MB)\n", benchmarkMBytes);
+    for (int c = ProtoBase64::CODEC_BYTE; c <= ProtoBase64::CODEC_AVX2; c++)
+    {
+        if (!ProtoBase64::SetCodec((ProtoBase64::Codec)c)) continue;
+        ProtoTime t0, t1, t2;
+        unsigned int len = 0;
+        unsigned int decodeLen = 0;
+        t0.GetCurrentTime();
+        for (unsigned int i = 0; i < benchmarkMBytes; i++)
+            len = ProtoBase64::Encode(data, BENCH_SIZE, benchText, textSize);
+        t1.GetCurrentTime();
+        for (unsigned int i = 0; i < benchmarkMBytes; i++)
+            decodeLen = ProtoBase64::Decode(benchText, len, data, BENCH_SIZE);
+        t2.GetCurrentTime();
+        double encodeTime = ProtoTime::Delta(t1, t0);
+        double decodeTime = ProtoTime::Delta(t2, t1);
+        if (BENCH_SIZE != decodeLen) fprintf(stderr, "base64Example: benchmark decode error\n");
+        printf("%-5s  %10.1f    %10.1f\n", CODEC_NAME[c],
+               (encodeTime > 0.0) ? (benchmarkMBytes / encodeTime) : 0.0,
+               (decodeTime > 0.0) ? (benchmarkMBytes / decodeTime) : 0.0);
+    }
+    ProtoBase64::SetCodec(bestCodec);
+    delete[] benchText;
+    delete[] data;
+    return 0;
+}  // end main()
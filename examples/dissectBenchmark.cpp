@@ -0,0 +1,395 @@
+// This program measures ProtoDissector batch dissection throughput (in
+// packets/sec) for a synthetic mix of Ethernet frames (IPv4 and IPv6, TCP,
+// UDP and ICMP, VLAN tagged, fragmented, padded and truncated) and compares
+// it with parsing the same frames through the ProtoPkt class chain
+// (ProtoPktETH, ProtoPktIP, ProtoPktIPv4/IPv6 and ProtoPktUDP/TCP).  It also
+// validates the descriptors against the expected header values and checks
+// that ProtoFlow::Cache::Key::InitFromDescriptor() builds the same flow keys
+// as ProtoFlow::Cache::Key::InitFromPkt().
+
+// Usage: dissectBenchmark [<numFrames> [<rounds>]]
+
+#include "protoDissector.h"
+#include "protoFlowCache.h"
+#include "protoPktETH.h"
+#include "protoPktTCP.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi()
+#include <string.h>  // for memset()
+
+// Synthetic frames held in one buffer (each IP header is 32-bit aligned)
+class FrameSet
+{
+    public:
+        FrameSet() : buffer(NULL), frame_list(NULL), length_list(NULL), expect_list(NULL), count(0), bytes(0) {}
+        ~FrameSet()
+        {
+            delete[] expect_list;
+            delete[] length_list;
+            delete[] frame_list;
+            delete[] buffer;
+        }
+
+        enum Kind
+        {
+            IPV4_TCP,
+            IPV4_UDP,
+            IPV6_UDP,
+            IPV6_TCP_EXT,   // (with hop-by-hop options header)
+            IPV4_UDP_VLAN,
+            IPV4_ICMP,
+            IPV4_FRAGMENT,  // (non-first fragment)
+            IPV4_TCP_PAD,   // (minimum size frame with link padding)
+            IPV6_TRUNCATED, // (capture shorter than IP length)
+            KIND_MAX
+        };
+        struct Expect
+        {
+            Kind            kind;
+            unsigned int    l3_offset;
+            unsigned int    payload_length;
+            UINT16          src_port;
+            UINT16          dst_port;
+            UINT8           protocol;
+            UINT8           flags;
+        };
+
+        bool Init(unsigned int numFrames);
+        unsigned int GetCount() const
+            {return count;}
+        const void* const* GetFrameList() const
+            {return frame_list;}
+        const unsigned int* GetLengthList() const
+            {return length_list;}
+        const Expect& GetExpect(unsigned int index) const
+            {return expect_list[index];}
+        unsigned long GetBytes() const
+            {return bytes;}
+
+    private:
+        enum {FRAME_MAX = 1600};  // (buffer space per frame)
+        unsigned int BuildFrame(unsigned int n, UINT8* frame, Expect& expect);
+
+        UINT32*         buffer;
+        const void**    frame_list;
+        unsigned int*   length_list;
+        Expect*         expect_list;
+        unsigned int    count;
+        unsigned long   bytes;
+};  // end class FrameSet
+
+static void PutNet16(UINT8* ptr, UINT16 value)
+{
+    ptr[0] = (UINT8)(value >> 8);
+    ptr[1] = (UINT8)(value & 0xff);
+}  // end PutNet16()
+
+bool FrameSet::Init(unsigned int numFrames)
+{
+    if ((NULL == (buffer = new UINT32[(size_t)numFrames * (FRAME_MAX / 4)])) ||
+        (NULL == (frame_list = new const void*[numFrames])) ||
+        (NULL == (length_list = new unsigned int[numFrames])) ||
+        (NULL == (expect_list = new Expect[numFrames])))
+    {
+        perror("dissectBenchmark: new error");
+        return false;
+    }
+    memset(buffer, 0, (size_t)numFrames * FRAME_MAX);
+    for (unsigned int n = 0; n < numFrames; n++)
+    {
+        // (frames start at offset 2 (mod 4) so IP headers are aligned)
+        UINT8* frame = (UINT8*)(buffer + (size_t)n * (FRAME_MAX / 4)) + 2;
+        frame_list[n] = frame;
+        length_list[n] = BuildFrame(n, frame, expect_list[n]);
+        bytes += length_list[n];
+    }
+    count = numFrames;
+    return true;
+}  // end FrameSet::Init()
+
+unsigned int FrameSet::BuildFrame(unsigned int n, UINT8* frame, Expect& expect)
+{
+    Kind kind = (Kind)(n % KIND_MAX);
+    unsigned int payloadLen = (n * 2654435761U) % 1200;
+    memset(&expect, 0, sizeof(Expect));
+    expect.kind = kind;
+    expect.flags = ProtoDissector::Descriptor::FLAG_L3 | ProtoDissector::Descriptor::FLAG_L4;
+    expect.src_port = 1024 + (n % 50000);
+    expect.dst_port = 5000 + (n % 7);
+
+    // Ethernet header
+    for (unsigned int i = 0; i < 12; i++) frame[i] = (UINT8)(n + i);
+    unsigned int offset = 12;
+    if (IPV4_UDP_VLAN == kind)
+    {
+        PutNet16(frame + offset, 0x8100);
+        PutNet16(frame + offset + 2, (UINT16)(n % 4095) + 1);
+        offset += 4;
+        expect.flags |= ProtoDissector::Descriptor::FLAG_VLAN;
+    }
+    bool ipv6 = ((IPV6_UDP == kind) || (IPV6_TCP_EXT == kind) || (IPV6_TRUNCATED == kind));
+    PutNet16(frame + offset, ipv6 ? 0x86dd : 0x0800);
+    offset += 2;
+    expect.l3_offset = offset;
+    UINT8* ip = frame + offset;
+
+    // IP header
+    unsigned int ipHdrLen;
+    UINT8 protocol;
+    switch (kind)
+    {
+        case IPV4_TCP:
+        case IPV4_TCP_PAD:
+        case IPV6_TCP_EXT:
+            protocol = ProtoPktIP::TCP;
+            break;
+        case IPV4_ICMP:
+            protocol = ProtoPktIP::ICMP;
+            break;
+        default:
+            protocol = ProtoPktIP::UDP;
+            break;
+    }
+    expect.protocol = protocol;
+    if (IPV4_TCP_PAD == kind)
+        payloadLen = 0;
+    else if ((IPV6_TRUNCATED == kind) && (payloadLen < 2))
+        payloadLen = 100;
+    unsigned int l4HdrLen = (ProtoPktIP::TCP == protocol) ? ((0 != (n & 0x10)) ? 32 : 20) : 8;
+    if (ipv6)
+    {
+        ipHdrLen = 40;
+        ip[0] = 0x60 | (UINT8)((n & 0xff) >> 4);
+        ip[1] = (UINT8)(n << 4);
+        ip[6] = protocol;
+        ip[7] = 64;
+        for (unsigned int i = 0; i < 16; i++)
+        {
+            ip[8 + i] = (UINT8)(0x20 + i + n);
+            ip[24 + i] = (UINT8)(0x30 + i + (n >> 8));
+        }
+        if (IPV6_TCP_EXT == kind)
+        {
+            ip[6] = ProtoPktIP::HOPOPT;
+            ip[40] = protocol;
+            ip[41] = 0;  // (8 bytes)
+            ip[42] = 1;  // (PadN option)
+            ip[43] = 4;
+            ipHdrLen += 8;
+        }
+        PutNet16(ip + 4, (UINT16)(ipHdrLen - 40 + l4HdrLen + payloadLen));
+    }
+    else
+    {
+        ipHdrLen = (0 != (n & 0x20)) ? 24 : 20;
+        ip[0] = 0x40 | (UINT8)(ipHdrLen >> 2);
+        ip[1] = (UINT8)(n & 0xfc);
+        PutNet16(ip + 2, (UINT16)(ipHdrLen + l4HdrLen + payloadLen));
+        ip[8] = 64;
+        ip[9] = protocol;
+        UINT32 src = 0x0a000000 + n;
+        UINT32 dst = 0xc0a80000 + (n % 65536);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            ip[12 + i] = (UINT8)(src >> (24 - 8*i));
+            ip[16 + i] = (UINT8)(dst >> (24 - 8*i));
+        }
+        if (IPV4_FRAGMENT == kind)
+        {
+            PutNet16(ip + 6, 185);  // (offset 1480 bytes, last fragment)
+            expect.flags = ProtoDissector::Descriptor::FLAG_L3 | ProtoDissector::Descriptor::FLAG_FRAGMENT;
+            expect.src_port = expect.dst_port = 0;
+        }
+    }
+
+    // Transport header
+    UINT8* l4 = ip + ipHdrLen;
+    if (IPV4_FRAGMENT == kind)
+    {
+        l4HdrLen = 0;  // (all payload)
+        payloadLen += 8;
+    }
+    else if (ProtoPktIP::ICMP == protocol)
+    {
+        l4[0] = 8;  // (echo request)
+        l4[1] = 0;
+        expect.src_port = 0;
+        expect.dst_port = 0x0800;
+    }
+    else
+    {
+        PutNet16(l4, expect.src_port);
+        PutNet16(l4 + 2, expect.dst_port);
+        if (ProtoPktIP::TCP == protocol)
+        {
+            l4[12] = (UINT8)((l4HdrLen >> 2) << 4);
+            l4[13] = (UINT8)(n & 0x3f);
+        }
+        else
+        {
+            PutNet16(l4 + 4, (UINT16)(8 + payloadLen));
+        }
+    }
+    for (unsigned int i = 0; i < payloadLen; i++)
+        l4[l4HdrLen + i] = (UINT8)(n + i);
+    expect.payload_length = payloadLen;
+    unsigned int frameLen = (unsigned int)(l4 + l4HdrLen + payloadLen - frame);
+    if ((IPV4_TCP_PAD == kind) && (frameLen < 60))
+    {
+        frameLen = 60;  // (padding is not part of the payload)
+    }
+    else if (IPV6_TRUNCATED == kind)
+    {
+        // (capture snap length cuts off part of the payload)
+        unsigned int cut = payloadLen / 2;
+        frameLen -= cut;
+        expect.payload_length -= cut;
+        expect.flags |= ProtoDissector::Descriptor::FLAG_TRUNCATED;
+    }
+    return frameLen;
+}  // end FrameSet::BuildFrame()
+
+static unsigned int Validate(const FrameSet& frameSet)
+{
+    unsigned int badCount = 0;
+    for (unsigned int i = 0; i < frameSet.GetCount(); i++)
+    {
+        const void* frame = frameSet.GetFrameList()[i];
+        unsigned int length = frameSet.GetLengthList()[i];
+        const FrameSet::Expect& expect = frameSet.GetExpect(i);
+        ProtoDissector::Descriptor desc;
+        bool result = ProtoDissector::Dissect(ProtoDissector::LINK_ETHERNET, frame, length, desc);
+        if (!result || (expect.flags != desc.GetFlags()) || (expect.l3_offset != desc.GetL3Offset()) ||
+            (expect.protocol != desc.GetProtocol()) || (expect.payload_length != desc.GetPayloadLength()) ||
+            (expect.src_port != desc.GetSrcPort()) || (expect.dst_port != desc.GetDstPort()) ||
+            ((desc.GetPayloadOffset() + desc.GetPayloadLength()) > length))
+        {
+            if (badCount++ < 10)
+                fprintf(stderr, "dissectBenchmark: frame %u (kind %d) descriptor mismatch\n", i, expect.kind);
+            continue;
+        }
+        // Compare with ProtoPkt parsing of the IP packet via the flow key
+        ProtoPktIP ipPkt;
+        unsigned int ipLength = length - desc.GetL3Offset();
+        if (ipLength > 0xffff) ipLength = 0xffff;
+        if (!ipPkt.InitFromBuffer(ipLength, (char*)frame + desc.GetL3Offset(), ipLength))
+        {
+            if (badCount++ < 10)
+                fprintf(stderr, "dissectBenchmark: frame %u (kind %d) ProtoPktIP error\n", i, expect.kind);
+            continue;
+        }
+        ProtoFlow::Cache::Key pktKey, descKey;
+        UINT8 tcpFlags = 0;
+        if (!pktKey.InitFromPkt(ipPkt, 1, &tcpFlags) || !descKey.InitFromDescriptor(desc, 1) ||
+            !pktKey.IsEqual(descKey) || (tcpFlags != desc.GetTcpFlags()))
+        {
+            if (badCount++ < 10)
+                fprintf(stderr, "dissectBenchmark: frame %u (kind %d) flow key mismatch\n", i, expect.kind);
+        }
+    }
+    return badCount;
+}  // end Validate()
+
+// The "traditional" parse of each frame through the ProtoPkt class chain
+static unsigned long ParseProtoPkt(const FrameSet& frameSet)
+{
+    unsigned long sum = 0;
+    for (unsigned int i = 0; i < frameSet.GetCount(); i++)
+    {
+        unsigned int length = frameSet.GetLengthList()[i];
+        ProtoPktETH ethPkt((void*)frameSet.GetFrameList()[i], length);
+        if (!ethPkt.InitFromBuffer(length)) continue;
+        ProtoPktIP ipPkt;
+        unsigned int ipLength = ethPkt.GetPayloadLength();
+        if (!ipPkt.InitFromBuffer(ipLength, ethPkt.AccessPayload(), ipLength)) continue;
+        switch (ipPkt.GetVersion())
+        {
+            case 4:
+            {
+                ProtoPktIPv4 ip4Pkt(ipPkt);
+                sum += *(const UINT32*)ip4Pkt.GetSrcAddrPtr() + *(const UINT32*)ip4Pkt.GetDstAddrPtr() + ip4Pkt.GetProtocol();
+                break;
+            }
+            case 6:
+            {
+                ProtoPktIPv6 ip6Pkt(ipPkt);
+                sum += *(const UINT32*)ip6Pkt.GetSrcAddrPtr() + *(const UINT32*)ip6Pkt.GetDstAddrPtr() + ip6Pkt.GetNextHeader();
+                break;
+            }
+            default:
+                continue;
+        }
+        ProtoPktUDP udpPkt;
+        ProtoPktTCP tcpPkt;
+        if (udpPkt.InitFromPacket(ipPkt))
+            sum += udpPkt.GetSrcPort() + udpPkt.GetDstPort() + udpPkt.GetPayloadLength();
+        else if (tcpPkt.InitFromPacket(ipPkt))
+            sum += tcpPkt.GetSrcPort() + tcpPkt.GetDstPort() + tcpPkt.GetPayloadLength();
+    }
+    return sum;
+}  // end ParseProtoPkt()
+
+static unsigned long ParseDissector(const FrameSet& frameSet)
+{
+    enum {BATCH_SIZE = 32};
+    ProtoDissector::Descriptor descList[BATCH_SIZE];
+    unsigned long sum = 0;
+    for (unsigned int i = 0; i < frameSet.GetCount(); i += BATCH_SIZE)
+    {
+        unsigned int count = frameSet.GetCount() - i;
+        if (count > BATCH_SIZE) count = BATCH_SIZE;
+        ProtoDissector::Dissect(ProtoDissector::LINK_ETHERNET, count, frameSet.GetFrameList() + i,
+                                frameSet.GetLengthList() + i, descList);
+        for (unsigned int j = 0; j < count; j++)
+        {
+            const ProtoDissector::Descriptor& desc = descList[j];
+            sum += *desc.GetSrcAddrPtr() + *desc.GetDstAddrPtr() + desc.GetProtocol() +
+                   desc.GetSrcPort() + desc.GetDstPort() + desc.GetPayloadLength();
+        }
+    }
+    return sum;
+}  // end ParseDissector()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numFrames = (argc > 1) ? atoi(argv[1]) : 16384;
+    unsigned int rounds = (argc > 2) ? atoi(argv[2]) : 100;
+    if (numFrames < FrameSet::KIND_MAX) numFrames = FrameSet::KIND_MAX;
+    if (0 == rounds) rounds = 1;
+
+    FrameSet frameSet;
+    if (!frameSet.Init(numFrames)) return -1;
+    printf("%u frames (%.1lf MB), sizeof(ProtoDissector::Descriptor) = %u bytes\n",
+           numFrames, 1.0e-06 * frameSet.GetBytes(), (unsigned int)sizeof(ProtoDissector::Descriptor));
+
+    // 1) Validation
+    unsigned int badCount = Validate(frameSet);
+    if (0 != badCount)
+    {
+        fprintf(stderr, "dissectBenchmark: validation FAILED (%u bad frames)\n", badCount);
+        return -1;
+    }
+    printf("validation passed\n");
+
+    // 2) Throughput
+    ProtoTime startTime, endTime;
+    unsigned long sum = 0;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        sum += ParseProtoPkt(frameSet);
+    endTime.GetCurrentTime();
+    double pktElapsed = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        sum += ParseDissector(frameSet);
+    endTime.GetCurrentTime();
+    double dissectElapsed = ProtoTime::Delta(endTime, startTime);
+    double total = (double)rounds * numFrames;
+    printf("ProtoPkt chain: %.2lf Mpps (%.1lf nsec/packet)\n",
+           1.0e-06 * total / pktElapsed, 1.0e+09 * pktElapsed / total);
+    printf("ProtoDissector: %.2lf Mpps (%.1lf nsec/packet), %.1lfx speedup (checksum %lu)\n",
+           1.0e-06 * total / dissectElapsed, 1.0e+09 * dissectElapsed / total,
+           pktElapsed / dissectElapsed, sum & 0xffff);
+    return 0;
+}  // end main()
@@ -0,0 +1,139 @@
+// This program measures ProtoFile line input throughput for a large log
+// file using buffered Readline(), zero-copy GetNextLine(), GetNextLine()
+// on a memory-mapped file and GetNextLine() with a read-ahead thread.  A
+// log file of "sizeMB" (default 256) megabytes is generated if the given
+// file does not exist (and is removed afterwards).
+
+// Usage: fileBenchmark [<file> [<sizeMB>]]
+
+#include "protoFile.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi()
+
+static bool CreateLogFile(const char* path, unsigned int sizeMB)
+{
+    FILE* filePtr = fopen(path, "w");
+    if (NULL == filePtr)
+    {
+        perror("fileBenchmark: fopen() error");
+        return false;
+    }
+    unsigned long long total = (unsigned long long)sizeMB * 1024 * 1024;
+    unsigned long long written = 0;
+    unsigned long seq = 0;
+    while (written < total)
+    {
+        // Lines of varying length
+        char line[256];
+        int len = sprintf(line, "%010lu 10.0.%lu.%lu proto=%s len=%lu msg=\"%.*s\"\n",
+                          seq, (seq >> 8) & 0xff, seq & 0xff, (0 == (seq % 3)) ? "udp" : "tcp",
+                          (seq * 37) % 1500, (int)(seq % 97),
+                          "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
+        if (1 != fwrite(line, len, 1, filePtr))
+        {
+            perror("fileBenchmark: fwrite() error");
+            fclose(filePtr);
+            return false;
+        }
+        written += len;
+        seq++;
+    }
+    fclose(filePtr);
+    return true;
+}  // end CreateLogFile()
+
+enum Mode {READLINE, NEXT_LINE, MAPPED, READ_AHEAD};
+
+static bool RunTest(const char* path, Mode mode)
+{
+    ProtoFile file;
+    if (!file.Open(path, O_RDONLY))
+    {
+        fprintf(stderr, "fileBenchmark: unable to open file \"%s\"\n", path);
+        return false;
+    }
+    const char* name = "";
+    switch (mode)
+    {
+        case READLINE:
+            name = "Readline()             ";
+            break;
+        case NEXT_LINE:
+            name = "GetNextLine()          ";
+            break;
+        case MAPPED:
+            name = "GetNextLine() mapped   ";
+            if (!file.Map())
+            {
+                fprintf(stderr, "fileBenchmark: Map() error\n");
+                return false;
+            }
+            break;
+        case READ_AHEAD:
+            name = "GetNextLine() readahead";
+            if (!file.StartReadAhead())
+            {
+                fprintf(stderr, "fileBenchmark: StartReadAhead() error\n");
+                return false;
+            }
+            break;
+    }
+    ProtoTime startTime;
+    startTime.GetCurrentTime();
+    unsigned long lineCount = 0;
+    unsigned long long byteCount = 0;
+    unsigned long checksum = 0;  // (so the lines are actually looked at)
+    if (READLINE == mode)
+    {
+        char buffer[1024];
+        while (true)
+        {
+            unsigned int length = 1024;
+            if (!file.Readline(buffer, length)) break;
+            lineCount++;
+            byteCount += length;
+            checksum += (unsigned char)buffer[0];
+        }
+    }
+    else
+    {
+        const char* line;
+        unsigned int length;
+        while (file.GetNextLine(line, length))
+        {
+            lineCount++;
+            byteCount += length;
+            if (0 != length) checksum += (unsigned char)line[0];
+        }
+    }
+    ProtoTime stopTime;
+    stopTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(stopTime, startTime);
+    double size = (double)file.GetSize();
+    file.Close();
+    printf("%s: %lu lines (%llu bytes, checksum %lu) in %.3f sec, %.1f MB/s\n",
+           name, lineCount, byteCount, checksum, elapsed,
+           (elapsed > 0.0) ? (size / (1024.0 * 1024.0) / elapsed) : 0.0);
+    return true;
+}  // end RunTest()
+
+int main(int argc, char* argv[])
+{
+    const char* path = (argc > 1) ? argv[1] : "/tmp/fileBenchmark.log";
+    unsigned int sizeMB = (argc > 2) ? atoi(argv[2]) : 256;
+    bool created = false;
+    if (!ProtoFile::Exists(path))
+    {
+        printf("fileBenchmark: creating %u MB log file \"%s\" ...\n", sizeMB, path);
+        if (!CreateLogFile(path, sizeMB)) return 1;
+        created = true;
+    }
+    // (the first pass also warms up the page cache)
+    bool result = RunTest(path, READLINE) &&
+                  RunTest(path, NEXT_LINE) &&
+                  RunTest(path, MAPPED) &&
+                  RunTest(path, READ_AHEAD);
+    if (created) ProtoFile::Unlink(path);
+    return result ? 0 : 1;
+}  // end main()
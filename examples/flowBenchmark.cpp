@@ -0,0 +1,221 @@
+// This program validates ProtoFlow::Cache packet classification and
+// accounting (the exported flow records must add up to the packets
+// offered) and measures its packet update rate for a synthetic traffic
+// mix of many concurrent UDP and TCP flows with timeouts and evictions
+
+// Usage: flowBenchmark [<numFlows> [<numPackets> [<duration>]]]
+
+#include "protoFlowCache.h"
+#include "protoPktIP.h"
+#include "protoPktTCP.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), atof(), rand()
+#include <string.h>  // for memset(), memcmp()
+
+class FlowCounter
+{
+    public:
+        FlowCounter()
+         : records(0), packets(0), bytes(0), batches(0)
+        {
+            memset(reasons, 0, sizeof(reasons));
+        }
+        void OnExport(ProtoFlow::Cache& /*theCache*/, const ProtoFlow::Cache::Record* recordList, unsigned int recordCount)
+        {
+            for (unsigned int i = 0; i < recordCount; i++)
+            {
+                const ProtoFlow::Cache::Record& record = recordList[i];
+                packets += record.GetPackets();
+                bytes += record.GetBytes();
+                reasons[record.GetExpireReason()]++;
+            }
+            records += recordCount;
+            batches++;
+        }
+        unsigned long   records;
+        unsigned long   packets;
+        unsigned long   bytes;
+        unsigned long   batches;
+        unsigned long   reasons[ProtoFlow::Cache::EXPIRE_FLUSH + 1];
+};  // end class FlowCounter
+
+// Fills in an IPv4 UDP or TCP packet header for flow "flowIndex"
+static unsigned int BuildPacket(UINT8* buffer, unsigned int flowIndex, unsigned int length, UINT8 tcpFlags)
+{
+    bool tcp = (0 == (flowIndex & 0x03));
+    memset(buffer, 0, 40);
+    buffer[0] = 0x45;  // version 4, 20 byte header
+    buffer[2] = (UINT8)(length >> 8);
+    buffer[3] = (UINT8)length;
+    buffer[8] = 64;  // TTL
+    buffer[9] = tcp ? ProtoPktIP::TCP : ProtoPktIP::UDP;
+    buffer[12] = 10;  // src 10.x.y.z
+    buffer[13] = (UINT8)(flowIndex >> 16);
+    buffer[14] = (UINT8)(flowIndex >> 8);
+    buffer[15] = (UINT8)flowIndex;
+    buffer[16] = 192;  // dst 192.168.x.1
+    buffer[17] = 168;
+    buffer[18] = (UINT8)(flowIndex >> 24);
+    buffer[19] = 1;
+    UINT16 srcPort = (UINT16)(1024 + (flowIndex % 50000));
+    buffer[20] = (UINT8)(srcPort >> 8);
+    buffer[21] = (UINT8)srcPort;
+    buffer[22] = tcp ? 0 : 0x13;  // dst port 80 or 5001
+    buffer[23] = tcp ? 80 : 0x89;
+    if (tcp) buffer[33] = tcpFlags;
+    return length;
+}  // end BuildPacket()
+
+static bool ValidateKeys()
+{
+    UINT32 buffer[32];
+    UINT8* ptr = (UINT8*)buffer;
+    ProtoFlow::Cache::Key key;
+    UINT8 tcpFlags;
+    // IPv4 TCP
+    BuildPacket(ptr, 4, 60, ProtoPktTCP::FLAG_SYN);
+    ProtoPktIP ipPkt;
+    ipPkt.InitFromBuffer(60, buffer, sizeof(buffer));
+    if (!key.InitFromPkt(ipPkt, 2, &tcpFlags) || (ProtoPktIP::TCP != key.GetProtocol()) ||
+        (1028 != key.GetSrcPort()) || (80 != key.GetDstPort()) ||
+        (ProtoPktTCP::FLAG_SYN != tcpFlags) || (2 != key.GetInterfaceIndex()))
+    {
+        fprintf(stderr, "flowBenchmark: IPv4 key mismatch\n");
+        return false;
+    }
+    ProtoAddress addr;
+    key.GetSrcAddr(addr);
+    ProtoAddress refAddr;
+    refAddr.ResolveFromString("10.0.0.4");
+    if (!addr.HostIsEqual(refAddr) || (1028 != addr.GetPort()))
+    {
+        fprintf(stderr, "flowBenchmark: IPv4 key address mismatch\n");
+        return false;
+    }
+    ProtoFlow::Description description;
+    key.GetDescription(description);
+    ProtoFlow::Description refDescription;
+    refDescription.InitFromPkt(ipPkt, 2);
+    if ((description.GetKeysize() != refDescription.GetKeysize()) ||
+        (0 != memcmp(description.GetKey(), refDescription.GetKey(), description.GetKeysize() >> 3)))
+    {
+        fprintf(stderr, "flowBenchmark: description mismatch\n");
+        return false;
+    }
+    // IPv6 UDP behind a hop-by-hop options header
+    memset(buffer, 0, sizeof(buffer));
+    ptr[0] = 0x60;
+    ptr[5] = 16;  // payload length
+    ptr[6] = ProtoPktIP::HOPOPT;
+    ptr[8] = ptr[24] = 0x20;
+    ptr[23] = 1;
+    ptr[39] = 2;
+    ptr[40] = ProtoPktIP::UDP;  // (8 byte hop-by-hop header)
+    ptr[48] = 0x13;  // src port 5001
+    ptr[49] = 0x89;
+    ptr[51] = 53;    // dst port 53
+    ProtoPktIP ip6Pkt;
+    ip6Pkt.InitFromBuffer(56, buffer, sizeof(buffer));
+    if (!key.InitFromPkt(ip6Pkt, 0, &tcpFlags) || (ProtoPktIP::UDP != key.GetProtocol()) ||
+        (5001 != key.GetSrcPort()) || (53 != key.GetDstPort()))
+    {
+        fprintf(stderr, "flowBenchmark: IPv6 key mismatch\n");
+        return false;
+    }
+    return true;
+}  // end ValidateKeys()
+
+// Offers "numPackets" packets spread over "duration" seconds to a cache
+// of "cacheSize" flows and checks the exported totals
+static bool RunTest(unsigned int numFlows, unsigned int numPackets, double duration,
+                    unsigned int cacheSize, const char* label)
+{
+    ProtoFlow::Cache cache;
+    FlowCounter counter;
+    if (!cache.Open(cacheSize, 10.0, 30.0, 1.0) ||
+        !cache.SetListener(&counter, &FlowCounter::OnExport))
+    {
+        fprintf(stderr, "flowBenchmark: cache.Open() error\n");
+        return false;
+    }
+    // Precompute a skewed flow sequence (a few heavy flows, many light ones)
+    unsigned int* flowSequence = new unsigned int[numPackets];
+    for (unsigned int i = 0; i < numPackets; i++)
+    {
+        unsigned int r = (unsigned int)rand();
+        flowSequence[i] = (0 == (r & 0x03)) ? ((r >> 2) % 64) : ((r >> 2) % numFlows);
+    }
+    UINT32 buffer[1500/4];
+    ProtoPktIP ipPkt(buffer, sizeof(buffer));
+    ProtoTime pktTime(1000.0);
+    double interval = duration / numPackets;
+    unsigned long totalBytes = 0;
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < numPackets; i++)
+    {
+        unsigned int flowIndex = flowSequence[i];
+        UINT8 tcpFlags = (0 == (i % 1000)) ? ProtoPktTCP::FLAG_FIN : ProtoPktTCP::FLAG_ACK;
+        unsigned int length = BuildPacket((UINT8*)buffer, flowIndex, 40 + (flowIndex % 1400), tcpFlags);
+        ipPkt.SetLength(length);
+        totalBytes += length;
+        pktTime += interval;
+        if (NULL == cache.Update(ipPkt, length, pktTime))
+        {
+            fprintf(stderr, "flowBenchmark: cache.Update() error\n");
+            delete[] flowSequence;
+            return false;
+        }
+    }
+    endTime.GetCurrentTime();
+    double updateTime = ProtoTime::Delta(endTime, startTime);
+    unsigned int activeFlows = cache.GetFlowCount();
+    cache.Flush();
+    delete[] flowSequence;
+    printf("%s: %u flows max, %.2lf Mpps (%.0lf nsec/pkt), %u active at end, %lu exported in %lu batches\n",
+           label, cacheSize, 1.0e-06 * numPackets / updateTime, 1.0e+09 * updateTime / numPackets,
+           activeFlows, counter.records, counter.batches);
+    printf("    expired: idle %lu  active %lu  end %lu  evict %lu  flush %lu\n",
+           counter.reasons[ProtoFlow::Cache::EXPIRE_IDLE], counter.reasons[ProtoFlow::Cache::EXPIRE_ACTIVE],
+           counter.reasons[ProtoFlow::Cache::EXPIRE_END], counter.reasons[ProtoFlow::Cache::EXPIRE_EVICT],
+           counter.reasons[ProtoFlow::Cache::EXPIRE_FLUSH]);
+    if ((counter.packets != numPackets) || (counter.bytes != totalBytes) ||
+        (counter.records != cache.GetExportCount()) || (0 != cache.GetFlowCount()) ||
+        (counter.reasons[ProtoFlow::Cache::EXPIRE_EVICT] != cache.GetEvictCount()))
+    {
+        fprintf(stderr, "flowBenchmark: %s accounting mismatch (packets %lu/%u bytes %lu/%lu)\n",
+                label, counter.packets, numPackets, counter.bytes, totalBytes);
+        return false;
+    }
+    return true;
+}  // end RunTest()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numFlows = (argc > 1) ? atoi(argv[1]) : 1000000;
+    unsigned int numPackets = (argc > 2) ? atoi(argv[2]) : 10000000;
+    double duration = (argc > 3) ? atof(argv[3]) : 60.0;
+    if (numFlows < 64) numFlows = 64;
+    if (numPackets < 1000) numPackets = 1000;
+    if (duration <= 0.0) duration = 60.0;
+    srand(1);
+
+    if (!ValidateKeys())
+    {
+        fprintf(stderr, "flowBenchmark: validation FAILED\n");
+        return -1;
+    }
+    printf("key validation passed\n");
+    printf("%u flows, %u packets over %.1lf sec (idle timeout 10 sec, active timeout 30 sec)\n",
+           numFlows, numPackets, duration);
+    // 1) Cache sized for all flows, 2) undersized cache (evictions)
+    if (!RunTest(numFlows, numPackets, duration, numFlows, "full cache ") ||
+        !RunTest(numFlows, numPackets, duration, numFlows / 8, "small cache"))
+    {
+        fprintf(stderr, "flowBenchmark: accounting FAILED\n");
+        return -1;
+    }
+    printf("accounting passed\n");
+    return 0;
+}  // end main()
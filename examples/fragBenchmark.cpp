@@ -0,0 +1,303 @@
+// This program measures ProtoIPReassembler throughput for synthetic
+// fragmented IPv4 and IPv6 UDP traffic (with fragments reordered and
+// interleaved across datagrams, and some duplicated) and validates the
+// reassembled packets.  It also checks eviction under a small memory cap
+// and timeout expiry of incomplete datagrams.
+
+// Usage: fragBenchmark [<numDatagrams> [<rounds>]]
+
+#include "protoIPReassembler.h"
+#include "protoDispatcher.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), rand()
+#include <string.h>  // for memset()
+
+// Synthetic fragment traffic held in one buffer
+class FragmentSet
+{
+    public:
+        FragmentSet() : buffer(NULL), offset_list(NULL), length_list(NULL), count(0), words(0), bytes(0) {}
+        ~FragmentSet()
+        {
+            delete[] length_list;
+            delete[] offset_list;
+            delete[] buffer;
+        }
+        bool Init(unsigned int numDatagrams, unsigned int window, bool duplicates);
+        unsigned int GetCount() const
+            {return count;}
+        UINT32* GetPacket(unsigned int index) const
+            {return (buffer + offset_list[index]);}
+        unsigned int GetLength(unsigned int index) const
+            {return length_list[index];}
+        unsigned long GetBytes() const
+            {return bytes;}
+
+        static unsigned int GetPayloadLength(unsigned int n)
+            {return (1500 + ((n * 2654435761U) % 8000));}  // (always fragmented)
+        static UINT8 GetPayloadByte(unsigned int n, unsigned int i)
+            {return (UINT8)(n * 7 + i);}
+
+    private:
+        void AddFragment(unsigned int n, unsigned int offset, unsigned int length, bool more);
+
+        UINT32*         buffer;
+        unsigned int*   offset_list;   // in UINT32 words
+        unsigned int*   length_list;
+        unsigned int    count;
+        unsigned int    words;
+        unsigned long   bytes;
+};  // end class FragmentSet
+
+void FragmentSet::AddFragment(unsigned int n, unsigned int offset, unsigned int length, bool more)
+{
+    UINT8* pkt = (UINT8*)(buffer + words);
+    unsigned int hdrLength;
+    if (0 == (n & 0x01))
+    {
+        // IPv4 (datagram "n" is in the source address and ID)
+        hdrLength = 20;
+        unsigned int total = hdrLength + length;
+        memset(pkt, 0, hdrLength);
+        pkt[0] = 0x45;
+        pkt[2] = (UINT8)(total >> 8);
+        pkt[3] = (UINT8)total;
+        pkt[4] = (UINT8)(n >> 8);
+        pkt[5] = (UINT8)n;
+        UINT16 frag = (UINT16)((offset >> 3) | (more ? 0x2000 : 0));
+        pkt[6] = (UINT8)(frag >> 8);
+        pkt[7] = (UINT8)frag;
+        pkt[8] = 64;
+        pkt[9] = ProtoPktIP::UDP;
+        pkt[12] = 10;
+        pkt[13] = (UINT8)(n >> 16);
+        pkt[14] = (UINT8)(n >> 8);
+        pkt[15] = (UINT8)n;
+        pkt[16] = 10;
+        pkt[17] = 255;
+        pkt[19] = 1;
+    }
+    else
+    {
+        // IPv6 with FRAG header
+        hdrLength = 48;
+        memset(pkt, 0, hdrLength);
+        pkt[0] = 0x60;
+        pkt[4] = (UINT8)((8 + length) >> 8);
+        pkt[5] = (UINT8)(8 + length);
+        pkt[6] = ProtoPktIP::FRAG;
+        pkt[7] = 64;
+        pkt[8] = pkt[24] = 0x20;
+        pkt[9] = pkt[25] = 0x01;
+        pkt[21] = (UINT8)(n >> 16);
+        pkt[22] = (UINT8)(n >> 8);
+        pkt[23] = (UINT8)n;
+        pkt[39] = 1;
+        pkt[40] = ProtoPktIP::UDP;
+        UINT16 frag = (UINT16)(offset | (more ? 1 : 0));
+        pkt[42] = (UINT8)(frag >> 8);
+        pkt[43] = (UINT8)frag;
+        pkt[44] = (UINT8)(n >> 24);
+        pkt[45] = (UINT8)(n >> 16);
+        pkt[46] = (UINT8)(n >> 8);
+        pkt[47] = (UINT8)n;
+    }
+    for (unsigned int i = 0; i < length; i++)
+        pkt[hdrLength + i] = GetPayloadByte(n, offset + i);
+    offset_list[count] = words;
+    length_list[count++] = hdrLength + length;
+    words += (hdrLength + length + 3) / 4;
+    bytes += hdrLength + length;
+}  // end FragmentSet::AddFragment()
+
+bool FragmentSet::Init(unsigned int numDatagrams, unsigned int window, bool duplicates)
+{
+    // Count fragments and buffer space needed
+    unsigned int maxFragments = 0;
+    unsigned long maxWords = 0;
+    for (unsigned int n = 0; n < numDatagrams; n++)
+    {
+        unsigned int fragSize = (0 == (n & 0x01)) ? 1480 : 1448;
+        unsigned int numFrags = (GetPayloadLength(n) + fragSize - 1) / fragSize + (duplicates ? 1 : 0);
+        maxFragments += numFrags;
+        maxWords += numFrags * ((48 + fragSize + 3) / 4);
+    }
+    buffer = new UINT32[maxWords];
+    offset_list = new unsigned int[maxFragments];
+    length_list = new unsigned int[maxFragments];
+    count = words = 0;
+    bytes = 0;
+    for (unsigned int n = 0; n < numDatagrams; n++)
+    {
+        unsigned int fragSize = (0 == (n & 0x01)) ? 1480 : 1448;
+        unsigned int length = GetPayloadLength(n);
+        for (unsigned int offset = 0; offset < length; offset += fragSize)
+        {
+            unsigned int fragLength = ((length - offset) > fragSize) ? fragSize : (length - offset);
+            AddFragment(n, offset, fragLength, (offset + fragLength) < length);
+            // Duplicate some IPv4 fragments
+            if (duplicates && (0 == (n & 0x01)) && (0 == (n % 10)) && (0 == offset))
+                AddFragment(n, offset, fragLength, true);
+        }
+    }
+    // Reorder (and interleave) fragments within a sliding window
+    for (unsigned int i = 0; (window > 1) && (i < count); i++)
+    {
+        unsigned int j = i + ((unsigned int)rand() % window);
+        if (j >= count) continue;
+        unsigned int tmp = offset_list[i];
+        offset_list[i] = offset_list[j];
+        offset_list[j] = tmp;
+        tmp = length_list[i];
+        length_list[i] = length_list[j];
+        length_list[j] = tmp;
+    }
+    return true;
+}  // end FragmentSet::Init()
+
+// Checks a reassembled packet against its original content
+static bool CheckPacket(ProtoPktIP& pkt)
+{
+    const UINT8* ptr = (const UINT8*)pkt.GetBuffer();
+    unsigned int n, hdrLength, length;
+    if (4 == pkt.GetVersion())
+    {
+        ProtoPktIPv4 ip4Pkt(pkt);
+        n = ((unsigned int)ptr[13] << 16) | ((unsigned int)ptr[14] << 8) | ptr[15];
+        hdrLength = 20;
+        length = ip4Pkt.GetTotalLength() - hdrLength;
+        UINT16 checksum = ip4Pkt.GetChecksum();
+        if (ip4Pkt.FlagIsSet(ProtoPktIPv4::FLAG_MF) || (0 != ip4Pkt.GetFragmentOffset()) ||
+            (checksum != ip4Pkt.CalculateChecksum(false)))
+            return false;
+    }
+    else
+    {
+        ProtoPktIPv6 ip6Pkt(pkt);
+        n = ((unsigned int)ptr[21] << 16) | ((unsigned int)ptr[22] << 8) | ptr[23];
+        hdrLength = 40;
+        length = ip6Pkt.GetPayloadLength();
+        if (ProtoPktIP::UDP != ip6Pkt.GetNextHeader())
+            return false;
+    }
+    if ((length != FragmentSet::GetPayloadLength(n)) || (pkt.GetLength() != (hdrLength + length)))
+        return false;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        if (ptr[hdrLength + i] != FragmentSet::GetPayloadByte(n, i))
+            return false;
+    }
+    return true;
+}  // end CheckPacket()
+
+// Passes all fragments through the reassembler, counting (and optionally checking) completions
+static unsigned int RunFragments(ProtoIPReassembler& reassembler, const FragmentSet& fragSet,
+                                 bool check, unsigned int& badCount)
+{
+    unsigned int completeCount = 0;
+    ProtoPktIP ipPkt;
+    ProtoPktIP outPkt;
+    for (unsigned int i = 0; i < fragSet.GetCount(); i++)
+    {
+        ipPkt.InitFromBuffer(fragSet.GetLength(i), fragSet.GetPacket(i), fragSet.GetLength(i));
+        if (ProtoIPReassembler::STATUS_COMPLETE == reassembler.Process(ipPkt, outPkt))
+        {
+            completeCount++;
+            if (check && !CheckPacket(outPkt)) badCount++;
+        }
+    }
+    return completeCount;
+}  // end RunFragments()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numDatagrams = (argc > 1) ? atoi(argv[1]) : 20000;
+    unsigned int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+    if (numDatagrams < 100) numDatagrams = 100;
+    if (0 == rounds) rounds = 1;
+    srand(1);
+    ProtoDispatcher dispatcher;
+
+    FragmentSet fragSet;
+    fragSet.Init(numDatagrams, 32, true);
+    printf("%u datagrams (IPv4 and IPv6), %u fragments, %.1lf MB\n",
+           numDatagrams, fragSet.GetCount(), 1.0e-06 * fragSet.GetBytes());
+
+    // 1) Validate reassembled packets (default memory cap)
+    ProtoIPReassembler reassembler(dispatcher);
+    if (!reassembler.Open())
+    {
+        fprintf(stderr, "fragBenchmark: reassembler.Open() error\n");
+        return -1;
+    }
+    unsigned int badCount = 0;
+    unsigned int completeCount = RunFragments(reassembler, fragSet, true, badCount);
+    if ((completeCount != numDatagrams) || (0 != badCount))
+    {
+        fprintf(stderr, "fragBenchmark: validation FAILED (%u of %u complete, %u bad)\n",
+                completeCount, numDatagrams, badCount);
+        return -1;
+    }
+    // (duplicates arriving after their datagram completed are left pending)
+    printf("validation passed (%lu duplicate/overlapping fragments, %u stale pending)\n",
+           reassembler.GetOverlapCount(), reassembler.GetPendingCount());
+    reassembler.Flush();
+
+    // 2) Throughput
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        completeCount = RunFragments(reassembler, fragSet, false, badCount);
+    endTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(endTime, startTime);
+    printf("reassembly: %.2lf Mfragments/sec, %.2lf Gbps (%.0lf nsec/fragment)\n",
+           1.0e-06 * rounds * fragSet.GetCount() / elapsed,
+           8.0e-09 * rounds * fragSet.GetBytes() / elapsed,
+           1.0e+09 * elapsed / ((double)rounds * fragSet.GetCount()));
+
+    // 3) Small memory cap (heavier reordering, oldest datagrams evicted)
+    FragmentSet wideSet;
+    wideSet.Init(numDatagrams, 256, false);
+    ProtoIPReassembler smallReassembler(dispatcher);
+    smallReassembler.Open(64, 64*1024);
+    badCount = 0;
+    completeCount = RunFragments(smallReassembler, wideSet, true, badCount);
+    printf("small cap: %u of %u complete, %lu evicted, %u pages max\n",
+           completeCount, numDatagrams, smallReassembler.GetEvictCount(), smallReassembler.GetPageMax());
+    if ((0 != badCount) || (0 == smallReassembler.GetEvictCount()) ||
+        (smallReassembler.GetPageCount() > smallReassembler.GetPageMax()))
+    {
+        fprintf(stderr, "fragBenchmark: memory cap test FAILED (%u bad)\n", badCount);
+        return -1;
+    }
+
+    // 4) Timeout expiry of incomplete datagrams (every fragment but the last)
+    ProtoIPReassembler timeoutReassembler(dispatcher);
+    timeoutReassembler.Open(ProtoIPReassembler::DEFAULT_DATAGRAM_MAX,
+                            ProtoIPReassembler::DEFAULT_MEMORY_MAX, 0.1);
+    FragmentSet partialSet;
+    partialSet.Init(100, 0, false);
+    ProtoPktIP outPkt;
+    for (unsigned int i = 0; i < partialSet.GetCount(); i++)
+    {
+        ProtoPktIP pkt;
+        pkt.InitFromBuffer(partialSet.GetLength(i), partialSet.GetPacket(i), partialSet.GetLength(i));
+        const UINT8* ptr = (const UINT8*)pkt.GetBuffer();
+        bool more = (4 == pkt.GetVersion()) ? (0 != (ptr[6] & 0x20)) : (0 != (ptr[43] & 0x01));
+        if (more) timeoutReassembler.Process(pkt, outPkt);
+    }
+    unsigned int pendingCount = timeoutReassembler.GetPendingCount();
+    startTime.GetCurrentTime();
+    while ((0 != timeoutReassembler.GetPendingCount()) && ((endTime.GetCurrentTime() - startTime) < 2.0))
+        dispatcher.Run(true);
+    endTime.GetCurrentTime();
+    printf("timeout: %u pending, %lu timed out after %.3lf sec\n",
+           pendingCount, timeoutReassembler.GetTimeoutCount(), endTime - startTime);
+    if ((0 == pendingCount) || (pendingCount != timeoutReassembler.GetTimeoutCount()))
+    {
+        fprintf(stderr, "fragBenchmark: timeout test FAILED\n");
+        return -1;
+    }
+    return 0;
+}  // end main()
@@ -144,7 +144,8 @@ unsigned int MyNode::GetId() const
     MyGraph::Interface* iface = GetDefaultInterface();
     if (NULL != iface)
     {
-        UINT8* addrPtr = (UINT8*)(iface->GetAddress().GetRawHostAddress());
+        ProtoAddress addr = iface->GetAddress();
+        UINT8* addrPtr = (UINT8*)(addr.GetRawHostAddress());
         unsigned int id = addrPtr[2];
         id = (id << 8) + addrPtr[3];
         return id;
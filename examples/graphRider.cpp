@@ -140,7 +140,7 @@ class Node :public NetGraph::NodeTemplate<CdsInterface>, public ProtoQueue::Item
         }
         
         // We always give our nodes a default interface
-        const ProtoAddress& GetAddress() const
+        ProtoAddress GetAddress() const
             {return GetDefaultInterface()->GetAddress();}
         
         const char* GetName() const
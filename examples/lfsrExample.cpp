@@ -224,5 +224,76 @@ int main(int argc, char* argv[])
         if (NULL != refSeq[i]) delete[] refSeq[i];
     delete[] refSeq;
     
+    // This validates the table-driven FillBuffer(), the jump-ahead Seek() 
+    // and SyncSearch() against bit-at-a-time generation and then 
+    // benchmarks them
+    const unsigned int BENCH_BYTES = 1 << 20;
+    char* fastBuf = new char[BENCH_BYTES];
+    char* slowBuf = new char[BENCH_BYTES];
+    if ((NULL == fastBuf) || (NULL == slowBuf))
+    {
+        perror("lfsrExample: new bench buffer error");
+        if (NULL != fastBuf) delete[] fastBuf;
+        return -1;
+    }
+    ProtoLFSR fastReg(ProtoLFSR::PN32BIT);
+    ProtoLFSR slowReg(ProtoLFSR::PN32BIT);
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < BENCH_BYTES; i++)
+    {
+        UINT8 byte = 0;
+        for (int j = 0; j < 8; j++)
+        {
+            byte <<= 1;
+            if (slowReg.GetNextBit()) byte |= 0x01;
+        }
+        slowBuf[i] = (char)byte;
+    }
+    endTime.GetCurrentTime();
+    double bitTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    fastReg.FillBuffer(fastBuf, BENCH_BYTES);
+    endTime.GetCurrentTime();
+    double fillTime = ProtoTime::Delta(endTime, startTime);
+    printf("FillBuffer() %s bit-by-bit generation\n", 
+           (0 == memcmp(fastBuf, slowBuf, BENCH_BYTES)) ? "matches" : "DOES NOT MATCH");
+    printf("bit-by-bit: %lf Mbps  FillBuffer(): %lf Mbps\n",
+           (8.0*BENCH_BYTES) / (1.0e+06*bitTime), (8.0*BENCH_BYTES) / (1.0e+06*fillTime));
+    
+    // Seek forward and backward (slowReg is at bit BENCH_BYTES*8)
+    fastReg.Reset();
+    startTime.GetCurrentTime();
+    fastReg.Seek(8*BENCH_BYTES);
+    endTime.GetCurrentTime();
+    printf("Seek(%u) %s (%lf usec)\n", 8*BENCH_BYTES,
+           (fastReg.GetState() == slowReg.GetState()) ? "matches" : "DOES NOT MATCH",
+           1.0e+06*ProtoTime::Delta(endTime, startTime));
+    fastReg.Seek(-8*(BENCH_BYTES - 1024));
+    bool seekOK = true;
+    for (unsigned int i = 1024; i < 1032; i++)
+        if (fastReg.GetNextByte() != (UINT8)slowBuf[i]) seekOK = false;
+    printf("Seek(%d) %s\n", -8*(BENCH_BYTES - 1024), seekOK ? "matches" : "DOES NOT MATCH");
+    
+    // ProtoLFSRX table-driven generation should match, too
+    UINT32 xp = (UINT32)ProtoLFSR::PN32BIT;
+    pnx.SetPolynomial(&xp, 32);
+    pnx.FillBuffer(fastBuf, BENCH_BYTES);
+    printf("ProtoLFSRX::FillBuffer() %s bit-by-bit generation\n", 
+           (0 == memcmp(fastBuf, slowBuf, BENCH_BYTES)) ? "matches" : "DOES NOT MATCH");
+    
+    // Put a bit error up front and make sure SyncSearch() finds
+    // the first offset where neither the sync nor check bits include it
+    const int ERROR_BIT = 43;
+    slowBuf[ERROR_BIT >> 3] ^= (0x80 >> (ERROR_BIT & 0x07));
+    int found = fastReg.SyncSearch(slowBuf, 1024, 1024, 256);
+    bool syncOK = (ERROR_BIT + 1) == found;
+    for (int i = found; syncOK && (i < found + 256); i++)
+        if (fastReg.GetNextBit() != ProtoLFSR::GetBit(slowBuf, i)) syncOK = false;
+    printf("SyncSearch() found offset %d (bit error at %d) %s\n", 
+           found, ERROR_BIT, syncOK ? "OK" : "ERROR");
+    delete[] fastBuf;
+    delete[] slowBuf;
+    
     return 0;
 }  // end main()
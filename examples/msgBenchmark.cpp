@@ -0,0 +1,333 @@
+// This program validates the ManetPktView parser and ManetPktWriter
+// encoder against the ManetPkt/ManetMsg iterator-based classes and
+// benchmarks building and parsing a realistic mix of RFC 5444
+// messages (NHDP HELLO for IPv4 and IPv6, OLSRv2 TC)
+
+#include "manetMsg.h"
+#include "manetPktView.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi()
+
+using namespace ManetMsgTypes;
+
+const unsigned int BUFFER_SIZE = 4096;
+const unsigned int HELLO_NBRS = 20;
+const unsigned int TC_NBRS = 40;
+const unsigned int HELLO6_NBRS = 8;
+
+// Addresses and TLV values used for the message mix
+static ProtoAddress local_addr;
+static ProtoAddress hello_nbrs[HELLO_NBRS];
+static UINT8 link_status[HELLO_NBRS];
+static ProtoAddress tc_nbrs[TC_NBRS];
+static UINT16 link_metric[TC_NBRS];
+static ProtoAddress local_addr6;
+static ProtoAddress hello6_nbrs[HELLO6_NBRS];
+static UINT8 link_status6[HELLO6_NBRS];
+
+static void InitAddresses()
+{
+    char addrString[64];
+    local_addr.ResolveFromString("10.1.1.1");
+    for (unsigned int i = 0; i < HELLO_NBRS; i++)
+    {
+        sprintf(addrString, "10.1.1.%u", i + 2);
+        hello_nbrs[i].ResolveFromString(addrString);
+        link_status[i] = (0 == (i & 0x01)) ? 1 : 2;
+    }
+    for (unsigned int i = 0; i < TC_NBRS; i++)
+    {
+        sprintf(addrString, "10.2.%u.1", i);
+        tc_nbrs[i].ResolveFromString(addrString);
+        link_metric[i] = (UINT16)(100 + i);
+    }
+    local_addr6.ResolveFromString("fe80::200:ff:fe00:1");
+    for (unsigned int i = 0; i < HELLO6_NBRS; i++)
+    {
+        sprintf(addrString, "fe80::200:ff:fe00:%x", i + 2);
+        hello6_nbrs[i].ResolveFromString(addrString);
+        link_status6[i] = 2;
+    }
+}  // end InitAddresses()
+
+// Build the message mix using the ManetPkt/ManetMsg classes
+static unsigned int BuildLegacy(UINT32* buffer, UINT16 seq)
+{
+    ManetPkt pkt;
+    if (!pkt.InitIntoBuffer(buffer, BUFFER_SIZE)) return 0;
+    pkt.SetSequence(seq);
+
+    // NHDP HELLO (IPv4)
+    ManetMsg* msg = pkt.AppendMessage();
+    msg->SetType(MSG_TYPE_NHDP);
+    msg->SetAddressLength(4);
+    ManetTlv* tlv = msg->AppendTlv(MSG_TLV_VALIDITY_TIME);
+    tlv->SetValue((UINT8)0x64);
+    tlv = msg->AppendTlv(MSG_TLV_INTERVAL_TIME);
+    tlv->SetValue((UINT8)0x54);
+    ManetAddrBlock* blk = msg->AppendAddressBlock();
+    blk->AppendAddress(local_addr);
+    tlv = blk->AppendTlv(ADDR_TLV_LOCAL_IF);
+    tlv->SetValue((UINT8)1);
+    blk = msg->AppendAddressBlock();
+    blk->SetHead(hello_nbrs[0], 3);
+    for (unsigned int i = 0; i < HELLO_NBRS; i++)
+        blk->AppendAddress(hello_nbrs[i]);
+    tlv = blk->AppendTlv(ADDR_TLV_LINK_STATUS);
+    tlv->SetIndexRange(0, HELLO_NBRS - 1, true, HELLO_NBRS);
+    for (unsigned int i = 0; i < HELLO_NBRS; i++)
+        tlv->SetValue(link_status[i], i, HELLO_NBRS);
+    tlv = blk->AppendTlv(ADDR_TLV_OTHER_NEIGHB);
+    tlv->SetIndexRange(0, 4, false, HELLO_NBRS);
+    tlv->SetValue((UINT8)1);
+
+    // OLSRv2 TC (IPv4)
+    msg = pkt.AppendMessage();
+    msg->SetType(MSG_TYPE_OLSRv2);
+    msg->SetOriginator(local_addr);
+    msg->SetHopLimit(255);
+    msg->SetHopCount(0);
+    msg->SetSequence(seq);
+    tlv = msg->AppendTlv(MSG_TLV_OLSR_CONT_SEQ_NUM);
+    tlv->SetValue((UINT16)seq);
+    blk = msg->AppendAddressBlock();
+    blk->SetHead(tc_nbrs[0], 2);
+    blk->SetTail(tc_nbrs[0], 1);
+    for (unsigned int i = 0; i < TC_NBRS; i++)
+        blk->AppendAddress(tc_nbrs[i]);
+    tlv = blk->AppendTlv(ADDR_TLV_OLSR_LINK_METRIC);
+    tlv->SetIndexRange(0, TC_NBRS - 1, true, TC_NBRS);
+    for (unsigned int i = 0; i < TC_NBRS; i++)
+        tlv->SetValue(link_metric[i], i, TC_NBRS);
+
+    // NHDP HELLO (IPv6)
+    msg = pkt.AppendMessage();
+    msg->SetType(MSG_TYPE_NHDP);
+    msg->SetAddressLength(16);
+    tlv = msg->AppendTlv(MSG_TLV_VALIDITY_TIME);
+    tlv->SetValue((UINT8)0x64);
+    blk = msg->AppendAddressBlock();
+    blk->AppendAddress(local_addr6);
+    tlv = blk->AppendTlv(ADDR_TLV_LOCAL_IF);
+    tlv->SetValue((UINT8)1);
+    blk = msg->AppendAddressBlock();
+    blk->SetHead(hello6_nbrs[0], 15);
+    for (unsigned int i = 0; i < HELLO6_NBRS; i++)
+        blk->AppendAddress(hello6_nbrs[i]);
+    tlv = blk->AppendTlv(ADDR_TLV_LINK_STATUS);
+    tlv->SetIndexRange(0, HELLO6_NBRS - 1, true, HELLO6_NBRS);
+    for (unsigned int i = 0; i < HELLO6_NBRS; i++)
+        tlv->SetValue(link_status6[i], i, HELLO6_NBRS);
+
+    pkt.Pack();
+    return pkt.GetLength();
+}  // end BuildLegacy()
+
+// Build the same message mix with ManetPktWriter
+static unsigned int BuildWriter(ManetPktWriter& writer, UINT32* buffer, UINT16 seq)
+{
+    if (!writer.Init(buffer, BUFFER_SIZE)) return 0;
+    writer.SetSequence(seq);
+
+    writer.BeginMessage(MSG_TYPE_NHDP, 4);
+    writer.AppendMsgTlv(MSG_TLV_VALIDITY_TIME, (UINT8)0x64);
+    writer.AppendMsgTlv(MSG_TLV_INTERVAL_TIME, (UINT8)0x54);
+    writer.AppendAddressBlock(&local_addr, 1);
+    writer.AppendAddrTlv(ADDR_TLV_LOCAL_IF, 0, (UINT8)1);
+    writer.AppendAddressBlock(hello_nbrs, HELLO_NBRS);
+    writer.AppendAddrTlv(ADDR_TLV_LINK_STATUS, 0, HELLO_NBRS - 1,
+                         (char*)link_status, HELLO_NBRS, true);
+    UINT8 otherNeighb = 1;
+    writer.AppendAddrTlv(ADDR_TLV_OTHER_NEIGHB, 0, 4, (char*)&otherNeighb, 1);
+    writer.EndMessage();
+
+    writer.BeginMessage(MSG_TYPE_OLSRv2, 4, &local_addr, 255, 0, seq);
+    writer.AppendMsgTlv(MSG_TLV_OLSR_CONT_SEQ_NUM, (UINT16)seq);
+    writer.AppendAddressBlock(tc_nbrs, TC_NBRS);
+    UINT16 metrics[TC_NBRS];
+    for (unsigned int i = 0; i < TC_NBRS; i++)
+        metrics[i] = htons(link_metric[i]);
+    writer.AppendAddrTlv(ADDR_TLV_OLSR_LINK_METRIC, 0, TC_NBRS - 1,
+                         (char*)metrics, 2*TC_NBRS, true);
+    writer.EndMessage();
+
+    writer.BeginMessage(MSG_TYPE_NHDP, 16);
+    writer.AppendMsgTlv(MSG_TLV_VALIDITY_TIME, (UINT8)0x64);
+    writer.AppendAddressBlock(&local_addr6, 1);
+    writer.AppendAddrTlv(ADDR_TLV_LOCAL_IF, 0, (UINT8)1);
+    writer.AppendAddressBlock(hello6_nbrs, HELLO6_NBRS);
+    writer.AppendAddrTlv(ADDR_TLV_LINK_STATUS, 0, HELLO6_NBRS - 1,
+                         (char*)link_status6, HELLO6_NBRS, true);
+    return writer.Finish();
+}  // end BuildWriter()
+
+// Walks the packet with the iterator classes, returning a
+// checksum over address bytes and TLV values
+static UINT32 ParseLegacy(UINT32* buffer, unsigned int pktLen)
+{
+    UINT32 sum = 0;
+    ManetPkt pkt;
+    if (!pkt.InitFromBuffer(pktLen, buffer, pktLen)) return 0;
+    ManetPkt::MsgIterator msgIterator(pkt);
+    ManetMsg msg;
+    while (msgIterator.GetNextMessage(msg))
+    {
+        sum += msg.GetType();
+        if (msg.HasSequence()) sum += msg.GetSequence();
+        ManetMsg::TlvIterator tlvIterator(msg);
+        ManetTlv tlv;
+        while (tlvIterator.GetNextTlv(tlv))
+        {
+            sum += tlv.GetType();
+            if (!tlv.HasValue()) continue;
+            const char* value = tlv.GetValuePtr(tlv.GetValueLength());
+            for (UINT16 j = 0; j < tlv.GetValueLength(); j++)
+                sum += (UINT8)value[j];
+        }
+        ManetMsg::AddrBlockIterator blockIterator(msg);
+        ManetAddrBlock block;
+        while (blockIterator.GetNextAddressBlock(block))
+        {
+            UINT8 numAddrs = block.GetAddressCount();
+            ProtoAddress addr;
+            for (UINT8 i = 0; i < numAddrs; i++)
+            {
+                block.GetAddress(i, addr);
+                const char* ptr = addr.GetRawHostAddress();
+                for (UINT8 j = 0; j < addr.GetLength(); j++)
+                    sum += (UINT8)ptr[j];
+            }
+            ManetAddrBlock::TlvIterator addrTlvIterator(block);
+            while (addrTlvIterator.GetNextTlv(tlv))
+            {
+                sum += tlv.GetType();
+                UINT16 valueLength = tlv.GetValueLength(numAddrs);
+                if (tlv.IsMultiValue())
+                {
+                    for (UINT8 i = tlv.GetIndexStart(); i <= tlv.GetIndexStop(numAddrs); i++)
+                    {
+                        const char* value = tlv.GetValuePtr(valueLength, i, numAddrs);
+                        for (UINT16 j = 0; j < valueLength; j++)
+                            sum += (UINT8)value[j];
+                    }
+                }
+                else if (tlv.HasValue())
+                {
+                    const char* value = tlv.GetValuePtr(valueLength);
+                    for (UINT16 j = 0; j < valueLength; j++)
+                        sum += (UINT8)value[j];
+                }
+            }
+        }
+    }
+    return sum;
+}  // end ParseLegacy()
+
+// Same walk using the flat ManetPktView
+static UINT32 ParseView(ManetPktView& view, UINT32* buffer, unsigned int pktLen)
+{
+    UINT32 sum = 0;
+    if (!view.Parse(buffer, pktLen)) return 0;
+    for (unsigned int m = 0; m < view.GetMsgCount(); m++)
+    {
+        const ManetPktView::Msg& msg = view.GetMsg(m);
+        sum += msg.GetType();
+        if (msg.HasSequence()) sum += msg.GetSequence();
+        unsigned int tlvEnd = msg.GetTlvIndex() + msg.GetTlvCount();
+        for (unsigned int t = msg.GetTlvIndex(); t < tlvEnd; t++)
+        {
+            const ManetPktView::Tlv& tlv = view.GetTlv(t);
+            sum += tlv.GetType();
+            const char* value = tlv.GetValuePtr();
+            for (UINT16 j = 0; j < tlv.GetTlvLength(); j++)
+                sum += (UINT8)value[j];
+        }
+        unsigned int blockEnd = msg.GetAddrBlockIndex() + msg.GetAddrBlockCount();
+        for (unsigned int b = msg.GetAddrBlockIndex(); b < blockEnd; b++)
+        {
+            const ManetPktView::AddrBlock& block = view.GetAddrBlock(b);
+            unsigned int addrEnd = block.GetAddressIndex() + block.GetAddressCount();
+            for (unsigned int i = block.GetAddressIndex(); i < addrEnd; i++)
+            {
+                const char* ptr = view.GetAddressPtr(i);
+                for (UINT8 j = 0; j < msg.GetAddressLength(); j++)
+                    sum += (UINT8)ptr[j];
+            }
+            tlvEnd = block.GetTlvIndex() + block.GetTlvCount();
+            for (unsigned int t = block.GetTlvIndex(); t < tlvEnd; t++)
+            {
+                const ManetPktView::Tlv& tlv = view.GetTlv(t);
+                sum += tlv.GetType();
+                const char* value = tlv.GetValuePtr(tlv.GetIndexStart());
+                for (UINT16 j = 0; j < tlv.GetTlvLength(); j++)
+                    sum += (UINT8)value[j];
+            }
+        }
+    }
+    return sum;
+}  // end ParseView()
+
+int main(int argc, char* argv[])
+{
+    unsigned int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    InitAddresses();
+    UINT32 legacyBuffer[BUFFER_SIZE/4];
+    UINT32 writerBuffer[BUFFER_SIZE/4];
+    ManetPktWriter writer;
+    ManetPktView* view = new ManetPktView();  // (large, so allocate once)
+
+    // 1) Validate that both encoders produce equivalent packets
+    //    and both parsers extract the same content
+    unsigned int legacyLen = BuildLegacy(legacyBuffer, 1);
+    unsigned int writerLen = BuildWriter(writer, writerBuffer, 1);
+    UINT32 sumLegacy = ParseLegacy(legacyBuffer, legacyLen);
+    UINT32 sumView = ParseView(*view, legacyBuffer, legacyLen);
+    UINT32 sumWriter = ParseLegacy(writerBuffer, writerLen);
+    UINT32 sumWriterView = ParseView(*view, writerBuffer, writerLen);
+    printf("legacy build: %u bytes, writer build: %u bytes\n", legacyLen, writerLen);
+    printf("checksums: legacy/legacy:%lu legacy/view:%lu writer/legacy:%lu writer/view:%lu\n",
+            (unsigned long)sumLegacy, (unsigned long)sumView,
+            (unsigned long)sumWriter, (unsigned long)sumWriterView);
+    if ((0 == sumLegacy) || (sumLegacy != sumView) ||
+        (sumLegacy != sumWriter) || (sumLegacy != sumWriterView))
+    {
+        fprintf(stderr, "msgBenchmark: validation FAILED\n");
+        delete view;
+        return -1;
+    }
+    printf("validation passed (%u messages, %u addresses)\n",
+           view->GetMsgCount(), view->GetAddressCount());
+
+    // 2) Benchmark encoding and decoding
+    ProtoTime startTime, endTime;
+    UINT32 total = 0;
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < iterations; i++)
+        total += BuildLegacy(legacyBuffer, (UINT16)i);
+    endTime.GetCurrentTime();
+    double legacyBuildTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < iterations; i++)
+        total += BuildWriter(writer, writerBuffer, (UINT16)i);
+    endTime.GetCurrentTime();
+    double writerBuildTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < iterations; i++)
+        total += ParseLegacy(legacyBuffer, legacyLen);
+    endTime.GetCurrentTime();
+    double legacyParseTime = ProtoTime::Delta(endTime, startTime);
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < iterations; i++)
+        total += ParseView(*view, writerBuffer, writerLen);
+    endTime.GetCurrentTime();
+    double viewParseTime = ProtoTime::Delta(endTime, startTime);
+
+    printf("build:  legacy %lf pkts/sec  writer %lf pkts/sec\n",
+           iterations / legacyBuildTime, iterations / writerBuildTime);
+    printf("parse:  legacy %lf pkts/sec  view %lf pkts/sec\n",
+           iterations / legacyParseTime, iterations / viewParseTime);
+    printf("(total: %lu)\n", (unsigned long)total);
+    delete view;
+    return 0;
+}  // end main()
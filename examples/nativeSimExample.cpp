@@ -0,0 +1,187 @@
+// This program illustrates NativeProtoSim, the in-process network simulator
+// for ProtoSimAgent code.  A grid of "nodes" (each linked to its up to four
+// grid neighbors) run a simple neighbor discovery protocol using ProtoSocket
+// and ProtoTimer exactly as they would in a real program:  each broadcasts
+// jittered HELLO messages and acknowledges HELLOs from new neighbors with a
+// unicast ACK.  With more than one partition, bands of grid rows are
+// simulated in parallel threads with the same results.
+
+// Usage: nativeSimExample [<gridSize> [<partitions> [<seconds>]]]
+
+// (must be built with SIMULATE and NATIVE_SIM defined, see CMakeLists.txt)
+
+#include "nativeProtoSim.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi(), atof()
+#include <string.h>     // for strncmp()
+#include <sys/time.h>   // for gettimeofday() (ProtoTime is the simulation clock here)
+
+#define HELLO_PORT 5000
+
+class HelloAgent : public NativeProtoSimAgent
+{
+    public:
+        HelloAgent();
+        ~HelloAgent();
+
+        bool OnStartup(int argc, const char*const* argv);
+        bool ProcessCommands(int argc, const char*const* argv);
+        void OnShutdown();
+
+        unsigned int GetNeighborsHeard() const
+            {return neighbor_count;}
+        unsigned long GetAckCount() const
+            {return ack_count;}
+
+    private:
+        bool OnHelloTimeout(ProtoTimer& theTimer);
+        void OnSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent);
+
+        enum {NEIGHBOR_MAX = 4};
+        ProtoSocket     socket;
+        ProtoTimer      hello_timer;
+        unsigned long   hello_seq;
+        SIMADDR         neighbor_list[NEIGHBOR_MAX];
+        unsigned int    neighbor_count;
+        unsigned long   ack_count;
+};  // end class HelloAgent
+
+HelloAgent::HelloAgent()
+ : socket(ProtoSocket::UDP), hello_seq(0), neighbor_count(0), ack_count(0)
+{
+    hello_timer.SetListener(this, &HelloAgent::OnHelloTimeout);
+    hello_timer.SetRepeat(-1);
+    socket.SetNotifier(&GetSocketNotifier());
+    socket.SetListener(this, &HelloAgent::OnSocketEvent);
+}
+
+HelloAgent::~HelloAgent()
+{
+    OnShutdown();
+}
+
+bool HelloAgent::OnStartup(int /*argc*/, const char*const* /*argv*/)
+{
+    if (!socket.Open(HELLO_PORT))
+    {
+        fprintf(stderr, "nativeSimExample: socket.Open() error\n");
+        return false;
+    }
+    // (start at a random phase of the HELLO interval)
+    hello_timer.SetInterval(1.0 * UniformRandom());
+    ActivateTimer(hello_timer);
+    return true;
+}  // end HelloAgent::OnStartup()
+
+bool HelloAgent::ProcessCommands(int /*argc*/, const char*const* /*argv*/)
+{
+    return false;
+}  // end HelloAgent::ProcessCommands()
+
+void HelloAgent::OnShutdown()
+{
+    if (hello_timer.IsActive()) hello_timer.Deactivate();
+    if (socket.IsOpen()) socket.Close();
+}  // end HelloAgent::OnShutdown()
+
+bool HelloAgent::OnHelloTimeout(ProtoTimer& theTimer)
+{
+    char buffer[64];
+    unsigned int numBytes = sprintf(buffer, "HELLO %u %lu", GetAddress(), hello_seq++);
+    ProtoAddress dst;
+    dst.SimSetAddress(0xffffffff);  // (broadcast)
+    dst.SetPort(HELLO_PORT);
+    socket.SendTo(buffer, numBytes, dst);
+    theTimer.SetInterval(0.75 + 0.5 * UniformRandom());  // (jittered)
+    return true;
+}  // end HelloAgent::OnHelloTimeout()
+
+void HelloAgent::OnSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent)
+{
+    if (ProtoSocket::RECV != theEvent) return;
+    char buffer[64];
+    unsigned int numBytes = sizeof(buffer) - 1;
+    ProtoAddress srcAddr;
+    if (!theSocket.RecvFrom(buffer, numBytes, srcAddr) || (0 == numBytes)) return;
+    buffer[numBytes] = '\0';
+    if (0 == strncmp(buffer, "ACK", 3))
+    {
+        ack_count++;
+        return;
+    }
+    SIMADDR src = srcAddr.SimGetAddress();
+    for (unsigned int i = 0; i < neighbor_count; i++)
+    {
+        if (src == neighbor_list[i]) return;  // (already known)
+    }
+    if (neighbor_count < NEIGHBOR_MAX) neighbor_list[neighbor_count++] = src;
+    numBytes = sprintf(buffer, "ACK %u", GetAddress());
+    theSocket.SendTo(buffer, numBytes, srcAddr);
+}  // end HelloAgent::OnSocketEvent()
+
+static double WallClock()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec + 1.0e-06 * now.tv_usec);
+}  // end WallClock()
+
+int main(int argc, char* argv[])
+{
+    unsigned int gridSize = (argc > 1) ? atoi(argv[1]) : 32;
+    unsigned int numPartitions = (argc > 2) ? atoi(argv[2]) : 1;
+    double duration = (argc > 3) ? atof(argv[3]) : 600.0;
+    if (0 == gridSize) gridSize = 1;
+    if (0 == numPartitions) numPartitions = 1;
+    if (numPartitions > gridSize) numPartitions = gridSize;
+    unsigned int nodeCount = gridSize * gridSize;
+
+    NativeProtoSim sim(numPartitions);
+    sim.SetSeed(1);
+    HelloAgent* agentList = new HelloAgent[nodeCount];
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        // (bands of grid rows per partition)
+        unsigned int row = i / gridSize;
+        if (0 == sim.AddAgent(agentList[i], row * numPartitions / gridSize))
+        {
+            fprintf(stderr, "nativeSimExample: AddAgent() error\n");
+            return 1;
+        }
+    }
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        // 2 msec, 1 Mbps links with 1% loss (agent addresses are index + 1)
+        if ((0 != ((i + 1) % gridSize)) && !sim.Link(i + 1, i + 2, 0.002, 0.01, 1.0e+06))
+            return 1;
+        if (((i + gridSize) < nodeCount) && !sim.Link(i + 1, i + gridSize + 1, 0.002, 0.01, 1.0e+06))
+            return 1;
+    }
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        if (!agentList[i].Startup(0, NULL)) return 1;
+    }
+
+    double wallStart = WallClock();
+    sim.Run(duration);
+    double wallElapsed = WallClock() - wallStart;
+
+    unsigned long neighborTotal = 0;
+    unsigned long ackTotal = 0;
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        neighborTotal += agentList[i].GetNeighborsHeard();
+        ackTotal += agentList[i].GetAckCount();
+        agentList[i].Shutdown();
+    }
+    printf("%u nodes, %u partition(s): %.1f sec simulated in %.3f sec wall time (%.0fx real time)\n",
+           nodeCount, numPartitions, sim.GetTime(), wallElapsed,
+           (wallElapsed > 0.0) ? (sim.GetTime() / wallElapsed) : 0.0);
+    printf("   %lu events (%.0f events/sec), %lu packets sent, %lu delivered, %lu lost, %lu unroutable\n",
+           sim.GetEventCount(), (wallElapsed > 0.0) ? (sim.GetEventCount() / wallElapsed) : 0.0,
+           sim.GetSentCount(), sim.GetDeliveredCount(), sim.GetLostCount(), sim.GetUnroutableCount());
+    printf("   %.2f neighbors per node, %lu acks received\n",
+           (double)neighborTotal / nodeCount, ackTotal);
+    delete[] agentList;
+    return 0;
+}  // end main()
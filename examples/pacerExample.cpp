@@ -0,0 +1,272 @@
+// This example sends UDP datagrams to itself (loopback) through a ProtoPacer
+// and reports the configured versus achieved (sent and received) rates.
+// The source offers traffic in large, bursty batches and the pacer smooths
+// the output to the configured rate using its token bucket.  Each batch
+// includes a zero-length datagram, which must not stall the pacer queue.
+
+// Usage: pacerExample [rate <bits/sec>][size <bytes>][depth <bytes>]
+//                     [burst <seconds>][duration <seconds>][kernel]
+
+#include "protoApp.h"
+#include "protoPacer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+class PacerExample : public ProtoApp
+{
+    public:
+        PacerExample();
+        ~PacerExample();
+
+        bool OnStartup(int argc, const char*const* argv);
+        bool ProcessCommands(int argc, const char*const* argv);
+        void OnShutdown();
+
+    private:
+        enum CmdType {CMD_INVALID, CMD_ARG, CMD_NOARG};
+        static const char* const CMD_LIST[];
+        static CmdType GetCmdType(const char* string);
+        bool OnCommand(const char* cmd, const char* val);
+        void Usage();
+
+        void OnSourceTimeout(ProtoTimer& theTimer);
+        void OnReportTimeout(ProtoTimer& theTimer);
+        void OnRecvSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent);
+
+        ProtoSocket     tx_socket;
+        ProtoSocket     rx_socket;
+        ProtoPacer      pacer;
+        ProtoTimer      source_timer;
+        ProtoTimer      report_timer;
+        ProtoAddress    dst_addr;
+        unsigned int    pkt_size;
+        double          duration;
+        double          elapsed;
+        unsigned long   recv_bytes;
+        char            tx_buffer[ProtoPacer::DEFAULT_PKT_SIZE_MAX];
+
+};  // end class PacerExample
+
+PROTO_INSTANTIATE_APP(PacerExample)
+
+const double SOURCE_INTERVAL = 0.010;  // source offers a batch every 10 msec
+const double REPORT_INTERVAL = 1.0;
+
+PacerExample::PacerExample()
+ : tx_socket(ProtoSocket::UDP), rx_socket(ProtoSocket::UDP), pacer(GetTimerMgr()),
+   pkt_size(1200), duration(5.0), elapsed(0.0), recv_bytes(0)
+{
+    source_timer.SetListener(this, &PacerExample::OnSourceTimeout);
+    source_timer.SetInterval(SOURCE_INTERVAL);
+    source_timer.SetRepeat(-1);
+    report_timer.SetListener(this, &PacerExample::OnReportTimeout);
+    report_timer.SetInterval(REPORT_INTERVAL);
+    report_timer.SetRepeat(-1);
+    rx_socket.SetNotifier(&GetSocketNotifier());
+    rx_socket.SetListener(this, &PacerExample::OnRecvSocketEvent);
+    tx_socket.SetNotifier(&GetSocketNotifier());
+    pacer.SetRate(10.0e+06);
+    memset(tx_buffer, 'p', sizeof(tx_buffer));
+}
+
+PacerExample::~PacerExample()
+{
+}
+
+void PacerExample::Usage()
+{
+    fprintf(stderr, "Usage: pacerExample [rate <bits/sec>][size <bytes>][depth <bytes>]\n"
+                    "                    [burst <seconds>][duration <seconds>][kernel]\n");
+}
+
+const char* const PacerExample::CMD_LIST[] =
+{
+    "+rate",        // pacing rate in bits/sec
+    "+size",        // datagram payload size in bytes
+    "+depth",       // token bucket depth in bytes (0 = fixed rate)
+    "+burst",       // pacer burst (timer) interval in seconds
+    "+duration",    // test duration in seconds
+    "-kernel",      // use SO_MAX_PACING_RATE
+    NULL
+};
+
+PacerExample::CmdType PacerExample::GetCmdType(const char* cmd)
+{
+    if (!cmd) return CMD_INVALID;
+    unsigned int len = strlen(cmd);
+    bool matched = false;
+    CmdType type = CMD_INVALID;
+    const char* const* nextCmd = CMD_LIST;
+    while (*nextCmd)
+    {
+        if (!strncmp(cmd, *nextCmd+1, len))
+        {
+            if (matched)
+            {
+                // ambiguous command (command should match only once)
+                return CMD_INVALID;
+            }
+            else
+            {
+                matched = true;
+                if ('+' == *nextCmd[0])
+                    type = CMD_ARG;
+                else
+                    type = CMD_NOARG;
+            }
+        }
+        nextCmd++;
+    }
+    return type;
+}  // end PacerExample::GetCmdType()
+
+bool PacerExample::ProcessCommands(int argc, const char*const* argv)
+{
+    int i = 1;
+    while (i < argc)
+    {
+        switch (GetCmdType(argv[i]))
+        {
+            case CMD_INVALID:
+                PLOG(PL_ERROR, "PacerExample::ProcessCommands() invalid command: %s\n", argv[i]);
+                return false;
+            case CMD_NOARG:
+                if (!OnCommand(argv[i], NULL)) return false;
+                i++;
+                break;
+            case CMD_ARG:
+                if (!OnCommand(argv[i], argv[i+1])) return false;
+                i += 2;
+                break;
+        }
+    }
+    return true;
+}  // end PacerExample::ProcessCommands()
+
+bool PacerExample::OnCommand(const char* cmd, const char* val)
+{
+    CmdType type = GetCmdType(cmd);
+    size_t len = strlen(cmd);
+    if ((CMD_ARG == type) && (NULL == val))
+    {
+        PLOG(PL_ERROR, "PacerExample::OnCommand(%s) missing argument\n", cmd);
+        return false;
+    }
+    else if (!strncmp("rate", cmd, len))
+    {
+        pacer.SetRate(atof(val));
+    }
+    else if (!strncmp("size", cmd, len))
+    {
+        pkt_size = atoi(val);
+        if ((pkt_size < 1) || (pkt_size > sizeof(tx_buffer)))
+        {
+            PLOG(PL_ERROR, "PacerExample::OnCommand(size) error: invalid size\n");
+            return false;
+        }
+    }
+    else if (!strncmp("depth", cmd, len))
+    {
+        pacer.SetBucketDepth(atoi(val));
+    }
+    else if (!strncmp("burst", cmd, len))
+    {
+        pacer.SetBurstInterval(atof(val));
+    }
+    else if (!strncmp("duration", cmd, len))
+    {
+        duration = atof(val);
+    }
+    else if (!strncmp("kernel", cmd, len))
+    {
+        pacer.SetKernelPacing(true);
+    }
+    return true;
+}  // end PacerExample::OnCommand()
+
+bool PacerExample::OnStartup(int argc, const char*const* argv)
+{
+    if (!ProcessCommands(argc, argv))
+    {
+        Usage();
+        return false;
+    }
+    if (!rx_socket.Open(0, ProtoAddress::IPv4))
+    {
+        PLOG(PL_ERROR, "pacerExample: rx_socket.Open() error\n");
+        return false;
+    }
+    rx_socket.SetRxBufferSize(4*1024*1024);
+    dst_addr.ResolveFromString("127.0.0.1");
+    dst_addr.SetPort(rx_socket.GetPort());
+    if (!tx_socket.Open(0, ProtoAddress::IPv4))
+    {
+        PLOG(PL_ERROR, "pacerExample: tx_socket.Open() error\n");
+        return false;
+    }
+    if (!pacer.Open(tx_socket))
+    {
+        PLOG(PL_ERROR, "pacerExample: pacer.Open() error\n");
+        return false;
+    }
+    ActivateTimer(source_timer);
+    ActivateTimer(report_timer);
+    return true;
+}  // end PacerExample::OnStartup()
+
+void PacerExample::OnShutdown()
+{
+    if (source_timer.IsActive()) source_timer.Deactivate();
+    if (report_timer.IsActive()) report_timer.Deactivate();
+    pacer.Close();
+    tx_socket.Close();
+    rx_socket.Close();
+}  // end PacerExample::OnShutdown()
+
+void PacerExample::OnSourceTimeout(ProtoTimer& /*theTimer*/)
+{
+    // Offer twice the pacing rate worth of traffic as a single burst
+    // (Excess packets beyond the pacer queue are dropped)
+    double batchBytes = 2.0 * SOURCE_INTERVAL * pacer.GetRate() / 8.0;
+    unsigned int count = (unsigned int)(batchBytes / (double)pkt_size) + 1;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // (The second packet of a batch is usually queued behind the first)
+        unsigned int numBytes = (1 == i) ? 0 : pkt_size;
+        pacer.SendTo(tx_buffer, numBytes, dst_addr);
+    }
+}  // end PacerExample::OnSourceTimeout()
+
+void PacerExample::OnReportTimeout(ProtoTimer& /*theTimer*/)
+{
+    elapsed += REPORT_INTERVAL;
+    fprintf(stdout, "pacerExample: target>%.3lf Mbps sent>%.3lf Mbps recv>%.3lf Mbps "
+                    "pkts>%lu drops>%lu queued>%u\n",
+            1.0e-06*pacer.GetRate(), 1.0e-06*pacer.GetAchievedRate(),
+            1.0e-06*8.0*(double)recv_bytes/REPORT_INTERVAL,
+            pacer.GetSentPackets(), pacer.GetDropCount(), pacer.GetQueueCount());
+    recv_bytes = 0;
+    if ((0 == pacer.GetSentPackets()) && (0 != pacer.GetQueueCount()))
+    {
+        PLOG(PL_ERROR, "pacerExample: error: pacer queue stalled\n");
+        Stop(-1);
+        return;
+    }
+    pacer.ResetStats();
+    if (elapsed >= duration) Stop();
+}  // end PacerExample::OnReportTimeout()
+
+void PacerExample::OnRecvSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent)
+{
+    if (ProtoSocket::RECV != theEvent) return;
+    char buffer[ProtoPacer::DEFAULT_PKT_SIZE_MAX];
+    for (;;)
+    {
+        unsigned int numBytes = sizeof(buffer);
+        ProtoAddress srcAddr;
+        if (!theSocket.RecvFrom(buffer, numBytes, srcAddr) || (0 == numBytes)) break;
+        recv_bytes += numBytes;
+    }
+}  // end PacerExample::OnRecvSocketEvent()
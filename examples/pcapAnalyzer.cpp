@@ -0,0 +1,600 @@
+// This program analyzes a pcap or pcapng capture file in parallel with
+// ProtoPcapAnalyzer, keeping a ProtoFlow::Cache per worker thread (flow
+// affinity keeps each flow on one worker) and printing the flow records.
+// Without an "input" file it instead writes synthetic captures (classic
+// pcap in both byte orders and resolutions, and a two section pcapng file),
+// validates packet delivery, flow affinity, per-flow ordering, timestamps
+// and ordered output for each affinity mode, and measures throughput.
+
+// Usage: pcapAnalyzer [input <pcapFile>][workers <count>][affinity {none|flow|address}][ordered]
+
+#include "protoPcapAnalyzer.h"
+#include "protoFlowCache.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi()
+#include <string.h>  // for strcmp(), memset()
+#include <stdint.h>  // for uint64_t
+#include <unistd.h>  // for unlink(), getpid()
+
+// Per-worker flow accounting (the "input" mode)
+class FlowAnalyzer
+{
+    public:
+        FlowAnalyzer() : flow_count(0) {}
+
+        void OnPacket(ProtoPcapAnalyzer::Worker& worker, const ProtoPcapAnalyzer::Packet& packet);
+        void OnOutput(const char* data, unsigned int length)
+            {fwrite(data, 1, length, stdout);}
+        // Exports (prints) the remaining flows and frees the caches
+        void Finish(ProtoPcapAnalyzer& analyzer);
+
+        unsigned long   flow_count;
+
+    private:
+        class WorkerCache : public ProtoFlow::Cache
+        {
+            public:
+                WorkerCache(ProtoPcapAnalyzer::Worker& theWorker) : worker(theWorker), export_count(0) {}
+                void OnExport(ProtoFlow::Cache& theCache, const Record* recordList, unsigned int recordCount);
+                ProtoPcapAnalyzer::Worker&  worker;
+                unsigned long               export_count;
+        };
+};  // end class FlowAnalyzer
+
+void FlowAnalyzer::OnPacket(ProtoPcapAnalyzer::Worker& worker, const ProtoPcapAnalyzer::Packet& packet)
+{
+    WorkerCache* cache = (WorkerCache*)worker.GetUserData();
+    if (NULL == cache)
+    {
+        // (created upon a worker's first packet)
+        if ((NULL == (cache = new WorkerCache(worker))) || !cache->Open(1 << 18))
+        {
+            fprintf(stderr, "pcapAnalyzer: flow cache allocation error\n");
+            delete cache;
+            return;
+        }
+        cache->SetListener(cache, &WorkerCache::OnExport);
+        worker.SetUserData(cache);
+    }
+    ProtoFlow::Cache::Key key;
+    if (key.InitFromDescriptor(packet.GetDescriptor(), packet.GetInterface()))
+        cache->Update(key, packet.GetOriginalLength(), packet.GetTime(), packet.GetDescriptor().GetTcpFlags());
+    else
+        cache->Advance(packet.GetTime());
+}  // end FlowAnalyzer::OnPacket()
+
+void FlowAnalyzer::WorkerCache::OnExport(ProtoFlow::Cache& /*theCache*/, const Record* recordList, unsigned int recordCount)
+{
+    for (unsigned int i = 0; i < recordCount; i++)
+    {
+        const Record& record = recordList[i];
+        ProtoAddress src, dst;
+        record.GetKey().GetSrcAddr(src);
+        record.GetKey().GetDstAddr(dst);
+        char srcText[64], dstText[64];
+        src.GetHostString(srcText, 64);
+        dst.GetHostString(dstText, 64);
+        char text[256];
+        int length = snprintf(text, sizeof(text), "%.6lf %s/%hu -> %s/%hu proto %d packets %lu bytes %lu duration %.3lf\n",
+                              record.GetFirstTime(), srcText, record.GetKey().GetSrcPort(),
+                              dstText, record.GetKey().GetDstPort(), (int)record.GetKey().GetProtocol(),
+                              record.GetPackets(), record.GetBytes(), record.GetDuration());
+        if (length <= 0) continue;
+        if ((unsigned int)length >= sizeof(text)) length = sizeof(text) - 1;
+        // (outside of the packet handler (i.e., final flush), print directly)
+        if (!worker.Output(text, length)) fwrite(text, 1, length, stdout);
+        export_count++;
+    }
+}  // end FlowAnalyzer::WorkerCache::OnExport()
+
+void FlowAnalyzer::Finish(ProtoPcapAnalyzer& analyzer)
+{
+    for (unsigned int i = 0; i < analyzer.GetWorkerCount(); i++)
+    {
+        ProtoPcapAnalyzer::Worker* worker = analyzer.GetWorker(i);
+        WorkerCache* cache = (WorkerCache*)worker->GetUserData();
+        if (NULL == cache) continue;
+        cache->Flush();
+        flow_count += cache->export_count;
+        worker->SetUserData(NULL);
+        delete cache;
+    }
+}  // end FlowAnalyzer::Finish()
+
+// Synthetic capture generation.  Packet "n" belongs to flow GetFlow(n) and
+// carries the flow id and "n" (as two 32-bit words) at its payload offset.
+class CaptureWriter
+{
+    public:
+        enum Format
+        {
+            PCAP_USEC,          // (little endian)
+            PCAP_NSEC_SWAPPED,  // (big endian, nanosecond timestamps)
+            PCAPNG              // (two sections, second big endian, three interfaces)
+        };
+
+        CaptureWriter(unsigned int numPackets, unsigned int numFlows)
+            : packet_count(numPackets), flow_count(numFlows), swap(false) {}
+
+        bool Write(const char* fileName, Format format);
+
+        unsigned int GetFlow(unsigned int n) const
+            {return ((n * 7919U) % flow_count);}
+        static UINT32 GetSeconds(unsigned int n)
+            {return (1700000000 + n / 1000);}
+        static UINT32 GetNanoseconds(unsigned int n, bool nsec)
+            {return ((n % 1000) * 1000000 + (n % 997) * 1000 + (nsec ? (n % 991) : 0));}
+        static bool IsNanosecond(Format format, unsigned int n)
+            {return ((PCAP_NSEC_SWAPPED == format) || ((PCAPNG == format) && (0 != (n & 0x01))));}
+
+    private:
+        unsigned int BuildFrame(unsigned int n, UINT8* frame) const;
+        void Put16(UINT16 value, FILE* filePtr) const;
+        void Put32(UINT32 value, FILE* filePtr) const;
+        void PutBlock(UINT32 type, const UINT8* body, unsigned int length, FILE* filePtr) const;
+
+        unsigned int    packet_count;
+        unsigned int    flow_count;
+        bool            swap;
+};  // end class CaptureWriter
+
+static void PutNet16(UINT8* ptr, UINT16 value)
+{
+    ptr[0] = (UINT8)(value >> 8);
+    ptr[1] = (UINT8)(value & 0xff);
+}  // end PutNet16()
+
+// Flows cycle through IPv4 UDP, IPv4 TCP, IPv6 UDP, IPv6 TCP and fragmented IPv4
+// UDP (all of whose packets are fragments).  Odd "rounds" are the reverse direction.
+unsigned int CaptureWriter::BuildFrame(unsigned int n, UINT8* frame) const
+{
+    unsigned int flow = GetFlow(n);
+    bool reverse = (0 != ((n / flow_count) & 0x01));
+    unsigned int kind = flow % 5;
+    bool ipv6 = ((2 == kind) || (3 == kind));
+    UINT8 protocol = ((1 == kind) || (3 == kind)) ? 6 : 17;
+    unsigned int payloadLen = 8 + (n % 200);
+    memset(frame, 0, 14 + 40 + 20);
+    for (unsigned int i = 0; i < 12; i++) frame[i] = (UINT8)(i + 1);
+    PutNet16(frame + 12, ipv6 ? 0x86dd : 0x0800);
+    UINT8* ip = frame + 14;
+    UINT8 srcAddr[16], dstAddr[16];
+    memset(srcAddr, 0, 16);
+    memset(dstAddr, 0, 16);
+    srcAddr[0] = dstAddr[0] = ipv6 ? 0x20 : 10;
+    srcAddr[1] = 1;
+    dstAddr[1] = 2;
+    unsigned int addrOffset = ipv6 ? 14 : 2;
+    srcAddr[addrOffset] = dstAddr[addrOffset] = (UINT8)(flow >> 8);
+    srcAddr[addrOffset + 1] = (UINT8)flow;
+    dstAddr[addrOffset + 1] = (UINT8)(flow * 3);
+    UINT16 srcPort = 1024 + (flow % 50000);
+    UINT16 dstPort = 80 + (flow % 3);
+    if (reverse)
+    {
+        UINT8 temp[16];
+        memcpy(temp, srcAddr, 16);
+        memcpy(srcAddr, dstAddr, 16);
+        memcpy(dstAddr, temp, 16);
+        UINT16 port = srcPort;
+        srcPort = dstPort;
+        dstPort = port;
+    }
+    bool fragment = (4 == kind);
+    bool firstFragment = fragment && (0 == (n & 0x02));
+    unsigned int l4Len = (fragment && !firstFragment) ? 0 : ((6 == protocol) ? 20 : 8);
+    unsigned int ipHdrLen = ipv6 ? 40 : 20;
+    if (ipv6)
+    {
+        ip[0] = 0x60;
+        PutNet16(ip + 4, (UINT16)(l4Len + payloadLen));
+        ip[6] = protocol;
+        ip[7] = 64;
+        memcpy(ip + 8, srcAddr, 16);
+        memcpy(ip + 24, dstAddr, 16);
+    }
+    else
+    {
+        ip[0] = 0x45;
+        PutNet16(ip + 2, (UINT16)(ipHdrLen + l4Len + payloadLen));
+        if (fragment) PutNet16(ip + 6, firstFragment ? 0x2000 : 185);
+        ip[8] = 64;
+        ip[9] = protocol;
+        memcpy(ip + 12, srcAddr, 4);
+        memcpy(ip + 16, dstAddr, 4);
+    }
+    UINT8* l4 = ip + ipHdrLen;
+    if (0 != l4Len)
+    {
+        PutNet16(l4, srcPort);
+        PutNet16(l4 + 2, dstPort);
+        if (6 == protocol)
+            l4[12] = 0x50;
+        else
+            PutNet16(l4 + 4, (UINT16)(8 + payloadLen));
+    }
+    UINT8* payload = l4 + l4Len;
+    memcpy(payload, &flow, 4);
+    memcpy(payload + 4, &n, 4);
+    for (unsigned int i = 8; i < payloadLen; i++) payload[i] = (UINT8)(n + i);
+    return (unsigned int)(payload + payloadLen - frame);
+}  // end CaptureWriter::BuildFrame()
+
+void CaptureWriter::Put16(UINT16 value, FILE* filePtr) const
+{
+    if (swap) value = (UINT16)((value >> 8) | (value << 8));
+    fwrite(&value, 2, 1, filePtr);
+}  // end CaptureWriter::Put16()
+
+void CaptureWriter::Put32(UINT32 value, FILE* filePtr) const
+{
+    if (swap)
+        value = ((value >> 24) | ((value >> 8) & 0x0000ff00) | ((value << 8) & 0x00ff0000) | (value << 24));
+    fwrite(&value, 4, 1, filePtr);
+}  // end CaptureWriter::Put32()
+
+// (the "body" must already be in the file byte order)
+void CaptureWriter::PutBlock(UINT32 type, const UINT8* body, unsigned int length, FILE* filePtr) const
+{
+    unsigned int padLen = (4 - (length & 0x03)) & 0x03;
+    UINT32 blockLen = 12 + length + padLen;
+    Put32(type, filePtr);
+    Put32(blockLen, filePtr);
+    fwrite(body, 1, length, filePtr);
+    UINT8 pad[4] = {0, 0, 0, 0};
+    fwrite(pad, 1, padLen, filePtr);
+    Put32(blockLen, filePtr);
+}  // end CaptureWriter::PutBlock()
+
+bool CaptureWriter::Write(const char* fileName, Format format)
+{
+    FILE* filePtr = fopen(fileName, "wb");
+    if (NULL == filePtr)
+    {
+        perror("pcapAnalyzer: fopen() error");
+        return false;
+    }
+    UINT8 frame[512];
+    if (PCAPNG != format)
+    {
+        swap = (PCAP_NSEC_SWAPPED == format);
+        Put32((PCAP_USEC == format) ? 0xa1b2c3d4 : 0xa1b23c4d, filePtr);
+        Put16(2, filePtr);
+        Put16(4, filePtr);
+        Put32(0, filePtr);
+        Put32(0, filePtr);
+        Put32(65535, filePtr);
+        Put32(1, filePtr);  // (LINKTYPE_ETHERNET)
+        for (unsigned int n = 0; n < packet_count; n++)
+        {
+            unsigned int length = BuildFrame(n, frame);
+            UINT32 nsec = GetNanoseconds(n, IsNanosecond(format, n));
+            Put32(GetSeconds(n), filePtr);
+            Put32((PCAP_USEC == format) ? (nsec / 1000) : nsec, filePtr);
+            Put32(length, filePtr);
+            Put32(length, filePtr);
+            fwrite(frame, 1, length, filePtr);
+        }
+    }
+    else
+    {
+        unsigned int sectionStart[2] = {0, packet_count / 2};
+        for (unsigned int s = 0; s < 2; s++)
+        {
+            swap = (1 == s);
+            // Section header
+            UINT8 body[512];
+            UINT32 magic = swap ? 0x4d3c2b1a : 0x1a2b3c4d;
+            memcpy(body, &magic, 4);
+            UINT16 version[2] = {(UINT16)(swap ? 0x0100 : 1), 0};
+            memcpy(body + 4, version, 4);
+            memset(body + 8, 0xff, 8);  // (section length unspecified)
+            PutBlock(0x0a0d0d0a, body, 16, filePtr);
+            // Interface 0 (microseconds), interface 1 (if_tsresol 9, nanoseconds)
+            // and interface 2 (unsupported if_tsresol 64, its packets are skipped)
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                UINT16 linkType = swap ? 0x0100 : 1;
+                memset(body, 0, 24);
+                memcpy(body, &linkType, 2);
+                UINT32 snapLen = swap ? 0xffff0000 : 0x0000ffff;
+                memcpy(body + 4, &snapLen, 4);
+                unsigned int length = 8;
+                if (0 != i)
+                {
+                    UINT16 option[2] = {(UINT16)(swap ? 0x0900 : 9), (UINT16)(swap ? 0x0100 : 1)};
+                    memcpy(body + 8, option, 4);
+                    body[12] = (1 == i) ? 9 : 64;
+                    length = 20;  // (option padded, then opt_endofopt)
+                }
+                PutBlock(1, body, length, filePtr);
+            }
+            // (an unrelated block type to be skipped)
+            memset(body, 0, 8);
+            PutBlock(4, body, 8, filePtr);
+            // (a packet on interface 2, counted as skipped)
+            memset(body, 0, 20);
+            body[0] = swap ? 0 : 2;
+            body[3] = swap ? 2 : 0;
+            memset(body + 4, 0xff, 8);  // (timestamp)
+            PutBlock(6, body, 20, filePtr);
+            unsigned int end = (0 == s) ? sectionStart[1] : packet_count;
+            for (unsigned int n = sectionStart[s]; n < end; n++)
+            {
+                // Enhanced packet block (on interface "n & 1")
+                unsigned int length = BuildFrame(n, frame);
+                bool nsec = IsNanosecond(format, n);
+                uint64_t units = (uint64_t)GetSeconds(n) * (nsec ? 1000000000 : 1000000) +
+                                 (nsec ? GetNanoseconds(n, true) : (GetNanoseconds(n, false) / 1000));
+                UINT32 high = (UINT32)(units >> 32);
+                UINT32 low = (UINT32)(units & 0xffffffff);
+                Put32(6, filePtr);
+                UINT32 blockLen = 32 + ((length + 3) & ~3);
+                Put32(blockLen, filePtr);
+                Put32(n & 0x01, filePtr);
+                Put32(high, filePtr);
+                Put32(low, filePtr);
+                Put32(length, filePtr);
+                Put32(length, filePtr);
+                fwrite(frame, 1, length, filePtr);
+                UINT8 pad[4] = {0, 0, 0, 0};
+                fwrite(pad, 1, ((length + 3) & ~3) - length, filePtr);
+                Put32(blockLen, filePtr);
+            }
+        }
+    }
+    fclose(filePtr);
+    return true;
+}  // end CaptureWriter::Write()
+
+// Validates what each worker is handed
+class Checker
+{
+    public:
+        Checker(const CaptureWriter& theWriter, unsigned int numPackets, unsigned int numFlows, CaptureWriter::Format theFormat)
+            : writer(theWriter), packet_count(numPackets), flow_count(numFlows), format(theFormat),
+              seen_list(new UINT8[numPackets]), output_next(0), output_count(0), bad_count(0)
+        {
+            memset(seen_list, 0, numPackets);
+            for (unsigned int w = 0; w < ProtoPcapAnalyzer::WORKER_MAX; w++) last_list[w] = NULL;
+        }
+        ~Checker()
+        {
+            for (unsigned int w = 0; w < ProtoPcapAnalyzer::WORKER_MAX; w++) delete[] last_list[w];
+            delete[] seen_list;
+        }
+
+        void OnPacket(ProtoPcapAnalyzer::Worker& worker, const ProtoPcapAnalyzer::Packet& packet);
+        void OnOutput(const char* data, unsigned int length);
+        // Returns the number of problems found
+        unsigned int Check(ProtoPcapAnalyzer& analyzer, bool ordered);
+
+    private:
+        enum {NONE = 0xffffffff};
+        const CaptureWriter&    writer;
+        unsigned int            packet_count;
+        unsigned int            flow_count;
+        CaptureWriter::Format   format;
+        UINT8*                  seen_list;
+        UINT32*                 last_list[ProtoPcapAnalyzer::WORKER_MAX];  // per worker, last packet of each flow
+        unsigned long           output_next;
+        unsigned long           output_count;
+        unsigned int            bad_count;
+};  // end class Checker
+
+void Checker::OnPacket(ProtoPcapAnalyzer::Worker& worker, const ProtoPcapAnalyzer::Packet& packet)
+{
+    UINT32* lastList = last_list[worker.GetIndex()];
+    if (NULL == lastList)
+    {
+        // (each worker's first call, so no locking is needed)
+        lastList = last_list[worker.GetIndex()] = new UINT32[flow_count];
+        for (unsigned int f = 0; f < flow_count; f++) lastList[f] = NONE;
+    }
+    const ProtoDissector::Descriptor& desc = packet.GetDescriptor();
+    UINT32 flow, n;
+    memcpy(&flow, desc.GetPayload(packet.GetData()), 4);
+    memcpy(&n, desc.GetPayload(packet.GetData()) + 4, 4);
+    unsigned long index = packet.GetIndex();
+    bool nsec = CaptureWriter::IsNanosecond(format, n);
+    if ((n != index) || (n >= packet_count) || (flow != writer.GetFlow(n)) ||
+        (packet.GetSeconds() != CaptureWriter::GetSeconds(n)) ||
+        (packet.GetNanoseconds() != CaptureWriter::GetNanoseconds(n, nsec)) ||
+        ((CaptureWriter::PCAPNG == format) && (packet.GetInterface() != (n & 0x01))))
+    {
+        bad_count++;
+        return;
+    }
+    seen_list[n]++;
+    // (packets of a flow are seen in order, and with flow affinity, by one worker)
+    if ((NONE != lastList[flow]) && (lastList[flow] >= n)) bad_count++;
+    lastList[flow] = n;
+    char text[32];
+    worker.Output(text, sprintf(text, "%lu\n", index));
+}  // end Checker::OnPacket()
+
+void Checker::OnOutput(const char* data, unsigned int /*length*/)
+{
+    // (checked for capture order by Check() when output is ordered)
+    unsigned long index = strtoul(data, NULL, 10);
+    if (index != output_next) output_next = NONE;
+    if (NONE != output_next) output_next++;
+    output_count++;
+}  // end Checker::OnOutput()
+
+unsigned int Checker::Check(ProtoPcapAnalyzer& analyzer, bool ordered)
+{
+    unsigned int problems = bad_count;
+    for (unsigned int n = 0; n < packet_count; n++)
+        if (1 != seen_list[n]) problems++;
+    if ((analyzer.GetPacketCount() != packet_count) || (output_count != packet_count) ||
+        (ordered && (output_next != packet_count)))
+        problems++;
+    // (the pcapng capture has a packet on an unsupported interface per section)
+    if (analyzer.GetSkipCount() != ((CaptureWriter::PCAPNG == format) ? 2UL : 0UL))
+        problems++;
+    if (ProtoPcapAnalyzer::AFFINITY_NONE != analyzer.GetAffinity())
+    {
+        // Each flow must have been handled by a single worker
+        for (unsigned int f = 0; f < flow_count; f++)
+        {
+            unsigned int workers = 0;
+            for (unsigned int w = 0; w < analyzer.GetWorkerCount(); w++)
+                if ((NULL != last_list[w]) && (NONE != last_list[w][f])) workers++;
+            if (workers > 1) problems++;
+        }
+    }
+    return problems;
+}  // end Checker::Check()
+
+// A light per-packet workload for measuring throughput
+class Counter
+{
+    public:
+        Counter()
+            {memset(sum_list, 0, sizeof(sum_list));}
+        void OnPacket(ProtoPcapAnalyzer::Worker& worker, const ProtoPcapAnalyzer::Packet& packet)
+        {
+            const ProtoDissector::Descriptor& desc = packet.GetDescriptor();
+            sum_list[worker.GetIndex()] += desc.GetSrcPort() + desc.GetPayloadLength();
+        }
+        unsigned long   sum_list[ProtoPcapAnalyzer::WORKER_MAX];
+};  // end class Counter
+
+static int SelfTest(unsigned int numWorkers)
+{
+    const unsigned int numPackets = 200000;
+    const unsigned int numFlows = 5000;
+    CaptureWriter writer(numPackets, numFlows);
+    const char* formatName[3] = {"pcap (usec)", "pcap (nsec, swapped)", "pcapng"};
+    const char* affinityName[3] = {"none", "flow", "address"};
+    char fileName[3][64];
+    bool result = true;
+    for (unsigned int f = 0; f < 3; f++)
+    {
+        sprintf(fileName[f], "/tmp/pcapAnalyzer-%d-%u.pcap", (int)getpid(), f);
+        if (!writer.Write(fileName[f], (CaptureWriter::Format)f)) return -1;
+    }
+
+    // 1) Validation for each format, affinity mode and output order
+    for (unsigned int f = 0; (f < 3) && result; f++)
+    {
+        ProtoPcapAnalyzer analyzer;
+        // (small chunks so there are many in flight)
+        analyzer.SetChunkSize(64*1024, 256);
+        if (!analyzer.Open(fileName[f]))
+        {
+            result = false;
+            break;
+        }
+        for (unsigned int a = 0; (a < 3) && result; a++)
+        {
+            for (unsigned int ordered = 0; ordered < 2; ordered++)
+            {
+                Checker checker(writer, numPackets, numFlows, (CaptureWriter::Format)f);
+                analyzer.SetListener(&checker, &Checker::OnPacket, &Checker::OnOutput);
+                analyzer.SetAffinity((ProtoPcapAnalyzer::Affinity)a);
+                analyzer.SetOrderedOutput(0 != ordered);
+                unsigned int problems = analyzer.Run(numWorkers) ? checker.Check(analyzer, 0 != ordered) : 1;
+                printf("%s, %u workers, affinity %s%s: %lu packets in %lu chunks, %s\n",
+                       formatName[f], numWorkers, affinityName[a], ordered ? ", ordered" : "",
+                       analyzer.GetPacketCount(), analyzer.GetChunkCount(),
+                       (0 == problems) ? "passed" : "FAILED");
+                if (0 != problems)
+                {
+                    fprintf(stderr, "pcapAnalyzer: validation FAILED (%u problems)\n", problems);
+                    result = false;
+                    break;
+                }
+            }
+        }
+        analyzer.SetListener((Checker*)NULL, &Checker::OnPacket);
+    }
+
+    // 2) Throughput
+    if (result)
+    {
+        ProtoPcapAnalyzer analyzer;
+        analyzer.Open(fileName[0]);
+        Counter counter;
+        analyzer.SetListener(&counter, &Counter::OnPacket);
+        for (unsigned int a = 0; a < 2; a++)
+        {
+            analyzer.SetAffinity((ProtoPcapAnalyzer::Affinity)a);
+            for (unsigned int workers = 1; workers <= numWorkers; workers *= 2)
+            {
+                const unsigned int rounds = 10;
+                ProtoTime startTime, endTime;
+                startTime.GetCurrentTime();
+                for (unsigned int r = 0; r < rounds; r++)
+                    analyzer.Run(workers);
+                endTime.GetCurrentTime();
+                double elapsed = ProtoTime::Delta(endTime, startTime);
+                printf("throughput (affinity %s, %u workers): %.2lf Mpps, %.2lf Gbps\n",
+                       affinityName[a], workers, 1.0e-06 * rounds * analyzer.GetPacketCount() / elapsed,
+                       8.0e-09 * rounds * analyzer.GetByteCount() / elapsed);
+            }
+        }
+    }
+    for (unsigned int f = 0; f < 3; f++)
+        unlink(fileName[f]);
+    return result ? 0 : -1;
+}  // end SelfTest()
+
+int main(int argc, char* argv[])
+{
+    const char* inputFile = NULL;
+    unsigned int numWorkers = 4;
+    ProtoPcapAnalyzer::Affinity affinity = ProtoPcapAnalyzer::AFFINITY_FLOW;
+    bool ordered = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "input") && (i + 1 < argc))
+        {
+            inputFile = argv[++i];
+        }
+        else if (!strcmp(argv[i], "workers") && (i + 1 < argc))
+        {
+            numWorkers = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "affinity") && (i + 1 < argc))
+        {
+            const char* mode = argv[++i];
+            if (!strcmp(mode, "none"))
+                affinity = ProtoPcapAnalyzer::AFFINITY_NONE;
+            else if (!strcmp(mode, "address"))
+                affinity = ProtoPcapAnalyzer::AFFINITY_ADDRESS;
+            else
+                affinity = ProtoPcapAnalyzer::AFFINITY_FLOW;
+        }
+        else if (!strcmp(argv[i], "ordered"))
+        {
+            ordered = true;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: pcapAnalyzer [input <pcapFile>][workers <count>][affinity {none|flow|address}][ordered]\n");
+            return -1;
+        }
+    }
+    if (0 == numWorkers) numWorkers = 1;
+    if (NULL == inputFile) return SelfTest(numWorkers);
+
+    ProtoPcapAnalyzer analyzer;
+    if (!analyzer.Open(inputFile)) return -1;
+    FlowAnalyzer flowAnalyzer;
+    analyzer.SetListener(&flowAnalyzer, &FlowAnalyzer::OnPacket, &FlowAnalyzer::OnOutput);
+    analyzer.SetAffinity(affinity);
+    analyzer.SetOrderedOutput(ordered);
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    bool result = analyzer.Run(numWorkers);
+    flowAnalyzer.Finish(analyzer);
+    endTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(endTime, startTime);
+    fflush(stdout);
+    fprintf(stderr, "pcapAnalyzer: %lu packets (%lu skipped), %lu flows, %.3lf sec, %.2lf Mpps\n",
+            analyzer.GetPacketCount(), analyzer.GetSkipCount(), flowAnalyzer.flow_count, elapsed,
+            1.0e-06 * analyzer.GetPacketCount() / elapsed);
+    return result ? 0 : -1;
+}  // end main()
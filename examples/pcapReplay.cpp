@@ -2,21 +2,18 @@
 // Note that it needs root privileges to execute
 
 // Usage:  pcapReplay interface <ifaceName> [input <pcapFile>][dst <addr[/<port>]>][src <addr[/<port>]][edst <macAddr>]
+//                    [speed <multiplier>][topspeed][batch <count>]
 
 // TBD - add option for specific network address translation rules
 
 #include <protoString.h>    // for ProtoTokenator
 #include <protoCap.h>       // for ProtoCap
 #include <protoNet.h>       
-#include <protoPktETH.h>
-#include <protoPktIP.h>
+#include <protoPcapReplay.h>
 #include <protoApp.h>       // base class for command-line app
 #include <protoDebug.h>
 #include <stdio.h>
-#include <pcap.h>
-
-// Maximum supported frame size
-#define FRAME_MAX 8192
+#include <stdlib.h>         // for atof(), atoi()
 
 class PcapReplay : public ProtoApp
 {
@@ -36,21 +33,11 @@ class PcapReplay : public ProtoApp
         bool OnCommand(const char* cmd, const char* val);        
         void Usage();
         bool ParseAddrPort(const char* string, ProtoAddress& addr);
-        double ReadFrame();
-        void OnTxTimeout(ProtoTimer& theTimer);
+        void OnReplayDone(ProtoPcapReplay& theReplay);
 
         const char*     pcap_file;
         ProtoCap*       tx_cap;
-        ProtoTimer      tx_timer;
-        ProtoAddress    dst_addr;
-        ProtoAddress    dst_mac;
-        ProtoAddress    src_addr;
-        pcap_t*         pcap_device;
-        int             pcap_link_type;
-        ProtoTime       last_time;
-        UINT32          aligned_buffer[(FRAME_MAX+4)/4];
-        void*           ip_buffer;
-        UINT16          ip_length;
+        ProtoPcapReplay replay;
       
 }; // end class PcapReplay
 
@@ -58,12 +45,9 @@ class PcapReplay : public ProtoApp
 PROTO_INSTANTIATE_APP(PcapReplay)
         
 PcapReplay::PcapReplay()
- : pcap_file(NULL), tx_cap(NULL), pcap_device(NULL), ip_buffer(NULL), ip_length(0)
-   
+ : pcap_file(NULL), tx_cap(NULL), replay(GetTimerMgr())
 {       
-    tx_timer.SetListener(this, &PcapReplay::OnTxTimeout);
-    tx_timer.SetRepeat(-1);
-    memset(aligned_buffer, 0, FRAME_MAX+4);
+    replay.SetListener(this, &PcapReplay::OnReplayDone);
 }
 
 PcapReplay::~PcapReplay()
@@ -72,7 +56,8 @@ PcapReplay::~PcapReplay()
 
 void PcapReplay::Usage()
 {
-    fprintf(stderr, "pcapReplay interface <ifaceName> [input <pcapFile>][dst <addr[/<port>]>][edst <dstMac>][src <addr[/<port>]>]\n");
+    fprintf(stderr, "pcapReplay interface <ifaceName> [input <pcapFile>][dst <addr[/<port>]>][edst <dstMac>][src <addr[/<port>]>]\n"
+                    "                     [speed <multiplier>][topspeed][batch <count>]\n");
 }  // end PcapReplay::Usage()
 
 
@@ -83,6 +68,9 @@ const char* const PcapReplay::CMD_LIST[] =
     "+dst",         // <addr[/<port>]> remap packets' destination to given address and optional port
     "+src",         // <addr[/<port>]> remap packets' source to given address and optional port
     "+edst",        // <macAddr>  (colon-delimited)
+    "+speed",       // <multiplier> scale the capture timing (e.g., 2.0 replays twice as fast)
+    "-topspeed",    // replay as fast as possible
+    "+batch",       // <count> maximum frames per batched send
     NULL
 };
 
@@ -226,27 +214,57 @@ bool PcapReplay::OnCommand(const char* cmd, const char* val)
     }
     else if (!strncmp("dst", cmd, len))
     {
-        if (!ParseAddrPort(val, dst_addr)) 
+        ProtoAddress dstAddr;
+        if (!ParseAddrPort(val, dstAddr)) 
         {
             PLOG(PL_ERROR, "pcapReplay error: invalid destination address: \"%s\"\n", val);
             return false;
         }
+        replay.SetDstAddr(dstAddr);
     }
     else if (!strncmp("edst", cmd, len))
     {
-        if (!dst_mac.ResolveEthFromString(val))
+        ProtoAddress dstMac;
+        if (!dstMac.ResolveEthFromString(val))
         {
             PLOG(PL_ERROR, "pcapReplay error: invalid mac address: \"%s\"\n", val);
             return false;
         }
+        replay.SetDstMac(dstMac);
     }
     else if (!strncmp("src", cmd, len))
     {
-        if (!ParseAddrPort(val, src_addr))
+        ProtoAddress srcAddr;
+        if (!ParseAddrPort(val, srcAddr))
         {
             PLOG(PL_ERROR, "pcapReplay error: invalid source address: \"%s\"\n", val);
             return false;
         }
+        replay.SetSrcAddr(srcAddr);
+    }
+    else if (!strncmp("speed", cmd, len))
+    {
+        double speed = atof(val);
+        if (speed <= 0.0)
+        {
+            PLOG(PL_ERROR, "pcapReplay error: invalid speed: \"%s\"\n", val);
+            return false;
+        }
+        replay.SetSpeed(speed);
+    }
+    else if (!strncmp("topspeed", cmd, len))
+    {
+        replay.SetSpeed(0.0);
+    }
+    else if (!strncmp("batch", cmd, len))
+    {
+        int count = atoi(val);
+        if (count < 1)
+        {
+            PLOG(PL_ERROR, "pcapReplay error: invalid batch count: \"%s\"\n", val);
+            return false;
+        }
+        replay.SetBatchSize(count);
     }
     else
     {
@@ -269,180 +287,43 @@ bool PcapReplay::OnStartup(int argc, const char*const* argv)
         Usage();
         return false;
     }
-    FILE* infile = stdin;  // by default
-    if (NULL != pcap_file)
+    // Preload the entire capture (stdin by default)
+    if (!replay.Load(pcap_file))
     {
-        if (NULL == (infile = fopen(pcap_file, "r")))
-        {
-            PLOG(PL_ERROR, "pcapReplay error: invalid pcap file \"%s\"\n", pcap_file);
-            return false;
-        }
+        PLOG(PL_ERROR, "pcapReplay error: unable to load pcap file \"%s\"\n", 
+                       (NULL != pcap_file) ? pcap_file : "(stdin)");
+        return false;
     }
-    char pcapErrBuf[PCAP_ERRBUF_SIZE+1];
-    pcapErrBuf[PCAP_ERRBUF_SIZE] = '\0';
-    pcap_device = pcap_fopen_offline(infile, pcapErrBuf);
-    if (NULL == pcap_device)
+    fprintf(stderr, "pcapReplay: loaded %u frames (%u skipped) spanning %.6lf sec\n",
+            replay.GetFrameCount(), replay.GetSkipCount(), replay.GetDuration());
+    if (!replay.Start(*tx_cap))
     {
-        fprintf(stderr, "pcap2mgen: pcap_fopen_offline() error: %s\n", pcapErrBuf);
-        if (stdin != infile) fclose(infile);
+        PLOG(PL_ERROR, "pcapReplay error: unable to start replay\n");
         return false;
     }
-    pcap_link_type = pcap_datalink(pcap_device);
-    tx_timer.SetInterval(0.0);
-    ActivateTimer(tx_timer);
     return true;
 }  // end PcapReplay::OnStartup()
 
-
-double PcapReplay::ReadFrame()
-{
-    // TBD - read/buffer next pcap item and set interval timer
-    pcap_pkthdr hdr;
-    const u_char* pktData;
-    // TBD - make this a loop to seek IP packets?
-    if (NULL != (pktData = pcap_next(pcap_device, &hdr)))
-    {
-        if (hdr.len > hdr.caplen)
-        {
-            PLOG(PL_ERROR, "pcapRelay error: pcap snap length was too small!\n");
-            return -1.0;
-        }
-        unsigned int numBytes = hdr.caplen;
-        if (numBytes > FRAME_MAX)
-        {
-            PLOG(PL_ERROR, "pcapRelay error: encountered oversized frame length  %u\n", numBytes);
-            return -1.0;
-        }
-        if (DLT_LINUX_SLL == pcap_link_type)
-        {
-             memcpy(aligned_buffer, pktData, numBytes);
-             ip_buffer = aligned_buffer + 4;  // assumes 16-byte header (i.e. 6-byte link address on SLL frame)
-             ip_length = numBytes - 16;
-        }
-        else  // assume DLT_EN10MB
-        {
-            UINT16* ethBuffer = ((UINT16*)aligned_buffer) + 1; 
-            memcpy(ethBuffer, pktData, numBytes);
-            ProtoPktETH ethPkt(ethBuffer, FRAME_MAX);
-            if (!ethPkt.InitFromBuffer(hdr.len))
-            {
-                fprintf(stderr, "pcapRelay error: invalid Ether frame in pcap file\n");
-                return -1.0;
-            }    
-            ip_buffer = ethPkt.AccessPayload();
-            ip_length = ethPkt.GetPayloadLength();
-        }
-        // Now determine interval for tx_timer
-        ProtoTime thisTime(hdr.ts);
-        double interval;
-        if (last_time.IsValid())
-        {
-            interval = ProtoTime::Delta(thisTime, last_time);
-            if (interval < 0.0)
-            {
-                PLOG(PL_WARN, "pcapRelay warning: negative pcap interval detected?!\n");
-                interval = 0.0;
-            }
-        }
-        else
-        {
-            interval = 0.0;  // first frame
-        }
-        last_time = thisTime;
-        return interval;
-    }
-    else
-    {
-        // end of pcap input reached
-        return -1.0;
-    }
-    
-}  // end PcapRelay::ReadFrame()
-
-void PcapReplay::OnTxTimeout(ProtoTimer& theTimer)
+void PcapReplay::OnReplayDone(ProtoPcapReplay& theReplay)
 {
-    if (0 != ip_length)
-    {
-        ProtoPktIP ipPkt;
-        if (ipPkt.InitFromBuffer(ip_length, ip_buffer, ip_length))
-        {
-            if (dst_addr.IsValid())
-                ipPkt.SetDstAddr(dst_addr);
-            // TBD - support port number translation
-            if (0 != dst_addr.GetPort())
-                PLOG(PL_WARN, "pcapRelay warning: port translation not yet supported!\n");
-            if (src_addr.IsValid())
-                ipPkt.SetSrcAddr(src_addr);
-            if (0 != src_addr.GetPort())
-                PLOG(PL_WARN, "pcapRelay warning: port translation not yet supported!\n");
-            // Fix UDP checksum  
-            ProtoPktIP::Protocol protocol;
-            switch (ipPkt.GetVersion())
-            {
-                case 4:
-                {
-                    ProtoPktIPv4 ip4Pkt(ipPkt);
-                    protocol = ip4Pkt.GetProtocol();;
-                    break;
-                }
-                case 6:
-                {
-                    ProtoPktIPv6 ip6Pkt(ipPkt);
-                    protocol = ip6Pkt.GetNextHeader();;
-                    break;
-                }
-                default:
-                    PLOG(PL_WARN, "pcapRelay warning: unknown IP version!\n");
-                    protocol = ProtoPktIP::RESERVED;
-                    break;
-            }
-            if (ProtoPktIP::UDP == protocol)
-            {
-                ProtoPktUDP udpPkt;
-                if (udpPkt.InitFromPacket(ipPkt))
-                    udpPkt.FinalizeChecksum(ipPkt);
-                else
-                    PLOG(PL_WARN, "pcapRelay warning: invalid UDP packet?!\n");
-            }
-                
-            // Set appropriate Ethernet header
-            UINT16* ethBuffer = (UINT16*)ip_buffer - 7;
-            ProtoPktETH ethPkt(ethBuffer, ip_length + 14);
-            ethPkt.SetDstAddr(dst_mac);
-            ethPkt.SetType(ProtoPktETH::IP);
-            ethPkt.SetPayloadLength(ip_length);
-            unsigned int numBytes = ethPkt.GetLength();
-            if (!tx_cap->Forward((char*)ethPkt.GetBuffer(), numBytes))
-            {
-                PLOG(PL_ERROR, "pcapRelay error: unable to forward frame!\n");
-            }
-        }
-        else
-        {
-            PLOG(PL_ERROR, "pcapRelay error: bad IP packet!\n");
-        }
-    }
-    double interval = ReadFrame();  // read next pcap frame
-    if (interval < 0.0)
-        Stop();
-    else
-        theTimer.SetInterval(interval);
-}  // end PcapReplay::OnTxTimeout()
+    double elapsed = theReplay.GetElapsedTime();
+    fprintf(stderr, "pcapReplay: sent %lu frames (%lu bytes, %lu errors) in %.6lf sec "
+                    "(%.3lf Mbps, max lateness %.6lf sec)\n",
+            theReplay.GetSentFrames(), theReplay.GetSentBytes(), theReplay.GetErrorCount(),
+            elapsed, (elapsed > 0.0) ? (8.0e-06 * (double)theReplay.GetSentBytes() / elapsed) : 0.0,
+            theReplay.GetMaxLateness());
+    Stop();
+}  // end PcapReplay::OnReplayDone()
 
 void PcapReplay::OnShutdown()
 {
-    if (tx_timer.IsActive()) tx_timer.Deactivate();
+    replay.Stop();
     if (NULL != tx_cap)
     {
         tx_cap->Close();
         delete tx_cap;
         tx_cap = NULL;
     }
-    if (NULL != pcap_device)
-    {
-        pcap_close(pcap_device);
-        pcap_device = NULL;
-    }
     PLOG(PL_ERROR, "PcapReplay: Done.\n"); 
     CloseDebugLog();
 }  // end PcapReplay::OnShutdown()
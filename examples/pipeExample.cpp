@@ -9,6 +9,7 @@
 // 2) Uncomment _one_ of these ProtoPipe "types" for demonstration
 #define PIPE_TYPE ProtoPipe::MESSAGE
 //#define PIPE_TYPE ProtoPipe::STREAM
+//#define PIPE_TYPE ProtoPipe::SEQPACKET
 
 #ifdef ASYNC_IO_EXAMPLE
 /**
@@ -396,16 +397,16 @@ int main(int argc, char* argv[])
         {
             ProtoPipe server(PIPE_TYPE);
             ProtoPipe acceptPipe(PIPE_TYPE);
-            ProtoPipe& recvPipe = (ProtoPipe::STREAM == server.GetType()) ? acceptPipe : server;
+            ProtoPipe& recvPipe = (ProtoPipe::MESSAGE != server.GetType()) ? acceptPipe : server;
             PLOG(PL_ERROR, "pipeExample: server listening ...\n");
             if (!server.Listen("protoDaemon"))
 			{
                 PLOG(PL_ERROR, "pipeExample: error opening server socket\n");
                 return -1;        
             }  
-            if (ProtoPipe::STREAM == server.GetType())
+            if (ProtoPipe::MESSAGE != server.GetType())
             {  
-                // "STREAM" ProtoPipes are connection-oriented
+                // "STREAM" and "SEQPACKET" ProtoPipes are connection-oriented
                 // Note that the argument to Accept() is optional if the
                 // application only wants to have one connection at a time
                 if (!server.Accept(&acceptPipe))
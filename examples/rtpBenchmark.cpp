@@ -0,0 +1,328 @@
+// This program validates ProtoRTPReceiver statistics and in-order playout
+// for many synthetic RTP streams (with packets lost, reordered and
+// duplicated), checks timer-driven playout in real time and measures
+// receive throughput at high stream counts.
+
+// Usage: rtpBenchmark [<numStreams> [<packetsPerStream>]]
+
+#include "protoRTPReceiver.h"
+#include "protoDispatcher.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), rand()
+#include <string.h>  // for memset()
+
+enum
+{
+    PAYLOAD_SIZE    = 160,      // 20 msec of 8 kHz PCMU
+    TIMESTAMP_STEP  = 160,
+    SSRC_BASE       = 0x10000
+};
+static const double PACKET_INTERVAL = 0.020;
+
+// Builds packet "seq" (a sequence number offset) of stream "n"
+static unsigned int BuildPacket(UINT32* buffer, unsigned int n, unsigned int seq)
+{
+    ProtoPktRTP rtpPkt(buffer, 12 + PAYLOAD_SIZE);
+    rtpPkt.SetVersion();
+    rtpPkt.SetPayloadType(ProtoPktRTP::PCMU);
+    rtpPkt.SetSequence((UINT16)(n * 4099 + seq));  // (streams wrap at different points)
+    rtpPkt.SetTimestamp(n * 7919 + seq * TIMESTAMP_STEP);
+    rtpPkt.SetSSRC(SSRC_BASE + n);
+    char payload[PAYLOAD_SIZE];
+    for (unsigned int i = 0; i < PAYLOAD_SIZE; i++)
+        payload[i] = (char)(n + seq + i);
+    rtpPkt.SetPayload(payload, PAYLOAD_SIZE);
+    return rtpPkt.GetLength();
+}  // end BuildPacket()
+
+// Packet "seq" of stream "n" is lost in transit (but never the first two,
+// which validate the source, or the last)
+static bool IsLost(unsigned int n, unsigned int seq, unsigned int numPackets)
+{
+    return ((seq > 1) && ((seq + 1) < numPackets) && (0 == ((n + seq) % 17)));
+}
+
+// Checks played out packets against their original content and order
+class PlayoutChecker
+{
+    public:
+        PlayoutChecker(unsigned int numStreams)
+         : packet_count(0), loss_count(0), bad_count(0),
+           state_list(new State[numStreams]), num_streams(numStreams)
+        {
+            memset(state_list, 0, numStreams * sizeof(State));
+        }
+        ~PlayoutChecker()
+            {delete[] state_list;}
+
+        void OnStreamEvent(ProtoRTPReceiver::Stream& stream, ProtoRTPReceiver::Event event,
+                           const char* data, unsigned int length);
+
+        // Number of packets played out or reported lost for stream "n"
+        unsigned int GetPlayoutCount(unsigned int n) const
+            {return (state_list[n].packet_count + state_list[n].loss_count);}
+
+        unsigned long   packet_count;
+        unsigned long   loss_count;
+        unsigned int    bad_count;
+
+    private:
+        struct State
+        {
+            unsigned int    n;
+            unsigned int    next_seq;   // expected sequence offset
+            unsigned int    packet_count;
+            unsigned int    loss_count;
+        };
+        State*          state_list;
+        unsigned int    num_streams;
+};  // end class PlayoutChecker
+
+void PlayoutChecker::OnStreamEvent(ProtoRTPReceiver::Stream& stream, ProtoRTPReceiver::Event event,
+                                   const char* data, unsigned int length)
+{
+    State* state = (State*)stream.GetUserData();
+    switch (event)
+    {
+        case ProtoRTPReceiver::EVENT_NEW_STREAM:
+        {
+            unsigned int n = stream.GetSsrc() - SSRC_BASE;
+            if (n >= num_streams)
+            {
+                bad_count++;
+                break;
+            }
+            state = state_list + n;
+            state->n = n;
+            state->next_seq = 1;  // (the first packet is used for validation only)
+            stream.SetUserData(state);
+            break;
+        }
+        case ProtoRTPReceiver::EVENT_PACKET:
+        {
+            if (NULL == state) break;
+            packet_count++;
+            state->packet_count++;
+            ProtoPktRTP rtpPkt;
+            if (!rtpPkt.InitFromBuffer(length, (void*)data, length) ||
+                (PAYLOAD_SIZE != rtpPkt.GetPayloadLength()))
+            {
+                bad_count++;
+                break;
+            }
+            unsigned int seq = (UINT16)(rtpPkt.GetSequence() - (UINT16)(state->n * 4099));
+            const char* payload = (const char*)rtpPkt.GetPayload();
+            if ((seq != state->next_seq) || (payload[7] != (char)(state->n + seq + 7)))
+                bad_count++;
+            state->next_seq = seq + 1;
+            break;
+        }
+        case ProtoRTPReceiver::EVENT_LOSS:
+            if (NULL == state) break;
+            loss_count += length;
+            state->loss_count += length;
+            state->next_seq += length;
+            break;
+        default:
+            break;
+    }
+}  // end PlayoutChecker::OnStreamEvent()
+
+// Counts played out packets only (for throughput measurement)
+class PacketCounter
+{
+    public:
+        PacketCounter() : packet_count(0) {}
+        void OnStreamEvent(ProtoRTPReceiver::Stream& /*stream*/, ProtoRTPReceiver::Event event,
+                           const char* /*data*/, unsigned int /*length*/)
+            {if (ProtoRTPReceiver::EVENT_PACKET == event) packet_count++;}
+        unsigned long   packet_count;
+};  // end class PacketCounter
+
+// Sends one packet per stream every PACKET_INTERVAL (odd/even pairs swapped)
+class RealTimeSource
+{
+    public:
+        RealTimeSource(ProtoDispatcher& theDispatcher, ProtoRTPReceiver& theReceiver,
+                       unsigned int numStreams, unsigned int numPackets)
+         : dispatcher(theDispatcher), receiver(theReceiver),
+           num_streams(numStreams), num_packets(numPackets), seq(0)
+        {
+            timer.SetListener(this, &RealTimeSource::OnTimeout);
+            timer.SetInterval(PACKET_INTERVAL);
+            timer.SetRepeat(-1);
+            dispatcher.ActivateTimer(timer);
+        }
+        bool IsDone() const
+            {return (seq >= num_packets);}
+        void OnTimeout(ProtoTimer& theTimer);
+
+    private:
+        ProtoDispatcher&    dispatcher;
+        ProtoRTPReceiver&   receiver;
+        ProtoTimer          timer;
+        unsigned int        num_streams;
+        unsigned int        num_packets;
+        unsigned int        seq;
+};  // end class RealTimeSource
+
+void RealTimeSource::OnTimeout(ProtoTimer& /*theTimer*/)
+{
+    // (each second pair of packets is sent together, in reverse order)
+    unsigned int count = ((seq > 1) && (0 == (seq & 0x02)) && ((seq + 1) < num_packets)) ? 2 : 1;
+    UINT32 buffer[(12 + PAYLOAD_SIZE + 3) / 4];
+    for (unsigned int n = 0; n < num_streams; n++)
+    {
+        for (unsigned int i = count; i > 0; i--)
+        {
+            unsigned int length = BuildPacket(buffer, n, seq + i - 1);
+            ProtoPktRTP rtpPkt(buffer, sizeof(buffer), length);
+            receiver.Receive(rtpPkt);
+        }
+    }
+    seq += count;
+    if (seq >= num_packets) timer.Deactivate();
+}  // end RealTimeSource::OnTimeout()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numStreams = (argc > 1) ? atoi(argv[1]) : 10000;
+    unsigned int numPackets = (argc > 2) ? atoi(argv[2]) : 100;
+    if (numStreams < 100) numStreams = 100;
+    if (numPackets < 10) numPackets = 10;
+    srand(1);
+    ProtoDispatcher dispatcher;
+    UINT32 buffer[(12 + PAYLOAD_SIZE + 3) / 4];
+
+    // 1) Statistics and playout order with loss, reordering and duplicates
+    //    (using synthetic arrival times; buffered packets are flushed at the end)
+    ProtoRTPReceiver receiver(dispatcher);
+    if (!receiver.Open(numStreams, 16 * numStreams))
+    {
+        fprintf(stderr, "rtpBenchmark: receiver.Open() error\n");
+        return -1;
+    }
+    PlayoutChecker checker(numStreams);
+    receiver.SetListener(&checker, &PlayoutChecker::OnStreamEvent);
+    ProtoTime startTime;
+    startTime.GetCurrentTime();
+    unsigned long sentCount = 0;
+    for (unsigned int seq = 0; seq < numPackets; seq++)
+    {
+        for (unsigned int n = 0; n < numStreams; n++)
+        {
+            // Adjacent packets are swapped for some streams
+            unsigned int s = seq;
+            unsigned int pair = seq & ~0x01;
+            if ((pair > 1) && ((pair + 1) < numPackets) && (0 == (n % 3)))
+                s = seq ^ 0x01;
+            if (IsLost(n, s, numPackets)) continue;
+            ProtoTime arrivalTime = startTime;
+            arrivalTime += s * PACKET_INTERVAL + 0.001 * (rand() % 10);
+            unsigned int length = BuildPacket(buffer, n, s);
+            ProtoPktRTP rtpPkt(buffer, sizeof(buffer), length);
+            receiver.Receive(rtpPkt, arrivalTime);
+            sentCount++;
+            if (0 == ((n + s) % 23))
+            {
+                receiver.Receive(rtpPkt, arrivalTime);  // duplicate
+                sentCount++;
+            }
+        }
+    }
+    receiver.Flush();
+    unsigned int statsBad = 0;
+    unsigned int playoutBad = 0;
+    double maxJitter = 0.0;
+    unsigned long lateCount = 0;
+    for (unsigned int n = 0; n < numStreams; n++)
+    {
+        const ProtoRTPReceiver::Stream* stream = receiver.FindStream(SSRC_BASE + n);
+        if (NULL == stream)
+        {
+            statsBad++;
+            continue;
+        }
+        INT32 lost = 0;
+        for (unsigned int seq = 1; seq < numPackets; seq++)
+            if (IsLost(n, seq, numPackets)) lost++;
+        // (duplicates count as received, per RFC 3550)
+        if ((stream->GetExpectedCount() != (numPackets - 1)) ||
+            (stream->GetCumulativeLost() != (lost - (INT32)stream->GetDuplicateCount())) ||
+            (0 == stream->GetDuplicateCount()))
+            statsBad++;
+        if (checker.GetPlayoutCount(n) != (numPackets - 1))
+            playoutBad++;
+        lateCount += stream->GetLateCount();
+        if (stream->GetJitterSeconds() > maxJitter)
+            maxJitter = stream->GetJitterSeconds();
+    }
+    printf("validation: %u streams, %lu packets received, %lu played, %lu lost, %lu late, %lu played early\n",
+           numStreams, sentCount, checker.packet_count, checker.loss_count,
+           lateCount, receiver.GetEarlyCount());
+    // (arrival jitter is uniform over 0-9 msec, i.e., a mean deviation of about 3.3 msec)
+    if ((0 != checker.bad_count) || (0 != statsBad) || (0 != playoutBad) ||
+        (0 != receiver.GetBufferCount()) || (maxJitter <= 0.0) || (maxJitter > 0.010))
+    {
+        fprintf(stderr, "rtpBenchmark: validation FAILED (%u bad packets, %u bad stats, %u bad playout, max jitter %.4lf)\n",
+                checker.bad_count, statsBad, playoutBad, maxJitter);
+        return -1;
+    }
+    printf("validation passed (max jitter %.2lf msec)\n", 1.0e+03 * maxJitter);
+
+    // 2) Throughput (pool sized so that playout is forced early under load)
+    PacketCounter counter;
+    ProtoRTPReceiver fastReceiver(dispatcher);
+    fastReceiver.Open(numStreams, 8 * numStreams, 12 + PAYLOAD_SIZE, 16);
+    fastReceiver.SetListener(&counter, &PacketCounter::OnStreamEvent);
+    unsigned int setCount = 256 * 1024;
+    UINT32* pktSet = new UINT32[(size_t)setCount * (sizeof(buffer) / 4)];
+    for (unsigned int i = 0; i < setCount; i++)
+        BuildPacket(pktSet + (size_t)i * (sizeof(buffer) / 4), i % numStreams, i / numStreams);
+    unsigned int rounds = 8;
+    ProtoTime endTime;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+    {
+        for (unsigned int i = 0; i < setCount; i++)
+        {
+            ProtoPktRTP rtpPkt(pktSet + (size_t)i * (sizeof(buffer) / 4), sizeof(buffer), 12 + PAYLOAD_SIZE);
+            // (sequence numbers advance by "setCount / numStreams" each round)
+            rtpPkt.SetSequence(rtpPkt.GetSequence() + (UINT16)(r * (setCount / numStreams)));
+            fastReceiver.Receive(rtpPkt, startTime);
+            rtpPkt.SetSequence(rtpPkt.GetSequence() - (UINT16)(r * (setCount / numStreams)));
+        }
+    }
+    endTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(endTime, startTime);
+    printf("receive: %.2lf Mpkts/sec (%.0lf nsec/pkt, %u streams, %lu played)\n",
+           1.0e-06 * rounds * setCount / elapsed, 1.0e+09 * elapsed / ((double)rounds * setCount),
+           fastReceiver.GetStreamCount(), counter.packet_count);
+    delete[] pktSet;
+
+    // 3) Timer-driven playout in real time (no loss, so nothing should be skipped)
+    PlayoutChecker rtChecker(100);
+    ProtoRTPReceiver rtReceiver(dispatcher);
+    rtReceiver.Open(100);
+    rtReceiver.SetPlayoutDelay(0.050);
+    rtReceiver.SetListener(&rtChecker, &PlayoutChecker::OnStreamEvent);
+    RealTimeSource source(dispatcher, rtReceiver, 100, 50);
+    startTime.GetCurrentTime();
+    while ((!source.IsDone() || (0 != rtReceiver.GetBufferCount())) && ((endTime.GetCurrentTime() - startTime) < 5.0))
+        dispatcher.Run(true);
+    endTime.GetCurrentTime();
+    unsigned int incompleteCount = 0;
+    for (unsigned int n = 0; n < 100; n++)
+        if (rtChecker.GetPlayoutCount(n) != 49) incompleteCount++;
+    printf("real time: %lu packets played, %lu lost, in %.3lf sec\n",
+           rtChecker.packet_count, rtChecker.loss_count, endTime - startTime);
+    if ((0 != rtChecker.bad_count) || (0 != rtChecker.loss_count) || (0 != incompleteCount) ||
+        (0 != rtReceiver.GetEarlyCount()))
+    {
+        fprintf(stderr, "rtpBenchmark: real time test FAILED (%u bad, %u incomplete)\n",
+                rtChecker.bad_count, incompleteCount);
+        return -1;
+    }
+    return 0;
+}  // end main()
@@ -0,0 +1,546 @@
+// This program compares ProtoShmRing and (MESSAGE/SEQPACKET) ProtoPipe local
+// interprocess messaging.  A forked child process is the producer (or the
+// echo side for latency) and both ends are driven by a ProtoDispatcher,
+// as in "pipeExample".  Messages carry a producer id and sequence number
+// that the consumer checks for loss, reordering and corruption.
+//
+// 1) Throughput: the child sends <count> messages of <size> bytes as fast
+//    as possible (ring messages are published <batch> at a time, with
+//    backpressure handled by output notification)
+// 2) Multi-producer: same as 1) with two producer processes on one ring
+// 3) Pipe throughput: one Send()/Recv() per message, then <batch> messages
+//    per SendBatch()/RecvBatch() call on MESSAGE and SEQPACKET pipes
+// 4) Latency: ping-pong round trips of <size> byte messages
+
+// Usage: shmRingBenchmark [<count> [<size> [<batch>]]]
+
+#include "protoShmRing.h"
+#include "protoPipe.h"
+#include "protoDispatcher.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi()
+#include <string.h>     // for memcpy()
+#include <unistd.h>     // for fork(), pipe(), _exit()
+#include <sys/wait.h>   // for waitpid()
+
+static const unsigned int RING_SIZE = 4*1024*1024;
+static const unsigned int PING_ROUNDS = 20000;
+static const unsigned int BATCH_MAX = ProtoPipe::BATCH_MAX;
+
+// Message content: producer id, sequence number, then a pattern
+static void FillMessage(char* buffer, unsigned int size, UINT32 producer, UINT32 seq)
+{
+    memcpy(buffer, &producer, 4);
+    memcpy(buffer + 4, &seq, 4);
+    for (unsigned int i = 8; i < size; i++)
+        buffer[i] = (char)(seq + i);
+}  // end FillMessage()
+
+// Checks messages arrive complete and in order from each producer
+class Checker
+{
+    public:
+        enum {PRODUCER_MAX = 4};
+        Checker(unsigned int msgSize)
+         : msg_size(msgSize), msg_count(0), bad_count(0)
+            {memset(next_seq, 0, sizeof(next_seq));}
+
+        void Check(const char* msg, unsigned int length)
+        {
+            UINT32 producer, seq;
+            memcpy(&producer, msg, 4);
+            memcpy(&seq, msg + 4, 4);
+            bool ok = (length == msg_size) && (producer < PRODUCER_MAX) && (seq == next_seq[producer]);
+            if (ok) ok = ((char)(seq + (length - 1)) == msg[length - 1]);
+            if (ok)
+                next_seq[producer]++;
+            else if (bad_count++ < 10)
+                fprintf(stderr, "shmRingBenchmark: bad message (producer %u seq %u length %u)\n",
+                        producer, seq, length);
+            msg_count++;
+        }
+        unsigned int    msg_size;
+        unsigned long   msg_count;
+        unsigned long   bad_count;
+        UINT32          next_seq[PRODUCER_MAX];
+};  // end class Checker
+
+// Consumer side of the throughput tests
+class Sink
+{
+    public:
+        Sink(ProtoDispatcher& theDispatcher, unsigned int msgSize, unsigned long expected)
+         : dispatcher(theDispatcher), checker(msgSize), expected_count(expected),
+           recv_batch(1), recv_buffer(new char[BATCH_MAX * (msgSize + 1)]) {}
+        ~Sink()
+            {delete[] recv_buffer;}
+
+        void OnRingEvent(ProtoChannel& theChannel, ProtoChannel::Notification theFlag)
+        {
+            if (ProtoChannel::NOTIFY_INPUT != theFlag) return;
+            ProtoShmRing& ring = static_cast<ProtoShmRing&>(theChannel);
+            const char* msgList[64];
+            unsigned int lengthList[64];
+            unsigned int n;
+            if (0 == checker.msg_count) start_time.GetCurrentTime();
+            while (0 != (n = ring.Peek(64, msgList, lengthList)))
+            {
+                for (unsigned int i = 0; i < n; i++)
+                    checker.Check(msgList[i], lengthList[i]);
+                ring.Consume(n);
+            }
+            if (checker.msg_count >= expected_count) Finish();
+        }
+        void SetRecvBatch(unsigned int batchSize)
+            {recv_batch = (batchSize < BATCH_MAX) ? batchSize : BATCH_MAX;}
+        void OnPipeEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent)
+        {
+            ProtoPipe& pipe = static_cast<ProtoPipe&>(theSocket);
+            if (ProtoSocket::ACCEPT == theEvent)
+            {
+                // (SEQPACKET pipe, the listener becomes the connection)
+                if (!pipe.Accept()) dispatcher.Stop();
+                return;
+            }
+            if (ProtoSocket::RECV != theEvent) return;
+            if (0 == checker.msg_count) start_time.GetCurrentTime();
+            if (recv_batch > 1)
+            {
+                char* bufferList[BATCH_MAX];
+                unsigned int lengthList[BATCH_MAX];
+                unsigned int n;
+                do
+                {
+                    for (unsigned int i = 0; i < recv_batch; i++)
+                    {
+                        bufferList[i] = recv_buffer + i * (checker.msg_size + 1);
+                        lengthList[i] = checker.msg_size + 1;
+                    }
+                    n = pipe.RecvBatch(recv_batch, bufferList, lengthList);
+                    for (unsigned int i = 0; i < n; i++)
+                        checker.Check(bufferList[i], lengthList[i]);
+                } while (n == recv_batch);
+            }
+            else
+            {
+                while (true)
+                {
+                    unsigned int len = checker.msg_size + 1;
+                    if (!pipe.Recv(recv_buffer, len) || (0 == len)) break;
+                    checker.Check(recv_buffer, len);
+                }
+            }
+            if (checker.msg_count >= expected_count) Finish();
+        }
+        void Finish()
+        {
+            end_time.GetCurrentTime();
+            dispatcher.Stop();
+        }
+        double GetElapsed() const
+            {return ProtoTime::Delta(end_time, start_time);}
+
+        ProtoDispatcher&    dispatcher;
+        Checker             checker;
+        unsigned long       expected_count;
+        unsigned int        recv_batch;
+        char*               recv_buffer;
+        ProtoTime           start_time;
+        ProtoTime           end_time;
+};  // end class Sink
+
+// Ring producer (in a child process) driven by output notification
+class Source
+{
+    public:
+        Source(ProtoDispatcher& theDispatcher, UINT32 producerId,
+               unsigned int msgSize, unsigned long count, unsigned int batchSize)
+         : dispatcher(theDispatcher), producer_id(producerId), msg_size(msgSize),
+           msg_count(count), batch_size(batchSize), next_seq(0),
+           msg_buffer(new char[batchSize * msgSize]) {}
+        ~Source()
+            {delete[] msg_buffer;}
+
+        void OnRingEvent(ProtoChannel& theChannel, ProtoChannel::Notification theFlag)
+        {
+            ProtoShmRing& ring = static_cast<ProtoShmRing&>(theChannel);
+            if (ProtoChannel::NOTIFY_ERROR == theFlag)
+            {
+                dispatcher.Stop();
+                return;
+            }
+            if (ProtoChannel::NOTIFY_OUTPUT != theFlag) return;
+            const char* msgList[256];
+            unsigned int lengthList[256];
+            while (next_seq < msg_count)
+            {
+                unsigned int n = batch_size;
+                if ((msg_count - next_seq) < n) n = (unsigned int)(msg_count - next_seq);
+                for (unsigned int i = 0; i < n; i++)
+                {
+                    char* msg = msg_buffer + i * msg_size;
+                    FillMessage(msg, msg_size, producer_id, (UINT32)(next_seq + i));
+                    msgList[i] = msg;
+                    lengthList[i] = msg_size;
+                }
+                unsigned int sent = ring.WriteBatch(n, msgList, lengthList);
+                next_seq += sent;
+                if (sent < n) return;  // ring full, wait for NOTIFY_OUTPUT
+            }
+            ring.StopOutputNotification();
+            dispatcher.Stop();
+        }
+
+        ProtoDispatcher&    dispatcher;
+        UINT32              producer_id;
+        unsigned int        msg_size;
+        unsigned long       msg_count;
+        unsigned int        batch_size;
+        unsigned long       next_seq;
+        char*               msg_buffer;
+};  // end class Source
+
+static void RunRingProducer(const char* ringName, UINT32 producerId, unsigned int msgSize,
+                            unsigned long count, unsigned int batchSize)
+{
+    ProtoDispatcher dispatcher;
+    Source source(dispatcher, producerId, msgSize, count, batchSize);
+    ProtoShmRing ring;
+    ring.SetNotifier(&dispatcher);
+    ring.SetListener(&source, &Source::OnRingEvent);
+    if (!ring.Connect(ringName)) _exit(1);
+    ring.StartOutputNotification();
+    dispatcher.Run();
+    if (0 != ring.GetFullCount())
+        fprintf(stderr, "   (producer %u found the ring full %lu times)\n",
+                producerId, (unsigned long)ring.GetFullCount());
+    ring.Close();
+    _exit(0);
+}  // end RunRingProducer()
+
+static bool RingThroughput(unsigned int numProducers, unsigned long count,
+                           unsigned int msgSize, unsigned int batchSize)
+{
+    char ringName[64];
+    sprintf(ringName, "shmRingBenchmark-%d", (int)getpid());
+    ProtoDispatcher dispatcher;
+    Sink sink(dispatcher, msgSize, count * numProducers);
+    ProtoShmRing ring;
+    ring.SetNotifier(&dispatcher);
+    ring.SetListener(&sink, &Sink::OnRingEvent);
+    if (!ring.Listen(ringName, RING_SIZE, numProducers > 1))
+    {
+        fprintf(stderr, "shmRingBenchmark: ring listen error\n");
+        return false;
+    }
+    pid_t pidList[Checker::PRODUCER_MAX];
+    for (unsigned int i = 0; i < numProducers; i++)
+    {
+        if (0 == (pidList[i] = fork()))
+            RunRingProducer(ringName, i, msgSize, count, batchSize);
+    }
+    dispatcher.Run();
+    for (unsigned int i = 0; i < numProducers; i++)
+        waitpid(pidList[i], NULL, 0);
+    double elapsed = sink.GetElapsed();
+    double rate = (double)sink.checker.msg_count / elapsed;
+    bool ok = (0 == sink.checker.bad_count) && ((count * numProducers) == ring.GetMessageCount());
+    printf("shm ring (%u producer%s, batch %u): %lu x %u bytes: %.2f Mmsg/sec, %.2f Gbps %s\n",
+           numProducers, (numProducers > 1) ? "s" : "", batchSize, sink.checker.msg_count, msgSize,
+           rate * 1.0e-06, rate * msgSize * 8.0e-09, ok ? "passed" : "FAILED");
+    ring.Close();
+    return ok;
+}  // end RingThroughput()
+
+static bool PipeThroughput(ProtoPipe::Type pipeType, unsigned long count,
+                           unsigned int msgSize, unsigned int batchSize)
+{
+    char pipeName[64];
+    sprintf(pipeName, "shmRingBenchmark-%d", (int)getpid());
+    if (batchSize > BATCH_MAX) batchSize = BATCH_MAX;
+    ProtoDispatcher dispatcher;
+    Sink sink(dispatcher, msgSize, count);
+    sink.SetRecvBatch(batchSize);
+    ProtoPipe server(pipeType);
+    server.SetNotifier(&dispatcher);
+    server.SetListener(&sink, &Sink::OnPipeEvent);
+    if (!server.Listen(pipeName))
+    {
+        fprintf(stderr, "shmRingBenchmark: pipe listen error\n");
+        return false;
+    }
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        // (blocking sends, so the full socket queue provides backpressure)
+        ProtoPipe client(pipeType);
+        if (!client.Connect(pipeName)) _exit(1);
+        char* msg = new char[batchSize * msgSize];
+        const char* bufferList[BATCH_MAX];
+        unsigned int lengthList[BATCH_MAX];
+        for (unsigned int i = 0; i < batchSize; i++)
+        {
+            bufferList[i] = msg + i * msgSize;
+            lengthList[i] = msgSize;
+        }
+        unsigned long seq = 0;
+        while (seq < count)
+        {
+            if (batchSize > 1)
+            {
+                unsigned int n = (count - seq < batchSize) ? (unsigned int)(count - seq) : batchSize;
+                for (unsigned int i = 0; i < n; i++)
+                    FillMessage(msg + i * msgSize, msgSize, 0, (UINT32)(seq + i));
+                unsigned int sent = 0;
+                while (sent < n)
+                {
+                    unsigned int result = client.SendBatch(n - sent, bufferList + sent, lengthList + sent);
+                    if (0 == result) break;
+                    sent += result;
+                }
+                if (sent < n) break;
+                seq += n;
+            }
+            else
+            {
+                FillMessage(msg, msgSize, 0, (UINT32)seq);
+                unsigned int len = msgSize;
+                if (!client.Send(msg, len)) break;
+                seq++;
+            }
+        }
+        delete[] msg;
+        client.Close();
+        _exit(0);
+    }
+    dispatcher.Run();
+    waitpid(pid, NULL, 0);
+    double elapsed = sink.GetElapsed();
+    double rate = (double)sink.checker.msg_count / elapsed;
+    bool ok = (0 == sink.checker.bad_count) && (count == sink.checker.msg_count);
+    printf("ProtoPipe %-9s (batch %3u):  %lu x %u bytes: %.2f Mmsg/sec, %.2f Gbps %s\n",
+           (ProtoPipe::SEQPACKET == pipeType) ? "SEQPACKET" : "MESSAGE", batchSize,
+           sink.checker.msg_count, msgSize, rate * 1.0e-06, rate * msgSize * 8.0e-09,
+           ok ? "passed" : "FAILED");
+    server.Close();
+    return ok;
+}  // end PipeThroughput()
+
+// Ping-pong latency.  The parent "pinger" sends a message to the child,
+// which echoes it back on a second ring (or pipe) and so on.
+class Pinger
+{
+    public:
+        Pinger(ProtoDispatcher& theDispatcher, unsigned int msgSize, bool isEcho)
+         : dispatcher(theDispatcher), is_echo(isEcho), msg_size(msgSize), round_count(0),
+           total_rtt(0.0), min_rtt(1.0e+06), max_rtt(0.0), ping_ring(NULL), ping_pipe(NULL),
+           msg_buffer(new char[msgSize + 1]) {}
+        ~Pinger()
+            {delete[] msg_buffer;}
+
+        void SetOutput(ProtoShmRing* ring)
+            {ping_ring = ring;}
+        void SetOutput(ProtoPipe* pipe)
+            {ping_pipe = pipe;}
+
+        void SendPing()
+        {
+            FillMessage(msg_buffer, msg_size, 0, round_count);
+            send_time.GetCurrentTime();
+            Send(msg_buffer, msg_size);
+        }
+        void SendQuit()
+            {Send("Q", 1);}
+
+        void OnRingEvent(ProtoChannel& theChannel, ProtoChannel::Notification theFlag)
+        {
+            if (ProtoChannel::NOTIFY_INPUT != theFlag) return;
+            ProtoShmRing& ring = static_cast<ProtoShmRing&>(theChannel);
+            while (true)
+            {
+                unsigned int len = msg_size + 1;
+                if (!ring.Read(msg_buffer, len) || (0 == len)) break;
+                OnMessage(len);
+            }
+        }
+        void OnPipeEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent)
+        {
+            if (ProtoSocket::RECV != theEvent) return;
+            ProtoPipe& pipe = static_cast<ProtoPipe&>(theSocket);
+            while (true)
+            {
+                unsigned int len = msg_size + 1;
+                if (!pipe.Recv(msg_buffer, len) || (0 == len)) break;
+                OnMessage(len);
+            }
+        }
+        void Report(const char* label) const
+        {
+            printf("%s round trip (%u bytes): avg %.2f usec, min %.2f usec, max %.2f usec\n",
+                   label, msg_size, 1.0e+06 * total_rtt / round_count,
+                   1.0e+06 * min_rtt, 1.0e+06 * max_rtt);
+        }
+
+    private:
+        void Send(const char* msg, unsigned int len)
+        {
+            if (NULL != ping_ring)
+                ping_ring->Write(msg, len);
+            else
+                ping_pipe->Send(msg, len);
+        }
+        void OnMessage(unsigned int len)
+        {
+            if (is_echo)
+            {
+                if (1 == len)
+                    dispatcher.Stop();
+                else
+                    Send(msg_buffer, len);
+                return;
+            }
+            ProtoTime now;
+            now.GetCurrentTime();
+            double rtt = ProtoTime::Delta(now, send_time);
+            total_rtt += rtt;
+            if (rtt < min_rtt) min_rtt = rtt;
+            if (rtt > max_rtt) max_rtt = rtt;
+            if (++round_count < PING_ROUNDS)
+            {
+                SendPing();
+            }
+            else
+            {
+                SendQuit();
+                dispatcher.Stop();
+            }
+        }
+
+        ProtoDispatcher&    dispatcher;
+        bool                is_echo;
+        unsigned int        msg_size;
+        unsigned int        round_count;
+        double              total_rtt;
+        double              min_rtt;
+        double              max_rtt;
+        ProtoTime           send_time;
+        ProtoShmRing*       ping_ring;
+        ProtoPipe*          ping_pipe;
+        char*               msg_buffer;
+};  // end class Pinger
+
+static void RingLatency(unsigned int msgSize)
+{
+    char pongName[64], pingName[64];
+    sprintf(pongName, "shmRingBenchmark-%d-pong", (int)getpid());
+    sprintf(pingName, "shmRingBenchmark-%d-ping", (int)getpid());
+    ProtoDispatcher dispatcher;
+    Pinger pinger(dispatcher, msgSize, false);
+    ProtoShmRing pongRing;
+    pongRing.SetNotifier(&dispatcher);
+    pongRing.SetListener(&pinger, &Pinger::OnRingEvent);
+    if (!pongRing.Listen(pongName, 65536)) return;
+    int syncFd[2];
+    if (0 != pipe(syncFd)) return;
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        ProtoDispatcher echoDispatcher;
+        Pinger echo(echoDispatcher, msgSize, true);
+        ProtoShmRing pingRing, replyRing;
+        if (!pingRing.Listen(pingName, 65536)) _exit(1);
+        if (1 != write(syncFd[1], "x", 1)) _exit(1);
+        if (!pingRing.Accept()) _exit(1);
+        pingRing.SetNotifier(&echoDispatcher);
+        pingRing.SetListener(&echo, &Pinger::OnRingEvent);
+        if (!replyRing.Connect(pongName)) _exit(1);
+        echo.SetOutput(&replyRing);
+        echoDispatcher.Run();
+        replyRing.Close();
+        pingRing.Close();
+        _exit(0);
+    }
+    char byte;
+    ProtoShmRing pingRing;
+    if ((1 != read(syncFd[0], &byte, 1)) || !pingRing.Connect(pingName))
+    {
+        fprintf(stderr, "shmRingBenchmark: ping ring connect error\n");
+        return;
+    }
+    pinger.SetOutput(&pingRing);
+    pinger.SendPing();
+    dispatcher.Run();
+    waitpid(pid, NULL, 0);
+    close(syncFd[0]);
+    close(syncFd[1]);
+    pinger.Report("shm ring ");
+}  // end RingLatency()
+
+static void PipeLatency(unsigned int msgSize)
+{
+    char pongName[64], pingName[64];
+    sprintf(pongName, "shmRingBenchmark-%d-pong", (int)getpid());
+    sprintf(pingName, "shmRingBenchmark-%d-ping", (int)getpid());
+    ProtoDispatcher dispatcher;
+    Pinger pinger(dispatcher, msgSize, false);
+    ProtoPipe pongPipe(ProtoPipe::MESSAGE);
+    pongPipe.SetNotifier(&dispatcher);
+    pongPipe.SetListener(&pinger, &Pinger::OnPipeEvent);
+    if (!pongPipe.Listen(pongName)) return;
+    int syncFd[2];
+    if (0 != pipe(syncFd)) return;
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        ProtoDispatcher echoDispatcher;
+        Pinger echo(echoDispatcher, msgSize, true);
+        ProtoPipe pingPipe(ProtoPipe::MESSAGE), replyPipe(ProtoPipe::MESSAGE);
+        pingPipe.SetNotifier(&echoDispatcher);
+        pingPipe.SetListener(&echo, &Pinger::OnPipeEvent);
+        if (!pingPipe.Listen(pingName)) _exit(1);
+        if (!replyPipe.Connect(pongName)) _exit(1);
+        echo.SetOutput(&replyPipe);
+        if (1 != write(syncFd[1], "x", 1)) _exit(1);
+        echoDispatcher.Run();
+        replyPipe.Close();
+        pingPipe.Close();
+        _exit(0);
+    }
+    char byte;
+    ProtoPipe pingPipe(ProtoPipe::MESSAGE);
+    if ((1 != read(syncFd[0], &byte, 1)) || !pingPipe.Connect(pingName))
+    {
+        fprintf(stderr, "shmRingBenchmark: ping pipe connect error\n");
+        return;
+    }
+    pinger.SetOutput(&pingPipe);
+    pinger.SendPing();
+    dispatcher.Run();
+    waitpid(pid, NULL, 0);
+    close(syncFd[0]);
+    close(syncFd[1]);
+    pongPipe.Close();
+    pingPipe.Close();
+    pinger.Report("ProtoPipe");
+}  // end PipeLatency()
+
+int main(int argc, char* argv[])
+{
+    unsigned long count = (argc > 1) ? atoi(argv[1]) : 2000000;
+    unsigned int msgSize = (argc > 2) ? atoi(argv[2]) : 256;
+    unsigned int batchSize = (argc > 3) ? atoi(argv[3]) : 32;
+    if (msgSize < 8) msgSize = 8;
+    if (batchSize < 1) batchSize = 1;
+    if (batchSize > 256) batchSize = 256;
+
+    bool ok = RingThroughput(1, count, msgSize, 1);
+    ok &= RingThroughput(1, count, msgSize, batchSize);
+    ok &= RingThroughput(2, count / 2, msgSize, batchSize);
+    ok &= PipeThroughput(ProtoPipe::MESSAGE, count, msgSize, 1);
+    ok &= PipeThroughput(ProtoPipe::MESSAGE, count, msgSize, batchSize);
+    ok &= PipeThroughput(ProtoPipe::SEQPACKET, count, msgSize, batchSize);
+    RingLatency(msgSize);
+    PipeLatency(msgSize);
+    return ok ? 0 : 1;
+}  // end main()
@@ -0,0 +1,278 @@
+// This program validates ProtoSpaceIndex radius and k-nearest neighbor
+// queries against ProtoSpace::Iterator and compares their performance for
+// a set of moving nodes where every node finds its neighbors every "tick"
+// (as a network emulator computing connectivity would)
+
+// Usage: spaceBenchmark [<numNodes> [<numTicks> [<radius> [<numThreads>]]]]
+
+#include "protoSpaceIndex.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), atof(), qsort()
+#include <math.h>    // for sqrt()
+
+class SimNode : public ProtoSpace::Node
+{
+    public:
+        unsigned int GetDimensions() const
+            {return 2;}
+        double GetOrdinate(unsigned int index) const
+            {return pos[index];}
+
+        void Move(double extent)
+        {
+            for (unsigned int i = 0; i < 2; i++)
+            {
+                pos[i] += vel[i];
+                if ((pos[i] < 0.0) || (pos[i] >= extent))
+                {
+                    vel[i] = -vel[i];
+                    pos[i] += 2.0 * vel[i];
+                }
+            }
+        }
+
+        double  pos[2];
+        double  vel[2];
+};  // end class SimNode
+
+static double Random(double max)
+{
+    return (max * (double)rand() / ((double)RAND_MAX + 1.0));
+}
+
+static int CompareNeighbor(const void* a, const void* b)
+{
+    const ProtoSpace::Node* na = static_cast<const ProtoSpaceIndex::Neighbor*>(a)->node;
+    const ProtoSpace::Node* nb = static_cast<const ProtoSpaceIndex::Neighbor*>(b)->node;
+    return ((na < nb) ? -1 : ((na > nb) ? 1 : 0));
+}
+
+// ProtoSpace::Iterator version of a radius query (excluding the node itself)
+static unsigned int IteratorFindNeighbors(ProtoSpace::Iterator& iterator, SimNode& node, double radius,
+                                          ProtoSpaceIndex::Neighbor* neighborList, unsigned int listMax)
+{
+    iterator.Reset(node.pos);
+    unsigned int found = 0;
+    ProtoSpace::Node* next;
+    double distance;
+    while ((NULL != (next = iterator.GetNextNode(&distance))) && (distance <= radius))
+    {
+        if (next == &node) continue;
+        if (found < listMax)
+        {
+            neighborList[found].node = next;
+            neighborList[found].distance = distance;
+        }
+        found++;
+    }
+    return found;
+}  // end IteratorFindNeighbors()
+
+static bool Validate(ProtoSpace& space, ProtoSpaceIndex& index, SimNode* nodeList,
+                     unsigned int numNodes, double radius)
+{
+    const unsigned int LIST_MAX = 1024;
+    const unsigned int K = 8;
+    ProtoSpaceIndex::Neighbor* refList = new ProtoSpaceIndex::Neighbor[LIST_MAX];
+    ProtoSpaceIndex::Neighbor* testList = new ProtoSpaceIndex::Neighbor[LIST_MAX];
+    ProtoSpace::Iterator iterator(space);
+    bool result = iterator.Init();
+    for (unsigned int n = 0; result && (n < numNodes); n += (numNodes / 500) + 1)
+    {
+        SimNode& node = nodeList[n];
+        // Radius query (compare node sets)
+        unsigned int refCount = IteratorFindNeighbors(iterator, node, radius, refList, LIST_MAX);
+        unsigned int testCount = index.FindNeighbors(node.pos, radius, testList, LIST_MAX, &node);
+        if ((refCount != testCount) || (refCount > LIST_MAX))
+        {
+            fprintf(stderr, "spaceBenchmark: radius query count mismatch (%u vs %u)\n", refCount, testCount);
+            result = false;
+            break;
+        }
+        qsort(refList, refCount, sizeof(ProtoSpaceIndex::Neighbor), CompareNeighbor);
+        qsort(testList, testCount, sizeof(ProtoSpaceIndex::Neighbor), CompareNeighbor);
+        for (unsigned int i = 0; i < refCount; i++)
+        {
+            if (refList[i].node != testList[i].node)
+            {
+                fprintf(stderr, "spaceBenchmark: radius query node mismatch\n");
+                result = false;
+                break;
+            }
+        }
+        // k-nearest query (compare distances, in order)
+        iterator.Reset(node.pos);
+        refCount = 0;
+        ProtoSpace::Node* next;
+        double distance;
+        while ((refCount < K) && (NULL != (next = iterator.GetNextNode(&distance))))
+        {
+            if (next == &node) continue;
+            refList[refCount].node = next;
+            refList[refCount++].distance = distance;
+        }
+        testCount = index.FindNearest(node.pos, K, testList, &node);
+        if (refCount != testCount)
+        {
+            fprintf(stderr, "spaceBenchmark: nearest query count mismatch (%u vs %u)\n", refCount, testCount);
+            result = false;
+            break;
+        }
+        for (unsigned int i = 0; i < refCount; i++)
+        {
+            if (fabs(refList[i].distance - testList[i].distance) > 1.0e-09)
+            {
+                fprintf(stderr, "spaceBenchmark: nearest query distance mismatch\n");
+                result = false;
+                break;
+            }
+        }
+    }
+    delete[] testList;
+    delete[] refList;
+    return result;
+}  // end Validate()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numNodes = (argc > 1) ? atoi(argv[1]) : 50000;
+    unsigned int numTicks = (argc > 2) ? atoi(argv[2]) : 10;
+    double radius = (argc > 3) ? atof(argv[3]) : 10.0;
+    unsigned int numThreads = (argc > 4) ? atoi(argv[4]) : 4;
+    if (numNodes < 16) numNodes = 16;
+    if (0 == numTicks) numTicks = 1;
+    if (radius <= 0.0) radius = 10.0;
+    // Size the area for about 20 neighbors per node
+    double extent = sqrt((double)numNodes * M_PI * radius * radius / 20.0);
+    const unsigned int LIST_MAX = 256;
+
+    srand(1);
+    SimNode* nodeList = new SimNode[numNodes];
+    ProtoSpace::Node** queryList = new ProtoSpace::Node*[numNodes];
+    ProtoSpaceIndex::Neighbor* resultList = new ProtoSpaceIndex::Neighbor[(size_t)numNodes * LIST_MAX];
+    unsigned int* countList = new unsigned int[numNodes];
+    for (unsigned int i = 0; i < numNodes; i++)
+    {
+        SimNode& node = nodeList[i];
+        node.pos[0] = Random(extent);
+        node.pos[1] = Random(extent);
+        node.vel[0] = Random(0.2 * radius) - 0.1 * radius;
+        node.vel[1] = Random(0.2 * radius) - 0.1 * radius;
+        queryList[i] = &node;
+    }
+    printf("%u nodes, %.1lf x %.1lf area, radius %.1lf, %u ticks\n", numNodes, extent, extent, radius, numTicks);
+
+    ProtoSpace space;
+    ProtoSpaceIndex index(radius);
+    for (unsigned int i = 0; i < numNodes; i++)
+        space.InsertNode(nodeList[i]);
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    if (!index.Rebuild(queryList, numNodes))
+    {
+        fprintf(stderr, "spaceBenchmark: index.Rebuild() error\n");
+        return -1;
+    }
+    endTime.GetCurrentTime();
+    double rebuildTime = ProtoTime::Delta(endTime, startTime);
+
+    // 1) Validate against ProtoSpace::Iterator (static and after moving)
+    bool valid = Validate(space, index, nodeList, numNodes, radius);
+    for (unsigned int i = 0; valid && (i < numNodes); i++)
+    {
+        space.RemoveNode(nodeList[i]);
+        nodeList[i].Move(extent);
+        space.InsertNode(nodeList[i]);
+    }
+    if (valid && !index.Update())
+    {
+        fprintf(stderr, "spaceBenchmark: index.Update() error\n");
+        valid = false;
+    }
+    if (!valid || !Validate(space, index, nodeList, numNodes, radius))
+    {
+        fprintf(stderr, "spaceBenchmark: validation FAILED\n");
+        return -1;
+    }
+    printf("validation passed\n");
+
+    // 2) ProtoSpace (move nodes, then Iterator neighbor query for every node).
+    //    The Iterator queries are slow, so only a sample of nodes is queried
+    //    and the query time is scaled up to the full node set.
+    ProtoSpace::Iterator iterator(space);
+    iterator.Init();
+    unsigned int sampleStep = (numNodes / 1000) + 1;
+    unsigned int sampleCount = 0;
+    unsigned long refTotal = 0;
+    double moveTime = 0.0;
+    double queryTime = 0.0;
+    for (unsigned int t = 0; t < numTicks; t++)
+    {
+        startTime.GetCurrentTime();
+        for (unsigned int i = 0; i < numNodes; i++)
+        {
+            space.RemoveNode(nodeList[i]);
+            nodeList[i].Move(extent);
+            space.InsertNode(nodeList[i]);
+        }
+        endTime.GetCurrentTime();
+        moveTime += ProtoTime::Delta(endTime, startTime);
+        startTime.GetCurrentTime();
+        for (unsigned int i = (t % sampleStep); i < numNodes; i += sampleStep)
+        {
+            refTotal += IteratorFindNeighbors(iterator, nodeList[i], radius, resultList, LIST_MAX);
+            sampleCount++;
+        }
+        endTime.GetCurrentTime();
+        queryTime += ProtoTime::Delta(endTime, startTime);
+    }
+    double refTime = (moveTime + (queryTime * numTicks * numNodes / sampleCount)) / numTicks;
+    printf("ProtoSpace::Iterator:          %8.2lf msec/tick (update %.2lf msec) (%.1lf neighbors/node, %u queries sampled)\n",
+           1.0e+03 * refTime, 1.0e+03 * moveTime / numTicks, (double)refTotal / sampleCount, sampleCount);
+    iterator.Destroy();
+    space.Empty();
+
+    // 3) ProtoSpaceIndex, single and multiple threads
+    for (unsigned int pass = 0; pass < 2; pass++)
+    {
+        unsigned int threads = (0 == pass) ? 1 : numThreads;
+        if ((0 != pass) && (threads <= 1)) break;
+        unsigned long total = 0;
+        double updateTime = 0.0;
+        startTime.GetCurrentTime();
+        for (unsigned int t = 0; t < numTicks; t++)
+        {
+            ProtoTime updateStart, updateEnd;
+            updateStart.GetCurrentTime();
+            for (unsigned int i = 0; i < numNodes; i++)
+                nodeList[i].Move(extent);
+            index.Update();
+            updateEnd.GetCurrentTime();
+            updateTime += ProtoTime::Delta(updateEnd, updateStart);
+            index.FindNeighborsBatch(queryList, numNodes, radius, resultList, LIST_MAX, countList, threads);
+            for (unsigned int i = 0; i < numNodes; i++)
+                total += countList[i];
+        }
+        endTime.GetCurrentTime();
+        double testTime = ProtoTime::Delta(endTime, startTime) / numTicks;
+        printf("ProtoSpaceIndex (%u thread%s):   %8.2lf msec/tick (update %.2lf msec) speedup %.1lfx (%.1lf neighbors/node)\n",
+               threads, (1 == threads) ? " " : "s", 1.0e+03 * testTime, 1.0e+03 * updateTime / numTicks,
+               refTime / testTime, (double)total / ((double)numTicks * numNodes));
+    }
+
+    // 4) k-nearest batch query and bulk rebuild
+    const unsigned int K = 8;
+    startTime.GetCurrentTime();
+    index.FindNearestBatch(queryList, numNodes, K, resultList, countList, numThreads);
+    endTime.GetCurrentTime();
+    printf("ProtoSpaceIndex k-nearest (k=%u, %u threads): %.2lf msec\n",
+           K, numThreads, 1.0e+03 * ProtoTime::Delta(endTime, startTime));
+    printf("ProtoSpaceIndex::Rebuild(): %.2lf msec\n", 1.0e+03 * rebuildTime);
+
+    delete[] countList;
+    delete[] resultList;
+    delete[] queryList;
+    delete[] nodeList;
+    return 0;
+}  // end main()
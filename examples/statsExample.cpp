@@ -0,0 +1,186 @@
+// This program illustrates the ProtoStats streaming estimators with a
+// stream of synthetic (log-normal) latency samples.  It reports the cost
+// per sample of each estimator and compares the quantiles from the
+// histogram and P-square estimators with the exact values (from sorting
+// all samples).  It then records the samples from several threads, each
+// into its own histogram (merged afterwards) and all into one shared
+// histogram with RecordConcurrent().
+
+// Usage: statsExample [<sampleCount> [<threads>]]
+
+#include "protoStats.h"
+#include "protoThread.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi(), qsort()
+#include <math.h>       // for exp(), log(), sqrt(), cos()
+
+// Log-normal latencies (median 1 msec) from a simple LCG and Box-Muller
+static void FillSamples(double* sampleList, unsigned int count)
+{
+    unsigned long long state = 12345;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u1 = ((double)(state >> 11) + 1.0) / 9007199254740993.0;
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u2 = (double)(state >> 11) / 9007199254740992.0;
+        double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979 * u2);
+        sampleList[i] = 1.0e-03 * exp(0.75 * normal);
+    }
+}  // end FillSamples()
+
+static int CompareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}  // end CompareDouble()
+
+class Recorder : public ProtoThread
+{
+    public:
+        Recorder() : sample_list(NULL), sample_count(0), shared(NULL) {}
+        bool Init(const double* sampleList, unsigned int count, ProtoStats::Histogram* sharedHistogram)
+        {
+            sample_list = sampleList;
+            sample_count = count;
+            shared = sharedHistogram;
+            return histogram.Init(1.0e-06, 100.0);
+        }
+        int RunThread()
+        {
+            if (NULL != shared)
+            {
+                for (unsigned int i = 0; i < sample_count; i++)
+                    shared->RecordConcurrent(sample_list[i]);
+            }
+            else
+            {
+                for (unsigned int i = 0; i < sample_count; i++)
+                    histogram.Record(sample_list[i]);
+            }
+            return 0;
+        }
+        const ProtoStats::Histogram& GetHistogram() const
+            {return histogram;}
+
+    private:
+        const double*           sample_list;
+        unsigned int            sample_count;
+        ProtoStats::Histogram*  shared;
+        ProtoStats::Histogram   histogram;
+};  // end class Recorder
+
+static bool RunThreads(const double* sampleList, unsigned int count, unsigned int numThreads, bool shared)
+{
+    ProtoStats::Histogram histogram;
+    if (!histogram.Init(1.0e-06, 100.0)) return false;
+    Recorder* recorderList = new Recorder[numThreads];
+    unsigned int share = count / numThreads;
+    ProtoTime startTime;
+    startTime.GetCurrentTime();
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        if (!recorderList[i].Init(sampleList + i * share, share, shared ? &histogram : NULL) ||
+            !recorderList[i].StartThread())
+        {
+            fprintf(stderr, "statsExample: unable to start recorder thread\n");
+            delete[] recorderList;
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        recorderList[i].StopThread();  // (joins the thread)
+        if (!shared) histogram.Merge(recorderList[i].GetHistogram());
+    }
+    ProtoTime stopTime;
+    stopTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(stopTime, startTime);
+    printf("%u threads, %s: %llu samples, %.1f nsec/sample, p50 %.3f p99 %.3f msec\n",
+           numThreads, shared ? "shared histogram   " : "per-thread + merge ",
+           (unsigned long long)histogram.GetCount(), 1.0e+09 * elapsed / histogram.GetCount(),
+           1.0e+03 * histogram.GetQuantile(0.50), 1.0e+03 * histogram.GetQuantile(0.99));
+    delete[] recorderList;
+    return true;
+}  // end RunThreads()
+
+int main(int argc, char* argv[])
+{
+    unsigned int sampleCount = (argc > 1) ? atoi(argv[1]) : 4000000;
+    unsigned int numThreads = (argc > 2) ? atoi(argv[2]) : 4;
+    if (0 == sampleCount) sampleCount = 1;
+    if (0 == numThreads) numThreads = 1;
+    double* sampleList = new double[sampleCount];
+    FillSamples(sampleList, sampleCount);
+
+    ProtoTime t0, t1;
+    ProtoStats::Summary summary;
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < sampleCount; i++)
+        summary.Add(sampleList[i]);
+    t1.GetCurrentTime();
+    printf("Summary:   %.1f nsec/sample, count %lu min %.3f mean %.3f max %.3f stddev %.3f msec\n",
+           1.0e+09 * ProtoTime::Delta(t1, t0) / sampleCount, summary.GetCount(),
+           1.0e+03 * summary.GetMin(), 1.0e+03 * summary.GetMean(),
+           1.0e+03 * summary.GetMax(), 1.0e+03 * summary.GetStdDev());
+
+    ProtoStats::Ewma ewma;
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < sampleCount; i++)
+        ewma.Add(sampleList[i]);
+    t1.GetCurrentTime();
+    printf("Ewma:      %.1f nsec/sample, mean %.3f stddev %.3f msec\n",
+           1.0e+09 * ProtoTime::Delta(t1, t0) / sampleCount,
+           1.0e+03 * ewma.GetMean(), 1.0e+03 * ewma.GetStdDev());
+
+    ProtoStats::Histogram histogram;
+    if (!histogram.Init(1.0e-06, 100.0))  // (1 usec to 100 sec, ~3% precision)
+    {
+        fprintf(stderr, "statsExample: histogram.Init() error\n");
+        return 1;
+    }
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < sampleCount; i++)
+        histogram.Record(sampleList[i]);
+    t1.GetCurrentTime();
+    printf("Histogram: %.1f nsec/sample, %u buckets (%lu bytes)\n",
+           1.0e+09 * ProtoTime::Delta(t1, t0) / sampleCount, histogram.GetBucketCount(),
+           (unsigned long)(histogram.GetBucketCount() * sizeof(uint64_t)));
+
+    const double quantileList[] = {0.5, 0.9, 0.99, 0.999};
+    const unsigned int QUANTILE_COUNT = sizeof(quantileList) / sizeof(double);
+    ProtoStats::Quantile estimatorList[QUANTILE_COUNT];
+    t0.GetCurrentTime();
+    for (unsigned int q = 0; q < QUANTILE_COUNT; q++)
+    {
+        estimatorList[q] = ProtoStats::Quantile(quantileList[q]);
+        for (unsigned int i = 0; i < sampleCount; i++)
+            estimatorList[q].Add(sampleList[i]);
+    }
+    t1.GetCurrentTime();
+    printf("Quantile:  %.1f nsec/sample (per quantile estimated)\n",
+           1.0e+09 * ProtoTime::Delta(t1, t0) / ((double)sampleCount * QUANTILE_COUNT));
+
+    double* sorted = new double[sampleCount];
+    for (unsigned int i = 0; i < sampleCount; i++) sorted[i] = sampleList[i];
+    qsort(sorted, sampleCount, sizeof(double), CompareDouble);
+    printf("quantile     exact   histogram (error)   P-square (error)   [msec]\n");
+    for (unsigned int q = 0; q < QUANTILE_COUNT; q++)
+    {
+        unsigned int index = (unsigned int)ceil(quantileList[q] * sampleCount) - 1;
+        double exact = sorted[index];
+        double hist = histogram.GetQuantile(quantileList[q]);
+        double p2 = estimatorList[q].GetValue();
+        printf("  %5.3f  %9.4f  %9.4f (%+5.2f%%)  %9.4f (%+5.2f%%)\n", quantileList[q],
+               1.0e+03 * exact, 1.0e+03 * hist, 100.0 * (hist - exact) / exact,
+               1.0e+03 * p2, 100.0 * (p2 - exact) / exact);
+    }
+    delete[] sorted;
+
+    bool result = RunThreads(sampleList, sampleCount, numThreads, false) &&
+                  RunThreads(sampleList, sampleCount, numThreads, true);
+    delete[] sampleList;
+    return result ? 0 : 1;
+}  // end main()
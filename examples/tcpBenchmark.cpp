@@ -0,0 +1,453 @@
+// This program measures ProtoTCPReassembler throughput for synthetic IPv4
+// and IPv6 TCP connections (with segments reordered and interleaved across
+// connections, some retransmitted and some overlapping) and validates the
+// reconstructed byte streams.  It also checks gap skipping and eviction
+// under a small memory cap and idle timeout of unfinished connections.
+
+// Usage: tcpBenchmark [<numConnections> [<rounds>]]
+
+#include "protoTCPReassembler.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), rand()
+#include <string.h>  // for memset()
+
+// Synthetic TCP traffic held in one buffer
+class SegmentSet
+{
+    public:
+        SegmentSet() : buffer(NULL), offset_list(NULL), length_list(NULL), count(0), words(0), bytes(0) {}
+        ~SegmentSet()
+        {
+            delete[] length_list;
+            delete[] offset_list;
+            delete[] buffer;
+        }
+        // Connections are opened in groups of "concurrency", with data segments
+        // reordered within "window" and FINs sent only if "finish" is set
+        bool Init(unsigned int numConnections, unsigned int concurrency, unsigned int window, bool finish);
+        unsigned int GetCount() const
+            {return count;}
+        UINT32* GetPacket(unsigned int index) const
+            {return (buffer + offset_list[index]);}
+        unsigned int GetLength(unsigned int index) const
+            {return length_list[index];}
+        unsigned long GetBytes() const
+            {return bytes;}
+
+        static unsigned int GetStreamLength(unsigned int n, unsigned int dir)
+            {return (0 == dir) ? (200 + ((n * 2654435761U) % 6000)) : (500 + ((n * 40503U) % 20000));}
+        static UINT8 GetStreamByte(unsigned int n, unsigned int dir, unsigned int i)
+            {return (UINT8)(n * 13 + dir * 101 + i + (i >> 8));}
+
+    private:
+        enum {FIN = 0x01, SYN = 0x02, ACK = 0x10};
+        static UINT32 GetISN(unsigned int n, unsigned int dir)  // (exercises sequence wrap)
+            {return (0 == dir) ? (0xfffff000 + n * 977) : (n * 104729);}
+        static unsigned int GetMSS(unsigned int n)
+            {return (0 == (n & 0x01)) ? 1460 : 1440;}
+        unsigned int GetSegmentCount(unsigned int n) const;
+        void AddSegment(unsigned int n, unsigned int dir, unsigned int offset, unsigned int length, UINT8 flags);
+        void AddData(unsigned int n, unsigned int& segment);
+        void Shuffle(unsigned int start, unsigned int end, unsigned int window);
+
+        UINT32*         buffer;
+        unsigned int*   offset_list;   // in UINT32 words
+        unsigned int*   length_list;
+        unsigned int    count;
+        unsigned long   words;
+        unsigned long   bytes;
+};  // end class SegmentSet
+
+void SegmentSet::AddSegment(unsigned int n, unsigned int dir, unsigned int offset, unsigned int length, UINT8 flags)
+{
+    UINT8* pkt = (UINT8*)(buffer + words);
+    unsigned int hdrLength;
+    UINT8 clientAddr[16], serverAddr[16];
+    if (0 == (n & 0x01))
+    {
+        // IPv4 (connection "n" is in the client address)
+        hdrLength = 20;
+        unsigned int total = hdrLength + 20 + length;
+        memset(pkt, 0, hdrLength);
+        pkt[0] = 0x45;
+        pkt[2] = (UINT8)(total >> 8);
+        pkt[3] = (UINT8)total;
+        pkt[8] = 64;
+        pkt[9] = ProtoPktIP::TCP;
+        clientAddr[0] = 10;
+        clientAddr[1] = (UINT8)(n >> 16);
+        clientAddr[2] = (UINT8)(n >> 8);
+        clientAddr[3] = (UINT8)n;
+        serverAddr[0] = 10;
+        serverAddr[1] = 255;
+        serverAddr[2] = 0;
+        serverAddr[3] = 1;
+        memcpy(pkt + 12, (0 == dir) ? clientAddr : serverAddr, 4);
+        memcpy(pkt + 16, (0 == dir) ? serverAddr : clientAddr, 4);
+    }
+    else
+    {
+        hdrLength = 40;
+        memset(pkt, 0, hdrLength);
+        pkt[0] = 0x60;
+        pkt[4] = (UINT8)((20 + length) >> 8);
+        pkt[5] = (UINT8)(20 + length);
+        pkt[6] = ProtoPktIP::TCP;
+        pkt[7] = 64;
+        memset(clientAddr, 0, 16);
+        memset(serverAddr, 0, 16);
+        clientAddr[0] = serverAddr[0] = 0x20;
+        clientAddr[1] = serverAddr[1] = 0x01;
+        clientAddr[13] = (UINT8)(n >> 16);
+        clientAddr[14] = (UINT8)(n >> 8);
+        clientAddr[15] = (UINT8)n;
+        serverAddr[15] = 1;
+        memcpy(pkt + 8, (0 == dir) ? clientAddr : serverAddr, 16);
+        memcpy(pkt + 24, (0 == dir) ? serverAddr : clientAddr, 16);
+    }
+    UINT8* tcp = pkt + hdrLength;
+    memset(tcp, 0, 20);
+    UINT16 clientPort = (UINT16)(40000 + (n % 20000));
+    UINT16 serverPort = 80;
+    UINT16 srcPort = (0 == dir) ? clientPort : serverPort;
+    UINT16 dstPort = (0 == dir) ? serverPort : clientPort;
+    UINT32 seq = GetISN(n, dir) + ((0 != (flags & SYN)) ? 0 : (1 + offset));
+    tcp[0] = (UINT8)(srcPort >> 8);
+    tcp[1] = (UINT8)srcPort;
+    tcp[2] = (UINT8)(dstPort >> 8);
+    tcp[3] = (UINT8)dstPort;
+    tcp[4] = (UINT8)(seq >> 24);
+    tcp[5] = (UINT8)(seq >> 16);
+    tcp[6] = (UINT8)(seq >> 8);
+    tcp[7] = (UINT8)seq;
+    tcp[12] = 0x50;
+    tcp[13] = flags;
+    for (unsigned int i = 0; i < length; i++)
+        tcp[20 + i] = GetStreamByte(n, dir, offset + i);
+    unsigned int pktLength = hdrLength + 20 + length;
+    offset_list[count] = words;
+    length_list[count++] = pktLength;
+    words += (pktLength + 3) / 4;
+    bytes += pktLength;
+}  // end SegmentSet::AddSegment()
+
+unsigned int SegmentSet::GetSegmentCount(unsigned int n) const
+{
+    // (data segments plus up to two extra per segment for retransmissions and overlaps)
+    unsigned int mss = GetMSS(n);
+    unsigned int numSegments = 4;  // SYN, SYN-ACK and FINs
+    for (unsigned int dir = 0; dir < 2; dir++)
+        numSegments += 3 * ((GetStreamLength(n, dir) + mss - 1) / mss);
+    return numSegments;
+}  // end SegmentSet::GetSegmentCount()
+
+// Adds connection "n" data segment number "segment" (alternating directions), with
+// some retransmitted and some overlapping
+void SegmentSet::AddData(unsigned int n, unsigned int& segment)
+{
+    unsigned int mss = GetMSS(n);
+    unsigned int dir = segment & 0x01;
+    unsigned int offset = (segment >> 1) * mss;
+    unsigned int length = GetStreamLength(n, dir);
+    if (offset < length)
+    {
+        unsigned int segLength = ((length - offset) > mss) ? mss : (length - offset);
+        AddSegment(n, dir, offset, segLength, ACK);
+        if (0 == ((n + segment) % 10))
+            AddSegment(n, dir, offset, segLength, ACK);  // retransmission
+        if ((0 == ((n + segment) % 7)) && (offset >= 100))
+            AddSegment(n, dir, offset - 100, segLength / 2 + 100, ACK);  // overlap
+    }
+    segment++;
+}  // end SegmentSet::AddData()
+
+void SegmentSet::Shuffle(unsigned int start, unsigned int end, unsigned int window)
+{
+    for (unsigned int i = start; (window > 1) && (i < end); i++)
+    {
+        unsigned int j = i + ((unsigned int)rand() % window);
+        if (j >= end) continue;
+        unsigned int tmp = offset_list[i];
+        offset_list[i] = offset_list[j];
+        offset_list[j] = tmp;
+        tmp = length_list[i];
+        length_list[i] = length_list[j];
+        length_list[j] = tmp;
+    }
+}  // end SegmentSet::Shuffle()
+
+bool SegmentSet::Init(unsigned int numConnections, unsigned int concurrency, unsigned int window, bool finish)
+{
+    unsigned int maxSegments = 0;
+    for (unsigned int n = 0; n < numConnections; n++)
+        maxSegments += GetSegmentCount(n);
+    buffer = new UINT32[(unsigned long)maxSegments * ((40 + 20 + 1460 + 3) / 4)];
+    offset_list = new unsigned int[maxSegments];
+    length_list = new unsigned int[maxSegments];
+    count = words = 0;
+    bytes = 0;
+    unsigned int* segment = new unsigned int[concurrency];
+    for (unsigned int first = 0; first < numConnections; first += concurrency)
+    {
+        unsigned int last = first + concurrency;
+        if (last > numConnections) last = numConnections;
+        for (unsigned int n = first; n < last; n++)
+        {
+            AddSegment(n, 0, 0, 0, SYN);
+            AddSegment(n, 1, 0, 0, SYN | ACK);
+            segment[n - first] = 0;
+        }
+        // Interleave data segments across the group, then reorder them
+        unsigned int dataStart = count;
+        bool more = true;
+        while (more)
+        {
+            more = false;
+            for (unsigned int n = first; n < last; n++)
+            {
+                unsigned int mss = GetMSS(n);
+                unsigned int maxLength = GetStreamLength(n, 1) > GetStreamLength(n, 0) ?
+                                            GetStreamLength(n, 1) : GetStreamLength(n, 0);
+                if (((segment[n - first] >> 1) * mss) >= maxLength) continue;
+                AddData(n, segment[n - first]);
+                more = true;
+            }
+        }
+        Shuffle(dataStart, count, window);
+        for (unsigned int n = first; finish && (n < last); n++)
+        {
+            AddSegment(n, 0, GetStreamLength(n, 0), 0, FIN | ACK);
+            AddSegment(n, 1, GetStreamLength(n, 1), 0, FIN | ACK);
+        }
+    }
+    delete[] segment;
+    return true;
+}  // end SegmentSet::Init()
+
+// Checks delivered stream data against the original content
+class StreamChecker
+{
+    public:
+        StreamChecker(unsigned int numConnections)
+         : open_count(0), close_count(0), timeout_count(0), evict_count(0),
+           gap_bytes(0), bad_count(0),
+           state_list(new State[numConnections]), num_connections(numConnections)
+        {
+            memset(state_list, 0, numConnections * sizeof(State));
+        }
+        ~StreamChecker()
+            {delete[] state_list;}
+
+        void OnStreamEvent(ProtoTCPReassembler::Connection& connection, ProtoTCPReassembler::Event event,
+                           ProtoTCPReassembler::Direction dir, const char* data, unsigned int length);
+
+        // Returns number of connections whose streams were not fully delivered
+        unsigned int GetIncompleteCount() const;
+
+        unsigned int    open_count;
+        unsigned int    close_count;
+        unsigned int    timeout_count;
+        unsigned int    evict_count;
+        unsigned long   gap_bytes;
+        unsigned int    bad_count;
+
+    private:
+        struct State
+        {
+            unsigned int    n;
+            unsigned int    offset[2];
+            bool            opened;
+        };
+        State*          state_list;
+        unsigned int    num_connections;
+};  // end class StreamChecker
+
+void StreamChecker::OnStreamEvent(ProtoTCPReassembler::Connection& connection, ProtoTCPReassembler::Event event,
+                                  ProtoTCPReassembler::Direction dir, const char* data, unsigned int length)
+{
+    State* state = (State*)connection.GetUserData();
+    switch (event)
+    {
+        case ProtoTCPReassembler::EVENT_OPEN:
+        {
+            open_count++;
+            ProtoAddress clientAddr, serverAddr;
+            connection.GetClientAddr(clientAddr);
+            connection.GetServerAddr(serverAddr);
+            const UINT8* ptr = (const UINT8*)clientAddr.GetRawHostAddress() + clientAddr.GetLength() - 3;
+            unsigned int n = ((unsigned int)ptr[0] << 16) | ((unsigned int)ptr[1] << 8) | ptr[2];
+            if ((n >= num_connections) || (80 != serverAddr.GetPort()))
+            {
+                bad_count++;
+                break;
+            }
+            // (an evicted connection picked up again mid-stream is not checked)
+            if (state_list[n].opened) break;
+            state = state_list + n;
+            state->n = n;
+            state->opened = true;
+            connection.SetUserData(state);
+            break;
+        }
+        case ProtoTCPReassembler::EVENT_DATA:
+            if (NULL == state) break;
+            for (unsigned int i = 0; i < length; i++)
+            {
+                if ((UINT8)data[i] != SegmentSet::GetStreamByte(state->n, dir, state->offset[dir] + i))
+                {
+                    bad_count++;
+                    break;
+                }
+            }
+            state->offset[dir] += length;
+            if (state->offset[dir] > SegmentSet::GetStreamLength(state->n, dir)) bad_count++;
+            break;
+        case ProtoTCPReassembler::EVENT_GAP:
+            if (NULL == state) break;
+            state->offset[dir] += length;
+            gap_bytes += length;
+            break;
+        case ProtoTCPReassembler::EVENT_CLOSE:
+            close_count++;
+            break;
+        case ProtoTCPReassembler::EVENT_TIMEOUT:
+            timeout_count++;
+            break;
+        case ProtoTCPReassembler::EVENT_EVICT:
+            evict_count++;
+            break;
+        default:
+            bad_count++;
+            break;
+    }
+}  // end StreamChecker::OnStreamEvent()
+
+unsigned int StreamChecker::GetIncompleteCount() const
+{
+    unsigned int incompleteCount = 0;
+    for (unsigned int n = 0; n < num_connections; n++)
+    {
+        if ((state_list[n].offset[0] != SegmentSet::GetStreamLength(n, 0)) ||
+            (state_list[n].offset[1] != SegmentSet::GetStreamLength(n, 1)))
+            incompleteCount++;
+    }
+    return incompleteCount;
+}  // end StreamChecker::GetIncompleteCount()
+
+// Counts delivered bytes only (for throughput measurement)
+class ByteCounter
+{
+    public:
+        ByteCounter() : byte_count(0) {}
+        void OnStreamEvent(ProtoTCPReassembler::Connection& /*connection*/, ProtoTCPReassembler::Event event,
+                           ProtoTCPReassembler::Direction /*dir*/, const char* /*data*/, unsigned int length)
+            {if (ProtoTCPReassembler::EVENT_DATA == event) byte_count += length;}
+        unsigned long   byte_count;
+};  // end class ByteCounter
+
+static void RunSegments(ProtoTCPReassembler& reassembler, const SegmentSet& segmentSet, const ProtoTime& pktTime)
+{
+    ProtoPktIP ipPkt;
+    for (unsigned int i = 0; i < segmentSet.GetCount(); i++)
+    {
+        ipPkt.InitFromBuffer(segmentSet.GetLength(i), segmentSet.GetPacket(i), segmentSet.GetLength(i));
+        reassembler.Process(ipPkt, pktTime);
+    }
+}  // end RunSegments()
+
+int main(int argc, char* argv[])
+{
+    unsigned int numConnections = (argc > 1) ? atoi(argv[1]) : 5000;
+    unsigned int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+    if (numConnections < 100) numConnections = 100;
+    if (0 == rounds) rounds = 1;
+    srand(1);
+    ProtoTime pktTime;
+    pktTime.GetCurrentTime();
+
+    SegmentSet segmentSet;
+    segmentSet.Init(numConnections, 256, 32, true);
+    printf("%u connections (IPv4 and IPv6), %u segments, %.1lf MB\n",
+           numConnections, segmentSet.GetCount(), 1.0e-06 * segmentSet.GetBytes());
+
+    // 1) Validate reconstructed streams (default limits)
+    ProtoTCPReassembler reassembler;
+    if (!reassembler.Open())
+    {
+        fprintf(stderr, "tcpBenchmark: reassembler.Open() error\n");
+        return -1;
+    }
+    StreamChecker checker(numConnections);
+    reassembler.SetListener(&checker, &StreamChecker::OnStreamEvent);
+    RunSegments(reassembler, segmentSet, pktTime);
+    unsigned int incompleteCount = checker.GetIncompleteCount();
+    if ((checker.open_count != numConnections) || (checker.close_count != numConnections) ||
+        (0 != checker.bad_count) || (0 != checker.gap_bytes) || (0 != incompleteCount) ||
+        (0 != reassembler.GetConnectionCount()) || (0 != reassembler.GetBlockCount()))
+    {
+        fprintf(stderr, "tcpBenchmark: validation FAILED (%u opened, %u closed, %u bad, %lu gap bytes, %u incomplete)\n",
+                checker.open_count, checker.close_count, checker.bad_count, checker.gap_bytes, incompleteCount);
+        return -1;
+    }
+    printf("validation passed (%lu out of order, %lu retransmitted/overlapping segments)\n",
+           reassembler.GetOutOfOrderCount(), reassembler.GetOverlapCount());
+
+    // 2) Throughput
+    ByteCounter counter;
+    reassembler.SetListener(&counter, &ByteCounter::OnStreamEvent);
+    ProtoTime startTime, endTime;
+    startTime.GetCurrentTime();
+    for (unsigned int r = 0; r < rounds; r++)
+        RunSegments(reassembler, segmentSet, pktTime);
+    endTime.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(endTime, startTime);
+    printf("reassembly: %.2lf Msegments/sec, %.2lf Gbps (%.0lf nsec/segment, %.1lf MB delivered)\n",
+           1.0e-06 * rounds * segmentSet.GetCount() / elapsed,
+           8.0e-09 * rounds * segmentSet.GetBytes() / elapsed,
+           1.0e+09 * elapsed / ((double)rounds * segmentSet.GetCount()),
+           1.0e-06 * counter.byte_count);
+
+    // 3) Small limits (heavier reordering, gaps skipped and connections evicted)
+    SegmentSet wideSet;
+    wideSet.Init(numConnections, 256, 512, true);
+    ProtoTCPReassembler smallReassembler;
+    smallReassembler.Open(128, 16*1024, 256*1024);
+    StreamChecker smallChecker(numConnections);
+    smallReassembler.SetListener(&smallChecker, &StreamChecker::OnStreamEvent);
+    RunSegments(smallReassembler, wideSet, pktTime);
+    smallReassembler.Flush();
+    printf("small limits: %u of %u closed, %lu gaps (%lu bytes), %lu evicted\n",
+           smallChecker.close_count, numConnections, smallReassembler.GetGapCount(),
+           smallChecker.gap_bytes, smallReassembler.GetEvictCount());
+    if ((0 != smallChecker.bad_count) || (0 == smallReassembler.GetGapCount()) ||
+        (0 == smallReassembler.GetEvictCount()) || (0 != smallReassembler.GetBlockCount()) ||
+        (smallChecker.open_count != (smallChecker.close_count + smallChecker.evict_count +
+                                     smallChecker.timeout_count)))
+    {
+        fprintf(stderr, "tcpBenchmark: small limits test FAILED (%u bad)\n", smallChecker.bad_count);
+        return -1;
+    }
+
+    // 4) Idle timeout of unfinished connections (no FINs)
+    SegmentSet openSet;
+    openSet.Init(100, 100, 16, false);
+    ProtoTCPReassembler idleReassembler;
+    idleReassembler.Open();
+    StreamChecker idleChecker(100);
+    idleReassembler.SetListener(&idleChecker, &StreamChecker::OnStreamEvent);
+    RunSegments(idleReassembler, openSet, pktTime);
+    unsigned int openCount = idleReassembler.GetConnectionCount();
+    idleReassembler.Expire(pktTime, 30.0);  // (none idle yet)
+    ProtoTime laterTime = pktTime;
+    laterTime += 60.0;
+    idleReassembler.Expire(laterTime, 30.0);
+    printf("timeout: %u open, %u timed out\n", openCount, idleChecker.timeout_count);
+    if ((100 != openCount) || (100 != idleChecker.timeout_count) ||
+        (0 != idleReassembler.GetConnectionCount()) || (0 != idleChecker.GetIncompleteCount()))
+    {
+        fprintf(stderr, "tcpBenchmark: timeout test FAILED\n");
+        return -1;
+    }
+    return 0;
+}  // end main()
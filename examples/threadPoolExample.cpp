@@ -0,0 +1,204 @@
+// This program illustrates ProtoThreadPool by running the same CPU-bound
+// jobs (counting primes) first inline in ProtoDispatcher timer callbacks and
+// then offloaded to a thread pool with completions delivered back to the
+// dispatcher.  A 1 msec "tick" timer runs throughout, and how late it fires
+// shows how much the jobs block the dispatcher.
+
+// Usage: threadPoolExample [<jobCount> [<primeLimit> [<threads>]]]
+
+#include "protoThreadPool.h"
+#include "protoDispatcher.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi()
+
+class PrimeTask : public ProtoThreadPool::Task
+{
+    public:
+        PrimeTask() : limit(0), count(0) {}
+        void SetLimit(unsigned int primeLimit)
+            {limit = primeLimit;}
+        unsigned int GetCount() const
+            {return count;}
+        void Run()
+        {
+            count = 0;
+            for (unsigned int n = 2; n < limit; n++)
+            {
+                bool isPrime = true;
+                for (unsigned int d = 2; (d * d) <= n; d++)
+                {
+                    if (0 == (n % d))
+                    {
+                        isPrime = false;
+                        break;
+                    }
+                }
+                if (isPrime) count++;
+            }
+        }
+    private:
+        unsigned int    limit;
+        unsigned int    count;
+};  // end class PrimeTask
+
+class PoolExample
+{
+    public:
+        PoolExample(unsigned int jobCount, unsigned int primeLimit);
+        ~PoolExample();
+
+        bool Run(bool offload, unsigned int numThreads);
+
+    private:
+        bool OnTickTimeout(ProtoTimer& theTimer);
+        bool OnJobTimeout(ProtoTimer& theTimer);
+        void OnTaskComplete(ProtoThreadPool::Task& theTask);
+        void Report(bool offload);
+
+        ProtoDispatcher     dispatcher;
+        ProtoThreadPool     pool;
+        ProtoTimer          tick_timer;
+        ProtoTimer          job_timer;
+        PrimeTask*          task_list;
+        unsigned int        job_count;
+        unsigned int        job_index;      // next job to start
+        unsigned int        done_count;
+        unsigned int        busy_count;     // (submissions refused, retried)
+        bool                offload;
+        ProtoTime           start_time;
+        ProtoTime           last_tick;
+        unsigned long       tick_count;
+        double              late_sum;
+        double              late_max;
+};  // end class PoolExample
+
+PoolExample::PoolExample(unsigned int jobCount, unsigned int primeLimit)
+ : task_list(new PrimeTask[jobCount]), job_count(jobCount), job_index(0),
+   done_count(0), busy_count(0), offload(false), tick_count(0), late_sum(0.0), late_max(0.0)
+{
+    for (unsigned int i = 0; i < jobCount; i++)
+    {
+        task_list[i].SetLimit(primeLimit);
+        task_list[i].SetListener(this, &PoolExample::OnTaskComplete);
+    }
+    tick_timer.SetListener(this, &PoolExample::OnTickTimeout);
+    tick_timer.SetInterval(0.001);
+    tick_timer.SetRepeat(-1);
+    // Jobs arrive in bursts of a few at a time
+    job_timer.SetListener(this, &PoolExample::OnJobTimeout);
+    job_timer.SetInterval(0.005);
+    job_timer.SetRepeat(-1);
+    pool.SetNotifier(&dispatcher);
+}
+
+PoolExample::~PoolExample()
+{
+    pool.Close();
+    delete[] task_list;
+}
+
+bool PoolExample::Run(bool offloadJobs, unsigned int numThreads)
+{
+    offload = offloadJobs;
+    job_index = done_count = busy_count = 0;
+    tick_count = 0;
+    late_sum = late_max = 0.0;
+    if (offload)
+    {
+        if (!pool.Open(numThreads))
+        {
+            fprintf(stderr, "threadPoolExample: pool.Open() error\n");
+            return false;
+        }
+        pool.ResetStats();
+    }
+    start_time.GetCurrentTime();
+    last_tick = start_time;
+    dispatcher.ActivateTimer(tick_timer);
+    dispatcher.ActivateTimer(job_timer);
+    dispatcher.Run();
+    if (tick_timer.IsActive()) tick_timer.Deactivate();
+    if (job_timer.IsActive()) job_timer.Deactivate();
+    Report(offload);
+    if (offload) pool.Close();
+    return true;
+}  // end PoolExample::Run()
+
+bool PoolExample::OnTickTimeout(ProtoTimer& /*theTimer*/)
+{
+    ProtoTime now;
+    now.GetCurrentTime();
+    double late = ProtoTime::Delta(now, last_tick) - tick_timer.GetInterval();
+    if (late < 0.0) late = 0.0;
+    late_sum += late;
+    if (late > late_max) late_max = late;
+    tick_count++;
+    last_tick = now;
+    return true;
+}  // end PoolExample::OnTickTimeout()
+
+bool PoolExample::OnJobTimeout(ProtoTimer& /*theTimer*/)
+{
+    for (unsigned int i = 0; (i < 4) && (job_index < job_count); i++)
+    {
+        PrimeTask& task = task_list[job_index];
+        if (offload)
+        {
+            if (!pool.Submit(task))
+            {
+                busy_count++;  // (queues full, try again next time)
+                break;
+            }
+        }
+        else
+        {
+            task.Run();
+            done_count++;
+        }
+        job_index++;
+    }
+    if (job_index >= job_count)
+    {
+        job_timer.Deactivate();
+        if (done_count >= job_count) dispatcher.Stop();
+    }
+    return true;
+}  // end PoolExample::OnJobTimeout()
+
+void PoolExample::OnTaskComplete(ProtoThreadPool::Task& /*theTask*/)
+{
+    if (++done_count >= job_count) dispatcher.Stop();
+}  // end PoolExample::OnTaskComplete()
+
+void PoolExample::Report(bool offloadJobs)
+{
+    ProtoTime now;
+    now.GetCurrentTime();
+    double elapsed = ProtoTime::Delta(now, start_time);
+    printf("%s: %u jobs (%u primes each) in %.3f sec, tick lateness avg %.3f msec, max %.3f msec\n",
+           offloadJobs ? "offloaded" : "inline   ", done_count, task_list[0].GetCount(), elapsed,
+           (0 != tick_count) ? (1.0e+03 * late_sum / tick_count) : 0.0, 1.0e+03 * late_max);
+    if (offloadJobs && (0 != pool.GetCompleteCount()))
+    {
+        unsigned long completed = pool.GetCompleteCount();
+        printf("   %u threads: avg queue %.3f msec (max %.3f), avg run %.3f msec (max %.3f), "
+               "%lu steals, %u retries\n",
+               pool.GetThreadCount(),
+               1.0e+03 * pool.GetQueueTimeTotal() / completed, 1.0e+03 * pool.GetQueueTimeMax(),
+               1.0e+03 * pool.GetRunTimeTotal() / completed, 1.0e+03 * pool.GetRunTimeMax(),
+               pool.GetStealCount(), busy_count);
+    }
+}  // end PoolExample::Report()
+
+int main(int argc, char* argv[])
+{
+    unsigned int jobCount = (argc > 1) ? atoi(argv[1]) : 200;
+    unsigned int primeLimit = (argc > 2) ? atoi(argv[2]) : 100000;
+    unsigned int numThreads = (argc > 3) ? atoi(argv[3]) : 0;
+    if (0 == jobCount) jobCount = 1;
+    PoolExample example(jobCount, primeLimit);
+    if (!example.Run(false, numThreads)) return 1;
+    if (!example.Run(true, numThreads)) return 1;
+    return 0;
+}  // end main()
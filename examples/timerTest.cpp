@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>  // for clock()
 
 
 // Simple self-scaling linear/non-linear histogram (one-sided)
@@ -90,6 +91,9 @@ class TimerTestApp : public ProtoApp
       double        elapsed_sec;
       
       Histogram     histogram;
+      Histogram     jitter_histogram;  // |interval error| in microseconds
+      double        jitter_max;
+      clock_t       cpu_mark;
       
       unsigned int  report_count;
       int           timer_int_count;
@@ -105,7 +109,8 @@ class TimerTestApp : public ProtoApp
 
 void TimerTestApp::Usage()
 {
-    fprintf(stderr, "Usage: timerTest [help][precise][interval <timerInterval>][output <outFile>][timer_int_count <5secIntervalCount>]\n");
+    fprintf(stderr, "Usage: timerTest [help][precise][hires][spin <spinWindow>][interval <timerInterval>]\n"
+                    "                 [output <outFile>][timer_int_count <5secIntervalCount>]\n");
 }
 
 const char* const TimerTestApp::CMD_LIST[] =
@@ -115,6 +120,8 @@ const char* const TimerTestApp::CMD_LIST[] =
 	"-nanosleep",   // Linux only
     "-priority", 
     "-precise",
+    "-hires",       // high resolution dispatcher wait
+    "+spin",        // <spinWindow> seconds of spin before each timeout
 	"+output",
     "+timer_int_count", // number of 5 second report intervals
     "+debug",       // <debugLevel>
@@ -127,7 +134,8 @@ const char* const TimerTestApp::CMD_LIST[] =
 PROTO_INSTANTIATE_APP(TimerTestApp) 
 
 TimerTestApp::TimerTestApp()
-: first_timeout(true), report_count(0), timer_int_count(4), out_file(stdout)
+: first_timeout(true), report_count(0), timer_int_count(4), out_file(stdout),
+  use_nanosleep(false)
 {
     the_timer.SetListener(this, &TimerTestApp::OnTimeout);
     the_timer.SetInterval(1.0);
@@ -222,6 +230,7 @@ bool TimerTestApp::OnStartup(int argc, const char*const* argv)
     }
     
     histogram.Init(1000, 1.0);
+    jitter_histogram.Init(1000, 0.5);  // (finer resolution near zero)
 
 #ifdef LINUX    
     if (use_nanosleep)
@@ -260,6 +269,13 @@ bool TimerTestApp::OnStartup(int argc, const char*const* argv)
 
 void TimerTestApp::OnShutdown()
 {
+   if (!jitter_histogram.IsEmpty())
+   {
+       TRACE("timer jitter (usec): p50>%.1lf p90>%.1lf p99>%.1lf p99.9>%.1lf max>%.1lf\n",
+             jitter_histogram.Percentile(0.50), jitter_histogram.Percentile(0.90),
+             jitter_histogram.Percentile(0.99), jitter_histogram.Percentile(0.999),
+             jitter_max);
+   }
    histogram.Print(out_file);
    if (stdout != out_file) 
    {
@@ -340,6 +356,20 @@ bool TimerTestApp::OnCommand(const char* cmd, const char* val)
     {
         dispatcher.SetPreciseTiming(true);
     }
+    else if (!strncmp("hires", cmd, len))
+    {
+        dispatcher.SetHighResolution(true);
+    }
+    else if (!strncmp("spin", cmd, len))
+    {
+        float spinWindow;
+        if (1 != sscanf(val, "%e", &spinWindow))
+        {
+            PLOG(PL_ERROR, "TimerTestApp::OnCommand(spin) error: invalid argument\n");
+            return false;
+        }
+        dispatcher.SetSpinWindow((double)spinWindow);
+    }
     else if (!strncmp("interval", cmd, len))
     {
         float timerInterval;
@@ -397,6 +427,8 @@ void TimerTestApp::OnTimeout(ProtoTimer& /*theTimer*/)
         timeout_count = 0;
         delta_min = 1000.0;
         delta_max = 0.0;
+        jitter_max = 0.0;
+        cpu_mark = clock();
     }
     else
     {
@@ -405,6 +437,11 @@ void TimerTestApp::OnTimeout(ProtoTimer& /*theTimer*/)
         
         histogram.Tally(delta);
         
+        // Jitter is the error of each interval relative to the nominal one
+        double jitter = 1.0e+06 * fabs(delta - the_timer.GetInterval());
+        jitter_histogram.Tally(jitter);
+        if (jitter > jitter_max) jitter_max = jitter;
+        
         if (delta > delta_max)
             delta_max = delta;
         if (delta < delta_min)
@@ -421,8 +458,14 @@ void TimerTestApp::OnTimeout(ProtoTimer& /*theTimer*/)
             double ave = ave_sum / timeout_count;
             double var = (squ_sum - (ave_sum * ave)) / timeout_count;
             
+            clock_t cpuTime = clock();
+            double cpuUsage = 100.0 * ((double)(cpuTime - cpu_mark) / CLOCKS_PER_SEC) / elapsed_sec;
+            cpu_mark = cpuTime;
             TRACE("timer interval: ave>%lf min>%lf max>%lf var>%lf\n",
                     ave, delta_min, delta_max, var);
+            TRACE("timer jitter (usec): p50>%.1lf p99>%.1lf max>%.1lf cpu>%.1lf%%\n",
+                    jitter_histogram.Percentile(0.50), jitter_histogram.Percentile(0.99),
+                    jitter_max, cpuUsage);
             elapsed_sec = 0.0;
             if (timer_int_count == ++report_count) Stop();
             
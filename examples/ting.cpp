@@ -5,6 +5,7 @@
 #include <protoPkt.h>
 #include <protoQueue.h>
 #include <protoNet.h>
+#include <protoStats.h>
 
 #include <stdio.h>   // for stdout/stderr printouts
 #include <string.h>
@@ -1247,6 +1248,15 @@ bool TingSession::OnSessionTimeout(ProtoTimer& theTimer)
 }  // end TingSession::OnSessionTimeout()
 
 
+// Prints "<label>: min>x ave>y max>z" (or "<label>: undetermined")
+static void PrintStats(FILE* filePtr, const char* label, const ProtoStats::Summary& stats, const char* separator)
+{
+    if (stats.GetCount() > 0)
+        fprintf(filePtr, "%s: min>%f ave>%f max>%f%s", label, stats.GetMin(), stats.GetMean(), stats.GetMax(), separator);
+    else
+        fprintf(filePtr, "%s: undetermined%s", label, separator);
+}  // end PrintStats()
+
 void TingSession::Summarize()
 {
     // Summarize my observations
@@ -1254,14 +1264,8 @@ void TingSession::Summarize()
     TingObservation* obs;
     
     ProtoAddress currentAddr;
-    double offsetMin = 0.0;
-    double offsetMax = 0.0;
-    double offsetSum = 0.0;
-    unsigned int offsetCount = 0;
-    double rttMin = 0.0;
-    double rttMax = 0.0;
-    double rttSum = 0.0;
-    unsigned int rttCount = 0;
+    ProtoStats::Summary offsetStats;
+    ProtoStats::Summary rttStats;
     while (NULL != (obs = iterator.GetNextItem()))
     {
         // Skip local addresses
@@ -1270,25 +1274,10 @@ void TingSession::Summarize()
         if (!currentAddr.IsEqual(obs->GetAddress()))
         {
             fprintf(log_file, "host %s/%hu ", currentAddr.GetHostString(), currentAddr.GetPort());
-            if (offsetCount > 0)
-            {
-                double offsetAve = offsetSum / (double)offsetCount;
-                fprintf(log_file, "offset: min>%f ave>%f max>%f ", offsetMin, offsetAve, offsetMax);
-            }
-            else
-            {
-                fprintf(log_file, "offset: undetermined ");
-            }
-            if (rttCount > 0)
-            {
-                double rttAve = rttSum / (double)rttCount;
-                fprintf(log_file, "rtt: min>%f ave>%f max>%f\n", rttMin, rttAve, rttMax);
-            }
-            else
-            {
-                fprintf(log_file, "rtt: undetermined\n");
-            }
-            rttCount = offsetCount = 0;
+            PrintStats(log_file, "offset", offsetStats, " ");
+            PrintStats(log_file, "rtt", rttStats, "\n");
+            rttStats.Reset();
+            offsetStats.Reset();
             currentAddr = obs->GetAddress();
         }
         
@@ -1297,59 +1286,17 @@ void TingSession::Summarize()
             double rtt = obs->GetRtt();
             if (rtt >= 0.0)
             {
-                // update rtt tracking
-                if (rttCount > 0)
-                {
-                    if (rtt < rttMin) 
-                        rttMin = rtt;
-                    else if (rtt > rttMax)
-                        rttMax = rtt;
-                    rttSum += rtt;
-                }
-                else
-                {
-                    rttMin = rttMax = rttSum = obs->GetRtt();
-                }
-                rttCount++;
-                // update offset tracking
+                rttStats.Add(rtt);
                 double offset = ProtoTime(obs->GetObservedTime()) - ProtoTime(obs->GetReferenceTime()) - (rtt / 2.0);
-                if (offsetCount > 0)
-                {
-                    if (offset < offsetMin)
-                        offsetMin = offset;
-                    else if (offset > offsetMax)
-                        offsetMax = offset;
-                    offsetSum += offset;
-                }
-                else
-                {
-                    offsetMin = offsetMax = offsetSum = offset;
-                }
-                offsetCount++;
+                offsetStats.Add(offset);
             }
         }
     }
     if (currentAddr.IsValid())
     {
         fprintf(log_file, "host %s/%hu ", currentAddr.GetHostString(), currentAddr.GetPort());
-        if (offsetCount > 0)
-        {
-            double offsetAve = offsetSum / (double)offsetCount;
-            fprintf(log_file, "offset: min>%f ave>%f max>%f ", offsetMin, offsetAve, offsetMax);
-        }
-        else
-        {
-            fprintf(log_file, "offset: undetermined ");
-        }
-        if (rttCount > 0)
-        {
-            double rttAve = rttSum / (double)rttCount;
-            fprintf(log_file, "rtt: min>%f ave>%f max>%f\n", rttMin, rttAve, rttMax);
-        }
-        else
-        {
-            fprintf(log_file, "rtt: undetermined\n");
-        }
+        PrintStats(log_file, "offset", offsetStats, " ");
+        PrintStats(log_file, "rtt", rttStats, "\n");
     }
     
     // Summarize based on mutual observations (i.e. multicast ting)
@@ -1362,7 +1309,7 @@ void TingSession::Summarize()
         if (local_address_list.Contains(observerAddr)) continue;
         
         //fprintf(log_file, "Summarizing observer %s/%hu ...\n", observerAddr.GetHostString(), observerAddr.GetPort());
-        offsetCount = 0;
+        offsetStats.Reset();
         // Find observations of common reference(s) and compute offset
         TingObserver::Iterator it1(*observer);
         TingObservation* obs1;
@@ -1381,65 +1328,21 @@ void TingSession::Summarize()
                 // Common observation, so compute offset time
                 // (offset = my observed time minus their observed time)
                 double offset = ProtoTime(obs2->GetObservedTime()) - ProtoTime(obs1->GetObservedTime());
-                if (offsetCount > 0)
-                {
-                    if (offset < offsetMin)
-                        offsetMin = offset;
-                    else if (offset > offsetMax)
-                        offsetMax = offset;
-                    offsetSum += offset;
-                }
-                else
-                {
-                    offsetMin = offsetMax = offsetSum = offset;
-                }
-                offsetCount++;
+                offsetStats.Add(offset);
                 break;
             }
         }
         fprintf(log_file, "host %s/%hu ", observerAddr.GetHostString(), observerAddr.GetPort());
-        if (offsetCount > 0)
-        {
-            double offsetAve = offsetSum / (double)offsetCount;
-            fprintf(log_file, "RBS offset: min>%f ave>%f max>%f ", offsetMin, offsetAve, offsetMax);
-        }
-        else
-        {
-            fprintf(log_file, "RBS offset: undetermined ");
-        }
+        PrintStats(log_file, "RBS offset", offsetStats, " ");
         // Have I been able to measure RTT to this observer?
-        rttCount = 0;
+        rttStats.Reset();
         iterator.Reset(&observerAddr);
         while (NULL != (obs = iterator.GetNextItem()))
         {
             double rtt = obs->GetRtt();
-            if (rtt >= 0.0)
-            {
-                // update rtt tracking
-                if (rttCount > 0)
-                {
-                    if (rtt < rttMin) 
-                        rttMin = rtt;
-                    else if (rtt > rttMax)
-                        rttMax = rtt;
-                    rttSum += rtt;
-                }
-                else
-                {
-                    rttMin = rttMax = rttSum = obs->GetRtt();
-                }
-                rttCount++;
-            }
-        }
-        if (rttCount > 0)
-        {
-            double rttAve = rttSum / (double)rttCount;
-            fprintf(log_file, "rtt: min>%f ave>%f max>%f\n", rttMin, rttAve, rttMax);
-        }
-        else
-        {
-            fprintf(log_file, "rtt: undetermined\n");
+            if (rtt >= 0.0) rttStats.Add(rtt);
         }
+        PrintStats(log_file, "rtt", rttStats, "\n");
     }
 }  // end TingSession::Summarize()
 
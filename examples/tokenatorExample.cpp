@@ -1,9 +1,57 @@
 
 #include "protoString.h"
 #include "protoDefs.h"  // for PATH_MAX
+#include "protoTime.h"
 #include <ctype.h>
 #include <string.h>
 
+// Times tokenizing a line of text "count" times with the allocating
+// GetNextItem(detach=true), the buffer-reusing GetNextItem() and the
+// zero-copy GetNextSpan()
+static void Benchmark(const char* text, const char* delimiters, unsigned int count)
+{
+    ProtoTokenator tk(text);
+    tk.SetDelimiters(delimiters);
+    unsigned long total[3] = {0, 0, 0};  // (total item lengths)
+    double elapsed[3];
+    for (int mode = 0; mode < 3; mode++)
+    {
+        ProtoTime startTime;
+        startTime.GetCurrentTime();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            tk.Reset();
+            const char* item;
+            unsigned int length;
+            switch (mode)
+            {
+                case 0:
+                    while (NULL != (item = tk.GetNextItem(true)))
+                    {
+                        total[mode] += strlen(item);
+                        delete[] item;
+                    }
+                    break;
+                case 1:
+                    while (NULL != (item = tk.GetNextItem()))
+                        total[mode] += strlen(item);
+                    break;
+                case 2:
+                    while (tk.GetNextSpan(item, length))
+                        total[mode] += length;
+                    break;
+            }
+        }
+        ProtoTime stopTime;
+        stopTime.GetCurrentTime();
+        elapsed[mode] = ProtoTime::Delta(stopTime, startTime);
+    }
+    double mbytes = (double)strlen(text) * count / (1024.0 * 1024.0);
+    printf("delimiters \"%s\": detach %.1f MB/s, reuse %.1f MB/s, span %.1f MB/s (%s)\n",
+           delimiters, mbytes / elapsed[0], mbytes / elapsed[1], mbytes / elapsed[2],
+           ((total[0] == total[1]) && (total[1] == total[2])) ? "match" : "MISMATCH");
+}  // end Benchmark()
+
 int main(int argc, char* argv[])
 {
     const char* text1 = " trains, ,planes, motorcycles  , trucks, cars";
@@ -87,4 +135,22 @@ int main(int argc, char* argv[])
         printf("path: \"%s\" dirname: \"%s\" basename: \"%s\"\n", thePath, dirname, basename);
     }
     
+    // Multiple delimiters can be set, e.g. for comma and/or semicolon separated lists
+    printf("\nComma/semicolon-delimited, stripped tokenization of:\n    \"%s\"\n", text1);
+    tk.Reset(text1);
+    tk.SetDelimiters(",;");
+    const char* span;
+    unsigned int spanLen;
+    // (GetNextSpan() returns pointers into the text rather than allocated copies)
+    while (tk.GetNextSpan(span, spanLen))
+        printf("\"%.*s\"\n", (int)spanLen, span);
+    
+    // Tokenizer throughput for a typical command / address list line
+    printf("\n");
+    const char* benchText = "addr 192.168.1.1/24, 10.0.0.1/8; fe80::1/64 , 172.16.0.1/12 "
+                            "cmd -interface eth0 -port 5000 -ttl 32 -rate 1.0e+06 -log /tmp/out.log";
+    Benchmark(benchText, " ", 200000);
+    Benchmark(benchText, ",", 200000);
+    Benchmark(benchText, " ,;", 200000);
+
 }  // end main()
@@ -0,0 +1,198 @@
+// This program illustrates ProtoTrace.  It measures the cost of recording a
+// trace event, then traces a ProtoDispatcher loop for a few seconds in which
+// a timer sends UDP packets over the loopback interface to a receiving socket
+// whose handler "parses" each packet (an application trace span with a
+// counter).  The binary trace file is written and converted to Chrome trace
+// event JSON (open it with ui.perfetto.dev or chrome://tracing).  Build the
+// library with USE_PROTO_TRACE (e.g. cmake -DPROTOKIT_TRACE=ON) to enable the
+// built-in dispatcher, timer and socket trace points.
+
+// Usage: traceExample [<seconds> [<traceFile>]]
+//        traceExample convert <traceFile> <jsonFile>
+
+#include "protoTrace.h"
+#include "protoDispatcher.h"
+#include "protoSocket.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atof()
+#include <string.h>     // for strcmp(), strlen()
+
+class TraceExample
+{
+    public:
+        TraceExample(ProtoDispatcher& theDispatcher);
+        bool Start(double duration);
+        void Stop();
+
+        unsigned long GetSendCount() const
+            {return send_count;}
+        unsigned long GetRecvCount() const
+            {return recv_count;}
+
+    private:
+        bool OnSendTimeout(ProtoTimer& theTimer);
+        bool OnStopTimeout(ProtoTimer& theTimer);
+        void OnRecvSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent);
+        void ParsePacket(const char* buffer, unsigned int numBytes);
+
+        ProtoDispatcher&    dispatcher;
+        ProtoTimer          send_timer;
+        ProtoTimer          stop_timer;
+        ProtoSocket         tx_socket;
+        ProtoSocket         rx_socket;
+        ProtoAddress        dst_addr;
+        unsigned long       send_count;
+        unsigned long       recv_count;
+};  // end class TraceExample
+
+TraceExample::TraceExample(ProtoDispatcher& theDispatcher)
+ : dispatcher(theDispatcher), tx_socket(ProtoSocket::UDP), rx_socket(ProtoSocket::UDP),
+   send_count(0), recv_count(0)
+{
+    send_timer.SetListener(this, &TraceExample::OnSendTimeout);
+    send_timer.SetInterval(0.001);
+    send_timer.SetRepeat(-1);
+    stop_timer.SetListener(this, &TraceExample::OnStopTimeout);
+    stop_timer.SetRepeat(0);
+    tx_socket.SetNotifier(&dispatcher);
+    rx_socket.SetNotifier(&dispatcher);
+    rx_socket.SetListener(this, &TraceExample::OnRecvSocketEvent);
+}
+
+bool TraceExample::Start(double duration)
+{
+    if (!rx_socket.Open(0, ProtoAddress::IPv4) || !tx_socket.Open(0, ProtoAddress::IPv4))
+    {
+        fprintf(stderr, "traceExample: socket open error\n");
+        return false;
+    }
+    dst_addr.ResolveFromString("127.0.0.1");
+    dst_addr.SetPort(rx_socket.GetPort());
+    dispatcher.ActivateTimer(send_timer);
+    stop_timer.SetInterval(duration);
+    dispatcher.ActivateTimer(stop_timer);
+    return true;
+}  // end TraceExample::Start()
+
+void TraceExample::Stop()
+{
+    if (send_timer.IsActive()) send_timer.Deactivate();
+    if (stop_timer.IsActive()) stop_timer.Deactivate();
+    tx_socket.Close();
+    rx_socket.Close();
+}  // end TraceExample::Stop()
+
+bool TraceExample::OnSendTimeout(ProtoTimer& /*theTimer*/)
+{
+    // Send a short burst of packets of varying size
+    char buffer[1024];
+    memset(buffer, 0, sizeof(buffer));
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        unsigned int numBytes = 64 + ((send_count * 37) % (sizeof(buffer) - 64));
+        memcpy(buffer, &send_count, sizeof(send_count));
+        if (!tx_socket.SendTo(buffer, numBytes, dst_addr) || (0 == numBytes)) break;
+        send_count++;
+    }
+    return true;
+}  // end TraceExample::OnSendTimeout()
+
+bool TraceExample::OnStopTimeout(ProtoTimer& /*theTimer*/)
+{
+    dispatcher.Stop();
+    return false;
+}  // end TraceExample::OnStopTimeout()
+
+void TraceExample::OnRecvSocketEvent(ProtoSocket& theSocket, ProtoSocket::Event theEvent)
+{
+    if (ProtoSocket::RECV != theEvent) return;
+    char buffer[1024];
+    for (;;)
+    {
+        unsigned int numBytes = sizeof(buffer);
+        ProtoAddress srcAddr;
+        if (!theSocket.RecvFrom(buffer, numBytes, srcAddr) || (0 == numBytes)) break;
+        ParsePacket(buffer, numBytes);
+    }
+}  // end TraceExample::OnRecvSocketEvent()
+
+// Application code is traced with the same macros as the built-in trace points
+void TraceExample::ParsePacket(const char* buffer, unsigned int numBytes)
+{
+    PROTO_TRACE_SCOPE("example", "ParsePacket");
+    PROTO_TRACE_COUNTER("example", "packet size", numBytes);
+    unsigned int checksum = 0;
+    for (unsigned int i = 0; i < numBytes; i++)
+        checksum = (checksum * 31) + (unsigned char)buffer[i];
+    if (0 == checksum) PROTO_TRACE_INSTANT("example", "zero checksum");
+    if (0 == (++recv_count % 1000)) PROTO_TRACE_INSTANT("example", "1000 packets");
+}  // end TraceExample::ParsePacket()
+
+int main(int argc, char* argv[])
+{
+    if ((argc > 1) && (0 == strcmp(argv[1], "convert")))
+    {
+        if (argc != 4)
+        {
+            fprintf(stderr, "Usage: traceExample convert <traceFile> <jsonFile>\n");
+            return 1;
+        }
+        return (ProtoTrace::ConvertToJson(argv[2], argv[3]) ? 0 : 1);
+    }
+    double duration = (argc > 1) ? atof(argv[1]) : 2.0;
+    const char* tracePath = (argc > 2) ? argv[2] : "traceExample.ptrc";
+#ifndef USE_PROTO_TRACE
+    printf("traceExample: trace points not enabled (build with USE_PROTO_TRACE)\n");
+#endif // !USE_PROTO_TRACE
+
+    // 1) Cost of recording an event (the ring wraps many times)
+    const unsigned int BUFFER_EVENTS = 1 << 18;  // (enough for about 6 seconds of this example)
+    const unsigned int EVENT_COUNT = 2000000;
+    ProtoTrace::Start(BUFFER_EVENTS);
+    ProtoTime t0, t1;
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < EVENT_COUNT / 2; i++)
+    {
+        ProtoTrace::Record(ProtoTrace::EVENT_BEGIN, "example", "Benchmark");
+        ProtoTrace::Record(ProtoTrace::EVENT_END, "example", "Benchmark");
+    }
+    t1.GetCurrentTime();
+    ProtoTrace::Stop();
+    double activeCost = 1.0e+09 * ProtoTime::Delta(t1, t0) / EVENT_COUNT;
+    t0.GetCurrentTime();
+    for (unsigned int i = 0; i < EVENT_COUNT / 2; i++)
+    {
+        ProtoTrace::Record(ProtoTrace::EVENT_BEGIN, "example", "Benchmark");
+        ProtoTrace::Record(ProtoTrace::EVENT_END, "example", "Benchmark");
+    }
+    t1.GetCurrentTime();
+    double inactiveCost = 1.0e+09 * ProtoTime::Delta(t1, t0) / EVENT_COUNT;
+    printf("trace event cost: %.1f nsec (%.1f nsec when not tracing)\n", activeCost, inactiveCost);
+
+    // 2) Trace a dispatcher loop
+    ProtoDispatcher dispatcher;
+    TraceExample example(dispatcher);
+    if (!example.Start(duration)) return 1;
+    ProtoTrace::SetThreadName("main");
+    ProtoTrace::Start(BUFFER_EVENTS);
+    dispatcher.Run();
+    ProtoTrace::Stop();
+    example.Stop();
+    printf("sent %lu packets, received %lu packets\n", example.GetSendCount(), example.GetRecvCount());
+
+    if (!ProtoTrace::Write(tracePath)) return 1;
+    char jsonPath[PATH_MAX];
+    snprintf(jsonPath, PATH_MAX, "%s.json", tracePath);
+    if (!ProtoTrace::ConvertToJson(tracePath, jsonPath)) return 1;
+    FILE* filePtr = fopen(tracePath, "rb");
+    long traceSize = 0;
+    if (NULL != filePtr)
+    {
+        fseek(filePtr, 0, SEEK_END);
+        traceSize = ftell(filePtr);
+        fclose(filePtr);
+    }
+    printf("wrote %s (%ld bytes) and %s\n", tracePath, traceSize, jsonPath);
+    return 0;
+}  // end main()
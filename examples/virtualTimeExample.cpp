@@ -0,0 +1,207 @@
+// This program illustrates the ProtoDispatcher virtual time mode.  A number
+// of "nodes" each run MANET-style timers (jittered HELLO and TC intervals,
+// short retransmission timeouts and long neighbor hold timers) for a given
+// duration, first briefly in real time and then for the full duration in
+// virtual time, where the dispatcher jumps from one timeout to the next.
+// It also checks that a threaded dispatcher refuses virtual time.
+
+// Usage: virtualTimeExample [<nodeCount> [<seconds>]]
+
+#include "protoDispatcher.h"
+#include "protoTime.h"
+#include <stdio.h>
+#include <stdlib.h>     // for atoi(), rand()
+
+class Node
+{
+    public:
+        Node();
+        void Start(ProtoDispatcher& theDispatcher);
+        void Stop();
+
+        static unsigned long timeout_count;
+
+    private:
+        bool OnHelloTimeout(ProtoTimer& theTimer);
+        bool OnTcTimeout(ProtoTimer& theTimer);
+        bool OnRetransmitTimeout(ProtoTimer& theTimer);
+        bool OnHoldTimeout(ProtoTimer& theTimer);
+        static double Jitter(double interval)
+            {return interval * (0.75 + 0.25 * ((double)rand() / (double)RAND_MAX));}
+
+        ProtoDispatcher*    dispatcher;
+        ProtoTimer          hello_timer;
+        ProtoTimer          tc_timer;
+        ProtoTimer          retransmit_timer;
+        ProtoTimer          hold_timer;
+        unsigned int        retransmit_count;
+};  // end class Node
+
+unsigned long Node::timeout_count = 0;
+
+Node::Node()
+ : dispatcher(NULL), retransmit_count(0)
+{
+    hello_timer.SetListener(this, &Node::OnHelloTimeout);
+    hello_timer.SetRepeat(-1);
+    tc_timer.SetListener(this, &Node::OnTcTimeout);
+    tc_timer.SetRepeat(-1);
+    retransmit_timer.SetListener(this, &Node::OnRetransmitTimeout);
+    retransmit_timer.SetRepeat(-1);
+    hold_timer.SetListener(this, &Node::OnHoldTimeout);
+    hold_timer.SetInterval(30.0);  // (a "long" timer)
+    hold_timer.SetRepeat(0);
+}
+
+void Node::Start(ProtoDispatcher& theDispatcher)
+{
+    dispatcher = &theDispatcher;
+    hello_timer.SetInterval(Jitter(2.0));
+    dispatcher->ActivateTimer(hello_timer);
+    tc_timer.SetInterval(Jitter(5.0));
+    dispatcher->ActivateTimer(tc_timer);
+    dispatcher->ActivateTimer(hold_timer);
+}  // end Node::Start()
+
+void Node::Stop()
+{
+    if (hello_timer.IsActive()) hello_timer.Deactivate();
+    if (tc_timer.IsActive()) tc_timer.Deactivate();
+    if (retransmit_timer.IsActive()) retransmit_timer.Deactivate();
+    if (hold_timer.IsActive()) hold_timer.Deactivate();
+}  // end Node::Stop()
+
+bool Node::OnHelloTimeout(ProtoTimer& theTimer)
+{
+    timeout_count++;
+    // Hearing a neighbor refreshes the hold timer
+    if (hold_timer.IsActive())
+        hold_timer.Reschedule();
+    else
+        dispatcher->ActivateTimer(hold_timer);
+    theTimer.SetInterval(Jitter(2.0));
+    return true;
+}  // end Node::OnHelloTimeout()
+
+bool Node::OnTcTimeout(ProtoTimer& theTimer)
+{
+    timeout_count++;
+    // Some TC messages need acknowledgement, with a few retransmissions
+    if ((0 == (rand() % 4)) && !retransmit_timer.IsActive())
+    {
+        retransmit_count = 0;
+        retransmit_timer.SetInterval(0.1);
+        dispatcher->ActivateTimer(retransmit_timer);
+    }
+    theTimer.SetInterval(Jitter(5.0));
+    return true;
+}  // end Node::OnTcTimeout()
+
+bool Node::OnRetransmitTimeout(ProtoTimer& theTimer)
+{
+    timeout_count++;
+    if (++retransmit_count >= 3)
+    {
+        theTimer.Deactivate();
+        return false;
+    }
+    theTimer.SetInterval(2.0 * theTimer.GetInterval());  // (backoff)
+    return true;
+}  // end Node::OnRetransmitTimeout()
+
+bool Node::OnHoldTimeout(ProtoTimer& /*theTimer*/)
+{
+    timeout_count++;
+    return true;
+}  // end Node::OnHoldTimeout()
+
+class Scenario
+{
+    public:
+        Scenario(unsigned int nodeCount);
+        ~Scenario();
+        bool Run(bool virtualTime, double duration);
+
+    private:
+        bool OnStopTimeout(ProtoTimer& theTimer);
+
+        ProtoDispatcher     dispatcher;
+        ProtoTimer          stop_timer;
+        Node*               node_list;
+        unsigned int        node_count;
+};  // end class Scenario
+
+Scenario::Scenario(unsigned int nodeCount)
+ : node_list(new Node[nodeCount]), node_count(nodeCount)
+{
+    stop_timer.SetListener(this, &Scenario::OnStopTimeout);
+    stop_timer.SetRepeat(0);
+}
+
+Scenario::~Scenario()
+{
+    delete[] node_list;
+}
+
+bool Scenario::Run(bool virtualTime, double duration)
+{
+    srand(1);
+    Node::timeout_count = 0;
+    if (!dispatcher.SetVirtualTime(virtualTime))
+    {
+        fprintf(stderr, "virtualTimeExample: SetVirtualTime() error\n");
+        return false;
+    }
+    struct timeval startTime;
+    dispatcher.GetSystemTime(startTime);
+    ProtoTime wallStart;
+    wallStart.GetCurrentTime();
+    for (unsigned int i = 0; i < node_count; i++)
+        node_list[i].Start(dispatcher);
+    stop_timer.SetInterval(duration);
+    dispatcher.ActivateTimer(stop_timer);
+    dispatcher.Run();
+    for (unsigned int i = 0; i < node_count; i++)
+        node_list[i].Stop();
+    ProtoTime wallStop;
+    wallStop.GetCurrentTime();
+    struct timeval stopTime;
+    dispatcher.GetSystemTime(stopTime);
+    double elapsed = ProtoTime::Delta(ProtoTime(stopTime), ProtoTime(startTime));
+    double wallElapsed = ProtoTime::Delta(wallStop, wallStart);
+    printf("%s time: %u nodes, %.1f sec of timer activity (%lu timeouts) in %.3f sec (%.0fx real time)\n",
+           virtualTime ? "virtual" : "real   ", node_count, elapsed, Node::timeout_count,
+           wallElapsed, (wallElapsed > 0.0) ? (elapsed / wallElapsed) : 0.0);
+    dispatcher.SetVirtualTime(false);
+    return true;
+}  // end Scenario::Run()
+
+bool Scenario::OnStopTimeout(ProtoTimer& /*theTimer*/)
+{
+    dispatcher.Stop();
+    return false;
+}  // end Scenario::OnStopTimeout()
+
+int main(int argc, char* argv[])
+{
+    unsigned int nodeCount = (argc > 1) ? atoi(argv[1]) : 50;
+    double duration = (argc > 2) ? atof(argv[2]) : (4.0 * 3600.0);
+    if (0 == nodeCount) nodeCount = 1;
+    // Virtual time is only supported when the dispatcher is not threaded
+    ProtoDispatcher threaded;
+    if (!threaded.StartThread())
+    {
+        fprintf(stderr, "virtualTimeExample: StartThread() error\n");
+        return 1;
+    }
+    bool refused = !threaded.SetVirtualTime(true);
+    threaded.Stop();
+    if (!refused)
+    {
+        fprintf(stderr, "virtualTimeExample: error: threaded dispatcher accepted virtual time\n");
+        return 1;
+    }
+    Scenario scenario(nodeCount);
+    if (!scenario.Run(false, 5.0) || !scenario.Run(true, duration)) return 1;
+    return 0;
+}  // end main()
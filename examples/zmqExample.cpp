@@ -1,6 +1,7 @@
  
 #include "protoZMQ.h"
 #include "protoTimer.h"
+#include "protoTime.h"
 #include "protoApp.h"
 
 #include <stdio.h>  // for stderr output as needed
@@ -33,8 +34,30 @@ class ZmqExample : public ProtoApp
         bool OnTxTimeout(ProtoTimer& theTimer);
         void OnSocketEvent(ProtoEvent& theEvent);
         
+        // Ping-pong latency test over a pair of ZMQ_PAIR sockets, run
+        // first with the PollerThread and then in "direct" mode
+        bool StartLatencyTest(bool direct);
+        void StopLatencyTest();
+        void SendPing();
+        void OnPingEvent(ProtoEvent& theEvent);
+        void OnPongEvent(ProtoEvent& theEvent);
+        bool OnLatencyTimeout(ProtoTimer& theTimer);
+        
         ProtoTimer          tx_timer;
         ProtoZmq::Socket    zmq_socket;
+        
+        ProtoZmq::Socket    ping_socket;
+        ProtoZmq::Socket    pong_socket;
+        ProtoTimer          lat_timer;
+        char                lat_endpoint[256];
+        bool                lat_direct;
+        bool                lat_skip;     // (see OnPongEvent())
+        unsigned int        lat_rounds;
+        unsigned int        lat_count;
+        ProtoTime           ping_time;
+        double              rtt_sum;
+        double              rtt_min;
+        double              rtt_max;
         //int                 socket_type;  // ZMQ_PUB, ZMQ_SUB, ZMQ_RADIO, ZMQ_DISH, etc
         
         char*        msg_buffer;
@@ -49,12 +72,18 @@ class ZmqExample : public ProtoApp
 PROTO_INSTANTIATE_APP(ZmqExample) 
         
 ZmqExample::ZmqExample()
-  : msg_buffer(NULL), msg_len(0), msg_index(0),
+  : lat_direct(false), lat_skip(false), lat_rounds(0), lat_count(0),
+    rtt_sum(0.0), rtt_min(0.0), rtt_max(0.0),
+    msg_buffer(NULL), msg_len(0), msg_index(0),
     msg_repeat(0), msg_repeat_count(0)
 {
+    lat_endpoint[0] = '\0';
     tx_timer.SetListener(this, &ZmqExample::OnTxTimeout);
     tx_timer.SetInterval(1.0);
     tx_timer.SetRepeat(-1);
+    lat_timer.SetListener(this, &ZmqExample::OnLatencyTimeout);
+    lat_timer.SetInterval(0.0);
+    lat_timer.SetRepeat(0);
     zmq_socket.SetNotifier(&dispatcher);
     zmq_socket.SetListener(this, &ZmqExample::OnSocketEvent);
 }
@@ -71,13 +100,15 @@ const char* const ZmqExample::CMD_LIST[] =
     "+dish",        // Receive with given ZMQ_DISH socket
     "+repeat",     // repeat message multiple times
     "+send",       // Send given string as message
+    "+latency",    // Run ping-pong latency test on given endpoint ('repeat' sets rounds)
     NULL
 };
     
 void ZmqExample::Usage()
 {
     fprintf(stderr, "zmqExample [publish <endpoint>][subscribe <endpoint>]\n"
-                    "            [send <message>][repeat <repeatCount>]\n");
+                    "            [send <message>][repeat <repeatCount>]\n"
+                    "            [latency <endpoint>]\n");
 }  // end ZmqExample::Usage()
   
 bool ZmqExample::OnStartup(int argc, const char*const* argv)
@@ -101,6 +132,7 @@ void ZmqExample::OnShutdown()
     if (tx_timer.IsActive()) tx_timer.Deactivate();
     if (zmq_socket.IsOpen()) zmq_socket.Close();
     if (zmq_socket.IsOpen()) zmq_socket.Close();
+    StopLatencyTest();
     PLOG(PL_ERROR, "zmqExample: Done.\n");
 }  // end ZmqExample::OnShutdown()
 
@@ -207,6 +239,17 @@ bool ZmqExample::OnCommand(const char* cmd, const char* val)
         if (msg_repeat_count) ActivateTimer(tx_timer);
         OnTxTimeout(tx_timer);  // go ahead and send msg immediately
     }
+    else if (!strncmp("latency", cmd, len))
+    {
+        strncpy(lat_endpoint, val, 255);
+        lat_endpoint[255] = '\0';
+        lat_rounds = (msg_repeat > 0) ? msg_repeat : 10000;
+        if (!StartLatencyTest(false))
+        {
+            PLOG(PL_ERROR, "ZmqExample::OnCommand() error: unable to start latency test\n");
+            return false;
+        }
+    }
     else
     {
         PLOG(PL_ERROR, "ZmqExample::OnCommand() unknown command error?\n");
@@ -272,6 +315,113 @@ void ZmqExample::OnSocketEvent(ProtoEvent& /*theEvent*/)
     }
 }  // end ZmqExample::OnSocketEvent()
 
+bool ZmqExample::StartLatencyTest(bool direct)
+{
+    StopLatencyTest();
+    lat_direct = direct;
+    lat_skip = false;
+    lat_count = 0;
+    rtt_sum = rtt_max = 0.0;
+    rtt_min = -1.0;
+    // The "pong" socket binds and owns the context the "ping" socket uses
+    // (so "inproc://" endpoints work too)
+    if (!pong_socket.Open(ZMQ_PAIR))
+    {
+        PLOG(PL_ERROR, "ZmqExample::StartLatencyTest() pong_socket.Open() error\n");
+        return false;
+    }
+    if (!ping_socket.Open(ZMQ_PAIR, NULL, pong_socket.GetContext()))
+    {
+        PLOG(PL_ERROR, "ZmqExample::StartLatencyTest() ping_socket.Open() error\n");
+        StopLatencyTest();
+        return false;
+    }
+    bool result;
+    if (direct)
+        result = pong_socket.SetDispatcher(&dispatcher) && ping_socket.SetDispatcher(&dispatcher);
+    else
+        result = pong_socket.SetNotifier(&dispatcher) && ping_socket.SetNotifier(&dispatcher);
+    pong_socket.SetListener(this, &ZmqExample::OnPongEvent);
+    ping_socket.SetListener(this, &ZmqExample::OnPingEvent);
+    if (!result || !pong_socket.Bind(lat_endpoint) || !ping_socket.Connect(lat_endpoint))
+    {
+        PLOG(PL_ERROR, "ZmqExample::StartLatencyTest() error: unable to set up sockets\n");
+        StopLatencyTest();
+        return false;
+    }
+    SendPing();
+    return true;
+}  // end ZmqExample::StartLatencyTest()
+
+void ZmqExample::StopLatencyTest()
+{
+    // (ping_socket first, since zmq_ctx_term() waits for its sockets to close)
+    if (ping_socket.IsOpen()) ping_socket.Close();
+    if (pong_socket.IsOpen()) pong_socket.Close();
+}  // end ZmqExample::StopLatencyTest()
+
+void ZmqExample::SendPing()
+{
+    char buffer[64];
+    memset(buffer, 0, 64);
+    unsigned int numBytes = 64;
+    ping_time.GetCurrentTime();
+    if (!ping_socket.Send(buffer, numBytes) || (0 == numBytes))
+        PLOG(PL_ERROR, "ZmqExample::SendPing() error: ping not sent\n");
+}  // end ZmqExample::SendPing()
+
+void ZmqExample::OnPongEvent(ProtoEvent& /*theEvent*/)
+{
+    // In "direct" mode, every other notification is left unhandled to
+    // check that the socket notifies again without a new ZMQ_FD edge
+    // (a PollerThread socket is only notified again after I/O)
+    if (lat_direct && (lat_skip = !lat_skip)) return;
+    // Echo pings back without copying: the received messages are
+    // handed straight to SendBatch() which takes ownership of them
+    zmq_msg_t msgList[16];
+    unsigned int count;
+    do
+    {
+        count = 16;
+        if (!pong_socket.RecvBatch(msgList, count)) break;
+        unsigned int sent = count;
+        pong_socket.SendBatch(msgList, sent);
+        for (unsigned int i = sent; i < count; i++)
+            zmq_msg_close(msgList + i);  // (dropped if the socket would block)
+    } while (16 == count);
+}  // end ZmqExample::OnPongEvent()
+
+void ZmqExample::OnPingEvent(ProtoEvent& /*theEvent*/)
+{
+    char buffer[64];
+    unsigned int numBytes = 64;
+    if (!ping_socket.Recv(buffer, numBytes) || (0 == numBytes)) return;
+    ProtoTime now;
+    now.GetCurrentTime();
+    double rtt = 1.0e+06 * ProtoTime::Delta(now, ping_time);
+    rtt_sum += rtt;
+    if ((rtt_min < 0.0) || (rtt < rtt_min)) rtt_min = rtt;
+    if (rtt > rtt_max) rtt_max = rtt;
+    if (++lat_count < lat_rounds)
+    {
+        SendPing();
+        return;
+    }
+    fprintf(stderr, "zmqExample: %s round trip (%u rounds): avg %.2f usec, min %.2f usec, max %.2f usec\n",
+            lat_direct ? "direct      " : "PollerThread", lat_count, rtt_sum / lat_count, rtt_min, rtt_max);
+    // (the sockets are closed from a timeout, not their own notification)
+    ActivateTimer(lat_timer);
+}  // end ZmqExample::OnPingEvent()
+
+bool ZmqExample::OnLatencyTimeout(ProtoTimer& /*theTimer*/)
+{
+    if (lat_direct || !StartLatencyTest(true))
+    {
+        StopLatencyTest();
+        Stop();
+    }
+    return true;
+}  // end ZmqExample::OnLatencyTimeout()
 
 ZmqExample::CmdType ZmqExample::GetCmdType(const char* cmd)
 {
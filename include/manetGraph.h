@@ -296,9 +296,9 @@ class NetGraph : public ProtoGraph
                 Interface(Node& theNode);
                 virtual ~Interface();
 
-                const ProtoAddress& GetAddress() const
+                ProtoAddress GetAddress() const
                     {return default_addr_item.GetAddress();}
-                const ProtoAddress& GetAnyAddress() const
+                ProtoAddress GetAnyAddress() const
                     {return GetAddress();}
                 ProtoAddressList& GetAddressList()
                     {return addr_list;}
@@ -316,7 +316,7 @@ class NetGraph : public ProtoGraph
                 bool Contains(const ProtoAddress& theAddress) const
                     {return addr_list.Contains(theAddress);}
 
-                const ProtoAddress& GetDefaultAddress() const
+                ProtoAddress GetDefaultAddress() const
                     {return default_addr_item.GetAddress();}
 
                 //void SetAddress(const ProtoAddress& theAddress)
@@ -478,7 +478,7 @@ class ManetAddrBlock : public ProtoPkt
         unsigned int OffsetMid() const
         {
             UINT16 offset = OffsetTailLength();
-            offset += (HasTail() ? (1 + (HasZeroTail() ? 0 : GetTailLength())) : 0);
+            offset += ((HasTail() || HasZeroTail()) ? (1 + (HasZeroTail() ? 0 : GetTailLength())) : 0);
             return offset;
         }
         unsigned int OffsetPrefixLength() const
@@ -0,0 +1,428 @@
+#ifndef _MANET_PKT_VIEW
+#define _MANET_PKT_VIEW
+
+/**
+* @class ManetPktView
+* @brief Single-pass, allocation-free parser for IETF RFC 5444 packets
+*
+* The ManetPkt/ManetMsg/ManetAddrBlock/ManetTlv classes in "manetMsg.h"
+* parse lazily via iterators that re-walk preceding TLV blocks for each
+* step.  ManetPktView instead walks a received packet exactly once and
+* records every message, address block and TLV into flat, preallocated
+* arrays.  Addresses are expanded (head/mid/tail) into a fixed-stride
+* array as they are parsed, and TLV index ranges are resolved against
+* their address block so applications can index values directly.
+*
+* A ManetPktView is fairly large (tens of kilobytes), so applications
+* should create one and reuse it for each received packet.  Pointers
+* returned by the view reference the parsed packet buffer, which must
+* remain valid while the view is used.
+*
+* The companion ManetPktWriter class builds packets in a single forward
+* pass, writing each field once and back-filling only the length fields.
+*/
+
+#include "protoPkt.h"      // for ntohs(), htonl(), etc
+#include "protoDebug.h"
+#include "protoAddress.h"
+
+class ManetPktView
+{
+    public:
+        ManetPktView();
+        ~ManetPktView();
+
+        // Maximum number of items recorded per packet
+        enum
+        {
+            MSG_MAX         = 64,
+            ADDR_BLOCK_MAX  = 256,
+            TLV_MAX         = 2048,
+            ADDR_MAX        = 2048,
+            ADDR_SIZE_MAX   = 16   // bytes (supports up to IPv6)
+        };
+
+        class Tlv
+        {
+            public:
+                UINT8 GetType() const
+                    {return tlv_type;}
+                bool HasExtendedType() const
+                    {return (0 != (tlv_flags & EXTENDED_TYPE));}
+                UINT8 GetExtendedType() const
+                    {return tlv_type_ext;}
+                UINT16 GetFullType() const
+                    {return (((UINT16)tlv_type << 8) | tlv_type_ext);}
+                // For address block TLVs, the index range is resolved to
+                // the block addresses (i.e. no index == all addresses)
+                UINT8 GetIndexStart() const
+                    {return index_start;}
+                UINT8 GetIndexStop() const
+                    {return index_stop;}
+                bool HasValue() const
+                    {return (0 != (tlv_flags & HAS_VALUE));}
+                bool IsMultiValue() const
+                    {return (0 != (tlv_flags & MULTIVALUE));}
+                // Total length of value field
+                UINT16 GetTlvLength() const
+                    {return tlv_length;}
+                // Length of a single value (differs for multivalue TLVs)
+                UINT16 GetValueLength() const
+                    {return value_length;}
+                // "index" is the address index for multivalue TLVs (ignored otherwise)
+                const char* GetValuePtr(UINT8 index = 0) const
+                {
+                    if (!IsMultiValue()) return value_ptr;
+                    ASSERT((index >= index_start) && (index <= index_stop));
+                    return (value_ptr + (index - index_start)*value_length);
+                }
+                bool GetValue(UINT8& value, UINT8 index = 0) const;
+                bool GetValue(UINT16& value, UINT8 index = 0) const;
+                bool GetValue(UINT32& value, UINT8 index = 0) const;
+                // True if the TLV applies to the address at "index"
+                bool AppliesTo(UINT8 index) const
+                    {return ((index >= index_start) && (index <= index_stop));}
+
+            private:
+                friend class ManetPktView;
+                UINT8           tlv_type;
+                UINT8           tlv_type_ext;
+                UINT8           tlv_flags;
+                UINT8           index_start;
+                UINT8           index_stop;
+                UINT16          tlv_length;
+                UINT16          value_length;
+                const char*     value_ptr;
+        };  // end class ManetPktView::Tlv
+
+        class AddrBlock
+        {
+            public:
+                UINT8 GetAddressCount() const
+                    {return addr_count;}
+                // Index of the first block address in the view's address array
+                unsigned int GetAddressIndex() const
+                    {return addr_index;}
+                unsigned int GetTlvIndex() const
+                    {return tlv_index;}
+                unsigned int GetTlvCount() const
+                    {return tlv_count;}
+
+            private:
+                friend class ManetPktView;
+                UINT8           addr_count;
+                UINT16          addr_index;
+                UINT16          tlv_index;
+                UINT16          tlv_count;
+        };  // end class ManetPktView::AddrBlock
+
+        class Msg
+        {
+            public:
+                UINT8 GetType() const
+                    {return msg_type;}
+                UINT16 GetMsgSize() const
+                    {return msg_size;}
+                // Offset of message within the packet buffer
+                UINT16 GetOffset() const
+                    {return msg_offset;}
+                UINT8 GetAddressLength() const
+                    {return addr_length;}
+                ProtoAddress::Type GetAddressType() const
+                    {return ProtoAddress::GetType(addr_length);}
+                bool HasOriginator() const
+                    {return (NULL != originator_ptr);}
+                const char* GetOriginatorPtr() const
+                    {return originator_ptr;}
+                bool GetOriginator(ProtoAddress& addr) const;
+                bool HasHopLimit() const
+                    {return (0 != (msg_flags & HAS_HOP_LIMIT));}
+                UINT8 GetHopLimit() const
+                    {return hop_limit;}
+                bool HasHopCount() const
+                    {return (0 != (msg_flags & HAS_HOP_COUNT));}
+                UINT8 GetHopCount() const
+                    {return hop_count;}
+                bool HasSequence() const
+                    {return (0 != (msg_flags & HAS_SEQ_NUM));}
+                UINT16 GetSequence() const
+                    {return msg_seq;}
+                // msg-tlv-block range in the view's TLV array
+                unsigned int GetTlvIndex() const
+                    {return tlv_index;}
+                unsigned int GetTlvCount() const
+                    {return tlv_count;}
+                // range in the view's address block array
+                unsigned int GetAddrBlockIndex() const
+                    {return block_index;}
+                unsigned int GetAddrBlockCount() const
+                    {return block_count;}
+
+            private:
+                friend class ManetPktView;
+                UINT8           msg_type;
+                UINT8           msg_flags;
+                UINT8           addr_length;
+                UINT8           hop_limit;
+                UINT8           hop_count;
+                UINT16          msg_seq;
+                UINT16          msg_size;
+                UINT16          msg_offset;
+                const char*     originator_ptr;
+                UINT16          tlv_index;
+                UINT16          tlv_count;
+                UINT16          block_index;
+                UINT16          block_count;
+        };  // end class ManetPktView::Msg
+
+        // Parses the packet in "bufferPtr".  Returns false if the
+        // packet is malformed or exceeds the view's capacity.
+        bool Parse(const void* bufferPtr, unsigned int numBytes);
+        void Clear();
+
+        // Packet header fields
+        UINT8 GetVersion() const
+            {return (pkt_semantics >> 4);}
+        bool HasSequence() const
+            {return (0 != (pkt_semantics & PKT_HAS_SEQ_NUM));}
+        UINT16 GetSequence() const
+            {return pkt_seq;}
+        unsigned int GetTlvIndex() const
+            {return 0;}  // pkt-tlv-block is always first when present
+        unsigned int GetTlvCount() const
+            {return pkt_tlv_count;}
+
+        unsigned int GetMsgCount() const
+            {return msg_count;}
+        const Msg& GetMsg(unsigned int index) const
+        {
+            ASSERT(index < msg_count);
+            return msg_list[index];
+        }
+
+        const AddrBlock& GetAddrBlock(unsigned int index) const
+        {
+            ASSERT(index < block_count);
+            return block_list[index];
+        }
+
+        const Tlv& GetTlv(unsigned int index) const
+        {
+            ASSERT(index < tlv_count);
+            return tlv_list[index];
+        }
+
+        // Fully expanded addresses (length is the message address length)
+        unsigned int GetAddressCount() const
+            {return addr_count;}
+        const char* GetAddressPtr(unsigned int index) const
+        {
+            ASSERT(index < addr_count);
+            return (addr_buffer + index*ADDR_SIZE_MAX);
+        }
+        UINT8 GetPrefixLength(unsigned int index) const
+        {
+            ASSERT(index < addr_count);
+            return prefix_list[index];
+        }
+        bool GetAddress(const Msg& msg, unsigned int index, ProtoAddress& addr) const;
+
+        // Finds the first TLV of "type" in the given range of the TLV array
+        // (returns NULL if not found)
+        const Tlv* FindTlv(unsigned int tlvIndex, unsigned int tlvCount, UINT8 type) const;
+
+    private:
+        // RFC 5444 flag bits
+        enum
+        {
+            PKT_HAS_SEQ_NUM     = 0x08,
+            PKT_HAS_TLV_BLOCK   = 0x04
+        };
+        enum
+        {
+            HAS_ORIGINATOR      = 0x80,
+            HAS_HOP_LIMIT       = 0x40,
+            HAS_HOP_COUNT       = 0x20,
+            HAS_SEQ_NUM         = 0x10
+        };
+        enum
+        {
+            HAS_HEAD            = 0x80,
+            HAS_FULL_TAIL       = 0x40,
+            HAS_ZERO_TAIL       = 0x20,
+            HAS_SINGLE_PREFIX   = 0x10,
+            HAS_MULTI_PREFIX    = 0x08
+        };
+        enum
+        {
+            EXTENDED_TYPE       = 0x80,
+            SINGLE_INDEX        = 0x40,
+            MULTI_INDEX         = 0x20,
+            HAS_VALUE           = 0x10,
+            EXTENDED_LENGTH     = 0x08,
+            MULTIVALUE          = 0x04
+        };
+
+        bool ParseTlvBlock(unsigned int& offset, unsigned int limit,
+                           unsigned int numAddrs, UINT16& tlvIndex, UINT16& tlvCount);
+        bool ParseMessage(unsigned int& offset);
+        bool ParseAddrBlock(unsigned int& offset, unsigned int limit, UINT8 addrLength);
+
+        UINT16 GetUINT16(unsigned int offset) const
+            {return (((UINT16)pkt_buffer[offset] << 8) | (UINT16)pkt_buffer[offset+1]);}
+
+        const UINT8*    pkt_buffer;
+        unsigned int    pkt_length;
+        UINT8           pkt_semantics;
+        UINT16          pkt_seq;
+        unsigned int    pkt_tlv_count;
+
+        unsigned int    msg_count;
+        unsigned int    block_count;
+        unsigned int    tlv_count;
+        unsigned int    addr_count;
+
+        Msg             msg_list[MSG_MAX];
+        AddrBlock       block_list[ADDR_BLOCK_MAX];
+        Tlv             tlv_list[TLV_MAX];
+        char            addr_buffer[ADDR_MAX*ADDR_SIZE_MAX];
+        UINT8           prefix_list[ADDR_MAX];
+
+};  // end class ManetPktView
+
+/**
+* @class ManetPktWriter
+* @brief Single-pass RFC 5444 packet encoder
+*
+* Fields are written directly into the packet buffer in wire order,
+* so no content is ever moved.  Only the <msg-size> and <tlvs-length>
+* fields (and the packet flags) are filled in once their extent is known.
+* AppendAddressBlock() chooses the head/tail compression for the given
+* address list automatically.  The calls MUST be made in the order of
+* the RFC 5444 packet layout:
+*
+*   Init(), [SetSequence()], [AppendPktTlv()...],
+*   { BeginMessage(), [AppendMsgTlv()...],
+*     {AppendAddressBlock(), [AppendAddrTlv()...]}..., EndMessage() }...,
+*   Finish()
+*/
+class ManetPktWriter
+{
+    public:
+        ManetPktWriter();
+        ~ManetPktWriter();
+
+        bool Init(void* bufferPtr, unsigned int numBytes, UINT8 version = 0);
+
+        bool SetSequence(UINT16 sequence);
+
+        bool AppendPktTlv(UINT8 type, const char* value = NULL, UINT16 valueLength = 0)
+            {return AppendTlv(PKT_TLV, type, 0, false, 0, 0, value, valueLength, false);}
+
+        // Negative "hopLimit", "hopCount", or "sequence" are omitted from the header
+        bool BeginMessage(UINT8               type,
+                          UINT8               addrLength,
+                          const ProtoAddress* originator = NULL,
+                          int                 hopLimit = -1,
+                          int                 hopCount = -1,
+                          int                 sequence = -1);
+
+        bool AppendMsgTlv(UINT8 type, const char* value = NULL, UINT16 valueLength = 0)
+            {return AppendTlv(MSG_TLV, type, 0, false, 0, 0, value, valueLength, false);}
+        bool AppendMsgTlv(UINT8 type, UINT8 value)
+            {return AppendMsgTlv(type, (char*)&value, 1);}
+        bool AppendMsgTlv(UINT8 type, UINT16 value)
+        {
+            UINT16 temp16 = htons(value);
+            return AppendMsgTlv(type, (char*)&temp16, 2);
+        }
+        bool AppendMsgTlv(UINT8 type, UINT32 value)
+        {
+            UINT32 temp32 = htonl(value);
+            return AppendMsgTlv(type, (char*)&temp32, 4);
+        }
+
+        // Adds an address block with the smallest head/tail encoding for
+        // the given addresses (optional "prefixLengths" are in bits)
+        bool AppendAddressBlock(const ProtoAddress* addrList,
+                                unsigned int        numAddrs,
+                                const UINT8*        prefixLengths = NULL);
+
+        // Adds a TLV to the most recent address block for addresses "indexStart"
+        // through "indexStop". For "multiValue" TLVs, "value" has one
+        // "valueLength / (indexStop - indexStart + 1)" sized value per address.
+        bool AppendAddrTlv(UINT8        type,
+                           UINT8        indexStart,
+                           UINT8        indexStop,
+                           const char*  value,
+                           UINT16       valueLength,
+                           bool         multiValue = false)
+            {return AppendTlv(ADDR_TLV, type, 0, false, indexStart, indexStop, value, valueLength, multiValue);}
+        bool AppendAddrTlv(UINT8 type, UINT8 index, UINT8 value)
+            {return AppendAddrTlv(type, index, index, (char*)&value, 1);}
+
+        bool EndMessage();
+
+        // Finalizes the packet and returns its length (0 upon error)
+        unsigned int Finish();
+
+        unsigned int GetLength() const
+            {return pkt_length;}
+
+    private:
+        enum State
+        {
+            STATE_IDLE,
+            STATE_PKT_HEADER,   // packet header written
+            STATE_PKT_TLV,      // pkt-tlv-block open
+            STATE_MSG_TLV,      // msg-tlv-block open
+            STATE_ADDR_TLV,     // addr-block tlv-block open
+            STATE_MSG_END       // between messages
+        };
+        enum TlvContext {PKT_TLV, MSG_TLV, ADDR_TLV};
+
+        bool AppendTlv(TlvContext   context,
+                       UINT8        type,
+                       UINT8        typeExt,
+                       bool         hasTypeExt,
+                       UINT8        indexStart,
+                       UINT8        indexStop,
+                       const char*  value,
+                       UINT16       valueLength,
+                       bool         multiValue);
+
+        bool HasRoom(unsigned int numBytes) const
+            {return ((pkt_length + numBytes) <= buffer_bytes);}
+        void PutUINT8(UINT8 value)
+            {buffer_ptr[pkt_length++] = value;}
+        void PutUINT16(UINT16 value)
+        {
+            buffer_ptr[pkt_length++] = (UINT8)(value >> 8);
+            buffer_ptr[pkt_length++] = (UINT8)value;
+        }
+        void SetUINT16(unsigned int offset, UINT16 value)
+        {
+            buffer_ptr[offset] = (UINT8)(value >> 8);
+            buffer_ptr[offset+1] = (UINT8)value;
+        }
+        void OpenTlvBlock()
+        {
+            tlv_block_offset = pkt_length;
+            pkt_length += 2;
+        }
+        void CloseTlvBlock()
+            {SetUINT16(tlv_block_offset, (UINT16)(pkt_length - tlv_block_offset - 2));}
+
+        UINT8*          buffer_ptr;
+        unsigned int    buffer_bytes;
+        unsigned int    pkt_length;
+        State           state;
+        UINT8           pkt_flags;
+        unsigned int    msg_offset;
+        UINT8           msg_addr_length;
+        unsigned int    tlv_block_offset;
+        unsigned int    block_addr_count;
+
+};  // end class ManetPktWriter
+
+#endif // _MANET_PKT_VIEW
@@ -7,6 +7,7 @@
 #include "protoDefs.h"
 #include "protoTree.h"
 #include "protoDebug.h"
+#include "protoHash.h"
 
 #ifdef UNIX
 #include <sys/types.h>
@@ -48,6 +49,10 @@ typedef IpT_Address SIMADDR;
 extern IpT_Address IPI_BroadcastAddr;
 #endif // OPNET
 
+#ifdef NATIVE_SIM
+typedef UINT32 SIMADDR;  // (node addresses, high bit set for multicast groups)
+#endif // NATIVE_SIM
+
 #ifndef _SOCKADDRSIM
 #define _SOCKADDRSIM
 struct sockaddr_sim
@@ -259,6 +264,93 @@ class ProtoAddress
 #endif // if/else SIMULATE
 };  // end class ProtoAddress
 
+/**
+ * @class ProtoCompactAddress
+ *
+ * @brief Fixed-size (20 byte) address value for tables and other
+ * containers that hold many addresses.  Holds IPv4, IPv6, ETH (and SIM)
+ * host addresses plus port inline, instead of a full sockaddr_storage, 
+ * with unused address bytes kept zeroed so that equality and hashing are 
+ * simple word operations.  Convert to/from ProtoAddress at API edges.
+ * (Note IPv6 flow info and scope id are not retained.)
+ */
+class ProtoCompactAddress
+{
+    public:
+        ProtoCompactAddress()
+            {Invalidate();}
+        ProtoCompactAddress(const ProtoAddress& theAddr)
+            {SetAddress(theAddr);}
+        
+        bool IsValid() const 
+            {return (ProtoAddress::INVALID != type);}
+        void Invalidate()
+        {
+            value.word[0] = value.word[1] = value.word[2] = value.word[3] = 0;
+            type = ProtoAddress::INVALID;
+            length = 0;
+            port = 0;
+        }
+        
+        // Conversion to/from ProtoAddress
+        bool SetAddress(const ProtoAddress& theAddr);
+        void GetAddress(ProtoAddress& theAddr) const;
+        ProtoAddress GetAddress() const
+        {
+            ProtoAddress theAddr;
+            GetAddress(theAddr);
+            return theAddr;
+        }
+        
+        ProtoAddress::Type GetType() const 
+            {return ((ProtoAddress::Type)type);}
+        UINT8 GetLength() const 
+            {return length;}
+        const char* GetRawHostAddress() const 
+            {return ((const char*)value.byte);}
+        UINT16 GetPort() const 
+            {return port;}
+        void SetPort(UINT16 thePort)
+            {port = thePort;}
+        const char* GetHostString(char* buffer = NULL, unsigned int buflen = 0) const
+            {return GetAddress().GetHostString(buffer, buflen);}
+        
+        // Address comparison
+        bool HostIsEqual(const ProtoCompactAddress& theAddr) const
+        {
+            return ((type == theAddr.type) &&
+                    (value.word[0] == theAddr.value.word[0]) &&
+                    (value.word[1] == theAddr.value.word[1]) &&
+                    (value.word[2] == theAddr.value.word[2]) &&
+                    (value.word[3] == theAddr.value.word[3]));
+        }
+        bool IsEqual(const ProtoCompactAddress& theAddr) const
+            {return (HostIsEqual(theAddr) && (port == theAddr.port));}
+        int CompareHostAddr(const ProtoCompactAddress& theAddr) const;
+        bool operator==(const ProtoCompactAddress& theAddr) const {return IsEqual(theAddr);}
+        bool operator!=(const ProtoCompactAddress& theAddr) const {return !IsEqual(theAddr);}
+        bool operator<(const ProtoCompactAddress& theAddr) const {return (CompareHostAddr(theAddr) < 0);}
+        bool operator>(const ProtoCompactAddress& theAddr) const {return (CompareHostAddr(theAddr) > 0);}
+        
+        // 32-bit hash of the host address (and type), e.g. for hash tables
+        UINT32 GetHash() const
+            {return ProtoHash::Words(value.word, 4, type);}
+        
+        // Prefix operations
+        bool PrefixIsEqual(const ProtoCompactAddress& theAddr, UINT8 prefixLen) const;
+        void ApplyPrefixMask(UINT8 prefixLen);
+        
+    private:
+        union
+        {
+            UINT32  word[4];
+            UINT8   byte[16];
+        }                       value;
+        UINT8                   type;   // ProtoAddress::Type
+        UINT8                   length; // in bytes
+        UINT16                  port;   // host byte order
+};  // end class ProtoCompactAddress
+
 
 /**
  * @class ProtoAddressList
@@ -322,7 +414,9 @@ class ProtoAddressList
                 Item(const ProtoAddress& theAddr, const void* userData = NULL);
                 ~Item();
 
-                const ProtoAddress& GetAddress() const
+                ProtoAddress GetAddress() const
+                    {return addr.GetAddress();}
+                const ProtoCompactAddress& GetCompactAddress() const
                     {return addr;}
                 
                 const void* GetUserData() const
@@ -340,8 +434,8 @@ class ProtoAddressList
                 unsigned int GetKeysize() const {return (addr.GetLength() << 3);}
 
             private:
-                ProtoAddress    addr;    
-                const void*     user_data;   // this will be deprecated!
+                ProtoCompactAddress addr;    
+                const void*         user_data;   // this will be deprecated!
         };  // end class ProtoAddressList::Item    
         
         bool InsertItem(ProtoAddressList::Item& theItem)
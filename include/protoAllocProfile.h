@@ -0,0 +1,100 @@
+#ifndef _PROTO_ALLOC_PROFILE
+#define _PROTO_ALLOC_PROFILE
+
+#include "protoDefs.h"
+#include <stdio.h>  // for FILE*
+
+/**
+ * @class ProtoAllocProfile
+ *
+ * @brief Sampling heap profiler for finding allocation hot spots (e.g. in
+ * ProtoQueue, ProtoTree or ProtoPkt use) under real load.  Unlike ProtoCheck,
+ * which tracks every allocation in a locked map, this samples allocations
+ * about once per "sample interval" bytes allocated by each thread (512 KB by
+ * default), so it is cheap enough to leave enabled in production:
+ *
+ * - An unsampled "new" or "delete" just updates a thread-local byte count
+ *   and adds a 16 byte header to the allocation (no locks or shared state).
+ *
+ * - A sampled allocation records its call stack (up to STACK_DEPTH return
+ *   addresses) as an allocation "site" in a lock-free table.  Each site keeps
+ *   estimated allocation count and bytes, live (not yet deleted) count and
+ *   bytes, and a histogram of allocation size classes.  (Each sample is
+ *   weighted by the inverse of its probability of being sampled, so the
+ *   estimates are unbiased.)
+ *
+ * The report (sites sorted by allocated or live bytes, symbolized with
+ * dladdr()) can be written via Report(), fetched with GetSites(), or written
+ * whenever the process receives a signal (see EnableSignalReport()).
+ *
+ * The global "new" and "delete" operators are replaced only when the library
+ * is built with USE_PROTO_ALLOC_PROFILE defined (and not USE_PROTO_CHECK).
+ * Otherwise these methods are still available but report nothing.  Stack
+ * capture and symbols are available with glibc (or other backtrace()
+ * providers); elsewhere only the immediate caller of "new" is recorded.
+ * (Addresses in executables not linked with -rdynamic are reported as
+ * "module+offset" for use with addr2line.)
+ */
+class ProtoAllocProfile
+{
+    public:
+        enum
+        {
+            STACK_DEPTH = 4,
+            SIZE_CLASS_COUNT = 16   // (up to 16 bytes, 32, 64, ..., over 256 KB)
+        };
+
+        enum SortKey
+        {
+            SORT_ALLOC_BYTES,
+            SORT_ALLOC_COUNT,
+            SORT_LIVE_BYTES
+        };
+
+        // Allocation site statistics (the counts and bytes are estimates)
+        struct Site
+        {
+            void*           stack[STACK_DEPTH];  // (innermost caller first)
+            unsigned int    depth;
+            unsigned long   samples;
+            double          alloc_count;
+            double          alloc_bytes;
+            double          live_count;
+            double          live_bytes;
+            double          size_class_count[SIZE_CLASS_COUNT];
+        };
+
+        // Returns true if the library was built with USE_PROTO_ALLOC_PROFILE
+        static bool IsEnabled();
+
+        // Mean bytes allocated (per thread) between samples (0 stops sampling)
+        static void SetSampleInterval(unsigned long bytes);
+        static unsigned long GetSampleInterval();
+
+        // Fills "siteList" with up to "maxSites" sites in descending "sortKey"
+        // order, returning the number of sites filled in
+        static unsigned int GetSites(Site* siteList, unsigned int maxSites, SortKey sortKey = SORT_ALLOC_BYTES);
+
+        // Writes totals, the size class histogram and the top "maxSites" sites
+        static bool Report(FILE* filePtr, unsigned int maxSites = 20, SortKey sortKey = SORT_ALLOC_BYTES);
+
+        // Clears the allocation statistics (the live statistics are kept)
+        static void Reset();
+
+        // Writes a Report() to "path" (appended) or stderr (if NULL) each time
+        // the process receives "signum" (e.g. SIGUSR2).  A thread is started
+        // that writes the report, since that is not safe in a signal handler.
+        static bool EnableSignalReport(int signum, const char* path = NULL);
+        static void DisableSignalReport();
+
+        // Returns the size class index for an allocation of "size" bytes
+        static unsigned int GetSizeClass(size_t size)
+        {
+            if (size <= 16) return 0;
+            unsigned int index = (64 - __builtin_clzll((unsigned long long)(size - 1))) - 4;
+            return ((index < SIZE_CLASS_COUNT) ? index : (SIZE_CLASS_COUNT - 1));
+        }
+
+};  // end class ProtoAllocProfile
+
+#endif // _PROTO_ALLOC_PROFILE
@@ -0,0 +1,258 @@
+#ifndef _PROTO_ATOMIC
+#define _PROTO_ATOMIC
+
+#include "protoDefs.h"
+
+/**
+ * @class ProtoAtomic
+ *
+ * @brief Atomic operations on values shared between threads (counters,
+ * flags, list heads, etc) that are 1, 4 or 8 bytes in size, using the
+ * GCC/Clang __atomic builtins or the MSVC _Interlocked intrinsics.
+ *
+ * Load() and the read-modify-write operations are sequentially consistent,
+ * Store() is a release store and LoadRelaxed() has no ordering (e.g. for
+ * flags and statistics that are only polled).  FetchAdd() and FetchSub()
+ * are for integer types, while the others may be used with any plain
+ * value of a supported size (e.g. pointers or double).
+ */
+class ProtoAtomic
+{
+    private:
+        // (so a value argument such as "1" needn't match the type exactly)
+        template <class T>
+        class Value
+        {
+            public:
+                typedef T Type;
+        };
+
+    public:
+        template <class T>
+        static T Load(const T* ptr);
+        template <class T>
+        static T LoadRelaxed(const T* ptr);
+        template <class T>
+        static void Store(T* ptr, typename Value<T>::Type value);
+
+        // These return the prior value
+        template <class T>
+        static T FetchAdd(T* ptr, typename Value<T>::Type value);
+        template <class T>
+        static T FetchSub(T* ptr, typename Value<T>::Type value);
+        template <class T>
+        static T Exchange(T* ptr, typename Value<T>::Type value);
+
+        // Sets "*ptr" to "desired" and returns true if it held "expected",
+        // otherwise "expected" is set to the current value
+        template <class T>
+        static bool CompareExchange(T* ptr, T& expected, typename Value<T>::Type desired);
+
+        static void Fence();
+
+};  // end class ProtoAtomic
+
+#if defined(__GNUC__) || defined(__clang__)
+
+template <class T>
+inline T ProtoAtomic::Load(const T* ptr)
+{
+    T value;
+    __atomic_load(ptr, &value, __ATOMIC_SEQ_CST);
+    return value;
+}
+
+template <class T>
+inline T ProtoAtomic::LoadRelaxed(const T* ptr)
+{
+    T value;
+    __atomic_load(ptr, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+template <class T>
+inline void ProtoAtomic::Store(T* ptr, typename Value<T>::Type value)
+{
+    __atomic_store(ptr, &value, __ATOMIC_RELEASE);
+}
+
+template <class T>
+inline T ProtoAtomic::FetchAdd(T* ptr, typename Value<T>::Type value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+template <class T>
+inline T ProtoAtomic::FetchSub(T* ptr, typename Value<T>::Type value)
+{
+    return __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+template <class T>
+inline T ProtoAtomic::Exchange(T* ptr, typename Value<T>::Type value)
+{
+    T prior;
+    __atomic_exchange(ptr, &value, &prior, __ATOMIC_SEQ_CST);
+    return prior;
+}
+
+template <class T>
+inline bool ProtoAtomic::CompareExchange(T* ptr, T& expected, typename Value<T>::Type desired)
+{
+    return __atomic_compare_exchange(ptr, &expected, &desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+inline void ProtoAtomic::Fence()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+#include <string.h>  // for memcpy()
+
+#if defined(_M_IX86) || defined(_M_X64)
+// (x86 loads are not reordered with other loads, nor stores with other stores)
+#define PROTO_ATOMIC_BARRIER() _ReadWriteBarrier()
+#define PROTO_ATOMIC_FENCE() _mm_mfence()
+#else
+#define PROTO_ATOMIC_BARRIER() __dmb(0xb)  // (ARM "ish" full barrier)
+#define PROTO_ATOMIC_FENCE() __dmb(0xb)
+#endif // if/else _M_IX86 || _M_X64
+
+// The machine word used for values of each size (all other
+// operations are built on the word's compare-and-exchange)
+template <unsigned int SIZE>
+class ProtoAtomicWord;
+
+template <>
+class ProtoAtomicWord<1>
+{
+    public:
+        typedef char Type;
+        static Type Load(const volatile Type* ptr)
+            {return *ptr;}
+        static void Store(volatile Type* ptr, Type value)
+            {*ptr = value;}
+        static Type CompareExchange(volatile Type* ptr, Type desired, Type expected)
+            {return _InterlockedCompareExchange8(ptr, desired, expected);}
+};  // end class ProtoAtomicWord<1>
+
+template <>
+class ProtoAtomicWord<4>
+{
+    public:
+        typedef long Type;
+        static Type Load(const volatile Type* ptr)
+            {return *ptr;}
+        static void Store(volatile Type* ptr, Type value)
+            {*ptr = value;}
+        static Type CompareExchange(volatile Type* ptr, Type desired, Type expected)
+            {return _InterlockedCompareExchange(ptr, desired, expected);}
+};  // end class ProtoAtomicWord<4>
+
+template <>
+class ProtoAtomicWord<8>
+{
+    public:
+        typedef __int64 Type;
+#ifdef _M_IX86
+        // (plain 64-bit loads and stores aren't atomic on 32-bit x86)
+        static Type Load(const volatile Type* ptr)
+            {return _InterlockedCompareExchange64((volatile Type*)ptr, 0, 0);}
+        static void Store(volatile Type* ptr, Type value)
+        {
+            Type current = *ptr;
+            Type prior;
+            while (current != (prior = _InterlockedCompareExchange64(ptr, value, current)))
+                current = prior;
+        }
+#else
+        static Type Load(const volatile Type* ptr)
+            {return *ptr;}
+        static void Store(volatile Type* ptr, Type value)
+            {*ptr = value;}
+#endif // if/else _M_IX86
+        static Type CompareExchange(volatile Type* ptr, Type desired, Type expected)
+            {return _InterlockedCompareExchange64(ptr, desired, expected);}
+};  // end class ProtoAtomicWord<8>
+
+template <class T>
+inline T ProtoAtomic::Load(const T* ptr)
+{
+    typedef ProtoAtomicWord<sizeof(T)> Word;
+    typename Word::Type word = Word::Load((const volatile typename Word::Type*)ptr);
+    PROTO_ATOMIC_BARRIER();
+    T value;
+    memcpy(&value, &word, sizeof(T));
+    return value;
+}
+
+template <class T>
+inline T ProtoAtomic::LoadRelaxed(const T* ptr)
+{
+    typedef ProtoAtomicWord<sizeof(T)> Word;
+    typename Word::Type word = Word::Load((const volatile typename Word::Type*)ptr);
+    T value;
+    memcpy(&value, &word, sizeof(T));
+    return value;
+}
+
+template <class T>
+inline void ProtoAtomic::Store(T* ptr, typename Value<T>::Type value)
+{
+    typedef ProtoAtomicWord<sizeof(T)> Word;
+    typename Word::Type word;
+    memcpy(&word, &value, sizeof(T));
+    PROTO_ATOMIC_BARRIER();
+    Word::Store((volatile typename Word::Type*)ptr, word);
+}
+
+template <class T>
+inline bool ProtoAtomic::CompareExchange(T* ptr, T& expected, typename Value<T>::Type desired)
+{
+    typedef ProtoAtomicWord<sizeof(T)> Word;
+    typename Word::Type expectedWord, desiredWord;
+    memcpy(&expectedWord, &expected, sizeof(T));
+    memcpy(&desiredWord, &desired, sizeof(T));
+    typename Word::Type prior = Word::CompareExchange((volatile typename Word::Type*)ptr, desiredWord, expectedWord);
+    if (prior == expectedWord) return true;
+    memcpy(&expected, &prior, sizeof(T));
+    return false;
+}
+
+template <class T>
+inline T ProtoAtomic::FetchAdd(T* ptr, typename Value<T>::Type value)
+{
+    T prior = LoadRelaxed(ptr);
+    while (!CompareExchange(ptr, prior, (T)(prior + value))) {}
+    return prior;
+}
+
+template <class T>
+inline T ProtoAtomic::FetchSub(T* ptr, typename Value<T>::Type value)
+{
+    T prior = LoadRelaxed(ptr);
+    while (!CompareExchange(ptr, prior, (T)(prior - value))) {}
+    return prior;
+}
+
+template <class T>
+inline T ProtoAtomic::Exchange(T* ptr, typename Value<T>::Type value)
+{
+    T prior = LoadRelaxed(ptr);
+    while (!CompareExchange(ptr, prior, value)) {}
+    return prior;
+}
+
+inline void ProtoAtomic::Fence()
+{
+    PROTO_ATOMIC_FENCE();
+}
+
+#else
+#error "ProtoAtomic: no atomic operations for this compiler"
+#endif // if/else __GNUC__ || __clang__ / _MSC_VER
+
+#endif // _PROTO_ATOMIC
@@ -4,14 +4,14 @@
 /**
 * @class ProtoAverage
 *
-* @brief The ProtoAverage uses the proto list class to keep
-* a sub averaged record of numbers to be averaged.  This will
-* allow for averaging of VERY large sets of numbers with minimal
-* rounding and overflow errors along with minimal memory storage.
+* @brief The ProtoAverage keeps a running average of numbers.  This 
+* allows for averaging of VERY large sets of numbers with minimal
+* rounding and overflow errors in constant memory (no allocation per
+* number).  See ProtoStats (protoStats.h) for variance, quantiles, etc.
 */
 
 #include "protoDefs.h"
-#include "protoList.h"
+#include "protoStats.h"
 
 class ProtoAverage
 {
@@ -24,25 +24,6 @@ class ProtoAverage
         unsigned long GetCount() const;
         void Print();
     private:
-        class AverageItem : public ProtoList::Item
-        {
-            friend class ProtoAverage;
-            public:
-                AverageItem(double v) : value(v) , depth(0) , factor(1) {}
-                double GetValue() const {return value;}
-                double GetDepth() const {return depth;}
-                double GetFactor() const {return factor;}
-                bool Merge(const ProtoAverage::AverageItem &otherItem);
-            private:
-                double value;
-                double depth;
-                double factor;
-                void SetValue(double v);
-                void SetDepth(double d);
-        };
-        //this is the list used to store the values along with depth information on the values
-        class AverageList : public ProtoListTemplate<AverageItem> {};
-        AverageList list;
-        unsigned long count;
+        ProtoStats::Summary summary;
 };
 #endif
@@ -2,54 +2,187 @@
 #define _PROTO_BASE64
 
 // This class implements Base64 text encoding (and decoding) of binary data per IETF RFC 4648
-// By default, no maximum line length is imposed on encoder output and 
+// By default, no maximum line length is imposed on encoder output and
 // the output is fully padded per the RFC's recommendation.  However, options
 // are provided to enforce a maximum text line length and exclude padding if desired.
+// The "URL and filename safe" alphabet (RFC 4648 section 5) is also supported.
+
+// Bulk data is encoded/decoded several bytes at a time with a portable 64-bit
+// table-driven codec, or with SSSE3 or AVX2 instructions where available (x86
+// with GCC or Clang), selected at run time.  The Encoder and Decoder classes
+// below can process data that arrives in arbitrary chunks.
 
 #include "protoDefs.h"
 
 class ProtoBase64
 {
     public:
+        enum Alphabet
+        {
+            STANDARD,   // 'A'-'Z', 'a'-'z', '0'-'9', '+', '/'
+            URL_SAFE    // ... '-', '_' instead of '+', '/'
+        };
+
+        enum Codec
+        {
+            CODEC_AUTO,     // (the fastest supported)
+            CODEC_BYTE,     // one character at a time
+            CODEC_SWAR,     // portable 64-bit
+            CODEC_SSSE3,
+            CODEC_AVX2
+        };
+
         // Initializes encoding/decoding tables (called automatically if user doesn't)
-        static void Init(); 
-    
+        static void Init();
+
+        // Selects the codec (returns false if not supported by this CPU)
+        static bool SetCodec(Codec codec);
+        static Codec GetCodec();
+
         // Returns length (in bytes) of encoding of "numBytes" of data
-        static unsigned int ComputeEncodedSize(unsigned int numBytes, 
-                                               unsigned int maxLineLength = 0, 
+        static unsigned int ComputeEncodedSize(unsigned int numBytes,
+                                               unsigned int maxLineLength = 0,
                                                bool         includePadding = true);
-              
+
         // Returns length of encoded data in bytes (0 if "bufferSize" too small)
-        static unsigned int Encode(const char*    inputBuffer, 
-                                   unsigned int   inputBytes, 
-                                   char*          outputBuffer, 
-                                   unsigned int   bufferSize, 
+        static unsigned int Encode(const char*    inputBuffer,
+                                   unsigned int   inputBytes,
+                                   char*          outputBuffer,
+                                   unsigned int   bufferSize,
                                    unsigned int   maxLineLength = 0,
-                                   bool           includePadding = true);
-        
+                                   bool           includePadding = true,
+                                   Alphabet       alphabet = STANDARD);
+
         // Returns conservative (large) estimate of decoded data for "numBytes" of base64 characters
-        static unsigned int EstimateDecodedSize(unsigned int    numBytes, 
+        static unsigned int EstimateDecodedSize(unsigned int    numBytes,
                                                 unsigned int    maxLineLength = 0);
-        
+
         // Returns actual size (in bytes) of decoding of base64 characters in "inputBuffer"
-        static unsigned int DetermineDecodedSize(const char*    inputBuffer, 
-                                                 unsigned int   inputBytes);
-        
+        static unsigned int DetermineDecodedSize(const char*    inputBuffer,
+                                                 unsigned int   inputBytes,
+                                                 Alphabet       alphabet = STANDARD);
+
         // Returns length of decoded data in bytes (0 if "bufferSize" too small)
-        static unsigned int Decode(const char*   inputBuffer, 
-                                   unsigned int  inputBytes, 
-                                   char*         outputBuffer, 
-                                   unsigned int  bufferSize);
-        
-        // TBD - Add  alternative "Decode()" and "DetermineDecodedSize()" methods that can use 
+        // (padding and non-Base64 characters such as CR/LF are skipped)
+        static unsigned int Decode(const char*   inputBuffer,
+                                   unsigned int  inputBytes,
+                                   char*         outputBuffer,
+                                   unsigned int  bufferSize,
+                                   Alphabet      alphabet = STANDARD);
+
+        // TBD - Add  alternative "Decode()" and "DetermineDecodedSize()" methods that can use
         //       a NULL-terminated string "inputBuffer"
-        
+
+        // Streaming encoder for data in chunks:  call Update() for each chunk
+        // and Finish() at the end.  The output is the same as Encode() of all
+        // the data at once.
+        class Encoder
+        {
+            public:
+                Encoder(unsigned int    maxLineLength = 0,
+                        bool            includePadding = true,
+                        Alphabet        alphabet = STANDARD);
+
+                void Reset()
+                {
+                    pending_count = 0;
+                    line_length = 0;
+                }
+                // Returns the output buffer space needed by Update() plus Finish()
+                unsigned int GetMaxOutput(unsigned int inputBytes) const;
+
+                // These return false (and do nothing) if "bufferSize" is insufficient
+                bool Update(const char*     inputBuffer,
+                            unsigned int    inputBytes,
+                            char*           outputBuffer,
+                            unsigned int    bufferSize,
+                            unsigned int&   outputBytes);
+                bool Finish(char*           outputBuffer,
+                            unsigned int    bufferSize,
+                            unsigned int&   outputBytes);
+
+            private:
+                unsigned int    max_line_length;
+                bool            include_padding;
+                Alphabet        alphabet;
+                unsigned char   pending[3];     // (input bytes not yet encoded)
+                unsigned int    pending_count;
+                unsigned int    line_length;
+        };  // end class ProtoBase64::Encoder
+
+        // Streaming decoder for text in chunks (split anywhere)
+        class Decoder
+        {
+            public:
+                Decoder(Alphabet alphabet = STANDARD);
+
+                void Reset()
+                {
+                    offset = 0;
+                    output = 0;
+                }
+                // Returns the output buffer space needed for "inputBytes" more characters
+                // (assuming they are all Base64 characters)
+                unsigned int GetMaxOutput(unsigned int inputBytes) const;
+
+                // Returns false (and does nothing) if "bufferSize" is insufficient
+                // for the Base64 characters in "inputBuffer"
+                bool Update(const char*     inputBuffer,
+                            unsigned int    inputBytes,
+                            char*           outputBuffer,
+                            unsigned int    bufferSize,
+                            unsigned int&   outputBytes);
+
+                // Returns false if the text so far ends with a partial byte
+                bool IsComplete() const
+                    {return (1 != offset);}
+
+            private:
+                Alphabet        alphabet;
+                unsigned int    offset;     // (0-3 characters into the current quad)
+                char            output;     // (partial output byte)
+        };  // end class ProtoBase64::Decoder
+
     private:
+        static void EncodeBlocks(const unsigned char*   input,
+                                 unsigned int           numBytes,
+                                 char*                  buffer,
+                                 Alphabet               alphabet);
+        static void EncodeLines(const unsigned char*    input,
+                                unsigned int            numBytes,
+                                char*                   buffer,
+                                unsigned int&           outdex,
+                                unsigned int&           lineLength,
+                                unsigned int            maxLineLength,
+                                Alphabet                alphabet);
+        static void EncodeTail(const unsigned char*     input,
+                               unsigned int             numBytes,
+                               char*                    buffer,
+                               unsigned int&            outdex,
+                               unsigned int&            lineLength,
+                               unsigned int             maxLineLength,
+                               bool                     includePadding,
+                               Alphabet                 alphabet);
+        static unsigned int DecodeBlocks(const char*    input,
+                                         unsigned int   numBytes,
+                                         char*          buffer,
+                                         unsigned int   buflen,
+                                         Alphabet       alphabet);
+        static bool DecodeText(const char*      input,
+                               unsigned int     numBytes,
+                               char*            buffer,
+                               unsigned int     buflen,
+                               unsigned int&    outdex,
+                               unsigned int&    offset,
+                               char&            output,
+                               Alphabet         alphabet);
+
         static bool initialized;
-        static const char BASE64_ENCODE[]; 
-        static char BASE64_DECODE[255];
+        static Codec codec;
+        static const char BASE64_ENCODE[2][65];
+        static char BASE64_DECODE[2][256];
         static const char PAD64;
-        
+
 };  // end class ProtoBase64
 
 
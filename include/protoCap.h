@@ -62,6 +62,14 @@ class ProtoCap : public ProtoChannel
         virtual bool Recv(char* buffer, unsigned int& numBytes, Direction* direction = NULL) = 0;
         virtual bool Send(const char* buffer, unsigned int& numBytes) = 0;
         
+        // Sends "count" frames, stopping at the first frame that would block
+        // or fails, and returns the number of frames sent.  The default calls
+        // Send() for each frame, but implementations may override this with
+        // a batched (e.g., sendmmsg()) transmission.
+        virtual unsigned int SendBatch(const char* const*   bufferList, 
+                                       const unsigned int*  lengthList, 
+                                       unsigned int         count);
+        
         bool Forward(char* buffer, unsigned int& numBytes);
         
         bool ForwardFrom(char* buffer, unsigned int& numBytes, const ProtoAddress& srcMacAddr);
@@ -89,7 +89,7 @@ class ProtoChannel : public ProtoNotify
 
         bool UpdateNotification();
         
-        void OnNotify(NotifyFlag theFlag)
+        virtual void OnNotify(NotifyFlag theFlag)
         {
             if (listener) listener->on_event(*this, theFlag);   
         }
@@ -19,6 +19,9 @@
 // might be added.  This is _not_ a replacement for other tools such
 // as "valgrind", etc but useful for Protolib-based code.
 
+// For finding allocation hot spots (rather than leaks) in production
+// code, see the sampling profiler in "protoAllocProfile.h" instead.
+
 #include <stdio.h>  // for FILE*
 
 // UNCOMMENT this next line to enable "ProtoCheck" (or use -DUSE_PROTO_CHECK for your compiler)
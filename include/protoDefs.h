@@ -86,6 +86,18 @@ inline void ProtoSystemTime(struct timeval& theTime)
 }
 #endif // OPNET
 
+#ifdef NATIVE_SIM
+// (the clock of the NativeProtoSim partition running in the calling thread)
+double NativeProtoSimClock();
+inline void ProtoSystemTime(struct timeval& theTime)
+{
+    // (rounded to the nearest microsecond so timers are not seen as early)
+    unsigned long long usec = (unsigned long long)(NativeProtoSimClock() * 1.0e06 + 0.5);
+    theTime.tv_sec = usec / 1000000;
+    theTime.tv_usec = usec % 1000000;
+}
+#endif // NATIVE_SIM
+
 #else  // !SIMULATE
 
 #if defined(WIN32) && ((__cplusplus >= 201103L) || (_MSC_VER >= 1900))
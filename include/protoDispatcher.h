@@ -227,6 +227,8 @@ class ProtoDispatcher : public ProtoTimerMgr,
             ProtoTimerMgr::DeactivateTimer(theTimer);
             ResumeThread();
         }
+        // (virtual time is only supported when not threaded)
+        bool SetVirtualTime(bool state);
         
     // Methods to manage generic input/output streams (pipes, files, devices, etc)
         typedef ProtoChannel::Handle Descriptor;  // , UNIX "int" descriptors, Win32 "HANDLE" type 
@@ -292,6 +294,28 @@ class ProtoDispatcher : public ProtoTimerMgr,
          */
         void SetPreciseTiming(bool state) 
             {precise_timing = state;}
+        /**
+         * Enables a high resolution wait mode for sub-millisecond timer
+         * accuracy without busy-waiting.  On Linux, the kernel timer slack 
+         * of the thread calling Run() is minimized and, when available, 
+         * epoll_pwait2() is used with a nanosecond timeout instead of 
+         * re-arming the timerfd for each wait (the timerfd remains the
+         * fallback if the running kernel lacks epoll_pwait2()).  The 
+         * default state is "false".  Must be set before Run() is called.
+         */
+        void SetHighResolution(bool state)
+            {high_resolution = state;}
+        /**
+         * Sets a hybrid block-then-spin wait policy.  When the next timer
+         * timeout is more than "spinWindow" seconds away, the dispatcher
+         * blocks until "spinWindow" seconds before it and then polls for 
+         * the remainder.  This trades a bounded amount of CPU for timer
+         * accuracy.  A "spinWindow" of zero (the default) disables it.
+         */
+        void SetSpinWindow(double spinWindow)
+            {spin_window = (spinWindow > 0.0) ? spinWindow : 0.0;}
+        double GetSpinWindow() const
+            {return spin_window;}
         // For debugging purposes
         void SetUserData(const void* userData)
             {user_data = userData;}
@@ -728,6 +752,8 @@ class ProtoDispatcher : public ProtoTimerMgr,
         int                      exit_code;  
         double                   timer_delay;  // ( timer_delay < 0.0) means INFINITY
         bool                     precise_timing;
+        bool                     high_resolution;
+        double                   spin_window;
         ThreadId                 thread_id;
         bool                     external_thread;
         bool                     priority_boost;
@@ -792,6 +818,9 @@ class ProtoDispatcher : public ProtoTimerMgr,
         bool EpollChange(int fd, int events, int op, void* udata);
         struct epoll_event      epoll_event_array[EPOLL_ARRAY_SIZE];
         int                     epoll_fd;
+#ifdef HAVE_EPOLL_PWAIT2
+        bool                    use_epoll_pwait2;
+#endif // HAVE_EPOLL_PWAIT2
 #else  // UNIX
 #error "undefined async i/o mechanism"  // to make sure we implement something       
 #endif  // !USE_SELECT && !USE_KQUEUE
@@ -0,0 +1,156 @@
+#ifndef _PROTO_DISSECTOR
+#define _PROTO_DISSECTOR
+
+/**
+* @class ProtoDissector
+*
+* @brief Single-pass packet dissector that parses a batch of captured frames
+* into flat, fixed-size header descriptors.
+*
+* Parsing a frame with the ProtoPkt classes means constructing a ProtoPktETH,
+* then a ProtoPktIP, a ProtoPktIPv4 or ProtoPktIPv6 and finally a ProtoPktUDP
+* or ProtoPktTCP, with each re-validating its lengths.  The dissector instead
+* walks the link, network and transport headers of each frame once, with
+* only raw byte loads and bounds checks, and records what it found in a
+* ProtoDissector::Descriptor: the header offsets, protocol, addresses, ports,
+* TCP flags and the payload span.  Nothing is allocated or copied, so the
+* descriptors (and the frames they refer to) can be handed on to flow
+* accounting (see ProtoFlow::Cache::Key::InitFromDescriptor()), reassembly
+* or other analysis.
+*
+* Ethernet (with up to two 802.1Q/802.1ad VLAN tags), Linux "cooked" (SLL)
+* and raw IP frames are supported, with link type values matching the pcap
+* LINKTYPE_* numbers.  IPv6 extension headers are skipped so the descriptor
+* "protocol" is the upper layer protocol.  Frames are processed in batches,
+* prefetching ahead, so the per-frame cost is dominated by the header loads
+* themselves.  The methods are static (stateless) and may be called from
+* multiple threads.
+*/
+
+#include "protoAddress.h"
+
+class ProtoDissector
+{
+    public:
+        enum LinkType
+        {
+            LINK_ETHERNET   = 1,    // (pcap LINKTYPE_ETHERNET)
+            LINK_RAW        = 101,  // (pcap LINKTYPE_RAW, IPv4 or IPv6)
+            LINK_LINUX_SLL  = 113   // (pcap LINKTYPE_LINUX_SLL)
+        };
+
+        class Descriptor
+        {
+            public:
+                enum Flag
+                {
+                    FLAG_L3         = 0x01,  // valid IPv4 or IPv6 header
+                    FLAG_L4         = 0x02,  // TCP, UDP, SCTP or ICMP header parsed
+                    FLAG_FRAGMENT   = 0x04,  // IP fragment (FLAG_L4 only if first fragment)
+                    FLAG_TRUNCATED  = 0x08,  // captured length less than the IP length
+                    FLAG_VLAN       = 0x10   // 802.1Q/802.1ad tagged
+                };
+
+                UINT8 GetFlags() const
+                    {return flags;}
+                bool HasL3() const
+                    {return (0 != (flags & FLAG_L3));}
+                bool HasL4() const
+                    {return (0 != (flags & FLAG_L4));}
+                bool IsFragment() const
+                    {return (0 != (flags & FLAG_FRAGMENT));}
+                bool IsTruncated() const
+                    {return (0 != (flags & FLAG_TRUNCATED));}
+
+                // Link layer (the link header, if any, is at frame offset zero)
+                UINT16 GetEtherType() const  // (host byte order)
+                    {return ether_type;}
+                bool HasVlan() const
+                    {return (0 != (flags & FLAG_VLAN));}
+                UINT16 GetVlanId() const     // (outermost tag)
+                    {return vlan_id;}
+
+                // Network layer
+                unsigned int GetL3Offset() const
+                    {return l3_offset;}
+                UINT8 GetVersion() const     // 4, 6 or 0 (not IP)
+                    {return version;}
+                UINT8 GetProtocol() const    // upper layer protocol
+                    {return protocol;}
+                UINT8 GetTrafficClass() const  // (IPv4 TOS or IPv6 traffic class)
+                    {return traffic_class;}
+                UINT8 GetTTL() const         // (IPv4 TTL or IPv6 hop limit)
+                    {return ttl;}
+                unsigned int GetAddrLength() const
+                    {return ((6 == version) ? 16 : 4);}
+                // (network byte order)
+                const UINT32* GetSrcAddrPtr() const
+                    {return src_addr;}
+                const UINT32* GetDstAddrPtr() const
+                    {return dst_addr;}
+                // (ports, if any, are set in the returned addresses)
+                bool GetSrcAddr(ProtoAddress& addr) const;
+                bool GetDstAddr(ProtoAddress& addr) const;
+
+                // Transport layer (ICMP type and code are used as "dst port" as with NetFlow)
+                unsigned int GetL4Offset() const
+                    {return l4_offset;}
+                UINT16 GetSrcPort() const
+                    {return src_port;}
+                UINT16 GetDstPort() const
+                    {return dst_port;}
+                UINT8 GetTcpFlags() const
+                    {return tcp_flags;}
+
+                // Payload span (past the L4 header or, if FLAG_L4 is not set,
+                // the L3 payload), excluding any link layer padding
+                unsigned int GetPayloadOffset() const
+                    {return payload_offset;}
+                unsigned int GetPayloadLength() const
+                    {return payload_length;}
+                const char* GetPayload(const void* frame) const
+                    {return ((const char*)frame + payload_offset);}
+
+            private:
+                friend class ProtoDissector;
+                UINT32  src_addr[4];
+                UINT32  dst_addr[4];
+                UINT16  l3_offset;
+                UINT16  l4_offset;
+                UINT16  payload_offset;
+                UINT16  payload_length;
+                UINT16  ether_type;
+                UINT16  vlan_id;
+                UINT16  src_port;
+                UINT16  dst_port;
+                UINT8   version;
+                UINT8   protocol;
+                UINT8   traffic_class;
+                UINT8   ttl;
+                UINT8   tcp_flags;
+                UINT8   flags;
+                UINT16  reserved;
+        };  // end class ProtoDissector::Descriptor
+
+        // Dissects "count" frames into "descList", returning the number of
+        // frames with a valid IP header (FLAG_L3)
+        static unsigned int Dissect(LinkType            linkType,
+                                    unsigned int        count,
+                                    const void* const*  frameList,
+                                    const unsigned int* lengthList,
+                                    Descriptor*         descList);
+        // Single frame version, returns true if the frame has a valid IP header
+        static bool Dissect(LinkType            linkType,
+                            const void*         frame,
+                            unsigned int        length,
+                            Descriptor&         desc);
+
+    private:
+        // (frames are prefetched this many frames ahead in a batch)
+        enum {PREFETCH_AHEAD = 4};
+
+        static bool DissectFrame(LinkType linkType, const UINT8* frame, unsigned int length, Descriptor& desc);
+
+};  // end class ProtoDissector
+
+#endif // _PROTO_DISSECTOR
@@ -29,6 +29,7 @@
 #include "protoDefs.h"
 #include "protoDebug.h"
 #include "protoQueue.h"
+#include "protoThread.h"
 
 #ifndef MIN
 #define MIN(X,Y) ((X<Y)?X:Y)
@@ -80,6 +81,44 @@ class ProtoFile : public ProtoChannel
         bool Read(char* buffer, unsigned int& numBytes);//numBytes going is is requested amount comming out is amount read.  Note that a return value of true with numBytes =0 means nothing was read.
         bool Read(char* buffer, size_t& numBytes);
         bool Readline(char* buffer, unsigned int& bufferSize);//uses bufferedRead to read in a line quickly will return false if full line is not available
+
+        // Fast sequential input.  Map() memory-maps the (open, regular) file
+        // and StartReadAhead() starts a thread reading "blockSize" blocks
+        // ahead of use (for pipes, FIFOs, etc that can't be mapped).  Either
+        // way Readline() and GetNextRecord() then take their input from the
+        // mapping or blocks (don't mix these with Read()).
+        bool Map();
+        void Unmap();
+        bool IsMapped() const
+            {return is_mapped;}
+        const char* GetMapData() const
+            {return map_ptr;}
+        size_t GetMapSize() const
+            {return map_size;}
+        bool StartReadAhead(unsigned int blockSize = 1024*1024, unsigned int blockCount = 4);
+        void StopReadAhead();
+        bool IsReadingAhead() const
+            {return (NULL != read_ahead);}
+
+        // Zero-copy record iteration: "record" points to the next record
+        // (without its "delimiter") in the mapping or a read buffer and is
+        // valid until the next call.  A final record without a delimiter is
+        // returned as is.  Returns false at end of file (or upon error).
+        bool GetNextRecord(const char*& record, unsigned int& length, char delimiter = '\n');
+        // (as above, also removing any '\r' before the '\n')
+        bool GetNextLine(const char*& line, unsigned int& length);
+
+        // Access pattern hints (posix_fadvise(), where supported)
+        enum Advice
+        {
+            ADVISE_NORMAL,
+            ADVISE_SEQUENTIAL,
+            ADVISE_RANDOM,
+            ADVISE_WILLNEED,
+            ADVISE_DONTNEED
+        };
+        bool Advise(Advice advice, Offset theOffset = 0, Offset length = 0);
+
         size_t Write(const char* buffer, size_t len);
         bool Seek(Offset theOffset);
         ProtoFile::Offset GetOffset() const {return (offset);}
@@ -240,6 +279,9 @@ class ProtoFile : public ProtoChannel
 
     private:
         bool ReadPrivate(char* buffer, unsigned int& numBytes);  // helper for Readline()
+        bool FillBuffer(bool skipNonPrint);
+        bool AppendRecord(const char* data, unsigned int length);
+        class ReadAhead;
 
         // This is used by the ProtoFile::DirectoryIterator
         class Directory
@@ -278,8 +320,19 @@ class ProtoFile : public ProtoChannel
         // (TBD - allocate this only when needed or split to separate "FastReader" class?)
         enum {BUFFER_SIZE = 2048};
         char            read_buffer[BUFFER_SIZE];
-        char*           read_ptr;
-        unsigned int    read_count;
+        const char*     read_ptr;       // (into read_buffer, the mapping or a read ahead block)
+        size_t          read_count;
+        // Memory-mapped and read-ahead state
+        bool            is_mapped;
+        char*           map_ptr;
+        size_t          map_size;
+#ifdef WIN32
+        HANDLE          map_handle;
+#endif // WIN32
+        ReadAhead*      read_ahead;
+        char*           record_buffer;  // (records that span read blocks)
+        unsigned int    record_size;
+        unsigned int    record_length;
 };  // end class ProtoFile
 
 #endif // _PROTO_FILE
@@ -0,0 +1,251 @@
+#ifndef _PROTO_FLOW_CACHE
+#define _PROTO_FLOW_CACHE
+
+#include "protoFlow.h"
+#include "protoDissector.h"
+#include "protoSlotTable.h"
+#include "protoTime.h"
+
+// The ProtoFlow::Cache class provides NetFlow-like accounting of live flows.
+// Packets are classified by an exact-match ProtoFlow::Cache::Key (the fields of
+// a ProtoFlow::Description plus the transport (L4) source and destination ports)
+// and per-flow packet/byte counts, first/last packet times and cumulative TCP
+// flags are kept.  Flows are expired when idle for longer than the "idle timeout",
+// when active for longer than the "active timeout", or upon a TCP FIN or RST, and
+// the expired flow records are exported in batches to a listener callback.
+
+// NOTES:
+// 1) All memory is allocated by Open() (for a fixed maximum number of flows), so
+//    memory use is bounded.  When the cache is full, the flows closest to expiry
+//    are exported early (EXPIRE_EVICT) to make room for new flows.
+// 2) Expiry uses a timer wheel (one slot per "tick interval") with lazy timeout
+//    evaluation: a packet update does not move its flow on the wheel; the flow's
+//    actual expiry time is checked (and the flow rescheduled if needed) when its
+//    slot comes due.
+// 3) The cache is clocked by the packet times passed to Update() (so it works
+//    equally for live capture and offline pcap analysis), and Advance() may be
+//    called (e.g., from a ProtoTimer) to expire flows when no packets arrive.
+
+namespace ProtoFlow
+{
+    class Cache
+    {
+        public:
+            Cache();
+            ~Cache();
+
+            // Exact-match flow key (fixed-size so it can be hashed and compared directly)
+            class Key
+            {
+                public:
+                    Key();
+
+                    // Parses IPv4 or IPv6 header and TCP, UDP or SCTP ports
+                    // (ICMP type and code are used as "dst port" as with NetFlow)
+                    // (IPv6 extension headers are skipped so the key "protocol" is the
+                    //  upper layer protocol, and the TCP flags are optionally returned)
+                    bool InitFromPkt(ProtoPktIP& ipPkt, unsigned int ifaceIndex = 0, UINT8* tcpFlags = NULL);
+                    // Same, from an already dissected frame (no header parsing)
+                    bool InitFromDescriptor(const ProtoDissector::Descriptor& desc, unsigned int ifaceIndex = 0);
+                    // (Ports are taken from the "dst" and "src" addresses)
+                    void SetKey(const ProtoAddress&     dst,
+                                const ProtoAddress&     src,
+                                UINT8                   trafficClass,
+                                ProtoPktIP::Protocol    protocol,
+                                unsigned int            ifaceIndex = 0);
+
+                    // (Ports are set in the returned addresses)
+                    bool GetDstAddr(ProtoAddress& addr) const;
+                    bool GetSrcAddr(ProtoAddress& addr) const;
+                    UINT16 GetDstPort() const
+                        {return dst_port;}
+                    UINT16 GetSrcPort() const
+                        {return src_port;}
+                    UINT8 GetTrafficClass() const
+                        {return traffic_class;}
+                    ProtoPktIP::Protocol GetProtocol() const
+                        {return (ProtoPktIP::Protocol)protocol;}
+                    unsigned int GetInterfaceIndex() const
+                        {return iface_index;}
+
+                    // Fills in the (full mask length) ProtoFlow::Description for this flow
+                    void GetDescription(Description& description) const;
+
+                    UINT32 GetHash() const;
+                    bool IsEqual(const Key& key) const
+                    {
+                        const UINT32* a = (const UINT32*)this;
+                        const UINT32* b = (const UINT32*)&key;
+                        for (unsigned int i = 0; i < (sizeof(Key) / sizeof(UINT32)); i++)
+                            if (a[i] != b[i]) return false;
+                        return true;
+                    }
+
+                    void Print(FILE* filePtr = NULL) const;  // to ProtoDebug by default
+
+                private:
+                    UINT32      dst_addr[4];
+                    UINT32      src_addr[4];
+                    UINT32      iface_index;
+                    UINT16      dst_port;
+                    UINT16      src_port;
+                    UINT8       addr_len;   // 4 (IPv4) or 16 (IPv6)
+                    UINT8       traffic_class;
+                    UINT8       protocol;
+                    UINT8       reserved;   // (always zero)
+            };  // end class ProtoFlow::Cache::Key
+
+            enum ExpireReason
+            {
+                EXPIRE_NONE = 0,
+                EXPIRE_IDLE,    // no packets for "idle timeout"
+                EXPIRE_ACTIVE,  // active for "active timeout"
+                EXPIRE_END,     // TCP FIN or RST seen (expires at next tick)
+                EXPIRE_EVICT,   // exported early to make room for a new flow
+                EXPIRE_FLUSH    // exported upon Flush()
+            };
+
+            class Record
+            {
+                public:
+                    const Key& GetKey() const
+                        {return key;}
+                    unsigned long GetPackets() const
+                        {return packets;}
+                    unsigned long GetBytes() const
+                        {return bytes;}
+                    // (times are in seconds, same time base as Update() times)
+                    double GetFirstTime() const
+                        {return first_time;}
+                    double GetLastTime() const
+                        {return last_time;}
+                    double GetDuration() const
+                        {return (last_time - first_time);}
+                    UINT8 GetTcpFlags() const  // cumulative OR of TCP flags seen
+                        {return tcp_flags;}
+                    ExpireReason GetExpireReason() const
+                        {return (ExpireReason)expire_reason;}
+
+                private:
+                    friend class Cache;
+                    template <class SLOT_TYPE, class KEY_TYPE> friend class ::ProtoSlotTable;
+                    Key             key;
+                    unsigned long   packets;
+                    unsigned long   bytes;
+                    double          first_time;
+                    double          last_time;
+                    UINT32          hash;
+                    UINT32          hash_next;   // hash bucket chain (or free list)
+                    UINT32          wheel_prev;  // timer wheel slot list
+                    UINT32          wheel_next;
+                    UINT32          wheel_tick;  // tick of wheel slot holding record
+                    UINT8           tcp_flags;
+                    UINT8           expire_reason;
+                    bool            in_use;
+            };  // end class ProtoFlow::Cache::Record
+
+            enum {DEFAULT_BATCH_SIZE = 256};
+
+            // Allocates the cache for up to "maxFlows" concurrent flows.  Timeouts
+            // are rounded to (and expiry is accurate to) the "tickInterval"
+            bool Open(unsigned int  maxFlows,
+                      double        idleTimeout = 15.0,
+                      double        activeTimeout = 1800.0,
+                      double        tickInterval = 1.0,
+                      unsigned int  batchSize = DEFAULT_BATCH_SIZE);
+            void Close();  // (discards flows without export, call Flush() first if desired)
+            bool IsOpen() const
+                {return record_table.IsReady();}
+
+            // The listener is handed each batch of expired flow records
+            template <class LTYPE>
+            bool SetListener(LTYPE* theListener, void(LTYPE::*exportHandler)(Cache&, const Record*, unsigned int))
+            {
+                if (NULL != listener) delete listener;
+                listener = theListener ? new LISTENER_TYPE<LTYPE>(theListener, exportHandler) : NULL;
+                return (NULL == listener) ? (NULL != theListener) : true;
+            }
+
+            // Accounts a packet of "pktLength" bytes (e.g., the frame length).  Returns the flow
+            // record updated (NULL if not an IP packet or the flow could not be added)
+            const Record* Update(ProtoPktIP& ipPkt, unsigned int pktLength,
+                                 const ProtoTime& pktTime, unsigned int ifaceIndex = 0);
+            const Record* Update(const Key& key, unsigned int pktLength,
+                                 const ProtoTime& pktTime, UINT8 tcpFlags = 0);
+            const Record* Find(const Key& key) const;
+
+            // Expires (and exports) flows due as of "currentTime"
+            void Advance(const ProtoTime& currentTime);
+            // Expires (and exports) all flows
+            void Flush();
+
+            unsigned int GetFlowCount() const
+                {return record_table.GetCount();}
+            unsigned int GetFlowMax() const
+                {return record_table.GetMax();}
+            unsigned long GetPacketCount() const
+                {return packet_count;}
+            unsigned long GetExportCount() const
+                {return export_count;}
+            unsigned long GetEvictCount() const
+                {return evict_count;}
+
+        private:
+            typedef ProtoSlotTable<Record, Key> RecordTable;
+            enum {NIL = RecordTable::NIL};
+
+            UINT32 GetTick(double theTime) const
+                {return ((theTime > base_time) ? (UINT32)((theTime - base_time) * tick_rate) : 0);}
+            UINT32 GetExpireTick(const Record& record) const;
+            void WheelInsert(UINT32 index, UINT32 tick);
+            void WheelRemove(UINT32 index);
+            void Expire(UINT32 index, ExpireReason reason);
+            bool Evict();
+            void AdvanceTick(UINT32 tick);
+            void Export();
+
+            class Listener
+            {
+                public:
+                    virtual ~Listener() {}
+                    virtual void on_export(Cache& theCache, const Record* recordList, unsigned int recordCount) = 0;
+            };
+            template <class LTYPE>
+            class LISTENER_TYPE : public Listener
+            {
+                public:
+                    LISTENER_TYPE(LTYPE* theListener, void(LTYPE::*exportHandler)(Cache&, const Record*, unsigned int))
+                        : listener(theListener), export_handler(exportHandler) {}
+                    void on_export(Cache& theCache, const Record* recordList, unsigned int recordCount)
+                        {(listener->*export_handler)(theCache, recordList, recordCount);}
+                private:
+                    LTYPE*  listener;
+                    void    (LTYPE::*export_handler)(Cache&, const Record*, unsigned int);
+            };
+
+            Listener*       listener;
+
+            RecordTable     record_table;   // preallocated record pool
+            UINT32*         wheel;          // timer wheel slot list heads
+            UINT32          wheel_mask;
+
+            double          idle_timeout;
+            double          active_timeout;
+            double          tick_rate;      // ticks per second
+            double          base_time;      // time of tick zero
+            bool            base_valid;
+            UINT32          current_tick;   // last tick processed
+
+            Record*         batch_list;     // export batch
+            unsigned int    batch_size;
+            unsigned int    batch_count;
+
+            unsigned long   packet_count;
+            unsigned long   export_count;
+            unsigned long   evict_count;
+
+    };  // end class ProtoFlow::Cache
+
+}  // end namespace ProtoFlow
+
+#endif // !_PROTO_FLOW_CACHE
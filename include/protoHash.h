@@ -0,0 +1,41 @@
+#ifndef _PROTO_HASH
+#define _PROTO_HASH
+
+#include "protoDefs.h"
+
+/**
+ * @class ProtoHash
+ *
+ * @brief 32-bit hashing of fixed-size keys made of 32-bit words (addresses,
+ * flow and reassembly keys, grid coordinates, etc) for hash tables.  This is
+ * the MurmurHash3 word mixing and finalizer, so all key bytes affect the
+ * low-order hash bits used to select table buckets.
+ */
+class ProtoHash
+{
+    public:
+        static UINT32 Mix(UINT32 hash, UINT32 word)
+        {
+            word *= 0xcc9e2d51;
+            word = (word << 15) | (word >> 17);
+            hash ^= word * 0x1b873593;
+            return (((hash << 13) | (hash >> 19)) * 5 + 0xe6546b64);
+        }
+        static UINT32 Final(UINT32 hash)
+        {
+            hash ^= hash >> 16;
+            hash *= 0x85ebca6b;
+            hash ^= hash >> 13;
+            hash *= 0xc2b2ae35;
+            return (hash ^ (hash >> 16));
+        }
+        static UINT32 Words(const UINT32* word, unsigned int numWords, UINT32 seed = 0)
+        {
+            UINT32 hash = seed;
+            for (unsigned int i = 0; i < numWords; i++)
+                hash = Mix(hash, word[i]);
+            return Final(hash);
+        }
+};  // end class ProtoHash
+
+#endif // _PROTO_HASH
@@ -0,0 +1,171 @@
+#ifndef _PROTO_IP_REASSEMBLER
+#define _PROTO_IP_REASSEMBLER
+
+/**
+* @class ProtoIPReassembler
+*
+* @brief Reassembles fragmented IPv4 and IPv6 datagrams (e.g., as received
+* via ProtoCap or ProtoDetour) into contiguous packets.
+*
+* Fragments are matched on (src, dst, id, protocol) and their payload is
+* copied into fixed-size pages taken from a preallocated pool, so the
+* memory used for pending datagrams is capped by Open().  When the pool
+* (or the table of pending datagrams) is exhausted, the oldest pending
+* datagram is discarded to make room.  Pending datagrams are discarded
+* when not completed within the reassembly timeout, using a single
+* ProtoTimer.
+*
+* Overlapping IPv4 fragments are accepted with the data received first
+* retained, while an IPv6 datagram with overlapping fragments is discarded
+* (per RFC 5722).
+*
+* Process() hands back a ProtoPktIP view of each complete packet.  For an
+* unfragmented packet this refers to the input packet buffer itself; for a
+* reassembled datagram it refers to an internal buffer that is valid until
+* the next call to Process().
+*/
+
+#include "protoPktIP.h"
+#include "protoSlotTable.h"
+#include "protoTimer.h"
+
+class ProtoIPReassembler
+{
+    public:
+        ProtoIPReassembler(ProtoTimerMgr& timerMgr);
+        ~ProtoIPReassembler();
+
+        enum
+        {
+            DEFAULT_DATAGRAM_MAX    = 1024,
+            DEFAULT_MEMORY_MAX      = 4*1024*1024  // bytes
+        };
+
+        // The pool holds fragment data for up to "datagramMax" pending datagrams
+        // using up to "memoryMax" bytes.  Incomplete datagrams are discarded after
+        // "timeout" seconds (RFC 791 and RFC 8200 suggest 15 and 60 seconds)
+        bool Open(unsigned int  datagramMax = DEFAULT_DATAGRAM_MAX,
+                  unsigned int  memoryMax = DEFAULT_MEMORY_MAX,
+                  double        timeout = 30.0);
+        void Close();
+        bool IsOpen() const
+            {return datagram_table.IsReady();}
+
+        enum Status
+        {
+            STATUS_WHOLE,       // packet was not fragmented ("outPkt" refers to "ipPkt")
+            STATUS_COMPLETE,    // fragment completed a datagram ("outPkt" is reassembled)
+            STATUS_PENDING,     // fragment was accepted for reassembly
+            STATUS_DROPPED      // fragment was invalid or could not be buffered
+        };
+        Status Process(ProtoPktIP& ipPkt, ProtoPktIP& outPkt);
+
+        // Discards all pending datagrams
+        void Flush();
+
+        unsigned int GetPendingCount() const
+            {return datagram_table.GetCount();}
+        unsigned int GetPageCount() const  // pages in use
+            {return (page_max - page_free_count);}
+        unsigned int GetPageMax() const
+            {return page_max;}
+
+        unsigned long GetFragmentCount() const
+            {return fragment_count;}
+        unsigned long GetCompleteCount() const
+            {return complete_count;}
+        unsigned long GetTimeoutCount() const
+            {return timeout_count;}
+        unsigned long GetEvictCount() const
+            {return evict_count;}
+        unsigned long GetOverlapCount() const
+            {return overlap_count;}
+        unsigned long GetDropCount() const
+            {return drop_count;}
+
+    private:
+        enum
+        {
+            NIL             = 0xffffffff,
+            PAGE_SIZE       = 2048,
+            PAGE_MAX        = (65536 / PAGE_SIZE) + 1,  // per datagram
+            RANGE_MAX       = 16,   // received data ranges per datagram
+            HEADER_MAX      = 256,  // unfragmentable header bytes
+            PKT_SIZE_MAX    = 40 + 65535
+        };
+        class Key
+        {
+            public:
+                UINT32      src_addr[4];
+                UINT32      dst_addr[4];
+                UINT32      id;
+                UINT8       version;
+                UINT8       protocol;
+                UINT16      reserved;  // (always zero)
+
+                UINT32 GetHash() const;
+                bool IsEqual(const Key& key) const
+                    {return (0 == memcmp(this, &key, sizeof(Key)));}
+        };
+        struct Range
+        {
+            UINT32  start;
+            UINT32  end;
+        };
+        class Datagram
+        {
+            public:
+                Key         key;
+                UINT32      hash;
+                UINT32      hash_next;  // hash bucket chain (or free list)
+                UINT32      age_prev;   // pending list, oldest first
+                UINT32      age_next;
+                double      create_time;
+                UINT32      total_length;   // fragmentable part (when last fragment seen)
+                bool        last_seen;
+                bool        first_seen;
+                UINT16      header_length;  // unfragmentable part (when first fragment seen)
+                UINT16      next_header_offset;  // IPv6 "next header" field pointing to FRAG header
+                UINT8       next_header;         // (from IPv6 FRAG header)
+                UINT16      range_count;
+                Range       range_list[RANGE_MAX];
+                UINT32      page_list[PAGE_MAX];
+                UINT32      header[HEADER_MAX / 4];
+        };
+
+        UINT32 AddDatagram(const Key& key, UINT32 hash);
+        void RemoveDatagram(UINT32 index);
+        bool AddData(UINT32 index, UINT32 start, UINT32 end, const UINT8* data);
+        UINT32 GetPage(UINT32 index);
+        bool AddRange(Datagram& datagram, UINT32 start, UINT32 end);
+        unsigned int Assemble(Datagram& datagram);
+        void OnTimeout(ProtoTimer& theTimer);
+
+        char* GetPageData(UINT32 page) const
+            {return (page_buffer + (size_t)page * PAGE_SIZE);}
+
+        ProtoTimerMgr&  timer_mgr;
+        ProtoTimer      timeout_timer;
+        double          timeout;
+
+        ProtoSlotTable<Datagram, Key> datagram_table;
+        UINT32          age_head;
+        UINT32          age_tail;
+
+        char*           page_buffer;
+        UINT32*         page_free_list;  // stack of free page indices
+        unsigned int    page_max;
+        unsigned int    page_free_count;
+
+        UINT32*         out_buffer;     // reassembled packet
+
+        unsigned long   fragment_count;
+        unsigned long   complete_count;
+        unsigned long   timeout_count;
+        unsigned long   evict_count;
+        unsigned long   overlap_count;
+        unsigned long   drop_count;
+
+};  // end class ProtoIPReassembler
+
+#endif // _PROTO_IP_REASSEMBLER
@@ -92,11 +92,24 @@ class ProtoLFSR
         bool GetPrevBit();
         UINT8 GetPrevByte();
         
+        // Fills the "buffer" with the next "buflen" bytes of the
+        // sequence (uses a byte-indexed step table, 32 bits per loop)
         void FillBuffer(char* buffer, unsigned int buflen);
         
         // Here, buflen MUST be >= ((GetNumBits() + bitOffset) / 8)
         bool Sync(const char* buffer, unsigned int buflen, unsigned int bitOffset = 0);
         
+        // This searches "buffer" for the first bit offset (up to "maxOffset") 
+        // at which a Sync() results in the "checkBits" bits following the
+        // sync point being regenerated with at most "maxErrors" bit errors.
+        // Upon success, the LFSR is left synced at the returned bit offset.
+        // Returns -1 if no acceptable sync offset is found.
+        int SyncSearch(const char*  buffer, 
+                       unsigned int buflen, 
+                       unsigned int maxOffset,
+                       unsigned int checkBits,
+                       unsigned int maxErrors = 0);
+        
         // Some static "helper" methods
         static unsigned int GetPolySize(Polynomial poly);
         static Polynomial GetPolynomial(unsigned int registerSize)
@@ -114,13 +127,32 @@ class ProtoLFSR
     
     private:
         static const ProtoLFSR::Polynomial POLYNOMIAL_LIST[33];
+        // Shift counts at or above these thresholds use the step
+        // table and the GF(2) matrix jump-ahead, respectively
+        enum {TABLE_SHIFT_MIN = 64, JUMP_SHIFT_MIN = 1024};
         void Shift(unsigned int count = 1);
+        void Jump(unsigned int count);
         void LoadBit(bool bit);   
         void Mirror();
         bool IsMirrored() const
             {return is_mirrored;}
         
+        // The step table holds, for each value of the low 8 bits
+        // of the register, the 8 output bits produced and the
+        // contribution of those bits to the register state after
+        // 8 shifts (i.e. state' = (state >> 8) ^ step_xor[state & 0xff])
+        void BuildTable();
+        bool TableIsValid() const
+            {return (table_poly == lfsr_poly);}
+        UINT8 StepByte()
+        {
+            UINT8 index = (UINT8)lfsr_state;
+            lfsr_state = (lfsr_state >> 8) ^ step_xor[index];
+            return step_out[index];
+        }
         
+        static void MatrixSquare(UINT32* matrix);
+        static UINT32 MatrixMultiply(const UINT32* matrix, UINT32 vector);
             
         UINT32          lfsr_poly; 
         UINT32          lfsr_state;
@@ -128,6 +160,9 @@ class ProtoLFSR
         UINT32          lfsr_mask;
         bool            is_mirrored;
         bool            byte_mode;
+        UINT32          table_poly;  // polynomial step table was built for
+        UINT32          step_xor[256];
+        UINT8           step_out[256];
         
 };  // end class ProtoLFSR
 
@@ -203,6 +238,8 @@ class ProtoLFSRX
         bool GetPrevBit();
         UINT8 GetPrevByte();
         
+        // Fills the "buffer" with the next "buflen" bytes of the sequence
+        // (uses a byte-indexed step table that is built on first use)
         void FillBuffer(char* buffer, unsigned int buflen);
         
         // Here, buflen MUST be >= ((GetNumBits() + bitOffset) / 8)
@@ -213,7 +250,18 @@ class ProtoLFSRX
             {return ProtoBitmask::GetWeight(c);}
     
     private:
+        enum {TABLE_SHIFT_MIN = 64};
         void Shift(unsigned int count = 1);  // right shift
+        // Byte-at-a-time stepping (see ProtoLFSR::BuildTable() comments)
+        bool BuildTable();
+        bool TableIsValid() const
+            {return ((NULL != step_xor) && (table_mirrored == is_mirrored));}
+        UINT8 StepByte();
+        void ClearTable()
+        {
+            if (NULL != step_xor) delete[] step_xor;
+            step_xor = NULL;
+        }
         void LoadBit(bool bit);   
         void Mirror();
         bool IsMirrored() const
@@ -237,6 +285,9 @@ class ProtoLFSRX
         UINT32          lfsrx_mask;  // mask for most significant word (i.e. lfsrx_poly[lfsrx_words]
         bool            is_mirrored;
         bool            byte_mode;
+        UINT32*         step_xor;    // 256 x lfsrx_words step table (NULL if not built)
+        UINT8           step_out[256];
+        bool            table_mirrored; // mirror state step table was built for
         
 };  // end class ProtoLFSRX
 
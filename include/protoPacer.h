@@ -0,0 +1,139 @@
+#ifndef _PROTO_PACER
+#define _PROTO_PACER
+
+/**
+* @class ProtoPacer
+*
+* @brief Rate-limited (paced) output for a ProtoSocket or ProtoCap.
+*
+* Packets handed to the pacer are transmitted immediately while the
+* token bucket has room, and otherwise are copied into a preallocated
+* ring queue.  A single ProtoTimer releases the queued packets in bursts
+* (at most once per "burst interval") as tokens accrue at the configured
+* rate, so the cost of pacing is one timer reschedule per burst rather
+* than one per packet.  A bucket depth of zero gives fixed-rate pacing
+* (no accumulated credit beyond one burst interval).
+*
+* For ProtoSocket outputs on Linux, SetKernelPacing() can instead hand
+* the rate to the kernel via SO_MAX_PACING_RATE (enforced by the "fq"
+* queuing discipline), in which case packets are passed straight through.
+*
+* Achieved-rate statistics are kept for all packets the pacer sends.
+*/
+
+#include "protoSocket.h"
+#include "protoCap.h"
+#include "protoTimer.h"
+
+class ProtoPacer
+{
+    public:
+        ProtoPacer(ProtoTimerMgr& timerMgr);
+        ~ProtoPacer();
+
+        enum
+        {
+            DEFAULT_QUEUE_LENGTH    = 256,   // packets
+            DEFAULT_PKT_SIZE_MAX    = 2048   // bytes
+        };
+
+        // The queue holds up to "queueLength" packets of up to "pktSizeMax" bytes
+        bool Open(ProtoSocket&  theSocket,
+                  unsigned int  queueLength = DEFAULT_QUEUE_LENGTH,
+                  unsigned int  pktSizeMax = DEFAULT_PKT_SIZE_MAX);
+        bool Open(ProtoCap&     theCap,
+                  unsigned int  queueLength = DEFAULT_QUEUE_LENGTH,
+                  unsigned int  pktSizeMax = DEFAULT_PKT_SIZE_MAX);
+        void Close();
+        bool IsOpen() const
+            {return (NULL != slot_list);}
+
+        // Pacing rate in bits/sec (a "rate" <= 0.0 disables pacing)
+        void SetRate(double bitsPerSecond);
+        double GetRate() const
+            {return rate;}
+        // Token bucket depth in bytes (0 == fixed rate pacing).  This also
+        // bounds the credit kept to catch up after late timer wakeups.
+        void SetBucketDepth(unsigned int numBytes)
+            {bucket_depth = numBytes;}
+        unsigned int GetBucketDepth() const
+            {return bucket_depth;}
+        // Minimum interval between timer-driven releases of queued packets
+        void SetBurstInterval(double seconds)
+            {burst_interval = (seconds > 0.0) ? seconds : 0.0;}
+        double GetBurstInterval() const
+            {return burst_interval;}
+        // Uses SO_MAX_PACING_RATE when available (ProtoSocket output only)
+        bool SetKernelPacing(bool enable);
+        bool GetKernelPacing() const
+            {return kernel_pacing;}
+
+        // Returns false if the packet was dropped (queue full or send error)
+        bool Send(const char* buffer, unsigned int numBytes)
+            {return Enqueue(buffer, numBytes, NULL);}
+        bool SendTo(const char* buffer, unsigned int numBytes, const ProtoAddress& dstAddr)
+            {return Enqueue(buffer, numBytes, &dstAddr);}
+
+        unsigned int GetQueueCount() const
+            {return slot_count;}
+        unsigned int GetQueueLength() const
+            {return slot_max;}
+
+        // Statistics (since Open() or last ResetStats())
+        void ResetStats();
+        unsigned long GetSentPackets() const
+            {return sent_packets;}
+        unsigned long GetSentBytes() const
+            {return sent_bytes;}
+        unsigned long GetDropCount() const
+            {return drop_count;}
+        double GetAchievedRate();  // bits/sec
+
+    private:
+        class Slot
+        {
+            public:
+                Slot() : length(0), has_dst(false) {}
+                unsigned int    length;
+                bool            has_dst;
+                ProtoAddress    dst_addr;
+        };
+        enum TransmitStatus {TX_OK, TX_BLOCKED, TX_ERROR};
+
+        bool Init(unsigned int queueLength, unsigned int pktSizeMax);
+        bool Enqueue(const char* buffer, unsigned int numBytes, const ProtoAddress* dstAddr);
+        TransmitStatus Transmit(const char* buffer, unsigned int numBytes, const ProtoAddress* dstAddr);
+        void Refill();
+        double GetReleaseDelay() const;
+        void ScheduleRelease();
+        void OnPaceTimeout(ProtoTimer& theTimer);
+
+        char* GetSlotData(unsigned int index) const
+            {return (slot_buffer + index*pkt_size_max);}
+
+        ProtoTimerMgr&  timer_mgr;
+        ProtoTimer      pace_timer;
+        ProtoSocket*    socket;
+        ProtoCap*       cap;
+        double          rate;             // bits/sec
+        unsigned int    bucket_depth;     // bytes
+        double          burst_interval;   // seconds
+        bool            kernel_pacing;
+        double          tokens;           // bytes
+        ProtoTime       refill_time;
+
+        Slot*           slot_list;
+        char*           slot_buffer;
+        unsigned int    slot_max;
+        unsigned int    slot_head;
+        unsigned int    slot_count;
+        unsigned int    pkt_size_max;
+
+        unsigned long   sent_packets;
+        unsigned long   sent_bytes;
+        unsigned long   drop_count;
+        ProtoTime       stats_start;
+
+};  // end class ProtoPacer
+
+#endif // _PROTO_PACER
@@ -0,0 +1,343 @@
+#ifndef _PROTO_PCAP_ANALYZER
+#define _PROTO_PCAP_ANALYZER
+
+/**
+* @class ProtoPcapAnalyzer
+*
+* @brief Parallel offline analysis of pcap and pcapng capture files.
+*
+* The capture file is memory-mapped (so it is never copied) and the calling
+* thread scans its record (or block) headers, handing record-aligned
+* "chunks" of a bounded number of records and bytes to a set of worker
+* threads.  Workers dissect each packet with ProtoDissector and pass it to
+* the listener's packet handler (in the worker's thread) along with the
+* Worker, which provides per-worker user data and an output channel.
+*
+* Work is distributed according to the "affinity" setting:
+*
+* AFFINITY_NONE - each chunk is processed by one worker (whichever is free),
+*     giving the best load balance when no state is kept across packets.
+*
+* AFFINITY_FLOW - each packet is assigned to a worker by a symmetric hash of
+*     its addresses, protocol and ports, so both directions of a flow are
+*     always handled by the same worker, in capture order, and per-flow state
+*     (e.g., a ProtoFlow::Cache or ProtoTCPReassembler per worker) needs no
+*     locking.  IP fragments are hashed without ports (so all fragments of a
+*     datagram stay together).
+*
+* AFFINITY_ADDRESS - as above, hashing the address pair and protocol only
+*     (e.g., for IP reassembly or per-host-pair state).
+*
+* With affinity, each chunk is dissected and classified once (by whichever
+* worker reaches it first) and then every worker handles its share.  Data
+* passed to Worker::Output() is delivered to the listener's output handler,
+* either as each chunk is finished (from the worker's thread, serialized) or,
+* if "ordered output" is set, from the thread calling Run() and merged back
+* into capture order.  Packets are numbered in capture order from zero.
+*
+* Classic pcap (microsecond or nanosecond timestamps, either byte order) and
+* pcapng (multiple sections and interfaces, enhanced, simple and obsolete
+* packet blocks, either byte order) files are supported.  Ethernet, Linux
+* "cooked" (SLL) and raw IPv4/IPv6 link types are dissected and packets of
+* other link types are delivered with an empty descriptor.
+*/
+
+#include "protoDissector.h"
+#include "protoThread.h"
+#include "protoTime.h"
+
+class ProtoPcapAnalyzer
+{
+    public:
+        ProtoPcapAnalyzer();
+        ~ProtoPcapAnalyzer();
+
+        enum Affinity
+        {
+            AFFINITY_NONE,
+            AFFINITY_FLOW,
+            AFFINITY_ADDRESS
+        };
+        enum
+        {
+            WORKER_MAX              = 64,
+            DEFAULT_CHUNK_SIZE      = 1024*1024,  // bytes
+            DEFAULT_CHUNK_RECORDS   = 2048
+        };
+
+        class Packet
+        {
+            public:
+                unsigned long GetIndex() const  // (capture order)
+                    {return index;}
+                // (timestamp as seconds and nanoseconds since the epoch)
+                UINT32 GetSeconds() const
+                    {return record->sec;}
+                UINT32 GetNanoseconds() const
+                    {return record->nsec;}
+                ProtoTime GetTime() const
+                    {return ProtoTime(record->sec, record->nsec / 1000);}
+                const char* GetData() const
+                    {return record->data;}
+                unsigned int GetLength() const  // captured length
+                    {return record->length;}
+                unsigned int GetOriginalLength() const
+                    {return record->orig_length;}
+                unsigned int GetLinkType() const  // (pcap LINKTYPE_* value)
+                    {return record->link_type;}
+                unsigned int GetInterface() const  // (pcapng interface id, else zero)
+                    {return record->iface;}
+                const ProtoDissector::Descriptor& GetDescriptor() const
+                    {return *desc;}
+
+            private:
+                friend class ProtoPcapAnalyzer;
+                struct Record
+                {
+                    const char*     data;
+                    UINT32          length;
+                    UINT32          orig_length;
+                    UINT32          sec;
+                    UINT32          nsec;
+                    UINT16          link_type;
+                    UINT16          iface;
+                };
+                const Record*                       record;
+                const ProtoDissector::Descriptor*   desc;
+                unsigned long                       index;
+        };  // end class ProtoPcapAnalyzer::Packet
+
+        class Worker
+        {
+            public:
+                unsigned int GetIndex() const
+                    {return index;}
+                // Queues data for the output handler (may be called from the
+                // packet handler only, attributing the data to that packet)
+                bool Output(const char* data, unsigned int length);
+                unsigned long GetPacketCount() const
+                    {return packet_count;}
+                unsigned long GetByteCount() const
+                    {return byte_count;}
+
+                // (user data persists until the next Run() or Close())
+                void SetUserData(void* userData)
+                    {user_data = userData;}
+                void* GetUserData() const
+                    {return user_data;}
+
+            private:
+                friend class ProtoPcapAnalyzer;
+                class Thread : public ProtoThread
+                {
+                    public:
+                        Thread(ProtoPcapAnalyzer& theAnalyzer, Worker& theWorker)
+                            : analyzer(theAnalyzer), worker(theWorker) {}
+                        int RunThread()
+                            {return analyzer.RunWorker(worker);}
+                    private:
+                        ProtoPcapAnalyzer&  analyzer;
+                        Worker&             worker;
+                };
+                // Output records (a UINT32 packet index and length, then the data)
+                class OutputBuffer
+                {
+                    public:
+                        OutputBuffer() : buffer(NULL), length(0), size(0) {}
+                        ~OutputBuffer()
+                            {delete[] buffer;}
+                        bool Append(UINT32 pktIndex, const char* data, UINT32 dataLength);
+                        void Reset()
+                            {length = 0;}
+                        char*           buffer;
+                        unsigned int    length;
+                        unsigned int    size;
+                };
+
+                Worker(ProtoPcapAnalyzer& theAnalyzer, unsigned int theIndex);
+
+                ProtoPcapAnalyzer&  analyzer;
+                Thread              thread;
+                unsigned int        index;
+                unsigned long       next_chunk;     // (sequence number, affinity modes)
+                OutputBuffer*       output;         // (current chunk output)
+                UINT32              pkt_index;      // (current packet, within chunk)
+                OutputBuffer        local_output;   // (unordered output)
+                unsigned long       packet_count;
+                unsigned long       byte_count;
+                void*               user_data;
+        };  // end class ProtoPcapAnalyzer::Worker
+
+        bool Open(const char* fileName);
+        void Close();
+        bool IsOpen() const
+            {return (NULL != file_buffer);}
+        bool IsPcapNG() const
+            {return is_pcapng;}
+
+        void SetAffinity(Affinity theAffinity)
+            {affinity = theAffinity;}
+        Affinity GetAffinity() const
+            {return affinity;}
+        void SetOrderedOutput(bool state)
+            {ordered_output = state;}
+        bool GetOrderedOutput() const
+            {return ordered_output;}
+        // Chunks hold up to "recordMax" records and (unless a single record is
+        // larger) up to "chunkSize" bytes of the file
+        void SetChunkSize(unsigned int chunkSize, unsigned int recordMax)
+        {
+            chunk_size = (0 != chunkSize) ? chunkSize : 1;
+            chunk_record_max = (0 != recordMax) ? recordMax : 1;
+        }
+
+        // The packet handler is called from worker threads (concurrently) and the
+        // (optional) output handler is called from one thread at a time
+        template <class LTYPE>
+        bool SetListener(LTYPE* theListener,
+                         void(LTYPE::*packetHandler)(Worker&, const Packet&),
+                         void(LTYPE::*outputHandler)(const char*, unsigned int) = NULL)
+        {
+            if (NULL != listener) delete listener;
+            listener = theListener ? new LISTENER_TYPE<LTYPE>(theListener, packetHandler, outputHandler) : NULL;
+            return (NULL == listener) ? (NULL != theListener) : true;
+        }
+
+        // Processes the entire file with "numWorkers" worker threads, returning
+        // when done (the file may be processed again with another Run())
+        bool Run(unsigned int numWorkers);
+
+        unsigned int GetWorkerCount() const
+            {return worker_count;}
+        Worker* GetWorker(unsigned int index) const
+            {return (index < worker_count) ? worker_list[index] : NULL;}
+
+        // Statistics (of the last Run())
+        unsigned long GetPacketCount() const
+            {return packet_count;}
+        unsigned long GetByteCount() const  // (captured bytes)
+            {return byte_count;}
+        unsigned long GetSkipCount() const  // (unsupported or malformed records)
+            {return skip_count;}
+        unsigned long GetChunkCount() const
+            {return chunk_count;}
+
+    private:
+        typedef Packet::Record Record;
+        enum {INTERFACE_MAX = 256};
+        enum ChunkState
+        {
+            CHUNK_EMPTY,
+            CHUNK_FILLED,       // (records scanned)
+            CHUNK_CLASSIFYING,  // (being dissected and assigned to workers)
+            CHUNK_READY         // (classified)
+        };
+        struct Chunk
+        {
+            ChunkState                      state;
+            unsigned int                    pending;        // workers not done with it
+            unsigned int                    count;
+            unsigned long                   first_index;    // (of first packet)
+            Record*                         record_list;
+            ProtoDissector::Descriptor*     desc_list;
+            UINT8*                          worker_list;    // (affinity modes)
+            Worker::OutputBuffer*           output_list;    // (per worker, ordered output)
+        };
+        struct Interface
+        {
+            UINT16      link_type;
+            uint64_t    units_per_sec;  // timestamp resolution (0 if unsupported)
+        };
+
+        // File scanning
+        void Rewind();
+        bool NextRecord(Record& record);
+        bool NextPcapRecord(Record& record);
+        bool NextPcapNGRecord(Record& record);
+        bool ParseSectionHeader(size_t offset);
+        void ParseInterface(const char* body, unsigned int length);
+        UINT16 Get16(const char* ptr) const;
+        UINT32 Get32(const char* ptr) const;
+
+        // Processing
+        bool CreateChunks(unsigned int chunkMax);
+        void DestroyChunks();
+        void FillChunk(Chunk& chunk);
+        static void DissectRecords(const Record* recordList, unsigned int count, ProtoDissector::Descriptor* descList);
+        void ClassifyChunk(Chunk& chunk);
+        void ReleaseChunk(Chunk& chunk);
+        void ProcessChunk(Worker& worker, Chunk& chunk, bool dissect);
+        void FlushOutput(Worker::OutputBuffer& outputBuffer);
+        void Deliver(const char* data, unsigned int length)
+            {if (NULL != listener) listener->on_output(data, length);}
+        int RunWorker(Worker& worker);
+        Chunk& GetChunk(unsigned long seq) const
+            {return chunk_list[seq % chunk_max];}
+
+        class Listener
+        {
+            public:
+                virtual ~Listener() {}
+                virtual void on_packet(Worker& worker, const Packet& packet) = 0;
+                virtual void on_output(const char* data, unsigned int length) = 0;
+                virtual bool has_output() const = 0;
+        };
+        template <class LTYPE>
+        class LISTENER_TYPE : public Listener
+        {
+            public:
+                LISTENER_TYPE(LTYPE* theListener,
+                              void(LTYPE::*packetHandler)(Worker&, const Packet&),
+                              void(LTYPE::*outputHandler)(const char*, unsigned int))
+                    : listener(theListener), packet_handler(packetHandler), output_handler(outputHandler) {}
+                void on_packet(Worker& worker, const Packet& packet)
+                    {(listener->*packet_handler)(worker, packet);}
+                void on_output(const char* data, unsigned int length)
+                    {if (NULL != output_handler) (listener->*output_handler)(data, length);}
+                bool has_output() const
+                    {return (NULL != output_handler);}
+            private:
+                LTYPE*  listener;
+                void    (LTYPE::*packet_handler)(Worker&, const Packet&);
+                void    (LTYPE::*output_handler)(const char*, unsigned int);
+        };
+
+        Listener*       listener;
+        Affinity        affinity;
+        bool            ordered_output;
+        unsigned int    chunk_size;
+        unsigned int    chunk_record_max;
+
+        // Mapped file and scan state
+        char*           file_buffer;
+        size_t          file_size;
+        bool            file_mapped;    // (else "file_buffer" was read into)
+        bool            is_pcapng;
+        bool            swap_bytes;
+        size_t          scan_offset;
+        UINT16          link_type;      // (classic pcap)
+        UINT32          frac_scale;     // (classic pcap, nsec per fraction unit)
+        Interface       iface_list[INTERFACE_MAX];
+        unsigned int    iface_count;
+
+        // Workers and chunks (shared state is protected by "mutex")
+        Worker*         worker_list[WORKER_MAX];
+        unsigned int    worker_count;
+        Chunk*          chunk_list;
+        unsigned int    chunk_max;
+        ProtoMutex      mutex;
+        ProtoCondition  work_cond;      // (workers wait for chunks)
+        ProtoCondition  done_cond;      // (Run() waits for chunk completion)
+        ProtoMutex      output_mutex;   // (serializes unordered output)
+        unsigned long   fill_seq;       // chunks filled so far
+        unsigned long   take_seq;       // next chunk to take (AFFINITY_NONE)
+        bool            scan_done;
+
+        unsigned long   packet_count;
+        unsigned long   byte_count;
+        unsigned long   skip_count;
+        unsigned long   chunk_count;
+
+};  // end class ProtoPcapAnalyzer
+
+#endif // _PROTO_PCAP_ANALYZER
@@ -0,0 +1,159 @@
+#ifndef _PROTO_PCAP_REPLAY
+#define _PROTO_PCAP_REPLAY
+
+/**
+* @class ProtoPcapReplay
+*
+* @brief Replays the frames of a pcap capture file out a ProtoCap.
+*
+* The entire capture is loaded into memory up front and each frame is
+* copied (as an Ethernet frame, with its IP header 32-bit aligned) into a
+* single contiguous buffer along with a precomputed transmit schedule.
+* Classic pcap files (microsecond or nanosecond timestamps, either byte
+* order) with Ethernet, Linux "cooked" (SLL) or raw IP link types are
+* supported; libpcap is not required.
+*
+* Optional address/port and MAC rewriting is applied once, in place, when
+* the replay is started, with the IPv4 header and UDP/TCP checksums
+* updated incrementally (RFC 1624) rather than recomputed for every frame.
+*
+* During replay, each timeout hands all frames that are due (up to the
+* batch size) to ProtoCap::SendBatch().  Frames are scheduled against the
+* replay start time (not the previous frame) so timer lateness does not
+* accumulate.  A speed multiplier scales the capture timing and a speed
+* of zero (or less) sends as fast as the ProtoCap allows ("top speed").
+*/
+
+#include "protoCap.h"
+#include "protoTimer.h"
+
+#include <stdio.h>  // for FILE
+
+class ProtoPcapReplay
+{
+    public:
+        ProtoPcapReplay(ProtoTimerMgr& timerMgr);
+        ~ProtoPcapReplay();
+
+        enum {DEFAULT_BATCH_SIZE = 32};
+
+        // Loads (replaces) the capture ("fileName" == NULL reads stdin)
+        bool Load(const char* fileName);
+        bool Load(FILE* filePtr);
+        void Unload();
+        bool IsLoaded() const
+            {return (NULL != frame_list);}
+        unsigned int GetFrameCount() const
+            {return frame_count;}
+        // Number of capture records that were not loaded (unsupported or truncated)
+        unsigned int GetSkipCount() const
+            {return skip_count;}
+        // Capture time span (seconds) from first to last frame
+        double GetDuration() const
+            {return ((0 != frame_count) ? frame_list[frame_count - 1].time : 0.0);}
+
+        // Rewriting (invalid addresses disable rewriting, a zero port leaves
+        // the port as is).  These take effect on the next Start().
+        void SetDstAddr(const ProtoAddress& addr)
+            {dst_addr = addr;}
+        void SetSrcAddr(const ProtoAddress& addr)
+            {src_addr = addr;}
+        void SetDstMac(const ProtoAddress& macAddr)
+            {dst_mac = macAddr;}
+
+        // Replay speed multiplier (<= 0.0 is "top speed")
+        void SetSpeed(double multiplier)
+            {speed = multiplier;}
+        double GetSpeed() const
+            {return speed;}
+        // Maximum frames handed to ProtoCap::SendBatch() per call
+        void SetBatchSize(unsigned int count)
+            {batch_size = ((0 != count) ? ((count < (unsigned int)BATCH_MAX) ? count : (unsigned int)BATCH_MAX) : 1);}
+        unsigned int GetBatchSize() const
+            {return batch_size;}
+
+        bool Start(ProtoCap& theCap);
+        void Stop();
+        bool IsRunning() const
+            {return replay_timer.IsActive();}
+
+        // The listener is notified when the last frame has been sent
+        template <class LTYPE>
+        bool SetListener(LTYPE* theListener, void(LTYPE::*doneHandler)(ProtoPcapReplay&))
+        {
+            if (NULL != listener) delete listener;
+            listener = theListener ? new LISTENER_TYPE<LTYPE>(theListener, doneHandler) : NULL;
+            return (NULL == listener) ? (NULL != theListener) : true;
+        }
+
+        // Statistics (since last Start())
+        unsigned long GetSentFrames() const
+            {return sent_frames;}
+        unsigned long GetSentBytes() const
+            {return sent_bytes;}
+        unsigned long GetErrorCount() const
+            {return error_count;}
+        double GetMaxLateness() const  // seconds
+            {return max_lateness;}
+        double GetElapsedTime();       // seconds
+
+    private:
+        enum {BATCH_MAX = 1024};
+        struct Frame
+        {
+            UINT32      offset;  // into frame_buffer
+            UINT32      length;
+            double      time;    // relative to first frame
+        };
+
+        void Rewrite();
+        void RewriteFrame(char* frameBuffer, unsigned int frameLength);
+        void OnReplayTimeout(ProtoTimer& theTimer);
+
+        class Listener
+        {
+            public:
+                virtual ~Listener() {}
+                virtual void on_done(ProtoPcapReplay& theReplay) = 0;
+        };
+        template <class LTYPE>
+        class LISTENER_TYPE : public Listener
+        {
+            public:
+                LISTENER_TYPE(LTYPE* theListener, void(LTYPE::*doneHandler)(ProtoPcapReplay&))
+                    : listener(theListener), done_handler(doneHandler) {}
+                void on_done(ProtoPcapReplay& theReplay)
+                    {(listener->*done_handler)(theReplay);}
+            private:
+                LTYPE*  listener;
+                void    (LTYPE::*done_handler)(ProtoPcapReplay&);
+        };
+
+        ProtoTimerMgr&  timer_mgr;
+        ProtoTimer      replay_timer;
+        Listener*       listener;
+        ProtoCap*       cap;
+
+        UINT32*         frame_buffer;  // UINT32 for alignment
+        Frame*          frame_list;
+        unsigned int    frame_count;
+        unsigned int    skip_count;
+
+        ProtoAddress    dst_addr;
+        ProtoAddress    src_addr;
+        ProtoAddress    dst_mac;
+        double          speed;
+        unsigned int    batch_size;
+
+        unsigned int    frame_index;   // next frame to send
+        ProtoTime       start_time;
+        unsigned long   sent_frames;
+        unsigned long   sent_bytes;
+        unsigned long   error_count;
+        double          max_lateness;
+        const char*     batch_buffer[BATCH_MAX];
+        unsigned int    batch_length[BATCH_MAX];
+
+};  // end class ProtoPcapReplay
+
+#endif // _PROTO_PCAP_REPLAY
@@ -11,16 +11,27 @@
  * named pipe/mailslot mechanisms (WIN32).  This class 
  * extends the "ProtoSocket" class to support "LOCAL" 
  * domain interprocess communications.
+ *
+ * MESSAGE pipes are datagram sockets, STREAM pipes are connection-
+ * oriented byte streams and SEQPACKET pipes (UNIX only) are connection-
+ * oriented like STREAM but keep message boundaries like MESSAGE.
+ *
+ * For MESSAGE and SEQPACKET pipes, SendBatch() and RecvBatch() move a
+ * burst of messages with a single system call (sendmmsg()/recvmmsg() on
+ * Linux, else one call per message).  On UNIX, SendDescriptors() and
+ * RecvDescriptors() pass open file descriptors (SCM_RIGHTS) along with
+ * a message, so a peer can be handed e.g. a CreateSharedMemory() buffer
+ * to map rather than having its content copied through the pipe.
  */
 class ProtoPipe : public ProtoSocket
 {
     public:
-        enum Type {MESSAGE, STREAM};
+        enum Type {MESSAGE, STREAM, SEQPACKET};
 
 		ProtoPipe(Type theType = MESSAGE);
         ~ProtoPipe();
         
-        Type GetType() {return ((UDP == GetProtocol()) ? MESSAGE : STREAM);}
+        Type GetType() {return pipe_type;}
         const char* GetName() {return path;}
         bool Connect(const char* serverName);
         bool Listen(const char* theName);
@@ -31,6 +42,38 @@ class ProtoPipe : public ProtoSocket
             {return ProtoSocket::Send(buffer, numBytes);}
         bool Recv(char* buffer, unsigned int& numBytes)
             {return ProtoSocket::Recv(buffer, numBytes);}
+
+        // These return the number of messages sent or received, which is
+        // zero (without error) if the pipe would block.  For RecvBatch(),
+        // "lengthList" holds the buffer sizes on input and the message
+        // lengths on return.
+        unsigned int SendBatch(unsigned int         count,
+                               const char* const*   bufferList,
+                               const unsigned int*  lengthList);
+        unsigned int RecvBatch(unsigned int     maxCount,
+                               char* const*     bufferList,
+                               unsigned int*    lengthList);
+
+        // Sends "fdCount" descriptors with an optional message (a single
+        // byte is sent if none is given).  The receiver gets duplicates
+        // of the descriptors and is responsible for closing them.
+        bool SendDescriptors(const int*     fdList,
+                             unsigned int   fdCount,
+                             const char*    buffer = NULL,
+                             unsigned int   numBytes = 0);
+        // On input "fdCount" is the "fdList" size and "numBytes" the
+        // "buffer" size (which may be NULL/0 to discard the message)
+        bool RecvDescriptors(int*           fdList,
+                             unsigned int&  fdCount,
+                             char*          buffer,
+                             unsigned int&  numBytes);
+
+        // Creates an anonymous shared memory object of "size" bytes
+        // (memfd on Linux) suitable for passing with SendDescriptors().
+        // Returns the descriptor, or -1 on error.
+        static int CreateSharedMemory(unsigned int size, const char* name = "protoPipe");
+        
+        enum {BATCH_MAX = 64, DESCRIPTOR_MAX = 16};
         
     private:
         bool Open(const char* theName);
@@ -54,6 +97,7 @@ class ProtoPipe : public ProtoSocket
 #endif  
         HANDLE       named_event_handle;
 #endif // if/else !WIN32
+        Type        pipe_type;
         char        path[PATH_MAX];
 };
 
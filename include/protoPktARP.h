@@ -150,8 +150,8 @@ class ProtoArpTable
                 MacItem(const ProtoAddress& macAddr);
                 ~MacItem();
                 
-                const ProtoAddress& GetMacAddr()
-                    {return mac_addr;}
+                ProtoAddress GetMacAddr() const
+                    {return mac_addr.GetAddress();}
                 ProtoAddressList& AccessAddressList()
                     {return ip_addr_list;}
                 
@@ -166,8 +166,8 @@ class ProtoArpTable
                 unsigned int GetKeysize() const
                     {return (8 * mac_addr.GetLength());}
                 
-                ProtoAddress     mac_addr;
-                ProtoAddressList ip_addr_list;
+                ProtoCompactAddress mac_addr;
+                ProtoAddressList    ip_addr_list;
         };  // end class ProtoArpTable::MacItem
         class MacList : public ProtoTreeTemplate<MacItem> 
         {
@@ -184,9 +184,9 @@ class ProtoArpTable
                     : ip_addr(ipAddr), mac_item(macItem) {}
                 ~IPItem() {}
                 
-                const ProtoAddress& GetAddress()const
-                    {return ip_addr;}
-                const ProtoAddress& GetMacAddr() const
+                ProtoAddress GetAddress() const
+                    {return ip_addr.GetAddress();}
+                ProtoAddress GetMacAddr() const
                     {return mac_item->GetMacAddr();}
                 
                 MacItem* GetMacItem()
@@ -198,8 +198,8 @@ class ProtoArpTable
                 unsigned int GetKeysize() const
                     {return (8 * ip_addr.GetLength());}
                 
-                ProtoAddress    ip_addr;
-                MacItem*        mac_item;
+                ProtoCompactAddress ip_addr;
+                MacItem*            mac_item;
         };  // end class ProtoArpTable::IPItem
         
         
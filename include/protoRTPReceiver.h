@@ -0,0 +1,292 @@
+#ifndef _PROTO_RTP_RECEIVER
+#define _PROTO_RTP_RECEIVER
+
+/**
+* @class ProtoRTPReceiver
+*
+* @brief RTP (RFC 3550) receive pipeline that demultiplexes packets by SSRC,
+* keeps per-stream reception statistics and plays each stream out in
+* sequence order through a jitter (playout) buffer.
+*
+* Streams are kept in a hash table of preallocated entries.  For each stream
+* the extended highest sequence number, packet loss (RFC 3550 A.3) and
+* interarrival jitter (RFC 3550 A.8) are updated with a few integer
+* operations per packet and can be read directly from the Stream.
+*
+* Received packets are copied into buffers from a shared pool and held in a
+* per-stream ring (indexed by extended sequence number) until their playout
+* time, which is the arrival time predicted by the RTP timestamp (relative
+* to the earliest arriving packet seen so far) plus the playout delay.  A
+* single ProtoTimer releases due packets, in order, for all streams, with
+* streams ordered in a heap by their next playout time and releases
+* coalesced to at most one per "release interval".  Packets missing when a
+* later packet is played out are reported as lost, and packets arriving
+* after their turn are discarded as late.  If the pool or a stream's ring is
+* exhausted, the earliest waiting packets are played out early.  When the
+* stream table is full, the least recently active stream is removed.
+*
+* Listener callbacks must not call Receive() or remove streams.
+*/
+
+#include "protoPktRTP.h"
+#include "protoTimer.h"
+
+class ProtoRTPReceiver
+{
+    public:
+        ProtoRTPReceiver(ProtoTimerMgr& timerMgr);
+        ~ProtoRTPReceiver();
+
+        enum
+        {
+            DEFAULT_STREAM_MAX      = 1024,
+            DEFAULT_POOL_SIZE       = 8192,  // packets
+            DEFAULT_PKT_SIZE_MAX    = 1500,  // bytes
+            DEFAULT_STREAM_DEPTH    = 64     // packets (power of 2)
+        };
+        enum Event
+        {
+            EVENT_NEW_STREAM,   // stream first seen
+            EVENT_PACKET,       // RTP packet played out
+            EVENT_LOSS,         // "length" packets missing at playout
+            EVENT_REMOVE        // stream removed (buffered packets are discarded)
+        };
+
+        class Stream
+        {
+            public:
+                UINT32 GetSsrc() const
+                    {return ssrc;}
+                // Reception statistics (RFC 3550 section 6.4.1)
+                UINT32 GetExtendedMaxSeq() const
+                    {return (cycles + max_seq);}
+                UINT32 GetReceivedCount() const
+                    {return received;}
+                UINT32 GetExpectedCount() const
+                    {return (GetExtendedMaxSeq() - base_seq + 1);}
+                INT32 GetCumulativeLost() const
+                    {return (INT32)(GetExpectedCount() - received);}
+                // Loss fraction (8-bit fixed point) since the last call (i.e., report)
+                UINT8 UpdateFractionLost();
+                // Interarrival jitter in timestamp units and in seconds
+                UINT32 GetJitter() const
+                    {return (jitter >> 4);}
+                double GetJitterSeconds() const
+                    {return ((double)(jitter >> 4) / (double)clock_rate);}
+                // Playout statistics
+                unsigned long GetPlayedCount() const
+                    {return played_count;}
+                unsigned long GetLateCount() const
+                    {return late_count;}
+                unsigned long GetDuplicateCount() const
+                    {return duplicate_count;}
+                unsigned int GetBufferedCount() const
+                    {return buffered_count;}
+                double GetLastTime() const
+                    {return last_time;}
+
+                void SetUserData(void* userData)
+                    {user_data = userData;}
+                void* GetUserData() const
+                    {return user_data;}
+
+            private:
+                friend class ProtoRTPReceiver;
+                void InitSeq(UINT16 seq);
+                bool UpdateSeq(UINT16 seq);
+
+                UINT32          ssrc;
+                UINT32          hash_next;  // hash bucket chain (or free list)
+                UINT32          lru_prev;   // activity list, least recent first
+                UINT32          lru_next;
+                UINT32          heap_index; // position in playout heap (or NIL)
+                double          start_time;
+                double          last_time;
+                void*           user_data;
+                // RFC 3550 A.1 source state
+                UINT16          max_seq;
+                UINT32          cycles;
+                UINT32          base_seq;
+                UINT32          bad_seq;
+                UINT32          probation;
+                UINT32          received;
+                UINT32          expected_prior;
+                UINT32          received_prior;
+                UINT32          transit;
+                UINT32          jitter;     // (scaled by 16)
+                UINT32          clock_rate;
+                // Playout state
+                UINT32*         ring;       // buffered packets by extended sequence number
+                UINT32          play_seq;   // next extended sequence number to play out
+                unsigned int    buffered_count;
+                double          ref_time;   // playout reference (earliest arrival)
+                UINT32          ref_timestamp;
+                double          due_time;   // playout time of next buffered packet
+                unsigned long   played_count;
+                unsigned long   late_count;
+                unsigned long   duplicate_count;
+        };  // end class ProtoRTPReceiver::Stream
+
+        // Up to "streamMax" streams sharing a pool of "poolSize" buffers of "pktSizeMax"
+        // bytes, with up to "streamDepth" (rounded up to a power of 2) packets per stream
+        bool Open(unsigned int  streamMax = DEFAULT_STREAM_MAX,
+                  unsigned int  poolSize = DEFAULT_POOL_SIZE,
+                  unsigned int  pktSizeMax = DEFAULT_PKT_SIZE_MAX,
+                  unsigned int  streamDepth = DEFAULT_STREAM_DEPTH);
+        void Close();
+        bool IsOpen() const
+            {return (NULL != stream_list);}
+
+        // Delay (seconds) added to the predicted arrival time for playout
+        void SetPlayoutDelay(double seconds)
+            {playout_delay = seconds;}
+        double GetPlayoutDelay() const
+            {return playout_delay;}
+        // Minimum interval between timer-driven releases
+        void SetReleaseInterval(double seconds)
+            {release_interval = seconds;}
+        double GetReleaseInterval() const
+            {return release_interval;}
+        // RTP timestamp clock rate for a payload type (defaults per RFC 3551, with
+        // 90 kHz assumed for dynamic types), used for jitter and playout timing
+        void SetClockRate(ProtoPktRTP::PayloadType payloadType, UINT32 rate)
+            {if ((payloadType < ProtoPktRTP::PT_MAX) && (0 != rate)) clock_rate[payloadType] = rate;}
+        UINT32 GetClockRate(ProtoPktRTP::PayloadType payloadType) const
+            {return (payloadType < ProtoPktRTP::PT_MAX) ? clock_rate[payloadType] : 0;}
+
+        template <class LTYPE>
+        bool SetListener(LTYPE* theListener, void(LTYPE::*eventHandler)(Stream&, Event, const char*, unsigned int))
+        {
+            if (NULL != listener) delete listener;
+            listener = theListener ? new LISTENER_TYPE<LTYPE>(theListener, eventHandler) : NULL;
+            return (NULL == listener) ? (NULL != theListener) : true;
+        }
+
+        // Returns false if the packet was invalid or discarded (e.g., late or duplicate)
+        bool Receive(const ProtoPktRTP& rtpPkt);
+        bool Receive(const ProtoPktRTP& rtpPkt, const ProtoTime& arrivalTime);
+
+        Stream* FindStream(UINT32 ssrc)
+        {
+            UINT32 index = FindStreamIndex(ssrc);
+            return (NIL != index) ? (stream_list + index) : NULL;
+        }
+        void RemoveStream(UINT32 ssrc);
+        // Removes streams idle for longer than "idleTimeout" seconds
+        void Expire(double idleTimeout);
+        // Plays out all buffered packets immediately
+        void Flush();
+
+        unsigned int GetStreamCount() const
+            {return stream_count;}
+        unsigned int GetBufferCount() const  // pool buffers in use
+            {return (pool_size - pool_free_count);}
+        unsigned long GetInvalidCount() const
+            {return invalid_count;}
+        unsigned long GetEarlyCount() const  // played out early due to buffer limits
+            {return early_count;}
+
+    private:
+        enum {NIL = 0xffffffff};
+        struct Entry
+        {
+            UINT32  ext_seq;
+            UINT32  timestamp;
+            UINT32  length;
+            UINT32  next;   // (free list)
+        };
+
+        UINT32 FindHead(const Stream& stream) const;
+        double GetDueTime(const Stream& stream, UINT32 entry) const
+            {return (stream.ref_time + (double)(INT32)(entry_list[entry].timestamp - stream.ref_timestamp) / (double)stream.clock_rate + playout_delay);}
+        UINT32 FindStreamIndex(UINT32 ssrc) const
+        {
+            UINT32 index = hash_table[HashSsrc(ssrc) & hash_mask];
+            while ((NIL != index) && (ssrc != stream_list[index].ssrc))
+                index = stream_list[index].hash_next;
+            return index;
+        }
+        static UINT32 HashSsrc(UINT32 ssrc)
+        {
+            ssrc ^= ssrc >> 16;
+            ssrc *= 0x85ebca6b;
+            return (ssrc ^ (ssrc >> 13));
+        }
+        UINT32 AddStream(UINT32 ssrc, UINT32 clockRate, double theTime);
+        void RemoveStreamIndex(UINT32 index);
+        void Touch(UINT32 index, double theTime);
+        bool Buffer(UINT32 index, UINT32 extSeq, UINT32 timestamp, const ProtoPktRTP& rtpPkt);
+        bool PlayNext(UINT32 index);
+        void Release(UINT32 index, double releaseTime);
+        void UpdateDueTime(UINT32 index);
+        void ScheduleRelease();
+        void OnReleaseTimeout(ProtoTimer& theTimer);
+        char* GetEntryData(UINT32 entry) const
+            {return (pool_buffer + (size_t)entry * pkt_size_max);}
+        void Notify(Stream& stream, Event event, const char* data, unsigned int length)
+            {if (NULL != listener) listener->on_event(stream, event, data, length);}
+
+        // Playout heap (ordered by Stream::due_time)
+        void HeapUpdate(UINT32 index);
+        void HeapRemove(UINT32 index);
+        void HeapSiftUp(UINT32 pos);
+        void HeapSiftDown(UINT32 pos);
+        void HeapSet(UINT32 pos, UINT32 index)
+        {
+            heap[pos] = index;
+            stream_list[index].heap_index = pos;
+        }
+
+        class Listener
+        {
+            public:
+                virtual ~Listener() {}
+                virtual void on_event(Stream& stream, Event event, const char* data, unsigned int length) = 0;
+        };
+        template <class LTYPE>
+        class LISTENER_TYPE : public Listener
+        {
+            public:
+                LISTENER_TYPE(LTYPE* theListener, void(LTYPE::*eventHandler)(Stream&, Event, const char*, unsigned int))
+                    : listener(theListener), event_handler(eventHandler) {}
+                void on_event(Stream& stream, Event event, const char* data, unsigned int length)
+                    {(listener->*event_handler)(stream, event, data, length);}
+            private:
+                LTYPE*  listener;
+                void    (LTYPE::*event_handler)(Stream&, Event, const char*, unsigned int);
+        };
+
+        ProtoTimerMgr&  timer_mgr;
+        ProtoTimer      release_timer;
+        double          release_time;   // when "release_timer" will fire
+        double          playout_delay;
+        double          release_interval;
+        UINT32          clock_rate[ProtoPktRTP::PT_MAX];
+        Listener*       listener;
+
+        Stream*         stream_list;
+        unsigned int    stream_max;
+        unsigned int    stream_count;
+        UINT32          stream_free;
+        UINT32          lru_head;
+        UINT32          lru_tail;
+        UINT32*         hash_table;
+        UINT32          hash_mask;
+        UINT32*         heap;
+        unsigned int    heap_count;
+
+        UINT32*         ring_buffer;
+        UINT32          ring_mask;
+        Entry*          entry_list;
+        char*           pool_buffer;
+        unsigned int    pool_size;
+        unsigned int    pool_free_count;
+        UINT32          entry_free;
+        unsigned int    pkt_size_max;
+
+        unsigned long   invalid_count;
+        unsigned long   early_count;
+
+};  // end class ProtoRTPReceiver
+
+#endif // _PROTO_RTP_RECEIVER
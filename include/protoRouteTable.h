@@ -87,9 +87,9 @@ class ProtoRouteTable
                 void SetMetric(int value) 
                     {metric = value;}
                 
-                const ProtoAddress& GetDestination() const {return destination;}
+                ProtoAddress GetDestination() const {return destination.GetAddress();}
                 unsigned int GetPrefixSize() const {return prefix_size;}  // in bits
-                const ProtoAddress& GetGateway() const {return gateway;}
+                ProtoAddress GetGateway() const {return gateway.GetAddress();}
                 unsigned int GetInterfaceIndex() const {return iface_index;}
                 int GetMetric() const {return metric;}
 
@@ -115,9 +115,9 @@ class ProtoRouteTable
                 
                 void Init(const ProtoAddress& dstAddr, unsigned int prefixSize);
                 
-                ProtoAddress        destination;
+                ProtoCompactAddress destination;
                 unsigned int        prefix_size;  // in bits
-                ProtoAddress        gateway;
+                ProtoCompactAddress gateway;
                 unsigned int        iface_index;
                 int                 metric;
         };  // end class ProtoRouteTable::Entry
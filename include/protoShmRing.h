@@ -0,0 +1,157 @@
+#ifndef _PROTO_SHM_RING
+#define _PROTO_SHM_RING
+
+#include "protoChannel.h"
+#include "protoPipe.h"
+
+#ifndef WIN32  // (uses POSIX shared memory, see protoShmRing.cpp)
+
+/**
+ * @class ProtoShmRing
+ *
+ * @brief Shared-memory message ring for local interprocess communication,
+ * usable as a faster alternative to ProtoPipe when both ends are on the
+ * same host and can map the same memory.
+ *
+ * One process (the consumer) calls Listen() to create the ring.  Producer
+ * processes call Connect() with the same name and then Write() messages
+ * straight into the shared buffer; there is no per-message system call
+ * and the payload is copied only once in each direction.  The ring is
+ * either single-producer (the default) or multi-producer, with producers
+ * claiming space with an atomic compare-and-swap and publishing in
+ * claim order.
+ *
+ * Wakeups use eventfd() (or a pipe where eventfd is not available) and
+ * are only signaled when the other side is actually waiting, so a busy
+ * ring costs no system calls at all:
+ *
+ * - The consumer gets NOTIFY_INPUT when messages are available.  It
+ *   should Read() (or Peek()/Consume()) until the ring is empty.
+ *
+ * - A producer whose Write() is refused because the ring is full
+ *   (backpressure) can StartOutputNotification() and gets NOTIFY_OUTPUT
+ *   once the consumer has freed space.
+ *
+ * The listening consumer hands the shared memory and wakeup descriptors
+ * to producers over a STREAM ProtoPipe of the given name.  If the
+ * consumer has a notifier (e.g. a ProtoDispatcher) set _before_ Listen(),
+ * producer connections are accepted automatically; otherwise the consumer
+ * must call Accept() for each producer.  Connect() blocks until accepted.
+ *
+ * Notes:
+ *  - Messages are published in order and delivered in order.  With
+ *    multiple producers, a producer that stalls between claiming and
+ *    publishing space holds up the messages claimed after its own.
+ *  - Unix only (eventfd()/pipe() plus SCM_RIGHTS descriptor passing)
+ */
+class ProtoShmRing : public ProtoChannel
+{
+    public:
+        ProtoShmRing();
+        virtual ~ProtoShmRing();
+
+        enum
+        {
+            DEFAULT_BUFFER_SIZE = 4*1024*1024,
+            MESSAGE_MAX = 0x3fffffff          // (length field is 30 bits)
+        };
+
+        // Consumer side.  The "bufferSize" is rounded up to a power of two
+        bool Listen(const char*  theName,
+                    unsigned int bufferSize = DEFAULT_BUFFER_SIZE,
+                    bool         multiProducer = false);
+        bool Accept();
+
+        // Producer side
+        bool Connect(const char* theName);
+
+        void Close();
+
+        bool IsConsumer() const
+            {return (IsOpen() && is_consumer);}
+        bool IsProducer() const
+            {return (IsOpen() && !is_consumer);}
+        bool IsMultiProducer() const;
+        const char* GetName() const
+            {return ring_name;}
+        unsigned int GetBufferSize() const
+            {return ring_size;}
+
+        // Producer methods.  Write() returns false if the ring is full,
+        // in which case a NOTIFY_OUTPUT will be posted (if output
+        // notification is on) when space is available.
+        bool Write(const char* buffer, unsigned int numBytes);
+        // Publishes as many of the messages as fit (in one step, with at
+        // most one wakeup of the consumer) and returns how many did.
+        unsigned int WriteBatch(unsigned int        count,
+                                const char* const*  bufferList,
+                                const unsigned int* lengthList);
+
+        // Consumer methods.  Read() copies the next message and returns
+        // true with "numBytes" set to its length, or zero if the ring is
+        // empty.  If the buffer is too small, false is returned with
+        // "numBytes" set to the length needed and the message is kept.
+        bool Read(char* buffer, unsigned int& numBytes);
+        // Zero-copy batch access: Peek() points "bufferList" at up to
+        // "maxCount" pending messages in place, and Consume() releases
+        // the first "count" of them (their space is then reused).
+        unsigned int Peek(unsigned int   maxCount,
+                          const char**   bufferList,
+                          unsigned int*  lengthList);
+        void Consume(unsigned int count);
+        bool IsEmpty() const;
+
+        // For a producer, "output notification" refers to ring space
+        // rather than descriptor writability (see class notes)
+        bool StartOutputNotification();
+        void StopOutputNotification();
+        bool OutputNotification() const
+            {return output_wanted;}
+
+        // Shared counters (maintained by the consumer)
+        uint64_t GetMessageCount() const;
+        uint64_t GetByteCount() const;
+        // Producer count of refused Write() calls (this producer only)
+        uint64_t GetFullCount() const
+            {return full_count;}
+
+        // (producers get NOTIFY_ERROR if the consumer closes the ring)
+        void OnNotify(NotifyFlag theFlag);
+
+    private:
+        struct Control;
+
+        bool Map(int fd, unsigned int size, bool init);
+        bool OpenWakeup();
+        void Signal(int fd, uint64_t count);
+        bool Drain(int fd, bool semaphore);
+        unsigned int Reserve(unsigned int        count,
+                             const unsigned int* lengthList,
+                             uint64_t&           head,
+                             uint64_t&           end);
+        bool Pending(uint64_t& tail, uint64_t& head);
+        void OnRendezvousEvent(ProtoSocket&       theSocket,
+                               ProtoSocket::Event theEvent);
+
+        Control*        control;
+        char*           ring_buffer;
+        unsigned int    ring_size;
+        unsigned int    ring_mask;
+        bool            is_consumer;
+        int             shm_fd;
+        int             data_wait_fd;      // consumer polls this
+        int             data_signal_fd;    // producers write this
+        int             space_wait_fd;     // producers poll this
+        int             space_signal_fd;   // consumer writes this
+        ProtoPipe       rendezvous_pipe;
+        char            ring_name[PATH_MAX];
+        // producer state
+        bool            output_wanted;
+        bool            space_armed;
+        uint64_t        full_count;
+
+};  // end class ProtoShmRing
+
+#endif // !WIN32
+
+#endif // _PROTO_SHM_RING
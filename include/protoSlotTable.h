@@ -0,0 +1,160 @@
+#ifndef _PROTO_SLOT_TABLE
+#define _PROTO_SLOT_TABLE
+
+#include "protoDefs.h"
+#include "protoDebug.h"
+
+/**
+ * @class ProtoSlotTable
+ *
+ * @brief Fixed-capacity hash table of preallocated "slots" that are
+ * referenced by UINT32 index (with NIL as the null index), so nothing is
+ * allocated once it is initialized.  Free slots are kept on a list linked
+ * through the same "hash_next" member used for the hash bucket chains.
+ *
+ * The SLOT_TYPE must have "key" (a KEY_TYPE with an IsEqual() method),
+ * "hash" and "hash_next" (UINT32) members.  Users keep any other slot
+ * lists (e.g. timeout or LRU order) by index in their own slot members.
+ */
+template <class SLOT_TYPE, class KEY_TYPE>
+class ProtoSlotTable
+{
+    public:
+        enum {NIL = 0xffffffff};
+
+        ProtoSlotTable()
+         : slot_list(NULL), slot_max(0), slot_count(0), slot_free(NIL),
+           hash_table(NULL), hash_mask(0) {}
+        ~ProtoSlotTable()
+            {Destroy();}
+
+        // The hash table has at least "bucketsPerSlot" buckets per slot
+        bool Init(unsigned int slotMax, unsigned int bucketsPerSlot = 1);
+        void Destroy();
+        bool IsReady() const
+            {return (NULL != slot_list);}
+
+        SLOT_TYPE& operator[](UINT32 index)
+            {return slot_list[index];}
+        const SLOT_TYPE& operator[](UINT32 index) const
+            {return slot_list[index];}
+        unsigned int GetCount() const
+            {return slot_count;}
+        unsigned int GetMax() const
+            {return slot_max;}
+        bool IsFull() const
+            {return (NIL == slot_free);}
+
+        // Returns the index of the slot with the given key (or NIL)
+        UINT32 Find(const KEY_TYPE& key, UINT32 hash) const;
+        // Takes a free slot (NIL if full), setting its "key" and "hash"
+        UINT32 Insert(const KEY_TYPE& key, UINT32 hash);
+        // Returns the slot to the free list
+        void Remove(UINT32 index);
+
+    private:
+        SLOT_TYPE*      slot_list;
+        unsigned int    slot_max;
+        unsigned int    slot_count;
+        UINT32          slot_free;
+        UINT32*         hash_table;     // bucket chain heads
+        UINT32          hash_mask;
+};  // end class ProtoSlotTable
+
+template <class SLOT_TYPE, class KEY_TYPE>
+bool ProtoSlotTable<SLOT_TYPE, KEY_TYPE>::Init(unsigned int slotMax, unsigned int bucketsPerSlot)
+{
+    Destroy();
+    if ((0 == slotMax) || (slotMax >= (unsigned int)NIL) || (0 == bucketsPerSlot))
+    {
+        PLOG(PL_ERROR, "ProtoSlotTable::Init() error: invalid parameter\n");
+        return false;
+    }
+    UINT32 hashSize = 1;
+    while (hashSize < (bucketsPerSlot * slotMax)) hashSize <<= 1;
+    if (NULL == (slot_list = new SLOT_TYPE[slotMax]))
+    {
+        PLOG(PL_ERROR, "ProtoSlotTable::Init() new slot_list error: %s\n", GetErrorString());
+        return false;
+    }
+    if (NULL == (hash_table = new UINT32[hashSize]))
+    {
+        PLOG(PL_ERROR, "ProtoSlotTable::Init() new hash_table error: %s\n", GetErrorString());
+        Destroy();
+        return false;
+    }
+    for (UINT32 i = 0; i < hashSize; i++)
+        hash_table[i] = NIL;
+    for (UINT32 i = 0; i < slotMax; i++)
+        slot_list[i].hash_next = i + 1;
+    slot_list[slotMax - 1].hash_next = NIL;
+    slot_free = 0;
+    slot_max = slotMax;
+    slot_count = 0;
+    hash_mask = hashSize - 1;
+    return true;
+}  // end ProtoSlotTable::Init()
+
+template <class SLOT_TYPE, class KEY_TYPE>
+void ProtoSlotTable<SLOT_TYPE, KEY_TYPE>::Destroy()
+{
+    if (NULL != hash_table)
+    {
+        delete[] hash_table;
+        hash_table = NULL;
+    }
+    if (NULL != slot_list)
+    {
+        delete[] slot_list;
+        slot_list = NULL;
+    }
+    slot_max = slot_count = 0;
+    slot_free = NIL;
+    hash_mask = 0;
+}  // end ProtoSlotTable::Destroy()
+
+template <class SLOT_TYPE, class KEY_TYPE>
+UINT32 ProtoSlotTable<SLOT_TYPE, KEY_TYPE>::Find(const KEY_TYPE& key, UINT32 hash) const
+{
+    UINT32 index = hash_table[hash & hash_mask];
+    while (NIL != index)
+    {
+        const SLOT_TYPE& slot = slot_list[index];
+        if ((hash == slot.hash) && key.IsEqual(slot.key))
+            break;
+        index = slot.hash_next;
+    }
+    return index;
+}  // end ProtoSlotTable::Find()
+
+template <class SLOT_TYPE, class KEY_TYPE>
+UINT32 ProtoSlotTable<SLOT_TYPE, KEY_TYPE>::Insert(const KEY_TYPE& key, UINT32 hash)
+{
+    UINT32 index = slot_free;
+    if (NIL == index) return NIL;
+    SLOT_TYPE& slot = slot_list[index];
+    slot_free = slot.hash_next;
+    slot.key = key;
+    slot.hash = hash;
+    UINT32& head = hash_table[hash & hash_mask];
+    slot.hash_next = head;
+    head = index;
+    slot_count++;
+    return index;
+}  // end ProtoSlotTable::Insert()
+
+template <class SLOT_TYPE, class KEY_TYPE>
+void ProtoSlotTable<SLOT_TYPE, KEY_TYPE>::Remove(UINT32 index)
+{
+    SLOT_TYPE& slot = slot_list[index];
+    // Unlink from hash bucket chain
+    UINT32* prevNext = hash_table + (slot.hash & hash_mask);
+    while (index != *prevNext)
+        prevNext = &slot_list[*prevNext].hash_next;
+    *prevNext = slot.hash_next;
+    slot.hash_next = slot_free;
+    slot_free = index;
+    slot_count--;
+}  // end ProtoSlotTable::Remove()
+
+#endif // _PROTO_SLOT_TABLE
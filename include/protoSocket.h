@@ -215,6 +215,8 @@ class ProtoSocket : public ProtoNotify
 		bool SetEcnCapable(bool status);
 		bool SetTxBufferSize(unsigned int bufferSize);
 		unsigned int GetTxBufferSize();
+		// Kernel pacing (Linux SO_MAX_PACING_RATE), "rate" <= 0.0 removes the limit
+		bool SetMaxPacingRate(double bitsPerSecond);
 		bool SetRxBufferSize(unsigned int bufferSize);
 		unsigned int GetRxBufferSize();
         
@@ -0,0 +1,168 @@
+#ifndef _PROTO_SPACE_INDEX
+#define _PROTO_SPACE_INDEX
+
+/**
+* @class ProtoSpaceIndex
+*
+* @brief Uniform grid spatial index of ProtoSpace::Node items for fast
+* radius ("neighbors within range") and k-nearest neighbor queries.
+*
+* Whereas ProtoSpace keeps a sorted ordinate tree per dimension (and so
+* must remove and re-insert a node whenever it moves), ProtoSpaceIndex
+* hashes each node into a cubic grid cell.  A node's position is cached
+* in the index and refreshed by UpdateNode() (one node) or Update() (all
+* nodes), which only touch the grid when a node actually changes cells.
+* Rebuild() bulk loads a node set and lays the entries out in cell order
+* for good memory locality.  Queries only visit the cells overlapping
+* the search range and use the positions cached at the last update.
+*
+* The cell size should be on the order of the typical query radius.
+* Up to DIMENSIONS_MAX dimensions are supported (the index dimensionality
+* is set by the first node added).
+*
+* Queries do not modify the index, so FindNeighborsBatch() and
+* FindNearestBatch() split a list of queries across multiple threads.
+* The index must not be modified while queries are in progress.
+*/
+
+#include "protoSpace.h"
+#include "protoDefs.h"
+
+class ProtoSpaceIndex
+{
+    public:
+        ProtoSpaceIndex(double cellSize = 1.0);
+        ~ProtoSpaceIndex();
+
+        enum {DIMENSIONS_MAX = 3};
+
+        // Query result item
+        struct Neighbor
+        {
+            ProtoSpace::Node*   node;
+            double              distance;
+        };
+
+        // Changing the cell size re-grids any indexed nodes
+        bool SetCellSize(double cellSize);
+        double GetCellSize() const
+            {return cell_size;}
+        unsigned int GetDimensions() const
+            {return num_dimensions;}
+        unsigned int GetNodeCount() const
+            {return entry_count;}
+        void Empty();   // removes all nodes (retains memory)
+        void Destroy(); // removes all nodes and frees memory
+
+        // Replaces index content with the given node set
+        bool Rebuild(ProtoSpace::Node* const* nodeList, unsigned int nodeCount);
+        bool InsertNode(ProtoSpace::Node& node);
+        bool RemoveNode(ProtoSpace::Node& node);
+        bool ContainsNode(const ProtoSpace::Node& node) const
+            {return (FindEntry(&node) >= 0);}
+        // Refresh cached position of one node or of all nodes
+        bool UpdateNode(ProtoSpace::Node& node);
+        bool Update();
+
+        // Finds nodes within "radius" of "origin" (unsorted), storing up to
+        // "listMax" of them in "neighborList". Returns the total number of
+        // nodes found (which may exceed "listMax").  The "exclude" node
+        // (e.g., the querying node itself) is not reported.
+        unsigned int FindNeighbors(const double*                origin,
+                                   double                       radius,
+                                   Neighbor*                    neighborList,
+                                   unsigned int                 listMax,
+                                   const ProtoSpace::Node*      exclude = NULL) const;
+        // Finds the (up to) "k" nodes closest to "origin", sorted by
+        // increasing distance. Returns the number of nodes found.
+        unsigned int FindNearest(const double*              origin,
+                                 unsigned int               k,
+                                 Neighbor*                  neighborList,
+                                 const ProtoSpace::Node*    exclude = NULL) const;
+
+        // Batch queries about the current position of each "queryList" node
+        // (excluding the node itself).  The results for query "i" are
+        // stored at "resultList + i*listMax" with the count found stored
+        // in "countList[i]".  Queries are split across "numThreads" threads
+        // (including the calling thread).
+        bool FindNeighborsBatch(ProtoSpace::Node* const*    queryList,
+                                unsigned int                queryCount,
+                                double                      radius,
+                                Neighbor*                   resultList,
+                                unsigned int                listMax,
+                                unsigned int*               countList,
+                                unsigned int                numThreads = 1) const;
+        bool FindNearestBatch(ProtoSpace::Node* const*  queryList,
+                              unsigned int              queryCount,
+                              unsigned int              k,
+                              Neighbor*                 resultList,
+                              unsigned int*             countList,
+                              unsigned int              numThreads = 1) const;
+
+    private:
+        struct Entry
+        {
+            ProtoSpace::Node*   node;
+            double              pos[DIMENSIONS_MAX];
+            INT32               cell;  // index into cell_table
+            INT32               prev;  // cell member list links
+            INT32               next;
+        };
+        struct Cell
+        {
+            INT32               coord[DIMENSIONS_MAX];
+            INT32               head;  // first member entry
+            UINT32              count; // number of member entries
+            bool                used;
+        };
+        struct NodeSlot
+        {
+            const ProtoSpace::Node* node;
+            INT32                   entry;
+        };
+        class BatchJob;
+
+        bool SetDimensions(const ProtoSpace::Node& node);
+        bool ReserveEntries(unsigned int count);
+        void LoadPosition(Entry& entry) const;
+        void GetCellCoord(const double* pos, INT32* coord) const;
+        INT32 FindCell(const INT32* coord) const;
+        INT32 GetCell(const INT32* coord);
+        bool ResizeCellTable(unsigned int minSize);
+        void LinkEntry(INT32 index, INT32 cellIndex);
+        void UnlinkEntry(INT32 index);
+        bool PlaceEntry(INT32 index);
+        bool RefreshEntry(INT32 index);
+        INT32 FindEntry(const ProtoSpace::Node* node) const;
+        void MapNode(const ProtoSpace::Node* node, INT32 index);
+        void UnmapNode(const ProtoSpace::Node* node);
+        bool ResizeNodeTable(unsigned int minSize);
+
+        void ScanNeighbors(const Cell& cell, const double* origin, double radiusSquared,
+                           const ProtoSpace::Node* exclude, Neighbor* neighborList,
+                           unsigned int listMax, unsigned int& found) const;
+        void ScanNearest(INT32 cellIndex, const double* origin, unsigned int k,
+                         const ProtoSpace::Node* exclude, Neighbor* neighborList,
+                         unsigned int& found) const;
+        bool RunBatch(BatchJob* jobList, unsigned int numThreads) const;
+
+        double          cell_size;
+        double          cell_scale;  // 1.0 / cell_size
+        unsigned int    num_dimensions;
+
+        Entry*          entry_list;
+        unsigned int    entry_count;
+        unsigned int    entry_max;
+
+        Cell*           cell_table;  // open addressing (linear probing)
+        unsigned int    cell_mask;
+        unsigned int    cell_used;
+        INT32           cell_min[DIMENSIONS_MAX];  // bounds of cells ever used
+        INT32           cell_max[DIMENSIONS_MAX];
+
+        NodeSlot*       node_table;  // node -> entry index
+        unsigned int    node_mask;
+
+};  // end class ProtoSpaceIndex
+
+#endif // _PROTO_SPACE_INDEX
@@ -0,0 +1,218 @@
+#ifndef _PROTO_STATS
+#define _PROTO_STATS
+
+#include "protoDefs.h"
+#ifdef _MSC_VER
+#include <intrin.h>  // for _BitScanReverse64()
+#endif // _MSC_VER
+
+/**
+ * @class ProtoStats
+ *
+ * @brief Fixed-memory streaming statistics for measurements such as
+ * per-packet latencies or round trip times.  None of these allocate
+ * memory per sample:
+ *
+ * - ProtoStats::Summary keeps the count, min, max, mean and variance
+ *   (Welford's method) and can Merge() summaries of separate streams.
+ *
+ * - ProtoStats::Ewma is an exponentially weighted moving average and
+ *   deviation (e.g. as TCP's SRTT and RTTVAR with the default 1/8 gain).
+ *
+ * - ProtoStats::Histogram counts samples in log-linear buckets (as the
+ *   "HDR" histogram) with a fixed relative precision, for any number of
+ *   quantiles of a stream.  Histograms with the same configuration can be
+ *   merged, so each thread can Record() into its own histogram without
+ *   any locking and a reader merges them.  RecordConcurrent() can instead
+ *   be used by multiple threads recording into the same histogram.
+ *
+ * - ProtoStats::Quantile estimates a single quantile with the P-square
+ *   algorithm in constant (and tiny) memory.  It cannot be merged.
+ */
+class ProtoStats
+{
+    public:
+        class Summary
+        {
+            public:
+                Summary();
+
+                void Reset();
+                void Add(double value);
+                void Merge(const Summary& other);
+
+                unsigned long GetCount() const
+                    {return count;}
+                double GetMin() const
+                    {return min_value;}
+                double GetMax() const
+                    {return max_value;}
+                double GetMean() const
+                    {return mean;}
+                double GetVariance() const  // (sample variance)
+                    {return ((count > 1) ? (m2 / (double)(count - 1)) : 0.0);}
+                double GetStdDev() const;
+
+            private:
+                unsigned long   count;
+                double          min_value;
+                double          max_value;
+                double          mean;
+                double          m2;    // (sum of squared differences from the mean)
+        };  // end class ProtoStats::Summary
+
+        class Ewma
+        {
+            public:
+                Ewma(double gain = 0.125);
+
+                void SetGain(double gain)
+                    {ewma_gain = gain;}
+                void Reset()
+                {
+                    valid = false;
+                    mean = variance = 0.0;
+                }
+                void Add(double value)
+                {
+                    if (valid)
+                    {
+                        double delta = value - mean;
+                        mean += ewma_gain * delta;
+                        variance = (1.0 - ewma_gain) * (variance + ewma_gain * delta * delta);
+                    }
+                    else
+                    {
+                        mean = value;
+                        variance = 0.0;
+                        valid = true;
+                    }
+                }
+                bool IsValid() const
+                    {return valid;}
+                double GetMean() const
+                    {return mean;}
+                double GetVariance() const
+                    {return variance;}
+                double GetStdDev() const;
+
+            private:
+                double  ewma_gain;
+                bool    valid;
+                double  mean;
+                double  variance;
+        };  // end class ProtoStats::Ewma
+
+        class Histogram
+        {
+            public:
+                Histogram();
+                ~Histogram();
+
+                // Values from zero to "maxValue" are counted with a resolution of
+                // "minValue" and a relative precision of 2^-"precisionBits" (values
+                // below zero count as zero and above "maxValue" as "maxValue")
+                bool Init(double minValue, double maxValue, unsigned int precisionBits = 5);
+                void Destroy();
+                bool IsReady() const
+                    {return (NULL != bucket_list);}
+                void Reset();
+
+                void Record(double value, unsigned long count = 1)
+                {
+                    unsigned int index = GetIndex(value);
+                    bucket_list[index] += count;
+                    total_count += count;
+                    if (value < min_value) min_value = value;
+                    if (value > max_value) max_value = value;
+                    value_sum += value * (double)count;
+                }
+                // (lock-free; safe for any number of recording threads)
+                void RecordConcurrent(double value, unsigned long count = 1);
+
+                // Adds another histogram's counts (it must have the same configuration)
+                bool Merge(const Histogram& other);
+
+                uint64_t GetCount() const
+                    {return total_count;}
+                double GetMin() const
+                    {return ((0 != total_count) ? min_value : 0.0);}
+                double GetMax() const
+                    {return ((0 != total_count) ? max_value : 0.0);}
+                double GetMean() const
+                    {return ((0 != total_count) ? (value_sum / (double)total_count) : 0.0);}
+                // Returns the value at the given quantile (0.0 to 1.0, e.g. 0.99)
+                double GetQuantile(double quantile) const;
+
+                unsigned int GetBucketCount() const
+                    {return bucket_count;}
+
+            private:
+                unsigned int GetIndex(double value) const
+                {
+                    uint64_t units = (value > 0.0) ? (uint64_t)(value * unit_scale) : 0;
+                    if (units > max_units) units = max_units;
+                    if (units < (sub_count << 1)) return (unsigned int)units;
+                    // (log-linear:  "sub_count" buckets per power of two)
+                    unsigned int shift = GetHighBit(units) - precision_bits;
+                    return (unsigned int)((shift * sub_count) + (units >> shift));
+                }
+                // Index of the highest bit set in a non-zero value
+                static unsigned int GetHighBit(uint64_t value)
+                {
+#if defined(__GNUC__) || defined(__clang__)
+                    return (63 - __builtin_clzll(value));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+                    unsigned long bit;
+                    _BitScanReverse64(&bit, value);
+                    return (unsigned int)bit;
+#else
+                    unsigned int bit = 0;
+                    while (0 != (value >>= 1)) bit++;
+                    return bit;
+#endif // if/else __GNUC__ || __clang__ / _MSC_VER 64-bit
+                }
+                double GetBucketValue(unsigned int index) const;
+
+                double          unit;           // (resolution)
+                double          unit_scale;     // (1.0 / unit)
+                unsigned int    precision_bits;
+                uint64_t        sub_count;      // 2^precision_bits
+                uint64_t        max_units;
+                uint64_t*       bucket_list;
+                unsigned int    bucket_count;
+                uint64_t        total_count;
+                double          min_value;
+                double          max_value;
+                double          value_sum;
+        };  // end class ProtoStats::Histogram
+
+        class Quantile
+        {
+            public:
+                Quantile(double quantile = 0.5);
+
+                void Reset();
+                void Add(double value);
+
+                unsigned long GetCount() const
+                    {return count;}
+                double GetQuantile() const
+                    {return quantile;}
+                double GetValue() const;  // (the current estimate)
+
+            private:
+                double Parabolic(int i, int d) const;
+                double Linear(int i, int d) const;
+
+                double          quantile;
+                unsigned long   count;
+                double          height[5];      // marker heights
+                double          position[5];    // marker positions
+                double          desired[5];     // desired marker positions
+                double          increment[5];   // desired position increments
+        };  // end class ProtoStats::Quantile
+
+};  // end class ProtoStats
+
+#endif // _PROTO_STATS
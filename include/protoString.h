@@ -26,6 +26,12 @@
        file path delimiters from directory prefixes (reverse split, maxCount=1) or leading, 
        extraneous file path delimiters from the file name portion (forward split, maxCount=1)
        
+    5) SetDelimiters() sets multiple delimiter characters (any one of which separates items)
+       
+  GetNextSpan() is a zero-copy, non-allocating alternative to GetNextItem() that returns 
+  each item as a (pointer, length) span into the text being parsed.  (Delimiters are found
+  using a lookup table or, for a single delimiter character, strchr() which libc vectorizes)
+       
 *******************/
 
 
@@ -49,13 +55,21 @@ class ProtoTokenator
                                                            // Otherwise, returned pointer is only valid until next
                                                            // call to GetNextItem() or ProtoTokenator destruction
         
+        // Returns false when there are no more items.  Otherwise "item" points to the next
+        // item (_not_ NUL-terminated) within the text, with "length" characters
+        bool GetNextSpan(const char*& item, unsigned int& length);
+        
         const char* GetNextPtr() const  // pointer to unparsed remainder
             {return next_ptr;}
         
         void Reset(const char* text=NULL, char delimiter='\0');  // default args retain current text/delimiter values
         
+        // Any character in the "delimiters" string separates items (whitespace 
+        // delimiters match all whitespace, as for a single whitespace delimiter)
+        void SetDelimiters(const char* delimiters);
+        
         void SetNullDelimiter() // with "stripWhitespace" enabled, this enables
-            {token = '\0';}     // simple leading/trailing stripping
+            {SetToken('\0');}   // simple leading/trailing stripping
         
         // If this is called, caller is responsible to delete
         // the memory allocated for the previous item returned.
@@ -64,12 +78,20 @@ class ProtoTokenator
         {
             char* item = (char*)prev_item;
             prev_item = NULL;
+            prev_size = 0;
             return item;
         }
-        bool TokenMatch(char c) const;
+        bool TokenMatch(char c) const
+            {return (('\0' != c) && delim_table[(unsigned char)c]);}
         
     private:
+        void SetToken(char delimiter);
+        const char* FindToken(const char* ptr) const;  // returns NULL at end of text
+        
         char         token;
+        bool         delim_table[256];  // (also set for '\0' to end scans)
+        bool         space_delim;       // delimiters include whitespace
+        bool         single_delim;      // one, non-whitespace delimiter
         bool         strip_whitespace; // strip leading/trailing whitespace if true
         bool         strip_tokens;     // string leading/trailing tokens if true
         bool         reverse;
@@ -78,6 +100,7 @@ class ProtoTokenator
         const char*  text_ptr;
         const char*  next_ptr;
         char*        prev_item;
+        unsigned int prev_size;        // (allocated size of "prev_item")
 };  // end class ProtoTokenator
 
 #endif // !_PROTO_STRING
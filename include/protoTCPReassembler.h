@@ -0,0 +1,241 @@
+#ifndef _PROTO_TCP_REASSEMBLER
+#define _PROTO_TCP_REASSEMBLER
+
+/**
+* @class ProtoTCPReassembler
+*
+* @brief Reconstructs the byte streams of TCP connections from captured
+* packets (e.g., as received via ProtoCap) and delivers them in order
+* through a listener callback.
+*
+* Connections are tracked in a hash table of preallocated entries.  A
+* segment arriving in order is delivered directly from the packet buffer
+* (zero copy); segments arriving out of order are copied into fixed-size
+* blocks from a shared pool and delivered once the missing data arrives.
+* Retransmitted and overlapping data is trimmed (data already received is
+* retained).  The SYN/FIN/RST lifecycle is followed, and connections whose
+* SYN was missed are picked up mid-stream (where the lower port is assumed
+* to be the server).
+*
+* Memory is bounded both per stream ("streamBufferMax" bytes of out of
+* order data) and in aggregate (the block pool size).  When a limit is hit,
+* the stream skips ahead over its first gap (reported as EVENT_GAP) so the
+* buffered data can be delivered, and if the pool is still exhausted the
+* least recently active connection is evicted.  A full connection table
+* also evicts the least recently active connection.
+*
+* Listener callbacks must not call back into the reassembler (other than
+* Connection user data access).  IP fragments are ignored, so fragmented
+* traffic should be passed through ProtoIPReassembler first.
+*/
+
+#include "protoPktIP.h"
+#include "protoSlotTable.h"
+#include "protoTime.h"
+
+class ProtoTCPReassembler
+{
+    public:
+        ProtoTCPReassembler();
+        ~ProtoTCPReassembler();
+
+        enum
+        {
+            DEFAULT_CONNECTION_MAX  = 4096,
+            DEFAULT_STREAM_BUFFER   = 256*1024,     // bytes
+            DEFAULT_MEMORY_MAX      = 16*1024*1024  // bytes
+        };
+        enum Direction
+        {
+            CLIENT_TO_SERVER = 0,
+            SERVER_TO_CLIENT = 1
+        };
+        enum Event
+        {
+            EVENT_OPEN,     // new connection (before any data)
+            EVENT_DATA,     // in-order stream data
+            EVENT_GAP,      // "length" bytes of missing stream data skipped
+            EVENT_CLOSE,    // both directions finished (FIN)
+            EVENT_RESET,    // connection reset (RST)
+            EVENT_TIMEOUT,  // idle timeout (or Flush())
+            EVENT_EVICT     // removed to free resources
+        };
+
+        class Connection
+        {
+            public:
+                bool GetClientAddr(ProtoAddress& addr) const
+                    {return GetEndpointAddr(client, addr);}
+                bool GetServerAddr(ProtoAddress& addr) const
+                    {return GetEndpointAddr(1 - client, addr);}
+                // Stream bytes delivered (or skipped as gaps) so far
+                unsigned long GetStreamBytes(Direction dir) const
+                    {return stream[dir].delivered;}
+                double GetLastTime() const
+                    {return last_time;}
+
+                void SetUserData(void* userData)
+                    {user_data = userData;}
+                void* GetUserData() const
+                    {return user_data;}
+
+            private:
+                friend class ProtoTCPReassembler;
+                template <class SLOT_TYPE, class KEY_TYPE> friend class ::ProtoSlotTable;
+                class Key
+                {
+                    public:
+                        UINT32      addr[2][4];  // endpoint addresses (lower endpoint first)
+                        UINT16      port[2];
+                        UINT8       version;
+                        UINT8       reserved[3];  // (always zero)
+                        UINT32 GetHash() const;
+                        bool IsEqual(const Key& key) const
+                            {return (0 == memcmp(this, &key, sizeof(Key)));}
+                };
+                struct Stream
+                {
+                    UINT32          next_seq;       // next in-order sequence number
+                    UINT32          fin_seq;        // sequence number of FIN
+                    UINT32          block_head;     // out-of-order blocks (by sequence)
+                    UINT32          buffered;       // out-of-order bytes buffered
+                    unsigned long   delivered;
+                    bool            initialized;
+                    bool            fin_seen;
+                    bool            closed;
+                };
+
+                bool GetEndpointAddr(unsigned int endpoint, ProtoAddress& addr) const;
+
+                Key         key;
+                UINT32      hash;
+                UINT32      hash_next;  // hash bucket chain (or free list)
+                UINT32      lru_prev;   // activity list, least recent first
+                UINT32      lru_next;
+                double      last_time;
+                void*       user_data;
+                UINT8       client;     // endpoint (0 or 1) that is the client
+                Stream      stream[2];  // by Direction
+        };  // end class ProtoTCPReassembler::Connection
+
+        // Up to "connectionMax" concurrent connections, "streamBufferMax" out of order
+        // bytes per stream and "memoryMax" bytes of out of order data in total
+        bool Open(unsigned int  connectionMax = DEFAULT_CONNECTION_MAX,
+                  unsigned int  streamBufferMax = DEFAULT_STREAM_BUFFER,
+                  unsigned int  memoryMax = DEFAULT_MEMORY_MAX);
+        void Close();  // (discards connections without notification)
+        bool IsOpen() const
+            {return connection_table.IsReady();}
+
+        // Connections whose SYN was not seen are tracked only if "midstream" is enabled
+        void SetMidstream(bool enable)
+            {midstream = enable;}
+        bool GetMidstream() const
+            {return midstream;}
+
+        template <class LTYPE>
+        bool SetListener(LTYPE* theListener, void(LTYPE::*eventHandler)(Connection&, Event, Direction, const char*, unsigned int))
+        {
+            if (NULL != listener) delete listener;
+            listener = theListener ? new LISTENER_TYPE<LTYPE>(theListener, eventHandler) : NULL;
+            return (NULL == listener) ? (NULL != theListener) : true;
+        }
+
+        // Returns false if "ipPkt" is not a (first fragment) TCP packet
+        bool Process(ProtoPktIP& ipPkt, const ProtoTime& pktTime);
+
+        // Times out connections idle for longer than "idleTimeout" as of "currentTime"
+        // (after delivering any data buffered beyond gaps)
+        void Expire(const ProtoTime& currentTime, double idleTimeout);
+        // Times out all connections
+        void Flush();
+
+        unsigned int GetConnectionCount() const
+            {return connection_table.GetCount();}
+        unsigned int GetBlockCount() const  // pool blocks in use
+            {return (block_max - block_free_count);}
+        unsigned long GetSegmentCount() const
+            {return segment_count;}
+        unsigned long GetOutOfOrderCount() const
+            {return ooo_count;}
+        unsigned long GetOverlapCount() const
+            {return overlap_count;}
+        unsigned long GetGapCount() const
+            {return gap_count;}
+        unsigned long GetEvictCount() const
+            {return evict_count;}
+
+    private:
+        enum
+        {
+            NIL         = 0xffffffff,
+            BLOCK_SIZE  = 2048
+        };
+        struct Block
+        {
+            UINT32  seq;
+            UINT32  length;
+            UINT32  next;
+            char    data[BLOCK_SIZE];
+        };
+
+        static bool SeqLess(UINT32 a, UINT32 b)
+            {return ((INT32)(a - b) < 0);}
+        static bool SeqLessEqual(UINT32 a, UINT32 b)
+            {return ((INT32)(a - b) <= 0);}
+
+        UINT32 AddConnection(const Connection::Key& key, UINT32 hash, UINT8 client, double theTime);
+        void RemoveConnection(UINT32 index, Event event);
+        void Touch(UINT32 index, double theTime);
+        void Deliver(Connection& connection, Direction dir, UINT32 seq, const char* data, unsigned int length);
+        void Drain(Connection& connection, Direction dir);
+        void SkipGap(Connection& connection, Direction dir);
+        void CheckClosed(UINT32 index);
+        bool Buffer(Connection& connection, Direction dir, UINT32 seq, const char* data, unsigned int length);
+        bool InsertBlocks(Connection::Stream& stream, UINT32* prevNext, UINT32 seq, const char* data, unsigned int length);
+        UINT32 AllocBlock();
+        void FreeBlocks(Connection::Stream& stream);
+        void Notify(Connection& connection, Event event, Direction dir, const char* data, unsigned int length)
+            {if (NULL != listener) listener->on_event(connection, event, dir, data, length);}
+
+        class Listener
+        {
+            public:
+                virtual ~Listener() {}
+                virtual void on_event(Connection& connection, Event event, Direction dir, const char* data, unsigned int length) = 0;
+        };
+        template <class LTYPE>
+        class LISTENER_TYPE : public Listener
+        {
+            public:
+                LISTENER_TYPE(LTYPE* theListener, void(LTYPE::*eventHandler)(Connection&, Event, Direction, const char*, unsigned int))
+                    : listener(theListener), event_handler(eventHandler) {}
+                void on_event(Connection& connection, Event event, Direction dir, const char* data, unsigned int length)
+                    {(listener->*event_handler)(connection, event, dir, data, length);}
+            private:
+                LTYPE*  listener;
+                void    (LTYPE::*event_handler)(Connection&, Event, Direction, const char*, unsigned int);
+        };
+
+        Listener*       listener;
+        bool            midstream;
+
+        ProtoSlotTable<Connection, Connection::Key> connection_table;
+        UINT32          lru_head;
+        UINT32          lru_tail;
+
+        Block*          block_list;
+        unsigned int    block_max;
+        unsigned int    block_free_count;
+        UINT32          block_free;     // free list (linked via "next")
+        unsigned int    stream_buffer_max;
+
+        unsigned long   segment_count;
+        unsigned long   ooo_count;
+        unsigned long   overlap_count;
+        unsigned long   gap_count;
+        unsigned long   evict_count;
+
+};  // end class ProtoTCPReassembler
+
+#endif // _PROTO_TCP_REASSEMBLER
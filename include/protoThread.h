@@ -21,6 +21,7 @@ class ProtoMutex
         // TBD - add TryLock() call?
         
     private:
+        friend class ProtoCondition;
 #ifdef WIN32
         CRITICAL_SECTION mutex;
 #else
@@ -28,6 +29,27 @@ class ProtoMutex
 #endif // if/else WIN32/UNIX
 };  // end class ProtoMutex
 
+// Condition variable for use with a ProtoMutex
+class ProtoCondition
+{
+    public:
+        ProtoCondition();
+        ~ProtoCondition();
+        
+        // The "mutex" must be locked by the caller and is
+        // released while waiting (spurious wakeups are possible)
+        void Wait(ProtoMutex& mutex);
+        void Signal();     // wakes one waiting thread
+        void Broadcast();  // wakes all waiting threads
+        
+    private:
+#ifdef WIN32
+        CONDITION_VARIABLE  cond;
+#else
+        pthread_cond_t      cond;
+#endif // if/else WIN32/UNIX
+};  // end class ProtoCondition
+
 class ProtoThread
 {
     public:
@@ -69,8 +91,8 @@ class ProtoThread
     private:
 #ifdef WIN32
         typedef DWORD ExitStatus;
-        ExitStatus GetExitStatus()  // pthread uses a _pointer_ to the status value location
-             {return &exit_status;} 
+        ExitStatus GetExitStatus()
+             {return (ExitStatus)exit_status;} 
         static unsigned int __stdcall DoThreadStart(void* lpParameter);
         static void DoThreadExit(ExitStatus exitStatus) 
             {ExitThread(exitStatus);}      
@@ -84,6 +106,9 @@ class ProtoThread
 #endif  // if/else WIN32    
             
         ThreadId    thread_id;
+#ifdef WIN32
+        HANDLE      actual_thread_handle;
+#endif // WIN32
         bool        external_thread;
         bool        thread_running;
         int         exit_code;
@@ -0,0 +1,256 @@
+#ifndef _PROTO_THREAD_POOL
+#define _PROTO_THREAD_POOL
+
+/**
+* @class ProtoThreadPool
+*
+* @brief Worker thread pool for moving heavy work (route computation,
+* parsing, crypto, etc) out of ProtoDispatcher callbacks.
+*
+* A Task subclass overrides Run(), which is called in a worker thread, and
+* is Submit()ted from a dispatcher callback.  When Run() returns, the task
+* is posted back to the dispatcher thread where its listener is notified.
+* Each worker has its own bounded queue; Submit() spreads tasks across the
+* queues round-robin and an idle worker "steals" from the other queues
+* before waiting, so a few long tasks don't hold up those queued behind
+* them.  Submit() fails (backpressure) when all queues are full.
+*
+* Completed tasks are pushed onto a lock-free (compare-and-swap) list, and
+* the pool's ProtoEvent is set only when that list was empty, so a burst of
+* completions costs the dispatcher a single wakeup.  The list is drained in
+* completion order when the event is notified.  By default completions go
+* to the dispatcher set with SetNotifier(); a CompletionQueue given to
+* Submit() delivers them to another dispatcher (thread) instead.
+*
+* Each task records when it was submitted, started and completed, and the
+* pool keeps totals of these times (updated as tasks are delivered).
+*
+* Notes:
+*  - A Task must not be deleted (or resubmitted) while IsPending().
+*  - Close() waits for running tasks to finish.  Tasks still queued are
+*    CANCELLED and completions not yet delivered by the pool's own queue
+*    are discarded (as they are when a CompletionQueue is destroyed).
+*/
+
+#include "protoAtomic.h"
+#include "protoThread.h"
+#include "protoEvent.h"
+#include "protoTime.h"
+
+class ProtoThreadPool
+{
+    public:
+        ProtoThreadPool();
+        ~ProtoThreadPool();
+
+        enum
+        {
+            THREAD_MAX          = 64,
+            DEFAULT_QUEUE_SIZE  = 256
+        };
+
+        class CompletionQueue;
+
+        class Task
+        {
+            public:
+                Task();
+                virtual ~Task();
+
+                enum Status
+                {
+                    IDLE,
+                    QUEUED,
+                    RUNNING,
+                    COMPLETE,   // (Run() finished, completion pending or delivered)
+                    CANCELLED
+                };
+
+                // Called in a worker thread
+                virtual void Run() = 0;
+
+                // The completion handler is called in the dispatcher thread
+                template <class LTYPE>
+                bool SetListener(LTYPE* theListener, void(LTYPE::*completionHandler)(Task&))
+                {
+                    if (NULL != listener) delete listener;
+                    listener = (NULL != theListener) ? new LISTENER_TYPE<LTYPE>(theListener, completionHandler) : NULL;
+                    return ((NULL != listener) || (NULL == theListener));
+                }
+
+                Status GetStatus() const
+                    {return (Status)ProtoAtomic::Load(&status);}
+                bool IsPending() const
+                {
+                    Status theStatus = GetStatus();
+                    return ((QUEUED == theStatus) || (RUNNING == theStatus) ||
+                            ((COMPLETE == theStatus) && !delivered));
+                }
+                // Index of the worker that ran the task
+                unsigned int GetWorkerIndex() const
+                    {return worker_index;}
+
+                // Timing (seconds) of the last completed run
+                double GetQueueTime() const     // submitted to started
+                    {return ProtoTime::Delta(start_time, submit_time);}
+                double GetRunTime() const       // started to completed
+                    {return ProtoTime::Delta(end_time, start_time);}
+                double GetDeliveryTime() const  // completed to delivered
+                    {return ProtoTime::Delta(deliver_time, end_time);}
+
+            private:
+                friend class ProtoThreadPool;
+                friend class CompletionQueue;
+
+                class Listener
+                {
+                    public:
+                        virtual ~Listener() {}
+                        virtual void on_complete(Task& theTask) = 0;
+                };
+                template <class LTYPE>
+                class LISTENER_TYPE : public Listener
+                {
+                    public:
+                        LISTENER_TYPE(LTYPE* theListener, void(LTYPE::*completionHandler)(Task&))
+                            : listener(theListener), completion_handler(completionHandler) {}
+                        void on_complete(Task& theTask)
+                            {(listener->*completion_handler)(theTask);}
+                    private:
+                        LTYPE*  listener;
+                        void    (LTYPE::*completion_handler)(Task&);
+                };
+
+                void SetStatus(Status theStatus)
+                    {ProtoAtomic::Store(&status, (int)theStatus);}
+
+                Listener*           listener;
+                int                 status;
+                bool                delivered;
+                unsigned int        worker_index;
+                CompletionQueue*    completion_queue;
+                Task*               next;           // (completion list link)
+                ProtoTime           submit_time;
+                ProtoTime           start_time;
+                ProtoTime           end_time;
+                ProtoTime           deliver_time;
+        };  // end class ProtoThreadPool::Task
+
+        // Delivers completed tasks to the dispatcher (thread) it is attached to
+        class CompletionQueue : private ProtoEvent
+        {
+            public:
+                CompletionQueue(ProtoThreadPool& thePool);
+                ~CompletionQueue();
+
+                bool SetNotifier(ProtoEvent::Notifier* theNotifier);
+                bool IsOpen() const
+                    {return ProtoEvent::IsOpen();}
+
+                // Delivers any completed tasks now (called upon notification)
+                void Drain();
+
+            private:
+                friend class ProtoThreadPool;
+                bool Open();
+                void Push(Task& theTask);
+                void Discard();
+                void OnEvent(ProtoEvent& theEvent);
+
+                ProtoThreadPool&    pool;
+                Task*               head;       // (lock-free LIFO push list)
+        };  // end class ProtoThreadPool::CompletionQueue
+
+        // Starts "numThreads" workers (zero means one per processor),
+        // each with a queue of up to "queueSize" tasks
+        bool Open(unsigned int numThreads = 0,
+                  unsigned int queueSize = DEFAULT_QUEUE_SIZE);
+        void Close();
+        bool IsOpen() const
+            {return (0 != worker_count);}
+        unsigned int GetThreadCount() const
+            {return worker_count;}
+
+        // Default completion delivery (e.g. a ProtoDispatcher)
+        bool SetNotifier(ProtoEvent::Notifier* theNotifier)
+            {return completion_queue.SetNotifier(theNotifier);}
+
+        // Returns false if the pool is closed, the task is pending or all
+        // queues are full.  (may be called from any thread, including workers)
+        bool Submit(Task& theTask, CompletionQueue* completionQueue = NULL);
+
+        // Statistics (the times are seconds, totals over delivered tasks)
+        unsigned long GetSubmitCount() const
+            {return ProtoAtomic::LoadRelaxed(&submit_count);}
+        unsigned long GetRejectCount() const
+            {return ProtoAtomic::LoadRelaxed(&reject_count);}
+        unsigned long GetCompleteCount() const
+            {return complete_count;}
+        unsigned long GetStealCount() const;
+        double GetQueueTimeTotal() const
+            {return queue_time_total;}
+        double GetQueueTimeMax() const
+            {return queue_time_max;}
+        double GetRunTimeTotal() const
+            {return run_time_total;}
+        double GetRunTimeMax() const
+            {return run_time_max;}
+        void ResetStats();
+
+    private:
+        class Worker
+        {
+            public:
+                Worker(ProtoThreadPool& thePool, unsigned int theIndex, unsigned int queueSize);
+                ~Worker();
+
+                bool Push(Task& theTask);
+                Task* Pop();
+
+                class Thread : public ProtoThread
+                {
+                    public:
+                        Thread(ProtoThreadPool& thePool, Worker& theWorker)
+                            : pool(thePool), worker(theWorker) {}
+                        int RunThread()
+                            {return pool.RunWorker(worker);}
+                    private:
+                        ProtoThreadPool&    pool;
+                        Worker&             worker;
+                };
+
+                Thread          thread;
+                unsigned int    index;
+                ProtoMutex      mutex;          // (protects the queue)
+                Task**          queue;
+                unsigned int    queue_size;
+                unsigned int    queue_head;
+                unsigned int    queue_count;
+                unsigned long   steal_count;
+        };  // end class ProtoThreadPool::Worker
+
+        int RunWorker(Worker& worker);
+        Task* GetTask(Worker& worker);
+        void OnComplete(Task& theTask);
+
+        Worker*             worker_list[THREAD_MAX];
+        unsigned int        worker_count;
+        unsigned int        next_worker;    // (round-robin submission)
+        unsigned int        pending_count;  // (queued tasks, atomic)
+        unsigned int        idle_count;     // (waiting workers, atomic)
+        bool                stopping;
+        ProtoMutex          mutex;
+        ProtoCondition      work_cond;
+        CompletionQueue     completion_queue;
+
+        unsigned long       submit_count;
+        unsigned long       reject_count;
+        unsigned long       complete_count;
+        double              queue_time_total;
+        double              queue_time_max;
+        double              run_time_total;
+        double              run_time_max;
+
+};  // end class ProtoThreadPool
+
+#endif // _PROTO_THREAD_POOL
@@ -374,6 +374,29 @@ class ProtoTimerMgr
         }
         
         virtual void GetSystemTime(struct timeval& currentTime);
+        
+        /**
+         * Virtual time mode: timer timeouts (and GetSystemTime()) are based
+         * on a virtual clock that starts at the current real time and is only
+         * advanced by AdvanceVirtualTime().  A ProtoDispatcher in this mode
+         * jumps its clock directly to the next timeout whenever no I/O is
+         * ready, so timer-driven logic runs much faster than real time.  
+         * (Set this before activating timers; code that reads the time of day
+         * directly instead of via GetSystemTime() will see real time)
+         * Virtual time is not supported for a threaded ProtoDispatcher: 
+         * SetVirtualTime(true) fails once its StartThread() has been called and 
+         * StartThread() fails while virtual time is set.  Returns false if the 
+         * mode could not be set.
+         */
+        virtual bool SetVirtualTime(bool state);
+        bool IsVirtualTime() const
+            {return virtual_time;}
+        /**
+         * Advances the virtual clock to the next timeout (but by no more than 
+         * "maxDelay" seconds, if non-negative) and services the timers that
+         * are due.  Returns false if there was no timeout to advance to.
+         */
+        bool AdvanceVirtualTime(double maxDelay = -1.0);
 
 #ifdef _SORTED_TIMERS        
         // These are for testing
@@ -434,6 +457,11 @@ class ProtoTimerMgr
         
         void GetCurrentSystemTime(struct timeval& currentTime)
         {
+            if (virtual_time)
+            {
+                currentTime = virtual_now.GetTimeVal();
+                return;
+            }
 #if (defined(SIMULATE) && defined(NS2))
             GetSystemTime(currentTime);
 #else
@@ -445,6 +473,11 @@ class ProtoTimerMgr
         // find its simulation context
         void GetCurrentProtoTime(ProtoTime& currentTime)
         {
+            if (virtual_time)
+            {
+                currentTime = virtual_now;
+                return;
+            }
 #if (defined(SIMULATE) && defined(NS2))
            GetSystemTime(currentTime.AccessTimeVal());
 #else
@@ -458,6 +491,8 @@ class ProtoTimerMgr
         ProtoTime       scheduled_timeout;
         ProtoTimer      pulse_timer;  // one second pulse timer
         ProtoTime       pulse_mark;
+        bool            virtual_time;
+        ProtoTime       virtual_now;
 
 #ifdef _SORTED_TIMERS   
         unsigned int    timer_list_count;
@@ -0,0 +1,189 @@
+#ifndef _PROTO_TRACE
+#define _PROTO_TRACE
+
+#include "protoDefs.h"
+#include "protoAtomic.h"
+#include "protoTime.h"
+
+#ifdef _MSC_VER
+#define PROTO_TRACE_TLS __declspec(thread)
+#else
+#define PROTO_TRACE_TLS __thread
+#endif // if/else _MSC_VER
+
+/**
+ * @class ProtoTrace
+ *
+ * @brief Lightweight event tracing for seeing where time goes inside the
+ * ProtoDispatcher loop (Wait(), Dispatch(), ProtoTimer timeouts, ProtoSocket
+ * notifications and I/O calls) and in application code such as packet parsers.
+ *
+ * Trace points record begin/end spans, instant events and counter values
+ * into a per-thread ring buffer (created on a thread's first event) using
+ * the CPU timestamp counter, so recording an event costs little more than
+ * reading the counter and takes no locks.  Each ring keeps the most recent events (like a
+ * flight recorder) if it wraps.  Write() saves the buffers to a compact
+ * binary trace file (see protoTrace.cpp for the format) that can be
+ * converted with ConvertToJson() to the Chrome trace event JSON format for
+ * viewing with ui.perfetto.dev or chrome://tracing.
+ *
+ * The PROTO_TRACE_*() macros below compile to nothing unless USE_PROTO_TRACE
+ * is defined (e.g. cmake -DPROTOKIT_TRACE=ON), so the built-in trace points
+ * cost nothing in normal builds.  Category and name strings must be string
+ * literals (or otherwise persist until the trace is written), since only
+ * their pointers are recorded.
+ */
+class ProtoTrace
+{
+    public:
+        enum EventType
+        {
+            EVENT_INVALID = 0,
+            EVENT_BEGIN,    // span begin
+            EVENT_END,      // span end
+            EVENT_INSTANT,  // point in time
+            EVENT_COUNTER   // counter "value" sample
+        };
+
+        enum {DEFAULT_BUFFER_EVENTS = 65536};  // (2 MB per thread on 64-bit systems)
+
+        // Starts recording (each thread's ring holds "bufferEvents" events,
+        // rounded up to a power of 2).  Buffers already created by an earlier
+        // trace are cleared and reused (keeping their size).
+        static bool Start(unsigned int bufferEvents = DEFAULT_BUFFER_EVENTS);
+        static void Stop();
+        static bool IsActive()
+            {return ProtoAtomic::LoadRelaxed(&active);}
+
+        // Names the calling thread in the trace (copied, up to 31 characters)
+        static void SetThreadName(const char* name);
+
+        // Writes the events recorded so far to a binary trace file (this may
+        // be called while tracing is active)
+        static bool Write(const char* path);
+
+        // Converts a binary trace file to Chrome trace event JSON
+        static bool ConvertToJson(const char* tracePath, const char* jsonPath);
+
+        static void Record(EventType type, const char* category, const char* name, int64_t value = 0)
+        {
+            if (IsActive())
+            {
+                Buffer* buffer = thread_buffer;
+                if ((NULL != buffer) || (NULL != (buffer = CreateBuffer())))
+                    buffer->Append(type, category, name, value);
+            }
+        }
+
+        // Returns the current timestamp counter value (in "ticks" that are
+        // calibrated against ProtoTime when a trace is written)
+        static uint64_t GetTicks()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+            uint64_t ticks;
+            asm volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+            return ticks;
+#elif defined(WIN32)
+            LARGE_INTEGER count;
+            QueryPerformanceCounter(&count);
+            return (uint64_t)count.QuadPart;
+#else
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif // if/else __x86_64__ || __i386__ / __aarch64__ / WIN32
+        }
+
+        // Records a begin event on construction and an end event on destruction
+        class Scope
+        {
+            public:
+                Scope(const char* theCategory, const char* theName)
+                 : category(theCategory), name(theName)
+                    {Record(EVENT_BEGIN, category, name);}
+                ~Scope()
+                    {Record(EVENT_END, category, name);}
+
+            private:
+                const char* category;
+                const char* name;
+        };  // end class ProtoTrace::Scope
+
+    private:
+        struct Event
+        {
+            uint64_t    ticks;      // (since trace start, event type in upper 8 bits)
+            const char* category;
+            const char* name;
+            int64_t     value;
+        };
+
+        class Buffer
+        {
+            public:
+                Buffer(unsigned int threadIndex);
+                ~Buffer();
+
+                bool Init(unsigned int numEvents);
+
+                void Append(EventType type, const char* category, const char* name, int64_t value)
+                {
+                    uint64_t index = head;  // (only the owning thread appends)
+                    Event& event = event_list[index & event_mask];
+                    event.ticks = ((GetTicks() - start_ticks) & TICKS_MASK) | ((uint64_t)type << TYPE_SHIFT);
+                    event.category = category;
+                    event.name = name;
+                    event.value = value;
+                    ProtoAtomic::Store(&head, index + 1);
+                }
+
+                Event*          event_list;
+                uint64_t        event_mask;
+                uint64_t        head;           // count of events appended
+                unsigned int    thread_index;
+                char            thread_name[32];
+                Buffer*         next;
+        };  // end class ProtoTrace::Buffer
+
+        static const unsigned int TYPE_SHIFT = 56;
+        static const uint64_t TICKS_MASK = (((uint64_t)1) << TYPE_SHIFT) - 1;
+
+        static Buffer* CreateBuffer();
+
+        static bool                 active;
+        static unsigned int         buffer_events;
+        static uint64_t             start_ticks;
+        static ProtoTime            start_time;
+        static Buffer*              buffer_list;
+        static unsigned int         thread_count;
+        static PROTO_TRACE_TLS Buffer*  thread_buffer;
+        static PROTO_TRACE_TLS char     thread_label[32];  // (see SetThreadName())
+
+};  // end class ProtoTrace
+
+#ifdef USE_PROTO_TRACE
+#define PROTO_TRACE_CONCAT_(a, b) a##b
+#define PROTO_TRACE_CONCAT(a, b) PROTO_TRACE_CONCAT_(a, b)
+#define PROTO_TRACE_SCOPE(category, name) \
+    ProtoTrace::Scope PROTO_TRACE_CONCAT(proto_trace_scope_, __LINE__)(category, name)
+#define PROTO_TRACE_BEGIN(category, name) \
+    ProtoTrace::Record(ProtoTrace::EVENT_BEGIN, category, name)
+#define PROTO_TRACE_END(category, name) \
+    ProtoTrace::Record(ProtoTrace::EVENT_END, category, name)
+#define PROTO_TRACE_INSTANT(category, name) \
+    ProtoTrace::Record(ProtoTrace::EVENT_INSTANT, category, name)
+#define PROTO_TRACE_COUNTER(category, name, value) \
+    ProtoTrace::Record(ProtoTrace::EVENT_COUNTER, category, name, (int64_t)(value))
+#define PROTO_TRACE_THREAD_NAME(name) ProtoTrace::SetThreadName(name)
+#else
+#define PROTO_TRACE_SCOPE(category, name) ((void)0)
+#define PROTO_TRACE_BEGIN(category, name) ((void)0)
+#define PROTO_TRACE_END(category, name) ((void)0)
+#define PROTO_TRACE_INSTANT(category, name) ((void)0)
+#define PROTO_TRACE_COUNTER(category, name, value) ((void)0)
+#define PROTO_TRACE_THREAD_NAME(name) ((void)0)
+#endif // if/else USE_PROTO_TRACE
+
+#endif // _PROTO_TRACE
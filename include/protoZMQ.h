@@ -7,6 +7,7 @@
 
 #include "protoThread.h"
 #include "protoEvent.h"
+#include "protoDispatcher.h"
 #include "zmq.h"
 
 class ProtoZmq
@@ -17,6 +18,7 @@ class ProtoZmq
     public:
         // Use the ProtoEvent notification framework for a ZMQ Socket
         // A PollerThread is used to run a zmq_poll() loop to monitor active sockets
+        // unless the socket is set to "direct" mode with SetDispatcher() (see below)
         class Socket : private ProtoEvent
         {
             public:
@@ -48,6 +50,18 @@ class ProtoZmq
                 bool SendToGroup(char* buffer, unsigned int& numBytes,const char* group);
                 bool Recv(char* buffer, unsigned int& numBytes);
                 bool RecvMsg(zmq_msg_t* zmqMsg);
+                
+                // Batched, zero-copy message I/O.  On input, "count" is the
+                // number of messages in (or room in) "msgList" and on output
+                // it is the number actually sent (or received).  RecvBatch()
+                // initializes the received messages and the caller then owns
+                // them (i.e., must zmq_msg_close() or send them).  SendBatch()
+                // takes ownership of the messages sent; the rest (if the
+                // socket would block) are left to the caller.  These return
+                // false only upon error.
+                bool RecvBatch(zmq_msg_t* msgList, unsigned int& count);
+                bool SendBatch(zmq_msg_t* msgList, unsigned int& count);
+                
                 bool StartInputNotification();
                 bool StopInputNotification();
                 bool StartOutputNotification();
@@ -78,6 +92,16 @@ class ProtoZmq
                 // before deleting it! (The "default" NULL pollerThread takes care of itself)
                 bool SetNotifier(ProtoEvent::Notifier* theNotifier, class PollerThread* pollerThread = NULL);
                 
+                // "Direct" mode: the socket ZMQ_FD is installed as a generic input 
+                // on the given dispatcher (no PollerThread) and ZMQ_EVENTS are checked 
+                // when it signals.  Since ZMQ_FD is edge-triggered, the listener is
+                // invoked repeatedly while events remain pending (and it does some
+                // I/O), so it should Recv() until nothing is left.  The socket must 
+                // only be used from the dispatcher thread.  (Not supported on WIN32)
+                bool SetDispatcher(ProtoDispatcher* theDispatcher);
+                bool IsDirect() const
+                    {return (NULL != direct_dispatcher);}
+                
                 template <class listenerType>
                 bool SetListener(listenerType* theListener, void(listenerType::*eventHandler)(ProtoEvent&))
                     {return ProtoEvent::SetListener(theListener, eventHandler);}
@@ -90,6 +114,13 @@ class ProtoZmq
                     {poll_status = status;}
             
                 bool UpdateNotification();
+                bool UpdateDirectNotification();
+                void CheckDirectEvents();
+                void OnDirectEvent();
+                void OnDirectTimeout(ProtoTimer& theTimer);
+                static void DirectCallback(ProtoDispatcher::Descriptor descriptor, 
+                                           ProtoDispatcher::Event      theEvent, 
+                                           const void*                 userData);
             
                 static PollerThread* default_poller_thread; 
                 static ProtoMutex    default_poller_mutex;  // to guarantee thread-safe instantiation of default_poller_thread    
@@ -106,6 +137,14 @@ class ProtoZmq
                 ProtoMutex          poller_mutex;
                 bool                poller_active;
                 
+                // "direct" mode state
+                ProtoDispatcher*    direct_dispatcher;
+                ProtoDispatcher::Descriptor direct_fd;  // ZMQ_FD
+                bool                direct_active;   // true when ZMQ_FD is installed
+                bool                in_direct_event; // true during OnDirectEvent()
+                unsigned long       io_count;        // Send()/Recv() call count
+                ProtoTimer          direct_timer;    // (re)checks ZMQ_EVENTS when no edge is due
+                
         };  // end ProtoZmq::Socket
         
     protected:
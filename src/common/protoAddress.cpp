@@ -128,6 +128,9 @@ bool ProtoAddress::IsMulticast() const
 #ifdef OPNET  
                 return (0xe0000000 == (0xf0000000 & addr.addr));
 #endif // OPNET
+#ifdef NATIVE_SIM
+                return (0 != (addr.addr & 0x80000000));
+#endif // NATIVE_SIM
 #endif // SIMULATE
             default:
                 return false;
@@ -165,6 +168,9 @@ bool ProtoAddress::IsBroadcast() const
 #ifdef OPNET  
 		        return (0xffffffff == addr.addr);
 #endif // OPNET
+#ifdef NATIVE_SIM
+                return (0xffffffff == addr.addr);
+#endif // NATIVE_SIM
 #endif // SIMULATE
             default:
                 return false;
@@ -1622,6 +1628,60 @@ bool ProtoAddress::ResolveLocalAddress(char* buffer, unsigned int buflen)
 }  // end ProtoAddress::ResolveLocalAddress()
 
 
+bool ProtoCompactAddress::SetAddress(const ProtoAddress& theAddr)
+{
+    Invalidate();
+    UINT8 len = theAddr.GetLength();
+    if (!theAddr.IsValid() || (len > sizeof(value))) return false;
+    memcpy(value.byte, theAddr.GetRawHostAddress(), len);
+    type = (UINT8)theAddr.GetType();
+    length = len;
+    port = theAddr.GetPort();
+    return true;
+}  // end ProtoCompactAddress::SetAddress()
+
+void ProtoCompactAddress::GetAddress(ProtoAddress& theAddr) const
+{
+    theAddr.Invalidate();  // so any prior port is not retained
+    if (IsValid())
+    {
+        theAddr.SetRawHostAddress((ProtoAddress::Type)type, (const char*)value.byte, length);
+        if (0 != port) theAddr.SetPort(port);
+    }
+}  // end ProtoCompactAddress::GetAddress()
+
+int ProtoCompactAddress::CompareHostAddr(const ProtoCompactAddress& theAddr) const
+{
+    // Order by type, then address bytes (unused bytes are zero)
+    if (type != theAddr.type) 
+        return ((type < theAddr.type) ? -1 : 1);
+    return memcmp(value.byte, theAddr.value.byte, length);
+}  // end ProtoCompactAddress::CompareHostAddr()
+
+bool ProtoCompactAddress::PrefixIsEqual(const ProtoCompactAddress& theAddr, UINT8 prefixLen) const
+{
+    if (type != theAddr.type) return false;
+    unsigned int nbyte = prefixLen >> 3;
+    if (nbyte >= length) return HostIsEqual(theAddr);
+    if ((0 != nbyte) && (0 != memcmp(value.byte, theAddr.value.byte, nbyte))) return false;
+    UINT8 nbit = prefixLen & 0x07;
+    if (0 == nbit) return true;
+    UINT8 mask = 0xff << (8 - nbit);
+    return ((mask & value.byte[nbyte]) == (mask & theAddr.value.byte[nbyte]));
+}  // end ProtoCompactAddress::PrefixIsEqual()
+
+void ProtoCompactAddress::ApplyPrefixMask(UINT8 prefixLen)
+{
+    unsigned int nbyte = prefixLen >> 3;
+    if (nbyte >= length) return;
+    UINT8 nbit = prefixLen & 0x07;
+    if (0 != nbit)
+        value.byte[nbyte++] &= (UINT8)(0xff << (8 - nbit));
+    if (nbyte < length)
+        memset(value.byte + nbyte, 0, length - nbyte);
+}  // end ProtoCompactAddress::ApplyPrefixMask()
+
+
 ProtoAddressList::ProtoAddressList()
 {
 }
@@ -1703,7 +1763,7 @@ bool ProtoAddressList::GetFirstAddress(ProtoAddress& firstAddr) const
     Item* rootItem = static_cast<Item*>(addr_tree.GetRoot());
     if (NULL != rootItem)
     {
-        firstAddr = rootItem->GetAddress();
+        rootItem->GetCompactAddress().GetAddress(firstAddr);
         return true;
     }
     else
@@ -1747,7 +1807,7 @@ bool ProtoAddressList::Iterator::GetNextAddress(ProtoAddress& nextAddr)
     Item* nextItem = static_cast<Item*>(ptree_iterator.GetNextItem());
     if (NULL != nextItem)
     {
-        nextAddr = nextItem->GetAddress();
+        nextItem->GetCompactAddress().GetAddress(nextAddr);
         return true;
     }
     else
@@ -1762,7 +1822,7 @@ bool ProtoAddressList::Iterator::PeekNextAddress(ProtoAddress& nextAddr)
     Item* nextItem = static_cast<Item*>(ptree_iterator.PeekNextItem());
     if (NULL != nextItem)
     {
-        nextAddr = nextItem->GetAddress();
+        nextItem->GetCompactAddress().GetAddress(nextAddr);
         return true;
     }
     else
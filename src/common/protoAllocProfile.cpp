@@ -0,0 +1,691 @@
+/**
+* @file protoAllocProfile.cpp
+*
+* @brief Sampling allocation profiler (replaces the global "new" and "delete"
+* operators when built with USE_PROTO_ALLOC_PROFILE)
+*/
+#include "protoAllocProfile.h"
+#include "protoDebug.h"
+
+#ifdef USE_PROTO_ALLOC_PROFILE
+
+#ifdef USE_PROTO_CHECK
+#error "USE_PROTO_ALLOC_PROFILE and USE_PROTO_CHECK both replace the new and delete operators"
+#endif // USE_PROTO_CHECK
+
+#include "protoThread.h"
+
+#include <new>
+#include <stdlib.h>  // for malloc(), free(), qsort()
+#include <string.h>  // for memcpy(), strrchr()
+#include <math.h>    // for log(), exp()
+#include <errno.h>
+
+#ifdef UNIX
+#include <unistd.h>  // for pipe(), read(), write()
+#include <signal.h>
+#include <dlfcn.h>   // for dladdr()
+#if defined(__GLIBC__) || defined(MACOSX)
+#define PROTO_ALLOC_BACKTRACE
+#include <execinfo.h>  // for backtrace()
+#endif // __GLIBC__ || MACOSX
+#ifdef __GNUC__
+#include <cxxabi.h>  // for abi::__cxa_demangle()
+#endif // __GNUC__
+#endif // UNIX
+
+#if __cplusplus >= 201103L
+#define PROTO_NOEXCEPT noexcept
+#else
+#define PROTO_NOEXCEPT throw()
+#endif // if/else C++11
+
+// Each allocation is preceded by a header with a pointer to its allocation
+// site (NULL if not sampled) just before the user pointer.  Sampled allocations
+// have a larger header that also holds the estimated count and bytes they
+// represent (subtracted from the site's live statistics when deleted).
+// (Both sizes keep the 16 byte alignment of malloc())
+
+struct ProtoAllocSite
+{
+    uint64_t        key;            // (hash of "stack", 0 if unused)
+    int             ready;          // (set once "stack" is filled in)
+    unsigned int    depth;
+    void*           stack[ProtoAllocProfile::STACK_DEPTH];
+    uint64_t        samples;
+    uint64_t        alloc_count;    // (counts are fixed point, see WEIGHT_SHIFT)
+    uint64_t        alloc_bytes;
+    int64_t         live_count;
+    int64_t         live_bytes;
+    uint64_t        size_class_count[ProtoAllocProfile::SIZE_CLASS_COUNT];
+};  // end struct ProtoAllocSite
+
+struct ProtoAllocSample
+{
+    uint64_t    count_weight;
+    uint64_t    byte_weight;
+};  // end struct ProtoAllocSample
+
+static const size_t HEADER_SIZE = 16;
+static const size_t SAMPLE_HEADER_SIZE = 32;
+static const unsigned int WEIGHT_SHIFT = 16;
+static const unsigned int SITE_TABLE_SIZE = 2048;  // (must be a power of two)
+static const long long IDLE_COUNTDOWN = 16 * 1024 * 1024;  // (re-check interval while stopped)
+
+static ProtoAllocSite site_table[SITE_TABLE_SIZE];
+static ProtoAllocSite overflow_site;  // (for samples when "site_table" is full)
+static unsigned long sample_interval = 512 * 1024;
+
+// Per-thread sampling state, so unsampled allocations touch no shared memory
+static __thread long long sample_countdown = 0;
+static __thread uint64_t sample_random = 0;
+static __thread bool in_profiler = false;
+
+static inline ProtoAllocSite*& GetSite(void* ptr)
+{
+    return ((ProtoAllocSite**)ptr)[-1];
+}
+
+// Returns exponentially distributed bytes (mean "interval") until the next sample
+static long long GetNextCountdown(unsigned long interval)
+{
+    if (0 == sample_random)
+        sample_random = ((uint64_t)(uintptr_t)&sample_random * 0x9e3779b97f4a7c15ULL) | 1;
+    sample_random ^= sample_random << 13;
+    sample_random ^= sample_random >> 7;
+    sample_random ^= sample_random << 17;
+    double u = ((double)(sample_random >> 11) + 0.5) / 9007199254740992.0;  // (0, 1)
+    return (long long)(-log(u) * (double)interval) + 1;
+}  // end GetNextCountdown()
+
+static ProtoAllocSite* FindSite(void* caller)
+{
+    void* frameList[ProtoAllocProfile::STACK_DEPTH + 8];
+    unsigned int depth = 0;
+#ifdef PROTO_ALLOC_BACKTRACE
+    // Capture the stack and skip our own frames (up to the caller of "new")
+    int count = backtrace(frameList, ProtoAllocProfile::STACK_DEPTH + 8);
+    int start = 0;
+    while ((start < count) && (frameList[start] != caller)) start++;
+    if (start < count)
+    {
+        depth = count - start;
+        if (depth > ProtoAllocProfile::STACK_DEPTH) depth = ProtoAllocProfile::STACK_DEPTH;
+        memmove(frameList, frameList + start, depth * sizeof(void*));
+    }
+#endif // PROTO_ALLOC_BACKTRACE
+    if (0 == depth)
+    {
+        frameList[0] = caller;
+        depth = 1;
+    }
+    uint64_t key = 14695981039346656037ULL;
+    for (unsigned int i = 0; i < depth; i++)
+    {
+        key ^= (uint64_t)(uintptr_t)frameList[i];
+        key *= 1099511628211ULL;
+        key ^= key >> 29;
+    }
+    if (0 == key) key = 1;
+    for (unsigned int i = 0; i < SITE_TABLE_SIZE; i++)
+    {
+        ProtoAllocSite* site = site_table + ((key + i) & (SITE_TABLE_SIZE - 1));
+        uint64_t siteKey = __atomic_load_n(&site->key, __ATOMIC_ACQUIRE);
+        if (0 == siteKey)
+        {
+            if (__atomic_compare_exchange_n(&site->key, &siteKey, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                memcpy(site->stack, frameList, depth * sizeof(void*));
+                site->depth = depth;
+                __atomic_store_n(&site->ready, 1, __ATOMIC_RELEASE);
+                return site;
+            }
+            // (else another thread claimed this entry and "siteKey" is its key)
+        }
+        if (key == siteKey) return site;
+    }
+    return &overflow_site;
+}  // end FindSite()
+
+static void* AllocateUnsampled(size_t size)
+{
+    char* base = (char*)malloc(size + HEADER_SIZE);
+    if (NULL == base) return NULL;
+    void* ptr = base + HEADER_SIZE;
+    GetSite(ptr) = NULL;
+    return ptr;
+}  // end AllocateUnsampled()
+
+// Called when the thread's sample countdown expires
+static void* __attribute__((noinline)) AllocateSampled(size_t size, void* caller)
+{
+    unsigned long interval = __atomic_load_n(&sample_interval, __ATOMIC_RELAXED);
+    if (in_profiler || (0 == interval) || (0 == sample_random))
+    {
+        // (reentrant, sampling stopped, or the thread's first allocation)
+        if (!in_profiler)
+            sample_countdown = (0 != interval) ? GetNextCountdown(interval) : IDLE_COUNTDOWN;
+        return AllocateUnsampled(size);
+    }
+    in_profiler = true;
+    sample_countdown = GetNextCountdown(interval);
+    ProtoAllocSite* site = FindSite(caller);
+    in_profiler = false;
+    char* base = (char*)malloc(size + SAMPLE_HEADER_SIZE);
+    if (NULL == base) return NULL;
+    // An allocation of "size" bytes is sampled with probability 1 - exp(-size/interval)
+    double probability = (size > 0) ? (1.0 - exp(-(double)size / (double)interval)) : 1.0;
+    ProtoAllocSample* sample = (ProtoAllocSample*)base;
+    sample->count_weight = (uint64_t)((double)(1 << WEIGHT_SHIFT) / probability);
+    sample->byte_weight = (uint64_t)((double)size / probability);
+    __atomic_fetch_add(&site->samples, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->alloc_count, sample->count_weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->alloc_bytes, sample->byte_weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->live_count, (int64_t)sample->count_weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->live_bytes, (int64_t)sample->byte_weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->size_class_count[ProtoAllocProfile::GetSizeClass(size)],
+                       sample->count_weight, __ATOMIC_RELAXED);
+    void* ptr = base + SAMPLE_HEADER_SIZE;
+    GetSite(ptr) = site;
+    return ptr;
+}  // end AllocateSampled()
+
+static inline void* Allocate(size_t size, void* caller)
+{
+    if (size > ((size_t)-1 - SAMPLE_HEADER_SIZE)) return NULL;
+    sample_countdown -= (long long)size;
+    if (sample_countdown >= 0)
+        return AllocateUnsampled(size);
+    else
+        return AllocateSampled(size, caller);
+}  // end Allocate()
+
+static inline void Deallocate(void* ptr)
+{
+    if (NULL == ptr) return;
+    ProtoAllocSite* site = GetSite(ptr);
+    if (NULL == site)
+    {
+        free((char*)ptr - HEADER_SIZE);
+        return;
+    }
+    ProtoAllocSample* sample = (ProtoAllocSample*)((char*)ptr - SAMPLE_HEADER_SIZE);
+    __atomic_fetch_sub(&site->live_count, (int64_t)sample->count_weight, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&site->live_bytes, (int64_t)sample->byte_weight, __ATOMIC_RELAXED);
+    free(sample);
+}  // end Deallocate()
+
+void* operator new(size_t size)
+{
+    void* ptr = Allocate(size, __builtin_return_address(0));
+    if (NULL == ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    void* ptr = Allocate(size, __builtin_return_address(0));
+    if (NULL == ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) PROTO_NOEXCEPT
+{
+    return Allocate(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) PROTO_NOEXCEPT
+{
+    return Allocate(size, __builtin_return_address(0));
+}
+
+void operator delete(void* ptr) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) PROTO_NOEXCEPT
+{
+    Deallocate(ptr);
+}
+#endif // __cpp_sized_deallocation
+
+bool ProtoAllocProfile::IsEnabled()
+{
+    return true;
+}  // end ProtoAllocProfile::IsEnabled()
+
+void ProtoAllocProfile::SetSampleInterval(unsigned long bytes)
+{
+    __atomic_store_n(&sample_interval, bytes, __ATOMIC_RELAXED);
+    // (the calling thread starts with the new interval, others after their next sample)
+    sample_countdown = (0 != bytes) ? GetNextCountdown(bytes) : IDLE_COUNTDOWN;
+}  // end ProtoAllocProfile::SetSampleInterval()
+
+unsigned long ProtoAllocProfile::GetSampleInterval()
+{
+    return __atomic_load_n(&sample_interval, __ATOMIC_RELAXED);
+}  // end ProtoAllocProfile::GetSampleInterval()
+
+static void GetSiteInfo(ProtoAllocSite& site, ProtoAllocProfile::Site& info)
+{
+    const double scale = 1.0 / (double)(1 << WEIGHT_SHIFT);
+    info.depth = site.depth;
+    memcpy(info.stack, site.stack, site.depth * sizeof(void*));
+    info.samples = (unsigned long)__atomic_load_n(&site.samples, __ATOMIC_RELAXED);
+    info.alloc_count = scale * (double)__atomic_load_n(&site.alloc_count, __ATOMIC_RELAXED);
+    info.alloc_bytes = (double)__atomic_load_n(&site.alloc_bytes, __ATOMIC_RELAXED);
+    info.live_count = scale * (double)__atomic_load_n(&site.live_count, __ATOMIC_RELAXED);
+    info.live_bytes = (double)__atomic_load_n(&site.live_bytes, __ATOMIC_RELAXED);
+    for (unsigned int i = 0; i < ProtoAllocProfile::SIZE_CLASS_COUNT; i++)
+        info.size_class_count[i] = scale * (double)__atomic_load_n(&site.size_class_count[i], __ATOMIC_RELAXED);
+}  // end GetSiteInfo()
+
+struct ProtoAllocRank
+{
+    double          value;
+    unsigned int    index;
+};
+
+static int CompareRank(const void* a, const void* b)
+{
+    double x = ((const ProtoAllocRank*)a)->value;
+    double y = ((const ProtoAllocRank*)b)->value;
+    return (x > y) ? -1 : ((x < y) ? 1 : 0);  // (descending)
+}  // end CompareRank()
+
+unsigned int ProtoAllocProfile::GetSites(Site* siteList, unsigned int maxSites, SortKey sortKey)
+{
+    // Rank the sites in use ("overflow_site" is at index SITE_TABLE_SIZE)
+    ProtoAllocRank* rankList = (ProtoAllocRank*)malloc((SITE_TABLE_SIZE + 1) * sizeof(ProtoAllocRank));
+    if (NULL == rankList)
+    {
+        PLOG(PL_ERROR, "ProtoAllocProfile::GetSites() malloc() error: %s\n", GetErrorString());
+        return 0;
+    }
+    unsigned int count = 0;
+    for (unsigned int i = 0; i <= SITE_TABLE_SIZE; i++)
+    {
+        ProtoAllocSite& site = (i < SITE_TABLE_SIZE) ? site_table[i] : overflow_site;
+        if ((i < SITE_TABLE_SIZE) && (0 == __atomic_load_n(&site.ready, __ATOMIC_ACQUIRE)))
+            continue;
+        // (skip sites with nothing allocated since Reset() and nothing live)
+        if ((0 == __atomic_load_n(&site.samples, __ATOMIC_RELAXED)) &&
+            (0 == __atomic_load_n(&site.live_count, __ATOMIC_RELAXED)))
+            continue;
+        switch (sortKey)
+        {
+            case SORT_ALLOC_COUNT:
+                rankList[count].value = (double)__atomic_load_n(&site.alloc_count, __ATOMIC_RELAXED);
+                break;
+            case SORT_LIVE_BYTES:
+                rankList[count].value = (double)__atomic_load_n(&site.live_bytes, __ATOMIC_RELAXED);
+                break;
+            default:
+                rankList[count].value = (double)__atomic_load_n(&site.alloc_bytes, __ATOMIC_RELAXED);
+                break;
+        }
+        rankList[count++].index = i;
+    }
+    qsort(rankList, count, sizeof(ProtoAllocRank), CompareRank);
+    if (count > maxSites) count = maxSites;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int index = rankList[i].index;
+        GetSiteInfo((index < SITE_TABLE_SIZE) ? site_table[index] : overflow_site, siteList[i]);
+    }
+    free(rankList);
+    return count;
+}  // end ProtoAllocProfile::GetSites()
+
+// Writes "function+offset (module)" (or "module+offset" for addr2line if there's no symbol)
+static void GetSymbol(void* addr, char* buffer, unsigned int buflen)
+{
+#ifdef UNIX
+    Dl_info info;
+    if ((0 != dladdr(addr, &info)) && (NULL != info.dli_fname))
+    {
+        const char* module = strrchr(info.dli_fname, '/');
+        module = (NULL != module) ? (module + 1) : info.dli_fname;
+        if ((NULL != info.dli_sname) && (NULL != info.dli_saddr))
+        {
+            const char* name = info.dli_sname;
+            char* demangled = NULL;
+#ifdef __GNUC__
+            int status;
+            demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+            if (NULL != demangled) name = demangled;
+#endif // __GNUC__
+            snprintf(buffer, buflen, "%s+0x%lx (%s)", name,
+                     (unsigned long)((char*)addr - (char*)info.dli_saddr), module);
+            if (NULL != demangled) free(demangled);
+        }
+        else
+        {
+            snprintf(buffer, buflen, "%s+0x%lx", module,
+                     (unsigned long)((char*)addr - (char*)info.dli_fbase));
+        }
+        return;
+    }
+#endif // UNIX
+    snprintf(buffer, buflen, "?");
+}  // end GetSymbol()
+
+bool ProtoAllocProfile::Report(FILE* filePtr, unsigned int maxSites, SortKey sortKey)
+{
+    // (our own allocations here are not sampled)
+    bool wasInProfiler = in_profiler;
+    in_profiler = true;
+    Site* siteList = (Site*)malloc((SITE_TABLE_SIZE + 1) * sizeof(Site));
+    if (NULL == siteList)
+    {
+        PLOG(PL_ERROR, "ProtoAllocProfile::Report() malloc() error: %s\n", GetErrorString());
+        in_profiler = wasInProfiler;
+        return false;
+    }
+    unsigned int count = GetSites(siteList, SITE_TABLE_SIZE + 1, sortKey);
+    Site total;
+    memset(&total, 0, sizeof(Site));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        total.samples += siteList[i].samples;
+        total.alloc_count += siteList[i].alloc_count;
+        total.alloc_bytes += siteList[i].alloc_bytes;
+        total.live_count += siteList[i].live_count;
+        total.live_bytes += siteList[i].live_bytes;
+        for (unsigned int j = 0; j < SIZE_CLASS_COUNT; j++)
+            total.size_class_count[j] += siteList[i].size_class_count[j];
+    }
+    fprintf(filePtr, "ProtoAllocProfile: interval %lu bytes, %lu samples, %u sites, "
+                     "allocated %.0f (%.3f MB), live %.0f (%.3f MB)\n",
+            GetSampleInterval(), total.samples, count, total.alloc_count, total.alloc_bytes / 1.0e+06,
+            total.live_count, total.live_bytes / 1.0e+06);
+    fprintf(filePtr, "  size class   allocations\n");
+    for (unsigned int i = 0; i < SIZE_CLASS_COUNT; i++)
+    {
+        if (0.0 == total.size_class_count[i]) continue;
+        if (i < (SIZE_CLASS_COUNT - 1))
+            fprintf(filePtr, "    <= %-7lu %12.0f (%5.1f%%)\n", 1UL << (i + 4), total.size_class_count[i],
+                    100.0 * total.size_class_count[i] / total.alloc_count);
+        else
+            fprintf(filePtr, "     > %-7lu %12.0f (%5.1f%%)\n", 1UL << (i + 3), total.size_class_count[i],
+                    100.0 * total.size_class_count[i] / total.alloc_count);
+    }
+    if (count > maxSites) count = maxSites;
+    fprintf(filePtr, "  rank   alloc MB    allocs   live MB     live  samples\n");
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const Site& site = siteList[i];
+        fprintf(filePtr, "  %4u %10.3f %9.0f %9.3f %8.0f %8lu\n", i + 1,
+                site.alloc_bytes / 1.0e+06, site.alloc_count,
+                site.live_bytes / 1.0e+06, site.live_count, site.samples);
+        for (unsigned int j = 0; j < site.depth; j++)
+        {
+            char symbol[512];
+            GetSymbol(site.stack[j], symbol, 512);
+            fprintf(filePtr, "       #%u %p %s\n", j, site.stack[j], symbol);
+        }
+    }
+    fflush(filePtr);
+    free(siteList);
+    in_profiler = wasInProfiler;
+    return true;
+}  // end ProtoAllocProfile::Report()
+
+void ProtoAllocProfile::Reset()
+{
+    for (unsigned int i = 0; i <= SITE_TABLE_SIZE; i++)
+    {
+        ProtoAllocSite& site = (i < SITE_TABLE_SIZE) ? site_table[i] : overflow_site;
+        __atomic_store_n(&site.samples, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site.alloc_count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&site.alloc_bytes, 0, __ATOMIC_RELAXED);
+        for (unsigned int j = 0; j < SIZE_CLASS_COUNT; j++)
+            __atomic_store_n(&site.size_class_count[j], 0, __ATOMIC_RELAXED);
+    }
+}  // end ProtoAllocProfile::Reset()
+
+#ifdef UNIX
+
+// The signal handler just writes to a pipe to wake this thread, which writes the report
+class ProtoAllocReporter : public ProtoThread
+{
+    public:
+        ProtoAllocReporter();
+        ~ProtoAllocReporter();
+
+        bool Start(int signum, const char* path);
+        void Stop();
+        int RunThread();
+
+        static void SignalHandler(int signum);
+
+    private:
+        static int          signal_fd;
+        int                 signal_num;
+        struct sigaction    old_action;
+        int                 pipe_fd[2];
+        char*               report_path;
+};  // end class ProtoAllocReporter
+
+int ProtoAllocReporter::signal_fd = -1;
+static ProtoAllocReporter* alloc_reporter = NULL;
+
+ProtoAllocReporter::ProtoAllocReporter()
+ : signal_num(0), report_path(NULL)
+{
+    pipe_fd[0] = pipe_fd[1] = -1;
+}
+
+ProtoAllocReporter::~ProtoAllocReporter()
+{
+    Stop();
+}
+
+bool ProtoAllocReporter::Start(int signum, const char* path)
+{
+    if (NULL != path)
+    {
+        if (NULL == (report_path = new char[strlen(path) + 1]))
+        {
+            PLOG(PL_ERROR, "ProtoAllocReporter::Start() new report_path error: %s\n", GetErrorString());
+            return false;
+        }
+        strcpy(report_path, path);
+    }
+    if (0 != pipe(pipe_fd))
+    {
+        PLOG(PL_ERROR, "ProtoAllocReporter::Start() pipe() error: %s\n", GetErrorString());
+        Stop();
+        return false;
+    }
+    if (!StartThread())
+    {
+        PLOG(PL_ERROR, "ProtoAllocReporter::Start() error: unable to start thread\n");
+        Stop();
+        return false;
+    }
+    signal_fd = pipe_fd[1];
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (0 != sigaction(signum, &action, &old_action))
+    {
+        PLOG(PL_ERROR, "ProtoAllocReporter::Start() sigaction() error: %s\n", GetErrorString());
+        Stop();
+        return false;
+    }
+    signal_num = signum;
+    return true;
+}  // end ProtoAllocReporter::Start()
+
+void ProtoAllocReporter::Stop()
+{
+    if (0 != signal_num)
+    {
+        sigaction(signal_num, &old_action, NULL);
+        signal_num = 0;
+    }
+    signal_fd = -1;
+    if (pipe_fd[1] >= 0)
+    {
+        close(pipe_fd[1]);  // (wakes the thread with end-of-file)
+        pipe_fd[1] = -1;
+    }
+    if (IsStarted()) StopThread();
+    if (pipe_fd[0] >= 0)
+    {
+        close(pipe_fd[0]);
+        pipe_fd[0] = -1;
+    }
+    if (NULL != report_path)
+    {
+        delete[] report_path;
+        report_path = NULL;
+    }
+}  // end ProtoAllocReporter::Stop()
+
+int ProtoAllocReporter::RunThread()
+{
+    for (;;)
+    {
+        char value;
+        ssize_t result = read(pipe_fd[0], &value, 1);
+        if (result < 0)
+        {
+            if (EINTR == errno) continue;
+            PLOG(PL_ERROR, "ProtoAllocReporter::RunThread() read() error: %s\n", GetErrorString());
+            break;
+        }
+        else if (0 == result)
+        {
+            break;  // (Stop() closed the pipe)
+        }
+        FILE* filePtr = (NULL != report_path) ? fopen(report_path, "a") : stderr;
+        if (NULL == filePtr)
+        {
+            PLOG(PL_ERROR, "ProtoAllocReporter::RunThread() fopen(%s) error: %s\n", report_path, GetErrorString());
+            continue;
+        }
+        ProtoAllocProfile::Report(filePtr);
+        if (stderr != filePtr) fclose(filePtr);
+    }
+    return 0;
+}  // end ProtoAllocReporter::RunThread()
+
+void ProtoAllocReporter::SignalHandler(int /*signum*/)
+{
+    int savedErrno = errno;
+    char value = 0;
+    if (signal_fd >= 0)
+    {
+        if (write(signal_fd, &value, 1) < 0) {}  // (report already pending if the pipe is full)
+    }
+    errno = savedErrno;
+}  // end ProtoAllocReporter::SignalHandler()
+
+bool ProtoAllocProfile::EnableSignalReport(int signum, const char* path)
+{
+    DisableSignalReport();
+    if (NULL == (alloc_reporter = new ProtoAllocReporter()))
+    {
+        PLOG(PL_ERROR, "ProtoAllocProfile::EnableSignalReport() new ProtoAllocReporter error: %s\n", GetErrorString());
+        return false;
+    }
+    if (!alloc_reporter->Start(signum, path))
+    {
+        delete alloc_reporter;
+        alloc_reporter = NULL;
+        return false;
+    }
+    return true;
+}  // end ProtoAllocProfile::EnableSignalReport()
+
+void ProtoAllocProfile::DisableSignalReport()
+{
+    if (NULL != alloc_reporter)
+    {
+        delete alloc_reporter;
+        alloc_reporter = NULL;
+    }
+}  // end ProtoAllocProfile::DisableSignalReport()
+
+#else
+
+bool ProtoAllocProfile::EnableSignalReport(int /*signum*/, const char* /*path*/)
+{
+    PLOG(PL_ERROR, "ProtoAllocProfile::EnableSignalReport() error: not supported on this platform\n");
+    return false;
+}  // end ProtoAllocProfile::EnableSignalReport()
+
+void ProtoAllocProfile::DisableSignalReport()
+{
+}
+
+#endif // if/else UNIX
+
+#else  // !USE_PROTO_ALLOC_PROFILE
+
+bool ProtoAllocProfile::IsEnabled()
+{
+    return false;
+}
+
+void ProtoAllocProfile::SetSampleInterval(unsigned long /*bytes*/)
+{
+}
+
+unsigned long ProtoAllocProfile::GetSampleInterval()
+{
+    return 0;
+}
+
+unsigned int ProtoAllocProfile::GetSites(Site* /*siteList*/, unsigned int /*maxSites*/, SortKey /*sortKey*/)
+{
+    return 0;
+}
+
+bool ProtoAllocProfile::Report(FILE* filePtr, unsigned int /*maxSites*/, SortKey /*sortKey*/)
+{
+    fprintf(filePtr, "ProtoAllocProfile: not enabled (build with USE_PROTO_ALLOC_PROFILE)\n");
+    return false;
+}
+
+void ProtoAllocProfile::Reset()
+{
+}
+
+bool ProtoAllocProfile::EnableSignalReport(int /*signum*/, const char* /*path*/)
+{
+    PLOG(PL_ERROR, "ProtoAllocProfile::EnableSignalReport() error: not enabled (build with USE_PROTO_ALLOC_PROFILE)\n");
+    return false;
+}
+
+void ProtoAllocProfile::DisableSignalReport()
+{
+}
+
+#endif // if/else USE_PROTO_ALLOC_PROFILE
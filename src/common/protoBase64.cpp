@@ -1,26 +1,262 @@
 #include "protoBase64.h"
-#include <string.h>  // for memset()
+#include <string.h>  // for memset(), memcpy()
 
 // This class implements Base64 encoding (and decoding) per IETF RFC 4648
-// By default, no maximum line length is imposed on encoder output and 
+// By default, no maximum line length is imposed on encoder output and
 // the output is fully padded per the RFC's recommendation.  However, options
 // are provided to enforce a maximum text line length and exclude padding if desired.
 
+// Bulk data (whole 3-byte groups in, runs of Base64 characters out) goes through
+// EncodeBlocks() and DecodeBlocks(), which use the fastest available codec.  The
+// "SWAR" codec encodes 12 bits per table lookup and decodes 4 characters with
+// 4 table lookups and a single validity test.  The SSSE3/AVX2 codecs are built
+// (with GCC/Clang on x86) using per-function "target" attributes so the library
+// itself needs no special compiler flags, and are selected in Init() if the CPU
+// supports them.  The SIMD decoders handle only the STANDARD alphabet.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROTO_BASE64_X86
+#include <immintrin.h>
+#endif // __GNUC__ && x86
+
 // Our static encoding / decoding tables
 bool ProtoBase64::initialized = false;
+ProtoBase64::Codec ProtoBase64::codec = ProtoBase64::CODEC_BYTE;
 const char ProtoBase64::PAD64 = '=';
-const char ProtoBase64::BASE64_ENCODE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";   
-char ProtoBase64::BASE64_DECODE[255];
+const char ProtoBase64::BASE64_ENCODE[2][65] =
+{
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+char ProtoBase64::BASE64_DECODE[2][256];
+
+// Tables for the SWAR codec (per alphabet):  character pairs for each 12-bit
+// value, and each character's 6 bits pre-shifted to their place in a 24-bit
+// group (with bit 24 set for non-Base64 characters, including the pad)
+static char BASE64_ENCODE_PAIRS[2][4096][2];
+static UINT32 BASE64_DECODE_BITS[2][4][256];
+static const UINT32 BASE64_INVALID_BITS = 0x01000000;
+
+#ifdef PROTO_BASE64_X86
+
+// These follow the well known methods of W. Mula and D. Lemire ("Faster Base64
+// Encoding and Decoding Using AVX2 Instructions", ACM TOW 2018)
+
+// Converts twelve 6-bit values (in the low 12 bytes after the shuffle) to characters
+__attribute__((target("ssse3")))
+static inline __m128i Base64EncodeSSSE3(__m128i in, __m128i shiftLUT)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(t1, t3);
+    // Map 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12 to index the offsets
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shiftLUT, result);
+    return _mm_add_epi8(result, indices);
+}  // end Base64EncodeSSSE3()
+
+__attribute__((target("ssse3")))
+static unsigned int Base64EncodeBlocksSSSE3(const unsigned char* input, unsigned int numBytes,
+                                            char* buffer, const char* alphabet)
+{
+    const __m128i shiftLUT = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           alphabet[62] - 62, alphabet[63] - 63, 'A', 0, 0);
+    unsigned int index = 0;
+    // (loads 16 bytes to use 12)
+    while ((numBytes - index) >= 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)(input + index));
+        _mm_storeu_si128((__m128i*)buffer, Base64EncodeSSSE3(in, shiftLUT));
+        index += 12;
+        buffer += 16;
+    }
+    return index;
+}  // end Base64EncodeBlocksSSSE3()
+
+__attribute__((target("avx2")))
+static unsigned int Base64EncodeBlocksAVX2(const unsigned char* input, unsigned int numBytes,
+                                           char* buffer, const char* alphabet)
+{
+    const __m256i shuffle =
+        _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                         1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shiftLUT =
+        _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         alphabet[62] - 62, alphabet[63] - 63, 'A', 0, 0,
+                         'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         alphabet[62] - 62, alphabet[63] - 63, 'A', 0, 0);
+    unsigned int index = 0;
+    // (two 16-byte loads, 12 bytes apart, for 24 bytes in per 32 characters out)
+    while ((numBytes - index) >= 28)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(input + index));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(input + index + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_shuffle_epi8(shiftLUT, result);
+        _mm256_storeu_si256((__m256i*)buffer, _mm256_add_epi8(result, indices));
+        index += 24;
+        buffer += 32;
+    }
+    return index;
+}  // end Base64EncodeBlocksAVX2()
+
+// Lookup tables to validate (by nibble) and translate STANDARD alphabet characters
+#define BASE64_LUT_LO 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, \
+                      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+#define BASE64_LUT_HI 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, \
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+#define BASE64_LUT_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+
+// These decode 16 (or 32) characters to 12 (or 24) bytes at a time (storing a full
+// vector), stopping at the first block with any non-Base64 character
+__attribute__((target("ssse3")))
+static unsigned int Base64DecodeBlocksSSSE3(const char* input, unsigned int numBytes,
+                                            char* buffer, unsigned int buflen)
+{
+    const __m128i lutLo = _mm_setr_epi8(BASE64_LUT_LO);
+    const __m128i lutHi = _mm_setr_epi8(BASE64_LUT_HI);
+    const __m128i lutRoll = _mm_setr_epi8(BASE64_LUT_ROLL);
+    const __m128i mask2F = _mm_set1_epi8(0x2f);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int index = 0;
+    while (((numBytes - index) >= 16) && (buflen >= 16))
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)(input + index));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+        __m128i loNibbles = _mm_and_si128(in, nibble);
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)))
+            break;  // a non-Base64 character (e.g. pad or CR/LF)
+        __m128i eq2F = _mm_cmpeq_epi8(in, mask2F);
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+        // Pack the 6-bit values into 24-bit groups and then bytes in order
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        out = _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i*)buffer, out);
+        index += 16;
+        buffer += 12;
+        buflen -= 12;
+    }
+    return index;
+}  // end Base64DecodeBlocksSSSE3()
+
+__attribute__((target("avx2")))
+static unsigned int Base64DecodeBlocksAVX2(const char* input, unsigned int numBytes,
+                                           char* buffer, unsigned int buflen)
+{
+    const __m256i lutLo = _mm256_setr_epi8(BASE64_LUT_LO, BASE64_LUT_LO);
+    const __m256i lutHi = _mm256_setr_epi8(BASE64_LUT_HI, BASE64_LUT_HI);
+    const __m256i lutRoll = _mm256_setr_epi8(BASE64_LUT_ROLL, BASE64_LUT_ROLL);
+    const __m256i mask2F = _mm256_set1_epi8(0x2f);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    unsigned int index = 0;
+    while (((numBytes - index) >= 32) && (buflen >= 32))
+    {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(input + index));
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble);
+        __m256i loNibbles = _mm256_and_si256(in, nibble);
+        __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm256_testz_si256(lo, hi)) break;  // a non-Base64 character
+        __m256i eq2F = _mm256_cmpeq_epi8(in, mask2F);
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        __m256i values = _mm256_add_epi8(in, roll);
+        __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i out = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        out = _mm256_shuffle_epi8(out, pack);
+        // (gather the 12 bytes from each 128-bit lane)
+        out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i*)buffer, out);
+        index += 32;
+        buffer += 24;
+        buflen -= 24;
+    }
+    return index;
+}  // end Base64DecodeBlocksAVX2()
+
+#endif // PROTO_BASE64_X86
 
 void ProtoBase64::Init()
 {
-    // Init to invalid value
-    memset(BASE64_DECODE, -1, 255);
-    for (unsigned int i = 0; i < 64; i++)
-        BASE64_DECODE[(unsigned char)BASE64_ENCODE[i]] = i;
+    for (unsigned int a = 0; a < 2; a++)
+    {
+        // Init to invalid value
+        memset(BASE64_DECODE[a], -1, 256);
+        for (unsigned int i = 0; i < 64; i++)
+            BASE64_DECODE[a][(unsigned char)BASE64_ENCODE[a][i]] = i;
+        for (unsigned int i = 0; i < 4096; i++)
+        {
+            BASE64_ENCODE_PAIRS[a][i][0] = BASE64_ENCODE[a][i >> 6];
+            BASE64_ENCODE_PAIRS[a][i][1] = BASE64_ENCODE[a][i & 0x3f];
+        }
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            char bits = BASE64_DECODE[a][i];
+            for (unsigned int k = 0; k < 4; k++)
+                BASE64_DECODE_BITS[a][k][i] = (bits < 0) ? BASE64_INVALID_BITS : ((UINT32)bits << (18 - 6*k));
+        }
+    }
     initialized = true;
+    SetCodec(CODEC_AUTO);
 }  // end ProtoBase64::Init()
 
+bool ProtoBase64::SetCodec(Codec theCodec)
+{
+    if (!initialized) Init();
+    bool ssse3 = false;
+    bool avx2 = false;
+#ifdef PROTO_BASE64_X86
+    __builtin_cpu_init();
+    ssse3 = (0 != __builtin_cpu_supports("ssse3"));
+    avx2 = (0 != __builtin_cpu_supports("avx2"));
+#endif // PROTO_BASE64_X86
+    switch (theCodec)
+    {
+        case CODEC_AUTO:
+            codec = avx2 ? CODEC_AVX2 : (ssse3 ? CODEC_SSSE3 : CODEC_SWAR);
+            return true;
+        case CODEC_SSSE3:
+            if (!ssse3) return false;
+            break;
+        case CODEC_AVX2:
+            if (!avx2) return false;
+            break;
+        default:
+            break;
+    }
+    codec = theCodec;
+    return true;
+}  // end ProtoBase64::SetCodec()
+
+ProtoBase64::Codec ProtoBase64::GetCodec()
+{
+    if (!initialized) Init();
+    return codec;
+}  // end ProtoBase64::GetCodec()
+
 unsigned int ProtoBase64::ComputeEncodedSize(unsigned int numBytes, unsigned int maxLineLength, bool includePadding)
 {
     unsigned int quads = numBytes / 3;
@@ -38,114 +274,180 @@ unsigned int ProtoBase64::ComputeEncodedSize(unsigned int numBytes, unsigned int
 }  // end ProtoBase64::ComputeEncodedSize()
 
 
-// This inline helper function sets a value in the encoder output buffer, making sure there is sufficient
-// buffer space _and_ inserting CR/LF whenever maxLineLength (if applicable) is reached
+// This inline helper function sets a value in the encoder output buffer, inserting CR/LF
+// whenever maxLineLength (if applicable) is reached (the caller has made sure there is
+// sufficient buffer space)
 // (This also updates the reference "outdex" and "lineLength" parameters passed in)
-// Note this return "true" on success and "false" when there is insufficient buffer space
-static inline bool SetOutputValue(char value, char* buffer, unsigned int buflen, unsigned int& outdex, unsigned int& lineLength, unsigned int maxLineLength)
+static inline void SetOutputValue(char value, char* buffer, unsigned int& outdex, unsigned int& lineLength, unsigned int maxLineLength)
+{
+    buffer[outdex++] = value;
+    if (++lineLength == maxLineLength)
+    {
+        lineLength = 0;
+        buffer[outdex++] = '\r';
+        buffer[outdex++] = '\n';
+    }
+}  // end SetOutputValue()
+
+// Encodes "numBytes" (a multiple of 3) to 4 characters per 3 bytes without line breaks
+void ProtoBase64::EncodeBlocks(const unsigned char* input, unsigned int numBytes, char* buffer, Alphabet alphabet)
+{
+    const char* table = BASE64_ENCODE[alphabet];
+    unsigned int index = 0;
+    switch (codec)
+    {
+        case CODEC_BYTE:
+            for (; index < numBytes; index += 3)
+            {
+                *buffer++ = table[input[index] >> 2];
+                *buffer++ = table[((input[index] << 4) & 0x30) | (input[index+1] >> 4)];
+                *buffer++ = table[((input[index+1] << 2) & 0x3c) | (input[index+2] >> 6)];
+                *buffer++ = table[input[index+2] & 0x3f];
+            }
+            return;
+#ifdef PROTO_BASE64_X86
+        case CODEC_AVX2:
+            index = Base64EncodeBlocksAVX2(input, numBytes, buffer, table);
+            buffer += (index / 3) * 4;
+            // fall through - to finish with smaller blocks
+        case CODEC_SSSE3:
+        {
+            unsigned int count = Base64EncodeBlocksSSSE3(input + index, numBytes - index, buffer, table);
+            index += count;
+            buffer += (count / 3) * 4;
+            break;
+        }
+#endif // PROTO_BASE64_X86
+        default:
+            break;
+    }
+    const char (*pairs)[2] = BASE64_ENCODE_PAIRS[alphabet];
+    // 6 bytes (48 bits) at a time, 12 bits per lookup
+    for (; (numBytes - index) >= 6; index += 6)
+    {
+        const unsigned char* ptr = input + index;
+        uint64_t bits = ((uint64_t)ptr[0] << 40) | ((uint64_t)ptr[1] << 32) | ((uint64_t)ptr[2] << 24) |
+                      ((uint64_t)ptr[3] << 16) | ((uint64_t)ptr[4] << 8) | (uint64_t)ptr[5];
+        memcpy(buffer, pairs[(bits >> 36) & 0xfff], 2);
+        memcpy(buffer + 2, pairs[(bits >> 24) & 0xfff], 2);
+        memcpy(buffer + 4, pairs[(bits >> 12) & 0xfff], 2);
+        memcpy(buffer + 6, pairs[bits & 0xfff], 2);
+        buffer += 8;
+    }
+    if (index < numBytes)
+    {
+        const unsigned char* ptr = input + index;
+        UINT32 bits = ((UINT32)ptr[0] << 16) | ((UINT32)ptr[1] << 8) | (UINT32)ptr[2];
+        memcpy(buffer, pairs[bits >> 12], 2);
+        memcpy(buffer + 2, pairs[bits & 0xfff], 2);
+    }
+}  // end ProtoBase64::EncodeBlocks()
+
+// Encodes "numBytes" (a multiple of 3) with CR/LF inserted as each "maxLineLength" (if non-zero)
+// line is filled.  The caller has made sure there is sufficient buffer space.
+void ProtoBase64::EncodeLines(const unsigned char*  input,
+                              unsigned int          numBytes,
+                              char*                 buffer,
+                              unsigned int&         outdex,
+                              unsigned int&         lineLength,
+                              unsigned int          maxLineLength,
+                              Alphabet              alphabet)
 {
-    if (outdex < buflen)
+    if (0 == maxLineLength)
+    {
+        EncodeBlocks(input, numBytes, buffer + outdex, alphabet);
+        outdex += (numBytes / 3) * 4;
+        return;
+    }
+    while (numBytes > 0)
     {
-        buffer[outdex++] = value;
-        if (++lineLength == maxLineLength)
+        // Encode the whole quads that fit on the current line at once
+        unsigned int count = 3 * ((maxLineLength - lineLength) / 4);
+        if (count > numBytes) count = numBytes;
+        if (count > 0)
         {
-            lineLength = 0;
-            if ((outdex + 1) < buflen)
+            EncodeBlocks(input, count, buffer + outdex, alphabet);
+            outdex += (count / 3) * 4;
+            lineLength += (count / 3) * 4;
+            if (lineLength == maxLineLength)
             {
+                lineLength = 0;
                 buffer[outdex++] = '\r';
                 buffer[outdex++] = '\n';
             }
-            else
-            {
-                return false;  // insufficient output buffer space
-            }
         }
-        return true;
+        else
+        {
+            // This quad is split by a line break
+            char quad[4];
+            EncodeBlocks(input, 3, quad, alphabet);
+            for (unsigned int i = 0; i < 4; i++)
+                SetOutputValue(quad[i], buffer, outdex, lineLength, maxLineLength);
+            count = 3;
+        }
+        input += count;
+        numBytes -= count;
+    }
+}  // end ProtoBase64::EncodeLines()
+
+// Encodes the final 1 or 2 input bytes (plus padding)
+void ProtoBase64::EncodeTail(const unsigned char*   input,
+                             unsigned int           numBytes,
+                             char*                  buffer,
+                             unsigned int&          outdex,
+                             unsigned int&          lineLength,
+                             unsigned int           maxLineLength,
+                             bool                   includePadding,
+                             Alphabet               alphabet)
+{
+    const char* table = BASE64_ENCODE[alphabet];
+    SetOutputValue(table[input[0] >> 2], buffer, outdex, lineLength, maxLineLength);
+    unsigned char morsel = (input[0] << 4) & 0x3f;
+    if (1 == numBytes)
+    {
+        // Generate one more output value plus two pad characters (if including padding)
+        SetOutputValue(table[morsel], buffer, outdex, lineLength, maxLineLength);
+        if (includePadding)
+        {
+            SetOutputValue(PAD64, buffer, outdex, lineLength, maxLineLength);
+            SetOutputValue(PAD64, buffer, outdex, lineLength, maxLineLength);
+        }
     }
     else
     {
-        return false;  // insufficient output buffer space
+        // Generate two more output values plus one pad character (if including padding)
+        morsel |= (input[1] >> 4) & 0x0f;
+        SetOutputValue(table[morsel], buffer, outdex, lineLength, maxLineLength);
+        SetOutputValue(table[(input[1] << 2) & 0x3f], buffer, outdex, lineLength, maxLineLength);
+        if (includePadding)
+            SetOutputValue(PAD64, buffer, outdex, lineLength, maxLineLength);
     }
-}  // end SetOutputValue()
+}  // end ProtoBase64::EncodeTail()
 
-unsigned int ProtoBase64::Encode(const char*    input, 
-                                 unsigned int   numBytes, 
-                                 char*          buffer, 
-                                 unsigned int   buflen, 
+unsigned int ProtoBase64::Encode(const char*    input,
+                                 unsigned int   numBytes,
+                                 char*          buffer,
+                                 unsigned int   buflen,
                                  unsigned int   maxLineLength,
-                                 bool           includePadding)
+                                 bool           includePadding,
+                                 Alphabet       alphabet)
 {
     if (!initialized) ProtoBase64::Init();
     // Every 3 bytes in yields 4 bytes out (plus CR/LF if maxLineLength >= 0)
-    unsigned int index = 0;
+    if (ComputeEncodedSize(numBytes, maxLineLength, includePadding) > buflen)
+        return 0; // insufficient output buffer space
+    const unsigned char* data = (const unsigned char*)input;
     unsigned int outdex = 0;
     unsigned int lineLength = 0;
-    while (numBytes > 0)
-    {
-        // At least one output value is generated
-        unsigned char morsel = (input[index] >> 2) & 0x3f;
-        if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-            return 0; // insufficient output buffer space
-        morsel = (input[index++] << 4) & 0x3f;
-        switch (numBytes)
-        {
-            case 1:  // Only 1 input byte remains
-            {
-                // Generate one more output value plus two pad characters (if including padding)
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                if (includePadding)
-                {
-                    // Two pad characters are inserted in this case
-                    if (!SetOutputValue(PAD64, buffer, buflen, outdex, lineLength, maxLineLength))
-                        return 0; // insufficient output buffer space
-                    if (!SetOutputValue(PAD64, buffer, buflen, outdex, lineLength, maxLineLength))
-                        return 0; // insufficient output buffer space
-                }
-                numBytes = 0;
-                break;
-            }
-            case 2:  // Only 2 input bytes remain
-            {
-                // Generate two more output values plus one pad character (if including padding)
-                morsel |= (input[index] >> 4) & 0x0f;
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                morsel = (input[index++] << 2) & 0x3f;
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                if (includePadding)
-                {
-                    // Only on epad character is inserted in this case
-                    if (!SetOutputValue(PAD64, buffer, buflen, outdex, lineLength, maxLineLength))
-                        return 0; // insufficient output buffer space
-                }
-                numBytes = 0;
-                break;
-            }
-            default:  // 3 or more input bytes remain
-            {
-                // Generate 3 more output values
-                morsel |= (input[index] >> 4) & 0x0f;
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                morsel = (input[index++] << 2) & 0x3f;
-                morsel |= (input[index] >> 6) & 0x03;
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                morsel = input[index++] & 0x3f;
-                if (!SetOutputValue(BASE64_ENCODE[morsel], buffer, buflen, outdex, lineLength, maxLineLength))
-                    return 0; // insufficient output buffer space
-                numBytes -= 3;
-                break;
-            }
-        }
-    }  // end while (numBytes > 0)
+    unsigned int remainder = numBytes % 3;
+    EncodeLines(data, numBytes - remainder, buffer, outdex, lineLength, maxLineLength, alphabet);
+    if (0 != remainder)
+        EncodeTail(data + numBytes - remainder, remainder, buffer, outdex, lineLength, maxLineLength, includePadding, alphabet);
     // NULL-terminate the encoded base64 text if there is space
     if (outdex < buflen) buffer[outdex] = '\0';
     return outdex;
 }  // end ProtoBase64::Encode()
-        
+
 unsigned int ProtoBase64::EstimateDecodedSize(unsigned int numBytes, unsigned int maxLineLength)
 {
     // This is a _conservative_ estimate (i.e., may over-estimate size)
@@ -166,18 +468,17 @@ unsigned int ProtoBase64::EstimateDecodedSize(unsigned int numBytes, unsigned in
     return size;
 }  // end ProtoBase64::EstimateDecodedSize()
 
-unsigned int ProtoBase64::DetermineDecodedSize(const char* input, unsigned int numBytes)
+unsigned int ProtoBase64::DetermineDecodedSize(const char* input, unsigned int numBytes, Alphabet alphabet)
 {
     if (!initialized) Init();
+    const char* decode = BASE64_DECODE[alphabet];
     // Each 4 bytes of input (CR/LF, etc withstanding) yields 3-bytes of output
     unsigned int validBytes = 0;
     for (unsigned int index = 0; index < numBytes; index++)
     {
-        char value = input[index];
-        if (PAD64 == value) continue;
-        char bits = BASE64_DECODE[(unsigned char)value];
-        if (bits < 0) continue;  // non-Base64 character
-        validBytes += 1;
+        // (the pad and other non-Base64 characters are negative in the table)
+        if (decode[(unsigned char)input[index]] >= 0)
+            validBytes += 1;
     }
     // For every 4 "valid encoded bytes", 3 output bytes are generated
     unsigned int quads = validBytes / 4;
@@ -189,19 +490,78 @@ unsigned int ProtoBase64::DetermineDecodedSize(const char* input, unsigned int n
     return size;
 }  // end ProtoBase64::DetermineDecodedSize()
 
-unsigned int ProtoBase64::Decode(const char* input, unsigned int numBytes, char* buffer, unsigned int buflen)
+// Decodes the leading run of Base64 characters (whole quads) in "input", stopping at any
+// other character (e.g. a pad or CR/LF) or when "buflen" is reached.  Returns the number
+// of characters decoded (3 bytes are output for each 4)
+unsigned int ProtoBase64::DecodeBlocks(const char* input, unsigned int numBytes, char* buffer, unsigned int buflen, Alphabet alphabet)
 {
-    if (!initialized) Init();
+    unsigned int index = 0;
+    switch (codec)
+    {
+        case CODEC_BYTE:
+            return 0;
+#ifdef PROTO_BASE64_X86
+        case CODEC_AVX2:
+            if (STANDARD != alphabet) break;
+            index = Base64DecodeBlocksAVX2(input, numBytes, buffer, buflen);
+            buffer += (index / 4) * 3;
+            buflen -= (index / 4) * 3;
+            // fall through - to finish with smaller blocks
+        case CODEC_SSSE3:
+        {
+            if (STANDARD != alphabet) break;
+            unsigned int count = Base64DecodeBlocksSSSE3(input + index, numBytes - index, buffer, buflen);
+            index += count;
+            buffer += (count / 4) * 3;
+            buflen -= (count / 4) * 3;
+            break;
+        }
+#endif // PROTO_BASE64_X86
+        default:
+            break;
+    }
+    const UINT32 (*bits)[256] = BASE64_DECODE_BITS[alphabet];
+    while (((numBytes - index) >= 4) && (buflen >= 3))
+    {
+        const unsigned char* ptr = (const unsigned char*)input + index;
+        UINT32 group = bits[0][ptr[0]] | bits[1][ptr[1]] | bits[2][ptr[2]] | bits[3][ptr[3]];
+        if (0 != (group & BASE64_INVALID_BITS)) break;
+        buffer[0] = (char)(group >> 16);
+        buffer[1] = (char)(group >> 8);
+        buffer[2] = (char)group;
+        buffer += 3;
+        buflen -= 3;
+        index += 4;
+    }
+    return index;
+}  // end ProtoBase64::DecodeBlocks()
+
+// Decodes "input" continuing from the given "offset" and partial "output" byte
+// (returns false if "buflen" is insufficient)
+bool ProtoBase64::DecodeText(const char*    input,
+                             unsigned int   numBytes,
+                             char*          buffer,
+                             unsigned int   buflen,
+                             unsigned int&  outdex,
+                             unsigned int&  offset,
+                             char&          output,
+                             Alphabet       alphabet)
+{
+    const char* decode = BASE64_DECODE[alphabet];
     // Each 4 bytes of input (CR/LF, etc withstanding) yields 3-bytes of output
-    char output = 0;
-    unsigned int outdex = 0;
-    unsigned int offset = 0;
-    for (unsigned int index = 0; index < numBytes; index++)
+    unsigned int index = 0;
+    while (index < numBytes)
     {
-        char value = input[index];
-        if (PAD64 == value) continue;
-        char bits = BASE64_DECODE[(unsigned char)value];
-        if (bits < 0) continue;  // non-Base64 character
+        if (0 == offset)
+        {
+            // Decode whole quads in bulk up to the next pad, CR/LF, etc
+            unsigned int count = DecodeBlocks(input + index, numBytes - index, buffer + outdex, buflen - outdex, alphabet);
+            index += count;
+            outdex += (count / 4) * 3;
+            if (index >= numBytes) break;
+        }
+        char bits = decode[(unsigned char)input[index++]];
+        if (bits < 0) continue;  // pad or non-Base64 character
         switch (offset)  // 0, 1, 2, 3
         {
             case 0:  // First 6 bits of 24 (just save 6 bits to "output")
@@ -210,25 +570,130 @@ unsigned int ProtoBase64::Decode(const char* input, unsigned int numBytes, char*
                 break;
             case 1:  // Second 6 bits (use 2 bits with prev "output" and save 4)
                 output |= (bits >> 4) & 0x03;
-                if (outdex >= buflen) return 0; // insufficient buffer space
+                if (outdex >= buflen) return false; // insufficient buffer space
                 buffer[outdex++] = output;
                 output = bits << 4;
                 offset = 2;
                 break;
             case 2:  // Third 6 bits (use 4 bits with prev "output" and save 2)
                 output |= (bits >> 2) & 0x0f;
-                if (outdex >= buflen) return 0; // insufficient buffer space
+                if (outdex >= buflen) return false; // insufficient buffer space
                 buffer[outdex++] = output;
                 output = bits << 6;
                 offset = 3;
                 break;
             case 3:  // Fourth 6 bits (use all 6 bits with prev "output")
                 output |= bits;
-                if (outdex >= buflen) return 0; // insufficient buffer space
+                if (outdex >= buflen) return false; // insufficient buffer space
                 buffer[outdex++] = output;
                 offset = 0;
                 break;
         }
-    }  // end for (index = 0..numBytes)
+    }  // end while (index < numBytes)
+    return true;
+}  // end ProtoBase64::DecodeText()
+
+unsigned int ProtoBase64::Decode(const char* input, unsigned int numBytes, char* buffer, unsigned int buflen, Alphabet alphabet)
+{
+    if (!initialized) Init();
+    char output = 0;
+    unsigned int outdex = 0;
+    unsigned int offset = 0;
+    if (!DecodeText(input, numBytes, buffer, buflen, outdex, offset, output, alphabet))
+        return 0;  // insufficient buffer space
     return outdex;
 }  // end ProtoBase64::Decode()
+
+ProtoBase64::Encoder::Encoder(unsigned int maxLineLength, bool includePadding, Alphabet theAlphabet)
+ : max_line_length(maxLineLength), include_padding(includePadding), alphabet(theAlphabet),
+   pending_count(0), line_length(0)
+{
+    if (!initialized) Init();
+}
+
+unsigned int ProtoBase64::Encoder::GetMaxOutput(unsigned int inputBytes) const
+{
+    // (4 characters per whole or partial 3-byte group, plus CR/LF per line filled)
+    unsigned int size = ((pending_count + inputBytes + 2) / 3) * 4;
+    if (max_line_length > 0)
+        size += 2 * ((line_length + size) / max_line_length);
+    return size;
+}  // end ProtoBase64::Encoder::GetMaxOutput()
+
+bool ProtoBase64::Encoder::Update(const char*   input,
+                                  unsigned int  numBytes,
+                                  char*         buffer,
+                                  unsigned int  buflen,
+                                  unsigned int& outdex)
+{
+    outdex = 0;
+    unsigned int total = pending_count + numBytes;
+    unsigned int size = (total / 3) * 4;
+    if (max_line_length > 0)
+        size += 2 * ((line_length + size) / max_line_length);
+    if (size > buflen) return false;  // insufficient buffer space
+    const unsigned char* data = (const unsigned char*)input;
+    if (total < 3)
+    {
+        memcpy(pending + pending_count, data, numBytes);
+        pending_count = total;
+        return true;
+    }
+    if (pending_count > 0)
+    {
+        // Complete the group left over from the previous chunk
+        unsigned int count = 3 - pending_count;
+        memcpy(pending + pending_count, data, count);
+        EncodeLines(pending, 3, buffer, outdex, line_length, max_line_length, alphabet);
+        data += count;
+        numBytes -= count;
+    }
+    pending_count = numBytes % 3;
+    EncodeLines(data, numBytes - pending_count, buffer, outdex, line_length, max_line_length, alphabet);
+    memcpy(pending, data + numBytes - pending_count, pending_count);
+    return true;
+}  // end ProtoBase64::Encoder::Update()
+
+bool ProtoBase64::Encoder::Finish(char* buffer, unsigned int buflen, unsigned int& outdex)
+{
+    outdex = 0;
+    if (GetMaxOutput(0) > buflen) return false;  // insufficient buffer space
+    if (pending_count > 0)
+        EncodeTail(pending, pending_count, buffer, outdex, line_length, max_line_length, include_padding, alphabet);
+    Reset();
+    return true;
+}  // end ProtoBase64::Encoder::Finish()
+
+ProtoBase64::Decoder::Decoder(Alphabet theAlphabet)
+ : alphabet(theAlphabet), offset(0), output(0)
+{
+    if (!initialized) Init();
+}
+
+unsigned int ProtoBase64::Decoder::GetMaxOutput(unsigned int inputBytes) const
+{
+    // (3 bytes per 4 characters, with the first byte output on the second character)
+    unsigned int total = offset + inputBytes;
+    return ((total / 4) * 3 + ((total % 4) * 3) / 4 - (offset * 3) / 4);
+}  // end ProtoBase64::Decoder::GetMaxOutput()
+
+bool ProtoBase64::Decoder::Update(const char*   input,
+                                  unsigned int  numBytes,
+                                  char*         buffer,
+                                  unsigned int  buflen,
+                                  unsigned int& outdex)
+{
+    outdex = 0;
+    if (GetMaxOutput(numBytes) > buflen)
+    {
+        // Count the Base64 characters (excluding pad, CR/LF, etc) for the actual size
+        const char* decode = BASE64_DECODE[alphabet];
+        unsigned int count = 0;
+        for (unsigned int index = 0; index < numBytes; index++)
+        {
+            if (decode[(unsigned char)input[index]] >= 0) count++;
+        }
+        if (GetMaxOutput(count) > buflen) return false;  // insufficient buffer space
+    }
+    return DecodeText(input, numBytes, buffer, buflen, outdex, offset, output, alphabet);
+}  // end ProtoBase64::Decoder::Update()
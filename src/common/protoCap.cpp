@@ -69,3 +69,23 @@ bool ProtoCap::ForwardFrom(char* buffer, unsigned int& numBytes, const ProtoAddr
     memcpy(buffer+6, srcMacAddr.GetRawHostAddress(), 6);
     return Send(buffer, numBytes);
 }  // end ProtoCap::ForwardFrom()
+
+
+/**
+ * @brief Sends a batch of frames, stopping at the first frame that would block or fails
+ *
+ * @param bufferList array of frame buffer pointers
+ * @param lengthList array of frame lengths
+ * @param count number of frames
+ *
+ * @return number of frames sent
+ */
+unsigned int ProtoCap::SendBatch(const char* const* bufferList, const unsigned int* lengthList, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int numBytes = lengthList[i];
+        if (!Send(bufferList[i], numBytes) || (0 == numBytes)) return i;
+    }
+    return count;
+}  // end ProtoCap::SendBatch()
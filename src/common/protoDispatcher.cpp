@@ -37,6 +37,7 @@
 */
 
 #include "protoDispatcher.h"
+#include "protoTrace.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -58,6 +59,9 @@ const ProtoDispatcher::WaitStatus ProtoDispatcher::WAIT_ERROR = WAIT_FAILED;
 #else
 #include <sys/resource.h>
 #endif // HAVE_SCHED
+#ifdef LINUX
+#include <sys/prctl.h>  // for PR_SET_TIMERSLACK
+#endif // LINUX
 const ProtoDispatcher::Descriptor ProtoDispatcher::INVALID_DESCRIPTOR = -1;
 const ProtoDispatcher::WaitStatus ProtoDispatcher::WAIT_ERROR = -1;
 #endif  // if/else WIN32/UNIX
@@ -113,6 +117,7 @@ ProtoDispatcher::GenericStream::GenericStream(Descriptor theDescriptor)
             
 ProtoDispatcher::ProtoDispatcher()
     : run(false), wait_status(WAIT_ERROR), exit_code(0), timer_delay(-1), precise_timing(false),
+      high_resolution(false), spin_window(0.0),
       thread_id((ThreadId)(NULL)), external_thread(false), priority_boost(false), 
       thread_started(false), thread_signaled(false), thread_master((ThreadId)(NULL)), 
       suspend_count(0), signal_count(0), controller(NULL), 
@@ -135,6 +140,9 @@ ProtoDispatcher::ProtoDispatcher()
       ,kevent_queue(-1)
 #elif defined(USE_EPOLL)
       ,epoll_fd(-1)
+#ifdef HAVE_EPOLL_PWAIT2
+      ,use_epoll_pwait2(true)
+#endif // HAVE_EPOLL_PWAIT2
 #else
 #error "undefined async i/o mechanism"  // to make sure we implement something
 #endif  // if/else USE_SELECT / USE_KQUEUE / USE_EPOLL
@@ -903,6 +911,21 @@ int ProtoDispatcher::Run(bool oneShot)
     wait_status = WAIT_ERROR;  
     if (priority_boost) BoostPriority();
     
+#ifdef LINUX
+    // In high resolution mode, minimize the kernel "timer slack" (50 usec
+    // by default) that is otherwise added to every timed wait of this thread
+    int timerSlack = -1;
+    if (high_resolution)
+    {
+        timerSlack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+        if ((timerSlack < 0) || (0 != prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0)))
+        {
+            PLOG(PL_WARN, "ProtoDispatcher::Run() warning: unable to set timer slack: %s\n", GetErrorString());
+            timerSlack = -1;
+        }
+    }
+#endif // LINUX
+    
 #ifdef USE_TIMERFD  // LINUX-only
     int tfd = timerfd_create(CLOCK_MONOTONIC, 0);
     if (tfd < 0)
@@ -938,7 +961,38 @@ int ProtoDispatcher::Run(bool oneShot)
     run = oneShot ? false : true;
     do
     { 
-        if (IsPending())
+        if (IsVirtualTime())  // (never threaded, see SetVirtualTime())
+        {
+            // Poll for ready I/O and service any timers that are due, then,
+            // if no I/O was ready, jump the virtual clock directly to the 
+            // next timeout instead of waiting for it
+            bool ioReady = false;
+            if (!stream_table.IsEmpty())
+            {
+                timer_delay = 0.0;
+                Wait();
+#ifdef WIN32
+                ioReady = (WAIT_TIMEOUT != wait_status) && (WAIT_ERROR != wait_status);
+#else
+                ioReady = (wait_status > 0);
+#endif // if/else WIN32
+                Dispatch();
+            }
+            // (due timers must run even while a descriptor stays ready, not
+            // only when Dispatch() happens to service them after I/O)
+            if (0.0 == ProtoTimerMgr::GetTimeRemaining()) OnSystemTimeout();
+            if (ioReady || AdvanceVirtualTime()) continue;
+            if (stream_table.IsEmpty())
+            {
+                PLOG(PL_DEBUG, "ProtoDispatcher::Run() would be stuck with no timers & no inputs!\n");
+                break;
+            }
+            // No timers, so block until there is I/O
+            timer_delay = -1.0;
+            Wait();
+            Dispatch();
+        }
+        else if (IsPending())
         {
             // Here we "latch" the next timeout _before_
             // we open the suspend window to be safe
@@ -1022,6 +1076,9 @@ int ProtoDispatcher::Run(bool oneShot)
 	CloseHandle(timer_stream.GetDescriptor());
 	timer_stream.SetDescriptor(INVALID_DESCRIPTOR);
 #endif // USE_WAITABLE_TIMER
+#ifdef LINUX
+    if (timerSlack > 0) prctl(PR_SET_TIMERSLACK, timerSlack, 0, 0, 0);
+#endif // LINUX
 	return exit_code;
 }  // end ProtoDispatcher::Run()
 
@@ -1059,12 +1116,24 @@ void* ProtoDispatcher::DoThreadStart(void* param)
     if (NULL != dp->controller) Lock(dp->controller->lock_b);
     Lock(dp->suspend_mutex);
     dp->thread_started = true;
+    PROTO_TRACE_THREAD_NAME("ProtoDispatcher");
     dp->exit_status = dp->Run();  // TBD - should have Run() set exit_status internally instead???
     Unlock(dp->suspend_mutex);
     DoThreadExit(dp->GetExitStatus());
     return (dp->GetExitStatus());
 }  // end ProtoDispatcher::DoThreadStart()
 
+bool ProtoDispatcher::SetVirtualTime(bool state)
+{
+    // The threaded Run() loop waits in real time, so virtual time
+    // would leave the timers of a threaded dispatcher stalled
+    if (state && IsThreaded())
+    {
+        PLOG(PL_ERROR, "ProtoDispatcher::SetVirtualTime() error: virtual time not supported when threaded\n");
+        return false;
+    }
+    return ProtoTimerMgr::SetVirtualTime(state);
+}  // end ProtoDispatcher::SetVirtualTime()
 
 bool ProtoDispatcher::StartThread(bool                         priorityBoost,
                                   ProtoDispatcher::Controller* theController,
@@ -1075,6 +1144,11 @@ bool ProtoDispatcher::StartThread(bool                         priorityBoost,
         PLOG(PL_ERROR, "ProtoDispatcher::StartThread() error: thread already started\n");
         return false;
     }
+    if (IsVirtualTime())
+    {
+        PLOG(PL_ERROR, "ProtoDispatcher::StartThread() error: virtual time not supported when threaded\n");
+        return false;
+    }
     priority_boost = priorityBoost;
     if (!InstallBreak())
     {
@@ -1673,12 +1747,13 @@ void ProtoDispatcher::RemoveBreak()
  */
 void ProtoDispatcher::Wait()
 {
+    PROTO_TRACE_SCOPE("dispatcher", "Wait");
     // (TBD) We could put some code here to protect this from
     // being called by the wrong thread?
     
-#if defined(USE_KQUEUE) || defined(HAVE_PSELECT) || defined(USE_TIMERFD)
+#if defined(USE_KQUEUE) || defined(HAVE_PSELECT) || defined(USE_TIMERFD) || defined(HAVE_EPOLL_PWAIT2)
 #define USE_TIMESPEC 1 // so we can use the "struct timespec" created here
-#endif  // USE_KQUEUE || HAVE_PSELECT || USE_TIMERFD    
+#endif  // USE_KQUEUE || HAVE_PSELECT || USE_TIMERFD || HAVE_EPOLL_PWAIT2
     
     
 #ifdef USE_SELECT
@@ -1723,6 +1798,10 @@ void ProtoDispatcher::Wait()
         // If (true == precise_timing) essentially force polling for small delays
         // (Note this will consume CPU resources)
         if (precise_timing && (timerDelay < PRECISE_THRESHOLD)) timerDelay = 0.0;
+        // Hybrid block/spin policy: block until "spin_window" before the
+        // timeout and then poll (zero timeout) until the timeout expires
+        if (spin_window > 0.0)
+            timerDelay = (timerDelay > spin_window) ? (timerDelay - spin_window) : 0.0;
         timeout.tv_sec = (unsigned long)timerDelay;
 #ifdef USE_TIMESPEC
         timeout.tv_nsec = 
@@ -1733,7 +1812,13 @@ void ProtoDispatcher::Wait()
 #endif // if/else USE_TIMESPEC
         timeoutPtr = &timeout;
 #ifdef USE_TIMERFD
-        if ((0 != timeout.tv_nsec) || (0 != timeout.tv_sec))
+#ifdef HAVE_EPOLL_PWAIT2
+        // (epoll_pwait2() takes the nanosecond timeout directly)
+        bool useTimerFd = !(high_resolution && use_epoll_pwait2);
+#else
+        bool useTimerFd = true;
+#endif // if/else HAVE_EPOLL_PWAIT2
+        if (useTimerFd && ((0 != timeout.tv_nsec) || (0 != timeout.tv_sec)))
         {
             // Install the timerfd descriptor to our "input_set"
             // configured with an appropriate one-shot timeout
@@ -1816,7 +1901,23 @@ void ProtoDispatcher::Wait()
 
     // Note if (NULL == timeoutPtr), then the timer_fd has been set up with the proper timeout value
     // (otherwise we convert "timerDelay" to milliseconds)
-    wait_status = epoll_wait(epoll_fd, epoll_event_array, EPOLL_ARRAY_SIZE, (NULL != timeoutPtr) ? (int)(timerDelay*1000.0) : -1);
+#ifdef HAVE_EPOLL_PWAIT2
+    if (high_resolution && use_epoll_pwait2)
+    {
+        wait_status = epoll_pwait2(epoll_fd, epoll_event_array, EPOLL_ARRAY_SIZE, timeoutPtr, NULL);
+        if ((wait_status < 0) && (ENOSYS == errno))
+        {
+            // Kernel lacks epoll_pwait2() (pre-5.11), so fall back to timerfd
+            PLOG(PL_WARN, "ProtoDispatcher::Wait() warning: epoll_pwait2() not supported, using timerfd\n");
+            use_epoll_pwait2 = false;
+            wait_status = 0;  // treated as a timeout so the wait is simply redone
+        }
+    }
+    else
+#endif // HAVE_EPOLL_PWAIT2
+    {
+        wait_status = epoll_wait(epoll_fd, epoll_event_array, EPOLL_ARRAY_SIZE, (NULL != timeoutPtr) ? (int)(timerDelay*1000.0) : -1);
+    }
      
 #elif defined(USE_KQUEUE)
     if (-1 == kevent_queue)
@@ -1840,6 +1941,8 @@ void ProtoDispatcher::Wait()
 
 void ProtoDispatcher::Dispatch()
 {
+    PROTO_TRACE_SCOPE("dispatcher", "Dispatch");
+    if (wait_status >= 0) PROTO_TRACE_COUNTER("dispatcher", "ready descriptors", wait_status);
 #if defined(USE_SELECT)
     // Here the "wait_status" is the return value from the select() call
     switch (wait_status)
@@ -2426,6 +2529,7 @@ bool ProtoDispatcher::Win32IncreaseStreamArraySize()
 
 void ProtoDispatcher::Wait()
 {
+    PROTO_TRACE_SCOPE("dispatcher", "Wait");
     double timerDelay = timer_delay;
 	// Don't wait if we have "ready" streams pending
 	if (!ready_stream_list.IsEmpty()) timerDelay = 0.0;
@@ -2527,6 +2631,7 @@ void ProtoDispatcher::Wait()
       
 void ProtoDispatcher::Dispatch()
 { 
+    PROTO_TRACE_SCOPE("dispatcher", "Dispatch");
     switch (wait_status)
     {
         case WAIT_ERROR:            // error status
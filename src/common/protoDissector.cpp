@@ -0,0 +1,250 @@
+#include "protoDissector.h"
+#include "protoPktIP.h"
+
+#include <string.h>  // for memset(), memcpy()
+
+static inline UINT16 GetNet16(const UINT8* ptr)
+{
+    return (((UINT16)ptr[0] << 8) | ptr[1]);
+}  // end GetNet16()
+
+bool ProtoDissector::Descriptor::GetSrcAddr(ProtoAddress& addr) const
+{
+    if (0 == (flags & FLAG_L3))
+    {
+        addr.Invalidate();
+        return false;
+    }
+    addr.SetRawHostAddress((6 == version) ? ProtoAddress::IPv6 : ProtoAddress::IPv4,
+                           (const char*)src_addr, GetAddrLength());
+    addr.SetPort(src_port);
+    return true;
+}  // end ProtoDissector::Descriptor::GetSrcAddr()
+
+bool ProtoDissector::Descriptor::GetDstAddr(ProtoAddress& addr) const
+{
+    if (0 == (flags & FLAG_L3))
+    {
+        addr.Invalidate();
+        return false;
+    }
+    addr.SetRawHostAddress((6 == version) ? ProtoAddress::IPv6 : ProtoAddress::IPv4,
+                           (const char*)dst_addr, GetAddrLength());
+    addr.SetPort(dst_port);
+    return true;
+}  // end ProtoDissector::Descriptor::GetDstAddr()
+
+unsigned int ProtoDissector::Dissect(LinkType             linkType,
+                                     unsigned int         count,
+                                     const void* const*   frameList,
+                                     const unsigned int*  lengthList,
+                                     Descriptor*          descList)
+{
+    unsigned int validCount = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+#ifdef __GNUC__
+        // Start loading the headers of an upcoming frame (and the
+        // descriptor it will be written to) while this one is parsed
+        if ((i + PREFETCH_AHEAD) < count)
+        {
+            __builtin_prefetch(frameList[i + PREFETCH_AHEAD], 0);
+            __builtin_prefetch(descList + i + PREFETCH_AHEAD, 1);
+        }
+#endif // __GNUC__
+        if (DissectFrame(linkType, (const UINT8*)frameList[i], lengthList[i], descList[i]))
+            validCount++;
+    }
+    return validCount;
+}  // end ProtoDissector::Dissect()
+
+bool ProtoDissector::Dissect(LinkType     linkType,
+                             const void*  frame,
+                             unsigned int length,
+                             Descriptor&  desc)
+{
+    return DissectFrame(linkType, (const UINT8*)frame, length, desc);
+}  // end ProtoDissector::Dissect()
+
+bool ProtoDissector::DissectFrame(LinkType linkType, const UINT8* frame, unsigned int length, Descriptor& desc)
+{
+    memset(&desc, 0, sizeof(Descriptor));
+    // (offsets are 16 bits, so anything beyond is treated as truncated)
+    if (length > 0xffff) length = 0xffff;
+
+    // 1) Link layer
+    unsigned int offset;
+    UINT16 etherType;
+    switch (linkType)
+    {
+        case LINK_ETHERNET:
+            if (length < 14) return false;
+            etherType = GetNet16(frame + 12);
+            offset = 14;
+            // Up to two VLAN tags (802.1ad outer, 802.1Q inner)
+            for (unsigned int tags = 0; tags < 2; tags++)
+            {
+                if ((0x8100 != etherType) && (0x88a8 != etherType)) break;
+                if ((offset + 4) > length) return false;
+                if (0 == tags) desc.vlan_id = GetNet16(frame + offset) & 0x0fff;
+                desc.flags |= Descriptor::FLAG_VLAN;
+                etherType = GetNet16(frame + offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINK_LINUX_SLL:
+            if (length < 16) return false;
+            etherType = GetNet16(frame + 14);
+            offset = 16;
+            break;
+        case LINK_RAW:
+            if (length < 1) return false;
+            switch (frame[0] >> 4)
+            {
+                case 4:
+                    etherType = 0x0800;
+                    break;
+                case 6:
+                    etherType = 0x86dd;
+                    break;
+                default:
+                    return false;
+            }
+            offset = 0;
+            break;
+        default:
+            return false;
+    }
+    desc.ether_type = etherType;
+    desc.l3_offset = offset;
+
+    // 2) Network layer
+    const UINT8* ipPtr = frame + offset;
+    unsigned int ipLen = length - offset;   // (captured bytes past L3 offset)
+    const UINT8* l4Ptr;
+    unsigned int l4Len;
+    UINT8 protocol;
+    bool firstFragment = true;
+    switch (etherType)
+    {
+        case 0x0800:  // IPv4
+        {
+            if ((ipLen < 20) || (4 != (ipPtr[0] >> 4))) return false;
+            unsigned int hdrLen = (ipPtr[0] & 0x0f) << 2;
+            unsigned int totalLen = GetNet16(ipPtr + 2);
+            if ((hdrLen < 20) || (totalLen < hdrLen) || (hdrLen > ipLen)) return false;
+            if (totalLen > ipLen)
+                desc.flags |= Descriptor::FLAG_TRUNCATED;
+            else
+                ipLen = totalLen;  // (excludes any link padding)
+            desc.version = 4;
+            desc.traffic_class = ipPtr[1];
+            desc.ttl = ipPtr[8];
+            protocol = ipPtr[9];
+            memcpy(desc.src_addr, ipPtr + 12, 4);
+            memcpy(desc.dst_addr, ipPtr + 16, 4);
+            UINT16 fragment = GetNet16(ipPtr + 6);
+            if (0 != (fragment & 0x3fff))  // (MF flag or non-zero offset)
+            {
+                desc.flags |= Descriptor::FLAG_FRAGMENT;
+                firstFragment = (0 == (fragment & 0x1fff));
+            }
+            l4Ptr = ipPtr + hdrLen;
+            l4Len = ipLen - hdrLen;
+            break;
+        }
+        case 0x86dd:  // IPv6
+        {
+            if ((ipLen < 40) || (6 != (ipPtr[0] >> 4))) return false;
+            unsigned int totalLen = 40 + GetNet16(ipPtr + 4);
+            if (totalLen > ipLen)
+                desc.flags |= Descriptor::FLAG_TRUNCATED;
+            else
+                ipLen = totalLen;
+            desc.version = 6;
+            desc.traffic_class = (UINT8)(GetNet16(ipPtr) >> 4);
+            desc.ttl = ipPtr[7];
+            memcpy(desc.src_addr, ipPtr + 8, 16);
+            memcpy(desc.dst_addr, ipPtr + 24, 16);
+            // Skip any extension headers to find the upper layer protocol
+            protocol = ipPtr[6];
+            l4Ptr = ipPtr + 40;
+            l4Len = ipLen - 40;
+            while (ProtoPktIP::IsExtension((ProtoPktIP::Protocol)protocol) && (l4Len >= 8))
+            {
+                unsigned int extLen;
+                switch (protocol)
+                {
+                    case ProtoPktIP::FRAG:
+                        extLen = 8;
+                        desc.flags |= Descriptor::FLAG_FRAGMENT;
+                        if (0 != (GetNet16(l4Ptr + 2) & 0xfff8))
+                            firstFragment = false;
+                        break;
+                    case ProtoPktIP::AUTH:
+                        extLen = ((unsigned int)l4Ptr[1] + 2) << 2;
+                        break;
+                    default:  // HOPOPT, DSTOPT, RTG
+                        extLen = ((unsigned int)l4Ptr[1] + 1) << 3;
+                        break;
+                }
+                if (extLen > l4Len) break;
+                protocol = l4Ptr[0];
+                l4Ptr += extLen;
+                l4Len -= extLen;
+                // A non-first fragment's payload continues the original
+                // packet's data, so any "headers" that follow aren't ours
+                if (!firstFragment) break;
+            }
+            if (ProtoPktIP::IsExtension((ProtoPktIP::Protocol)protocol))
+                firstFragment = false;  // (truncated extension header chain)
+            break;
+        }
+        default:
+            return false;
+    }
+    desc.protocol = protocol;
+    desc.flags |= Descriptor::FLAG_L3;
+    desc.l4_offset = (UINT16)(l4Ptr - frame);
+
+    // 3) Transport layer (ports and TCP flags are taken even when the
+    //    header is incomplete, but FLAG_L4 is only set for a full header)
+    unsigned int l4HdrLen = 0;
+    if (firstFragment)
+    {
+        switch (protocol)
+        {
+            case ProtoPktIP::TCP:
+                if (l4Len >= 14) desc.tcp_flags = l4Ptr[13];
+                if (l4Len >= 20)
+                {
+                    unsigned int dataOffset = (l4Ptr[12] >> 4) << 2;
+                    if ((dataOffset >= 20) && (dataOffset <= l4Len)) l4HdrLen = dataOffset;
+                }
+                // fall through - to get ports
+            case ProtoPktIP::UDP:
+            case 132:  // SCTP
+                if (l4Len >= 4)
+                {
+                    desc.src_port = GetNet16(l4Ptr);
+                    desc.dst_port = GetNet16(l4Ptr + 2);
+                }
+                if (ProtoPktIP::UDP == protocol)
+                    l4HdrLen = (l4Len >= 8) ? 8 : 0;
+                else if (132 == protocol)
+                    l4HdrLen = (l4Len >= 12) ? 12 : 0;  // (common header)
+                break;
+            case ProtoPktIP::ICMP:
+            case ProtoPktIP::ICMPv6:
+                if (l4Len >= 2) desc.dst_port = GetNet16(l4Ptr);  // type and code
+                if (l4Len >= 8) l4HdrLen = 8;
+                break;
+            default:
+                break;
+        }
+    }
+    if (0 != l4HdrLen) desc.flags |= Descriptor::FLAG_L4;
+    desc.payload_offset = desc.l4_offset + l4HdrLen;
+    desc.payload_length = l4Len - l4HdrLen;
+    return true;
+}  // end ProtoDissector::DissectFrame()
@@ -15,6 +15,7 @@
 #endif // !_WIN32_WCE
 #else
 #include <unistd.h>
+#include <sys/mman.h>  // for mmap()
 #endif // if/else WIN32
 
 #ifndef _WIN32_WCE
@@ -23,17 +24,214 @@
 #include <sys/stat.h>
 #endif // !_WIN32_WCE
 
+// Reads blocks of a file ahead of use in a separate thread
+class ProtoFile::ReadAhead : public ProtoThread
+{
+    public:
+        ReadAhead(ProtoFile& theFile);
+        ~ReadAhead();
+
+        bool Open(unsigned int blockSize, unsigned int blockCount);
+        void Close();
+
+        // Releases the previous block (if any) and gets the next one,
+        // waiting as needed ("count" is zero at end of file)
+        bool GetBlock(const char*& ptr, size_t& count);
+
+    private:
+        int RunThread();
+
+        ProtoFile&      file;
+        char**          block_list;
+        size_t*         length_list;
+        unsigned int    block_size;
+        unsigned int    block_count;
+        unsigned int    fill_index;
+        unsigned int    take_index;
+        unsigned int    filled_count;
+        bool            holding;    // (consumer is using the "take_index" block)
+        bool            stopping;
+        bool            eof;
+        bool            error;
+        ProtoMutex      mutex;
+        ProtoCondition  fill_cond;  // (reader waits for a free block)
+        ProtoCondition  take_cond;  // (consumer waits for a filled block)
+};  // end class ProtoFile::ReadAhead
+
+ProtoFile::ReadAhead::ReadAhead(ProtoFile& theFile)
+ : file(theFile), block_list(NULL), length_list(NULL), block_size(0), block_count(0),
+   fill_index(0), take_index(0), filled_count(0), holding(false), stopping(false),
+   eof(false), error(false)
+{
+}
+
+ProtoFile::ReadAhead::~ReadAhead()
+{
+    Close();
+}
+
+bool ProtoFile::ReadAhead::Open(unsigned int blockSize, unsigned int blockCount)
+{
+    Close();
+    if (0 == blockSize) blockSize = BUFFER_SIZE;
+    if (blockCount < 2) blockCount = 2;
+    if ((NULL == (block_list = new char*[blockCount])) ||
+        (NULL == (length_list = new size_t[blockCount])))
+    {
+        PLOG(PL_ERROR, "ProtoFile::ReadAhead::Open() new block list error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    memset(block_list, 0, blockCount * sizeof(char*));
+    block_count = blockCount;
+    for (unsigned int i = 0; i < blockCount; i++)
+    {
+        if (NULL == (block_list[i] = new char[blockSize]))
+        {
+            PLOG(PL_ERROR, "ProtoFile::ReadAhead::Open() new block error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+    }
+    block_size = blockSize;
+    fill_index = take_index = filled_count = 0;
+    holding = stopping = eof = error = false;
+    if (!StartThread())
+    {
+        PLOG(PL_ERROR, "ProtoFile::ReadAhead::Open() error: unable to start thread\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end ProtoFile::ReadAhead::Open()
+
+void ProtoFile::ReadAhead::Close()
+{
+    if (IsStarted())
+    {
+        mutex.Lock();
+        stopping = true;
+        fill_cond.Signal();
+        mutex.Unlock();
+        StopThread();  // (joins the thread, waiting for any read in progress)
+    }
+    if (NULL != block_list)
+    {
+        for (unsigned int i = 0; i < block_count; i++)
+            if (NULL != block_list[i]) delete[] block_list[i];
+        delete[] block_list;
+        block_list = NULL;
+    }
+    if (NULL != length_list)
+    {
+        delete[] length_list;
+        length_list = NULL;
+    }
+    block_count = 0;
+}  // end ProtoFile::ReadAhead::Close()
+
+int ProtoFile::ReadAhead::RunThread()
+{
+    while (true)
+    {
+        mutex.Lock();
+        while (!stopping && (filled_count == block_count))
+            fill_cond.Wait(mutex);
+        if (stopping)
+        {
+            mutex.Unlock();
+            break;
+        }
+        unsigned int index = fill_index;
+        mutex.Unlock();
+        // Fill the block (a short read means end of file or, for a pipe, 
+        // that no more is available yet, so the block is passed on as is)
+        size_t length = 0;
+        bool ok = true;
+        while (length < block_size)
+        {
+            unsigned int want = block_size - (unsigned int)length;
+            unsigned int numBytes = want;
+            if (!file.Read(block_list[index] + length, numBytes))
+            {
+                ok = false;
+                break;
+            }
+            length += numBytes;
+            if (numBytes < want) break;
+        }
+        mutex.Lock();
+        if (0 != length)
+        {
+            length_list[index] = length;
+            fill_index = (fill_index + 1) % block_count;
+            filled_count++;
+        }
+        if (!ok)
+            error = true;
+        else if (0 == length)
+            eof = true;
+        take_cond.Signal();
+        bool done = error || eof;
+        mutex.Unlock();
+        if (done) break;
+    }
+    return 0;
+}  // end ProtoFile::ReadAhead::RunThread()
+
+bool ProtoFile::ReadAhead::GetBlock(const char*& ptr, size_t& count)
+{
+    mutex.Lock();
+    if (holding)
+    {
+        take_index = (take_index + 1) % block_count;
+        filled_count--;
+        holding = false;
+        fill_cond.Signal();
+    }
+    while ((0 == filled_count) && !eof && !error)
+        take_cond.Wait(mutex);
+    bool result = true;
+    if (0 != filled_count)
+    {
+        ptr = block_list[take_index];
+        count = length_list[take_index];
+        holding = true;
+    }
+    else
+    {
+        count = 0;
+        if (error)
+        {
+            PLOG(PL_ERROR, "ProtoFile::ReadAhead::GetBlock() error: read failure\n");
+            result = false;
+        }
+    }
+    mutex.Unlock();
+    return result;
+}  // end ProtoFile::ReadAhead::GetBlock()
+
 ProtoFile::ProtoFile()
+ :
 #ifdef _WIN32_WCE
-    : file_ptr(NULL)
-#else
-#endif // if/else _WIN32_WCE
+   file_ptr(NULL),
+#endif // _WIN32_WCE
+   read_ptr(read_buffer), read_count(0), is_mapped(false), map_ptr(NULL), map_size(0),
+#ifdef WIN32
+   map_handle(NULL),
+#endif // WIN32
+   read_ahead(NULL), record_buffer(NULL), record_size(0), record_length(0)
 {
 }
 
 ProtoFile::~ProtoFile()
 {
     if (IsOpen()) Close();
+    if (NULL != record_buffer)
+    {
+        delete[] record_buffer;
+        record_buffer = NULL;
+    }
 }  // end ProtoFile::~ProtoFile()
 
 // This should be called with a full path only! (Why?)
@@ -143,6 +341,8 @@ bool ProtoFile::Open(const char* thePath, int theFlags)
 #endif // if/else WIN32/UNIX
     if (returnvalue)
     {
+        read_count = 0;
+        record_length = 0;
         return ProtoChannel::Open();
     }
     return returnvalue;
@@ -150,6 +350,10 @@ bool ProtoFile::Open(const char* thePath, int theFlags)
 
 void ProtoFile::Close()
 {
+    Unmap();
+    StopReadAhead();
+    read_count = 0;
+    record_length = 0;
     if (IsOpen())
     {
 #ifdef WIN32
@@ -420,50 +624,60 @@ bool ProtoFile::Read(char* buffer, size_t& numBytes)
     }  // end while true
 }  // end ProtoFile::Read()
 
-bool ProtoFile::ReadPrivate(char* buffer, unsigned int& numBytes)
+bool ProtoFile::FillBuffer(bool skipNonPrint)
 {
-    unsigned int want = numBytes;
-    if (read_count > 0)
-    {
-        unsigned int ncopy = MIN(want, read_count);
-        memcpy(buffer, read_ptr, ncopy);
-        read_count -= ncopy;
-        read_ptr += ncopy;
-        buffer +=ncopy;
-        want -= ncopy;
-    }
-    while (want > 0)
+    read_count = 0;
+    if (is_mapped) return true;  // (the mapping is a single block)
+    if (NULL != read_ahead) return read_ahead->GetBlock(read_ptr, read_count);
+    while (true)
     {
         unsigned int blocksize = BUFFER_SIZE;
         if (!Read(read_buffer, blocksize))
         {
-            PLOG(PL_ERROR, "ProtoFile::ReadPrivate() error: Read() failure\n");
+            PLOG(PL_ERROR, "ProtoFile::FillBuffer() error: Read() failure\n");
             return false;
         }
-        if (blocksize > 0)
+        // This check skips NULLs that have been read on some
+        // use of trpr via tail from an NFS mounted file
+        if ((0 != blocksize) && skipNonPrint &&
+            !isprint(*read_buffer) &&
+            ('\t' != *read_buffer) &&
+            ('\n' != *read_buffer) &&
+            ('\r' != *read_buffer))
         {
-            // This check skips NULLs that have been read on some
-            // use of trpr via tail from an NFS mounted file
-            if (!isprint(*read_buffer) &&
-                ('\t' != *read_buffer) &&
-                ('\n' != *read_buffer) &&
-                ('\r' != *read_buffer))
-            {
-                    continue;
-            }
-            unsigned int ncopy = MIN(want, blocksize);
-            memcpy(buffer, read_buffer, ncopy);
-            read_count = blocksize - ncopy;
-            read_ptr = read_buffer + ncopy;
-            buffer += ncopy;
-            want -= ncopy;
+            continue;
         }
-        else
+        read_ptr = read_buffer;
+        read_count = blocksize;  // (zero at EOF or EAGAIN)
+        return true;
+    }
+}  // end ProtoFile::FillBuffer()
+
+bool ProtoFile::ReadPrivate(char* buffer, unsigned int& numBytes)
+{
+    unsigned int want = numBytes;
+    while (want > 0)
+    {
+        if (0 == read_count)
         {
-            // Nothing more available (EOF or EAGAIN)
-            numBytes -= want;
-            return true;
+            if (!FillBuffer(true))
+            {
+                PLOG(PL_ERROR, "ProtoFile::ReadPrivate() error: FillBuffer() failure\n");
+                return false;
+            }
+            if (0 == read_count)
+            {
+                // Nothing more available (EOF or EAGAIN)
+                numBytes -= want;
+                return true;
+            }
         }
+        unsigned int ncopy = (unsigned int)MIN((size_t)want, read_count);
+        memcpy(buffer, read_ptr, ncopy);
+        read_count -= ncopy;
+        read_ptr += ncopy;
+        buffer += ncopy;
+        want -= ncopy;
     }
     // Filled "buffer" with requested "numBytes"
     return true;
@@ -474,18 +688,21 @@ bool ProtoFile::Readline(char*         buffer,
 {
     unsigned int count = 0;
     unsigned int length = bufferSize;
-    char* ptr = buffer;
     while (count < length)
     {
-        unsigned int one = 1;
-        if (ReadPrivate(ptr, one))
+        if (0 == read_count)
         {
-            if (0 == one)
+            if (!FillBuffer(true))
+            {
+                PLOG(PL_ERROR,"ProtoFile::Readline() error: FillBuffer() failure\n");
+                return false;
+            }
+            if (0 == read_count)
             {
                 // Must have reached EOF (treat as end of line)
                 if (count > 0)
                 {
-                    *ptr = '\0';
+                    buffer[count] = '\0';
                     bufferSize = count + 1;
                     return true;
                 }
@@ -495,30 +712,271 @@ bool ProtoFile::Readline(char*         buffer,
                     return false;
                 }
             }
-            else
-            {
-                // Check to see if its end of line char
-                if (('\n' == *ptr) || ('\r' == *ptr))
-                {
-                    *ptr = '\0';
-                    bufferSize = count;
-                    return true;
-                }
-                count++;
-                ptr++;
-            }
         }
-        else
+        // Copy up to the first end of line char ('\n' or '\r') found
+        // in the buffered data (memchr() is much faster than a byte loop)
+        size_t avail = MIN(read_count, (size_t)(length - count));
+        const char* eol = (const char*)memchr(read_ptr, '\n', avail);
+        const char* cr = (const char*)memchr(read_ptr, '\r', (NULL != eol) ? (size_t)(eol - read_ptr) : avail);
+        if (NULL != cr) eol = cr;
+        size_t ncopy = (NULL != eol) ? (size_t)(eol - read_ptr) : avail;
+        memcpy(buffer + count, read_ptr, ncopy);
+        count += (unsigned int)ncopy;
+        if (NULL != eol)
         {
-            PLOG(PL_ERROR,"ProtoFile::Readline() error: ReadPrivate() failure\n");
-            return false;
+            read_ptr += ncopy + 1;
+            read_count -= ncopy + 1;
+            buffer[count] = '\0';
+            bufferSize = count;
+            return true;
         }
+        read_ptr += ncopy;
+        read_count -= ncopy;
     }
     // We've filled up the buffer provided with no end-of-line reached
-    PLOG(PL_ERROR, "ProtoFile::Readline() error: line length exceeds\n", bufferSize);
+    PLOG(PL_ERROR, "ProtoFile::Readline() error: line length exceeds %u\n", bufferSize);
     return false;
 }  // end ProtoFile::Readline()
 
+bool ProtoFile::AppendRecord(const char* data, unsigned int length)
+{
+    if ((record_length + length) > record_size)
+    {
+        unsigned int newSize = (0 != record_size) ? (2 * record_size) : (unsigned int)BUFFER_SIZE;
+        while (newSize < (record_length + length)) newSize *= 2;
+        char* newBuffer = new char[newSize];
+        if (NULL == newBuffer)
+        {
+            PLOG(PL_ERROR, "ProtoFile::AppendRecord() new record_buffer error: %s\n", GetErrorString());
+            return false;
+        }
+        if (0 != record_length) memcpy(newBuffer, record_buffer, record_length);
+        if (NULL != record_buffer) delete[] record_buffer;
+        record_buffer = newBuffer;
+        record_size = newSize;
+    }
+    memcpy(record_buffer + record_length, data, length);
+    record_length += length;
+    return true;
+}  // end ProtoFile::AppendRecord()
+
+bool ProtoFile::GetNextRecord(const char*& record, unsigned int& length, char delimiter)
+{
+    // Records are returned in place unless they span read blocks, in
+    // which case the pieces are gathered into the "record_buffer"
+    record_length = 0;
+    while (true)
+    {
+        if (0 == read_count)
+        {
+            if (!FillBuffer(false)) return false;
+            if (0 == read_count)
+            {
+                // End of file, so any partial record is the last one
+                if (0 == record_length) return false;
+                record = record_buffer;
+                length = record_length;
+                return true;
+            }
+        }
+        const char* end = (const char*)memchr(read_ptr, delimiter, read_count);
+        size_t n = (NULL != end) ? (size_t)(end - read_ptr) : read_count;
+        if ((NULL != end) && (0 == record_length))
+        {
+            record = read_ptr;
+            length = (unsigned int)n;
+            read_ptr += n + 1;
+            read_count -= n + 1;
+            return true;
+        }
+        if (!AppendRecord(read_ptr, (unsigned int)n)) return false;
+        if (NULL != end)
+        {
+            read_ptr += n + 1;
+            read_count -= n + 1;
+            record = record_buffer;
+            length = record_length;
+            return true;
+        }
+        read_ptr += n;
+        read_count = 0;
+    }
+}  // end ProtoFile::GetNextRecord()
+
+bool ProtoFile::GetNextLine(const char*& line, unsigned int& length)
+{
+    if (!GetNextRecord(line, length, '\n')) return false;
+    if ((0 != length) && ('\r' == line[length - 1])) length--;
+    return true;
+}  // end ProtoFile::GetNextLine()
+
+bool ProtoFile::Map()
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoFile::Map() error: file not open\n");
+        return false;
+    }
+    if (is_mapped) return true;
+    if (NULL != read_ahead)
+    {
+        PLOG(PL_ERROR, "ProtoFile::Map() error: read ahead in progress\n");
+        return false;
+    }
+#ifdef _WIN32_WCE
+    PLOG(PL_ERROR, "ProtoFile::Map() error: not supported on WinCE\n");
+    return false;
+#else
+    Offset size = GetSize();
+    if ((Offset)((size_t)size) != size)
+    {
+        PLOG(PL_ERROR, "ProtoFile::Map() error: file too large to map\n");
+        return false;
+    }
+#ifdef WIN32
+    Offset position = _lseeki64(descriptor, 0, SEEK_CUR);
+#else
+    Offset position = lseek(descriptor, 0, SEEK_CUR);
+#endif // if/else WIN32/UNIX
+    // (any data already buffered by Readline() is picked up again from the mapping)
+    position -= (Offset)read_count;
+    if ((position < 0) || (position > size)) position = 0;
+    if (size > 0)
+    {
+#ifdef WIN32
+        map_handle = CreateFileMapping((HANDLE)_get_osfhandle(descriptor), NULL, PAGE_READONLY, 0, 0, NULL);
+        if (NULL == map_handle)
+        {
+            PLOG(PL_ERROR, "ProtoFile::Map() CreateFileMapping() error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL == (map_ptr = (char*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0)))
+        {
+            PLOG(PL_ERROR, "ProtoFile::Map() MapViewOfFile() error: %s\n", GetErrorString());
+            CloseHandle(map_handle);
+            map_handle = NULL;
+            return false;
+        }
+#else
+        void* ptr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (MAP_FAILED == ptr)
+        {
+            PLOG(PL_ERROR, "ProtoFile::Map() mmap() error: %s\n", GetErrorString());
+            return false;
+        }
+        map_ptr = (char*)ptr;
+#ifdef MADV_SEQUENTIAL
+        madvise(map_ptr, (size_t)size, MADV_SEQUENTIAL);
+#endif // MADV_SEQUENTIAL
+#endif // if/else WIN32/UNIX
+    }
+    map_size = (size_t)size;
+    is_mapped = true;
+    read_ptr = map_ptr + position;
+    read_count = map_size - (size_t)position;
+    record_length = 0;
+    return true;
+#endif // if/else _WIN32_WCE
+}  // end ProtoFile::Map()
+
+void ProtoFile::Unmap()
+{
+    if (!is_mapped) return;
+    // Leave the file positioned after the data consumed
+    Offset position = (Offset)(map_size - read_count);
+    if (NULL != map_ptr)
+    {
+#ifdef WIN32
+        UnmapViewOfFile(map_ptr);
+        CloseHandle(map_handle);
+        map_handle = NULL;
+#else
+        munmap(map_ptr, map_size);
+#endif // if/else WIN32/UNIX
+        map_ptr = NULL;
+    }
+    map_size = 0;
+    is_mapped = false;
+    read_ptr = read_buffer;
+    read_count = 0;
+    if (IsOpen()) Seek(position);
+}  // end ProtoFile::Unmap()
+
+bool ProtoFile::StartReadAhead(unsigned int blockSize, unsigned int blockCount)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoFile::StartReadAhead() error: file not open\n");
+        return false;
+    }
+    if (NULL != read_ahead) return true;
+    if (is_mapped)
+    {
+        PLOG(PL_ERROR, "ProtoFile::StartReadAhead() error: file is mapped\n");
+        return false;
+    }
+    Advise(ADVISE_SEQUENTIAL);
+    if (NULL == (read_ahead = new ReadAhead(*this)))
+    {
+        PLOG(PL_ERROR, "ProtoFile::StartReadAhead() new ReadAhead error: %s\n", GetErrorString());
+        return false;
+    }
+    // (any data already buffered is still used first)
+    if (!read_ahead->Open(blockSize, blockCount))
+    {
+        PLOG(PL_ERROR, "ProtoFile::StartReadAhead() error: unable to start read ahead\n");
+        delete read_ahead;
+        read_ahead = NULL;
+        return false;
+    }
+    return true;
+}  // end ProtoFile::StartReadAhead()
+
+void ProtoFile::StopReadAhead()
+{
+    if (NULL != read_ahead)
+    {
+        // (data read ahead but not yet consumed is discarded)
+        read_ahead->Close();
+        delete read_ahead;
+        read_ahead = NULL;
+        read_ptr = read_buffer;
+        read_count = 0;
+    }
+}  // end ProtoFile::StopReadAhead()
+
+bool ProtoFile::Advise(Advice advice, Offset theOffset, Offset length)
+{
+#if !defined(WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+    int fadvice;
+    switch (advice)
+    {
+        case ADVISE_SEQUENTIAL:
+            fadvice = POSIX_FADV_SEQUENTIAL;
+            break;
+        case ADVISE_RANDOM:
+            fadvice = POSIX_FADV_RANDOM;
+            break;
+        case ADVISE_WILLNEED:
+            fadvice = POSIX_FADV_WILLNEED;
+            break;
+        case ADVISE_DONTNEED:
+            fadvice = POSIX_FADV_DONTNEED;
+            break;
+        default:
+            fadvice = POSIX_FADV_NORMAL;
+            break;
+    }
+    int result = posix_fadvise(descriptor, theOffset, length, fadvice);
+    if (0 != result)
+    {
+        PLOG(PL_WARN, "ProtoFile::Advise() posix_fadvise() error: %s\n", strerror(result));
+        return false;
+    }
+#endif // !WIN32 && POSIX_FADV_SEQUENTIAL
+    return true;  // (hints are ignored where not supported)
+}  // end ProtoFile::Advise()
+
 size_t ProtoFile::Write(const char* buffer, size_t len)
 {
     ASSERT(IsOpen());
@@ -556,6 +1014,25 @@ size_t ProtoFile::Write(const char* buffer, size_t len)
 bool ProtoFile::Seek(Offset theOffset)
 {
     ASSERT(IsOpen());
+    if (is_mapped)
+    {
+        if ((theOffset < 0) || (theOffset > (Offset)map_size))
+        {
+            PLOG(PL_ERROR, "ProtoFile::Seek() error: offset beyond mapped file\n");
+            return false;
+        }
+        read_ptr = map_ptr + theOffset;
+        read_count = map_size - (size_t)theOffset;
+        record_length = 0;
+        offset = theOffset;
+        return true;
+    }
+    if (NULL != read_ahead)
+    {
+        PLOG(PL_ERROR, "ProtoFile::Seek() error: can't seek while reading ahead\n");
+        return false;
+    }
+    read_count = 0;  // (discard buffered data)
 #ifdef WIN32
 #ifdef _WIN32_WCE
     // (TBD) properly support big files on WinCE
@@ -0,0 +1,511 @@
+#include "protoFlowCache.h"
+#include "protoHash.h"
+#include "protoPktTCP.h"  // for ProtoPktTCP::FLAG_FIN, FLAG_RST
+#include "protoDebug.h"
+#include <string.h>  // for memset(), memcpy()
+
+ProtoFlow::Cache::Key::Key()
+{
+    memset(this, 0, sizeof(Key));
+}
+
+bool ProtoFlow::Cache::Key::InitFromPkt(ProtoPktIP& ipPkt, unsigned int ifaceIndex, UINT8* tcpFlags)
+{
+    memset(this, 0, sizeof(Key));
+    iface_index = ifaceIndex;
+    if (NULL != tcpFlags) *tcpFlags = 0;
+    const UINT8* l4Ptr = NULL;  // transport header (NULL if non-first fragment)
+    unsigned int l4Len = 0;     // (bytes of transport header available)
+    switch (ipPkt.GetVersion())
+    {
+        case 4:
+        {
+            const ProtoPktIPv4 ip4Pkt(ipPkt);
+            unsigned int hdrLen = ip4Pkt.GetHeaderLength();
+            unsigned int pktLen = ip4Pkt.GetTotalLength();
+            if (pktLen > ipPkt.GetLength()) pktLen = ipPkt.GetLength();
+            if ((hdrLen < 20) || (hdrLen > pktLen))
+            {
+                PLOG(PL_DEBUG, "ProtoFlow::Cache::Key::InitFromPkt() error: invalid IPv4 header\n");
+                return false;
+            }
+            addr_len = 4;
+            memcpy(dst_addr, ip4Pkt.GetDstAddrPtr(), 4);
+            memcpy(src_addr, ip4Pkt.GetSrcAddrPtr(), 4);
+            traffic_class = ip4Pkt.GetTOS() & 0xfc;
+            protocol = (UINT8)ip4Pkt.GetProtocol();
+            if (0 == ip4Pkt.GetFragmentOffset())
+            {
+                l4Ptr = (const UINT8*)ip4Pkt.GetPayload();
+                l4Len = pktLen - hdrLen;
+            }
+            break;
+        }
+        case 6:
+        {
+            const ProtoPktIPv6 ip6Pkt(ipPkt);
+            unsigned int pktLen = ProtoPktIPv6::GetHeaderLength() + ip6Pkt.GetPayloadLength();
+            if (pktLen > ipPkt.GetLength()) pktLen = ipPkt.GetLength();
+            if (pktLen < ProtoPktIPv6::GetHeaderLength())
+            {
+                PLOG(PL_DEBUG, "ProtoFlow::Cache::Key::InitFromPkt() error: invalid IPv6 header\n");
+                return false;
+            }
+            addr_len = 16;
+            memcpy(dst_addr, ip6Pkt.GetDstAddrPtr(), 16);
+            memcpy(src_addr, ip6Pkt.GetSrcAddrPtr(), 16);
+            traffic_class = ip6Pkt.GetTrafficClass() & 0xfc;
+            // Skip any extension headers to find the upper layer protocol
+            ProtoPktIP::Protocol nextHdr = ip6Pkt.GetNextHeader();
+            const UINT8* ptr = (const UINT8*)ip6Pkt.GetPayload();
+            unsigned int len = pktLen - ProtoPktIPv6::GetHeaderLength();
+            bool firstFragment = true;
+            while (ProtoPktIP::IsExtension(nextHdr) && (len >= 8))
+            {
+                unsigned int extLen;
+                switch (nextHdr)
+                {
+                    case ProtoPktIP::FRAG:
+                        extLen = 8;
+                        if (0 != ((((unsigned int)ptr[2] << 8) | ptr[3]) & 0xfff8))
+                            firstFragment = false;
+                        break;
+                    case ProtoPktIP::AUTH:
+                        extLen = ((unsigned int)ptr[1] + 2) << 2;
+                        break;
+                    default:  // HOPOPT, DSTOPT, RTG
+                        extLen = ((unsigned int)ptr[1] + 1) << 3;
+                        break;
+                }
+                if (extLen > len) break;
+                nextHdr = (ProtoPktIP::Protocol)ptr[0];
+                ptr += extLen;
+                len -= extLen;
+            }
+            protocol = (UINT8)nextHdr;
+            if (firstFragment && !ProtoPktIP::IsExtension(nextHdr))
+            {
+                l4Ptr = ptr;
+                l4Len = len;
+            }
+            break;
+        }
+        default:
+            PLOG(PL_DEBUG, "ProtoFlow::Cache::Key::InitFromPkt() error: invalid IP version!\n");
+            return false;
+    }
+    if (NULL == l4Ptr) return true;
+    switch (protocol)
+    {
+        case ProtoPktIP::TCP:
+            if ((l4Len >= 14) && (NULL != tcpFlags))
+                *tcpFlags = l4Ptr[13];
+            // fall through - to get ports
+        case ProtoPktIP::UDP:
+        case 132:  // SCTP
+            if (l4Len >= 4)
+            {
+                src_port = ((UINT16)l4Ptr[0] << 8) | l4Ptr[1];
+                dst_port = ((UINT16)l4Ptr[2] << 8) | l4Ptr[3];
+            }
+            break;
+        case ProtoPktIP::ICMP:
+        case ProtoPktIP::ICMPv6:
+            if (l4Len >= 2)
+                dst_port = ((UINT16)l4Ptr[0] << 8) | l4Ptr[1];  // type and code
+            break;
+        default:
+            break;
+    }
+    return true;
+}  // end ProtoFlow::Cache::Key::InitFromPkt()
+
+bool ProtoFlow::Cache::Key::InitFromDescriptor(const ProtoDissector::Descriptor& desc, unsigned int ifaceIndex)
+{
+    memset(this, 0, sizeof(Key));
+    if (!desc.HasL3()) return false;
+    iface_index = ifaceIndex;
+    addr_len = desc.GetAddrLength();
+    memcpy(dst_addr, desc.GetDstAddrPtr(), addr_len);
+    memcpy(src_addr, desc.GetSrcAddrPtr(), addr_len);
+    traffic_class = desc.GetTrafficClass() & 0xfc;
+    protocol = desc.GetProtocol();
+    dst_port = desc.GetDstPort();
+    src_port = desc.GetSrcPort();
+    return true;
+}  // end ProtoFlow::Cache::Key::InitFromDescriptor()
+
+void ProtoFlow::Cache::Key::SetKey(const ProtoAddress&     dst,
+                                   const ProtoAddress&     src,
+                                   UINT8                   trafficClass,
+                                   ProtoPktIP::Protocol    theProtocol,
+                                   unsigned int            ifaceIndex)
+{
+    memset(this, 0, sizeof(Key));
+    if (dst.IsValid() && (dst.GetLength() <= 16))
+    {
+        addr_len = dst.GetLength();
+        memcpy(dst_addr, dst.GetRawHostAddress(), addr_len);
+        dst_port = dst.GetPort();
+    }
+    if (src.IsValid() && (src.GetLength() <= 16))
+    {
+        if (0 == addr_len) addr_len = src.GetLength();
+        memcpy(src_addr, src.GetRawHostAddress(), src.GetLength());
+        src_port = src.GetPort();
+    }
+    traffic_class = trafficClass;
+    protocol = (UINT8)theProtocol;
+    iface_index = ifaceIndex;
+}  // end ProtoFlow::Cache::Key::SetKey()
+
+bool ProtoFlow::Cache::Key::GetDstAddr(ProtoAddress& addr) const
+{
+    if (0 == addr_len)
+    {
+        addr.Invalidate();
+        return false;
+    }
+    addr.SetRawHostAddress((4 == addr_len) ? ProtoAddress::IPv4 : ProtoAddress::IPv6, (const char*)dst_addr, addr_len);
+    addr.SetPort(dst_port);
+    return true;
+}  // end ProtoFlow::Cache::Key::GetDstAddr()
+
+bool ProtoFlow::Cache::Key::GetSrcAddr(ProtoAddress& addr) const
+{
+    if (0 == addr_len)
+    {
+        addr.Invalidate();
+        return false;
+    }
+    addr.SetRawHostAddress((4 == addr_len) ? ProtoAddress::IPv4 : ProtoAddress::IPv6, (const char*)src_addr, addr_len);
+    addr.SetPort(src_port);
+    return true;
+}  // end ProtoFlow::Cache::Key::GetSrcAddr()
+
+void ProtoFlow::Cache::Key::GetDescription(Description& description) const
+{
+    description.SetKey((const char*)dst_addr, addr_len, addr_len << 3,
+                       (const char*)src_addr, addr_len, addr_len << 3,
+                       traffic_class, (ProtoPktIP::Protocol)protocol, iface_index);
+}  // end ProtoFlow::Cache::Key::GetDescription()
+
+UINT32 ProtoFlow::Cache::Key::GetHash() const
+{
+    return ProtoHash::Words((const UINT32*)this, sizeof(Key) / sizeof(UINT32), 0x9e3779b9);
+}  // end ProtoFlow::Cache::Key::GetHash()
+
+void ProtoFlow::Cache::Key::Print(FILE* filePtr) const
+{
+    if (NULL == filePtr)
+        filePtr = GetDebugLog();
+    // Format is "src/port->dst/port,protocol,class,ifaceIndex"
+    ProtoAddress src, dst;
+    GetSrcAddr(src);
+    GetDstAddr(dst);
+    fprintf(filePtr, "%s/%hu->", src.GetHostString(), src_port);
+    fprintf(filePtr, "%s/%hu,%d,0x%02x,%u", dst.GetHostString(), dst_port,
+            protocol, traffic_class, iface_index);
+}  // end ProtoFlow::Cache::Key::Print()
+
+ProtoFlow::Cache::Cache()
+ : listener(NULL), wheel(NULL), wheel_mask(0),
+   idle_timeout(15.0), active_timeout(1800.0), tick_rate(1.0),
+   base_time(0.0), base_valid(false), current_tick(0),
+   batch_list(NULL), batch_size(0), batch_count(0),
+   packet_count(0), export_count(0), evict_count(0)
+{
+}
+
+ProtoFlow::Cache::~Cache()
+{
+    Close();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+bool ProtoFlow::Cache::Open(unsigned int  maxFlows,
+                            double        idleTimeout,
+                            double        activeTimeout,
+                            double        tickInterval,
+                            unsigned int  batchSize)
+{
+    Close();
+    if ((0 == maxFlows) || (maxFlows >= (unsigned int)NIL) || (0 == batchSize) ||
+        (tickInterval <= 0.0) || (idleTimeout <= 0.0) || (activeTimeout <= 0.0))
+    {
+        PLOG(PL_ERROR, "ProtoFlow::Cache::Open() error: invalid parameter\n");
+        return false;
+    }
+    idle_timeout = idleTimeout;
+    active_timeout = activeTimeout;
+    tick_rate = 1.0 / tickInterval;
+    // Timer wheel spanning the longer timeout (flows due beyond one lap of
+    // the wheel are rescheduled when their slot comes due)
+    double maxTicks = 2.0 + ((idleTimeout > activeTimeout) ? idleTimeout : activeTimeout) * tick_rate;
+    UINT32 wheelSize = 2;
+    while ((wheelSize < maxTicks) && (wheelSize < 0x10000)) wheelSize <<= 1;
+    // (with at least one hash bucket per flow)
+    if (!record_table.Init(maxFlows))
+    {
+        PLOG(PL_ERROR, "ProtoFlow::Cache::Open() error: unable to allocate records\n");
+        return false;
+    }
+    if ((NULL == (wheel = new UINT32[wheelSize])) ||
+        (NULL == (batch_list = new Record[batchSize])))
+    {
+        PLOG(PL_ERROR, "ProtoFlow::Cache::Open() new error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    for (UINT32 i = 0; i < wheelSize; i++)
+        wheel[i] = NIL;
+    for (UINT32 i = 0; i < maxFlows; i++)
+        record_table[i].in_use = false;
+    wheel_mask = wheelSize - 1;
+    batch_size = batchSize;
+    batch_count = 0;
+    base_valid = false;
+    current_tick = 0;
+    packet_count = export_count = evict_count = 0;
+    return true;
+}  // end ProtoFlow::Cache::Open()
+
+void ProtoFlow::Cache::Close()
+{
+    if (NULL != batch_list)
+    {
+        delete[] batch_list;
+        batch_list = NULL;
+    }
+    if (NULL != wheel)
+    {
+        delete[] wheel;
+        wheel = NULL;
+    }
+    record_table.Destroy();
+    batch_size = batch_count = 0;
+    wheel_mask = 0;
+}  // end ProtoFlow::Cache::Close()
+
+UINT32 ProtoFlow::Cache::GetExpireTick(const Record& record) const
+{
+    if (EXPIRE_END == record.expire_reason)
+        return (current_tick + 1);
+    UINT32 idleTick = GetTick(record.last_time + idle_timeout) + 1;
+    UINT32 activeTick = GetTick(record.first_time + active_timeout) + 1;
+    return ((idleTick < activeTick) ? idleTick : activeTick);
+}  // end ProtoFlow::Cache::GetExpireTick()
+
+const ProtoFlow::Cache::Record* ProtoFlow::Cache::Find(const Key& key) const
+{
+    if (!record_table.IsReady()) return NULL;
+    UINT32 index = record_table.Find(key, key.GetHash());
+    return ((NIL != index) ? &record_table[index] : NULL);
+}  // end ProtoFlow::Cache::Find()
+
+void ProtoFlow::Cache::WheelInsert(UINT32 index, UINT32 tick)
+{
+    // Flows due beyond one lap go in the last slot of the lap
+    if (tick <= current_tick)
+        tick = current_tick + 1;
+    else if ((tick - current_tick) > wheel_mask)
+        tick = current_tick + wheel_mask;
+    Record& record = record_table[index];
+    UINT32& head = wheel[tick & wheel_mask];
+    record.wheel_tick = tick;
+    record.wheel_prev = NIL;
+    record.wheel_next = head;
+    if (NIL != head) record_table[head].wheel_prev = index;
+    head = index;
+}  // end ProtoFlow::Cache::WheelInsert()
+
+void ProtoFlow::Cache::WheelRemove(UINT32 index)
+{
+    Record& record = record_table[index];
+    if (NIL != record.wheel_prev)
+        record_table[record.wheel_prev].wheel_next = record.wheel_next;
+    else
+        wheel[record.wheel_tick & wheel_mask] = record.wheel_next;
+    if (NIL != record.wheel_next)
+        record_table[record.wheel_next].wheel_prev = record.wheel_prev;
+    record.wheel_prev = record.wheel_next = NIL;
+}  // end ProtoFlow::Cache::WheelRemove()
+
+// Exports and frees a record (that has already been removed from the wheel)
+void ProtoFlow::Cache::Expire(UINT32 index, ExpireReason reason)
+{
+    Record& record = record_table[index];
+    // Copy to export batch
+    record.expire_reason = (UINT8)reason;
+    batch_list[batch_count++] = record;
+    record.in_use = false;
+    record_table.Remove(index);
+    export_count++;
+    if (batch_count >= batch_size) Export();
+}  // end ProtoFlow::Cache::Expire()
+
+// Exports the flow at the head of the nearest wheel slot to free a record
+bool ProtoFlow::Cache::Evict()
+{
+    for (UINT32 i = 1; i <= (wheel_mask + 1); i++)
+    {
+        UINT32 index = wheel[(current_tick + i) & wheel_mask];
+        if (NIL != index)
+        {
+            WheelRemove(index);
+            Expire(index, EXPIRE_EVICT);
+            evict_count++;
+            return true;
+        }
+    }
+    return false;
+}  // end ProtoFlow::Cache::Evict()
+
+void ProtoFlow::Cache::Export()
+{
+    if ((0 != batch_count) && (NULL != listener))
+        listener->on_export(*this, batch_list, batch_count);
+    batch_count = 0;
+}  // end ProtoFlow::Cache::Export()
+
+const ProtoFlow::Cache::Record* ProtoFlow::Cache::Update(ProtoPktIP&        ipPkt,
+                                                         unsigned int       pktLength,
+                                                         const ProtoTime&   pktTime,
+                                                         unsigned int       ifaceIndex)
+{
+    Key key;
+    UINT8 tcpFlags;
+    if (!key.InitFromPkt(ipPkt, ifaceIndex, &tcpFlags)) return NULL;
+    return Update(key, pktLength, pktTime, tcpFlags);
+}  // end ProtoFlow::Cache::Update(ProtoPktIP)
+
+const ProtoFlow::Cache::Record* ProtoFlow::Cache::Update(const Key&         key,
+                                                         unsigned int       pktLength,
+                                                         const ProtoTime&   pktTime,
+                                                         UINT8              tcpFlags)
+{
+    if (!record_table.IsReady())
+    {
+        PLOG(PL_ERROR, "ProtoFlow::Cache::Update() error: cache not open\n");
+        return NULL;
+    }
+    double theTime = pktTime.GetValue();
+    if (!base_valid)
+    {
+        base_time = theTime;
+        base_valid = true;
+        current_tick = 0;
+    }
+    else
+    {
+        UINT32 tick = GetTick(theTime);
+        if (tick > current_tick) AdvanceTick(tick);
+    }
+    packet_count++;
+    UINT32 hash = key.GetHash();
+    UINT32 index = record_table.Find(key, hash);
+    Record* record;
+    if (NIL != index)
+    {
+        record = &record_table[index];
+        record->packets++;
+        record->bytes += pktLength;
+        if (theTime > record->last_time) record->last_time = theTime;
+        record->tcp_flags |= tcpFlags;
+    }
+    else
+    {
+        if (record_table.IsFull() && !Evict())
+        {
+            PLOG(PL_WARN, "ProtoFlow::Cache::Update() warning: unable to add flow\n");
+            return NULL;
+        }
+        index = record_table.Insert(key, hash);
+        record = &record_table[index];
+        record->packets = 1;
+        record->bytes = pktLength;
+        record->first_time = record->last_time = theTime;
+        record->tcp_flags = tcpFlags;
+        record->expire_reason = EXPIRE_NONE;
+        record->in_use = true;
+        WheelInsert(index, GetExpireTick(*record));
+    }
+    if ((0 != (tcpFlags & (ProtoPktTCP::FLAG_FIN | ProtoPktTCP::FLAG_RST))) &&
+        (EXPIRE_END != record->expire_reason))
+    {
+        // TCP connection end, so expire flow at next tick
+        record->expire_reason = EXPIRE_END;
+        WheelRemove(index);
+        WheelInsert(index, current_tick + 1);
+    }
+    return record;
+}  // end ProtoFlow::Cache::Update(Key)
+
+void ProtoFlow::Cache::Advance(const ProtoTime& currentTime)
+{
+    if (!record_table.IsReady() || !base_valid) return;
+    UINT32 tick = GetTick(currentTime.GetValue());
+    if (tick > current_tick)
+        AdvanceTick(tick);
+    else
+        Export();
+}  // end ProtoFlow::Cache::Advance()
+
+void ProtoFlow::Cache::AdvanceTick(UINT32 tick)
+{
+    // Visit the slots from "current_tick" up to "tick" (at most one lap) and
+    // expire the flows now due, rescheduling any whose timeout was extended
+    UINT32 startTick = current_tick;
+    UINT32 numSlots = tick - startTick;
+    if (numSlots > (wheel_mask + 1)) numSlots = wheel_mask + 1;
+    current_tick = tick;
+    for (UINT32 i = 1; i <= numSlots; i++)
+    {
+        // Detach the slot list, so rescheduled flows aren't revisited here
+        UINT32 index = wheel[(startTick + i) & wheel_mask];
+        wheel[(startTick + i) & wheel_mask] = NIL;
+        while (NIL != index)
+        {
+            Record& record = record_table[index];
+            UINT32 next = record.wheel_next;
+            UINT32 expireTick = GetExpireTick(record);
+            if ((EXPIRE_END == record.expire_reason) || (expireTick <= tick))
+            {
+                ExpireReason reason = (ExpireReason)record.expire_reason;
+                if (EXPIRE_END != reason)
+                {
+                    UINT32 activeTick = GetTick(record.first_time + active_timeout) + 1;
+                    reason = (activeTick <= expireTick) ? EXPIRE_ACTIVE : EXPIRE_IDLE;
+                }
+                Expire(index, reason);
+            }
+            else
+            {
+                WheelInsert(index, expireTick);
+            }
+            index = next;
+        }
+    }
+    Export();
+}  // end ProtoFlow::Cache::AdvanceTick()
+
+void ProtoFlow::Cache::Flush()
+{
+    if (!record_table.IsReady()) return;
+    for (UINT32 i = 0; i <= wheel_mask; i++)
+    {
+        UINT32 index = wheel[i];
+        wheel[i] = NIL;
+        while (NIL != index)
+        {
+            UINT32 next = record_table[index].wheel_next;
+            Expire(index, EXPIRE_FLUSH);
+            index = next;
+        }
+    }
+    Export();
+}  // end ProtoFlow::Cache::Flush()
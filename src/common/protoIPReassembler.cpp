@@ -0,0 +1,443 @@
+#include "protoIPReassembler.h"
+#include "protoHash.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy(), memset(), memmove()
+
+UINT32 ProtoIPReassembler::Key::GetHash() const
+{
+    return ProtoHash::Words((const UINT32*)this, sizeof(Key) / sizeof(UINT32), 0x9e3779b9);
+}  // end ProtoIPReassembler::Key::GetHash()
+
+ProtoIPReassembler::ProtoIPReassembler(ProtoTimerMgr& timerMgr)
+ : timer_mgr(timerMgr), timeout(30.0), age_head(NIL), age_tail(NIL),
+   page_buffer(NULL), page_free_list(NULL), page_max(0), page_free_count(0),
+   out_buffer(NULL), fragment_count(0), complete_count(0), timeout_count(0),
+   evict_count(0), overlap_count(0), drop_count(0)
+{
+    timeout_timer.SetListener(this, &ProtoIPReassembler::OnTimeout);
+    timeout_timer.SetInterval(0.0);
+    timeout_timer.SetRepeat(-1);
+}
+
+ProtoIPReassembler::~ProtoIPReassembler()
+{
+    Close();
+}
+
+bool ProtoIPReassembler::Open(unsigned int datagramMax, unsigned int memoryMax, double theTimeout)
+{
+    Close();
+    unsigned int pageMax = memoryMax / PAGE_SIZE;
+    if ((0 == datagramMax) || (datagramMax >= (unsigned int)NIL) || (0 == pageMax) || (theTimeout <= 0.0))
+    {
+        PLOG(PL_ERROR, "ProtoIPReassembler::Open() error: invalid parameter\n");
+        return false;
+    }
+    if (!datagram_table.Init(datagramMax, 2))
+    {
+        PLOG(PL_ERROR, "ProtoIPReassembler::Open() error: unable to allocate datagrams\n");
+        return false;
+    }
+    if ((NULL == (page_buffer = new char[(size_t)pageMax * PAGE_SIZE])) ||
+        (NULL == (page_free_list = new UINT32[pageMax])) ||
+        (NULL == (out_buffer = new UINT32[(PKT_SIZE_MAX + 3) / 4])))
+    {
+        PLOG(PL_ERROR, "ProtoIPReassembler::Open() new error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    age_head = age_tail = NIL;
+    // (pages are handed out lowest index first)
+    for (UINT32 i = 0; i < pageMax; i++)
+        page_free_list[i] = pageMax - 1 - i;
+    page_max = page_free_count = pageMax;
+    timeout = theTimeout;
+    fragment_count = complete_count = timeout_count = 0;
+    evict_count = overlap_count = drop_count = 0;
+    return true;
+}  // end ProtoIPReassembler::Open()
+
+void ProtoIPReassembler::Close()
+{
+    if (timeout_timer.IsActive()) timeout_timer.Deactivate();
+    if (NULL != out_buffer)
+    {
+        delete[] out_buffer;
+        out_buffer = NULL;
+    }
+    if (NULL != page_free_list)
+    {
+        delete[] page_free_list;
+        page_free_list = NULL;
+    }
+    if (NULL != page_buffer)
+    {
+        delete[] page_buffer;
+        page_buffer = NULL;
+    }
+    datagram_table.Destroy();
+    age_head = age_tail = NIL;
+    page_max = page_free_count = 0;
+}  // end ProtoIPReassembler::Close()
+
+ProtoIPReassembler::Status ProtoIPReassembler::Process(ProtoPktIP& ipPkt, ProtoPktIP& outPkt)
+{
+    if (!datagram_table.IsReady())
+    {
+        PLOG(PL_ERROR, "ProtoIPReassembler::Process() error: reassembler not open\n");
+        return STATUS_DROPPED;
+    }
+    const UINT8* buffer = (const UINT8*)ipPkt.GetBuffer();
+    Key key;
+    memset(&key, 0, sizeof(Key));
+    const UINT8* data;          // fragment data
+    UINT32 start, end;          // fragment data range (within the fragmentable part)
+    bool more;                  // "more fragments" flag
+    unsigned int hdrLength;     // unfragmentable header length
+    unsigned int payloadMax;    // max reassembled length of fragmentable part
+    UINT16 nextHeaderOffset = 0;
+    UINT8 nextHeader = 0;
+    switch (ipPkt.GetVersion())
+    {
+        case 4:
+        {
+            const ProtoPktIPv4 ip4Pkt(ipPkt);
+            more = ip4Pkt.FlagIsSet(ProtoPktIPv4::FLAG_MF);
+            start = (UINT32)ip4Pkt.GetFragmentOffset() << 3;
+            if (!more && (0 == start))
+            {
+                outPkt.InitFromBuffer(ipPkt.GetLength(), ipPkt.AccessBuffer(), ipPkt.GetBufferLength());
+                return STATUS_WHOLE;
+            }
+            fragment_count++;
+            hdrLength = ip4Pkt.GetHeaderLength();
+            unsigned int pktLength = ip4Pkt.GetTotalLength();
+            if ((hdrLength < 20) || (pktLength < hdrLength) || (pktLength > ipPkt.GetLength()))
+            {
+                PLOG(PL_DEBUG, "ProtoIPReassembler::Process() invalid or truncated IPv4 fragment\n");
+                drop_count++;
+                return STATUS_DROPPED;
+            }
+            key.version = 4;
+            memcpy(key.src_addr, ip4Pkt.GetSrcAddrPtr(), 4);
+            memcpy(key.dst_addr, ip4Pkt.GetDstAddrPtr(), 4);
+            key.id = ip4Pkt.GetID();
+            key.protocol = (UINT8)ip4Pkt.GetProtocol();
+            data = buffer + hdrLength;
+            end = start + (pktLength - hdrLength);
+            payloadMax = 65535 - hdrLength;
+            break;
+        }
+        case 6:
+        {
+            const ProtoPktIPv6 ip6Pkt(ipPkt);
+            unsigned int pktLength = ProtoPktIPv6::GetHeaderLength() + ip6Pkt.GetPayloadLength();
+            if (pktLength > ipPkt.GetLength()) pktLength = ipPkt.GetLength();
+            // Find the FRAG header (after any hop-by-hop, routing and destination options)
+            UINT8 nh = (UINT8)ip6Pkt.GetNextHeader();
+            unsigned int offset = ProtoPktIPv6::GetHeaderLength();
+            nextHeaderOffset = 6;  // offset of IPv6 header "next header" field
+            while (((ProtoPktIP::HOPOPT == nh) || (ProtoPktIP::DSTOPT == nh) || (ProtoPktIP::RTG == nh)) &&
+                   ((offset + 8) <= pktLength))
+            {
+                nextHeaderOffset = offset;
+                nh = buffer[offset];
+                offset += ((unsigned int)buffer[offset + 1] + 1) << 3;
+            }
+            if ((ProtoPktIP::FRAG != nh) || ((offset + 8) > pktLength))
+            {
+                outPkt.InitFromBuffer(ipPkt.GetLength(), ipPkt.AccessBuffer(), ipPkt.GetBufferLength());
+                return STATUS_WHOLE;
+            }
+            fragment_count++;
+            if (pktLength != (ProtoPktIPv6::GetHeaderLength() + ip6Pkt.GetPayloadLength()))
+            {
+                PLOG(PL_DEBUG, "ProtoIPReassembler::Process() truncated IPv6 fragment\n");
+                drop_count++;
+                return STATUS_DROPPED;
+            }
+            UINT16 fragField = ((UINT16)buffer[offset + 2] << 8) | buffer[offset + 3];
+            start = fragField & 0xfff8;
+            more = (0 != (fragField & 0x0001));
+            key.version = 6;
+            memcpy(key.src_addr, ip6Pkt.GetSrcAddrPtr(), 16);
+            memcpy(key.dst_addr, ip6Pkt.GetDstAddrPtr(), 16);
+            memcpy(&key.id, buffer + offset + 4, 4);
+            key.protocol = nextHeader = buffer[offset];
+            hdrLength = offset;
+            data = buffer + offset + 8;  // (fragment data follows FRAG header)
+            end = start + (pktLength - offset - 8);
+            payloadMax = 65535 + ProtoPktIPv6::GetHeaderLength() - hdrLength;
+            break;
+        }
+        default:
+            PLOG(PL_DEBUG, "ProtoIPReassembler::Process() error: invalid IP version\n");
+            drop_count++;
+            return STATUS_DROPPED;
+    }
+    // All but the last fragment must carry a multiple of 8 bytes
+    if ((end > payloadMax) || (hdrLength > HEADER_MAX) ||
+        (more && ((end == start) || (0 != ((end - start) & 0x07)))))
+    {
+        PLOG(PL_DEBUG, "ProtoIPReassembler::Process() invalid fragment\n");
+        drop_count++;
+        return STATUS_DROPPED;
+    }
+    UINT32 hash = key.GetHash();
+    UINT32 index = datagram_table.Find(key, hash);
+    if (NIL == index) index = AddDatagram(key, hash);
+    Datagram& datagram = datagram_table[index];
+    // Check consistency with the datagram end, if known
+    bool valid = true;
+    if (!more)
+    {
+        if (datagram.last_seen)
+            valid = (end == datagram.total_length);
+        else if ((0 != datagram.range_count) && (datagram.range_list[datagram.range_count - 1].end > end))
+            valid = false;
+        datagram.last_seen = true;
+        datagram.total_length = end;
+    }
+    else if (datagram.last_seen && (end > datagram.total_length))
+    {
+        valid = false;
+    }
+    if (valid && (0 == start) && !datagram.first_seen)
+    {
+        memcpy(datagram.header, buffer, hdrLength);
+        datagram.header_length = hdrLength;
+        datagram.next_header_offset = nextHeaderOffset;
+        datagram.next_header = nextHeader;
+        datagram.first_seen = true;
+    }
+    if (!valid || !AddData(index, start, end, data))
+    {
+        RemoveDatagram(index);
+        drop_count++;
+        return STATUS_DROPPED;
+    }
+    if (datagram.first_seen && datagram.last_seen && (1 == datagram.range_count) &&
+        (0 == datagram.range_list[0].start) && (datagram.total_length == datagram.range_list[0].end))
+    {
+        unsigned int pktLength = Assemble(datagram);
+        RemoveDatagram(index);
+        complete_count++;
+        outPkt.InitFromBuffer(pktLength, out_buffer, PKT_SIZE_MAX);
+        return STATUS_COMPLETE;
+    }
+    return STATUS_PENDING;
+}  // end ProtoIPReassembler::Process()
+
+UINT32 ProtoIPReassembler::AddDatagram(const Key& key, UINT32 hash)
+{
+    if (datagram_table.IsFull())
+    {
+        // Discard oldest pending datagram
+        RemoveDatagram(age_head);
+        evict_count++;
+    }
+    UINT32 index = datagram_table.Insert(key, hash);
+    Datagram& datagram = datagram_table[index];
+    datagram.total_length = 0;
+    datagram.last_seen = datagram.first_seen = false;
+    datagram.header_length = 0;
+    datagram.range_count = 0;
+    memset(datagram.page_list, 0xff, sizeof(datagram.page_list));  // (all NIL)
+    // Append to pending list (in creation, and so timeout, order)
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    datagram.create_time = ProtoTime(currentTime).GetValue();
+    datagram.age_prev = age_tail;
+    datagram.age_next = NIL;
+    if (NIL != age_tail)
+        datagram_table[age_tail].age_next = index;
+    else
+        age_head = index;
+    age_tail = index;
+    if (!timeout_timer.IsActive())
+    {
+        timeout_timer.SetInterval(timeout);
+        timer_mgr.ActivateTimer(timeout_timer);
+    }
+    return index;
+}  // end ProtoIPReassembler::AddDatagram()
+
+void ProtoIPReassembler::RemoveDatagram(UINT32 index)
+{
+    Datagram& datagram = datagram_table[index];
+    if (NIL != datagram.age_prev)
+        datagram_table[datagram.age_prev].age_next = datagram.age_next;
+    else
+        age_head = datagram.age_next;
+    if (NIL != datagram.age_next)
+        datagram_table[datagram.age_next].age_prev = datagram.age_prev;
+    else
+        age_tail = datagram.age_prev;
+    for (unsigned int i = 0; i < PAGE_MAX; i++)
+    {
+        if (NIL != datagram.page_list[i])
+            page_free_list[page_free_count++] = datagram.page_list[i];
+    }
+    datagram_table.Remove(index);
+}  // end ProtoIPReassembler::RemoveDatagram()
+
+// Takes a free page, discarding older datagrams if needed
+UINT32 ProtoIPReassembler::GetPage(UINT32 index)
+{
+    while (0 == page_free_count)
+    {
+        UINT32 oldest = (index != age_head) ? age_head : datagram_table[age_head].age_next;
+        if (NIL == oldest) return NIL;
+        RemoveDatagram(oldest);
+        evict_count++;
+    }
+    return page_free_list[--page_free_count];
+}  // end ProtoIPReassembler::GetPage()
+
+// Copies fragment data not already received into the datagram's pages
+bool ProtoIPReassembler::AddData(UINT32 index, UINT32 start, UINT32 end, const UINT8* data)
+{
+    Datagram& datagram = datagram_table[index];
+    bool overlap = false;
+    for (unsigned int i = 0; i < datagram.range_count; i++)
+    {
+        const Range& range = datagram.range_list[i];
+        if ((range.start < end) && (range.end > start))
+        {
+            overlap = true;
+            if ((range.start <= start) && (range.end >= end))
+            {
+                overlap_count++;
+                return true;  // (duplicate, nothing new)
+            }
+        }
+    }
+    if (overlap)
+    {
+        overlap_count++;
+        if (6 == datagram.key.version) return false;  // RFC 5722
+    }
+    // Copy each gap between received ranges (earlier data is retained)
+    UINT32 pos = start;
+    unsigned int r = 0;
+    while (pos < end)
+    {
+        while ((r < datagram.range_count) && (datagram.range_list[r].end <= pos)) r++;
+        UINT32 gapEnd = end;
+        if ((r < datagram.range_count) && (datagram.range_list[r].start < end))
+        {
+            if (datagram.range_list[r].start <= pos)
+            {
+                pos = datagram.range_list[r].end;
+                continue;
+            }
+            gapEnd = datagram.range_list[r].start;
+        }
+        while (pos < gapEnd)
+        {
+            UINT32 pageIndex = pos / PAGE_SIZE;
+            UINT32& page = datagram.page_list[pageIndex];
+            if ((NIL == page) && (NIL == (page = GetPage(index))))
+            {
+                PLOG(PL_DEBUG, "ProtoIPReassembler::AddData() reassembly memory exhausted\n");
+                return false;
+            }
+            UINT32 pageEnd = (pageIndex + 1) * PAGE_SIZE;
+            UINT32 count = ((gapEnd < pageEnd) ? gapEnd : pageEnd) - pos;
+            memcpy(GetPageData(page) + (pos - pageIndex * PAGE_SIZE), data + (pos - start), count);
+            pos += count;
+        }
+    }
+    return AddRange(datagram, start, end);
+}  // end ProtoIPReassembler::AddData()
+
+// Merges [start, end) into the sorted list of received ranges
+bool ProtoIPReassembler::AddRange(Datagram& datagram, UINT32 start, UINT32 end)
+{
+    Range* list = datagram.range_list;
+    unsigned int count = datagram.range_count;
+    unsigned int i = 0;
+    while ((i < count) && (list[i].end < start)) i++;
+    unsigned int j = i;
+    while ((j < count) && (list[j].start <= end))
+    {
+        if (list[j].start < start) start = list[j].start;
+        if (list[j].end > end) end = list[j].end;
+        j++;
+    }
+    if (i == j)
+    {
+        if (count >= RANGE_MAX)
+        {
+            PLOG(PL_DEBUG, "ProtoIPReassembler::AddRange() too many fragment holes\n");
+            return false;
+        }
+        memmove(list + i + 1, list + i, (count - i) * sizeof(Range));
+        datagram.range_count++;
+    }
+    else
+    {
+        memmove(list + i + 1, list + j, (count - j) * sizeof(Range));
+        datagram.range_count -= (j - i - 1);
+    }
+    list[i].start = start;
+    list[i].end = end;
+    return true;
+}  // end ProtoIPReassembler::AddRange()
+
+// Builds the reassembled packet in "out_buffer" and returns its length
+unsigned int ProtoIPReassembler::Assemble(Datagram& datagram)
+{
+    UINT8* out = (UINT8*)out_buffer;
+    memcpy(out, datagram.header, datagram.header_length);
+    UINT8* ptr = out + datagram.header_length;
+    for (UINT32 pos = 0; pos < datagram.total_length; pos += PAGE_SIZE)
+    {
+        UINT32 count = datagram.total_length - pos;
+        if (count > PAGE_SIZE) count = PAGE_SIZE;
+        memcpy(ptr + pos, GetPageData(datagram.page_list[pos / PAGE_SIZE]), count);
+    }
+    unsigned int pktLength = datagram.header_length + datagram.total_length;
+    if (4 == datagram.key.version)
+    {
+        ProtoPktIPv4 ip4Pkt(out_buffer, PKT_SIZE_MAX, true);
+        ip4Pkt.SetTotalLength(pktLength);
+        ip4Pkt.ClearFlag(ProtoPktIPv4::FLAG_MF);
+        ip4Pkt.SetFragmentOffset(0);
+        ip4Pkt.CalculateChecksum();
+    }
+    else
+    {
+        // Unfragmentable part ends where the FRAG header was
+        UINT16 payloadLength = pktLength - ProtoPktIPv6::GetHeaderLength();
+        out[4] = (UINT8)(payloadLength >> 8);
+        out[5] = (UINT8)payloadLength;
+        out[datagram.next_header_offset] = datagram.next_header;
+    }
+    return pktLength;
+}  // end ProtoIPReassembler::Assemble()
+
+void ProtoIPReassembler::Flush()
+{
+    while (NIL != age_head)
+        RemoveDatagram(age_head);
+    if (timeout_timer.IsActive()) timeout_timer.Deactivate();
+}  // end ProtoIPReassembler::Flush()
+
+void ProtoIPReassembler::OnTimeout(ProtoTimer& /*theTimer*/)
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    double now = ProtoTime(currentTime).GetValue();
+    // (a little slack so timer granularity doesn't cause an extra wakeup)
+    while ((NIL != age_head) && ((datagram_table[age_head].create_time + timeout) <= (now + 1.0e-03)))
+    {
+        RemoveDatagram(age_head);
+        timeout_count++;
+    }
+    if (NIL == age_head)
+        timeout_timer.Deactivate();
+    else
+        timeout_timer.SetInterval(datagram_table[age_head].create_time + timeout - now);
+}  // end ProtoIPReassembler::OnTimeout()
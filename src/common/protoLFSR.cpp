@@ -9,7 +9,7 @@ ProtoLFSR::ProtoLFSR(Polynomial polynomial,
  : lfsr_poly((UINT32)polynomial),
    lfsr_state(initialState),
    lfsr_bits(GetPolySize(polynomial)),
-   is_mirrored(false), byte_mode(false)
+   is_mirrored(false), byte_mode(false), table_poly(PN_NONE)
 {
     lfsr_mask = ((UINT32)0xffffffff) >> (32 - lfsr_bits);
     //TRACE("lfsr_mask = 0x%04x\n", lfsr_mask);
@@ -92,6 +92,16 @@ void ProtoLFSR::Seek(int offsetBits)
 
 void ProtoLFSR::Shift(unsigned int count)
 {
+    if (count >= JUMP_SHIFT_MIN)
+    {
+        Jump(count);
+        return;
+    }
+    else if (count >= TABLE_SHIFT_MIN)
+    {
+        if (!TableIsValid()) BuildTable();
+        for (; count >= 8; count -= 8) StepByte();
+    }
     for (unsigned int i = 0; i < count; i++)
     {
         bool bit = (0 != (lfsr_state & 0x00000001));
@@ -101,6 +111,81 @@ void ProtoLFSR::Shift(unsigned int count)
     }
 }  // end ProtoLFSR::Shift()
 
+// Since the Galois register is linear over GF(2), "count" shifts
+// can be computed as T^count applied to the state, where "T" is the 
+// single shift transition matrix.  The matrix is raised to the needed
+// power by repeated squaring, so this takes O(log(count)) steps.
+void ProtoLFSR::Jump(unsigned int count)
+{
+    // matrix[i] is the image of state bit 'i' (i.e. matrix columns)
+    UINT32 matrix[32];
+    memset(matrix, 0, 32*sizeof(UINT32));
+    matrix[0] = lfsr_poly;
+    for (unsigned int i = 1; i < lfsr_bits; i++)
+        matrix[i] = ((UINT32)0x00000001) << (i - 1);
+    UINT32 state = lfsr_state;
+    while (0 != count)
+    {
+        if (0 != (count & 0x01))
+            state = MatrixMultiply(matrix, state);
+        count >>= 1;
+        if (0 != count) MatrixSquare(matrix);
+    }
+    lfsr_state = state;
+}  // end ProtoLFSR::Jump()
+
+UINT32 ProtoLFSR::MatrixMultiply(const UINT32* matrix, UINT32 vector)
+{
+    UINT32 result = 0;
+    while (0 != vector)
+    {
+        if (0 != (vector & 0x00000001)) result ^= *matrix;
+        vector >>= 1;
+        matrix++;
+    }
+    return result;
+}  // end ProtoLFSR::MatrixMultiply()
+
+void ProtoLFSR::MatrixSquare(UINT32* matrix)
+{
+    UINT32 result[32];
+    for (unsigned int i = 0; i < 32; i++)
+        result[i] = MatrixMultiply(matrix, matrix[i]);
+    memcpy(matrix, result, 32*sizeof(UINT32));
+}  // end ProtoLFSR::MatrixSquare()
+
+// The register state after 8 shifts (and the 8 output bits) are linear
+// in the low 8 bits of the state, so only the 8 single-bit entries are
+// computed by shifting and the rest of the table is filled in by XOR.
+void ProtoLFSR::BuildTable()
+{
+    UINT32 savedState = lfsr_state;
+    step_xor[0] = 0;
+    step_out[0] = 0;
+    for (unsigned int b = 0; b < 8; b++)
+    {
+        UINT8 out = 0;
+        lfsr_state = ((UINT32)0x00000001) << b;
+        for (unsigned int i = 0; i < 8; i++)
+        {
+            out <<= 1;
+            if (0 != (lfsr_state & 0x00000001)) out |= 0x01;
+            Shift();
+        }
+        step_xor[1 << b] = lfsr_state;
+        step_out[1 << b] = out;
+    }
+    for (unsigned int v = 3; v < 256; v++)
+    {
+        unsigned int lowBit = v & (~v + 1);
+        if (v == lowBit) continue;
+        step_xor[v] = step_xor[v ^ lowBit] ^ step_xor[lowBit];
+        step_out[v] = step_out[v ^ lowBit] ^ step_out[lowBit];
+    }
+    lfsr_state = savedState;
+    table_poly = lfsr_poly;
+}  // end ProtoLFSR::BuildTable()
+
 // This is used to "reverse load" the shift
 // register towards the state it would be
 // in to generate the sequence of bits
@@ -126,6 +211,54 @@ bool ProtoLFSR::Sync(const char* buffer, unsigned int buflen, unsigned int bitOf
     return true;
 }  // end ProtoLFSR::Sync()
 
+int ProtoLFSR::SyncSearch(const char*  buffer, 
+                          unsigned int buflen, 
+                          unsigned int maxOffset,
+                          unsigned int checkBits,
+                          unsigned int maxErrors)
+{
+    unsigned int totalBits = buflen << 3;
+    if (totalBits < (lfsr_bits + checkBits)) return -1;
+    unsigned int lastOffset = totalBits - lfsr_bits - checkBits;
+    if (maxOffset < lastOffset) lastOffset = maxOffset;
+    Reset(0);  // so step table is built for the forward polynomial
+    if (!TableIsValid()) BuildTable();
+    for (unsigned int offset = 0; offset <= lastOffset; offset++)
+    {
+        Sync(buffer, buflen, offset);
+        // The sync bits themselves are regenerated by definition,
+        // so skip past them and check the bits that follow
+        for (unsigned int i = 0; i < lfsr_bits; i++) Shift();
+        unsigned int index = offset + lfsr_bits;
+        unsigned int remaining = checkBits;
+        unsigned int errors = 0;
+        while ((remaining >= 8) && (errors <= maxErrors))
+        {
+            // Get the (possibly unaligned) byte at bit "index"
+            unsigned int shift = index & 0x07;
+            UINT8 byte = (UINT8)buffer[index >> 3] << shift;
+            if (0 != shift) byte |= (UINT8)buffer[(index >> 3) + 1] >> (8 - shift);
+            errors += GetWeight(byte ^ StepByte());
+            index += 8;
+            remaining -= 8;
+        }
+        while ((remaining > 0) && (errors <= maxErrors))
+        {
+            bool bit = (0 != (lfsr_state & 0x00000001));
+            Shift();
+            if (bit != GetBit(buffer, index)) errors++;
+            index++;
+            remaining--;
+        }
+        if (errors <= maxErrors)
+        {
+            Sync(buffer, buflen, offset);
+            return (int)offset;
+        }
+    }
+    return -1;
+}  // end ProtoLFSR::SyncSearch()
+
 UINT32 ProtoLFSR::MirrorBits(UINT32 word, unsigned int numBits)
 {
     UINT32 bit = 0x00000001 << (numBits - 1);
@@ -174,6 +307,11 @@ bool ProtoLFSR::GetNextBit()
 
 UINT8 ProtoLFSR::GetNextByte()
 {
+    if (!IsMirrored() && TableIsValid())
+    {
+        byte_mode = true;
+        return StepByte();
+    }
     if (IsMirrored())
     {
         Shift();    
@@ -230,8 +368,23 @@ UINT8 ProtoLFSR::GetPrevByte()
 
 void ProtoLFSR::FillBuffer(char* buffer, unsigned int buflen)
 {
-    for (unsigned int i = 0; i < buflen; i++)
-        buffer[i] = GetNextByte();
+    if (0 == buflen) return;
+    // First byte is generated the regular way to take care
+    // of any mirroring left over from prior "GetPrev" calls
+    buffer[0] = GetNextByte();
+    if (!TableIsValid()) BuildTable();
+    unsigned int i = 1;
+    // Generate 32 bits per loop iteration
+    for (; (i + 4) <= buflen; i += 4)
+    {
+        buffer[i] = (char)StepByte();
+        buffer[i+1] = (char)StepByte();
+        buffer[i+2] = (char)StepByte();
+        buffer[i+3] = (char)StepByte();
+    }
+    for (; i < buflen; i++)
+        buffer[i] = (char)StepByte();
+    byte_mode = true;
 }  // end ProtoLFSR::FillBuffer()
 
 
@@ -312,7 +465,8 @@ UINT32 ProtoLFSR::PolynomialSearch(unsigned int m)
 ProtoLFSRX::ProtoLFSRX()
  : lfsrx_poly(NULL), lfsrx_state(NULL),
    lfsrx_bits(0), lfsrx_words(0), lfsrx_mask(0),
-   is_mirrored(false), byte_mode(false)
+   is_mirrored(false), byte_mode(false),
+   step_xor(NULL), table_mirrored(false)
 {
 }
 
@@ -324,6 +478,7 @@ ProtoLFSRX::~ProtoLFSRX()
         delete[] lfsrx_state;
         lfsrx_poly = NULL;
     }
+    ClearTable();
 }
 
 bool ProtoLFSRX::SetPolynomial(const UINT32*    polynomial,
@@ -336,6 +491,7 @@ bool ProtoLFSRX::SetPolynomial(const UINT32*    polynomial,
         delete[] lfsrx_poly;
         delete[] lfsrx_state;
     }
+    ClearTable();
     lfsrx_state = NULL;
     lfsrx_bits = lfsrx_words = 0;
     lfsrx_mask = 0;
@@ -412,6 +568,7 @@ bool ProtoLFSRX::ComputePolynomial(const char* buffer, int numBits)
         delete[] lfsrx_poly;
         delete[] lfsrx_state;
     }
+    ClearTable();
     lfsrx_state = NULL;
     lfsrx_bits = lfsrx_words = 0;
     lfsrx_mask = 0;
@@ -593,6 +750,11 @@ bool ProtoLFSRX::GetNextBit()
 
 UINT8 ProtoLFSRX::GetNextByte()
 {
+    if (!IsMirrored() && TableIsValid())
+    {
+        byte_mode = true;
+        return StepByte();
+    }
     if (IsMirrored())
     {
         Shift();    
@@ -649,10 +811,87 @@ UINT8 ProtoLFSRX::GetPrevByte()
 
 void ProtoLFSRX::FillBuffer(char* buffer, unsigned int buflen)
 {
-    for (unsigned int i = 0; i < buflen; i++)
-        buffer[i] = GetNextByte();
+    if (0 == buflen) return;
+    buffer[0] = GetNextByte();  // handles any mirroring
+    if (TableIsValid() || BuildTable())
+    {
+        for (unsigned int i = 1; i < buflen; i++)
+            buffer[i] = (char)StepByte();
+        byte_mode = true;
+    }
+    else
+    {
+        for (unsigned int i = 1; i < buflen; i++)
+            buffer[i] = GetNextByte();
+    }
 }  // end ProtoLFSRX::FillBuffer()
 
+// See ProtoLFSR::BuildTable() comments.  Here each table
+// entry is a full "lfsrx_words" register contribution.
+bool ProtoLFSRX::BuildTable()
+{
+    if (0 == lfsrx_words) return false;
+    if (NULL == step_xor)
+    {
+        if (NULL == (step_xor = new UINT32[256*lfsrx_words]))
+        {
+            PLOG(PL_ERROR, "ProtoLFSRX::BuildTable() new step_xor error: %s\n", GetErrorString());
+            return false;
+        }
+    }
+    UINT32* savedState = new UINT32[lfsrx_words];
+    if (NULL == savedState)
+    {
+        PLOG(PL_ERROR, "ProtoLFSRX::BuildTable() new savedState error: %s\n", GetErrorString());
+        ClearTable();
+        return false;
+    }
+    memcpy(savedState, lfsrx_state, lfsrx_words*sizeof(UINT32));
+    memset(step_xor, 0, lfsrx_words*sizeof(UINT32));
+    step_out[0] = 0;
+    for (unsigned int b = 0; b < 8; b++)
+    {
+        UINT8 out = 0;
+        memset(lfsrx_state, 0, lfsrx_words*sizeof(UINT32));
+        lfsrx_state[0] = ((UINT32)0x00000001) << b;
+        for (unsigned int i = 0; i < 8; i++)
+        {
+            out <<= 1;
+            if (0 != (lfsrx_state[0] & 0x00000001)) out |= 0x01;
+            Shift();
+        }
+        memcpy(step_xor + (lfsrx_words << b), lfsrx_state, lfsrx_words*sizeof(UINT32));
+        step_out[1 << b] = out;
+    }
+    for (unsigned int v = 3; v < 256; v++)
+    {
+        unsigned int lowBit = v & (~v + 1);
+        if (v == lowBit) continue;
+        UINT32* row = step_xor + v*lfsrx_words;
+        const UINT32* rowA = step_xor + (v ^ lowBit)*lfsrx_words;
+        const UINT32* rowB = step_xor + lowBit*lfsrx_words;
+        for (unsigned int i = 0; i < lfsrx_words; i++)
+            row[i] = rowA[i] ^ rowB[i];
+        step_out[v] = step_out[v ^ lowBit] ^ step_out[lowBit];
+    }
+    memcpy(lfsrx_state, savedState, lfsrx_words*sizeof(UINT32));
+    delete[] savedState;
+    table_mirrored = is_mirrored;
+    return true;
+}  // end ProtoLFSRX::BuildTable()
+
+// Shifts the register 8 bits, returning the 8 output bits
+UINT8 ProtoLFSRX::StepByte()
+{
+    UINT8 index = (UINT8)lfsrx_state[0];
+    const UINT32* row = step_xor + index*lfsrx_words;
+    unsigned int last = lfsrx_words - 1;
+    for (unsigned int i = 0; i < last; i++)
+        lfsrx_state[i] = ((lfsrx_state[i] >> 8) | (lfsrx_state[i+1] << 24)) ^ row[i];
+    lfsrx_state[last] = (lfsrx_state[last] >> 8) ^ row[last];
+    return step_out[index];
+}  // end ProtoLFSRX::StepByte()
+
 // This sets the LFSR to the state it would be in _before_
 // generating the first "lfsr_bits" (register length) of bits 
 // provided in the "buffer".  This can be used to "sync" the 
@@ -698,6 +937,10 @@ void ProtoLFSRX::LoadBit(bool bit)
 
 void ProtoLFSRX::Shift(unsigned int count)
 {
+    if ((count >= TABLE_SHIFT_MIN) && (TableIsValid() || BuildTable()))
+    {
+        for (; count >= 8; count -= 8) StepByte();
+    }
     for (unsigned int i = 0; i < count; i++)
     {
         // This loop shifts the lfsrx_state register to the "right"
@@ -0,0 +1,295 @@
+#include "protoPacer.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy()
+
+ProtoPacer::ProtoPacer(ProtoTimerMgr& timerMgr)
+ : timer_mgr(timerMgr), socket(NULL), cap(NULL), rate(0.0),
+   bucket_depth(0), burst_interval(1.0e-03), kernel_pacing(false), tokens(0.0),
+   slot_list(NULL), slot_buffer(NULL), slot_max(0), slot_head(0), slot_count(0),
+   pkt_size_max(0), sent_packets(0), sent_bytes(0), drop_count(0)
+{
+    pace_timer.SetListener(this, &ProtoPacer::OnPaceTimeout);
+    pace_timer.SetInterval(0.0);
+    pace_timer.SetRepeat(-1);
+}
+
+ProtoPacer::~ProtoPacer()
+{
+    Close();
+}
+
+bool ProtoPacer::Open(ProtoSocket& theSocket, unsigned int queueLength, unsigned int pktSizeMax)
+{
+    if (!Init(queueLength, pktSizeMax)) return false;
+    socket = &theSocket;
+    if (kernel_pacing && !SetKernelPacing(true))
+        PLOG(PL_WARN, "ProtoPacer::Open() warning: kernel pacing unavailable, using timer pacing\n");
+    return true;
+}  // end ProtoPacer::Open(ProtoSocket)
+
+bool ProtoPacer::Open(ProtoCap& theCap, unsigned int queueLength, unsigned int pktSizeMax)
+{
+    if (!Init(queueLength, pktSizeMax)) return false;
+    cap = &theCap;
+    kernel_pacing = false;
+    return true;
+}  // end ProtoPacer::Open(ProtoCap)
+
+bool ProtoPacer::Init(unsigned int queueLength, unsigned int pktSizeMax)
+{
+    if (IsOpen()) Close();
+    if ((0 == queueLength) || (0 == pktSizeMax))
+    {
+        PLOG(PL_ERROR, "ProtoPacer::Open() error: invalid queue parameters\n");
+        return false;
+    }
+    if (NULL == (slot_list = new Slot[queueLength]))
+    {
+        PLOG(PL_ERROR, "ProtoPacer::Open() new slot_list error: %s\n", GetErrorString());
+        return false;
+    }
+    if (NULL == (slot_buffer = new char[queueLength*pktSizeMax]))
+    {
+        PLOG(PL_ERROR, "ProtoPacer::Open() new slot_buffer error: %s\n", GetErrorString());
+        delete[] slot_list;
+        slot_list = NULL;
+        return false;
+    }
+    slot_max = queueLength;
+    pkt_size_max = pktSizeMax;
+    slot_head = slot_count = 0;
+    // Start with a full bucket
+    tokens = (double)((bucket_depth > pkt_size_max) ? bucket_depth : pkt_size_max);
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    refill_time = currentTime;
+    ResetStats();
+    return true;
+}  // end ProtoPacer::Init()
+
+void ProtoPacer::Close()
+{
+    if (pace_timer.IsActive()) pace_timer.Deactivate();
+    if (kernel_pacing && (NULL != socket))
+    {
+        SetKernelPacing(false);
+        kernel_pacing = true;  // retain setting for next Open()
+    }
+    if (NULL != slot_list)
+    {
+        delete[] slot_list;
+        slot_list = NULL;
+    }
+    if (NULL != slot_buffer)
+    {
+        delete[] slot_buffer;
+        slot_buffer = NULL;
+    }
+    slot_max = slot_head = slot_count = 0;
+    socket = NULL;
+    cap = NULL;
+}  // end ProtoPacer::Close()
+
+void ProtoPacer::SetRate(double bitsPerSecond)
+{
+    if (IsOpen()) Refill();  // credit tokens at the old rate first
+    rate = (bitsPerSecond > 0.0) ? bitsPerSecond : 0.0;
+    if (kernel_pacing && (NULL != socket))
+        socket->SetMaxPacingRate(rate);
+    if (IsOpen() && (0 != slot_count))
+    {
+        // Re-evaluate release time for queued packets
+        if (pace_timer.IsActive()) pace_timer.Deactivate();
+        ScheduleRelease();
+    }
+}  // end ProtoPacer::SetRate()
+
+bool ProtoPacer::SetKernelPacing(bool enable)
+{
+    if (NULL == socket)
+    {
+        // Will be applied upon Open(ProtoSocket)
+        kernel_pacing = enable;
+        return true;
+    }
+    if (!socket->SetMaxPacingRate(enable ? rate : 0.0))
+    {
+        kernel_pacing = false;
+        return false;
+    }
+    kernel_pacing = enable;
+    return true;
+}  // end ProtoPacer::SetKernelPacing()
+
+void ProtoPacer::ResetStats()
+{
+    sent_packets = sent_bytes = drop_count = 0;
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    stats_start = currentTime;
+}  // end ProtoPacer::ResetStats()
+
+double ProtoPacer::GetAchievedRate()
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    double elapsed = ProtoTime::Delta(ProtoTime(currentTime), stats_start);
+    return ((elapsed > 0.0) ? (8.0 * (double)sent_bytes / elapsed) : 0.0);
+}  // end ProtoPacer::GetAchievedRate()
+
+void ProtoPacer::Refill()
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    ProtoTime now(currentTime);
+    double elapsed = ProtoTime::Delta(now, refill_time);
+    refill_time = now;
+    if (elapsed <= 0.0) return;
+    tokens += elapsed * rate / 8.0;
+    // The bucket holds at least one burst interval (and one packet) worth
+    // of credit.  While packets are queued, it may also hold the head
+    // packet's size so that late timer wakeups do not reduce the achieved
+    // rate, but a long blocked or late period can't build up credit for a
+    // line rate burst.
+    double depth = burst_interval * rate / 8.0;
+    if (depth < (double)bucket_depth) depth = (double)bucket_depth;
+    if (depth < (double)pkt_size_max) depth = (double)pkt_size_max;
+    if (0 != slot_count) depth += (double)slot_list[slot_head].length;
+    if (tokens > depth) tokens = depth;
+}  // end ProtoPacer::Refill()
+
+ProtoPacer::TransmitStatus ProtoPacer::Transmit(const char* buffer, unsigned int numBytes, const ProtoAddress* dstAddr)
+{
+    // A zero-length packet can't be told apart from a blocked send by its
+    // zeroed "length", so it is only ever taken as sent or failed (it would
+    // otherwise be retried forever and stall the queue behind it).
+    unsigned int length = numBytes;
+    if (NULL != socket)
+    {
+        // ProtoSocket returns "true" with "length" zeroed when the send would
+        // block ("length" is also zeroed on error, when it returns "false")
+        bool result = (NULL != dstAddr) ? socket->SendTo(buffer, length, *dstAddr) : socket->Send(buffer, length);
+        if (!result) return TX_ERROR;
+        if ((0 == length) && (0 != numBytes)) return TX_BLOCKED;
+    }
+    else
+    {
+        // ProtoCap zeroes "length" only when the send would block, returning
+        // "false" (LinuxCap, PcapCap) or "true" (BsdCap), so check it first
+        // as ProtoPcapReplay does
+        bool result = cap->Send(buffer, length);
+        if ((0 == length) && (0 != numBytes)) return TX_BLOCKED;
+        if (!result) return TX_ERROR;
+    }
+    sent_packets++;
+    sent_bytes += numBytes;
+    return TX_OK;
+}  // end ProtoPacer::Transmit()
+
+bool ProtoPacer::Enqueue(const char* buffer, unsigned int numBytes, const ProtoAddress* dstAddr)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoPacer::Send() error: pacer not open\n");
+        return false;
+    }
+    if (0 == slot_count)
+    {
+        // Send immediately if unpaced or the bucket has room
+        bool unpaced = (rate <= 0.0) || kernel_pacing;
+        if (!unpaced) Refill();
+        if (unpaced || (tokens >= (double)numBytes))
+        {
+            switch (Transmit(buffer, numBytes, dstAddr))
+            {
+                case TX_OK:
+                    if (!unpaced) tokens -= (double)numBytes;
+                    return true;
+                case TX_ERROR:
+                    drop_count++;
+                    return false;
+                case TX_BLOCKED:
+                    break;  // queue it below
+            }
+        }
+    }
+    if ((slot_count >= slot_max) || (numBytes > pkt_size_max))
+    {
+        drop_count++;
+        return false;
+    }
+    unsigned int index = (slot_head + slot_count) % slot_max;
+    Slot& slot = slot_list[index];
+    memcpy(GetSlotData(index), buffer, numBytes);
+    slot.length = numBytes;
+    if (NULL != dstAddr)
+    {
+        slot.dst_addr = *dstAddr;
+        slot.has_dst = true;
+    }
+    else
+    {
+        slot.has_dst = false;
+    }
+    slot_count++;
+    if (!pace_timer.IsActive()) ScheduleRelease();
+    return true;
+}  // end ProtoPacer::Enqueue()
+
+double ProtoPacer::GetReleaseDelay() const
+{
+    // Time until the head packet is eligible, but
+    // no sooner than the burst interval
+    double delay = burst_interval;
+    if ((rate > 0.0) && !kernel_pacing)
+    {
+        double deficit = (double)slot_list[slot_head].length - tokens;
+        double wait = (deficit > 0.0) ? (8.0 * deficit / rate) : 0.0;
+        if (wait > delay) delay = wait;
+    }
+    return delay;
+}  // end ProtoPacer::GetReleaseDelay()
+
+void ProtoPacer::ScheduleRelease()
+{
+    ASSERT(0 != slot_count);
+    pace_timer.SetInterval(GetReleaseDelay());
+    if (pace_timer.IsActive())
+        pace_timer.Reschedule();
+    else
+        timer_mgr.ActivateTimer(pace_timer);
+}  // end ProtoPacer::ScheduleRelease()
+
+void ProtoPacer::OnPaceTimeout(ProtoTimer& /*theTimer*/)
+{
+    bool unpaced = (rate <= 0.0) || kernel_pacing;
+    if (!unpaced) Refill();
+    while (0 != slot_count)
+    {
+        Slot& slot = slot_list[slot_head];
+        if (!unpaced && (tokens < (double)slot.length)) break;
+        TransmitStatus status =
+            Transmit(GetSlotData(slot_head), slot.length, slot.has_dst ? &slot.dst_addr : NULL);
+        if (TX_BLOCKED == status) break;  // retry next burst
+        if (TX_OK == status)
+        {
+            if (!unpaced) tokens -= (double)slot.length;
+        }
+        else
+        {
+            drop_count++;
+        }
+        slot_head = (slot_head + 1) % slot_max;
+        slot_count--;
+    }
+    if (0 == slot_count)
+    {
+        pace_timer.Deactivate();
+    }
+    else
+    {
+        // Set interval for next (repeating) timeout
+        pace_timer.SetInterval(GetReleaseDelay());
+    }
+}  // end ProtoPacer::OnPaceTimeout()
@@ -0,0 +1,752 @@
+#include "protoPcapAnalyzer.h"
+#include "protoHash.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy(), memset()
+#include <stdio.h>
+#include <stdint.h>  // for uint64_t
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // if/else WIN32/UNIX
+
+// Classic pcap file format constants
+// (see https://www.tcpdump.org/manpages/pcap-savefile.5.html)
+static const UINT32 PCAP_MAGIC_USEC = 0xa1b2c3d4;
+static const UINT32 PCAP_MAGIC_NSEC = 0xa1b23c4d;
+static const unsigned int PCAP_FILE_HDR_LEN = 24;
+static const unsigned int PCAP_REC_HDR_LEN = 16;
+// pcapng block types (see RFC draft-ietf-opsawg-pcapng)
+static const UINT32 PCAPNG_SHB = 0x0a0d0d0a;    // section header
+static const UINT32 PCAPNG_IDB = 0x00000001;    // interface description
+static const UINT32 PCAPNG_PB  = 0x00000002;    // packet (obsolete)
+static const UINT32 PCAPNG_SPB = 0x00000003;    // simple packet
+static const UINT32 PCAPNG_EPB = 0x00000006;    // enhanced packet
+static const UINT32 PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+static const UINT16 PCAPNG_OPT_END = 0;
+static const UINT16 PCAPNG_OPT_IF_TSRESOL = 9;
+
+static inline UINT32 Swap32(UINT32 value)
+{
+    return ((value >> 24) | ((value >> 8) & 0x0000ff00) |
+            ((value << 8) & 0x00ff0000) | (value << 24));
+}  // end Swap32()
+
+bool ProtoPcapAnalyzer::Worker::OutputBuffer::Append(UINT32 pktIndex, const char* data, UINT32 dataLength)
+{
+    unsigned int recordLength = 2*sizeof(UINT32) + dataLength;
+    if ((length + recordLength) > size)
+    {
+        unsigned int newSize = (0 != size) ? (2 * size) : 4096;
+        while (newSize < (length + recordLength)) newSize *= 2;
+        char* newBuffer = new char[newSize];
+        if (NULL == newBuffer)
+        {
+            PLOG(PL_ERROR, "ProtoPcapAnalyzer::Worker::Output() new error: %s\n", GetErrorString());
+            return false;
+        }
+        if (0 != length) memcpy(newBuffer, buffer, length);
+        delete[] buffer;
+        buffer = newBuffer;
+        size = newSize;
+    }
+    memcpy(buffer + length, &pktIndex, sizeof(UINT32));
+    memcpy(buffer + length + sizeof(UINT32), &dataLength, sizeof(UINT32));
+    memcpy(buffer + length + 2*sizeof(UINT32), data, dataLength);
+    length += recordLength;
+    return true;
+}  // end ProtoPcapAnalyzer::Worker::OutputBuffer::Append()
+
+ProtoPcapAnalyzer::Worker::Worker(ProtoPcapAnalyzer& theAnalyzer, unsigned int theIndex)
+ : analyzer(theAnalyzer), thread(theAnalyzer, *this), index(theIndex), next_chunk(0),
+   output(NULL), pkt_index(0), packet_count(0), byte_count(0), user_data(NULL)
+{
+}
+
+bool ProtoPcapAnalyzer::Worker::Output(const char* data, unsigned int length)
+{
+    if (NULL == output) return false;  // (no output handler, or not in packet handler)
+    return output->Append(pkt_index, data, length);
+}  // end ProtoPcapAnalyzer::Worker::Output()
+
+ProtoPcapAnalyzer::ProtoPcapAnalyzer()
+ : listener(NULL), affinity(AFFINITY_NONE), ordered_output(false),
+   chunk_size(DEFAULT_CHUNK_SIZE), chunk_record_max(DEFAULT_CHUNK_RECORDS),
+   file_buffer(NULL), file_size(0), file_mapped(false), is_pcapng(false), swap_bytes(false),
+   scan_offset(0), link_type(0), frac_scale(1000), iface_count(0),
+   worker_count(0), chunk_list(NULL), chunk_max(0),
+   fill_seq(0), take_seq(0), scan_done(false),
+   packet_count(0), byte_count(0), skip_count(0), chunk_count(0)
+{
+}
+
+ProtoPcapAnalyzer::~ProtoPcapAnalyzer()
+{
+    Close();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+bool ProtoPcapAnalyzer::Open(const char* fileName)
+{
+    Close();
+#ifdef WIN32
+    // (read into memory)
+    FILE* filePtr = fopen(fileName, "rb");
+    if (NULL == filePtr)
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() fopen(%s) error: %s\n", fileName, GetErrorString());
+        return false;
+    }
+    fseek(filePtr, 0, SEEK_END);
+    long fileSize = ftell(filePtr);
+    fseek(filePtr, 0, SEEK_SET);
+    if ((fileSize <= 0) || (NULL == (file_buffer = new char[fileSize])))
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() error: unable to load %s\n", fileName);
+        fclose(filePtr);
+        return false;
+    }
+    if ((size_t)fileSize != fread(file_buffer, 1, fileSize, filePtr))
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() fread() error: %s\n", GetErrorString());
+        fclose(filePtr);
+        delete[] file_buffer;
+        file_buffer = NULL;
+        return false;
+    }
+    fclose(filePtr);
+    file_size = (size_t)fileSize;
+    file_mapped = false;
+#else
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() open(%s) error: %s\n", fileName, GetErrorString());
+        return false;
+    }
+    struct stat fileStat;
+    if ((0 != fstat(fd, &fileStat)) || (fileStat.st_size <= 0))
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() error: %s is empty or unreadable\n", fileName);
+        close(fd);
+        return false;
+    }
+    void* ptr = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // (the mapping remains valid)
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() mmap() error: %s\n", GetErrorString());
+        return false;
+    }
+    // (records are scanned and processed roughly front to back)
+    madvise(ptr, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    file_buffer = (char*)ptr;
+    file_size = (size_t)fileStat.st_size;
+    file_mapped = true;
+#endif // if/else WIN32/UNIX
+
+    // Identify the file format
+    if (file_size >= 4)
+    {
+        UINT32 magic;
+        memcpy(&magic, file_buffer, 4);
+        if (PCAPNG_SHB == magic)
+        {
+            is_pcapng = true;
+            if (ParseSectionHeader(0)) return true;
+        }
+        else if (file_size >= PCAP_FILE_HDR_LEN)
+        {
+            is_pcapng = false;
+            swap_bytes = false;
+            if ((PCAP_MAGIC_USEC != magic) && (PCAP_MAGIC_NSEC != magic))
+            {
+                magic = Swap32(magic);
+                swap_bytes = true;
+            }
+            if ((PCAP_MAGIC_USEC == magic) || (PCAP_MAGIC_NSEC == magic))
+            {
+                frac_scale = (PCAP_MAGIC_NSEC == magic) ? 1 : 1000;
+                link_type = (UINT16)(Get32(file_buffer + 20) & 0x0000ffff);
+                return true;
+            }
+        }
+    }
+    PLOG(PL_ERROR, "ProtoPcapAnalyzer::Open() error: %s is not a pcap or pcapng file\n", fileName);
+    Close();
+    return false;
+}  // end ProtoPcapAnalyzer::Open()
+
+void ProtoPcapAnalyzer::Close()
+{
+    for (unsigned int i = 0; i < worker_count; i++)
+        delete worker_list[i];
+    worker_count = 0;
+    DestroyChunks();
+    if (NULL != file_buffer)
+    {
+#ifdef WIN32
+        delete[] file_buffer;
+#else
+        if (file_mapped)
+            munmap(file_buffer, file_size);
+        else
+            delete[] file_buffer;
+#endif // if/else WIN32/UNIX
+        file_buffer = NULL;
+    }
+    file_size = 0;
+    is_pcapng = false;
+}  // end ProtoPcapAnalyzer::Close()
+
+UINT16 ProtoPcapAnalyzer::Get16(const char* ptr) const
+{
+    UINT16 value;
+    memcpy(&value, ptr, 2);
+    return swap_bytes ? (UINT16)((value >> 8) | (value << 8)) : value;
+}  // end ProtoPcapAnalyzer::Get16()
+
+UINT32 ProtoPcapAnalyzer::Get32(const char* ptr) const
+{
+    UINT32 value;
+    memcpy(&value, ptr, 4);
+    return swap_bytes ? Swap32(value) : value;
+}  // end ProtoPcapAnalyzer::Get32()
+
+// Sets the byte order and resets the interface list for the section at "offset"
+bool ProtoPcapAnalyzer::ParseSectionHeader(size_t offset)
+{
+    if ((offset + 28) > file_size) return false;
+    UINT32 magic;
+    memcpy(&magic, file_buffer + offset + 8, 4);
+    if (PCAPNG_BYTE_ORDER_MAGIC == magic)
+        swap_bytes = false;
+    else if (PCAPNG_BYTE_ORDER_MAGIC == Swap32(magic))
+        swap_bytes = true;
+    else
+        return false;
+    iface_count = 0;
+    return true;
+}  // end ProtoPcapAnalyzer::ParseSectionHeader()
+
+void ProtoPcapAnalyzer::ParseInterface(const char* body, unsigned int length)
+{
+    if (iface_count >= INTERFACE_MAX)
+    {
+        iface_count++;  // (its packets are skipped)
+        return;
+    }
+    Interface& iface = iface_list[iface_count++];
+    iface.link_type = (length >= 8) ? Get16(body) : 0;
+    iface.units_per_sec = 1000000;  // (microseconds by default)
+    // Options (code, length, value padded to 32 bits)
+    unsigned int offset = 8;
+    while ((offset + 4) <= length)
+    {
+        UINT16 code = Get16(body + offset);
+        UINT16 optLen = Get16(body + offset + 2);
+        if ((PCAPNG_OPT_END == code) || ((offset + 4 + optLen) > length)) break;
+        if ((PCAPNG_OPT_IF_TSRESOL == code) && (optLen >= 1))
+        {
+            // Resolution is 2^-exponent (high bit set) or 10^-exponent.  Those
+            // too fine for 64-bit timestamp units (exponents over 19 or 63)
+            // are unsupported and the interface's packets are skipped.
+            UINT8 value = (UINT8)body[offset + 4];
+            bool base2 = (0 != (value & 0x80));
+            unsigned int exponent = value & 0x7f;
+            if (exponent > (base2 ? 63u : 19u))
+            {
+                PLOG(PL_WARN, "ProtoPcapAnalyzer::ParseInterface() warning: unsupported if_tsresol: 0x%02x\n", value);
+                iface.units_per_sec = 0;
+            }
+            else
+            {
+                iface.units_per_sec = 1;
+                for (unsigned int i = 0; i < exponent; i++)
+                    iface.units_per_sec *= base2 ? 2 : 10;
+            }
+        }
+        offset += 4 + ((optLen + 3) & ~3);
+    }
+}  // end ProtoPcapAnalyzer::ParseInterface()
+
+void ProtoPcapAnalyzer::Rewind()
+{
+    if (is_pcapng)
+    {
+        ParseSectionHeader(0);
+        scan_offset = 0;
+    }
+    else
+    {
+        scan_offset = PCAP_FILE_HDR_LEN;
+    }
+}  // end ProtoPcapAnalyzer::Rewind()
+
+bool ProtoPcapAnalyzer::NextRecord(Record& record)
+{
+    return is_pcapng ? NextPcapNGRecord(record) : NextPcapRecord(record);
+}  // end ProtoPcapAnalyzer::NextRecord()
+
+bool ProtoPcapAnalyzer::NextPcapRecord(Record& record)
+{
+    while ((scan_offset + PCAP_REC_HDR_LEN) <= file_size)
+    {
+        const char* hdr = file_buffer + scan_offset;
+        UINT32 captureLen = Get32(hdr + 8);
+        if ((scan_offset + PCAP_REC_HDR_LEN + captureLen) > file_size)
+        {
+            // (truncated final record)
+            skip_count++;
+            scan_offset = file_size;
+            return false;
+        }
+        scan_offset += PCAP_REC_HDR_LEN + captureLen;
+        UINT32 frac = Get32(hdr + 4);
+        if (frac >= (1000000000 / frac_scale))
+        {
+            skip_count++;  // (invalid timestamp)
+            continue;
+        }
+        record.data = hdr + PCAP_REC_HDR_LEN;
+        record.length = captureLen;
+        record.orig_length = Get32(hdr + 12);
+        record.sec = Get32(hdr);
+        record.nsec = frac * frac_scale;
+        record.link_type = link_type;
+        record.iface = 0;
+        return true;
+    }
+    return false;
+}  // end ProtoPcapAnalyzer::NextPcapRecord()
+
+bool ProtoPcapAnalyzer::NextPcapNGRecord(Record& record)
+{
+    while ((scan_offset + 12) <= file_size)
+    {
+        const char* block = file_buffer + scan_offset;
+        UINT32 type;
+        memcpy(&type, block, 4);
+        if (PCAPNG_SHB == type)
+        {
+            // (a new section may change the byte order)
+            if (!ParseSectionHeader(scan_offset))
+            {
+                PLOG(PL_ERROR, "ProtoPcapAnalyzer::NextRecord() error: invalid pcapng section header\n");
+                scan_offset = file_size;
+                return false;
+            }
+        }
+        else
+        {
+            type = Get32(block);
+        }
+        UINT32 blockLen = Get32(block + 4);
+        if ((blockLen < 12) || (0 != (blockLen & 0x03)) || ((scan_offset + blockLen) > file_size))
+        {
+            // (truncated or corrupt, so no further blocks can be found)
+            skip_count++;
+            scan_offset = file_size;
+            return false;
+        }
+        scan_offset += blockLen;
+        const char* body = block + 8;
+        unsigned int bodyLen = blockLen - 12;
+        UINT32 ifaceId = 0;
+        uint64_t timestamp = 0;
+        UINT32 captureLen, origLen;
+        const char* data;
+        switch (type)
+        {
+            case PCAPNG_IDB:
+                ParseInterface(body, bodyLen);
+                continue;
+            case PCAPNG_EPB:
+                if (bodyLen < 20) {skip_count++; continue;}
+                ifaceId = Get32(body);
+                timestamp = ((uint64_t)Get32(body + 4) << 32) | Get32(body + 8);
+                captureLen = Get32(body + 12);
+                origLen = Get32(body + 16);
+                data = body + 20;
+                bodyLen -= 20;
+                break;
+            case PCAPNG_PB:
+                if (bodyLen < 20) {skip_count++; continue;}
+                ifaceId = Get16(body);
+                timestamp = ((uint64_t)Get32(body + 4) << 32) | Get32(body + 8);
+                captureLen = Get32(body + 12);
+                origLen = Get32(body + 16);
+                data = body + 20;
+                bodyLen -= 20;
+                break;
+            case PCAPNG_SPB:
+                if (bodyLen < 4) {skip_count++; continue;}
+                origLen = Get32(body);
+                data = body + 4;
+                bodyLen -= 4;
+                captureLen = (origLen < bodyLen) ? origLen : bodyLen;
+                break;
+            default:
+                continue;  // (other block types are ignored)
+        }
+        if ((captureLen > bodyLen) || (ifaceId >= iface_count) || (ifaceId >= INTERFACE_MAX) ||
+            (0 == iface_list[ifaceId].units_per_sec))
+        {
+            skip_count++;
+            continue;
+        }
+        const Interface& iface = iface_list[ifaceId];
+        // Convert the timestamp (in interface resolution units) to seconds and nanoseconds
+        uint64_t unitsPerSec = iface.units_per_sec;
+        uint64_t sec = timestamp / unitsPerSec;
+        uint64_t frac = timestamp - (sec * unitsPerSec);
+        record.data = data;
+        record.length = captureLen;
+        record.orig_length = origLen;
+        record.sec = (UINT32)sec;
+        record.nsec = (UINT32)((double)frac * 1.0e+09 / (double)unitsPerSec);
+        if (record.nsec > 999999999) record.nsec = 999999999;
+        record.link_type = iface.link_type;
+        record.iface = (UINT16)ifaceId;
+        return true;
+    }
+    return false;
+}  // end ProtoPcapAnalyzer::NextPcapNGRecord()
+
+bool ProtoPcapAnalyzer::CreateChunks(unsigned int chunkMax)
+{
+    DestroyChunks();
+    if (NULL == (chunk_list = new Chunk[chunkMax]))
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Run() new chunk_list error: %s\n", GetErrorString());
+        return false;
+    }
+    memset(chunk_list, 0, chunkMax * sizeof(Chunk));
+    chunk_max = chunkMax;
+    for (unsigned int i = 0; i < chunkMax; i++)
+    {
+        Chunk& chunk = chunk_list[i];
+        chunk.state = CHUNK_EMPTY;
+        if ((NULL == (chunk.record_list = new Record[chunk_record_max])) ||
+            (NULL == (chunk.desc_list = new ProtoDissector::Descriptor[chunk_record_max])) ||
+            (NULL == (chunk.worker_list = new UINT8[chunk_record_max])) ||
+            (ordered_output && (NULL == (chunk.output_list = new Worker::OutputBuffer[worker_count]))))
+        {
+            PLOG(PL_ERROR, "ProtoPcapAnalyzer::Run() new chunk error: %s\n", GetErrorString());
+            DestroyChunks();
+            return false;
+        }
+    }
+    return true;
+}  // end ProtoPcapAnalyzer::CreateChunks()
+
+void ProtoPcapAnalyzer::DestroyChunks()
+{
+    if (NULL == chunk_list) return;
+    for (unsigned int i = 0; i < chunk_max; i++)
+    {
+        Chunk& chunk = chunk_list[i];
+        delete[] chunk.output_list;
+        delete[] chunk.worker_list;
+        delete[] chunk.desc_list;
+        delete[] chunk.record_list;
+    }
+    delete[] chunk_list;
+    chunk_list = NULL;
+    chunk_max = 0;
+}  // end ProtoPcapAnalyzer::DestroyChunks()
+
+// Scans the next records into "chunk" (called by the Run() thread only)
+void ProtoPcapAnalyzer::FillChunk(Chunk& chunk)
+{
+    unsigned int count = 0;
+    size_t startOffset = scan_offset;
+    while ((count < chunk_record_max) && ((scan_offset - startOffset) < chunk_size))
+    {
+        Record& record = chunk.record_list[count];
+        if (!NextRecord(record)) break;
+#ifdef __GNUC__
+        __builtin_prefetch(record.data, 0, 0);
+#endif // __GNUC__
+        byte_count += record.length;
+        count++;
+    }
+    chunk.count = count;
+    chunk.first_index = packet_count;
+    packet_count += count;
+}  // end ProtoPcapAnalyzer::FillChunk()
+
+static inline bool GetDissectorLinkType(unsigned int linkType, ProtoDissector::LinkType& dissectorType)
+{
+    switch (linkType)
+    {
+        case ProtoDissector::LINK_ETHERNET:
+        case ProtoDissector::LINK_RAW:
+        case ProtoDissector::LINK_LINUX_SLL:
+            dissectorType = (ProtoDissector::LinkType)linkType;
+            return true;
+        case 228:  // LINKTYPE_IPV4
+        case 229:  // LINKTYPE_IPV6
+            dissectorType = ProtoDissector::LINK_RAW;
+            return true;
+        default:
+            return false;
+    }
+}  // end GetDissectorLinkType()
+
+void ProtoPcapAnalyzer::DissectRecords(const Record*                 recordList,
+                                       unsigned int                  count,
+                                       ProtoDissector::Descriptor*   descList)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        ProtoDissector::LinkType linkType;
+        if (GetDissectorLinkType(recordList[i].link_type, linkType))
+            ProtoDissector::Dissect(linkType, recordList[i].data, recordList[i].length, descList[i]);
+        else
+            memset(descList + i, 0, sizeof(ProtoDissector::Descriptor));
+    }
+}  // end ProtoPcapAnalyzer::DissectRecords()
+
+// Dissects the chunk's packets and assigns each to a worker by hash
+void ProtoPcapAnalyzer::ClassifyChunk(Chunk& chunk)
+{
+    DissectRecords(chunk.record_list, chunk.count, chunk.desc_list);
+    bool usePorts = (AFFINITY_FLOW == affinity);
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        const ProtoDissector::Descriptor& desc = chunk.desc_list[i];
+        UINT32 hash = 0;
+        if (desc.HasL3())
+        {
+            // (symmetric, so both directions of a flow hash the same)
+            unsigned int words = desc.GetAddrLength() >> 2;
+            hash = ProtoHash::Words(desc.GetSrcAddrPtr(), words) + ProtoHash::Words(desc.GetDstAddrPtr(), words);
+            hash ^= desc.GetProtocol();
+            if (usePorts && !desc.IsFragment())
+                hash += ProtoHash::Final(desc.GetSrcPort() + 0x9e3779b9) + ProtoHash::Final(desc.GetDstPort() + 0x9e3779b9);
+            hash = ProtoHash::Final(hash);
+        }
+        chunk.worker_list[i] = (UINT8)(hash % worker_count);
+    }
+}  // end ProtoPcapAnalyzer::ClassifyChunk()
+
+
+void ProtoPcapAnalyzer::ProcessChunk(Worker& worker, Chunk& chunk, bool dissect)
+{
+    if (dissect) DissectRecords(chunk.record_list, chunk.count, chunk.desc_list);
+    bool output = (NULL != listener) && listener->has_output();
+    if (output)
+        worker.output = ordered_output ? (chunk.output_list + worker.index) : &worker.local_output;
+    bool all = (AFFINITY_NONE == affinity);
+    Packet packet;
+    for (unsigned int i = 0; i < chunk.count; i++)
+    {
+        if (!all && (worker.index != chunk.worker_list[i])) continue;
+        packet.record = chunk.record_list + i;
+        packet.desc = chunk.desc_list + i;
+        packet.index = chunk.first_index + i;
+        worker.pkt_index = i;
+        worker.packet_count++;
+        worker.byte_count += packet.record->length;
+        if (NULL != listener) listener->on_packet(worker, packet);
+    }
+    worker.output = NULL;
+    if (output && !ordered_output) FlushOutput(worker.local_output);
+}  // end ProtoPcapAnalyzer::ProcessChunk()
+
+// Delivers (unordered) worker output
+void ProtoPcapAnalyzer::FlushOutput(Worker::OutputBuffer& outputBuffer)
+{
+    if (0 == outputBuffer.length) return;
+    output_mutex.Lock();
+    unsigned int offset = 0;
+    while (offset < outputBuffer.length)
+    {
+        UINT32 length;
+        memcpy(&length, outputBuffer.buffer + offset + sizeof(UINT32), sizeof(UINT32));
+        offset += 2*sizeof(UINT32);
+        Deliver(outputBuffer.buffer + offset, length);
+        offset += length;
+    }
+    output_mutex.Unlock();
+    outputBuffer.Reset();
+}  // end ProtoPcapAnalyzer::FlushOutput()
+
+// Waits for all workers to finish with the chunk and delivers its (ordered) output
+void ProtoPcapAnalyzer::ReleaseChunk(Chunk& chunk)
+{
+    mutex.Lock();
+    while (0 != chunk.pending)
+        done_cond.Wait(mutex);
+    chunk.state = CHUNK_EMPTY;
+    mutex.Unlock();
+    if (NULL == chunk.output_list) return;
+    // Merge the workers' output (each in packet order) by packet index
+    unsigned int offsetList[WORKER_MAX];
+    memset(offsetList, 0, sizeof(offsetList));
+    while (true)
+    {
+        Worker::OutputBuffer* next = NULL;
+        UINT32 nextIndex = 0;
+        unsigned int nextWorker = 0;
+        for (unsigned int w = 0; w < worker_count; w++)
+        {
+            Worker::OutputBuffer& outputBuffer = chunk.output_list[w];
+            if (offsetList[w] >= outputBuffer.length) continue;
+            UINT32 pktIndex;
+            memcpy(&pktIndex, outputBuffer.buffer + offsetList[w], sizeof(UINT32));
+            if ((NULL == next) || (pktIndex < nextIndex))
+            {
+                next = &outputBuffer;
+                nextIndex = pktIndex;
+                nextWorker = w;
+            }
+        }
+        if (NULL == next) break;
+        // (deliver all of this worker's output for this packet)
+        unsigned int& offset = offsetList[nextWorker];
+        UINT32 pktIndex = nextIndex;
+        while ((offset < next->length) && (pktIndex == nextIndex))
+        {
+            UINT32 length;
+            memcpy(&length, next->buffer + offset + sizeof(UINT32), sizeof(UINT32));
+            Deliver(next->buffer + offset + 2*sizeof(UINT32), length);
+            offset += 2*sizeof(UINT32) + length;
+            if (offset < next->length)
+                memcpy(&pktIndex, next->buffer + offset, sizeof(UINT32));
+        }
+    }
+    for (unsigned int w = 0; w < worker_count; w++)
+        chunk.output_list[w].Reset();
+}  // end ProtoPcapAnalyzer::ReleaseChunk()
+
+int ProtoPcapAnalyzer::RunWorker(Worker& worker)
+{
+    bool dissect = (AFFINITY_NONE == affinity);
+    while (true)
+    {
+        mutex.Lock();
+        unsigned long seq = dissect ? take_seq : worker.next_chunk;
+        while ((seq == fill_seq) && !scan_done)
+        {
+            work_cond.Wait(mutex);
+            seq = dissect ? take_seq : worker.next_chunk;
+        }
+        if (seq == fill_seq)
+        {
+            mutex.Unlock();
+            break;  // (all done)
+        }
+        Chunk& chunk = GetChunk(seq);
+        if (dissect)
+        {
+            take_seq++;
+        }
+        else
+        {
+            worker.next_chunk++;
+            // The first worker to reach the chunk classifies it
+            while (CHUNK_READY != chunk.state)
+            {
+                if (CHUNK_FILLED == chunk.state)
+                {
+                    chunk.state = CHUNK_CLASSIFYING;
+                    mutex.Unlock();
+                    ClassifyChunk(chunk);
+                    mutex.Lock();
+                    chunk.state = CHUNK_READY;
+                    work_cond.Broadcast();
+                }
+                else
+                {
+                    work_cond.Wait(mutex);
+                }
+            }
+        }
+        mutex.Unlock();
+        ProcessChunk(worker, chunk, dissect);
+        mutex.Lock();
+        if (0 == --chunk.pending) done_cond.Signal();
+        mutex.Unlock();
+    }
+    return 0;
+}  // end ProtoPcapAnalyzer::RunWorker()
+
+bool ProtoPcapAnalyzer::Run(unsigned int numWorkers)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoPcapAnalyzer::Run() error: no file open\n");
+        return false;
+    }
+    if (0 == numWorkers) numWorkers = 1;
+    if (numWorkers > WORKER_MAX) numWorkers = WORKER_MAX;
+    for (unsigned int i = 0; i < worker_count; i++)
+        delete worker_list[i];
+    worker_count = 0;
+    for (unsigned int i = 0; i < numWorkers; i++)
+    {
+        if (NULL == (worker_list[i] = new Worker(*this, i)))
+        {
+            PLOG(PL_ERROR, "ProtoPcapAnalyzer::Run() new worker error: %s\n", GetErrorString());
+            return false;
+        }
+        worker_count++;
+    }
+    // A few chunks per worker are kept in flight
+    if (!CreateChunks(4 * numWorkers)) return false;
+    Rewind();
+    fill_seq = take_seq = 0;
+    scan_done = false;
+    packet_count = byte_count = skip_count = chunk_count = 0;
+
+    unsigned int started = 0;
+    for (; started < worker_count; started++)
+    {
+        if (!worker_list[started]->thread.StartThread())
+        {
+            PLOG(PL_ERROR, "ProtoPcapAnalyzer::Run() error: unable to start worker thread\n");
+            break;
+        }
+    }
+    bool result = (started == worker_count);
+    unsigned long releaseSeq = 0;
+    if (result)
+    {
+        unsigned int pending = (AFFINITY_NONE == affinity) ? 1 : worker_count;
+        while (true)
+        {
+            if ((fill_seq - releaseSeq) == chunk_max)
+                ReleaseChunk(GetChunk(releaseSeq++));  // (oldest chunk slot is reused)
+            Chunk& chunk = GetChunk(fill_seq);
+            FillChunk(chunk);
+            if (0 == chunk.count) break;
+            chunk_count++;
+            mutex.Lock();
+            chunk.state = CHUNK_FILLED;
+            chunk.pending = pending;
+            fill_seq++;
+            work_cond.Broadcast();
+            mutex.Unlock();
+        }
+    }
+    mutex.Lock();
+    scan_done = true;
+    work_cond.Broadcast();
+    mutex.Unlock();
+    while (releaseSeq < fill_seq)
+        ReleaseChunk(GetChunk(releaseSeq++));
+    for (unsigned int i = 0; i < started; i++)
+        worker_list[i]->thread.StopThread();  // (joins the thread)
+    DestroyChunks();
+    return result;
+}  // end ProtoPcapAnalyzer::Run()
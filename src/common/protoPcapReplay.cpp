@@ -0,0 +1,523 @@
+#include "protoPcapReplay.h"
+#include "protoDissector.h"
+#include "protoPktETH.h"
+#include "protoPktIP.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy()
+
+// Classic pcap file format constants
+// (see https://www.tcpdump.org/manpages/pcap-savefile.5.html)
+static const UINT32 PCAP_MAGIC_USEC = 0xa1b2c3d4;
+static const UINT32 PCAP_MAGIC_NSEC = 0xa1b23c4d;
+static const unsigned int PCAP_FILE_HDR_LEN = 24;
+static const unsigned int PCAP_REC_HDR_LEN = 16;
+enum PcapLinkType
+{
+    LINKTYPE_ETHERNET   = 1,
+    LINKTYPE_RAW        = 101,
+    LINKTYPE_LINUX_SLL  = 113
+};
+
+// Interval used to retry a ProtoCap whose transmit buffer is full
+static const double REPLAY_BLOCKED_INTERVAL = 1.0e-03;
+
+static inline UINT32 PcapGet32(const char* ptr, bool swap)
+{
+    UINT32 value;
+    memcpy(&value, ptr, 4);
+    if (swap)
+        value = ((value & 0x000000ff) << 24) | ((value & 0x0000ff00) << 8) |
+                ((value & 0x00ff0000) >> 8) | ((value & 0xff000000) >> 24);
+    return value;
+}  // end PcapGet32()
+
+static inline UINT16 GetNet16(const void* ptr)
+{
+    const UINT8* bytes = (const UINT8*)ptr;
+    return (UINT16)((bytes[0] << 8) | bytes[1]);
+}  // end GetNet16()
+
+// Length of a record converted to an Ethernet frame (link header replaced)
+static inline unsigned int GetFrameLength(UINT32 captureLen, unsigned int linkHdrLen)
+{
+    return (captureLen - linkHdrLen + 14);
+}  // end GetFrameLength()
+
+// Incrementally updates a 16-bit one's complement checksum for a change
+// of "numBytes" (even) of data from "oldData" to "newData" (RFC 1624, eqn. 3)
+static UINT16 ChecksumAdjust(UINT16 checksum, const void* oldData, const void* newData, unsigned int numBytes)
+{
+    UINT32 sum = (UINT16)~checksum;
+    for (unsigned int i = 0; i < numBytes; i += 2)
+    {
+        sum += (UINT16)~GetNet16((const UINT8*)oldData + i);
+        sum += GetNet16((const UINT8*)newData + i);
+    }
+    while (0 != (sum >> 16))
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (UINT16)~sum;
+}  // end ChecksumAdjust()
+
+ProtoPcapReplay::ProtoPcapReplay(ProtoTimerMgr& timerMgr)
+ : timer_mgr(timerMgr), listener(NULL), cap(NULL),
+   frame_buffer(NULL), frame_list(NULL), frame_count(0), skip_count(0),
+   speed(1.0), batch_size(DEFAULT_BATCH_SIZE), frame_index(0),
+   sent_frames(0), sent_bytes(0), error_count(0), max_lateness(0.0)
+{
+    replay_timer.SetListener(this, &ProtoPcapReplay::OnReplayTimeout);
+    replay_timer.SetInterval(0.0);
+    replay_timer.SetRepeat(-1);
+}
+
+ProtoPcapReplay::~ProtoPcapReplay()
+{
+    Unload();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+bool ProtoPcapReplay::Load(const char* fileName)
+{
+    FILE* filePtr = stdin;
+    if ((NULL != fileName) && (NULL == (filePtr = fopen(fileName, "rb"))))
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() fopen(%s) error: %s\n", fileName, GetErrorString());
+        return false;
+    }
+    bool result = Load(filePtr);
+    if (stdin != filePtr) fclose(filePtr);
+    return result;
+}  // end ProtoPcapReplay::Load(fileName)
+
+bool ProtoPcapReplay::Load(FILE* filePtr)
+{
+    Unload();
+    // 1) Read the entire capture into memory
+    char* fileBuffer = NULL;
+    size_t bufferSize = 0;
+    size_t fileSize = 0;
+    for (;;)
+    {
+        if (fileSize == bufferSize)
+        {
+            size_t newSize = (0 != bufferSize) ? (2 * bufferSize) : (1 << 20);
+            char* newBuffer;
+            if (NULL == (newBuffer = new char[newSize]))
+            {
+                PLOG(PL_ERROR, "ProtoPcapReplay::Load() new file buffer error: %s\n", GetErrorString());
+                if (NULL != fileBuffer) delete[] fileBuffer;
+                return false;
+            }
+            if (NULL != fileBuffer)
+            {
+                memcpy(newBuffer, fileBuffer, fileSize);
+                delete[] fileBuffer;
+            }
+            fileBuffer = newBuffer;
+            bufferSize = newSize;
+        }
+        size_t result = fread(fileBuffer + fileSize, 1, bufferSize - fileSize, filePtr);
+        if (0 == result)
+        {
+            if (0 != ferror(filePtr))
+            {
+                PLOG(PL_ERROR, "ProtoPcapReplay::Load() fread() error: %s\n", GetErrorString());
+                delete[] fileBuffer;
+                return false;
+            }
+            break;
+        }
+        fileSize += result;
+    }
+
+    // 2) Validate the file header
+    bool swap = false;
+    double fracScale = 1.0e-06;
+    UINT32 magic = (fileSize >= PCAP_FILE_HDR_LEN) ? PcapGet32(fileBuffer, false) : 0;
+    if ((PCAP_MAGIC_USEC != magic) && (PCAP_MAGIC_NSEC != magic))
+    {
+        swap = true;
+        magic = PcapGet32(fileBuffer, true);
+    }
+    if (PCAP_MAGIC_NSEC == magic)
+    {
+        fracScale = 1.0e-09;
+    }
+    else if (PCAP_MAGIC_USEC != magic)
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() error: not a (classic) pcap file\n");
+        delete[] fileBuffer;
+        return false;
+    }
+    unsigned int linkType = PcapGet32(fileBuffer + 20, swap) & 0x0000ffff;
+    unsigned int linkHdrLen;
+    switch (linkType)
+    {
+        case LINKTYPE_ETHERNET:
+            linkHdrLen = 14;
+            break;
+        case LINKTYPE_LINUX_SLL:
+            linkHdrLen = 16;
+            break;
+        case LINKTYPE_RAW:
+            linkHdrLen = 0;
+            break;
+        default:
+            PLOG(PL_ERROR, "ProtoPcapReplay::Load() error: unsupported link type %u\n", linkType);
+            delete[] fileBuffer;
+            return false;
+    }
+
+    // 3) Size the frame index and buffer.  Frames are stored as Ethernet
+    //    frames starting at offset 2 (mod 4) so that IP headers are aligned,
+    //    so each frame takes up to its length plus 5 bytes (see step 4).
+    unsigned int recordCount = 0;
+    size_t frameBytes = 2;
+    size_t offset = PCAP_FILE_HDR_LEN;
+    while ((offset + PCAP_REC_HDR_LEN) <= fileSize)
+    {
+        UINT32 captureLen = PcapGet32(fileBuffer + offset + 8, swap);
+        offset += PCAP_REC_HDR_LEN;
+        if (captureLen > (fileSize - offset)) break;  // truncated file
+        offset += captureLen;
+        recordCount++;
+        if (captureLen > linkHdrLen)
+            frameBytes += GetFrameLength(captureLen, linkHdrLen) + 5;
+    }
+    if (0 == recordCount)
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() error: empty pcap file\n");
+        delete[] fileBuffer;
+        return false;
+    }
+    if (NULL == (frame_list = new Frame[recordCount]))
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() new frame_list error: %s\n", GetErrorString());
+        delete[] fileBuffer;
+        return false;
+    }
+    if (NULL == (frame_buffer = new UINT32[(frameBytes + 3) / 4]))
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() new frame_buffer error: %s\n", GetErrorString());
+        delete[] frame_list;
+        frame_list = NULL;
+        delete[] fileBuffer;
+        return false;
+    }
+
+    // 4) Copy each record into the frame buffer as an Ethernet frame
+    //    and compute its transmit time relative to the first frame
+    char* ptr = (char*)frame_buffer;
+    UINT32 frameOffset = 2;
+    UINT32 firstSec = 0;
+    double firstFrac = 0.0;
+    double lastTime = 0.0;
+    offset = PCAP_FILE_HDR_LEN;
+    for (unsigned int i = 0; i < recordCount; i++)
+    {
+        const char* rec = fileBuffer + offset;
+        UINT32 sec = PcapGet32(rec, swap);
+        double frac = fracScale * (double)PcapGet32(rec + 4, swap);
+        UINT32 captureLen = PcapGet32(rec + 8, swap);
+        UINT32 originalLen = PcapGet32(rec + 12, swap);
+        const char* data = rec + PCAP_REC_HDR_LEN;
+        offset += PCAP_REC_HDR_LEN + captureLen;
+        // Skip records that were truncated by the capture snap length
+        // or are too short to hold the link (and Ethernet) header
+        if ((captureLen < originalLen) || (captureLen <= linkHdrLen))
+        {
+            skip_count++;
+            continue;
+        }
+        char* frame = ptr + frameOffset;
+        unsigned int frameLength = GetFrameLength(captureLen, linkHdrLen);
+        UINT16 type = 0;
+        switch (linkType)
+        {
+            case LINKTYPE_ETHERNET:
+                memcpy(frame, data, captureLen);
+                type = GetNet16(data + 12);
+                break;
+            case LINKTYPE_LINUX_SLL:
+                // (dst MAC unknown, src MAC is the SLL link-layer address)
+                memset(frame, 0, 12);
+                memcpy(frame + 6, data + 6, 6);
+                memcpy(frame + 12, data + 14, 2);
+                memcpy(frame + 14, data + 16, captureLen - 16);
+                type = GetNet16(data + 14);
+                break;
+            case LINKTYPE_RAW:
+                memset(frame, 0, 12);
+                switch (((const UINT8*)data)[0] >> 4)
+                {
+                    case 4:
+                        type = ProtoPktETH::IP;
+                        break;
+                    case 6:
+                        type = ProtoPktETH::IPv6;
+                        break;
+                }
+                frame[12] = (char)(type >> 8);
+                frame[13] = (char)(type & 0xff);
+                memcpy(frame + 14, data, captureLen);
+                break;
+        }
+        // 802.3 frames (type field is a length) are not supported by ProtoCap
+        if (type <= 0x05dc)
+        {
+            skip_count++;
+            continue;
+        }
+        double time;
+        if (0 == frame_count)
+        {
+            firstSec = sec;
+            firstFrac = frac;
+            time = 0.0;
+        }
+        else
+        {
+            time = (double)(INT32)(sec - firstSec) + (frac - firstFrac);
+            if (time < lastTime) time = lastTime;  // keep the schedule monotonic
+        }
+        lastTime = time;
+        Frame& f = frame_list[frame_count++];
+        f.offset = frameOffset;
+        f.length = frameLength;
+        f.time = time;
+        frameOffset = ((frameOffset + frameLength + 3) & ~((UINT32)3)) + 2;
+    }
+    delete[] fileBuffer;
+    if (0 != skip_count)
+        PLOG(PL_WARN, "ProtoPcapReplay::Load() warning: skipped %u unsupported or truncated frames\n", skip_count);
+    if (0 == frame_count)
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Load() error: no supported frames in pcap file\n");
+        Unload();
+        return false;
+    }
+    return true;
+}  // end ProtoPcapReplay::Load(filePtr)
+
+void ProtoPcapReplay::Unload()
+{
+    Stop();
+    if (NULL != frame_list)
+    {
+        delete[] frame_list;
+        frame_list = NULL;
+    }
+    if (NULL != frame_buffer)
+    {
+        delete[] frame_buffer;
+        frame_buffer = NULL;
+    }
+    frame_count = skip_count = 0;
+}  // end ProtoPcapReplay::Unload()
+
+bool ProtoPcapReplay::Start(ProtoCap& theCap)
+{
+    if (!IsLoaded())
+    {
+        PLOG(PL_ERROR, "ProtoPcapReplay::Start() error: no capture loaded\n");
+        return false;
+    }
+    Stop();
+    cap = &theCap;
+    Rewrite();
+    frame_index = 0;
+    sent_frames = sent_bytes = error_count = 0;
+    max_lateness = 0.0;
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    start_time = currentTime;
+    replay_timer.SetInterval(0.0);
+    timer_mgr.ActivateTimer(replay_timer);
+    return true;
+}  // end ProtoPcapReplay::Start()
+
+void ProtoPcapReplay::Stop()
+{
+    if (replay_timer.IsActive()) replay_timer.Deactivate();
+}  // end ProtoPcapReplay::Stop()
+
+double ProtoPcapReplay::GetElapsedTime()
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    return ProtoTime::Delta(ProtoTime(currentTime), start_time);
+}  // end ProtoPcapReplay::GetElapsedTime()
+
+void ProtoPcapReplay::Rewrite()
+{
+    if (!dst_mac.IsValid() && !cap->GetInterfaceAddr().IsValid() &&
+        !dst_addr.IsValid() && !src_addr.IsValid()) return;
+    char* ptr = (char*)frame_buffer;
+    for (unsigned int i = 0; i < frame_count; i++)
+        RewriteFrame(ptr + frame_list[i].offset, frame_list[i].length);
+}  // end ProtoPcapReplay::Rewrite()
+
+// Note rewriting is done relative to the current frame content, so it may
+// be safely repeated (e.g., for a subsequent Start() with new addresses)
+void ProtoPcapReplay::RewriteFrame(char* frameBuffer, unsigned int frameLength)
+{
+    ProtoPktETH ethPkt((UINT16*)frameBuffer, frameLength);
+    if (!ethPkt.InitFromBuffer(frameLength)) return;
+    if (dst_mac.IsValid()) ethPkt.SetDstAddr(dst_mac);
+    // Use our interface MAC as source (as ProtoCap::Forward() does)
+    if (cap->GetInterfaceAddr().IsValid()) ethPkt.SetSrcAddr(cap->GetInterfaceAddr());
+    if (!dst_addr.IsValid() && !src_addr.IsValid()) return;
+
+    ProtoDissector::Descriptor desc;
+    if (!ProtoDissector::Dissect(ProtoDissector::LINK_ETHERNET, frameBuffer, frameLength, desc)) return;
+    unsigned int addrLen = desc.GetAddrLength();
+    ProtoAddress::Type addrType = (16 == addrLen) ? ProtoAddress::IPv6 : ProtoAddress::IPv4;
+    if ((addrType != dst_addr.GetType()) && dst_addr.IsValid()) return;
+    if ((addrType != src_addr.GetType()) && src_addr.IsValid()) return;
+    UINT8* ipPtr = (UINT8*)frameBuffer + desc.GetL3Offset();
+    UINT8* dstPtr = ipPtr + ((4 == addrLen) ? 16 : 24);
+    UINT8* srcPtr = ipPtr + ((4 == addrLen) ? 12 : 8);
+
+    // Locate the UDP or TCP header (if any) for pseudo-header checksum and port rewriting
+    UINT8* l4Ptr = NULL;            // start of UDP/TCP header
+    unsigned int l4ChecksumOffset = 0;
+    bool l4HasChecksum = false;
+    if (desc.HasL4() && !desc.IsTruncated())
+    {
+        switch (desc.GetProtocol())
+        {
+            case ProtoPktIP::UDP:
+                l4Ptr = (UINT8*)frameBuffer + desc.GetL4Offset();
+                l4ChecksumOffset = 6;
+                l4HasChecksum = (0 != GetNet16(l4Ptr + 6));  // (zero means no IPv4 UDP checksum)
+                break;
+            case ProtoPktIP::TCP:
+                l4Ptr = (UINT8*)frameBuffer + desc.GetL4Offset();
+                l4ChecksumOffset = 16;
+                l4HasChecksum = true;
+                break;
+            default:
+                break;
+        }
+    }
+    UINT16 l4Checksum = (NULL != l4Ptr) ? GetNet16(l4Ptr + l4ChecksumOffset) : 0;
+    UINT16 ipChecksum = (4 == addrLen) ? GetNet16(ipPtr + 10) : 0;
+
+    const ProtoAddress* addrList[2] = {&dst_addr, &src_addr};
+    UINT8* addrPtrList[2] = {dstPtr, srcPtr};
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        const ProtoAddress& addr = *addrList[i];
+        if (!addr.IsValid()) continue;
+        const char* newAddr = addr.GetRawHostAddress();
+        if (0 != memcmp(addrPtrList[i], newAddr, addrLen))
+        {
+            if (4 == addrLen)
+                ipChecksum = ChecksumAdjust(ipChecksum, addrPtrList[i], newAddr, addrLen);
+            if (l4HasChecksum)
+                l4Checksum = ChecksumAdjust(l4Checksum, addrPtrList[i], newAddr, addrLen);
+            memcpy(addrPtrList[i], newAddr, addrLen);
+        }
+        UINT16 port = addr.GetPort();
+        if ((0 != port) && (NULL != l4Ptr))
+        {
+            // Destination port at offset 2, source port at offset 0 (UDP and TCP)
+            UINT8* portPtr = l4Ptr + ((0 == i) ? 2 : 0);
+            UINT8 newPort[2] = {(UINT8)(port >> 8), (UINT8)(port & 0xff)};
+            if (l4HasChecksum)
+                l4Checksum = ChecksumAdjust(l4Checksum, portPtr, newPort, 2);
+            memcpy(portPtr, newPort, 2);
+        }
+    }
+    if (4 == addrLen)
+    {
+        ipPtr[10] = (UINT8)(ipChecksum >> 8);
+        ipPtr[11] = (UINT8)(ipChecksum & 0xff);
+    }
+    if (l4HasChecksum)
+    {
+        // A computed UDP checksum of zero is transmitted as all ones
+        if ((0 == l4Checksum) && (6 == l4ChecksumOffset)) l4Checksum = 0xffff;
+        l4Ptr[l4ChecksumOffset] = (UINT8)(l4Checksum >> 8);
+        l4Ptr[l4ChecksumOffset + 1] = (UINT8)(l4Checksum & 0xff);
+    }
+}  // end ProtoPcapReplay::RewriteFrame()
+
+void ProtoPcapReplay::OnReplayTimeout(ProtoTimer& /*theTimer*/)
+{
+    bool topSpeed = (speed <= 0.0);
+    double elapsed = GetElapsedTime();
+    const char* ptr = (const char*)frame_buffer;
+    // The number of frames handled per timeout is limited
+    // so other dispatcher activity is not starved
+    unsigned int frameLimit = frame_index + BATCH_MAX;
+    if (frameLimit > frame_count) frameLimit = frame_count;
+    bool blocked = false;
+    while (frame_index < frameLimit)
+    {
+        // Gather the frames that are due into a batch
+        unsigned int count = 0;
+        while ((count < batch_size) && ((frame_index + count) < frameLimit))
+        {
+            const Frame& frame = frame_list[frame_index + count];
+            if (!topSpeed)
+            {
+                double lateness = elapsed - frame.time / speed;
+                if (lateness < 0.0) break;  // not yet due
+                if (lateness > max_lateness) max_lateness = lateness;
+            }
+            batch_buffer[count] = ptr + frame.offset;
+            batch_length[count] = frame.length;
+            count++;
+        }
+        if (0 == count) break;
+        unsigned int sent = cap->SendBatch(batch_buffer, batch_length, count);
+        for (unsigned int i = 0; i < sent; i++)
+            sent_bytes += batch_length[i];
+        sent_frames += sent;
+        frame_index += sent;
+        if (sent < count)
+        {
+            // Send() the frame that stopped the batch to
+            // distinguish a full transmit buffer from an error
+            unsigned int numBytes = batch_length[sent];
+            if (cap->Send(batch_buffer[sent], numBytes))
+            {
+                sent_frames++;
+                sent_bytes += numBytes;
+            }
+            else if (0 == numBytes)
+            {
+                blocked = true;
+                break;
+            }
+            else
+            {
+                error_count++;
+            }
+            frame_index++;
+        }
+    }
+    if (frame_index >= frame_count)
+    {
+        replay_timer.Deactivate();
+        if (NULL != listener) listener->on_done(*this);
+        return;
+    }
+    // Schedule the next timeout for when the next frame is due
+    // (relative to the replay start time so errors do not accumulate)
+    double interval = 0.0;
+    if (!topSpeed)
+    {
+        interval = frame_list[frame_index].time / speed - GetElapsedTime();
+        if (interval < 0.0) interval = 0.0;
+    }
+    if (blocked && (interval < REPLAY_BLOCKED_INTERVAL))
+        interval = REPLAY_BLOCKED_INTERVAL;
+    replay_timer.SetInterval(interval);
+    replay_timer.Reschedule();
+}  // end ProtoPcapReplay::OnReplayTimeout()
@@ -16,6 +16,17 @@
 #include <sys/un.h>  // for unix domain sockets
 #include <sys/stat.h>
 #include <stdlib.h>  // for mkstemp()
+#include <stdio.h>   // for sprintf()
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>  // for memfd_create(), shm_open()
+#include <sys/uio.h>
+// (SCM_RIGHTS is saved for descriptor passing since it is also (mis)used
+//  below to detect "sun_len" and so NO_SCM_RIGHTS undefines it)
+#ifdef SCM_RIGHTS
+#define HAVE_PIPE_SCM_RIGHTS
+static const int PIPE_SCM_RIGHTS = SCM_RIGHTS;
+#endif // SCM_RIGHTS
 #ifdef NO_SCM_RIGHTS
 #undef SCM_RIGHTS
 #endif  // NO_SCM_RIGHTS
@@ -25,10 +36,11 @@
 ProtoPipe::ProtoPipe(Type theType)
  : ProtoSocket((MESSAGE == theType) ? UDP : TCP),
 #ifdef WIN32
-   named_event_handle(INVALID_HANDLE_VALUE)
+   named_event_handle(INVALID_HANDLE_VALUE),
 #else  // UNIX
-   unlink_tried(false)
+   unlink_tried(false),
 #endif // if/else WIN32/UNIX
+   pipe_type(theType)
 {
     domain = LOCAL;
     path[0] = '\0';
@@ -296,7 +308,8 @@ bool ProtoPipe::Open(const char* theName)
 #else
     size_t len = strlen(sockAddr.sun_path) + sizeof(sockAddr.sun_family);
 #endif // if/else SCM_RIGHTS    
-    int socketType = (UDP == protocol) ? SOCK_DGRAM : SOCK_STREAM;      
+    int socketType = (UDP == protocol) ? SOCK_DGRAM : 
+                        ((SEQPACKET == pipe_type) ? SOCK_SEQPACKET : SOCK_STREAM);      
     if ((handle = socket(AF_UNIX, socketType, 0)) < 0)
     {
         PLOG(PL_ERROR, "ProtoPipe::Open() socket() error: %s\n", GetErrorString());
@@ -499,4 +512,298 @@ bool ProtoPipe::Connect(const char* theName)
 }  // end ProtoPipe::Connect()
 
 
+#endif // if/else WIN32/UNIX
+
+// Batched message and descriptor passing I/O
+
+unsigned int ProtoPipe::SendBatch(unsigned int         count,
+                                  const char* const*   bufferList,
+                                  const unsigned int*  lengthList)
+{
+    if (STREAM == pipe_type)
+    {
+        PLOG(PL_ERROR, "ProtoPipe::SendBatch() error: not supported for STREAM pipes\n");
+        return 0;
+    }
+    if (!IsConnected())
+    {
+        PLOG(PL_ERROR, "ProtoPipe::SendBatch() error: unconnected pipe\n");
+        return 0;
+    }
+    unsigned int sent = 0;
+#ifdef LINUX
+    struct mmsghdr msgList[BATCH_MAX];
+    struct iovec iovList[BATCH_MAX];
+    while (sent < count)
+    {
+        unsigned int n = count - sent;
+        if (n > BATCH_MAX) n = BATCH_MAX;
+        memset(msgList, 0, n * sizeof(struct mmsghdr));
+        for (unsigned int i = 0; i < n; i++)
+        {
+            iovList[i].iov_base = (void*)bufferList[sent + i];
+            iovList[i].iov_len = lengthList[sent + i];
+            msgList[i].msg_hdr.msg_iov = iovList + i;
+            msgList[i].msg_hdr.msg_iovlen = 1;
+        }
+        int result = sendmmsg(handle, msgList, n, 0);
+        if (result < 0)
+        {
+            switch (errno)
+            {
+                case EINTR:
+                    continue;
+                case EAGAIN:
+                    break;
+                case ECONNRESET:
+                case ENOTCONN:
+                case EPIPE:
+                    OnNotify(NOTIFY_ERROR);
+                    break;
+                default:
+                    PLOG(PL_ERROR, "ProtoPipe::SendBatch() sendmmsg() error: %s\n", GetErrorString());
+                    break;
+            }
+            break;
+        }
+        sent += (unsigned int)result;
+        if ((unsigned int)result < n) break;  // would block
+    }
+#else
+    // One Send() per message where sendmmsg() is not available
+    while (sent < count)
+    {
+        unsigned int numBytes = lengthList[sent];
+        if (!Send(bufferList[sent], numBytes) || (numBytes != lengthList[sent]))
+            break;
+        sent++;
+    }
+#endif // if/else LINUX
+    return sent;
+}  // end ProtoPipe::SendBatch()
+
+unsigned int ProtoPipe::RecvBatch(unsigned int     maxCount,
+                                  char* const*     bufferList,
+                                  unsigned int*    lengthList)
+{
+    if (STREAM == pipe_type)
+    {
+        PLOG(PL_ERROR, "ProtoPipe::RecvBatch() error: not supported for STREAM pipes\n");
+        return 0;
+    }
+    if (!IsOpen()) return 0;
+    unsigned int received = 0;
+#ifdef LINUX
+    if (maxCount > BATCH_MAX) maxCount = BATCH_MAX;
+    struct mmsghdr msgList[BATCH_MAX];
+    struct iovec iovList[BATCH_MAX];
+    memset(msgList, 0, maxCount * sizeof(struct mmsghdr));
+    for (unsigned int i = 0; i < maxCount; i++)
+    {
+        iovList[i].iov_base = bufferList[i];
+        iovList[i].iov_len = lengthList[i];
+        msgList[i].msg_hdr.msg_iov = iovList + i;
+        msgList[i].msg_hdr.msg_iovlen = 1;
+    }
+    // (MSG_WAITFORONE so a blocking pipe returns once something is received)
+    int result;
+    while ((result = recvmmsg(handle, msgList, maxCount, MSG_WAITFORONE, NULL)) < 0)
+    {
+        if (EINTR == errno) continue;
+        if (EAGAIN != errno)
+        {
+            PLOG(PL_ERROR, "ProtoPipe::RecvBatch() recvmmsg() error: %s\n", GetErrorString());
+            if (ECONNRESET == errno) OnNotify(NOTIFY_ERROR);
+        }
+        return 0;
+    }
+    for (int i = 0; i < result; i++)
+    {
+        if (0 != (msgList[i].msg_hdr.msg_flags & MSG_TRUNC))
+            PLOG(PL_WARN, "ProtoPipe::RecvBatch() warning: message truncated\n");
+        lengthList[i] = msgList[i].msg_len;
+        if ((SEQPACKET == pipe_type) && (0 == lengthList[i]))
+        {
+            // Zero length means the SEQPACKET peer disconnected
+            if (0 == i) OnNotify(NOTIFY_NONE);
+            break;
+        }
+        received++;
+    }
+#else
+    while (received < maxCount)
+    {
+        unsigned int numBytes = lengthList[received];
+        if (!Recv(bufferList[received], numBytes) || (0 == numBytes)) break;
+        lengthList[received++] = numBytes;
+    }
+#endif // if/else LINUX
+    return received;
+}  // end ProtoPipe::RecvBatch()
+
+#ifdef WIN32
+
+bool ProtoPipe::SendDescriptors(const int*     /*fdList*/,
+                                unsigned int   /*fdCount*/,
+                                const char*    /*buffer*/,
+                                unsigned int   /*numBytes*/)
+{
+    PLOG(PL_ERROR, "ProtoPipe::SendDescriptors() error: not supported on WIN32\n");
+    return false;
+}  // end ProtoPipe::SendDescriptors()
+
+bool ProtoPipe::RecvDescriptors(int*           /*fdList*/,
+                                unsigned int&  fdCount,
+                                char*          /*buffer*/,
+                                unsigned int&  numBytes)
+{
+    PLOG(PL_ERROR, "ProtoPipe::RecvDescriptors() error: not supported on WIN32\n");
+    fdCount = numBytes = 0;
+    return false;
+}  // end ProtoPipe::RecvDescriptors()
+
+int ProtoPipe::CreateSharedMemory(unsigned int /*size*/, const char* /*name*/)
+{
+    PLOG(PL_ERROR, "ProtoPipe::CreateSharedMemory() error: not supported on WIN32\n");
+    return -1;
+}  // end ProtoPipe::CreateSharedMemory()
+
+#else
+
+bool ProtoPipe::SendDescriptors(const int*     fdList,
+                                unsigned int   fdCount,
+                                const char*    buffer,
+                                unsigned int   numBytes)
+{
+#ifdef HAVE_PIPE_SCM_RIGHTS
+    if ((0 == fdCount) || (fdCount > DESCRIPTOR_MAX))
+    {
+        PLOG(PL_ERROR, "ProtoPipe::SendDescriptors() error: invalid descriptor count %u\n", fdCount);
+        return false;
+    }
+    // (at least one byte of data must accompany the descriptors)
+    char byte = 0;
+    struct iovec iov;
+    iov.iov_base = (NULL != buffer) ? (void*)buffer : (void*)&byte;
+    iov.iov_len = (NULL != buffer) ? numBytes : 1;
+    char cmsgBuffer[CMSG_SPACE(DESCRIPTOR_MAX * sizeof(int))];
+    memset(cmsgBuffer, 0, sizeof(cmsgBuffer));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsgBuffer;
+    msg.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = PIPE_SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fdList, fdCount * sizeof(int));
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;  // (an EPIPE error instead of SIGPIPE)
+#else
+    int flags = 0;
+#endif // if/else MSG_NOSIGNAL
+    while (sendmsg(handle, &msg, flags) < 0)
+    {
+        if (EINTR == errno) continue;
+        PLOG(PL_ERROR, "ProtoPipe::SendDescriptors() sendmsg() error: %s\n", GetErrorString());
+        return false;
+    }
+    return true;
+#else
+    PLOG(PL_ERROR, "ProtoPipe::SendDescriptors() error: SCM_RIGHTS not supported\n");
+    return false;
+#endif // if/else HAVE_PIPE_SCM_RIGHTS
+}  // end ProtoPipe::SendDescriptors()
+
+bool ProtoPipe::RecvDescriptors(int*           fdList,
+                                unsigned int&  fdCount,
+                                char*          buffer,
+                                unsigned int&  numBytes)
+{
+#ifdef HAVE_PIPE_SCM_RIGHTS
+    char byte;
+    struct iovec iov;
+    iov.iov_base = (NULL != buffer) ? (void*)buffer : (void*)&byte;
+    iov.iov_len = (NULL != buffer) ? numBytes : 1;
+    char cmsgBuffer[CMSG_SPACE(DESCRIPTOR_MAX * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsgBuffer;
+    msg.msg_controllen = sizeof(cmsgBuffer);
+    unsigned int fdMax = fdCount;
+    fdCount = 0;
+    ssize_t result;
+    while ((result = recvmsg(handle, &msg, 0)) < 0)
+    {
+        if (EINTR == errno) continue;
+        numBytes = 0;
+        if (EAGAIN == errno) return true;
+        PLOG(PL_ERROR, "ProtoPipe::RecvDescriptors() recvmsg() error: %s\n", GetErrorString());
+        return false;
+    }
+    numBytes = (NULL != buffer) ? (unsigned int)result : 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if ((SOL_SOCKET != cmsg->cmsg_level) || (PIPE_SCM_RIGHTS != cmsg->cmsg_type)) continue;
+        unsigned int count = (unsigned int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        const int* fdPtr = (const int*)CMSG_DATA(cmsg);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (fdCount < fdMax)
+                fdList[fdCount++] = fdPtr[i];
+            else
+                close(fdPtr[i]);  // (no room, so don't leak it)
+        }
+    }
+    if (0 != (msg.msg_flags & MSG_CTRUNC))
+        PLOG(PL_WARN, "ProtoPipe::RecvDescriptors() warning: descriptors truncated\n");
+    if (0 == result) OnNotify(NOTIFY_NONE);  // (peer disconnected)
+    return true;
+#else
+    PLOG(PL_ERROR, "ProtoPipe::RecvDescriptors() error: SCM_RIGHTS not supported\n");
+    fdCount = numBytes = 0;
+    return false;
+#endif // if/else HAVE_PIPE_SCM_RIGHTS
+}  // end ProtoPipe::RecvDescriptors()
+
+int ProtoPipe::CreateSharedMemory(unsigned int size, const char* name)
+{
+    int fd;
+#if defined(LINUX) && defined(MFD_CLOEXEC)
+    if ((fd = memfd_create(name, MFD_CLOEXEC)) < 0)
+    {
+        PLOG(PL_ERROR, "ProtoPipe::CreateSharedMemory() memfd_create() error: %s\n", GetErrorString());
+        return -1;
+    }
+#else
+    // Use a uniquely named POSIX shared memory object, unlinked
+    // right away so only descriptor holders can reach it
+    static unsigned int shm_count = 0;
+    char shmName[64];
+    for (int attempts = 0; attempts < 16; attempts++)
+    {
+        sprintf(shmName, "/%.32s-%d-%u", name, (int)getpid(), shm_count++);
+        if ((fd = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0600)) >= 0) break;
+        if (EEXIST != errno) break;
+    }
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "ProtoPipe::CreateSharedMemory() shm_open() error: %s\n", GetErrorString());
+        return -1;
+    }
+    shm_unlink(shmName);
+#endif // if/else LINUX && MFD_CLOEXEC
+    if (0 != ftruncate(fd, size))
+    {
+        PLOG(PL_ERROR, "ProtoPipe::CreateSharedMemory() ftruncate() error: %s\n", GetErrorString());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}  // end ProtoPipe::CreateSharedMemory()
+
 #endif // if/else WIN32/UNIX
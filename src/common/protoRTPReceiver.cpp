@@ -0,0 +1,627 @@
+#include "protoRTPReceiver.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy()
+#include <math.h>    // for fmod()
+
+// RFC 3550 A.1 sequence number validation parameters
+static const UINT32 RTP_SEQ_MOD = 1 << 16;
+static const UINT16 MAX_DROPOUT = 3000;
+static const UINT16 MAX_MISORDER = 100;
+static const UINT32 MIN_SEQUENTIAL = 2;
+
+// Playout reference is reset if a packet arrives this much (seconds) later than predicted
+static const double RESYNC_THRESHOLD = 2.0;
+
+void ProtoRTPReceiver::Stream::InitSeq(UINT16 seq)
+{
+    base_seq = seq;
+    max_seq = seq;
+    bad_seq = RTP_SEQ_MOD + 1;  // (so seq == bad_seq is false)
+    cycles = 0;
+    received = 0;
+    received_prior = 0;
+    expected_prior = 0;
+}  // end ProtoRTPReceiver::Stream::InitSeq()
+
+// RFC 3550 A.1 update_seq(), returns false for packets not (yet) considered valid
+bool ProtoRTPReceiver::Stream::UpdateSeq(UINT16 seq)
+{
+    UINT16 udelta = seq - max_seq;
+    if (0 != probation)
+    {
+        // Source is not valid until MIN_SEQUENTIAL packets in sequence are received
+        if (seq == (UINT16)(max_seq + 1))
+        {
+            probation--;
+            max_seq = seq;
+            if (0 == probation)
+            {
+                InitSeq(seq);
+                received++;
+                return true;
+            }
+        }
+        else
+        {
+            probation = MIN_SEQUENTIAL - 1;
+            max_seq = seq;
+        }
+        return false;
+    }
+    else if (udelta < MAX_DROPOUT)
+    {
+        // In order, with permissible gap
+        if (seq < max_seq) cycles += RTP_SEQ_MOD;  // (wrapped)
+        max_seq = seq;
+    }
+    else if (udelta <= (RTP_SEQ_MOD - MAX_MISORDER))
+    {
+        // A very large jump, accepted (as a restart) only if followed in sequence
+        if (seq == bad_seq)
+        {
+            InitSeq(seq);
+        }
+        else
+        {
+            bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
+            return false;
+        }
+    }
+    // (else duplicate or reordered packet)
+    received++;
+    return true;
+}  // end ProtoRTPReceiver::Stream::UpdateSeq()
+
+// RFC 3550 A.3
+UINT8 ProtoRTPReceiver::Stream::UpdateFractionLost()
+{
+    UINT32 expected = GetExpectedCount();
+    UINT32 expectedInterval = expected - expected_prior;
+    expected_prior = expected;
+    UINT32 receivedInterval = received - received_prior;
+    received_prior = received;
+    INT32 lostInterval = (INT32)(expectedInterval - receivedInterval);
+    if ((0 == expectedInterval) || (lostInterval <= 0))
+        return 0;
+    else
+        return (UINT8)(((UINT32)lostInterval << 8) / expectedInterval);
+}  // end ProtoRTPReceiver::Stream::UpdateFractionLost()
+
+ProtoRTPReceiver::ProtoRTPReceiver(ProtoTimerMgr& timerMgr)
+ : timer_mgr(timerMgr), release_time(0.0), playout_delay(0.060), release_interval(0.001),
+   listener(NULL), stream_list(NULL), stream_max(0), stream_count(0), stream_free(NIL),
+   lru_head(NIL), lru_tail(NIL), hash_table(NULL), hash_mask(0), heap(NULL), heap_count(0),
+   ring_buffer(NULL), ring_mask(0), entry_list(NULL), pool_buffer(NULL), pool_size(0),
+   pool_free_count(0), entry_free(NIL), pkt_size_max(0), invalid_count(0), early_count(0)
+{
+    release_timer.SetListener(this, &ProtoRTPReceiver::OnReleaseTimeout);
+    release_timer.SetInterval(0.0);
+    release_timer.SetRepeat(-1);
+    // Default clock rates (RFC 3551)
+    for (unsigned int i = 0; i < ProtoPktRTP::PT_MAX; i++)
+        clock_rate[i] = (i < 25) ? 8000 : 90000;
+    clock_rate[ProtoPktRTP::DVI416K] = 16000;
+    clock_rate[ProtoPktRTP::L16S] = clock_rate[ProtoPktRTP::L16M] = 44100;
+    clock_rate[ProtoPktRTP::MPA] = 90000;
+    clock_rate[16] = 11025;  // DVI4
+    clock_rate[17] = 22050;  // DVI4
+}
+
+ProtoRTPReceiver::~ProtoRTPReceiver()
+{
+    Close();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+bool ProtoRTPReceiver::Open(unsigned int streamMax, unsigned int poolSize, unsigned int pktSizeMax, unsigned int streamDepth)
+{
+    Close();
+    if ((0 == streamMax) || (streamMax >= (unsigned int)NIL) || (0 == poolSize) ||
+        (poolSize >= (unsigned int)NIL) || (pktSizeMax < ProtoPktRTP::BASE_HDR_LEN) ||
+        (0 == streamDepth) || (streamDepth > 0x8000))
+    {
+        PLOG(PL_ERROR, "ProtoRTPReceiver::Open() error: invalid parameter\n");
+        return false;
+    }
+    UINT32 depth = 1;
+    while (depth < streamDepth) depth <<= 1;
+    UINT32 hashSize = 1;
+    while (hashSize < (2 * streamMax)) hashSize <<= 1;
+    if (NULL == (stream_list = new Stream[streamMax]))
+    {
+        PLOG(PL_ERROR, "ProtoRTPReceiver::Open() new stream_list error: %s\n", GetErrorString());
+        return false;
+    }
+    if ((NULL == (hash_table = new UINT32[hashSize])) ||
+        (NULL == (heap = new UINT32[streamMax])) ||
+        (NULL == (ring_buffer = new UINT32[(size_t)streamMax * depth])) ||
+        (NULL == (entry_list = new Entry[poolSize])) ||
+        (NULL == (pool_buffer = new char[(size_t)poolSize * pktSizeMax])))
+    {
+        PLOG(PL_ERROR, "ProtoRTPReceiver::Open() new error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    for (UINT32 i = 0; i < hashSize; i++)
+        hash_table[i] = NIL;
+    for (UINT32 i = 0; i < streamMax; i++)
+    {
+        stream_list[i].hash_next = i + 1;
+        stream_list[i].ring = ring_buffer + (size_t)i * depth;
+    }
+    stream_list[streamMax - 1].hash_next = NIL;
+    for (size_t i = 0; i < ((size_t)streamMax * depth); i++)
+        ring_buffer[i] = NIL;
+    stream_free = 0;
+    stream_max = streamMax;
+    stream_count = 0;
+    lru_head = lru_tail = NIL;
+    hash_mask = hashSize - 1;
+    heap_count = 0;
+    ring_mask = depth - 1;
+    for (UINT32 i = 0; i < poolSize; i++)
+        entry_list[i].next = i + 1;
+    entry_list[poolSize - 1].next = NIL;
+    entry_free = 0;
+    pool_size = pool_free_count = poolSize;
+    pkt_size_max = pktSizeMax;
+    invalid_count = early_count = 0;
+    return true;
+}  // end ProtoRTPReceiver::Open()
+
+void ProtoRTPReceiver::Close()
+{
+    if (release_timer.IsActive()) release_timer.Deactivate();
+    if (NULL != pool_buffer)
+    {
+        delete[] pool_buffer;
+        pool_buffer = NULL;
+    }
+    if (NULL != entry_list)
+    {
+        delete[] entry_list;
+        entry_list = NULL;
+    }
+    if (NULL != ring_buffer)
+    {
+        delete[] ring_buffer;
+        ring_buffer = NULL;
+    }
+    if (NULL != heap)
+    {
+        delete[] heap;
+        heap = NULL;
+    }
+    if (NULL != hash_table)
+    {
+        delete[] hash_table;
+        hash_table = NULL;
+    }
+    if (NULL != stream_list)
+    {
+        delete[] stream_list;
+        stream_list = NULL;
+    }
+    stream_max = stream_count = heap_count = 0;
+    stream_free = lru_head = lru_tail = entry_free = NIL;
+    pool_size = pool_free_count = 0;
+}  // end ProtoRTPReceiver::Close()
+
+bool ProtoRTPReceiver::Receive(const ProtoPktRTP& rtpPkt)
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    return Receive(rtpPkt, ProtoTime(currentTime));
+}  // end ProtoRTPReceiver::Receive()
+
+bool ProtoRTPReceiver::Receive(const ProtoPktRTP& rtpPkt, const ProtoTime& arrivalTime)
+{
+    if (NULL == stream_list)
+    {
+        PLOG(PL_ERROR, "ProtoRTPReceiver::Receive() error: receiver not open\n");
+        return false;
+    }
+    if ((rtpPkt.GetLength() < ProtoPktRTP::BASE_HDR_LEN) || (ProtoPktRTP::VERSION != rtpPkt.GetVersion()) ||
+        (rtpPkt.GetHeaderLength() > rtpPkt.GetLength()) || (rtpPkt.GetLength() > pkt_size_max))
+    {
+        invalid_count++;
+        return false;
+    }
+    UINT32 ssrc = rtpPkt.GetSsrc();
+    double theTime = arrivalTime.GetValue();
+    UINT16 seq = rtpPkt.GetSequence();
+    UINT32 index = FindStreamIndex(ssrc);
+    if (NIL == index)
+    {
+        index = AddStream(ssrc, clock_rate[rtpPkt.GetPayloadType()], theTime);
+        Stream& stream = stream_list[index];
+        stream.InitSeq(seq);
+        stream.max_seq = seq - 1;
+        stream.probation = MIN_SEQUENTIAL;
+    }
+    else
+    {
+        Touch(index, theTime);
+    }
+    Stream& stream = stream_list[index];
+    if (!stream.UpdateSeq(seq))
+    {
+        invalid_count++;
+        return false;
+    }
+    UINT32 extSeq = stream.GetExtendedMaxSeq() - (UINT16)(stream.max_seq - seq);
+    UINT32 timestamp = rtpPkt.GetTimestamp();
+    // (arrival time in timestamp units, modulo 2^32)
+    double units = fmod((theTime - stream.start_time) * (double)stream.clock_rate, 4294967296.0);
+    UINT32 arrival = (UINT32)((units < 0.0) ? (units + 4294967296.0) : units);
+    bool refChanged = true;
+    if (1 == stream.received)
+    {
+        // Source (re)started, so play out anything left and reset playout
+        while (PlayNext(index)) early_count++;
+        stream.play_seq = extSeq;
+        stream.transit = arrival - timestamp;
+        stream.ref_time = theTime;
+        stream.ref_timestamp = timestamp;
+    }
+    else
+    {
+        // Interarrival jitter (RFC 3550 A.8)
+        UINT32 transit = arrival - timestamp;
+        INT32 d = (INT32)(transit - stream.transit);
+        stream.transit = transit;
+        if (d < 0) d = -d;
+        stream.jitter += (UINT32)d - ((stream.jitter + 8) >> 4);
+        // Playout reference tracks the earliest (relative) arrival
+        double predicted = stream.ref_time + (double)(INT32)(timestamp - stream.ref_timestamp) / (double)stream.clock_rate;
+        if ((theTime < predicted) || ((theTime - predicted) > RESYNC_THRESHOLD))
+        {
+            stream.ref_time = theTime;
+            stream.ref_timestamp = timestamp;
+        }
+        else
+        {
+            refChanged = false;
+        }
+    }
+    unsigned long earlyCount = early_count;
+    if (!Buffer(index, extSeq, timestamp, rtpPkt)) return false;
+    // (the stream's playout time changes only if this packet is next, the reference
+    // moved or packets were played out early)
+    if (refChanged || (earlyCount != early_count) || (NIL == stream.heap_index) ||
+        (FindHead(stream) == stream.ring[extSeq & ring_mask]))
+    {
+        UpdateDueTime(index);
+        ScheduleRelease();
+    }
+    return true;
+}  // end ProtoRTPReceiver::Receive()
+
+bool ProtoRTPReceiver::Buffer(UINT32 index, UINT32 extSeq, UINT32 timestamp, const ProtoPktRTP& rtpPkt)
+{
+    Stream& stream = stream_list[index];
+    if ((INT32)(extSeq - stream.play_seq) < 0)
+    {
+        stream.late_count++;
+        return false;
+    }
+    // Make room in the ring (playing out early) if needed
+    while ((extSeq - stream.play_seq) > ring_mask)
+    {
+        if (PlayNext(index))
+        {
+            early_count++;
+        }
+        else
+        {
+            UINT32 skip = extSeq - ring_mask - stream.play_seq;
+            Notify(stream, EVENT_LOSS, NULL, skip);
+            stream.play_seq += skip;
+        }
+    }
+    if (NIL != stream.ring[extSeq & ring_mask])
+    {
+        stream.duplicate_count++;
+        return false;
+    }
+    if (NIL == entry_free)
+    {
+        // Pool is exhausted, so play out the earliest due packet
+        UINT32 earliest = heap[0];
+        PlayNext(earliest);
+        early_count++;
+        UpdateDueTime(earliest);
+        if ((INT32)(extSeq - stream.play_seq) < 0)
+        {
+            stream.late_count++;  // (a later packet of this stream was played out)
+            return false;
+        }
+    }
+    UINT32 entry = entry_free;
+    Entry& e = entry_list[entry];
+    entry_free = e.next;
+    pool_free_count--;
+    e.ext_seq = extSeq;
+    e.timestamp = timestamp;
+    e.length = rtpPkt.GetLength();
+    memcpy(GetEntryData(entry), rtpPkt.GetBuffer(), e.length);
+    stream.ring[extSeq & ring_mask] = entry;
+    stream.buffered_count++;
+    return true;
+}  // end ProtoRTPReceiver::Buffer()
+
+UINT32 ProtoRTPReceiver::FindHead(const Stream& stream) const
+{
+    if (0 == stream.buffered_count) return NIL;
+    UINT32 seq = stream.play_seq;
+    UINT32 entry;
+    while (NIL == (entry = stream.ring[seq & ring_mask])) seq++;
+    return entry;
+}  // end ProtoRTPReceiver::FindHead()
+
+// Plays out the next buffered packet (reporting any missing before it)
+bool ProtoRTPReceiver::PlayNext(UINT32 index)
+{
+    Stream& stream = stream_list[index];
+    UINT32 entry = FindHead(stream);
+    if (NIL == entry) return false;
+    Entry& e = entry_list[entry];
+    UINT32 missing = e.ext_seq - stream.play_seq;
+    if (0 != missing) Notify(stream, EVENT_LOSS, NULL, missing);
+    stream.ring[e.ext_seq & ring_mask] = NIL;
+    stream.buffered_count--;
+    stream.play_seq = e.ext_seq + 1;
+    stream.played_count++;
+    Notify(stream, EVENT_PACKET, GetEntryData(entry), e.length);
+    e.next = entry_free;
+    entry_free = entry;
+    pool_free_count++;
+    return true;
+}  // end ProtoRTPReceiver::PlayNext()
+
+// Plays out the packets due by "releaseTime"
+void ProtoRTPReceiver::Release(UINT32 index, double releaseTime)
+{
+    Stream& stream = stream_list[index];
+    UINT32 entry;
+    while ((NIL != (entry = FindHead(stream))) && (GetDueTime(stream, entry) <= releaseTime))
+        PlayNext(index);
+    UpdateDueTime(index);
+}  // end ProtoRTPReceiver::Release()
+
+void ProtoRTPReceiver::UpdateDueTime(UINT32 index)
+{
+    Stream& stream = stream_list[index];
+    UINT32 entry = FindHead(stream);
+    if (NIL == entry)
+    {
+        HeapRemove(index);
+    }
+    else
+    {
+        stream.due_time = GetDueTime(stream, entry);
+        HeapUpdate(index);
+    }
+}  // end ProtoRTPReceiver::UpdateDueTime()
+
+void ProtoRTPReceiver::ScheduleRelease()
+{
+    if (0 == heap_count) return;
+    double dueTime = stream_list[heap[0]].due_time;
+    // (reschedule only if the next release is due more than a release interval earlier)
+    if (release_timer.IsActive() && (dueTime >= (release_time - release_interval))) return;
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    double now = ProtoTime(currentTime).GetValue();
+    double interval = (dueTime > now) ? (dueTime - now) : 0.0;
+    release_time = now + interval;
+    release_timer.SetInterval(interval);
+    if (release_timer.IsActive())
+        release_timer.Reschedule();
+    else
+        timer_mgr.ActivateTimer(release_timer);
+}  // end ProtoRTPReceiver::ScheduleRelease()
+
+void ProtoRTPReceiver::OnReleaseTimeout(ProtoTimer& /*theTimer*/)
+{
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    double now = ProtoTime(currentTime).GetValue();
+    // (packets due within the next release interval are released now)
+    double releaseTime = now + release_interval;
+    while ((0 != heap_count) && (stream_list[heap[0]].due_time <= releaseTime))
+        Release(heap[0], releaseTime);
+    if (0 == heap_count)
+    {
+        release_timer.Deactivate();
+    }
+    else
+    {
+        // Set interval for next (repeating) timeout
+        double interval = stream_list[heap[0]].due_time - now;
+        if (interval < release_interval) interval = release_interval;
+        release_time = now + interval;
+        release_timer.SetInterval(interval);
+    }
+}  // end ProtoRTPReceiver::OnReleaseTimeout()
+
+UINT32 ProtoRTPReceiver::AddStream(UINT32 ssrc, UINT32 clockRate, double theTime)
+{
+    if (NIL == stream_free)
+    {
+        // Remove least recently active stream
+        RemoveStreamIndex(lru_head);
+    }
+    UINT32 index = stream_free;
+    Stream& stream = stream_list[index];
+    stream_free = stream.hash_next;
+    stream.ssrc = ssrc;
+    stream.heap_index = NIL;
+    stream.start_time = stream.last_time = theTime;
+    stream.user_data = NULL;
+    stream.transit = stream.jitter = 0;
+    stream.clock_rate = clockRate;
+    stream.play_seq = 0;
+    stream.buffered_count = 0;
+    stream.ref_time = theTime;
+    stream.ref_timestamp = 0;
+    stream.due_time = 0.0;
+    stream.played_count = stream.late_count = stream.duplicate_count = 0;
+    UINT32& head = hash_table[HashSsrc(ssrc) & hash_mask];
+    stream.hash_next = head;
+    head = index;
+    stream.lru_prev = lru_tail;
+    stream.lru_next = NIL;
+    if (NIL != lru_tail)
+        stream_list[lru_tail].lru_next = index;
+    else
+        lru_head = index;
+    lru_tail = index;
+    stream_count++;
+    Notify(stream, EVENT_NEW_STREAM, NULL, 0);
+    return index;
+}  // end ProtoRTPReceiver::AddStream()
+
+void ProtoRTPReceiver::Touch(UINT32 index, double theTime)
+{
+    Stream& stream = stream_list[index];
+    stream.last_time = theTime;
+    if (lru_tail == index) return;
+    // Move to tail of activity list
+    if (NIL != stream.lru_prev)
+        stream_list[stream.lru_prev].lru_next = stream.lru_next;
+    else
+        lru_head = stream.lru_next;
+    stream_list[stream.lru_next].lru_prev = stream.lru_prev;
+    stream.lru_prev = lru_tail;
+    stream.lru_next = NIL;
+    stream_list[lru_tail].lru_next = index;
+    lru_tail = index;
+}  // end ProtoRTPReceiver::Touch()
+
+void ProtoRTPReceiver::RemoveStream(UINT32 ssrc)
+{
+    if (NULL == stream_list) return;
+    UINT32 index = FindStreamIndex(ssrc);
+    if (NIL != index) RemoveStreamIndex(index);
+}  // end ProtoRTPReceiver::RemoveStream()
+
+void ProtoRTPReceiver::RemoveStreamIndex(UINT32 index)
+{
+    Stream& stream = stream_list[index];
+    Notify(stream, EVENT_REMOVE, NULL, 0);
+    // Discard buffered packets
+    for (UINT32 seq = stream.play_seq; 0 != stream.buffered_count; seq++)
+    {
+        UINT32& slot = stream.ring[seq & ring_mask];
+        if (NIL == slot) continue;
+        entry_list[slot].next = entry_free;
+        entry_free = slot;
+        pool_free_count++;
+        slot = NIL;
+        stream.buffered_count--;
+    }
+    HeapRemove(index);
+    UINT32* prevNext = hash_table + (HashSsrc(stream.ssrc) & hash_mask);
+    while (index != *prevNext)
+        prevNext = &stream_list[*prevNext].hash_next;
+    *prevNext = stream.hash_next;
+    if (NIL != stream.lru_prev)
+        stream_list[stream.lru_prev].lru_next = stream.lru_next;
+    else
+        lru_head = stream.lru_next;
+    if (NIL != stream.lru_next)
+        stream_list[stream.lru_next].lru_prev = stream.lru_prev;
+    else
+        lru_tail = stream.lru_prev;
+    stream.hash_next = stream_free;
+    stream_free = index;
+    stream_count--;
+}  // end ProtoRTPReceiver::RemoveStreamIndex()
+
+void ProtoRTPReceiver::Expire(double idleTimeout)
+{
+    if (NULL == stream_list) return;
+    struct timeval currentTime;
+    timer_mgr.GetSystemTime(currentTime);
+    double expireTime = ProtoTime(currentTime).GetValue() - idleTimeout;
+    while ((NIL != lru_head) && (stream_list[lru_head].last_time <= expireTime))
+        RemoveStreamIndex(lru_head);
+}  // end ProtoRTPReceiver::Expire()
+
+void ProtoRTPReceiver::Flush()
+{
+    if (NULL == stream_list) return;
+    while (0 != heap_count)
+    {
+        UINT32 index = heap[0];
+        while (PlayNext(index));
+        HeapRemove(index);
+    }
+    if (release_timer.IsActive()) release_timer.Deactivate();
+}  // end ProtoRTPReceiver::Flush()
+
+void ProtoRTPReceiver::HeapUpdate(UINT32 index)
+{
+    UINT32 pos = stream_list[index].heap_index;
+    if (NIL == pos)
+    {
+        pos = heap_count++;
+        HeapSet(pos, index);
+        HeapSiftUp(pos);
+    }
+    else
+    {
+        HeapSiftUp(pos);
+        HeapSiftDown(stream_list[index].heap_index);
+    }
+}  // end ProtoRTPReceiver::HeapUpdate()
+
+void ProtoRTPReceiver::HeapRemove(UINT32 index)
+{
+    UINT32 pos = stream_list[index].heap_index;
+    if (NIL == pos) return;
+    stream_list[index].heap_index = NIL;
+    if (pos != --heap_count)
+    {
+        HeapSet(pos, heap[heap_count]);
+        HeapSiftUp(pos);
+        HeapSiftDown(stream_list[heap[pos]].heap_index);
+    }
+}  // end ProtoRTPReceiver::HeapRemove()
+
+void ProtoRTPReceiver::HeapSiftUp(UINT32 pos)
+{
+    UINT32 index = heap[pos];
+    double dueTime = stream_list[index].due_time;
+    while (0 != pos)
+    {
+        UINT32 parent = (pos - 1) >> 1;
+        if (stream_list[heap[parent]].due_time <= dueTime) break;
+        HeapSet(pos, heap[parent]);
+        pos = parent;
+    }
+    HeapSet(pos, index);
+}  // end ProtoRTPReceiver::HeapSiftUp()
+
+void ProtoRTPReceiver::HeapSiftDown(UINT32 pos)
+{
+    UINT32 index = heap[pos];
+    double dueTime = stream_list[index].due_time;
+    for (;;)
+    {
+        UINT32 child = (pos << 1) + 1;
+        if (child >= heap_count) break;
+        if (((child + 1) < heap_count) && (stream_list[heap[child + 1]].due_time < stream_list[heap[child]].due_time))
+            child++;
+        if (dueTime <= stream_list[heap[child]].due_time) break;
+        HeapSet(pos, heap[child]);
+        pos = child;
+    }
+    HeapSet(pos, index);
+}  // end ProtoRTPReceiver::HeapSiftDown()
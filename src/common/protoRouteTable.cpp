@@ -38,7 +38,7 @@ bool ProtoRouteTable::GetRoute(const ProtoAddress&  dst,
 {
     if (0 == prefixSize) 
     {
-        gw = default_entry.gateway;
+        default_entry.gateway.GetAddress(gw);
         ifIndex = default_entry.iface_index;
         metric = default_entry.metric;
         return true;   
@@ -46,7 +46,7 @@ bool ProtoRouteTable::GetRoute(const ProtoAddress&  dst,
     Entry* entry = GetEntry(dst, prefixSize);
     if (entry)
     {
-        gw = entry->gateway;
+        entry->gateway.GetAddress(gw);
         ifIndex = entry->iface_index;
         metric = entry->metric;
         return true;
@@ -99,7 +99,7 @@ bool ProtoRouteTable::FindRoute(const ProtoAddress& dst,
     Entry* entry = FindRouteEntry(dst, prefixSize);
     if (entry)
     {
-        gw = entry->gateway;
+        entry->gateway.GetAddress(gw);
         ifIndex = entry->iface_index;
         metric = entry->metric;
         return true;
@@ -203,7 +203,7 @@ void ProtoRouteTable::DeleteEntry(ProtoRouteTable::Entry* entry)
         default_entry.Clear();
         return;
     }
-    Entry* entryFound = static_cast<Entry*>(tree.Find(entry->GetDestination().GetRawHostAddress(), entry->GetPrefixSize()));
+    Entry* entryFound = static_cast<Entry*>(tree.Find(entry->GetKey(), entry->GetPrefixSize()));
     if (entryFound == entry)
     {
         tree.Remove(*entry);
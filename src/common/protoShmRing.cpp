@@ -0,0 +1,679 @@
+/**
+* @file protoShmRing.cpp
+*
+* @brief Shared-memory message ring for local interprocess communication
+*/
+#include "protoShmRing.h"
+#include "protoDebug.h"
+
+#ifndef WIN32
+
+#include <unistd.h>     // for close(), read(), write()
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>      // for sched_yield()
+#include <sys/mman.h>   // for mmap()
+#include <sys/stat.h>
+#ifdef USE_EVENTFD
+#include <sys/eventfd.h>
+#endif // USE_EVENTFD
+
+// Shared control block at the start of the mapping.  The producer,
+// commit and consumer indices are free-running byte counts, each on its
+// own cache line so producers and the consumer don't false share.
+struct ProtoShmRing::Control
+{
+    enum {MAGIC = 0x50534852, VERSION = 1};  // "PSHR"
+    enum {FLAG_MULTI = 0x01};
+
+    UINT32      magic;
+    UINT32      version;
+    UINT32      size;
+    UINT32      flags;
+    UINT32      producer_count;
+    UINT32      consumer_closed;
+    char        pad0[40];
+    uint64_t    reserve_head;       // space claimed by producers
+    char        pad1[56];
+    uint64_t    commit_head;        // space published to the consumer
+    char        pad2[56];
+    uint64_t    consumer_tail;      // space released by the consumer
+    char        pad3[56];
+    UINT32      consumer_waiting;   // consumer found the ring empty
+    UINT32      space_waiters;      // producers that found the ring full
+    char        pad4[56];
+    uint64_t    msg_count;
+    uint64_t    byte_count;
+    char        pad5[48];
+};  // end struct ProtoShmRing::Control
+
+// Each message is a 32-bit length header followed by the payload, padded
+// to an 8-byte multiple.  A message that would straddle the end of the
+// buffer is preceded by a "pad" record filling the remainder.
+static const UINT32 RECORD_PAD = 0x80000000;
+static const UINT32 RECORD_LENGTH_MASK = 0x3fffffff;
+static const unsigned int RING_SIZE_MIN = 4096;
+static const unsigned int RING_FD_COUNT = 5;
+
+static inline unsigned int RecordSize(unsigned int length)
+    {return ((length + 4 + 7) & ~7);}
+
+static inline uint64_t LoadAcquire(const uint64_t* ptr)
+    {return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);}
+
+ProtoShmRing::ProtoShmRing()
+ : control(NULL), ring_buffer(NULL), ring_size(0), ring_mask(0),
+   is_consumer(false), shm_fd(-1), data_wait_fd(-1), data_signal_fd(-1),
+   space_wait_fd(-1), space_signal_fd(-1), rendezvous_pipe(ProtoPipe::STREAM),
+   output_wanted(false), space_armed(false), full_count(0)
+{
+    ring_name[0] = '\0';
+}
+
+ProtoShmRing::~ProtoShmRing()
+{
+    Close();
+}
+
+bool ProtoShmRing::IsMultiProducer() const
+{
+    return ((NULL != control) && (0 != (control->flags & Control::FLAG_MULTI)));
+}  // end ProtoShmRing::IsMultiProducer()
+
+uint64_t ProtoShmRing::GetMessageCount() const
+{
+    return ((NULL != control) ? __atomic_load_n(&control->msg_count, __ATOMIC_RELAXED) : 0);
+}  // end ProtoShmRing::GetMessageCount()
+
+uint64_t ProtoShmRing::GetByteCount() const
+{
+    return ((NULL != control) ? __atomic_load_n(&control->byte_count, __ATOMIC_RELAXED) : 0);
+}  // end ProtoShmRing::GetByteCount()
+
+bool ProtoShmRing::Map(int fd, unsigned int size, bool init)
+{
+    size_t mapSize = sizeof(Control) + size;
+    void* ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Map() mmap() error: %s\n", GetErrorString());
+        return false;
+    }
+    control = (Control*)ptr;
+    if (init)
+    {
+        memset(control, 0, sizeof(Control));
+        control->magic = Control::MAGIC;
+        control->version = Control::VERSION;
+        control->size = size;
+        control->consumer_waiting = 1;  // (the first message wakes the consumer)
+    }
+    else if ((Control::MAGIC != control->magic) ||
+             (Control::VERSION != control->version) ||
+             (size != control->size))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Map() error: invalid ring header\n");
+        munmap(ptr, mapSize);
+        control = NULL;
+        return false;
+    }
+    ring_buffer = (char*)ptr + sizeof(Control);
+    ring_size = size;
+    ring_mask = size - 1;
+    return true;
+}  // end ProtoShmRing::Map()
+
+bool ProtoShmRing::OpenWakeup()
+{
+#ifdef USE_EVENTFD
+    // The "space" eventfd is a semaphore so that each waiting
+    // producer consumes one wakeup of those the consumer posts
+    if (-1 == (data_wait_fd = eventfd(0, EFD_NONBLOCK)))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::OpenWakeup() eventfd() error: %s\n", GetErrorString());
+        return false;
+    }
+    data_signal_fd = data_wait_fd;
+    if (-1 == (space_wait_fd = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE)))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::OpenWakeup() eventfd() error: %s\n", GetErrorString());
+        return false;
+    }
+    space_signal_fd = space_wait_fd;
+#else
+    int fds[2];
+    for (int i = 0; i < 2; i++)
+    {
+        if (0 != pipe(fds))
+        {
+            PLOG(PL_ERROR, "ProtoShmRing::OpenWakeup() pipe() error: %s\n", GetErrorString());
+            return false;
+        }
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+        if (0 == i)
+        {
+            data_wait_fd = fds[0];
+            data_signal_fd = fds[1];
+        }
+        else
+        {
+            space_wait_fd = fds[0];
+            space_signal_fd = fds[1];
+        }
+    }
+#endif // if/else USE_EVENTFD
+    return true;
+}  // end ProtoShmRing::OpenWakeup()
+
+void ProtoShmRing::Signal(int fd, uint64_t count)
+{
+#ifdef USE_EVENTFD
+    while (write(fd, &count, sizeof(uint64_t)) < 0)
+    {
+        if (EINTR == errno) continue;
+        if (EAGAIN != errno)  // (EAGAIN means the counter is saturated anyway)
+            PLOG(PL_ERROR, "ProtoShmRing::Signal() write() error: %s\n", GetErrorString());
+        break;
+    }
+#else
+    char bytes[64];
+    memset(bytes, 0, sizeof(bytes));
+    unsigned int len = (count < sizeof(bytes)) ? (unsigned int)count : sizeof(bytes);
+    while (write(fd, bytes, len) < 0)
+    {
+        if (EINTR == errno) continue;
+        if (EAGAIN != errno)  // (EAGAIN means the pipe is already signaled)
+            PLOG(PL_ERROR, "ProtoShmRing::Signal() write() error: %s\n", GetErrorString());
+        break;
+    }
+#endif // if/else USE_EVENTFD
+}  // end ProtoShmRing::Signal()
+
+bool ProtoShmRing::Drain(int fd, bool semaphore)
+{
+#ifdef USE_EVENTFD
+    (void)semaphore;  // (the eventfd semaphore mode handles this)
+    uint64_t count;
+    return (read(fd, &count, sizeof(uint64_t)) > 0);
+#else
+    char bytes[64];
+    if (semaphore) return (read(fd, bytes, 1) > 0);
+    bool result = false;
+    while (read(fd, bytes, sizeof(bytes)) > 0) result = true;
+    return result;
+#endif // if/else USE_EVENTFD
+}  // end ProtoShmRing::Drain()
+
+bool ProtoShmRing::Listen(const char* theName, unsigned int bufferSize, bool multiProducer)
+{
+    if (IsOpen()) Close();
+    unsigned int size = RING_SIZE_MIN;
+    while ((size < bufferSize) && (size < 0x40000000)) size <<= 1;
+
+    // 1) Create the (anonymous) shared memory object; producers
+    //    get its descriptor rather than a name
+    if ((shm_fd = ProtoPipe::CreateSharedMemory(sizeof(Control) + size, "protoShmRing")) < 0)
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Listen() error: unable to create shared memory\n");
+        return false;
+    }
+    if (!Map(shm_fd, size, true))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Listen() error: unable to map ring\n");
+        Close();
+        return false;
+    }
+    if (multiProducer) control->flags |= Control::FLAG_MULTI;
+
+    // 2) Wakeup descriptors and the rendezvous pipe producers connect to
+    if (!OpenWakeup())
+    {
+        Close();
+        return false;
+    }
+    ProtoChannel::Notifier* theNotifier = GetNotifier();
+    if (NULL != theNotifier)
+    {
+        rendezvous_pipe.SetNotifier(dynamic_cast<ProtoSocket::Notifier*>(theNotifier));
+        rendezvous_pipe.SetListener(this, &ProtoShmRing::OnRendezvousEvent);
+    }
+    if (!rendezvous_pipe.Listen(theName))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Listen() error: unable to listen on pipe \"%s\"\n", theName);
+        Close();
+        return false;
+    }
+    strncpy(ring_name, theName, PATH_MAX - 1);
+    ring_name[PATH_MAX - 1] = '\0';
+    is_consumer = true;
+    descriptor = data_wait_fd;
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Listen() error: unable to open channel\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end ProtoShmRing::Listen()
+
+bool ProtoShmRing::Accept()
+{
+    if (!IsConsumer())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Accept() error: ring is not listening\n");
+        return false;
+    }
+    ProtoPipe connection(ProtoPipe::STREAM);
+    if (!rendezvous_pipe.Accept(&connection))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Accept() error: rendezvous accept failure\n");
+        return false;
+    }
+    int fdList[RING_FD_COUNT] = {shm_fd, data_wait_fd, data_signal_fd, space_wait_fd, space_signal_fd};
+    bool result = connection.SendDescriptors(fdList, RING_FD_COUNT);
+    connection.Close();
+    return result;
+}  // end ProtoShmRing::Accept()
+
+void ProtoShmRing::OnRendezvousEvent(ProtoSocket&       /*theSocket*/,
+                                     ProtoSocket::Event theEvent)
+{
+    if (ProtoSocket::ACCEPT == theEvent) Accept();
+}  // end ProtoShmRing::OnRendezvousEvent()
+
+bool ProtoShmRing::Connect(const char* theName)
+{
+    if (IsOpen()) Close();
+    // 1) Get the ring descriptors from the listening consumer
+    ProtoPipe connection(ProtoPipe::STREAM);
+    if (!connection.Connect(theName))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Connect() error: unable to connect to \"%s\"\n", theName);
+        return false;
+    }
+    int fdList[RING_FD_COUNT];
+    unsigned int fdCount = RING_FD_COUNT;
+    unsigned int numBytes = 0;
+    bool result = connection.RecvDescriptors(fdList, fdCount, NULL, numBytes);
+    connection.Close();
+    if (!result) return false;
+    if (RING_FD_COUNT != fdCount)
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Connect() error: incomplete descriptor set\n");
+        for (unsigned int i = 0; i < fdCount; i++) close(fdList[i]);
+        return false;
+    }
+    shm_fd = fdList[0];
+    close(fdList[1]);  // (only the consumer waits on this)
+    data_signal_fd = fdList[2];
+    space_wait_fd = fdList[3];
+    space_signal_fd = fdList[4];
+
+    // 2) Map the ring and register as a producer
+    struct stat info;
+    if ((0 != fstat(shm_fd, &info)) || (info.st_size <= (off_t)sizeof(Control)))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Connect() error: invalid shared memory object\n");
+        Close();
+        return false;
+    }
+    if (!Map(shm_fd, (unsigned int)(info.st_size - sizeof(Control)), false))
+    {
+        Close();
+        return false;
+    }
+    if (IsMultiProducer())
+    {
+        __atomic_fetch_add(&control->producer_count, 1, __ATOMIC_SEQ_CST);
+    }
+    else
+    {
+        UINT32 expected = 0;
+        if (!__atomic_compare_exchange_n(&control->producer_count, &expected, 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            PLOG(PL_ERROR, "ProtoShmRing::Connect() error: single-producer ring \"%s\" already has a producer\n", theName);
+            munmap(control, sizeof(Control) + ring_size);
+            control = NULL;
+            Close();
+            return false;
+        }
+    }
+    strncpy(ring_name, theName, PATH_MAX - 1);
+    ring_name[PATH_MAX - 1] = '\0';
+    is_consumer = false;
+    descriptor = space_wait_fd;
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Connect() error: unable to open channel\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end ProtoShmRing::Connect()
+
+void ProtoShmRing::Close()
+{
+    if (IsOpen())
+    {
+        ProtoChannel::Close();
+        if (is_consumer)
+        {
+            // Wake any producers blocked on a full ring so they see the closure
+            __atomic_store_n(&control->consumer_closed, 1, __ATOMIC_SEQ_CST);
+            UINT32 producerCount = __atomic_load_n(&control->producer_count, __ATOMIC_SEQ_CST);
+            if (0 != producerCount) Signal(space_signal_fd, producerCount);
+        }
+        else
+        {
+            __atomic_fetch_sub(&control->producer_count, 1, __ATOMIC_SEQ_CST);
+        }
+        descriptor = INVALID_HANDLE;
+    }
+    rendezvous_pipe.Close();
+    if (NULL != control)
+    {
+        munmap(control, sizeof(Control) + ring_size);
+        control = NULL;
+        ring_buffer = NULL;
+    }
+    // (with eventfd the "wait" and "signal" descriptors may be the same)
+    int* fdList[RING_FD_COUNT] = {&shm_fd, &data_wait_fd, &data_signal_fd, &space_wait_fd, &space_signal_fd};
+    for (unsigned int i = 0; i < RING_FD_COUNT; i++)
+    {
+        int fd = *fdList[i];
+        if (fd < 0) continue;
+        close(fd);
+        for (unsigned int j = i; j < RING_FD_COUNT; j++)
+            if (fd == *fdList[j]) *fdList[j] = -1;
+    }
+    ring_size = ring_mask = 0;
+    ring_name[0] = '\0';
+    output_wanted = space_armed = false;
+}  // end ProtoShmRing::Close()
+
+unsigned int ProtoShmRing::Reserve(unsigned int        count,
+                                   const unsigned int* lengthList,
+                                   uint64_t&           head,
+                                   uint64_t&           end)
+{
+    bool multi = IsMultiProducer();
+    head = __atomic_load_n(&control->reserve_head, __ATOMIC_RELAXED);
+    while (true)
+    {
+        uint64_t limit = LoadAcquire(&control->consumer_tail) + ring_size;
+        uint64_t pos = head;
+        unsigned int n;
+        for (n = 0; n < count; n++)
+        {
+            unsigned int need = RecordSize(lengthList[n]);
+            unsigned int contig = ring_size - (unsigned int)(pos & ring_mask);
+            uint64_t next = pos + ((need > contig) ? (contig + need) : need);
+            if (next > limit) break;
+            pos = next;
+        }
+        if (0 == n) return 0;
+        end = pos;
+        if (!multi)
+        {
+            __atomic_store_n(&control->reserve_head, end, __ATOMIC_RELAXED);
+            return n;
+        }
+        // (a failed exchange updates "head" to the current value)
+        if (__atomic_compare_exchange_n(&control->reserve_head, &head, end, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return n;
+    }
+}  // end ProtoShmRing::Reserve()
+
+bool ProtoShmRing::Write(const char* buffer, unsigned int numBytes)
+{
+    return (1 == WriteBatch(1, &buffer, &numBytes));
+}  // end ProtoShmRing::Write()
+
+unsigned int ProtoShmRing::WriteBatch(unsigned int        count,
+                                      const char* const*  bufferList,
+                                      const unsigned int* lengthList)
+{
+    if (!IsProducer())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::WriteBatch() error: not connected as producer\n");
+        return 0;
+    }
+    if (0 != __atomic_load_n(&control->consumer_closed, __ATOMIC_RELAXED))
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::WriteBatch() error: ring \"%s\" closed by consumer\n", ring_name);
+        return 0;
+    }
+    if (0 == count) return 0;
+    // (messages up to half the ring are accepted so one always fits an empty ring)
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (RecordSize(lengthList[i]) > (ring_size >> 1))
+        {
+            PLOG(PL_ERROR, "ProtoShmRing::WriteBatch() error: message size %u exceeds ring limit\n", lengthList[i]);
+            count = i;
+            break;
+        }
+    }
+    uint64_t head, end;
+    unsigned int n = (0 != count) ? Reserve(count, lengthList, head, end) : 0;
+    if (0 != n)
+    {
+        // Copy the messages into the claimed space
+        uint64_t pos = head;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            unsigned int offset = (unsigned int)(pos & ring_mask);
+            unsigned int need = RecordSize(lengthList[i]);
+            unsigned int contig = ring_size - offset;
+            if (need > contig)
+            {
+                *((UINT32*)(ring_buffer + offset)) = RECORD_PAD | contig;
+                pos += contig;
+                offset = 0;
+            }
+            *((UINT32*)(ring_buffer + offset)) = lengthList[i];
+            memcpy(ring_buffer + offset + 4, bufferList[i], lengthList[i]);
+            pos += need;
+        }
+        // Publish in claim order (waiting for any earlier producer to finish)
+        if (IsMultiProducer())
+        {
+            unsigned int spin = 0;
+            while (LoadAcquire(&control->commit_head) != head)
+            {
+                if (++spin > 64) sched_yield();
+            }
+        }
+        __atomic_store_n(&control->commit_head, end, __ATOMIC_SEQ_CST);
+        if ((0 != __atomic_load_n(&control->consumer_waiting, __ATOMIC_SEQ_CST)) &&
+            (0 != __atomic_exchange_n(&control->consumer_waiting, 0, __ATOMIC_SEQ_CST)))
+        {
+            Signal(data_signal_fd, 1);
+        }
+    }
+    if (n < count)
+    {
+        // Ring full: count this producer as waiting for space, then
+        // recheck in case the consumer freed space in the meantime
+        full_count++;
+        if (!space_armed)
+        {
+            __atomic_fetch_add(&control->space_waiters, 1, __ATOMIC_SEQ_CST);
+            space_armed = true;
+        }
+        uint64_t used = __atomic_load_n(&control->reserve_head, __ATOMIC_SEQ_CST) -
+                        __atomic_load_n(&control->consumer_tail, __ATOMIC_SEQ_CST);
+        if ((ring_size - used) >= (2 * RecordSize(lengthList[n])))
+            Signal(space_signal_fd, 1);
+    }
+    return n;
+}  // end ProtoShmRing::WriteBatch()
+
+bool ProtoShmRing::IsEmpty() const
+{
+    if (NULL == control) return true;
+    return (LoadAcquire(&control->commit_head) == control->consumer_tail);
+}  // end ProtoShmRing::IsEmpty()
+
+bool ProtoShmRing::Pending(uint64_t& tail, uint64_t& head)
+{
+    tail = control->consumer_tail;
+    head = LoadAcquire(&control->commit_head);
+    if (head != tail) return true;
+    // Empty, so ask producers for a wakeup, then recheck
+    __atomic_store_n(&control->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    head = __atomic_load_n(&control->commit_head, __ATOMIC_SEQ_CST);
+    if (head == tail) return false;
+    __atomic_store_n(&control->consumer_waiting, 0, __ATOMIC_RELAXED);
+    return true;
+}  // end ProtoShmRing::Pending()
+
+bool ProtoShmRing::Read(char* buffer, unsigned int& numBytes)
+{
+    if (!IsConsumer())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::Read() error: not listening as consumer\n");
+        return false;
+    }
+    uint64_t tail, head;
+    if (!Pending(tail, head))
+    {
+        numBytes = 0;
+        return true;
+    }
+    UINT32 header = *((const UINT32*)(ring_buffer + (tail & ring_mask)));
+    if (0 != (header & RECORD_PAD))
+    {
+        tail += (header & RECORD_LENGTH_MASK);
+        header = *((const UINT32*)(ring_buffer + (tail & ring_mask)));
+    }
+    unsigned int length = header & RECORD_LENGTH_MASK;
+    if (length > numBytes)
+    {
+        PLOG(PL_WARN, "ProtoShmRing::Read() error: buffer too small for %u byte message\n", length);
+        numBytes = length;
+        return false;
+    }
+    memcpy(buffer, ring_buffer + (tail & ring_mask) + 4, length);
+    numBytes = length;
+    Consume(1);
+    return true;
+}  // end ProtoShmRing::Read()
+
+unsigned int ProtoShmRing::Peek(unsigned int   maxCount,
+                                const char**   bufferList,
+                                unsigned int*  lengthList)
+{
+    if (!IsConsumer()) return 0;
+    uint64_t pos, head;
+    if (!Pending(pos, head)) return 0;
+    unsigned int n = 0;
+    while ((n < maxCount) && (pos != head))
+    {
+        unsigned int offset = (unsigned int)(pos & ring_mask);
+        UINT32 header = *((const UINT32*)(ring_buffer + offset));
+        if (0 != (header & RECORD_PAD))
+        {
+            pos += (header & RECORD_LENGTH_MASK);
+            continue;
+        }
+        bufferList[n] = ring_buffer + offset + 4;
+        lengthList[n] = header & RECORD_LENGTH_MASK;
+        pos += RecordSize(lengthList[n]);
+        n++;
+    }
+    return n;
+}  // end ProtoShmRing::Peek()
+
+void ProtoShmRing::Consume(unsigned int count)
+{
+    if (!IsConsumer()) return;
+    uint64_t pos = control->consumer_tail;
+    uint64_t head = LoadAcquire(&control->commit_head);
+    uint64_t bytes = 0;
+    unsigned int n = 0;
+    while ((n < count) && (pos != head))
+    {
+        UINT32 header = *((const UINT32*)(ring_buffer + (pos & ring_mask)));
+        unsigned int length = header & RECORD_LENGTH_MASK;
+        if (0 != (header & RECORD_PAD))
+        {
+            pos += length;
+            continue;
+        }
+        pos += RecordSize(length);
+        bytes += length;
+        n++;
+    }
+    if (0 == n) return;
+    __atomic_store_n(&control->msg_count, control->msg_count + n, __ATOMIC_RELAXED);
+    __atomic_store_n(&control->byte_count, control->byte_count + bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&control->consumer_tail, pos, __ATOMIC_SEQ_CST);
+    // Wake producers waiting for space (one semaphore count each)
+    if (0 != __atomic_load_n(&control->space_waiters, __ATOMIC_SEQ_CST))
+    {
+        UINT32 waiters = __atomic_exchange_n(&control->space_waiters, 0, __ATOMIC_SEQ_CST);
+        if (0 != waiters) Signal(space_signal_fd, waiters);
+    }
+}  // end ProtoShmRing::Consume()
+
+bool ProtoShmRing::StartOutputNotification()
+{
+    if (!IsProducer())
+    {
+        PLOG(PL_ERROR, "ProtoShmRing::StartOutputNotification() error: not connected as producer\n");
+        return false;
+    }
+    if (!output_wanted)
+    {
+        output_wanted = true;
+        Signal(space_signal_fd, 1);  // (a first NOTIFY_OUTPUT to get things started)
+    }
+    return true;
+}  // end ProtoShmRing::StartOutputNotification()
+
+void ProtoShmRing::StopOutputNotification()
+{
+    output_wanted = false;
+}  // end ProtoShmRing::StopOutputNotification()
+
+void ProtoShmRing::OnNotify(NotifyFlag theFlag)
+{
+    if (NOTIFY_INPUT != theFlag)
+    {
+        ProtoChannel::OnNotify(theFlag);
+        return;
+    }
+    if (is_consumer)
+    {
+        Drain(data_wait_fd, false);
+        ProtoChannel::OnNotify(NOTIFY_INPUT);
+        // If the listener left messages behind, keep notifying (i.e.,
+        // "level-triggered" as for sockets), else re-arm the wakeup
+        uint64_t tail, head;
+        if (IsOpen() && Pending(tail, head))
+            Signal(data_signal_fd, 1);
+    }
+    else
+    {
+        Drain(space_wait_fd, true);
+        space_armed = false;
+        if (0 != __atomic_load_n(&control->consumer_closed, __ATOMIC_RELAXED))
+        {
+            ProtoChannel::OnNotify(NOTIFY_ERROR);
+            return;
+        }
+        if (output_wanted)
+        {
+            ProtoChannel::OnNotify(NOTIFY_OUTPUT);
+            // Keep notifying while output is wanted and space remains
+            if (IsOpen() && output_wanted && !space_armed)
+                Signal(space_signal_fd, 1);
+        }
+    }
+}  // end ProtoShmRing::OnNotify()
+
+#endif // !WIN32
@@ -105,7 +105,7 @@ bool ProtoSocket::Shutdown()
 bool ProtoSocket::Bind(UINT16 thePort, const ProtoAddress* /*localAddress*/)
 {
 
-	if (!IsOpen()) Open(thePort, ProtoAddress::SIM, FALSE);  // I.T. Added 24/3/07
+	if (!IsOpen()) Open(thePort, ProtoAddress::SIM, false);  // I.T. Added 24/3/07
 	
 //    if (IsOpen() && (port < 0)) 
 //    {
@@ -127,7 +127,7 @@ bool ProtoSocket::Bind(UINT16 thePort, const ProtoAddress* /*localAddress*/)
 
 bool ProtoSocket::Connect(const ProtoAddress& theAddress)
 {
-	if (!IsOpen()) Open(0, ProtoAddress::SIM, TRUE);  // I.T. Added 24/3/07 - use 0, as default port if not set
+	if (!IsOpen()) Open(0, ProtoAddress::SIM, true);  // I.T. Added 24/3/07 - use 0, as default port if not set
 
     state = CONNECTING; // the CONNECT is generated from the CONNECT Event
 
@@ -156,7 +156,7 @@ void ProtoSocket::Disconnect()
 
 bool ProtoSocket::Listen(UINT16 thePort)
 {
-	if (!IsOpen()) Open(thePort, ProtoAddress::SIM, TRUE);  // I.T. Added 24/3/07
+	if (!IsOpen()) Open(thePort, ProtoAddress::SIM, true);  // I.T. Added 24/3/07
 
 	state = LISTENING;  // I.T. Added 27/3/07
 	
@@ -220,7 +220,7 @@ bool ProtoSocket::Recv(char*            buffer,
 }  // end ProtoSocket::Recv()
 
 bool ProtoSocket::SendTo(const char*         buffer, 
-                         unsigned int        buflen,
+                         unsigned int&       buflen,
                          const ProtoAddress& dstAddr)
 {
     if (!IsOpen())
@@ -408,6 +408,11 @@ unsigned int ProtoSocket::GetTxBufferSize()
     return static_cast<ProtoSimAgent::SocketProxy*>(handle)->GetTxBufferSize(); // I.T. Added 26/3/07
 }  // end ProtoSocket::GetTxBufferSize()
 
+bool ProtoSocket::SetMaxPacingRate(double /*bitsPerSecond*/)
+{
+    return false;  // no kernel pacing in simulation
+}  // end ProtoSocket::SetMaxPacingRate()
+
 bool ProtoSocket::SetRxBufferSize(unsigned int bufferSize)
 {   
     static_cast<ProtoSimAgent::SocketProxy*>(handle)->SetRxBufferSize(bufferSize); // I.T. Added 26/3/07
@@ -442,7 +447,7 @@ bool ProtoSocket::UpdateNotification()
 		return static_cast<ProtoSimAgent::SocketProxy*>(handle)->SetOutputNotification(notify_output); // I.T. Added 26/3/07
 }  // end ProtoSocket::UpdateNotification()
 
-void ProtoSocket::OnNotify(ProtoSocket::Flag theFlag)
+void ProtoSocket::OnNotify(ProtoNotify::NotifyFlag theFlag)
 {
 #ifndef OPNET // JPH 5/18/2007
 
@@ -65,6 +65,7 @@ typedef UINT32 in_addr_t;
 #include "protoSocket.h"
 #include "protoNet.h"
 #include "protoDebug.h"
+#include "protoTrace.h"
 
 // Hack for using with NRL IPSEC implementation
 #ifdef HAVE_NETSEC
@@ -631,6 +632,7 @@ bool ProtoSocket::UpdateNotification()
 
 void ProtoSocket::OnNotify(NotifyFlag theFlag)
 {
+    PROTO_TRACE_SCOPE("socket", "OnNotify");
     ProtoSocket::Event event = INVALID_EVENT;
     if (NOTIFY_INPUT == theFlag)
     {
@@ -1303,6 +1305,7 @@ bool ProtoSocket::Accept(ProtoSocket* newSocket)
 bool ProtoSocket::Send(const char*         buffer, 
                        unsigned int&       numBytes)
 {
+    PROTO_TRACE_SCOPE("socket", "Send");
     //TRACE("ProtoSocket::Send() ...\n");
     if (IsConnected())
     {
@@ -1406,6 +1409,7 @@ bool ProtoSocket::Send(const char*         buffer,
 bool ProtoSocket::Recv(char*            buffer, 
                        unsigned int&    numBytes)
 {
+    PROTO_TRACE_SCOPE("socket", "Recv");
 #ifdef WIN32
     WSABUF recvBuf;
     recvBuf.buf = buffer;
@@ -1500,6 +1504,7 @@ bool ProtoSocket::SendTo(const char*         buffer,
                          unsigned int&       buflen,
                          const ProtoAddress& dstAddr)
 {
+    PROTO_TRACE_SCOPE("socket", "SendTo");
     if (!IsOpen())
     {
         if (!Open(0, dstAddr.GetType()))
@@ -1599,6 +1604,7 @@ bool ProtoSocket::RecvFrom(char*            buffer,
                            unsigned int&    numBytes, 
                            ProtoAddress&    sourceAddr)
 {
+    PROTO_TRACE_SCOPE("socket", "RecvFrom");
 	if (!IsBound())
     {
         PLOG(PL_ERROR, "ProtoSocket::RecvFrom() error: socket not bound\n");
@@ -1715,6 +1721,7 @@ bool ProtoSocket::RecvFrom(char*            buffer,
                            ProtoAddress&    sourceAddr,
                            ProtoAddress&    destAddr)
 {
+    PROTO_TRACE_SCOPE("socket", "RecvFrom");
     if (!IsBound())
     {
         PLOG(PL_ERROR, "ProtoSocket::RecvFrom() error: socket not bound\n");
@@ -1829,6 +1836,7 @@ bool ProtoSocket::RecvFrom(char*            buffer,
                            ProtoAddress&    sourceAddr,
                            ProtoAddress&    destAddr)
 {
+    PROTO_TRACE_SCOPE("socket", "RecvFrom");
 	if (!IsBound())
     {
         PLOG(PL_ERROR, "ProtoSocket::RecvFrom() error: socket not bound\n");
@@ -2806,6 +2814,34 @@ unsigned int ProtoSocket::GetTxBufferSize()
     return ((unsigned int)txBufferSize);
 }  // end ProtoSocket::GetTxBufferSize()
 
+bool ProtoSocket::SetMaxPacingRate(double bitsPerSecond)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoSocket::SetMaxPacingRate() error: socket closed\n");
+        return false;
+    }
+#ifdef SO_MAX_PACING_RATE
+    // The kernel pacing rate is in bytes/sec (~0U means unlimited)
+    unsigned int pacingRate = ~0U;
+    if (bitsPerSecond > 0.0)
+    {
+        double bytesPerSecond = bitsPerSecond / 8.0;
+        pacingRate = (bytesPerSecond < (double)(~0U)) ? (unsigned int)bytesPerSecond : (~0U - 1);
+    }
+    if (setsockopt(handle, SOL_SOCKET, SO_MAX_PACING_RATE, (char*)&pacingRate, sizeof(pacingRate)) < 0)
+    {
+        PLOG(PL_ERROR, "ProtoSocket::SetMaxPacingRate() setsockopt(SO_MAX_PACING_RATE) error: %s\n",
+                GetErrorString());
+        return false;
+    }
+    return true;
+#else
+    PLOG(PL_WARN, "ProtoSocket::SetMaxPacingRate() warning: SO_MAX_PACING_RATE not supported\n");
+    return false;
+#endif // if/else SO_MAX_PACING_RATE
+}  // end ProtoSocket::SetMaxPacingRate()
+
 bool ProtoSocket::SetRxBufferSize(unsigned int bufferSize)
 {
    if (!IsOpen())
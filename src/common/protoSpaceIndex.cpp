@@ -0,0 +1,947 @@
+/**
+* @file protoSpaceIndex.cpp
+*
+* @brief Uniform grid spatial index for ProtoSpace::Node radius and
+* k-nearest neighbor queries
+*/
+
+#include "protoSpaceIndex.h"
+#include "protoHash.h"
+#include "protoThread.h"
+#include "protoDebug.h"
+
+#include <math.h>    // for floor(), sqrt()
+#include <stdlib.h>  // for qsort()
+#include <string.h>  // for memcpy()
+
+// Cell coordinates are clamped to this range
+static const INT32 CELL_COORD_MAX = 0x3fffffff;
+static const unsigned int TABLE_SIZE_MIN = 64;
+
+static inline UINT32 HashCellCoord(const INT32* coord, unsigned int dim)
+{
+    return ProtoHash::Words((const UINT32*)coord, dim);
+}  // end HashCellCoord()
+
+static inline UINT32 HashNode(const void* ptr)
+{
+    size_t value = (size_t)ptr;
+    return ProtoHash::Final((UINT32)(value >> 4) ^ (UINT32)((value >> 16) >> 16));
+}  // end HashNode()
+
+static inline unsigned int TableSize(unsigned int minSize)
+{
+    unsigned int size = TABLE_SIZE_MIN;
+    while (size < minSize) size <<= 1;
+    return size;
+}  // end TableSize()
+
+// Used to sort cells into row-major order
+struct CellOrder
+{
+    INT32   coord[ProtoSpaceIndex::DIMENSIONS_MAX];
+    INT32   index;
+};
+
+static int CompareCellOrder(const void* a, const void* b)
+{
+    const INT32* ca = static_cast<const CellOrder*>(a)->coord;
+    const INT32* cb = static_cast<const CellOrder*>(b)->coord;
+    for (int i = ProtoSpaceIndex::DIMENSIONS_MAX - 1; i >= 0; i--)
+    {
+        if (ca[i] != cb[i]) return ((ca[i] < cb[i]) ? -1 : 1);
+    }
+    return 0;
+}  // end CompareCellOrder()
+
+ProtoSpaceIndex::ProtoSpaceIndex(double cellSize)
+ : cell_size((cellSize > 0.0) ? cellSize : 1.0), cell_scale(1.0 / cell_size),
+   num_dimensions(0), entry_list(NULL), entry_count(0), entry_max(0),
+   cell_table(NULL), cell_mask(0), cell_used(0), node_table(NULL), node_mask(0)
+{
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        cell_min[i] = CELL_COORD_MAX;
+        cell_max[i] = -CELL_COORD_MAX;
+    }
+}
+
+ProtoSpaceIndex::~ProtoSpaceIndex()
+{
+    Destroy();
+}
+
+void ProtoSpaceIndex::Empty()
+{
+    entry_count = 0;
+    if (NULL != cell_table)
+    {
+        for (unsigned int i = 0; i <= cell_mask; i++)
+            cell_table[i].used = false;
+    }
+    cell_used = 0;
+    if (NULL != node_table)
+    {
+        for (unsigned int i = 0; i <= node_mask; i++)
+            node_table[i].node = NULL;
+    }
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        cell_min[i] = CELL_COORD_MAX;
+        cell_max[i] = -CELL_COORD_MAX;
+    }
+}  // end ProtoSpaceIndex::Empty()
+
+void ProtoSpaceIndex::Destroy()
+{
+    Empty();
+    if (NULL != entry_list)
+    {
+        delete[] entry_list;
+        entry_list = NULL;
+    }
+    entry_max = 0;
+    if (NULL != cell_table)
+    {
+        delete[] cell_table;
+        cell_table = NULL;
+    }
+    cell_mask = 0;
+    if (NULL != node_table)
+    {
+        delete[] node_table;
+        node_table = NULL;
+    }
+    node_mask = 0;
+    num_dimensions = 0;
+}  // end ProtoSpaceIndex::Destroy()
+
+bool ProtoSpaceIndex::SetCellSize(double cellSize)
+{
+    if (cellSize <= 0.0)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::SetCellSize() error: invalid cell size\n");
+        return false;
+    }
+    cell_size = cellSize;
+    cell_scale = 1.0 / cellSize;
+    if (0 == entry_count) return true;
+    // Re-grid the current node set
+    ProtoSpace::Node** nodeList = new ProtoSpace::Node*[entry_count];
+    if (NULL == nodeList)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::SetCellSize() new nodeList error: %s\n", GetErrorString());
+        return false;
+    }
+    unsigned int nodeCount = entry_count;
+    for (unsigned int i = 0; i < nodeCount; i++)
+        nodeList[i] = entry_list[i].node;
+    bool result = Rebuild(nodeList, nodeCount);
+    delete[] nodeList;
+    return result;
+}  // end ProtoSpaceIndex::SetCellSize()
+
+bool ProtoSpaceIndex::SetDimensions(const ProtoSpace::Node& node)
+{
+    unsigned int numDimensions = node.GetDimensions();
+    if (0 == num_dimensions)
+    {
+        if ((0 == numDimensions) || (numDimensions > DIMENSIONS_MAX))
+        {
+            PLOG(PL_ERROR, "ProtoSpaceIndex::SetDimensions() error: unsupported node dimensions\n");
+            return false;
+        }
+        num_dimensions = numDimensions;
+    }
+    else if (numDimensions != num_dimensions)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::SetDimensions() error: node dimensions do not match index!\n");
+        return false;
+    }
+    return true;
+}  // end ProtoSpaceIndex::SetDimensions()
+
+bool ProtoSpaceIndex::ReserveEntries(unsigned int count)
+{
+    if (count > entry_max)
+    {
+        unsigned int newMax = (0 != entry_max) ? entry_max : 256;
+        while (newMax < count) newMax <<= 1;
+        Entry* newList = new Entry[newMax];
+        if (NULL == newList)
+        {
+            PLOG(PL_ERROR, "ProtoSpaceIndex::ReserveEntries() new entry_list error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL != entry_list)
+        {
+            memcpy(newList, entry_list, entry_count*sizeof(Entry));
+            delete[] entry_list;
+        }
+        entry_list = newList;
+        entry_max = newMax;
+    }
+    // Keep node table load at or below 1/2
+    if ((NULL == node_table) || ((node_mask + 1) < (2 * entry_max)))
+        return ResizeNodeTable(2 * entry_max);
+    return true;
+}  // end ProtoSpaceIndex::ReserveEntries()
+
+void ProtoSpaceIndex::LoadPosition(Entry& entry) const
+{
+    unsigned int i = 0;
+    for (; i < num_dimensions; i++)
+        entry.pos[i] = entry.node->GetOrdinate(i);
+    for (; i < DIMENSIONS_MAX; i++)
+        entry.pos[i] = 0.0;
+}  // end ProtoSpaceIndex::LoadPosition()
+
+// ("pos" must be zero-padded to DIMENSIONS_MAX)
+void ProtoSpaceIndex::GetCellCoord(const double* pos, INT32* coord) const
+{
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        double c = floor(pos[i] * cell_scale);
+        if (c > (double)CELL_COORD_MAX)
+            coord[i] = CELL_COORD_MAX;
+        else if (c < (double)(-CELL_COORD_MAX))
+            coord[i] = -CELL_COORD_MAX;
+        else
+            coord[i] = (INT32)c;
+    }
+}  // end ProtoSpaceIndex::GetCellCoord()
+
+INT32 ProtoSpaceIndex::FindCell(const INT32* coord) const
+{
+    if (NULL == cell_table) return -1;
+    unsigned int index = HashCellCoord(coord, num_dimensions) & cell_mask;
+    while (cell_table[index].used)
+    {
+        const Cell& cell = cell_table[index];
+        unsigned int i = 0;
+        while ((i < num_dimensions) && (cell.coord[i] == coord[i])) i++;
+        if (i == num_dimensions) return (INT32)index;
+        index = (index + 1) & cell_mask;
+    }
+    return -1;
+}  // end ProtoSpaceIndex::FindCell()
+
+// Finds or adds the cell for the given coordinates
+INT32 ProtoSpaceIndex::GetCell(const INT32* coord)
+{
+    INT32 index = FindCell(coord);
+    if (index >= 0) return index;
+    if ((NULL == cell_table) || ((2 * (cell_used + 1)) > (cell_mask + 1)))
+    {
+        if (!ResizeCellTable(2 * (cell_used + 1))) return -1;
+    }
+    unsigned int slot = HashCellCoord(coord, num_dimensions) & cell_mask;
+    while (cell_table[slot].used) slot = (slot + 1) & cell_mask;
+    Cell& cell = cell_table[slot];
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        if (i < num_dimensions)
+        {
+            cell.coord[i] = coord[i];
+            if (coord[i] < cell_min[i]) cell_min[i] = coord[i];
+            if (coord[i] > cell_max[i]) cell_max[i] = coord[i];
+        }
+        else
+        {
+            cell.coord[i] = 0;
+        }
+    }
+    cell.head = -1;
+    cell.count = 0;
+    cell.used = true;
+    cell_used++;
+    return (INT32)slot;
+}  // end ProtoSpaceIndex::GetCell()
+
+// Rehashes the occupied (non-empty) cells into a new table, dropping
+// cells that nodes have moved out of.  (Entries in transit, i.e. unlinked,
+// are not updated and must be re-linked by the caller)
+bool ProtoSpaceIndex::ResizeCellTable(unsigned int minSize)
+{
+    unsigned int occupied = 0;
+    if (NULL != cell_table)
+    {
+        for (unsigned int i = 0; i <= cell_mask; i++)
+            if (cell_table[i].used && (0 != cell_table[i].count)) occupied++;
+    }
+    if (minSize < (4 * (occupied + 1))) minSize = 4 * (occupied + 1);
+    unsigned int newSize = TableSize(minSize);
+    Cell* newTable = new Cell[newSize];
+    if (NULL == newTable)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::ResizeCellTable() new cell_table error: %s\n", GetErrorString());
+        return false;
+    }
+    for (unsigned int i = 0; i < newSize; i++)
+        newTable[i].used = false;
+    unsigned int newMask = newSize - 1;
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        cell_min[i] = CELL_COORD_MAX;
+        cell_max[i] = -CELL_COORD_MAX;
+    }
+    if (NULL != cell_table)
+    {
+        for (unsigned int i = 0; i <= cell_mask; i++)
+        {
+            const Cell& cell = cell_table[i];
+            if (!cell.used || (0 == cell.count)) continue;
+            unsigned int slot = HashCellCoord(cell.coord, num_dimensions) & newMask;
+            while (newTable[slot].used) slot = (slot + 1) & newMask;
+            newTable[slot] = cell;
+            for (INT32 e = cell.head; e >= 0; e = entry_list[e].next)
+                entry_list[e].cell = (INT32)slot;
+            for (unsigned int d = 0; d < num_dimensions; d++)
+            {
+                if (cell.coord[d] < cell_min[d]) cell_min[d] = cell.coord[d];
+                if (cell.coord[d] > cell_max[d]) cell_max[d] = cell.coord[d];
+            }
+        }
+        delete[] cell_table;
+    }
+    cell_table = newTable;
+    cell_mask = newMask;
+    cell_used = occupied;
+    return true;
+}  // end ProtoSpaceIndex::ResizeCellTable()
+
+void ProtoSpaceIndex::LinkEntry(INT32 index, INT32 cellIndex)
+{
+    Entry& entry = entry_list[index];
+    Cell& cell = cell_table[cellIndex];
+    entry.cell = cellIndex;
+    entry.prev = -1;
+    entry.next = cell.head;
+    if (cell.head >= 0) entry_list[cell.head].prev = index;
+    cell.head = index;
+    cell.count++;
+}  // end ProtoSpaceIndex::LinkEntry()
+
+void ProtoSpaceIndex::UnlinkEntry(INT32 index)
+{
+    Entry& entry = entry_list[index];
+    Cell& cell = cell_table[entry.cell];
+    if (entry.prev >= 0)
+        entry_list[entry.prev].next = entry.next;
+    else
+        cell.head = entry.next;
+    if (entry.next >= 0) entry_list[entry.next].prev = entry.prev;
+    cell.count--;
+    entry.cell = entry.prev = entry.next = -1;
+}  // end ProtoSpaceIndex::UnlinkEntry()
+
+// Links entry into the cell for its cached position
+bool ProtoSpaceIndex::PlaceEntry(INT32 index)
+{
+    INT32 coord[DIMENSIONS_MAX];
+    GetCellCoord(entry_list[index].pos, coord);
+    INT32 cellIndex = GetCell(coord);
+    if (cellIndex < 0) return false;
+    LinkEntry(index, cellIndex);
+    return true;
+}  // end ProtoSpaceIndex::PlaceEntry()
+
+// Reloads the entry position, moving it to a new cell as needed
+bool ProtoSpaceIndex::RefreshEntry(INT32 index)
+{
+    Entry& entry = entry_list[index];
+    LoadPosition(entry);
+    INT32 coord[DIMENSIONS_MAX];
+    GetCellCoord(entry.pos, coord);
+    const INT32* cellCoord = cell_table[entry.cell].coord;
+    unsigned int i = 0;
+    while ((i < num_dimensions) && (cellCoord[i] == coord[i])) i++;
+    if (i == num_dimensions) return true;  // same cell
+    UnlinkEntry(index);
+    INT32 cellIndex = GetCell(coord);
+    if (cellIndex < 0)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::RefreshEntry() error: unable to add cell\n");
+        RemoveNode(*entry.node);
+        return false;
+    }
+    LinkEntry(index, cellIndex);
+    return true;
+}  // end ProtoSpaceIndex::RefreshEntry()
+
+bool ProtoSpaceIndex::ResizeNodeTable(unsigned int minSize)
+{
+    unsigned int newSize = TableSize(minSize);
+    NodeSlot* newTable = new NodeSlot[newSize];
+    if (NULL == newTable)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::ResizeNodeTable() new node_table error: %s\n", GetErrorString());
+        return false;
+    }
+    if (NULL != node_table) delete[] node_table;
+    node_table = newTable;
+    node_mask = newSize - 1;
+    for (unsigned int i = 0; i < newSize; i++)
+        node_table[i].node = NULL;
+    for (unsigned int i = 0; i < entry_count; i++)
+        MapNode(entry_list[i].node, (INT32)i);
+    return true;
+}  // end ProtoSpaceIndex::ResizeNodeTable()
+
+INT32 ProtoSpaceIndex::FindEntry(const ProtoSpace::Node* node) const
+{
+    if (NULL == node_table) return -1;
+    unsigned int index = HashNode(node) & node_mask;
+    while (NULL != node_table[index].node)
+    {
+        if (node == node_table[index].node) return node_table[index].entry;
+        index = (index + 1) & node_mask;
+    }
+    return -1;
+}  // end ProtoSpaceIndex::FindEntry()
+
+// Adds or updates node -> entry mapping (table must have room)
+void ProtoSpaceIndex::MapNode(const ProtoSpace::Node* node, INT32 index)
+{
+    unsigned int slot = HashNode(node) & node_mask;
+    while ((NULL != node_table[slot].node) && (node != node_table[slot].node))
+        slot = (slot + 1) & node_mask;
+    node_table[slot].node = node;
+    node_table[slot].entry = index;
+}  // end ProtoSpaceIndex::MapNode()
+
+void ProtoSpaceIndex::UnmapNode(const ProtoSpace::Node* node)
+{
+    unsigned int i = HashNode(node) & node_mask;
+    while (node != node_table[i].node)
+    {
+        if (NULL == node_table[i].node) return;
+        i = (i + 1) & node_mask;
+    }
+    // Backward shift deletion (no tombstones)
+    unsigned int j = i;
+    for (;;)
+    {
+        j = (j + 1) & node_mask;
+        if (NULL == node_table[j].node) break;
+        unsigned int k = HashNode(node_table[j].node) & node_mask;
+        bool inRange = (i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j));
+        if (inRange) continue;
+        node_table[i] = node_table[j];
+        i = j;
+    }
+    node_table[i].node = NULL;
+}  // end ProtoSpaceIndex::UnmapNode()
+
+bool ProtoSpaceIndex::Rebuild(ProtoSpace::Node* const* nodeList, unsigned int nodeCount)
+{
+    Empty();
+    if (0 == nodeCount) return true;
+    if (!SetDimensions(*nodeList[0])) return false;
+    if (!ReserveEntries(nodeCount)) return false;
+    // Size the cell table for the worst case (one cell per node)
+    if ((NULL == cell_table) || ((cell_mask + 1) < (2 * nodeCount)))
+    {
+        if (!ResizeCellTable(2 * nodeCount)) return false;
+    }
+    Entry* sortList = new Entry[entry_max];
+    if (NULL == sortList)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::Rebuild() new sortList error: %s\n", GetErrorString());
+        return false;
+    }
+    // 1) Load positions and count cell members
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        Entry& entry = entry_list[i];
+        entry.node = nodeList[i];
+        if (entry.node->GetDimensions() != num_dimensions)
+        {
+            PLOG(PL_ERROR, "ProtoSpaceIndex::Rebuild() error: node dimensions do not match index!\n");
+            delete[] sortList;
+            Empty();
+            return false;
+        }
+        LoadPosition(entry);
+        INT32 coord[DIMENSIONS_MAX];
+        GetCellCoord(entry.pos, coord);
+        entry.cell = GetCell(coord);
+        cell_table[entry.cell].count++;
+    }
+    // 2) Assign each cell a contiguous range of entries ("head" is
+    //    temporarily used as the next insertion offset) with cells laid
+    //    out in row-major order so neighboring cells are close in memory
+    CellOrder* cellList = new CellOrder[cell_used];
+    if (NULL == cellList)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::Rebuild() new cellList error: %s\n", GetErrorString());
+        delete[] sortList;
+        Empty();
+        return false;
+    }
+    unsigned int cellCount = 0;
+    for (unsigned int i = 0; i <= cell_mask; i++)
+    {
+        const Cell& cell = cell_table[i];
+        if (!cell.used) continue;
+        CellOrder& item = cellList[cellCount++];
+        memcpy(item.coord, cell.coord, sizeof(item.coord));
+        item.index = (INT32)i;
+    }
+    qsort(cellList, cellCount, sizeof(CellOrder), CompareCellOrder);
+    INT32 offset = 0;
+    for (unsigned int i = 0; i < cellCount; i++)
+    {
+        Cell& cell = cell_table[cellList[i].index];
+        cell.head = offset;
+        offset += (INT32)cell.count;
+    }
+    delete[] cellList;
+    for (unsigned int i = 0; i < nodeCount; i++)
+        sortList[cell_table[entry_list[i].cell].head++] = entry_list[i];
+    delete[] entry_list;
+    entry_list = sortList;
+    entry_count = nodeCount;
+    // 3) Link cell member lists in entry order
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        Entry& entry = entry_list[i];
+        bool first = (0 == i) || (entry_list[i - 1].cell != entry.cell);
+        bool last = ((nodeCount - 1) == i) || (entry_list[i + 1].cell != entry.cell);
+        entry.prev = first ? -1 : (INT32)(i - 1);
+        entry.next = last ? -1 : (INT32)(i + 1);
+        if (first) cell_table[entry.cell].head = (INT32)i;
+        MapNode(entry.node, (INT32)i);
+    }
+    return true;
+}  // end ProtoSpaceIndex::Rebuild()
+
+bool ProtoSpaceIndex::InsertNode(ProtoSpace::Node& node)
+{
+    if (!SetDimensions(node)) return false;
+    if (FindEntry(&node) >= 0) return UpdateNode(node);
+    if (!ReserveEntries(entry_count + 1)) return false;
+    INT32 index = (INT32)entry_count;
+    Entry& entry = entry_list[index];
+    entry.node = &node;
+    LoadPosition(entry);
+    if (!PlaceEntry(index))
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::InsertNode() error: unable to add cell\n");
+        return false;
+    }
+    MapNode(&node, index);
+    entry_count++;
+    return true;
+}  // end ProtoSpaceIndex::InsertNode()
+
+bool ProtoSpaceIndex::RemoveNode(ProtoSpace::Node& node)
+{
+    INT32 index = FindEntry(&node);
+    if (index < 0) return false;
+    if (entry_list[index].cell >= 0) UnlinkEntry(index);
+    UnmapNode(&node);
+    INT32 last = (INT32)entry_count - 1;
+    if (index != last)
+    {
+        // Move last entry into the vacated slot
+        Entry& entry = entry_list[index];
+        entry = entry_list[last];
+        if (entry.prev >= 0)
+            entry_list[entry.prev].next = index;
+        else
+            cell_table[entry.cell].head = index;
+        if (entry.next >= 0) entry_list[entry.next].prev = index;
+        MapNode(entry.node, index);
+    }
+    entry_count--;
+    return true;
+}  // end ProtoSpaceIndex::RemoveNode()
+
+bool ProtoSpaceIndex::UpdateNode(ProtoSpace::Node& node)
+{
+    INT32 index = FindEntry(&node);
+    if (index < 0) return false;
+    return RefreshEntry(index);
+}  // end ProtoSpaceIndex::UpdateNode()
+
+bool ProtoSpaceIndex::Update()
+{
+    bool result = true;
+    INT32 index = 0;
+    while (index < (INT32)entry_count)
+    {
+        // (a failed entry is removed, replaced by the last entry)
+        if (RefreshEntry(index))
+            index++;
+        else
+            result = false;
+    }
+    return result;
+}  // end ProtoSpaceIndex::Update()
+
+void ProtoSpaceIndex::ScanNeighbors(const Cell&                 cell,
+                                    const double*               origin,
+                                    double                      radiusSquared,
+                                    const ProtoSpace::Node*     exclude,
+                                    Neighbor*                   neighborList,
+                                    unsigned int                listMax,
+                                    unsigned int&               found) const
+{
+    for (INT32 index = cell.head; index >= 0; index = entry_list[index].next)
+    {
+        const Entry& entry = entry_list[index];
+        double distSquared = 0.0;
+        for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+        {
+            // (positions are zero-padded to DIMENSIONS_MAX)
+            double delta = entry.pos[i] - origin[i];
+            distSquared += delta*delta;
+        }
+        if ((distSquared > radiusSquared) || (exclude == entry.node)) continue;
+        if (found < listMax)
+        {
+            neighborList[found].node = entry.node;
+            neighborList[found].distance = sqrt(distSquared);
+        }
+        found++;
+    }
+}  // end ProtoSpaceIndex::ScanNeighbors()
+
+unsigned int ProtoSpaceIndex::FindNeighbors(const double*               origin,
+                                            double                      radius,
+                                            Neighbor*                   neighborList,
+                                            unsigned int                listMax,
+                                            const ProtoSpace::Node*     exclude) const
+{
+    if ((0 == entry_count) || (radius < 0.0)) return 0;
+    // Determine the range of cells overlapping the search sphere bounding box
+    double pos[DIMENSIONS_MAX], minPos[DIMENSIONS_MAX], maxPos[DIMENSIONS_MAX];
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+    {
+        pos[i] = (i < num_dimensions) ? origin[i] : 0.0;
+        minPos[i] = pos[i] - radius;
+        maxPos[i] = pos[i] + radius;
+    }
+    INT32 lo[DIMENSIONS_MAX], hi[DIMENSIONS_MAX];
+    GetCellCoord(minPos, lo);
+    GetCellCoord(maxPos, hi);
+    double rangeCells = 1.0;
+    for (unsigned int i = 0; i < num_dimensions; i++)
+    {
+        if (lo[i] < cell_min[i]) lo[i] = cell_min[i];
+        if (hi[i] > cell_max[i]) hi[i] = cell_max[i];
+        if (lo[i] > hi[i]) return 0;
+        rangeCells *= (double)(hi[i] - lo[i] + 1);
+    }
+    double radiusSquared = radius*radius;
+    unsigned int found = 0;
+    if (rangeCells > (double)cell_used)
+    {
+        // The range spans more cells than are in use, so just scan them all
+        for (unsigned int i = 0; i <= cell_mask; i++)
+        {
+            const Cell& cell = cell_table[i];
+            if (cell.used && (0 != cell.count))
+                ScanNeighbors(cell, pos, radiusSquared, exclude, neighborList, listMax, found);
+        }
+        return found;
+    }
+    INT32 coord[DIMENSIONS_MAX];
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+        coord[i] = lo[i];
+    for (;;)
+    {
+        INT32 cellIndex = FindCell(coord);
+        if (cellIndex >= 0)
+            ScanNeighbors(cell_table[cellIndex], pos, radiusSquared, exclude, neighborList, listMax, found);
+        unsigned int d = 0;
+        while (d < num_dimensions)
+        {
+            if (coord[d] < hi[d])
+            {
+                coord[d]++;
+                break;
+            }
+            coord[d] = lo[d];
+            d++;
+        }
+        if (d == num_dimensions) break;
+    }
+    return found;
+}  // end ProtoSpaceIndex::FindNeighbors()
+
+// Merges cell members into the "neighborList" (kept sorted by increasing
+// squared distance) of the "k" closest nodes found so far
+void ProtoSpaceIndex::ScanNearest(INT32                     cellIndex,
+                                  const double*             origin,
+                                  unsigned int              k,
+                                  const ProtoSpace::Node*   exclude,
+                                  Neighbor*                 neighborList,
+                                  unsigned int&             found) const
+{
+    for (INT32 index = cell_table[cellIndex].head; index >= 0; index = entry_list[index].next)
+    {
+        const Entry& entry = entry_list[index];
+        if (exclude == entry.node) continue;
+        double distSquared = 0.0;
+        for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+        {
+            // (positions are zero-padded to DIMENSIONS_MAX)
+            double delta = entry.pos[i] - origin[i];
+            distSquared += delta*delta;
+        }
+        unsigned int j;
+        if (found < k)
+        {
+            j = found++;
+        }
+        else if (distSquared < neighborList[k - 1].distance)
+        {
+            j = k - 1;
+        }
+        else
+        {
+            continue;
+        }
+        while ((j > 0) && (neighborList[j - 1].distance > distSquared))
+        {
+            neighborList[j] = neighborList[j - 1];
+            j--;
+        }
+        neighborList[j].node = entry.node;
+        neighborList[j].distance = distSquared;
+    }
+}  // end ProtoSpaceIndex::ScanNearest()
+
+unsigned int ProtoSpaceIndex::FindNearest(const double*             origin,
+                                          unsigned int              k,
+                                          Neighbor*                 neighborList,
+                                          const ProtoSpace::Node*   exclude) const
+{
+    if ((0 == k) || (0 == entry_count)) return 0;
+    double pos[DIMENSIONS_MAX];
+    for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+        pos[i] = (i < num_dimensions) ? origin[i] : 0.0;
+    INT32 center[DIMENSIONS_MAX];
+    GetCellCoord(pos, center);
+    unsigned int found = 0;
+    // Search successive "rings" (cube shells) of cells about the origin cell
+    // until the k-th closest node found is closer than any unvisited cell
+    for (INT32 ring = 0; ; ring++)
+    {
+        double ringCells = 1.0;
+        bool covered = true;  // true when ring range includes all used cells
+        bool empty = false;   // true when ring range misses all used cells
+        INT32 lo[DIMENSIONS_MAX], hi[DIMENSIONS_MAX];
+        for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+        {
+            if (i >= num_dimensions)
+            {
+                lo[i] = hi[i] = 0;  // (unused)
+                continue;
+            }
+            ringCells *= (double)(2*ring + 1);
+            lo[i] = center[i] - ring;
+            hi[i] = center[i] + ring;
+            if ((lo[i] > cell_min[i]) || (hi[i] < cell_max[i])) covered = false;
+            if (lo[i] < cell_min[i]) lo[i] = cell_min[i];
+            if (hi[i] > cell_max[i]) hi[i] = cell_max[i];
+            if (lo[i] > hi[i]) empty = true;
+        }
+        if (ringCells > (double)cell_used)
+        {
+            // Searching further by ring would visit more cells than
+            // are in use, so just scan them all instead
+            found = 0;
+            for (unsigned int i = 0; i <= cell_mask; i++)
+            {
+                if (cell_table[i].used && (0 != cell_table[i].count))
+                    ScanNearest((INT32)i, pos, k, exclude, neighborList, found);
+            }
+            break;
+        }
+        if (!empty)
+        {
+            INT32 coord[DIMENSIONS_MAX];
+            for (unsigned int i = 0; i < DIMENSIONS_MAX; i++)
+                coord[i] = lo[i];
+            for (;;)
+            {
+                bool shell = false;
+                for (unsigned int i = 0; i < num_dimensions; i++)
+                {
+                    if ((coord[i] == (center[i] - ring)) || (coord[i] == (center[i] + ring)))
+                    {
+                        shell = true;
+                        break;
+                    }
+                }
+                if (shell)
+                {
+                    INT32 cellIndex = FindCell(coord);
+                    if (cellIndex >= 0)
+                        ScanNearest(cellIndex, pos, k, exclude, neighborList, found);
+                }
+                else
+                {
+                    // Skip over interior (already visited) cells in this row
+                    INT32 jump = center[0] + ring - 1;
+                    if (jump > coord[0]) coord[0] = (jump < hi[0]) ? jump : hi[0];
+                }
+                unsigned int d = 0;
+                while (d < num_dimensions)
+                {
+                    if (coord[d] < hi[d])
+                    {
+                        coord[d]++;
+                        break;
+                    }
+                    coord[d] = lo[d];
+                    d++;
+                }
+                if (d == num_dimensions) break;
+            }
+        }
+        if (covered) break;
+        // Unvisited cells are at least "ring" cells away from the origin
+        if (found == k)
+        {
+            double reach = (double)ring * cell_size;
+            if (neighborList[k - 1].distance <= (reach * reach)) break;
+        }
+    }
+    for (unsigned int i = 0; i < found; i++)
+        neighborList[i].distance = sqrt(neighborList[i].distance);
+    return found;
+}  // end ProtoSpaceIndex::FindNearest()
+
+// A contiguous range of batch queries, run in its own thread
+class ProtoSpaceIndex::BatchJob : public ProtoThread
+{
+    public:
+        const ProtoSpaceIndex*      index;
+        ProtoSpace::Node* const*    query_list;
+        unsigned int                query_start;
+        unsigned int                query_end;
+        double                      radius;     // (< 0.0 for k-nearest queries)
+        unsigned int                list_max;   // (or "k")
+        Neighbor*                   result_list;
+        unsigned int*               count_list;
+
+        int RunThread()
+        {
+            Run();
+            return 0;
+        }
+        void Run()
+        {
+            unsigned int numDimensions = index->num_dimensions;
+            for (unsigned int q = query_start; q < query_end; q++)
+            {
+                ProtoSpace::Node* node = query_list[q];
+                double origin[DIMENSIONS_MAX];
+                for (unsigned int i = 0; i < numDimensions; i++)
+                    origin[i] = node->GetOrdinate(i);
+                Neighbor* neighborList = result_list + ((size_t)q * list_max);
+                if (radius < 0.0)
+                    count_list[q] = index->FindNearest(origin, list_max, neighborList, node);
+                else
+                    count_list[q] = index->FindNeighbors(origin, radius, neighborList, list_max, node);
+            }
+        }
+};  // end class ProtoSpaceIndex::BatchJob
+
+bool ProtoSpaceIndex::RunBatch(BatchJob* jobList, unsigned int numThreads) const
+{
+    // Job 0 is run by the calling thread.  (If a thread cannot
+    // be created, its job is run by the calling thread as well)
+    for (unsigned int i = 1; i < numThreads; i++)
+    {
+        BatchJob& job = jobList[i];
+        if (!job.StartThread())
+        {
+            PLOG(PL_WARN, "ProtoSpaceIndex::RunBatch() warning: unable to start thread\n");
+            job.Run();
+        }
+    }
+    jobList[0].Run();
+    for (unsigned int i = 1; i < numThreads; i++)
+    {
+        BatchJob& job = jobList[i];
+        if (job.IsStarted()) job.StopThread();  // (joins the thread)
+    }
+    return true;
+}  // end ProtoSpaceIndex::RunBatch()
+
+bool ProtoSpaceIndex::FindNeighborsBatch(ProtoSpace::Node* const*   queryList,
+                                         unsigned int               queryCount,
+                                         double                     radius,
+                                         Neighbor*                  resultList,
+                                         unsigned int               listMax,
+                                         unsigned int*              countList,
+                                         unsigned int               numThreads) const
+{
+    if (radius < 0.0)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::FindNeighborsBatch() error: invalid radius\n");
+        return false;
+    }
+    if (0 == queryCount) return true;
+    if (0 == numThreads) numThreads = 1;
+    if (numThreads > queryCount) numThreads = queryCount;
+    BatchJob* jobList = new BatchJob[numThreads];
+    if (NULL == jobList)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::FindNeighborsBatch() new jobList error: %s\n", GetErrorString());
+        return false;
+    }
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        BatchJob& job = jobList[i];
+        job.index = this;
+        job.query_list = queryList;
+        job.query_start = (unsigned int)(((size_t)queryCount * i) / numThreads);
+        job.query_end = (unsigned int)(((size_t)queryCount * (i + 1)) / numThreads);
+        job.radius = radius;
+        job.list_max = listMax;
+        job.result_list = resultList;
+        job.count_list = countList;
+    }
+    bool result = RunBatch(jobList, numThreads);
+    delete[] jobList;
+    return result;
+}  // end ProtoSpaceIndex::FindNeighborsBatch()
+
+bool ProtoSpaceIndex::FindNearestBatch(ProtoSpace::Node* const* queryList,
+                                       unsigned int             queryCount,
+                                       unsigned int             k,
+                                       Neighbor*                resultList,
+                                       unsigned int*            countList,
+                                       unsigned int             numThreads) const
+{
+    if (0 == queryCount) return true;
+    if (0 == numThreads) numThreads = 1;
+    if (numThreads > queryCount) numThreads = queryCount;
+    BatchJob* jobList = new BatchJob[numThreads];
+    if (NULL == jobList)
+    {
+        PLOG(PL_ERROR, "ProtoSpaceIndex::FindNearestBatch() new jobList error: %s\n", GetErrorString());
+        return false;
+    }
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        BatchJob& job = jobList[i];
+        job.index = this;
+        job.query_list = queryList;
+        job.query_start = (unsigned int)(((size_t)queryCount * i) / numThreads);
+        job.query_end = (unsigned int)(((size_t)queryCount * (i + 1)) / numThreads);
+        job.radius = -1.0;
+        job.list_max = k;
+        job.result_list = resultList;
+        job.count_list = countList;
+    }
+    bool result = RunBatch(jobList, numThreads);
+    delete[] jobList;
+    return result;
+}  // end ProtoSpaceIndex::FindNearestBatch()
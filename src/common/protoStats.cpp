@@ -0,0 +1,308 @@
+/**
+* @file protoStats.cpp
+*
+* @brief Fixed-memory streaming statistics (summary, EWMA, histogram and quantile estimators)
+*/
+#include "protoStats.h"
+#include "protoAtomic.h"
+#include "protoDebug.h"
+
+#include <math.h>    // for sqrt()
+#include <string.h>  // for memset()
+
+ProtoStats::Summary::Summary()
+{
+    Reset();
+}
+
+void ProtoStats::Summary::Reset()
+{
+    count = 0;
+    min_value = max_value = 0.0;
+    mean = m2 = 0.0;
+}  // end ProtoStats::Summary::Reset()
+
+void ProtoStats::Summary::Add(double value)
+{
+    if (0 == count)
+    {
+        min_value = max_value = value;
+    }
+    else if (value < min_value)
+    {
+        min_value = value;
+    }
+    else if (value > max_value)
+    {
+        max_value = value;
+    }
+    count++;
+    // Welford's update (numerically stable, no running sum to overflow)
+    double delta = value - mean;
+    mean += delta / (double)count;
+    m2 += delta * (value - mean);
+}  // end ProtoStats::Summary::Add()
+
+void ProtoStats::Summary::Merge(const Summary& other)
+{
+    if (0 == other.count) return;
+    if (0 == count)
+    {
+        *this = other;
+        return;
+    }
+    if (other.min_value < min_value) min_value = other.min_value;
+    if (other.max_value > max_value) max_value = other.max_value;
+    double total = (double)count + (double)other.count;
+    double delta = other.mean - mean;
+    mean += delta * ((double)other.count / total);
+    m2 += other.m2 + delta * delta * ((double)count * (double)other.count / total);
+    count += other.count;
+}  // end ProtoStats::Summary::Merge()
+
+double ProtoStats::Summary::GetStdDev() const
+{
+    return sqrt(GetVariance());
+}  // end ProtoStats::Summary::GetStdDev()
+
+ProtoStats::Ewma::Ewma(double gain)
+ : ewma_gain(gain), valid(false), mean(0.0), variance(0.0)
+{
+}
+
+double ProtoStats::Ewma::GetStdDev() const
+{
+    return sqrt(variance);
+}  // end ProtoStats::Ewma::GetStdDev()
+
+ProtoStats::Histogram::Histogram()
+ : unit(1.0), unit_scale(1.0), precision_bits(0), sub_count(1), max_units(0),
+   bucket_list(NULL), bucket_count(0)
+{
+    Reset();
+}
+
+ProtoStats::Histogram::~Histogram()
+{
+    Destroy();
+}
+
+bool ProtoStats::Histogram::Init(double minValue, double maxValue, unsigned int precisionBits)
+{
+    Destroy();
+    if ((minValue <= 0.0) || (maxValue < minValue) || (precisionBits > 16) ||
+        ((maxValue / minValue) >= 1.0e+18))
+    {
+        PLOG(PL_ERROR, "ProtoStats::Histogram::Init() error: invalid range or precision\n");
+        return false;
+    }
+    unit = minValue;
+    unit_scale = 1.0 / minValue;
+    precision_bits = precisionBits;
+    sub_count = (uint64_t)1 << precisionBits;
+    max_units = (uint64_t)(maxValue * unit_scale);
+    bucket_count = GetIndex(maxValue) + 1;
+    if (NULL == (bucket_list = new uint64_t[bucket_count]))
+    {
+        PLOG(PL_ERROR, "ProtoStats::Histogram::Init() new bucket_list error: %s\n", GetErrorString());
+        bucket_count = 0;
+        return false;
+    }
+    Reset();
+    return true;
+}  // end ProtoStats::Histogram::Init()
+
+void ProtoStats::Histogram::Destroy()
+{
+    if (NULL != bucket_list)
+    {
+        delete[] bucket_list;
+        bucket_list = NULL;
+    }
+    bucket_count = 0;
+}  // end ProtoStats::Histogram::Destroy()
+
+void ProtoStats::Histogram::Reset()
+{
+    if (NULL != bucket_list)
+        memset(bucket_list, 0, bucket_count * sizeof(uint64_t));
+    total_count = 0;
+    min_value = 1.0e+308;
+    max_value = -1.0e+308;
+    value_sum = 0.0;
+}  // end ProtoStats::Histogram::Reset()
+
+void ProtoStats::Histogram::RecordConcurrent(double value, unsigned long count)
+{
+    unsigned int index = GetIndex(value);
+    ProtoAtomic::FetchAdd(&bucket_list[index], (uint64_t)count);
+    ProtoAtomic::FetchAdd(&total_count, (uint64_t)count);
+    double current = ProtoAtomic::LoadRelaxed(&min_value);
+    while ((value < current) && !ProtoAtomic::CompareExchange(&min_value, current, value));
+    current = ProtoAtomic::LoadRelaxed(&max_value);
+    while ((value > current) && !ProtoAtomic::CompareExchange(&max_value, current, value));
+    current = ProtoAtomic::LoadRelaxed(&value_sum);
+    while (!ProtoAtomic::CompareExchange(&value_sum, current, current + value * (double)count));
+}  // end ProtoStats::Histogram::RecordConcurrent()
+
+bool ProtoStats::Histogram::Merge(const Histogram& other)
+{
+    if ((other.unit != unit) || (other.precision_bits != precision_bits) ||
+        (other.bucket_count != bucket_count))
+    {
+        PLOG(PL_ERROR, "ProtoStats::Histogram::Merge() error: histogram configuration mismatch\n");
+        return false;
+    }
+    if (0 == other.total_count) return true;
+    for (unsigned int i = 0; i < bucket_count; i++)
+        bucket_list[i] += other.bucket_list[i];
+    total_count += other.total_count;
+    if (other.min_value < min_value) min_value = other.min_value;
+    if (other.max_value > max_value) max_value = other.max_value;
+    value_sum += other.value_sum;
+    return true;
+}  // end ProtoStats::Histogram::Merge()
+
+double ProtoStats::Histogram::GetBucketValue(unsigned int index) const
+{
+    uint64_t low, width;
+    if (index < (sub_count << 1))
+    {
+        low = index;
+        width = 1;
+    }
+    else
+    {
+        unsigned int shift = (unsigned int)(index / sub_count) - 1;
+        low = (index - shift * sub_count) << shift;
+        width = (uint64_t)1 << shift;
+    }
+    // (the middle of the bucket's range)
+    return (((double)low + 0.5 * (double)(width - 1)) * unit);
+}  // end ProtoStats::Histogram::GetBucketValue()
+
+double ProtoStats::Histogram::GetQuantile(double quantile) const
+{
+    if (0 == total_count) return 0.0;
+    if (quantile <= 0.0) return min_value;
+    if (quantile >= 1.0) return max_value;
+    uint64_t target = (uint64_t)ceil(quantile * (double)total_count);
+    if (0 == target) target = 1;
+    uint64_t sum = 0;
+    for (unsigned int i = 0; i < bucket_count; i++)
+    {
+        sum += bucket_list[i];
+        if (sum >= target)
+        {
+            double value = GetBucketValue(i);
+            if (value < min_value) return min_value;
+            if (value > max_value) return max_value;
+            return value;
+        }
+    }
+    return max_value;
+}  // end ProtoStats::Histogram::GetQuantile()
+
+ProtoStats::Quantile::Quantile(double theQuantile)
+ : quantile(theQuantile)
+{
+    Reset();
+}
+
+void ProtoStats::Quantile::Reset()
+{
+    count = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        height[i] = 0.0;
+        position[i] = (double)(i + 1);
+    }
+    desired[0] = 1.0;
+    desired[1] = 1.0 + 2.0 * quantile;
+    desired[2] = 1.0 + 4.0 * quantile;
+    desired[3] = 3.0 + 2.0 * quantile;
+    desired[4] = 5.0;
+    increment[0] = 0.0;
+    increment[1] = quantile / 2.0;
+    increment[2] = quantile;
+    increment[3] = (1.0 + quantile) / 2.0;
+    increment[4] = 1.0;
+}  // end ProtoStats::Quantile::Reset()
+
+void ProtoStats::Quantile::Add(double value)
+{
+    if (count < 5)
+    {
+        // Keep the first five values sorted as the initial markers
+        int i = (int)count++;
+        while ((i > 0) && (height[i - 1] > value))
+        {
+            height[i] = height[i - 1];
+            i--;
+        }
+        height[i] = value;
+        return;
+    }
+    count++;
+    // Find the cell the value falls in, adjusting the extreme markers
+    int k;
+    if (value < height[0])
+    {
+        height[0] = value;
+        k = 0;
+    }
+    else if (value >= height[4])
+    {
+        if (value > height[4]) height[4] = value;
+        k = 3;
+    }
+    else
+    {
+        k = 0;
+        while (value >= height[k + 1]) k++;
+    }
+    for (int i = k + 1; i < 5; i++)
+        position[i] += 1.0;
+    for (int i = 0; i < 5; i++)
+        desired[i] += increment[i];
+    // Move the middle markers toward their desired positions if needed
+    for (int i = 1; i < 4; i++)
+    {
+        double delta = desired[i] - position[i];
+        if (((delta >= 1.0) && ((position[i + 1] - position[i]) > 1.0)) ||
+            ((delta <= -1.0) && ((position[i - 1] - position[i]) < -1.0)))
+        {
+            int d = (delta > 0.0) ? 1 : -1;
+            double h = Parabolic(i, d);
+            if ((height[i - 1] < h) && (h < height[i + 1]))
+                height[i] = h;
+            else
+                height[i] = Linear(i, d);
+            position[i] += (double)d;
+        }
+    }
+}  // end ProtoStats::Quantile::Add()
+
+double ProtoStats::Quantile::Parabolic(int i, int d) const
+{
+    return (height[i] + ((double)d / (position[i + 1] - position[i - 1])) *
+            ((position[i] - position[i - 1] + d) * (height[i + 1] - height[i]) / (position[i + 1] - position[i]) +
+             (position[i + 1] - position[i] - d) * (height[i] - height[i - 1]) / (position[i] - position[i - 1])));
+}  // end ProtoStats::Quantile::Parabolic()
+
+double ProtoStats::Quantile::Linear(int i, int d) const
+{
+    return (height[i] + d * (height[i + d] - height[i]) / (position[i + d] - position[i]));
+}  // end ProtoStats::Quantile::Linear()
+
+double ProtoStats::Quantile::GetValue() const
+{
+    if (0 == count) return 0.0;
+    if (count < 5)
+    {
+        // (the first values are kept sorted)
+        unsigned int index = (unsigned int)(quantile * (double)(count - 1) + 0.5);
+        return height[index];
+    }
+    return height[2];
+}  // end ProtoStats::Quantile::GetValue()
@@ -13,8 +13,9 @@ ProtoTokenator::ProtoTokenator(const char*  text,
                                bool         stripTokens)
  : token(delimiter), strip_whitespace(stripWhiteSpace), strip_tokens(stripTokens), 
    reverse(reverseOrder), max_count(maxCount), remain(maxCount), 
-   text_ptr(text), prev_item(NULL)       
+   text_ptr(text), prev_item(NULL), prev_size(0)
 {
+    SetToken(delimiter);
     Reset();
 }
 
@@ -27,22 +28,66 @@ ProtoTokenator::~ProtoTokenator()
     }
 }
 
-bool ProtoTokenator::TokenMatch(char c) const
+void ProtoTokenator::SetToken(char delimiter)
 {
-    return ((c == token) || (isspace(token) && isspace(c)));
-}  // end ProtoTokenator::TokenMatch()
+    token = delimiter;
+    memset(delim_table, 0, sizeof(delim_table));
+    delim_table[0] = true;
+    delim_table[(unsigned char)delimiter] = true;
+    space_delim = (0 != isspace(delimiter));
+    if (space_delim)
+    {
+        for (int c = 1; c < 256; c++)
+            if (isspace(c)) delim_table[c] = true;
+    }
+    single_delim = ('\0' != delimiter) && !space_delim;
+}  // end ProtoTokenator::SetToken()
+
+void ProtoTokenator::SetDelimiters(const char* delimiters)
+{
+    SetToken(('\0' != *delimiters) ? *delimiters : ' ');
+    for (const char* ptr = delimiters + 1; '\0' != *ptr; ptr++)
+    {
+        delim_table[(unsigned char)*ptr] = true;
+        if (isspace(*ptr) && !space_delim)
+        {
+            space_delim = true;
+            for (int c = 1; c < 256; c++)
+                if (isspace(c)) delim_table[c] = true;
+        }
+        single_delim = false;
+    }
+}  // end ProtoTokenator::SetDelimiters()
+
+const char* ProtoTokenator::FindToken(const char* ptr) const
+{
+    if (single_delim) return strchr(ptr, token);
+    // (the table is also set for '\0' so there's one test per character)
+    const unsigned char* uptr = (const unsigned char*)ptr;
+    while (true)
+    {
+        if (delim_table[uptr[0]]) break;
+        if (delim_table[uptr[1]]) {uptr += 1; break;}
+        if (delim_table[uptr[2]]) {uptr += 2; break;}
+        if (delim_table[uptr[3]]) {uptr += 3; break;}
+        uptr += 4;
+    }
+    return ('\0' != *uptr) ? (const char*)uptr : NULL;
+}  // end ProtoTokenator::FindToken()
 
 void ProtoTokenator::Reset(const char* text, char delimiter)
 {
     remain = max_count;
     if (NULL != text) text_ptr = text;
-    if ('\0' != delimiter) token = delimiter;
+    if ('\0' != delimiter) SetToken(delimiter);
     if (reverse)
     {
         next_ptr = text_ptr;
-        if (NULL != next_ptr)
+        if ((NULL != next_ptr) && ('\0' == *next_ptr))
+            next_ptr = NULL;  // (empty string)
+        else if (NULL != next_ptr)
             next_ptr += strlen(next_ptr) - 1;
-        if (isspace(token))
+        if (space_delim)
         {
             // Advance to start of any trailing white space
             while (NULL != next_ptr)
@@ -64,7 +109,7 @@ void ProtoTokenator::Reset(const char* text, char delimiter)
     else
     {
         next_ptr = text_ptr;
-        if (isspace(token))
+        if (space_delim)
         {
             // advance to end of any leading white space
             while (NULL != next_ptr)
@@ -81,6 +126,38 @@ void ProtoTokenator::Reset(const char* text, char delimiter)
 }  // end ProtoTokenator::Reset()
 
 const char* const ProtoTokenator::GetNextItem(bool detach)
+{
+    const char* headPtr;
+    unsigned int itemLen;
+    if (!GetNextSpan(headPtr, itemLen)) return NULL;
+    // (the "prev_item" buffer is reused when it is big enough)
+    if ((NULL == prev_item) || (itemLen >= prev_size))
+    {
+        if (NULL != prev_item) delete[] prev_item;
+        prev_size = 0;
+        if (NULL == (prev_item = new char[itemLen+1]))
+        {
+            PLOG(PL_ERROR, "ProtoTokenator::GetNextItem() new char[] error: %s\n", GetErrorString());
+            return NULL;
+        }
+        prev_size = itemLen + 1;
+    }
+    memcpy(prev_item, headPtr, itemLen);
+    prev_item[itemLen] = '\0';
+    if (detach)
+    {
+        const char* item = prev_item;
+        prev_item = NULL;
+        prev_size = 0;
+        return item;
+    }
+    else
+    {
+        return prev_item;
+    }
+}  // end ProtoTokenator::GetNextItem()
+
+bool ProtoTokenator::GetNextSpan(const char*& item, unsigned int& length)
 {
     if (reverse)
     {
@@ -102,7 +179,7 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
                 }
             }
         }
-        if (NULL == next_ptr) return NULL;
+        if (NULL == next_ptr) return false;
         
         if ((0 != max_count) && (0 == remain))
         {
@@ -128,26 +205,10 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
                     itemLen--;
                 }
             }
-            // TBD - save "prev_len" only allocate a new "prev_item" when longer string is needed.
-            if (NULL != prev_item) delete[] prev_item;
-            if (NULL == (prev_item = new char[itemLen+1]))
-            {
-                PLOG(PL_ERROR, "ProtoTokenator::GetNextItem() new char[] error: %s\n", GetErrorString());
-                return NULL;
-            }
-            strncpy(prev_item, headPtr, itemLen); 
-            prev_item[itemLen] = '\0';
             next_ptr = NULL;
-            if (detach)
-            {
-                const char* item = prev_item;
-                prev_item = NULL;
-                return item;
-            }
-            else
-            {
-                return prev_item;
-            }
+            item = headPtr;
+            length = (unsigned int)itemLen;
+            return true;
         }
         const char* ptr = next_ptr;
         // Advance to next token
@@ -181,19 +242,13 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
                 itemLen--;
             }
         }
-        if (NULL != prev_item) delete[] prev_item;
-        if (NULL == (prev_item = new char[itemLen+1]))
-        {
-            PLOG(PL_ERROR, "ProtoTokenator::GetNextItem() new char[] error: %s\n", GetErrorString());
-            return NULL;
-        }
-        strncpy(prev_item, headPtr, itemLen);
-        prev_item[itemLen] = '\0';
+        item = headPtr;
+        length = (unsigned int)itemLen;
         if (text_ptr == ptr--)
         {
             ptr = NULL;
         }
-        else if (isspace(token))
+        else if (space_delim)
         {
             // Advance to start of white space
             while (NULL != ptr)
@@ -228,7 +283,7 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
                     break;
             }
         }
-        if (NULL == next_ptr) return NULL;
+        if (NULL == next_ptr) return false;
         if ((0 != max_count) && (0 == remain))
         {
             // Count was limited, so return remainder as last item 
@@ -252,44 +307,13 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
                     itemLen--;
                 }
             }
-            if (NULL != prev_item) delete[] prev_item;
-            if (NULL == (prev_item = new char[itemLen+1]))
-            {
-                PLOG(PL_ERROR, "ProtoTokenator::GetNextItem() new char[] error: %s\n", GetErrorString());
-                return NULL;
-            }
-            strncpy(prev_item, next_ptr, itemLen + 1); 
+            item = next_ptr;
+            length = (unsigned int)itemLen;
             next_ptr = NULL;
-            if (detach)
-            {
-                const char* item = prev_item;
-                prev_item = NULL;
-                return item;
-            }
-            else
-            {
-                return prev_item;  
-            }
-        }
-        const char* ptr;
-        if (isspace(token))
-        {
-            // Advance to start of white space
-            ptr = next_ptr;
-            while (NULL != ptr)
-            {
-                if ('\0' == *ptr)
-                    ptr = NULL;
-                else if (isspace(*ptr))
-                    break;
-                else
-                    ptr++;
-            }
-        }
-        else
-        {
-            ptr = strchr(next_ptr, token);
+            return true;
         }
+        // Advance to next token
+        const char* ptr = FindToken(next_ptr);
         size_t itemLen = (NULL == ptr) ? strlen(next_ptr) : (ptr++ - next_ptr);
         // Strip trailing whitespace, if required
         if (strip_whitespace)
@@ -298,15 +322,9 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
             while ((0 != itemLen) && (isspace(*tailPtr--)))
                 itemLen--;
         }
-        if (NULL != prev_item) delete[] prev_item;
-        if (NULL == (prev_item = new char[itemLen+1]))
-        {
-            PLOG(PL_ERROR, "ProtoTokenator::GetNextItem() new char[] error: %s\n", GetErrorString());
-            return NULL;
-        }
-        strncpy(prev_item, next_ptr, itemLen);
-        prev_item[itemLen] = '\0';
-        if (strip_whitespace || isspace(token))
+        item = next_ptr;
+        length = (unsigned int)itemLen;
+        if (strip_whitespace || space_delim)
         {
             // Advance to end of white space
             while (NULL != ptr)
@@ -322,14 +340,5 @@ const char* const ProtoTokenator::GetNextItem(bool detach)
         next_ptr = ptr;
     }
     if (0 != max_count) remain -= 1;
-    if (detach)
-    {
-        const char* item = prev_item;
-        prev_item = NULL;
-        return item;
-    }
-    else
-    {
-        return prev_item;
-    }
-}  // end ProtoTokenator::GetNextItem()
+    return true;
+}  // end ProtoTokenator::GetNextSpan()
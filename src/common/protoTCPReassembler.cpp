@@ -0,0 +1,502 @@
+#include "protoTCPReassembler.h"
+#include "protoHash.h"
+#include "protoPktTCP.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy(), memset(), memcmp()
+
+UINT32 ProtoTCPReassembler::Connection::Key::GetHash() const
+{
+    return ProtoHash::Words((const UINT32*)this, sizeof(Key) / sizeof(UINT32), 0x9e3779b9);
+}  // end ProtoTCPReassembler::Connection::Key::GetHash()
+
+bool ProtoTCPReassembler::Connection::GetEndpointAddr(unsigned int endpoint, ProtoAddress& addr) const
+{
+    switch (key.version)
+    {
+        case 4:
+            addr.SetRawHostAddress(ProtoAddress::IPv4, (const char*)key.addr[endpoint], 4);
+            break;
+        case 6:
+            addr.SetRawHostAddress(ProtoAddress::IPv6, (const char*)key.addr[endpoint], 16);
+            break;
+        default:
+            addr.Invalidate();
+            return false;
+    }
+    addr.SetPort(key.port[endpoint]);
+    return true;
+}  // end ProtoTCPReassembler::Connection::GetEndpointAddr()
+
+ProtoTCPReassembler::ProtoTCPReassembler()
+ : listener(NULL), midstream(true),
+   lru_head(NIL), lru_tail(NIL),
+   block_list(NULL), block_max(0), block_free_count(0), block_free(NIL),
+   stream_buffer_max(0), segment_count(0), ooo_count(0), overlap_count(0),
+   gap_count(0), evict_count(0)
+{
+}
+
+ProtoTCPReassembler::~ProtoTCPReassembler()
+{
+    Close();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+bool ProtoTCPReassembler::Open(unsigned int connectionMax, unsigned int streamBufferMax, unsigned int memoryMax)
+{
+    Close();
+    unsigned int blockMax = memoryMax / sizeof(Block);
+    if ((0 == connectionMax) || (connectionMax >= (unsigned int)NIL) || (0 == blockMax) || (0 == streamBufferMax))
+    {
+        PLOG(PL_ERROR, "ProtoTCPReassembler::Open() error: invalid parameter\n");
+        return false;
+    }
+    if (!connection_table.Init(connectionMax, 2))
+    {
+        PLOG(PL_ERROR, "ProtoTCPReassembler::Open() error: unable to allocate connections\n");
+        return false;
+    }
+    if (NULL == (block_list = new Block[blockMax]))
+    {
+        PLOG(PL_ERROR, "ProtoTCPReassembler::Open() new error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    lru_head = lru_tail = NIL;
+    for (UINT32 i = 0; i < blockMax; i++)
+        block_list[i].next = i + 1;
+    block_list[blockMax - 1].next = NIL;
+    block_free = 0;
+    block_max = block_free_count = blockMax;
+    stream_buffer_max = streamBufferMax;
+    segment_count = ooo_count = overlap_count = gap_count = evict_count = 0;
+    return true;
+}  // end ProtoTCPReassembler::Open()
+
+void ProtoTCPReassembler::Close()
+{
+    if (NULL != block_list)
+    {
+        delete[] block_list;
+        block_list = NULL;
+    }
+    connection_table.Destroy();
+    lru_head = lru_tail = block_free = NIL;
+    block_max = block_free_count = 0;
+}  // end ProtoTCPReassembler::Close()
+
+bool ProtoTCPReassembler::Process(ProtoPktIP& ipPkt, const ProtoTime& pktTime)
+{
+    if (!connection_table.IsReady())
+    {
+        PLOG(PL_ERROR, "ProtoTCPReassembler::Process() error: reassembler not open\n");
+        return false;
+    }
+    UINT8* buffer = (UINT8*)ipPkt.AccessBuffer();
+    unsigned int pktLength = ipPkt.GetLength();
+    const UINT8* srcAddr;
+    const UINT8* dstAddr;
+    unsigned int addrLength;
+    unsigned int offset;  // of TCP header
+    UINT8 version = ipPkt.GetVersion();
+    switch (version)
+    {
+        case 4:
+        {
+            ProtoPktIPv4 ip4Pkt(ipPkt);
+            // (fragments must be reassembled first)
+            if ((ProtoPktIP::TCP != ip4Pkt.GetProtocol()) ||
+                (0 != ip4Pkt.GetFragmentOffset()) || ip4Pkt.FlagIsSet(ProtoPktIPv4::FLAG_MF))
+                return false;
+            offset = ip4Pkt.GetHeaderLength();
+            if (ip4Pkt.GetTotalLength() < pktLength) pktLength = ip4Pkt.GetTotalLength();
+            srcAddr = (const UINT8*)ip4Pkt.GetSrcAddrPtr();
+            dstAddr = (const UINT8*)ip4Pkt.GetDstAddrPtr();
+            addrLength = 4;
+            break;
+        }
+        case 6:
+        {
+            ProtoPktIPv6 ip6Pkt(ipPkt);
+            unsigned int length = ProtoPktIPv6::GetHeaderLength() + ip6Pkt.GetPayloadLength();
+            if (length < pktLength) pktLength = length;
+            // Skip any hop-by-hop, routing and destination options
+            UINT8 nh = (UINT8)ip6Pkt.GetNextHeader();
+            offset = ProtoPktIPv6::GetHeaderLength();
+            while (((ProtoPktIP::HOPOPT == nh) || (ProtoPktIP::DSTOPT == nh) || (ProtoPktIP::RTG == nh)) &&
+                   ((offset + 8) <= pktLength))
+            {
+                nh = buffer[offset];
+                offset += ((unsigned int)buffer[offset + 1] + 1) << 3;
+            }
+            if (ProtoPktIP::TCP != nh) return false;
+            srcAddr = (const UINT8*)ip6Pkt.GetSrcAddrPtr();
+            dstAddr = (const UINT8*)ip6Pkt.GetDstAddrPtr();
+            addrLength = 16;
+            break;
+        }
+        default:
+            return false;
+    }
+    if ((offset + 20) > pktLength) return false;
+    unsigned int tcpHdrLength = (unsigned int)(buffer[offset + 12] >> 4) << 2;
+    if ((tcpHdrLength < 20) || ((offset + tcpHdrLength) > pktLength)) return false;
+    ProtoPktTCP tcpPkt(buffer + offset, pktLength - offset, true);
+    UINT16 srcPort = tcpPkt.GetSrcPort();
+    UINT16 dstPort = tcpPkt.GetDstPort();
+    UINT16 flags = tcpPkt.GetFlags();
+    UINT32 seq = tcpPkt.GetSequence();
+    const char* data = (const char*)(buffer + offset + tcpHdrLength);
+    unsigned int length = pktLength - offset - tcpHdrLength;
+    segment_count++;
+
+    // The key holds the endpoints in a canonical order so both directions match
+    Connection::Key key;
+    memset(&key, 0, sizeof(Connection::Key));
+    key.version = version;
+    int cmp = memcmp(srcAddr, dstAddr, addrLength);
+    UINT8 srcEndpoint = ((cmp < 0) || ((0 == cmp) && (srcPort <= dstPort))) ? 0 : 1;
+    memcpy(key.addr[srcEndpoint], srcAddr, addrLength);
+    memcpy(key.addr[1 - srcEndpoint], dstAddr, addrLength);
+    key.port[srcEndpoint] = srcPort;
+    key.port[1 - srcEndpoint] = dstPort;
+    UINT32 hash = key.GetHash();
+    UINT32 index = connection_table.Find(key, hash);
+    double theTime = pktTime.GetValue();
+    if (NIL == index)
+    {
+        if (0 != (flags & ProtoPktTCP::FLAG_RST)) return true;
+        UINT8 client;
+        if (0 != (flags & ProtoPktTCP::FLAG_SYN))
+            client = (0 != (flags & ProtoPktTCP::FLAG_ACK)) ? (1 - srcEndpoint) : srcEndpoint;
+        else if (midstream)
+            client = (srcPort > dstPort) ? srcEndpoint : (1 - srcEndpoint);
+        else
+            return true;
+        index = AddConnection(key, hash, client, theTime);
+    }
+    else
+    {
+        Touch(index, theTime);
+    }
+    Connection& connection = connection_table[index];
+    Direction dir = (srcEndpoint == connection.client) ? CLIENT_TO_SERVER : SERVER_TO_CLIENT;
+    if (0 != (flags & ProtoPktTCP::FLAG_RST))
+    {
+        RemoveConnection(index, EVENT_RESET);
+        return true;
+    }
+    Connection::Stream& stream = connection.stream[dir];
+    if (0 != (flags & ProtoPktTCP::FLAG_SYN))
+    {
+        seq++;  // (SYN occupies one sequence number)
+        if (!stream.initialized)
+        {
+            stream.next_seq = seq;
+            stream.initialized = true;
+        }
+    }
+    else if (!stream.initialized)
+    {
+        if ((0 == length) && (0 == (flags & ProtoPktTCP::FLAG_FIN)))
+            return true;  // (wait for data to pick up the stream)
+        stream.next_seq = seq;
+        stream.initialized = true;
+    }
+    if (stream.closed) return true;
+    if (0 != (flags & ProtoPktTCP::FLAG_FIN))
+    {
+        UINT32 finSeq = seq + length;
+        if (!stream.fin_seen || SeqLess(finSeq, stream.fin_seq))
+            stream.fin_seq = finSeq;
+        stream.fin_seen = true;
+    }
+    if (stream.fin_seen && SeqLess(stream.fin_seq, seq + length))
+        length = SeqLess(seq, stream.fin_seq) ? (stream.fin_seq - seq) : 0;  // (ignore data beyond FIN)
+    if (0 != length)
+    {
+        if (SeqLessEqual(seq, stream.next_seq))
+        {
+            // In order (or retransmitted) data is delivered from the packet itself
+            UINT32 skip = stream.next_seq - seq;
+            if (skip < length)
+            {
+                if (0 != skip) overlap_count++;
+                Deliver(connection, dir, stream.next_seq, data + skip, length - skip);
+                Drain(connection, dir);
+            }
+            else
+            {
+                overlap_count++;
+            }
+        }
+        else
+        {
+            ooo_count++;
+            // Under memory pressure, skip this stream ahead and then evict idle connections
+            while (!Buffer(connection, dir, seq, data, length))
+            {
+                if (NIL != stream.block_head)
+                {
+                    SkipGap(connection, dir);
+                    if (SeqLessEqual(seq, stream.next_seq))
+                    {
+                        UINT32 skip = stream.next_seq - seq;
+                        if (skip < length)
+                        {
+                            Deliver(connection, dir, stream.next_seq, data + skip, length - skip);
+                            Drain(connection, dir);
+                        }
+                        break;
+                    }
+                }
+                else if ((NIL == block_free) && (lru_head != index))
+                {
+                    RemoveConnection(lru_head, EVENT_EVICT);
+                    evict_count++;
+                }
+                else
+                {
+                    // Nothing else can be freed, so skip ahead to this segment
+                    Notify(connection, EVENT_GAP, dir, NULL, seq - stream.next_seq);
+                    gap_count++;
+                    stream.delivered += seq - stream.next_seq;
+                    stream.next_seq = seq;
+                    Deliver(connection, dir, seq, data, length);
+                    break;
+                }
+            }
+        }
+    }
+    CheckClosed(index);
+    return true;
+}  // end ProtoTCPReassembler::Process()
+
+void ProtoTCPReassembler::Deliver(Connection& connection, Direction dir, UINT32 seq, const char* data, unsigned int length)
+{
+    Connection::Stream& stream = connection.stream[dir];
+    stream.next_seq = seq + length;
+    stream.delivered += length;
+    Notify(connection, EVENT_DATA, dir, data, length);
+}  // end ProtoTCPReassembler::Deliver()
+
+// Delivers buffered blocks that are now in order (trimming any overlap)
+void ProtoTCPReassembler::Drain(Connection& connection, Direction dir)
+{
+    Connection::Stream& stream = connection.stream[dir];
+    while ((NIL != stream.block_head) && SeqLessEqual(block_list[stream.block_head].seq, stream.next_seq))
+    {
+        UINT32 index = stream.block_head;
+        Block& block = block_list[index];
+        UINT32 skip = stream.next_seq - block.seq;
+        if (skip < block.length)
+            Deliver(connection, dir, stream.next_seq, block.data + skip, block.length - skip);
+        stream.block_head = block.next;
+        stream.buffered -= block.length;
+        block.next = block_free;
+        block_free = index;
+        block_free_count++;
+    }
+}  // end ProtoTCPReassembler::Drain()
+
+// Skips the missing data before the first buffered block and delivers what follows it
+void ProtoTCPReassembler::SkipGap(Connection& connection, Direction dir)
+{
+    Connection::Stream& stream = connection.stream[dir];
+    if (NIL == stream.block_head) return;
+    UINT32 gap = block_list[stream.block_head].seq - stream.next_seq;
+    Notify(connection, EVENT_GAP, dir, NULL, gap);
+    gap_count++;
+    stream.delivered += gap;
+    stream.next_seq += gap;
+    Drain(connection, dir);
+}  // end ProtoTCPReassembler::SkipGap()
+
+void ProtoTCPReassembler::CheckClosed(UINT32 index)
+{
+    Connection& connection = connection_table[index];
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        Connection::Stream& stream = connection.stream[i];
+        if (stream.fin_seen && !stream.closed && (stream.next_seq == stream.fin_seq))
+        {
+            stream.closed = true;
+            FreeBlocks(stream);  // (nothing buffered can be in sequence now)
+        }
+    }
+    if (connection.stream[CLIENT_TO_SERVER].closed && connection.stream[SERVER_TO_CLIENT].closed)
+        RemoveConnection(index, EVENT_CLOSE);
+}  // end ProtoTCPReassembler::CheckClosed()
+
+// Copies the out of order data not already buffered into blocks, returning false
+// if the stream or pool limit was reached (any data buffered before that is kept)
+bool ProtoTCPReassembler::Buffer(Connection& connection, Direction dir, UINT32 seq, const char* data, unsigned int length)
+{
+    Connection::Stream& stream = connection.stream[dir];
+    UINT32 end = seq + length;
+    UINT32* prevNext = &stream.block_head;
+    while (NIL != *prevNext)
+    {
+        const Block& block = block_list[*prevNext];
+        UINT32 blockEnd = block.seq + block.length;
+        if (SeqLessEqual(end, block.seq)) break;  // (insert before this block)
+        if (SeqLess(seq, blockEnd))
+        {
+            overlap_count++;
+            if (SeqLess(seq, block.seq))
+            {
+                unsigned int count = block.seq - seq;
+                if (!InsertBlocks(stream, prevNext, seq, data, count)) return false;
+                while (*prevNext != NIL && SeqLess(block_list[*prevNext].seq, block.seq))
+                    prevNext = &block_list[*prevNext].next;
+            }
+            if (SeqLessEqual(end, blockEnd)) return true;  // (rest is already buffered)
+            data += blockEnd - seq;
+            seq = blockEnd;
+        }
+        prevNext = &block_list[*prevNext].next;
+    }
+    return InsertBlocks(stream, prevNext, seq, data, end - seq);
+}  // end ProtoTCPReassembler::Buffer()
+
+bool ProtoTCPReassembler::InsertBlocks(Connection::Stream& stream, UINT32* prevNext, UINT32 seq, const char* data, unsigned int length)
+{
+    while (0 != length)
+    {
+        if ((stream.buffered + length) > stream_buffer_max) return false;
+        UINT32 index = AllocBlock();
+        if (NIL == index) return false;
+        Block& block = block_list[index];
+        unsigned int count = (length < BLOCK_SIZE) ? length : BLOCK_SIZE;
+        block.seq = seq;
+        block.length = count;
+        memcpy(block.data, data, count);
+        block.next = *prevNext;
+        *prevNext = index;
+        prevNext = &block.next;
+        stream.buffered += count;
+        seq += count;
+        data += count;
+        length -= count;
+    }
+    return true;
+}  // end ProtoTCPReassembler::InsertBlocks()
+
+UINT32 ProtoTCPReassembler::AllocBlock()
+{
+    UINT32 index = block_free;
+    if (NIL != index)
+    {
+        block_free = block_list[index].next;
+        block_free_count--;
+    }
+    return index;
+}  // end ProtoTCPReassembler::AllocBlock()
+
+void ProtoTCPReassembler::FreeBlocks(Connection::Stream& stream)
+{
+    while (NIL != stream.block_head)
+    {
+        UINT32 index = stream.block_head;
+        stream.block_head = block_list[index].next;
+        block_list[index].next = block_free;
+        block_free = index;
+        block_free_count++;
+    }
+    stream.buffered = 0;
+}  // end ProtoTCPReassembler::FreeBlocks()
+
+UINT32 ProtoTCPReassembler::AddConnection(const Connection::Key& key, UINT32 hash, UINT8 client, double theTime)
+{
+    if (connection_table.IsFull())
+    {
+        // Evict least recently active connection
+        RemoveConnection(lru_head, EVENT_EVICT);
+        evict_count++;
+    }
+    UINT32 index = connection_table.Insert(key, hash);
+    Connection& connection = connection_table[index];
+    connection.client = client;
+    connection.user_data = NULL;
+    connection.last_time = theTime;
+    memset(connection.stream, 0, sizeof(connection.stream));
+    connection.stream[CLIENT_TO_SERVER].block_head = NIL;
+    connection.stream[SERVER_TO_CLIENT].block_head = NIL;
+    connection.lru_prev = lru_tail;
+    connection.lru_next = NIL;
+    if (NIL != lru_tail)
+        connection_table[lru_tail].lru_next = index;
+    else
+        lru_head = index;
+    lru_tail = index;
+    Notify(connection, EVENT_OPEN, CLIENT_TO_SERVER, NULL, 0);
+    return index;
+}  // end ProtoTCPReassembler::AddConnection()
+
+void ProtoTCPReassembler::Touch(UINT32 index, double theTime)
+{
+    Connection& connection = connection_table[index];
+    connection.last_time = theTime;
+    if (lru_tail == index) return;
+    // Move to tail of activity list
+    if (NIL != connection.lru_prev)
+        connection_table[connection.lru_prev].lru_next = connection.lru_next;
+    else
+        lru_head = connection.lru_next;
+    connection_table[connection.lru_next].lru_prev = connection.lru_prev;
+    connection.lru_prev = lru_tail;
+    connection.lru_next = NIL;
+    connection_table[lru_tail].lru_next = index;
+    lru_tail = index;
+}  // end ProtoTCPReassembler::Touch()
+
+void ProtoTCPReassembler::RemoveConnection(UINT32 index, Event event)
+{
+    Connection& connection = connection_table[index];
+    FreeBlocks(connection.stream[CLIENT_TO_SERVER]);
+    FreeBlocks(connection.stream[SERVER_TO_CLIENT]);
+    Notify(connection, event, CLIENT_TO_SERVER, NULL, 0);
+    if (NIL != connection.lru_prev)
+        connection_table[connection.lru_prev].lru_next = connection.lru_next;
+    else
+        lru_head = connection.lru_next;
+    if (NIL != connection.lru_next)
+        connection_table[connection.lru_next].lru_prev = connection.lru_prev;
+    else
+        lru_tail = connection.lru_prev;
+    connection_table.Remove(index);
+}  // end ProtoTCPReassembler::RemoveConnection()
+
+void ProtoTCPReassembler::Expire(const ProtoTime& currentTime, double idleTimeout)
+{
+    if (!connection_table.IsReady()) return;
+    double expireTime = currentTime.GetValue() - idleTimeout;
+    while ((NIL != lru_head) && (connection_table[lru_head].last_time <= expireTime))
+    {
+        Connection& connection = connection_table[lru_head];
+        while (NIL != connection.stream[CLIENT_TO_SERVER].block_head)
+            SkipGap(connection, CLIENT_TO_SERVER);
+        while (NIL != connection.stream[SERVER_TO_CLIENT].block_head)
+            SkipGap(connection, SERVER_TO_CLIENT);
+        RemoveConnection(lru_head, EVENT_TIMEOUT);
+    }
+}  // end ProtoTCPReassembler::Expire()
+
+void ProtoTCPReassembler::Flush()
+{
+    if (!connection_table.IsReady()) return;
+    while (NIL != lru_head)
+    {
+        Connection& connection = connection_table[lru_head];
+        while (NIL != connection.stream[CLIENT_TO_SERVER].block_head)
+            SkipGap(connection, CLIENT_TO_SERVER);
+        while (NIL != connection.stream[SERVER_TO_CLIENT].block_head)
+            SkipGap(connection, SERVER_TO_CLIENT);
+        RemoveConnection(lru_head, EVENT_TIMEOUT);
+    }
+}  // end ProtoTCPReassembler::Flush()
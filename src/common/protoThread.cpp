@@ -47,6 +47,49 @@ void ProtoMutex::Unlock()
 #endif
 }  // end ProtoMutex::Unlock()
 
+ProtoCondition::ProtoCondition()
+{
+#ifdef WIN32
+    InitializeConditionVariable(&cond);
+#else
+    pthread_cond_init(&cond, NULL);
+#endif
+}
+
+ProtoCondition::~ProtoCondition()
+{
+#ifndef WIN32
+    pthread_cond_destroy(&cond);
+#endif
+}
+
+void ProtoCondition::Wait(ProtoMutex& mutex)
+{
+#ifdef WIN32
+    SleepConditionVariableCS(&cond, &mutex.mutex, INFINITE);
+#else
+    pthread_cond_wait(&cond, &mutex.mutex);
+#endif
+}  // end ProtoCondition::Wait()
+
+void ProtoCondition::Signal()
+{
+#ifdef WIN32
+    WakeConditionVariable(&cond);
+#else
+    pthread_cond_signal(&cond);
+#endif
+}  // end ProtoCondition::Signal()
+
+void ProtoCondition::Broadcast()
+{
+#ifdef WIN32
+    WakeAllConditionVariable(&cond);
+#else
+    pthread_cond_broadcast(&cond);
+#endif
+}  // end ProtoCondition::Broadcast()
+
 ProtoThread::ProtoThread()
  : thread_id((ThreadId)NULL), external_thread(false),
    thread_running(false), exit_code(0)
@@ -0,0 +1,372 @@
+/**
+* @file protoThreadPool.cpp
+*
+* @brief Worker thread pool with completion delivery to ProtoDispatcher
+*/
+#include "protoThreadPool.h"
+#include "protoDebug.h"
+
+#include <string.h>   // for memset()
+#ifdef WIN32
+#include <windows.h>  // for GetSystemInfo()
+#else
+#include <unistd.h>   // for sysconf()
+#endif // if/else WIN32/UNIX
+
+ProtoThreadPool::Task::Task()
+ : listener(NULL), status(IDLE), delivered(true), worker_index(0),
+   completion_queue(NULL), next(NULL)
+{
+}
+
+ProtoThreadPool::Task::~Task()
+{
+    ASSERT(!IsPending());
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+ProtoThreadPool::CompletionQueue::CompletionQueue(ProtoThreadPool& thePool)
+ : pool(thePool), head(NULL)
+{
+}
+
+ProtoThreadPool::CompletionQueue::~CompletionQueue()
+{
+    Discard();
+    ProtoEvent::SetNotifier(NULL);
+    if (ProtoEvent::IsOpen()) ProtoEvent::Close();
+}
+
+bool ProtoThreadPool::CompletionQueue::Open()
+{
+    if (ProtoEvent::IsOpen()) return true;
+    if (!ProtoEvent::Open())
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::CompletionQueue::Open() error: unable to open event\n");
+        return false;
+    }
+    return ProtoEvent::SetListener(this, &CompletionQueue::OnEvent);
+}  // end ProtoThreadPool::CompletionQueue::Open()
+
+bool ProtoThreadPool::CompletionQueue::SetNotifier(ProtoEvent::Notifier* theNotifier)
+{
+    if (!Open()) return false;
+    if (!ProtoEvent::SetNotifier(theNotifier))
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::CompletionQueue::SetNotifier() error: unable to set notifier\n");
+        return false;
+    }
+    return true;
+}  // end ProtoThreadPool::CompletionQueue::SetNotifier()
+
+void ProtoThreadPool::CompletionQueue::Push(Task& theTask)
+{
+    // (called by workers) The event is only set when the list was empty
+    // since the dispatcher takes the whole list when notified
+    Task* oldHead = ProtoAtomic::LoadRelaxed(&head);
+    do
+    {
+        theTask.next = oldHead;
+    } while (!ProtoAtomic::CompareExchange(&head, oldHead, &theTask));
+    if (NULL == oldHead) ProtoEvent::Set();
+}  // end ProtoThreadPool::CompletionQueue::Push()
+
+void ProtoThreadPool::CompletionQueue::OnEvent(ProtoEvent& /*theEvent*/)
+{
+    Drain();
+}  // end ProtoThreadPool::CompletionQueue::OnEvent()
+
+void ProtoThreadPool::CompletionQueue::Drain()
+{
+    Task* list = ProtoAtomic::Exchange(&head, (Task*)NULL);
+    // Reverse the (pushed) list into completion order
+    Task* ordered = NULL;
+    while (NULL != list)
+    {
+        Task* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+    while (NULL != ordered)
+    {
+        Task* task = ordered;
+        ordered = task->next;  // (before the handler, which may resubmit it)
+        task->next = NULL;
+        pool.OnComplete(*task);
+    }
+}  // end ProtoThreadPool::CompletionQueue::Drain()
+
+void ProtoThreadPool::CompletionQueue::Discard()
+{
+    Task* task = ProtoAtomic::Exchange(&head, (Task*)NULL);
+    while (NULL != task)
+    {
+        Task* next = task->next;
+        task->next = NULL;
+        task->delivered = true;
+        task = next;
+    }
+}  // end ProtoThreadPool::CompletionQueue::Discard()
+
+ProtoThreadPool::Worker::Worker(ProtoThreadPool& thePool, unsigned int theIndex, unsigned int queueSize)
+ : thread(thePool, *this), index(theIndex), queue(new Task*[queueSize]),
+   queue_size(queueSize), queue_head(0), queue_count(0), steal_count(0)
+{
+}
+
+ProtoThreadPool::Worker::~Worker()
+{
+    delete[] queue;
+}
+
+bool ProtoThreadPool::Worker::Push(Task& theTask)
+{
+    mutex.Lock();
+    if (queue_count >= queue_size)
+    {
+        mutex.Unlock();
+        return false;
+    }
+    queue[(queue_head + queue_count) % queue_size] = &theTask;
+    queue_count++;
+    mutex.Unlock();
+    return true;
+}  // end ProtoThreadPool::Worker::Push()
+
+ProtoThreadPool::Task* ProtoThreadPool::Worker::Pop()
+{
+    mutex.Lock();
+    Task* task = NULL;
+    if (0 != queue_count)
+    {
+        task = queue[queue_head];
+        queue_head = (queue_head + 1) % queue_size;
+        queue_count--;
+    }
+    mutex.Unlock();
+    return task;
+}  // end ProtoThreadPool::Worker::Pop()
+
+ProtoThreadPool::ProtoThreadPool()
+ : worker_count(0), next_worker(0), pending_count(0), idle_count(0), stopping(false),
+   completion_queue(*this), submit_count(0), reject_count(0), complete_count(0),
+   queue_time_total(0.0), queue_time_max(0.0), run_time_total(0.0), run_time_max(0.0)
+{
+    memset(worker_list, 0, sizeof(worker_list));
+}
+
+ProtoThreadPool::~ProtoThreadPool()
+{
+    Close();
+}
+
+bool ProtoThreadPool::Open(unsigned int numThreads, unsigned int queueSize)
+{
+    if (IsOpen()) Close();
+    if (0 == numThreads)
+    {
+#ifdef WIN32
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        numThreads = (unsigned int)sysInfo.dwNumberOfProcessors;
+#else
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = (numCpus > 0) ? (unsigned int)numCpus : 1;
+#endif // if/else WIN32/UNIX
+    }
+    if (numThreads > THREAD_MAX) numThreads = THREAD_MAX;
+    if (0 == queueSize) queueSize = 1;
+    if (!completion_queue.Open())
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::Open() error: unable to open completion queue\n");
+        return false;
+    }
+    stopping = false;
+    pending_count = idle_count = 0;
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        if (NULL == (worker_list[i] = new Worker(*this, i, queueSize)))
+        {
+            PLOG(PL_ERROR, "ProtoThreadPool::Open() new Worker error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+        worker_count++;
+    }
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        if (!worker_list[i]->thread.StartThread())
+        {
+            PLOG(PL_ERROR, "ProtoThreadPool::Open() error: unable to start worker thread\n");
+            Close();
+            return false;
+        }
+    }
+    return true;
+}  // end ProtoThreadPool::Open()
+
+void ProtoThreadPool::Close()
+{
+    if (0 == worker_count) return;
+    mutex.Lock();
+    ProtoAtomic::Store(&stopping, true);
+    work_cond.Broadcast();
+    mutex.Unlock();
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        if (worker_list[i]->thread.IsStarted())
+            worker_list[i]->thread.StopThread();  // (joins the thread)
+    }
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        Worker* worker = worker_list[i];
+        Task* task;
+        while (NULL != (task = worker->Pop()))
+        {
+            task->delivered = true;
+            task->SetStatus(Task::CANCELLED);
+        }
+        delete worker;
+        worker_list[i] = NULL;
+    }
+    worker_count = 0;
+    completion_queue.Discard();
+}  // end ProtoThreadPool::Close()
+
+bool ProtoThreadPool::Submit(Task& theTask, CompletionQueue* completionQueue)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::Submit() error: pool not open\n");
+        return false;
+    }
+    if (theTask.IsPending())
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::Submit() error: task already pending\n");
+        return false;
+    }
+    if (NULL == completionQueue) completionQueue = &completion_queue;
+    if (!completionQueue->IsOpen())
+    {
+        PLOG(PL_ERROR, "ProtoThreadPool::Submit() error: completion queue not open\n");
+        return false;
+    }
+    theTask.completion_queue = completionQueue;
+    theTask.delivered = false;
+    theTask.submit_time.GetCurrentTime();
+    theTask.SetStatus(Task::QUEUED);
+    // (counted as pending before it is queued so workers never see it go negative)
+    ProtoAtomic::FetchAdd(&pending_count, 1);
+    unsigned int start = ProtoAtomic::FetchAdd(&next_worker, 1);
+    bool queued = false;
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        if (worker_list[(start + i) % worker_count]->Push(theTask))
+        {
+            queued = true;
+            break;
+        }
+    }
+    if (!queued)
+    {
+        ProtoAtomic::FetchSub(&pending_count, 1);
+        theTask.delivered = true;
+        theTask.SetStatus(Task::IDLE);
+        ProtoAtomic::FetchAdd(&reject_count, 1);
+        return false;
+    }
+    ProtoAtomic::FetchAdd(&submit_count, 1);
+    // Wake a worker if any are waiting (see GetTask() for why this can't be missed)
+    if (0 != ProtoAtomic::Load(&idle_count))
+    {
+        mutex.Lock();
+        work_cond.Signal();
+        mutex.Unlock();
+    }
+    return true;
+}  // end ProtoThreadPool::Submit()
+
+ProtoThreadPool::Task* ProtoThreadPool::GetTask(Worker& worker)
+{
+    while (!ProtoAtomic::Load(&stopping))
+    {
+        // Own queue first, then steal from the others
+        Task* task = worker.Pop();
+        for (unsigned int i = 1; (NULL == task) && (i < worker_count); i++)
+        {
+            if (NULL != (task = worker_list[(worker.index + i) % worker_count]->Pop()))
+                ProtoAtomic::FetchAdd(&worker.steal_count, 1);
+        }
+        if (NULL != task)
+        {
+            ProtoAtomic::FetchSub(&pending_count, 1);
+            return task;
+        }
+        // The idle count is raised _before_ checking for pending tasks so
+        // that either we see the new task or Submit() sees us waiting
+        mutex.Lock();
+        ProtoAtomic::FetchAdd(&idle_count, 1);
+        if (!ProtoAtomic::Load(&stopping) && (0 == ProtoAtomic::Load(&pending_count)))
+        {
+            work_cond.Wait(mutex);
+        }
+        ProtoAtomic::FetchSub(&idle_count, 1);
+        mutex.Unlock();
+    }
+    return NULL;
+}  // end ProtoThreadPool::GetTask()
+
+int ProtoThreadPool::RunWorker(Worker& worker)
+{
+    Task* task;
+    while (NULL != (task = GetTask(worker)))
+    {
+        task->worker_index = worker.index;
+        task->start_time.GetCurrentTime();
+        task->SetStatus(Task::RUNNING);
+        task->Run();
+        task->end_time.GetCurrentTime();
+        CompletionQueue* completionQueue = task->completion_queue;
+        task->SetStatus(Task::COMPLETE);
+        completionQueue->Push(*task);
+    }
+    return 0;
+}  // end ProtoThreadPool::RunWorker()
+
+void ProtoThreadPool::OnComplete(Task& theTask)
+{
+    theTask.deliver_time.GetCurrentTime();
+    double queueTime = theTask.GetQueueTime();
+    double runTime = theTask.GetRunTime();
+    complete_count++;
+    queue_time_total += queueTime;
+    if (queueTime > queue_time_max) queue_time_max = queueTime;
+    run_time_total += runTime;
+    if (runTime > run_time_max) run_time_max = runTime;
+    theTask.delivered = true;  // (so the handler may resubmit or delete it)
+    if (NULL != theTask.listener) theTask.listener->on_complete(theTask);
+}  // end ProtoThreadPool::OnComplete()
+
+unsigned long ProtoThreadPool::GetStealCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < worker_count; i++)
+        count += ProtoAtomic::LoadRelaxed(&worker_list[i]->steal_count);
+    return count;
+}  // end ProtoThreadPool::GetStealCount()
+
+void ProtoThreadPool::ResetStats()
+{
+    ProtoAtomic::Store(&submit_count, 0);
+    ProtoAtomic::Store(&reject_count, 0);
+    complete_count = 0;
+    queue_time_total = queue_time_max = 0.0;
+    run_time_total = run_time_max = 0.0;
+    for (unsigned int i = 0; i < worker_count; i++)
+        ProtoAtomic::Store(&worker_list[i]->steal_count, 0);
+}  // end ProtoThreadPool::ResetStats()
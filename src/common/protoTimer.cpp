@@ -7,6 +7,7 @@
 
 #include "protoTimer.h"
 #include "protoDebug.h"
+#include "protoTrace.h"
 
 #include <stdio.h>  // for getchar() debug
 
@@ -129,7 +130,7 @@ double ProtoTimer::GetTimeRemaining() const
  *  instance).
  */
 ProtoTimerMgr::ProtoTimerMgr()
-: update_pending(false), timeout_scheduled(false),
+: update_pending(false), timeout_scheduled(false), virtual_time(false),
 #ifdef _SORTED_TIMERS
   timer_list_count(0),
 #else
@@ -151,9 +152,39 @@ ProtoTimerMgr::~ProtoTimerMgr()
 */
 void ProtoTimerMgr::GetSystemTime(struct timeval& currentTime)
 {
-    ::ProtoSystemTime(currentTime);
+    if (virtual_time)
+        currentTime = virtual_now.GetTimeVal();
+    else
+        ::ProtoSystemTime(currentTime);
 }  // end ProtoTimerMgr::GetSystemTime()
 
+bool ProtoTimerMgr::SetVirtualTime(bool state)
+{
+    if (state == virtual_time) return true;
+    // The virtual clock starts at (or the real clock resumes from) the
+    // current real time, so any active timers remain consistent
+    virtual_now.GetCurrentTime();
+    virtual_time = state;
+    return true;
+}  // end ProtoTimerMgr::SetVirtualTime()
+
+bool ProtoTimerMgr::AdvanceVirtualTime(double maxDelay)
+{
+    if (!virtual_time) return false;
+    ProtoTimer* next = GetShortHead();
+    if (NULL == next)
+    {
+        if (maxDelay < 0.0) return false;
+        virtual_now += maxDelay;
+        return true;
+    }
+    double delta = ProtoTime::Delta(next->timeout, virtual_now);
+    if ((maxDelay >= 0.0) && (delta > maxDelay)) delta = maxDelay;
+    if (delta > 0.0) virtual_now += delta;
+    OnSystemTimeout();
+    return true;
+}  // end ProtoTimerMgr::AdvanceVirtualTime()
+
 const double ProtoTimerMgr::PRECISION_TIME_THRESHOLD = 8.0;
 
 /**
@@ -161,6 +192,7 @@ const double ProtoTimerMgr::PRECISION_TIME_THRESHOLD = 8.0;
 */
 void ProtoTimerMgr::OnSystemTimeout()
 {
+    PROTO_TRACE_SCOPE("timer", "OnSystemTimeout");
     timeout_scheduled = false;
     bool updateStatus = update_pending;
     update_pending = true;
@@ -177,7 +209,10 @@ void ProtoTimerMgr::OnSystemTimeout()
         if (delta < 1.0e-06)
         {
             invoked_timer = next;
+            PROTO_TRACE_COUNTER("timer", "timeout lateness (usec)", -1.0e+06 * delta);
+            PROTO_TRACE_BEGIN("timer", "DoTimeout");
             next->DoTimeout();
+            PROTO_TRACE_END("timer", "DoTimeout");
             if(invoked_timer== next)
             {
                 if (next->IsActive())
@@ -0,0 +1,589 @@
+/**
+* @file protoTrace.cpp
+*
+* @brief Per-thread trace event ring buffers, binary trace file output and
+* conversion to the Chrome trace event JSON format.
+*
+* The binary trace file is written in little-endian order, with unsigned
+* integers written as LEB128 "varints" (7 bits per byte, least significant
+* first, with the high bit set on all but the last byte):
+*
+*   "PTRC" <version (1 byte)>
+*   <start time sec> <start time usec>   (ProtoTime when Start() was called)
+*   <ticks per usec (8 byte IEEE double)>
+*   <string count> {<length> <characters>} ...
+*   <thread count> {<thread index> <name length> <name characters>
+*                   <dropped event count> <event count> {<event>} ...} ...
+*
+* where each <event> is:
+*
+*   <type (1 byte)> <category string index> <name string index>
+*   <ticks since the thread's previous event (or trace start)> [<value>]
+*
+* and the <value> (zigzag encoded) is present only for EVENT_COUNTER events.
+* Span begin/end events are typically 5 or 6 bytes each.
+*/
+
+#include "protoTrace.h"
+#include "protoDebug.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for qsort(), bsearch()
+#include <string.h>  // for memcpy(), strncpy()
+
+static const char TRACE_MAGIC[4] = {'P', 'T', 'R', 'C'};
+static const unsigned char TRACE_VERSION = 1;
+
+bool ProtoTrace::active = false;
+unsigned int ProtoTrace::buffer_events = ProtoTrace::DEFAULT_BUFFER_EVENTS;
+uint64_t ProtoTrace::start_ticks = 0;
+ProtoTime ProtoTrace::start_time;
+ProtoTrace::Buffer* ProtoTrace::buffer_list = NULL;
+unsigned int ProtoTrace::thread_count = 0;
+PROTO_TRACE_TLS ProtoTrace::Buffer* ProtoTrace::thread_buffer = NULL;
+PROTO_TRACE_TLS char ProtoTrace::thread_label[32] = {'\0'};
+
+ProtoTrace::Buffer::Buffer(unsigned int threadIndex)
+ : event_list(NULL), event_mask(0), head(0), thread_index(threadIndex), next(NULL)
+{
+    thread_name[0] = '\0';
+}
+
+ProtoTrace::Buffer::~Buffer()
+{
+    if (NULL != event_list)
+    {
+        delete[] event_list;
+        event_list = NULL;
+    }
+}
+
+bool ProtoTrace::Buffer::Init(unsigned int numEvents)
+{
+    if (NULL == (event_list = new Event[numEvents]))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::Buffer::Init() new event_list error: %s\n", GetErrorString());
+        return false;
+    }
+    event_mask = numEvents - 1;
+    head = 0;
+    return true;
+}  // end ProtoTrace::Buffer::Init()
+
+ProtoTrace::Buffer* ProtoTrace::CreateBuffer()
+{
+    unsigned int threadIndex = ProtoAtomic::FetchAdd(&thread_count, 1);
+    Buffer* buffer = new Buffer(threadIndex);
+    if (NULL == buffer)
+    {
+        PLOG(PL_ERROR, "ProtoTrace::CreateBuffer() new Buffer error: %s\n", GetErrorString());
+        return NULL;
+    }
+    if (!buffer->Init(buffer_events))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::CreateBuffer() error: unable to allocate %u events\n", buffer_events);
+        delete buffer;
+        return NULL;
+    }
+    if ('\0' != thread_label[0])
+        memcpy(buffer->thread_name, thread_label, sizeof(buffer->thread_name));
+    else
+        snprintf(buffer->thread_name, sizeof(buffer->thread_name), "thread %u", threadIndex);
+    // Lock-free push onto the "buffer_list" (buffers are never removed, so a
+    // thread's events can still be written after the thread exits)
+    Buffer* listHead = ProtoAtomic::LoadRelaxed(&buffer_list);
+    do
+    {
+        buffer->next = listHead;
+    } while (!ProtoAtomic::CompareExchange(&buffer_list, listHead, buffer));
+    thread_buffer = buffer;
+    return buffer;
+}  // end ProtoTrace::CreateBuffer()
+
+bool ProtoTrace::Start(unsigned int bufferEvents)
+{
+    if (IsActive())
+    {
+        PLOG(PL_ERROR, "ProtoTrace::Start() error: trace already active\n");
+        return false;
+    }
+    if ((0 == bufferEvents) || (bufferEvents > 0x01000000))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::Start() error: invalid bufferEvents: %u\n", bufferEvents);
+        return false;
+    }
+    unsigned int numEvents = 1;
+    while (numEvents < bufferEvents) numEvents <<= 1;
+    buffer_events = numEvents;
+    Buffer* buffer = ProtoAtomic::Load(&buffer_list);
+    while (NULL != buffer)
+    {
+        ProtoAtomic::Store(&buffer->head, 0);
+        buffer = buffer->next;
+    }
+    start_time.GetCurrentTime();
+    start_ticks = GetTicks();
+    ProtoAtomic::Store(&active, true);
+    return true;
+}  // end ProtoTrace::Start()
+
+void ProtoTrace::Stop()
+{
+    ProtoAtomic::Store(&active, false);
+}  // end ProtoTrace::Stop()
+
+void ProtoTrace::SetThreadName(const char* name)
+{
+    strncpy(thread_label, name, sizeof(thread_label) - 1);
+    thread_label[sizeof(thread_label) - 1] = '\0';
+    if (NULL != thread_buffer)
+        memcpy(thread_buffer->thread_name, thread_label, sizeof(thread_label));
+}  // end ProtoTrace::SetThreadName()
+
+static void PutVarint(FILE* filePtr, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        putc((int)((value & 0x7f) | 0x80), filePtr);
+        value >>= 7;
+    }
+    putc((int)value, filePtr);
+}  // end PutVarint()
+
+static int ComparePointers(const void* a, const void* b)
+{
+    uintptr_t pa = (uintptr_t)(*(const char* const*)a);
+    uintptr_t pb = (uintptr_t)(*(const char* const*)b);
+    return ((pa < pb) ? -1 : ((pa > pb) ? 1 : 0));
+}  // end ComparePointers()
+
+// Returns the index of "string" in the sorted "stringList"
+static uint64_t GetStringIndex(const char* string, const char** stringList, unsigned int stringCount)
+{
+    const char** item = (const char**)bsearch(&string, stringList, stringCount, sizeof(const char*), ComparePointers);
+    return (uint64_t)(item - stringList);
+}  // end GetStringIndex()
+
+bool ProtoTrace::Write(const char* path)
+{
+    // 1) Calibrate the tick rate against ProtoTime (over at least 10 msec)
+    ProtoTime now;
+    uint64_t ticks;
+    do
+    {
+        now.GetCurrentTime();
+        ticks = GetTicks();
+    } while (ProtoTime::Delta(now, start_time) < 0.010);
+    double ticksPerUsec = (double)(ticks - start_ticks) / (1.0e+06 * ProtoTime::Delta(now, start_time));
+    if (!(ticksPerUsec > 0.0))
+    {
+        PLOG(PL_WARN, "ProtoTrace::Write() warning: tick calibration failed (system time changed?)\n");
+        ticksPerUsec = 1.0;
+    }
+
+    // 2) Copy each thread's ring buffer.  Events the owning thread may have
+    //    overwritten during the copy (per its "head" afterwards) are dropped.
+    unsigned int bufferCount = 0;
+    Buffer* bufferList = ProtoAtomic::Load(&buffer_list);
+    for (Buffer* buffer = bufferList; NULL != buffer; buffer = buffer->next) bufferCount++;
+    Event** eventList = NULL;
+    uint64_t* eventCount = NULL;
+    uint64_t* droppedCount = NULL;
+    const char** stringList = NULL;
+    FILE* filePtr = NULL;
+    unsigned int stringCount = 0;
+    unsigned int b = 0;
+    bool result = false;
+    if (0 != bufferCount)
+    {
+        if ((NULL == (eventList = new Event*[bufferCount])) ||
+            (NULL == (eventCount = new uint64_t[bufferCount])) ||
+            (NULL == (droppedCount = new uint64_t[bufferCount])))
+        {
+            PLOG(PL_ERROR, "ProtoTrace::Write() new error: %s\n", GetErrorString());
+            goto cleanup;
+        }
+        memset(eventList, 0, bufferCount * sizeof(Event*));
+    }
+    b = 0;
+    for (Buffer* buffer = bufferList; NULL != buffer; buffer = buffer->next, b++)
+    {
+        uint64_t size = buffer->event_mask + 1;
+        uint64_t last = ProtoAtomic::Load(&buffer->head);
+        uint64_t first = (last > size) ? (last - size) : 0;
+        if (NULL == (eventList[b] = new Event[last - first + 1]))
+        {
+            PLOG(PL_ERROR, "ProtoTrace::Write() new event list error: %s\n", GetErrorString());
+            goto cleanup;
+        }
+        for (uint64_t i = first; i < last; i++)
+            eventList[b][i - first] = buffer->event_list[i & buffer->event_mask];
+        ProtoAtomic::Fence();
+        uint64_t head = ProtoAtomic::LoadRelaxed(&buffer->head);
+        uint64_t valid = (head + 1 > size) ? (head + 1 - size) : 0;  // (the slot for event "head" may be mid-write)
+        if (valid > first)
+        {
+            uint64_t skip = (valid < last) ? (valid - first) : (last - first);
+            memmove(eventList[b], eventList[b] + skip, (last - first - skip) * sizeof(Event));
+            first += skip;
+        }
+        eventCount[b] = last - first;
+        droppedCount[b] = first;
+    }
+
+    // 3) Build the string table (sorted, unique category and name pointers)
+    {
+        uint64_t totalEvents = 0;
+        for (b = 0; b < bufferCount; b++) totalEvents += eventCount[b];
+        if (NULL == (stringList = new const char*[2 * totalEvents + 1]))
+        {
+            PLOG(PL_ERROR, "ProtoTrace::Write() new string list error: %s\n", GetErrorString());
+            goto cleanup;
+        }
+        for (b = 0; b < bufferCount; b++)
+        {
+            for (uint64_t i = 0; i < eventCount[b]; i++)
+            {
+                stringList[stringCount++] = eventList[b][i].category;
+                stringList[stringCount++] = eventList[b][i].name;
+            }
+        }
+        qsort(stringList, stringCount, sizeof(const char*), ComparePointers);
+        unsigned int uniqueCount = 0;
+        for (unsigned int i = 0; i < stringCount; i++)
+        {
+            if ((0 == uniqueCount) || (stringList[i] != stringList[uniqueCount - 1]))
+                stringList[uniqueCount++] = stringList[i];
+        }
+        stringCount = uniqueCount;
+    }
+
+    // 4) Write the file
+    if (NULL == (filePtr = fopen(path, "wb")))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::Write() fopen(%s) error: %s\n", path, GetErrorString());
+        goto cleanup;
+    }
+    fwrite(TRACE_MAGIC, 1, 4, filePtr);
+    putc(TRACE_VERSION, filePtr);
+    PutVarint(filePtr, start_time.sec());
+    PutVarint(filePtr, start_time.usec());
+    {
+        uint64_t bits;
+        memcpy(&bits, &ticksPerUsec, sizeof(double));
+        for (unsigned int i = 0; i < 8; i++)
+            putc((int)((bits >> (8 * i)) & 0xff), filePtr);
+    }
+    PutVarint(filePtr, stringCount);
+    for (unsigned int i = 0; i < stringCount; i++)
+    {
+        const char* string = (NULL != stringList[i]) ? stringList[i] : "";
+        size_t len = strlen(string);
+        PutVarint(filePtr, len);
+        fwrite(string, 1, len, filePtr);
+    }
+    PutVarint(filePtr, bufferCount);
+    b = 0;
+    for (Buffer* buffer = bufferList; NULL != buffer; buffer = buffer->next, b++)
+    {
+        char threadName[sizeof(buffer->thread_name)];
+        memcpy(threadName, buffer->thread_name, sizeof(threadName));
+        threadName[sizeof(threadName) - 1] = '\0';
+        size_t len = strlen(threadName);
+        PutVarint(filePtr, buffer->thread_index);
+        PutVarint(filePtr, len);
+        fwrite(threadName, 1, len, filePtr);
+        PutVarint(filePtr, droppedCount[b]);
+        PutVarint(filePtr, eventCount[b]);
+        uint64_t prevTicks = 0;
+        for (uint64_t i = 0; i < eventCount[b]; i++)
+        {
+            const Event& event = eventList[b][i];
+            uint64_t eventTicks = event.ticks & TICKS_MASK;
+            unsigned int type = (unsigned int)(event.ticks >> TYPE_SHIFT);
+            putc(type, filePtr);
+            PutVarint(filePtr, GetStringIndex(event.category, stringList, stringCount));
+            PutVarint(filePtr, GetStringIndex(event.name, stringList, stringCount));
+            if (eventTicks > prevTicks)
+            {
+                PutVarint(filePtr, eventTicks - prevTicks);
+                prevTicks = eventTicks;
+            }
+            else
+            {
+                PutVarint(filePtr, 0);  // (clamp any TSC step backwards)
+            }
+            if (EVENT_COUNTER == type)
+                PutVarint(filePtr, ((uint64_t)event.value << 1) ^ (uint64_t)(event.value >> 63));
+        }
+    }
+    if (0 != ferror(filePtr))
+        PLOG(PL_ERROR, "ProtoTrace::Write() error writing %s: %s\n", path, GetErrorString());
+    else
+        result = true;
+    if (0 != fclose(filePtr))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::Write() fclose(%s) error: %s\n", path, GetErrorString());
+        result = false;
+    }
+
+cleanup:
+    if (NULL != eventList)
+    {
+        for (b = 0; b < bufferCount; b++)
+            if (NULL != eventList[b]) delete[] eventList[b];
+        delete[] eventList;
+    }
+    if (NULL != eventCount) delete[] eventCount;
+    if (NULL != droppedCount) delete[] droppedCount;
+    if (NULL != stringList) delete[] stringList;
+    return result;
+}  // end ProtoTrace::Write()
+
+// Bounds-checked reader for ProtoTrace::ConvertToJson()
+class ProtoTraceReader
+{
+    public:
+        ProtoTraceReader(const unsigned char* buffer, size_t numBytes)
+         : ptr(buffer), end(buffer + numBytes), ok(true) {}
+
+        bool IsOK() const
+            {return ok;}
+        void SetInvalid()
+            {ok = false;}
+        size_t GetRemaining() const
+            {return (size_t)(end - ptr);}
+
+        unsigned int GetByte()
+        {
+            if (ptr < end) return *ptr++;
+            ok = false;
+            return 0;
+        }
+        uint64_t GetVarint()
+        {
+            uint64_t value = 0;
+            for (unsigned int shift = 0; shift < 64; shift += 7)
+            {
+                unsigned int byte = GetByte();
+                value |= ((uint64_t)(byte & 0x7f)) << shift;
+                if (0 == (byte & 0x80)) return value;
+            }
+            ok = false;
+            return 0;
+        }
+        // Returns a pointer to the next "len" bytes (or NULL)
+        const char* GetBytes(uint64_t len)
+        {
+            if (len > GetRemaining())
+            {
+                ok = false;
+                return NULL;
+            }
+            const char* bytes = (const char*)ptr;
+            ptr += len;
+            return bytes;
+        }
+
+    private:
+        const unsigned char*    ptr;
+        const unsigned char*    end;
+        bool                    ok;
+};  // end class ProtoTraceReader
+
+static void PutJsonString(FILE* filePtr, const char* string, uint64_t len)
+{
+    putc('"', filePtr);
+    for (uint64_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)string[i];
+        if (('"' == c) || ('\\' == c))
+            fprintf(filePtr, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(filePtr, "\\u%04x", c);
+        else
+            putc(c, filePtr);
+    }
+    putc('"', filePtr);
+}  // end PutJsonString()
+
+bool ProtoTrace::ConvertToJson(const char* tracePath, const char* jsonPath)
+{
+    // 1) Read the whole trace file
+    FILE* filePtr = fopen(tracePath, "rb");
+    if (NULL == filePtr)
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() fopen(%s) error: %s\n", tracePath, GetErrorString());
+        return false;
+    }
+    long fileSize = -1;
+    if (0 == fseek(filePtr, 0, SEEK_END)) fileSize = ftell(filePtr);
+    if ((fileSize < 0) || (0 != fseek(filePtr, 0, SEEK_SET)))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error: unable to size %s: %s\n", tracePath, GetErrorString());
+        fclose(filePtr);
+        return false;
+    }
+    unsigned char* buffer = new unsigned char[fileSize + 1];
+    if (NULL == buffer)
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() new buffer error: %s\n", GetErrorString());
+        fclose(filePtr);
+        return false;
+    }
+    size_t numBytes = fread(buffer, 1, fileSize, filePtr);
+    fclose(filePtr);
+    ProtoTraceReader reader(buffer, numBytes);
+    const char* magic = reader.GetBytes(4);
+    if ((NULL == magic) || (0 != memcmp(magic, TRACE_MAGIC, 4)) || (TRACE_VERSION != reader.GetByte()))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error: %s is not a (version %u) trace file\n",
+                       tracePath, TRACE_VERSION);
+        delete[] buffer;
+        return false;
+    }
+    uint64_t startSec = reader.GetVarint();
+    uint64_t startUsec = reader.GetVarint();
+    uint64_t bits = 0;
+    for (unsigned int i = 0; i < 8; i++)
+        bits |= ((uint64_t)reader.GetByte()) << (8 * i);
+    double ticksPerUsec;
+    memcpy(&ticksPerUsec, &bits, sizeof(double));
+    if (!(ticksPerUsec > 0.0)) ticksPerUsec = 1.0;
+    uint64_t stringCount = reader.GetVarint();
+    const char** stringList = NULL;
+    uint64_t* stringLength = NULL;
+    if (stringCount > reader.GetRemaining())
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error: invalid string count\n");
+        delete[] buffer;
+        return false;
+    }
+    if ((NULL == (stringList = new const char*[stringCount + 1])) ||
+        (NULL == (stringLength = new uint64_t[stringCount + 1])))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() new string list error: %s\n", GetErrorString());
+        if (NULL != stringList) delete[] stringList;
+        delete[] buffer;
+        return false;
+    }
+    for (uint64_t i = 0; i < stringCount; i++)
+    {
+        stringLength[i] = reader.GetVarint();
+        stringList[i] = reader.GetBytes(stringLength[i]);
+    }
+
+    // 2) Write the JSON events (thread by thread)
+    bool result = reader.IsOK();
+    if (result && (NULL == (filePtr = fopen(jsonPath, "w"))))
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() fopen(%s) error: %s\n", jsonPath, GetErrorString());
+        result = false;
+    }
+    if (result)
+    {
+        fprintf(filePtr, "{\"traceEvents\":[\n");
+        bool first = true;
+        uint64_t threadCount = reader.GetVarint();
+        for (uint64_t t = 0; reader.IsOK() && (t < threadCount); t++)
+        {
+            uint64_t threadIndex = reader.GetVarint();
+            uint64_t nameLength = reader.GetVarint();
+            const char* threadName = reader.GetBytes(nameLength);
+            uint64_t droppedCount = reader.GetVarint();
+            uint64_t eventCount = reader.GetVarint();
+            if (!reader.IsOK() || (eventCount > reader.GetRemaining())) break;
+            if (0 != droppedCount)
+                PLOG(PL_WARN, "ProtoTrace::ConvertToJson() warning: %llu earlier events of thread %llu were overwritten\n",
+                              (unsigned long long)droppedCount, (unsigned long long)threadIndex);
+            fprintf(filePtr, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":",
+                    first ? "" : ",\n", (unsigned long long)threadIndex);
+            PutJsonString(filePtr, threadName, nameLength);
+            fprintf(filePtr, "}}");
+            first = false;
+            uint64_t ticks = 0;
+            unsigned long depth = 0;
+            for (uint64_t i = 0; i < eventCount; i++)
+            {
+                unsigned int type = reader.GetByte();
+                uint64_t category = reader.GetVarint();
+                uint64_t name = reader.GetVarint();
+                ticks += reader.GetVarint();
+                int64_t value = 0;
+                if (EVENT_COUNTER == type)
+                {
+                    uint64_t zigzag = reader.GetVarint();
+                    value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+                }
+                if (!reader.IsOK() || (category >= stringCount) || (name >= stringCount))
+                {
+                    reader.SetInvalid();
+                    break;
+                }
+                const char* phase;
+                switch (type)
+                {
+                    case EVENT_BEGIN:
+                        phase = "B";
+                        depth++;
+                        break;
+                    case EVENT_END:
+                        if (0 == depth) continue;  // (begin was before the trace or overwritten)
+                        phase = "E";
+                        depth--;
+                        break;
+                    case EVENT_INSTANT:
+                        phase = "i";
+                        break;
+                    case EVENT_COUNTER:
+                        phase = "C";
+                        break;
+                    default:
+                        continue;
+                }
+                fprintf(filePtr, ",\n{\"ph\":\"%s\",\"cat\":", phase);
+                PutJsonString(filePtr, stringList[category], stringLength[category]);
+                fprintf(filePtr, ",\"name\":");
+                PutJsonString(filePtr, stringList[name], stringLength[name]);
+                fprintf(filePtr, ",\"ts\":%.3f,\"pid\":1,\"tid\":%llu", (double)ticks / ticksPerUsec,
+                        (unsigned long long)threadIndex);
+                if (EVENT_INSTANT == type)
+                {
+                    fprintf(filePtr, ",\"s\":\"t\"");
+                }
+                else if (EVENT_COUNTER == type)
+                {
+                    fprintf(filePtr, ",\"args\":{");
+                    PutJsonString(filePtr, stringList[name], stringLength[name]);
+                    fprintf(filePtr, ":%lld}", (long long)value);
+                }
+                putc('}', filePtr);
+            }
+        }
+        fprintf(filePtr, "\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"start_time\":\"%llu.%06llu\"}}\n",
+                (unsigned long long)startSec, (unsigned long long)startUsec);
+        if (!reader.IsOK())
+        {
+            PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error: %s is truncated or invalid\n", tracePath);
+            result = false;
+        }
+        if (0 != ferror(filePtr))
+        {
+            PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error writing %s: %s\n", jsonPath, GetErrorString());
+            result = false;
+        }
+        if (0 != fclose(filePtr))
+        {
+            PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() fclose(%s) error: %s\n", jsonPath, GetErrorString());
+            result = false;
+        }
+    }
+    else if (!reader.IsOK())
+    {
+        PLOG(PL_ERROR, "ProtoTrace::ConvertToJson() error: %s is truncated or invalid\n", tracePath);
+    }
+    delete[] stringLength;
+    delete[] stringList;
+    delete[] buffer;
+    return result;
+}  // end ProtoTrace::ConvertToJson()
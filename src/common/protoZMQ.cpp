@@ -1,6 +1,8 @@
 #include "protoZMQ.h"
 #include "protoDebug.h"
 
+#include <string.h>  // for memcpy()
+
 #ifdef WIN32
 #include <processthreadsapi.h>  // for GetCurrentProcessId()
 #else
@@ -12,8 +14,14 @@ ProtoZmq::PollerThread* ProtoZmq::Socket::default_poller_thread = NULL;
 ProtoMutex  ProtoZmq::Socket::default_poller_mutex;
 
 ProtoZmq::Socket::Socket()
-  : state(CLOSED), zmq_ctx(NULL), zmq_sock(NULL), poll_flags(ZMQ_POLLIN)
+  : state(CLOSED), zmq_ctx(NULL), ext_ctx(false), zmq_sock(NULL), ext_sock(false),
+    poll_flags(ZMQ_POLLIN), poll_status(0), poller_thread(NULL), poller_active(false),
+    direct_dispatcher(NULL), direct_fd(ProtoDispatcher::INVALID_DESCRIPTOR),
+    direct_active(false), in_direct_event(false), io_count(0)
 {
+    direct_timer.SetListener(this, &ProtoZmq::Socket::OnDirectTimeout);
+    direct_timer.SetInterval(0.0);
+    direct_timer.SetRepeat(0);
 }
 
 ProtoZmq::Socket::~Socket()
@@ -154,6 +162,8 @@ bool ProtoZmq::Socket::StopOutputNotification()
 
 bool ProtoZmq::Socket::SetNotifier(ProtoEvent::Notifier* theNotifier, PollerThread* pollerThread)
 {
+    if ((NULL != theNotifier) && (NULL != direct_dispatcher))
+        SetDispatcher(NULL);  // leave "direct" mode
     poller_mutex.Lock();
     if (NULL != theNotifier)
     {
@@ -209,6 +219,8 @@ bool ProtoZmq::Socket::SetNotifier(ProtoEvent::Notifier* theNotifier, PollerThre
 
 bool ProtoZmq::Socket::UpdateNotification()
 {
+    if (NULL != direct_dispatcher) 
+        return UpdateDirectNotification();
     if (CONNECTED == state)
     {
         if (HasNotifier())
@@ -347,6 +359,8 @@ bool ProtoZmq::Socket::Send(char* buffer, unsigned int& numBytes)
     int result = zmq_send(zmq_sock, buffer, numBytes, ZMQ_DONTWAIT);
     if (poller_active && (0 != (ZMQ_POLLOUT & poll_flags)))
         UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
     if (result < 0)
     {
         switch (zmq_errno())
@@ -385,6 +399,8 @@ bool ProtoZmq::Socket::SendToGroup(char* buffer, unsigned int& numBytes,const ch
     result = zmq_msg_send (&msg, zmq_sock, ZMQ_DONTWAIT); 
     if (poller_active && (0 != (ZMQ_POLLOUT & poll_flags)))
         UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
     if (result < 0)
     {
         switch (zmq_errno())
@@ -415,6 +431,8 @@ bool ProtoZmq::Socket::Recv(char* buffer, unsigned int& numBytes)
     int result = zmq_recv(zmq_sock, buffer, numBytes, ZMQ_DONTWAIT);
     if (poller_active && (0 != (ZMQ_POLLIN & poll_flags)))
         UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
     if (result < 0)
     {
         switch (zmq_errno())
@@ -445,6 +463,8 @@ bool ProtoZmq::Socket::RecvMsg(zmq_msg_t* zmqMsg)
     int result = zmq_msg_recv(zmqMsg, zmq_sock, ZMQ_DONTWAIT);
     if (poller_active && (0 != (ZMQ_POLLIN & poll_flags)))
         UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
     if (result < 0)
     {
         switch (zmq_errno())
@@ -462,9 +482,198 @@ bool ProtoZmq::Socket::RecvMsg(zmq_msg_t* zmqMsg)
     return true;
 }  // end ProtoZmq::Socket::Recv()
 
+bool ProtoZmq::Socket::RecvBatch(zmq_msg_t* msgList, unsigned int& count)
+{
+    poller_mutex.Lock();
+    unsigned int received = 0;
+    bool result = true;
+    while (received < count)
+    {
+        zmq_msg_t* msg = msgList + received;
+        zmq_msg_init(msg);
+        if (zmq_msg_recv(msg, zmq_sock, ZMQ_DONTWAIT) < 0)
+        {
+            zmq_msg_close(msg);
+            int err = zmq_errno();
+            if (EINTR == err) continue;
+            if (EAGAIN != err)
+            {
+                PLOG(PL_ERROR, "ProtoZmq::Socket::RecvBatch() zmq_msg_recv() error: %s\n", zmq_strerror(err));
+                result = false;
+            }
+            break;
+        }
+        received++;
+    }
+    count = received;
+    if (poller_active && (0 != (ZMQ_POLLIN & poll_flags)))
+        UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
+    poller_mutex.Unlock();
+    return result;
+}  // end ProtoZmq::Socket::RecvBatch()
+
+bool ProtoZmq::Socket::SendBatch(zmq_msg_t* msgList, unsigned int& count)
+{
+    poller_mutex.Lock();
+    unsigned int sent = 0;
+    bool result = true;
+    while (sent < count)
+    {
+        // (zmq_msg_send() takes ownership of the message upon success)
+        if (zmq_msg_send(msgList + sent, zmq_sock, ZMQ_DONTWAIT) < 0)
+        {
+            int err = zmq_errno();
+            if (EINTR == err) continue;
+            if (EAGAIN != err)
+            {
+                PLOG(PL_ERROR, "ProtoZmq::Socket::SendBatch() zmq_msg_send() error: %s\n", zmq_strerror(err));
+                result = false;
+            }
+            break;
+        }
+        sent++;
+    }
+    count = sent;
+    if (poller_active && (0 != (ZMQ_POLLOUT & poll_flags)))
+        UpdateNotification();  // resets poll_flags and PollerThread notification
+    else if (direct_active)
+        CheckDirectEvents();
+    poller_mutex.Unlock();
+    return result;
+}  // end ProtoZmq::Socket::SendBatch()
+
+bool ProtoZmq::Socket::SetDispatcher(ProtoDispatcher* theDispatcher)
+{
+#ifdef WIN32
+    if (NULL != theDispatcher)
+    {
+        PLOG(PL_ERROR, "ProtoZmq::Socket::SetDispatcher() error: direct mode not supported on WIN32\n");
+        return false;
+    }
+#endif // WIN32
+    if (theDispatcher == direct_dispatcher) return true;
+    if ((NULL != theDispatcher) && HasNotifier())
+        SetNotifier(NULL);  // leave PollerThread mode
+    poller_mutex.Lock();
+    if (NULL != direct_dispatcher)
+    {
+        // Uninstall from the previous dispatcher
+        int savedFlags = poll_flags;
+        poll_flags = 0;
+        UpdateDirectNotification();
+        poll_flags = savedFlags;
+    }
+    direct_dispatcher = theDispatcher;
+    bool result = (NULL != theDispatcher) ? UpdateDirectNotification() : true;
+    poller_mutex.Unlock();
+    return result;
+}  // end ProtoZmq::Socket::SetDispatcher()
+
+bool ProtoZmq::Socket::UpdateDirectNotification()
+{
+    ASSERT(NULL != direct_dispatcher);
+    if ((CONNECTED == state) && (0 != poll_flags))
+    {
+        if (!direct_active)
+        {
+            size_t len = sizeof(direct_fd);
+            if (0 != zmq_getsockopt(zmq_sock, ZMQ_FD, &direct_fd, &len))
+            {
+                PLOG(PL_ERROR, "ProtoZmq::Socket::UpdateDirectNotification() zmq_getsockopt(ZMQ_FD) error: %s\n", 
+                        zmq_strerror(zmq_errno()));
+                return false;
+            }
+            if (!direct_dispatcher->InstallGenericInput(direct_fd, DirectCallback, this))
+            {
+                PLOG(PL_ERROR, "ProtoZmq::Socket::UpdateDirectNotification() error: unable to install ZMQ_FD\n");
+                return false;
+            }
+            direct_active = true;
+        }
+        // Events may already be pending (with no ZMQ_FD edge to come)
+        CheckDirectEvents();
+    }
+    else if (direct_active)
+    {
+        direct_dispatcher->RemoveGenericInput(direct_fd);
+        direct_fd = ProtoDispatcher::INVALID_DESCRIPTOR;
+        direct_active = false;
+        if (direct_timer.IsActive()) direct_timer.Deactivate();
+    }
+    return true;
+}  // end ProtoZmq::Socket::UpdateDirectNotification()
+
+void ProtoZmq::Socket::CheckDirectEvents()
+{
+    // Called after socket I/O.  Since ZMQ_FD only signals state changes,
+    // a pending event that arose during that I/O is picked up here
+    // (OnDirectEvent() loops itself, so there is nothing to do there)
+    io_count++;
+    if (in_direct_event || direct_timer.IsActive()) return;
+    int events = 0;
+    size_t len = sizeof(events);
+    if (0 != zmq_getsockopt(zmq_sock, ZMQ_EVENTS, &events, &len))
+    {
+        PLOG(PL_ERROR, "ProtoZmq::Socket::CheckDirectEvents() zmq_getsockopt(ZMQ_EVENTS) error: %s\n", 
+                zmq_strerror(zmq_errno()));
+        return;
+    }
+    if (0 != (events & poll_flags))
+        direct_dispatcher->ActivateTimer(direct_timer);
+}  // end ProtoZmq::Socket::CheckDirectEvents()
+
+void ProtoZmq::Socket::OnDirectTimeout(ProtoTimer& /*theTimer*/)
+{
+    OnDirectEvent();
+}  // end ProtoZmq::Socket::OnDirectTimeout()
+
+void ProtoZmq::Socket::DirectCallback(ProtoDispatcher::Descriptor /*descriptor*/, 
+                                      ProtoDispatcher::Event      /*theEvent*/, 
+                                      const void*                 userData)
+{
+    Socket* zmqSocket = reinterpret_cast<Socket*>(const_cast<void*>(userData));
+    zmqSocket->OnDirectEvent();
+}  // end ProtoZmq::Socket::DirectCallback()
+
+void ProtoZmq::Socket::OnDirectEvent()
+{
+    // Reading ZMQ_EVENTS also clears the ZMQ_FD signal.  The listener is
+    // notified until no events remain or it stops doing I/O.  Since no
+    // further ZMQ_FD edge will come for events it leaves pending, those are
+    // re-notified from the direct_timer on the next dispatcher pass (so we
+    // don't spin here on events it doesn't want to handle right now).
+    in_direct_event = true;
+    while (direct_active)
+    {
+        int events = 0;
+        size_t len = sizeof(events);
+        if (0 != zmq_getsockopt(zmq_sock, ZMQ_EVENTS, &events, &len))
+        {
+            if (EINTR == zmq_errno()) continue;
+            PLOG(PL_ERROR, "ProtoZmq::Socket::OnDirectEvent() zmq_getsockopt(ZMQ_EVENTS) error: %s\n", 
+                    zmq_strerror(zmq_errno()));
+            break;
+        }
+        int status = events & poll_flags;
+        if (0 == status) break;
+        SetPollStatus(status);
+        unsigned long ioCount = io_count;
+        ProtoEvent::OnNotify();
+        if (ioCount == io_count)
+        {
+            if (direct_active && !direct_timer.IsActive())
+                direct_dispatcher->ActivateTimer(direct_timer);
+            break;
+        }
+    }
+    in_direct_event = false;
+}  // end ProtoZmq::Socket::OnDirectEvent()
+
 ProtoZmq::PollerThread::PollerThread()
-  : zmq_ctx(NULL), ext_ctx(false), zmq_poller(NULL), event_array(NULL), 
-    event_array_length(0), socket_count(0)
+  : zmq_ctx(NULL), ext_ctx(false), zmq_poller(NULL), poller_running(false),
+    event_array(NULL), event_array_length(0), socket_count(0)
 {
 }
 
@@ -653,26 +862,38 @@ int ProtoZmq::PollerThread::RunThread()
             }
             continue;
         }
-        // Dispatch events for signaled sockets
+        // If we were signaled, sockets may have been added, modified or removed
+        // (and the event_array reallocated) since zmq_poller_wait_all() returned,
+        // so the other events are left for the next (level-triggered) poll
+        bool signaled = false;
         for (int i = 0; i < result; i++)
         {
-            zmq_poller_event_t* item = event_array + i;  
-            if (break_server.GetSocket() == item->socket)
+            if (break_server.GetSocket() == event_array[i].socket)
             {
-                // It's our "break" socket, so consume any 'break' messages
-                char dummy[64];
-                unsigned int numBytes;
-                do
-                {
-                    numBytes = 64;
-                    if (!break_server.Recv(dummy, numBytes))
-                    {
-                        PLOG(PL_ERROR, "ProtoZmq::PollerThread::RunThread() error: break_server.Recv() failure!\n");
-                        break;
-                    }
-                } while (0 != numBytes);
-                continue;
+                signaled = true;
+                break;
             }
+        }
+        if (signaled)
+        {
+            // Consume any 'break' messages
+            char dummy[64];
+            unsigned int numBytes;
+            do
+            {
+                numBytes = 64;
+                if (!break_server.Recv(dummy, numBytes))
+                {
+                    PLOG(PL_ERROR, "ProtoZmq::PollerThread::RunThread() error: break_server.Recv() failure!\n");
+                    break;
+                }
+            } while (0 != numBytes);
+            continue;
+        }
+        // Dispatch events for signaled sockets
+        for (int i = 0; i < result; i++)
+        {
+            zmq_poller_event_t* item = event_array + i;  
             Socket* zmqSocket = reinterpret_cast<Socket*>(item->user_data);
             zmqSocket->poller_mutex.Lock();
             // Filter events so we don't get redundant polling notifications.
@@ -752,7 +973,12 @@ bool ProtoZmq::PollerThread::AddSocketPrivate(Socket& zmqSocket)
             PLOG(PL_ERROR, " ProtoZmq::PollerThread::AddSocketPrivate() new event_array error: %s\n", GetErrorString());
             return false;
         }
-        if (NULL != event_array) delete[] event_array;  // delete old array
+        if (NULL != event_array) 
+        {
+            // (copied since the poller thread may be holding results)
+            memcpy(tempArray, event_array, event_array_length*sizeof(zmq_poller_event_t));
+            delete[] event_array;  // delete old array
+        }
         event_array = tempArray;                        // point to new array
         event_array_length = length;                    // save new length
     }
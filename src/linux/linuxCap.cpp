@@ -21,6 +21,11 @@
 #endif
 #include <netinet/in.h>
 
+// sendmmsg() is available as of glibc 2.14
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 14)))
+#define HAVE_SENDMMSG
+#endif
+
 /** This implementation of ProtoCap uses the
  *  PF_PACKET socket type available on Linux systems
  */
@@ -34,6 +39,9 @@ class LinuxCap : public ProtoCap
         bool Open(const char* interfaceName = NULL);
         void Close();
         bool Send(const char* buffer, unsigned int& numBytes);
+#ifdef HAVE_SENDMMSG
+        unsigned int SendBatch(const char* const* bufferList, const unsigned int* lengthList, unsigned int count);
+#endif // HAVE_SENDMMSG
         bool Recv(char* buffer, unsigned int& numBytes, Direction* direction = NULL);
         
 };  // end class LinuxCap
@@ -299,6 +307,53 @@ bool LinuxCap::Send(const char* buffer, unsigned int& numBytes)
     return true;
 }  // end LinuxCap::Send()
 
+#ifdef HAVE_SENDMMSG
+unsigned int LinuxCap::SendBatch(const char* const* bufferList, const unsigned int* lengthList, unsigned int count)
+{
+    // GRE interfaces need per-frame sendto() addressing
+    if (ProtoNet::IFACE_GRE == if_type)
+        return ProtoCap::SendBatch(bufferList, lengthList, count);
+    // Since the socket is bound to the interface, frames can be 
+    // passed to the kernel in groups with a single sendmmsg() call
+    const unsigned int MMSG_MAX = 64;
+    struct mmsghdr msgList[MMSG_MAX];
+    struct iovec iovList[MMSG_MAX];
+    unsigned int sent = 0;
+    while (sent < count)
+    {
+        unsigned int msgCount = 0;
+        while ((msgCount < MMSG_MAX) && ((sent + msgCount) < count))
+        {
+            const char* buffer = bufferList[sent + msgCount];
+            unsigned int numBytes = lengthList[sent + msgCount];
+            // Stop at zero length or 802.3 frames (see LinuxCap::Send())
+            if (numBytes < 14) break;
+            UINT16 type;
+            memcpy(&type, buffer+12, 2);
+            if (ntohs(type) <= 0x05dc) break;
+            iovList[msgCount].iov_base = (void*)buffer;
+            iovList[msgCount].iov_len = numBytes;
+            memset(&msgList[msgCount], 0, sizeof(struct mmsghdr));
+            msgList[msgCount].msg_hdr.msg_iov = &iovList[msgCount];
+            msgList[msgCount].msg_hdr.msg_iovlen = 1;
+            msgCount++;
+        }
+        if (0 == msgCount) break;
+        int result = sendmmsg(descriptor, msgList, msgCount, 0);
+        if (result < 0)
+        {
+            if (EINTR == errno) continue;  // try again
+            // Leave it to the caller to Send() the next frame 
+            // and determine if the error is transient
+            break;
+        }
+        sent += result;
+        if ((unsigned int)result < msgCount) break;
+    }
+    return sent;
+}  // end LinuxCap::SendBatch()
+#endif // HAVE_SENDMMSG
+
 bool LinuxCap::Recv(char* buffer, unsigned int& numBytes, Direction* direction)
 {
     struct sockaddr_ll pktAddr;
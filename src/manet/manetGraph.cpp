@@ -459,7 +459,7 @@ const char* NetGraph::Interface::GetVerticeKey() const
     if (addr_list.IsEmpty())
         return name_ptr;
     else
-        return default_addr_item.GetAddress().GetRawHostAddress();
+        return default_addr_item.GetCompactAddress().GetRawHostAddress();
 }  // end NetGraph::Interface::GetVerticeKey()
 
 unsigned int NetGraph::Interface::GetVerticeKeysize() const
@@ -480,7 +480,7 @@ unsigned int NetGraph::Interface::GetVerticeKeysize() const
     }
     else
     {
-        return (default_addr_item.GetAddress().GetLength() << 3);
+        return (default_addr_item.GetCompactAddress().GetLength() << 3);
     }
 }  // end NetGraph::Interface::GetVerticeKeysize()
 
@@ -733,7 +733,7 @@ bool ManetAddrBlock::InitFromBuffer(UINT8 addrLength, void* bufferPtr, unsigned
         minLength += GetHeadLength();
         if (buffer_bytes < minLength) return false;
     }
-    if (HasTail())
+    if (HasTail() || HasZeroTail())
     {
         minLength += 1;
         if (buffer_bytes < minLength) return false;
@@ -931,7 +931,7 @@ bool ManetMsg::SetSequence(UINT16 sequence)
             return false;
         }
     }
-    SetUINT8(offsetSequence, sequence);
+    SetUINT16(offsetSequence, sequence);
     return true;
 }  // end ManetMsg::SetSequence()
 
@@ -0,0 +1,766 @@
+#include "manetPktView.h"
+
+bool ManetPktView::Tlv::GetValue(UINT8& value, UINT8 index) const
+{
+    if ((value_length < 1) || (IsMultiValue() && !AppliesTo(index))) return false;
+    value = (UINT8)*GetValuePtr(index);
+    return true;
+}  // end ManetPktView::Tlv::GetValue(UINT8)
+
+bool ManetPktView::Tlv::GetValue(UINT16& value, UINT8 index) const
+{
+    if ((value_length < 2) || (IsMultiValue() && !AppliesTo(index))) return false;
+    UINT16 temp16;
+    memcpy(&temp16, GetValuePtr(index), 2);
+    value = ntohs(temp16);
+    return true;
+}  // end ManetPktView::Tlv::GetValue(UINT16)
+
+bool ManetPktView::Tlv::GetValue(UINT32& value, UINT8 index) const
+{
+    if ((value_length < 4) || (IsMultiValue() && !AppliesTo(index))) return false;
+    UINT32 temp32;
+    memcpy(&temp32, GetValuePtr(index), 4);
+    value = ntohl(temp32);
+    return true;
+}  // end ManetPktView::Tlv::GetValue(UINT32)
+
+bool ManetPktView::Msg::GetOriginator(ProtoAddress& addr) const
+{
+    if (HasOriginator())
+        addr.SetRawHostAddress(GetAddressType(), originator_ptr, addr_length);
+    else
+        addr.Invalidate();
+    return addr.IsValid();
+}  // end ManetPktView::Msg::GetOriginator()
+
+ManetPktView::ManetPktView()
+{
+    Clear();
+}
+
+ManetPktView::~ManetPktView()
+{
+}
+
+void ManetPktView::Clear()
+{
+    pkt_buffer = NULL;
+    pkt_length = 0;
+    pkt_semantics = 0;
+    pkt_seq = 0;
+    pkt_tlv_count = 0;
+    msg_count = block_count = tlv_count = addr_count = 0;
+}  // end ManetPktView::Clear()
+
+bool ManetPktView::Parse(const void* bufferPtr, unsigned int numBytes)
+{
+    Clear();
+    if ((NULL == bufferPtr) || (numBytes < 1)) return false;
+    pkt_buffer = (const UINT8*)bufferPtr;
+    pkt_length = numBytes;
+    pkt_semantics = pkt_buffer[0];
+    unsigned int offset = 1;
+    if (HasSequence())
+    {
+        if ((offset + 2) > pkt_length)
+        {
+            PLOG(PL_ERROR, "ManetPktView::Parse() error: truncated packet header\n");
+            return false;
+        }
+        pkt_seq = GetUINT16(offset);
+        offset += 2;
+    }
+    if (0 != (pkt_semantics & PKT_HAS_TLV_BLOCK))
+    {
+        UINT16 tlvIndex, tlvCount;
+        if (!ParseTlvBlock(offset, pkt_length, 0, tlvIndex, tlvCount))
+        {
+            PLOG(PL_ERROR, "ManetPktView::Parse() error: invalid pkt-tlv-block\n");
+            return false;
+        }
+        pkt_tlv_count = tlvCount;
+    }
+    while (offset < pkt_length)
+    {
+        if (!ParseMessage(offset)) return false;
+    }
+    return true;
+}  // end ManetPktView::Parse()
+
+// Parses the <tlv-block> at "offset", advancing "offset" past it.  A non-zero
+// "numAddrs" indicates an address block TLV block so index ranges are resolved.
+bool ManetPktView::ParseTlvBlock(unsigned int&  offset,
+                                 unsigned int   limit,
+                                 unsigned int   numAddrs,
+                                 UINT16&        tlvIndex,
+                                 UINT16&        tlvCount)
+{
+    if ((offset + 2) > limit) return false;
+    unsigned int blockEnd = offset + 2 + GetUINT16(offset);
+    if (blockEnd > limit) return false;
+    offset += 2;
+    tlvIndex = tlv_count;
+    tlvCount = 0;
+    while (offset < blockEnd)
+    {
+        if (tlv_count >= TLV_MAX)
+        {
+            PLOG(PL_ERROR, "ManetPktView::ParseTlvBlock() error: TLV_MAX exceeded\n");
+            return false;
+        }
+        if ((offset + 2) > blockEnd) return false;
+        Tlv& tlv = tlv_list[tlv_count];
+        tlv.tlv_type = pkt_buffer[offset++];
+        UINT8 flags = pkt_buffer[offset++];
+        tlv.tlv_flags = flags;
+        tlv.tlv_type_ext = 0;
+        if (0 != (flags & EXTENDED_TYPE))
+        {
+            if (offset >= blockEnd) return false;
+            tlv.tlv_type_ext = pkt_buffer[offset++];
+        }
+        if (0 != (flags & SINGLE_INDEX))
+        {
+            if (offset >= blockEnd) return false;
+            tlv.index_start = tlv.index_stop = pkt_buffer[offset++];
+        }
+        else if (0 != (flags & MULTI_INDEX))
+        {
+            if ((offset + 2) > blockEnd) return false;
+            tlv.index_start = pkt_buffer[offset++];
+            tlv.index_stop = pkt_buffer[offset++];
+            if (tlv.index_start > tlv.index_stop) return false;
+        }
+        else
+        {
+            tlv.index_start = 0;
+            tlv.index_stop = (0 != numAddrs) ? (UINT8)(numAddrs - 1) : 0;
+        }
+        if ((0 != numAddrs) && (tlv.index_stop >= numAddrs)) return false;
+        UINT16 tlvLength = 0;
+        if (0 != (flags & HAS_VALUE))
+        {
+            if (0 != (flags & EXTENDED_LENGTH))
+            {
+                if ((offset + 2) > blockEnd) return false;
+                tlvLength = GetUINT16(offset);
+                offset += 2;
+            }
+            else
+            {
+                if (offset >= blockEnd) return false;
+                tlvLength = pkt_buffer[offset++];
+            }
+            if ((offset + tlvLength) > blockEnd) return false;
+            tlv.value_ptr = (const char*)pkt_buffer + offset;
+        }
+        else
+        {
+            tlv.value_ptr = NULL;
+        }
+        tlv.tlv_length = tlvLength;
+        if ((0 != (flags & MULTIVALUE)) && (0 != tlvLength))
+        {
+            unsigned int numValues = tlv.index_stop - tlv.index_start + 1;
+            if (0 != (tlvLength % numValues))
+            {
+                PLOG(PL_ERROR, "ManetPktView::ParseTlvBlock() error: multivalue TLV length not integral of num-values\n");
+                return false;
+            }
+            tlv.value_length = tlvLength / numValues;
+        }
+        else
+        {
+            tlv.value_length = tlvLength;
+        }
+        offset += tlvLength;
+        tlv_count++;
+        tlvCount++;
+    }
+    return true;
+}  // end ManetPktView::ParseTlvBlock()
+
+bool ManetPktView::ParseMessage(unsigned int& offset)
+{
+    if (msg_count >= MSG_MAX)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: MSG_MAX exceeded\n");
+        return false;
+    }
+    if ((offset + 4) > pkt_length)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: truncated message header\n");
+        return false;
+    }
+    Msg& msg = msg_list[msg_count];
+    msg.msg_offset = offset;
+    msg.msg_type = pkt_buffer[offset];
+    msg.msg_flags = pkt_buffer[offset+1] & 0xf0;
+    msg.addr_length = (pkt_buffer[offset+1] & 0x0f) + 1;
+    msg.msg_size = GetUINT16(offset+2);
+    unsigned int msgEnd = offset + msg.msg_size;
+    if ((msg.msg_size < 4) || (msgEnd > pkt_length))
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: invalid msg-size %u\n", msg.msg_size);
+        return false;
+    }
+    if (msg.addr_length > ADDR_SIZE_MAX)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: unsupported msg-addr-length %u\n", msg.addr_length);
+        return false;
+    }
+    offset += 4;
+    unsigned int headerLength = ((0 != (msg.msg_flags & HAS_ORIGINATOR)) ? msg.addr_length : 0) +
+                                (msg.HasHopLimit() ? 1 : 0) +
+                                (msg.HasHopCount() ? 1 : 0) +
+                                (msg.HasSequence() ? 2 : 0);
+    if ((offset + headerLength) > msgEnd)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: truncated message header\n");
+        return false;
+    }
+    msg.originator_ptr = NULL;
+    if (0 != (msg.msg_flags & HAS_ORIGINATOR))
+    {
+        msg.originator_ptr = (const char*)pkt_buffer + offset;
+        offset += msg.addr_length;
+    }
+    msg.hop_limit = msg.HasHopLimit() ? pkt_buffer[offset++] : 0;
+    msg.hop_count = msg.HasHopCount() ? pkt_buffer[offset++] : 0;
+    msg.msg_seq = 0;
+    if (msg.HasSequence())
+    {
+        msg.msg_seq = GetUINT16(offset);
+        offset += 2;
+    }
+    if (!ParseTlvBlock(offset, msgEnd, 0, msg.tlv_index, msg.tlv_count))
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: invalid msg-tlv-block\n");
+        return false;
+    }
+    msg.block_index = block_count;
+    msg.block_count = 0;
+    while (offset < msgEnd)
+    {
+        if (!ParseAddrBlock(offset, msgEnd, msg.addr_length))
+        {
+            PLOG(PL_ERROR, "ManetPktView::ParseMessage() error: invalid address block\n");
+            return false;
+        }
+        msg.block_count++;
+    }
+    msg_count++;
+    return true;
+}  // end ManetPktView::ParseMessage()
+
+bool ManetPktView::ParseAddrBlock(unsigned int& offset, unsigned int limit, UINT8 addrLength)
+{
+    if (block_count >= ADDR_BLOCK_MAX)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseAddrBlock() error: ADDR_BLOCK_MAX exceeded\n");
+        return false;
+    }
+    if ((offset + 2) > limit) return false;
+    UINT8 numAddrs = pkt_buffer[offset++];
+    UINT8 flags = pkt_buffer[offset++];
+    if (0 == numAddrs) return false;
+    if ((addr_count + numAddrs) > ADDR_MAX)
+    {
+        PLOG(PL_ERROR, "ManetPktView::ParseAddrBlock() error: ADDR_MAX exceeded\n");
+        return false;
+    }
+    const UINT8* head = NULL;
+    unsigned int hlen = 0;
+    if (0 != (flags & HAS_HEAD))
+    {
+        if (offset >= limit) return false;
+        hlen = pkt_buffer[offset++];
+        if ((offset + hlen) > limit) return false;
+        head = pkt_buffer + offset;
+        offset += hlen;
+    }
+    const UINT8* tail = NULL;
+    unsigned int tlen = 0;
+    if (0 != (flags & (HAS_FULL_TAIL | HAS_ZERO_TAIL)))
+    {
+        if ((HAS_FULL_TAIL | HAS_ZERO_TAIL) == (flags & (HAS_FULL_TAIL | HAS_ZERO_TAIL))) return false;
+        if (offset >= limit) return false;
+        tlen = pkt_buffer[offset++];
+        if (0 != (flags & HAS_FULL_TAIL))
+        {
+            if ((offset + tlen) > limit) return false;
+            tail = pkt_buffer + offset;
+            offset += tlen;
+        }
+    }
+    if ((hlen + tlen) > addrLength) return false;
+    unsigned int mlen = addrLength - hlen - tlen;
+    if ((offset + numAddrs*mlen) > limit) return false;
+    // Expand the addresses into our fixed-stride "addr_buffer"
+    char* addrPtr = addr_buffer + addr_count*ADDR_SIZE_MAX;
+    const UINT8* midPtr = pkt_buffer + offset;
+    for (unsigned int i = 0; i < numAddrs; i++)
+    {
+        if (0 != hlen) memcpy(addrPtr, head, hlen);
+        if (0 != mlen) memcpy(addrPtr + hlen, midPtr, mlen);
+        if (NULL != tail)
+            memcpy(addrPtr + hlen + mlen, tail, tlen);
+        else if (0 != tlen)
+            memset(addrPtr + hlen + mlen, 0, tlen);
+        addrPtr += ADDR_SIZE_MAX;
+        midPtr += mlen;
+    }
+    offset += numAddrs*mlen;
+    UINT8* prefixPtr = prefix_list + addr_count;
+    UINT8 maxPrefix = addrLength << 3;
+    if (0 != (flags & HAS_SINGLE_PREFIX))
+    {
+        if (offset >= limit) return false;
+        UINT8 prefixLen = pkt_buffer[offset++];
+        if (prefixLen > maxPrefix) return false;
+        memset(prefixPtr, prefixLen, numAddrs);
+    }
+    else if (0 != (flags & HAS_MULTI_PREFIX))
+    {
+        if ((offset + numAddrs) > limit) return false;
+        for (unsigned int i = 0; i < numAddrs; i++)
+        {
+            if (pkt_buffer[offset] > maxPrefix) return false;
+            prefixPtr[i] = pkt_buffer[offset++];
+        }
+    }
+    else
+    {
+        memset(prefixPtr, maxPrefix, numAddrs);
+    }
+    AddrBlock& block = block_list[block_count];
+    block.addr_count = numAddrs;
+    block.addr_index = addr_count;
+    if (!ParseTlvBlock(offset, limit, numAddrs, block.tlv_index, block.tlv_count))
+        return false;
+    addr_count += numAddrs;
+    block_count++;
+    return true;
+}  // end ManetPktView::ParseAddrBlock()
+
+bool ManetPktView::GetAddress(const Msg& msg, unsigned int index, ProtoAddress& addr) const
+{
+    addr.SetRawHostAddress(msg.GetAddressType(), GetAddressPtr(index), msg.GetAddressLength());
+    return addr.IsValid();
+}  // end ManetPktView::GetAddress()
+
+const ManetPktView::Tlv* ManetPktView::FindTlv(unsigned int tlvIndex, unsigned int tlvCount, UINT8 type) const
+{
+    unsigned int end = tlvIndex + tlvCount;
+    if (end > tlv_count) end = tlv_count;
+    for (unsigned int i = tlvIndex; i < end; i++)
+        if (type == tlv_list[i].tlv_type) return &tlv_list[i];
+    return NULL;
+}  // end ManetPktView::FindTlv()
+
+
+ManetPktWriter::ManetPktWriter()
+ : buffer_ptr(NULL), buffer_bytes(0), pkt_length(0), state(STATE_IDLE),
+   pkt_flags(0), msg_offset(0), msg_addr_length(0), tlv_block_offset(0),
+   block_addr_count(0)
+{
+}
+
+ManetPktWriter::~ManetPktWriter()
+{
+}
+
+bool ManetPktWriter::Init(void* bufferPtr, unsigned int numBytes, UINT8 version)
+{
+    state = STATE_IDLE;
+    pkt_length = 0;
+    if ((NULL == bufferPtr) || (numBytes < 1)) return false;
+    buffer_ptr = (UINT8*)bufferPtr;
+    buffer_bytes = numBytes;
+    pkt_flags = version << 4;
+    pkt_length = 1;  // <pkt-flags> byte is filled in by Finish()
+    state = STATE_PKT_HEADER;
+    return true;
+}  // end ManetPktWriter::Init()
+
+bool ManetPktWriter::SetSequence(UINT16 sequence)
+{
+    if ((STATE_PKT_HEADER != state) || (0 != (pkt_flags & 0x08)) || !HasRoom(2))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::SetSequence() error: out of order or no room\n");
+        return false;
+    }
+    pkt_flags |= 0x08;  // HAS_SEQ_NUM
+    PutUINT16(sequence);
+    return true;
+}  // end ManetPktWriter::SetSequence()
+
+bool ManetPktWriter::AppendTlv(TlvContext   context,
+                               UINT8        type,
+                               UINT8        typeExt,
+                               bool         hasTypeExt,
+                               UINT8        indexStart,
+                               UINT8        indexStop,
+                               const char*  value,
+                               UINT16       valueLength,
+                               bool         multiValue)
+{
+    switch (context)
+    {
+        case PKT_TLV:
+            if (STATE_PKT_HEADER == state)
+            {
+                if (!HasRoom(2)) return false;
+                pkt_flags |= 0x04;  // HAS_TLV_BLOCK
+                OpenTlvBlock();
+                state = STATE_PKT_TLV;
+            }
+            if (STATE_PKT_TLV != state)
+            {
+                PLOG(PL_ERROR, "ManetPktWriter::AppendPktTlv() error: pkt-tlv must precede messages\n");
+                return false;
+            }
+            break;
+        case MSG_TLV:
+            if (STATE_MSG_TLV != state)
+            {
+                PLOG(PL_ERROR, "ManetPktWriter::AppendMsgTlv() error: msg-tlv must precede address blocks\n");
+                return false;
+            }
+            break;
+        case ADDR_TLV:
+            if (STATE_ADDR_TLV != state)
+            {
+                PLOG(PL_ERROR, "ManetPktWriter::AppendAddrTlv() error: no address block\n");
+                return false;
+            }
+            if ((indexStart > indexStop) || (indexStop >= block_addr_count))
+            {
+                PLOG(PL_ERROR, "ManetPktWriter::AppendAddrTlv() error: invalid index range\n");
+                return false;
+            }
+            break;
+    }
+    UINT8 flags = 0;
+    unsigned int tlvLength = 2;
+    if (hasTypeExt)
+    {
+        flags |= 0x80;  // EXTENDED_TYPE
+        tlvLength++;
+    }
+    bool fullBlock = (0 == indexStart) && ((indexStop + 1U) == block_addr_count);
+    if ((ADDR_TLV == context) && !fullBlock)
+    {
+        if (indexStart == indexStop)
+        {
+            flags |= 0x40;  // SINGLE_INDEX
+            tlvLength++;
+        }
+        else
+        {
+            flags |= 0x20;  // MULTI_INDEX
+            tlvLength += 2;
+        }
+    }
+    if ((ADDR_TLV == context) && multiValue && (indexStart != indexStop))
+    {
+        if (0 != (valueLength % (indexStop - indexStart + 1)))
+        {
+            PLOG(PL_ERROR, "ManetPktWriter::AppendAddrTlv() error: value length not integral of num-values\n");
+            return false;
+        }
+        flags |= 0x04;  // MULTIVALUE
+    }
+    if (0 != valueLength)
+    {
+        flags |= 0x10;  // HAS_VALUE
+        if (valueLength > 255)
+        {
+            flags |= 0x08;  // EXTENDED_LENGTH
+            tlvLength += 2;
+        }
+        else
+        {
+            tlvLength++;
+        }
+    }
+    tlvLength += valueLength;
+    if (!HasRoom(tlvLength))
+    {
+        PLOG(PL_WARN, "ManetPktWriter::AppendTlv() warning: no room for TLV\n");
+        return false;
+    }
+    PutUINT8(type);
+    PutUINT8(flags);
+    if (hasTypeExt) PutUINT8(typeExt);
+    if (0 != (flags & 0x40))
+    {
+        PutUINT8(indexStart);
+    }
+    else if (0 != (flags & 0x20))
+    {
+        PutUINT8(indexStart);
+        PutUINT8(indexStop);
+    }
+    if (0 != valueLength)
+    {
+        if (valueLength > 255)
+            PutUINT16(valueLength);
+        else
+            PutUINT8((UINT8)valueLength);
+        memcpy(buffer_ptr + pkt_length, value, valueLength);
+        pkt_length += valueLength;
+    }
+    return true;
+}  // end ManetPktWriter::AppendTlv()
+
+bool ManetPktWriter::BeginMessage(UINT8                type,
+                                  UINT8                addrLength,
+                                  const ProtoAddress*  originator,
+                                  int                  hopLimit,
+                                  int                  hopCount,
+                                  int                  sequence)
+{
+    if ((STATE_MSG_TLV == state) || (STATE_ADDR_TLV == state))
+    {
+        EndMessage();
+    }
+    else if (STATE_PKT_TLV == state)
+    {
+        CloseTlvBlock();
+        state = STATE_MSG_END;
+    }
+    if ((STATE_PKT_HEADER != state) && (STATE_MSG_END != state))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::BeginMessage() error: packet not initialized\n");
+        return false;
+    }
+    if ((addrLength < 1) || (addrLength > 16) ||
+        ((NULL != originator) && (originator->GetLength() != addrLength)))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::BeginMessage() error: invalid address length\n");
+        return false;
+    }
+    UINT8 flags = 0;
+    unsigned int headerLength = 4 + 2;  // includes empty msg-tlv-block
+    if (NULL != originator)
+    {
+        flags |= 0x80;
+        headerLength += addrLength;
+    }
+    if (hopLimit >= 0)
+    {
+        flags |= 0x40;
+        headerLength++;
+    }
+    if (hopCount >= 0)
+    {
+        flags |= 0x20;
+        headerLength++;
+    }
+    if (sequence >= 0)
+    {
+        flags |= 0x10;
+        headerLength += 2;
+    }
+    if (!HasRoom(headerLength))
+    {
+        PLOG(PL_WARN, "ManetPktWriter::BeginMessage() warning: no room for message\n");
+        return false;
+    }
+    msg_offset = pkt_length;
+    msg_addr_length = addrLength;
+    PutUINT8(type);
+    PutUINT8(flags | ((addrLength - 1) & 0x0f));
+    pkt_length += 2;  // <msg-size> is filled in by EndMessage()
+    if (NULL != originator)
+    {
+        memcpy(buffer_ptr + pkt_length, originator->GetRawHostAddress(), addrLength);
+        pkt_length += addrLength;
+    }
+    if (hopLimit >= 0) PutUINT8((UINT8)hopLimit);
+    if (hopCount >= 0) PutUINT8((UINT8)hopCount);
+    if (sequence >= 0) PutUINT16((UINT16)sequence);
+    OpenTlvBlock();
+    state = STATE_MSG_TLV;
+    return true;
+}  // end ManetPktWriter::BeginMessage()
+
+bool ManetPktWriter::AppendAddressBlock(const ProtoAddress* addrList,
+                                        unsigned int        numAddrs,
+                                        const UINT8*        prefixLengths)
+{
+    if ((STATE_MSG_TLV != state) && (STATE_ADDR_TLV != state))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::AppendAddressBlock() error: no message\n");
+        return false;
+    }
+    if ((0 == numAddrs) || (numAddrs > 255))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::AppendAddressBlock() error: invalid address count\n");
+        return false;
+    }
+    unsigned int addrLength = msg_addr_length;
+    for (unsigned int i = 0; i < numAddrs; i++)
+    {
+        if (addrList[i].GetLength() != addrLength)
+        {
+            PLOG(PL_ERROR, "ManetPktWriter::AppendAddressBlock() error: address length mismatch\n");
+            return false;
+        }
+    }
+    // Find the longest common head (a mid of at least one byte is kept)
+    // and only use it if it saves space
+    const char* first = addrList[0].GetRawHostAddress();
+    unsigned int hlen = addrLength - 1;
+    for (unsigned int i = 1; (i < numAddrs) && (0 != hlen); i++)
+    {
+        const char* addr = addrList[i].GetRawHostAddress();
+        unsigned int j = 0;
+        while ((j < hlen) && (addr[j] == first[j])) j++;
+        hlen = j;
+    }
+    if (((numAddrs - 1) * hlen) <= 1) hlen = 0;
+    // Then the longest common tail of what's left, which
+    // needs no tail bytes at all if it is all zero
+    unsigned int tlen = addrLength - 1 - hlen;
+    for (unsigned int i = 1; (i < numAddrs) && (0 != tlen); i++)
+    {
+        const char* addr = addrList[i].GetRawHostAddress();
+        unsigned int j = 0;
+        while ((j < tlen) && (addr[addrLength-1-j] == first[addrLength-1-j])) j++;
+        tlen = j;
+    }
+    bool zeroTail = true;
+    for (unsigned int j = 0; j < tlen; j++)
+    {
+        if (0 != first[addrLength-1-j])
+        {
+            zeroTail = false;
+            break;
+        }
+    }
+    if (zeroTail)
+    {
+        if ((numAddrs * tlen) <= 1) tlen = 0;
+    }
+    else if (((numAddrs - 1) * tlen) <= 1)
+    {
+        tlen = 0;
+    }
+    unsigned int mlen = addrLength - hlen - tlen;
+
+    // Determine if prefix length(s) are needed
+    UINT8 flags = 0;
+    unsigned int prefixCount = 0;
+    if (NULL != prefixLengths)
+    {
+        bool samePrefix = true;
+        for (unsigned int i = 1; i < numAddrs; i++)
+        {
+            if (prefixLengths[i] != prefixLengths[0])
+            {
+                samePrefix = false;
+                break;
+            }
+        }
+        if (!samePrefix)
+        {
+            flags |= 0x08;  // HAS_MULTI_PREFIX
+            prefixCount = numAddrs;
+        }
+        else if (prefixLengths[0] != (addrLength << 3))
+        {
+            flags |= 0x10;  // HAS_SINGLE_PREFIX
+            prefixCount = 1;
+        }
+    }
+
+    unsigned int blockLength = 2 + numAddrs*mlen + prefixCount + 2;  // includes empty tlv-block
+    if (0 != hlen)
+    {
+        flags |= 0x80;  // HAS_HEAD
+        blockLength += 1 + hlen;
+    }
+    if (0 != tlen)
+    {
+        flags |= zeroTail ? 0x20 : 0x40;  // HAS_ZERO_TAIL : HAS_FULL_TAIL
+        blockLength += 1 + (zeroTail ? 0 : tlen);
+    }
+    if (!HasRoom(blockLength))
+    {
+        PLOG(PL_WARN, "ManetPktWriter::AppendAddressBlock() warning: no room for address block\n");
+        return false;
+    }
+    CloseTlvBlock();  // msg-tlv-block or previous address block's tlv-block
+    PutUINT8((UINT8)numAddrs);
+    PutUINT8(flags);
+    if (0 != hlen)
+    {
+        PutUINT8((UINT8)hlen);
+        memcpy(buffer_ptr + pkt_length, first, hlen);
+        pkt_length += hlen;
+    }
+    if (0 != tlen)
+    {
+        PutUINT8((UINT8)tlen);
+        if (!zeroTail)
+        {
+            memcpy(buffer_ptr + pkt_length, first + addrLength - tlen, tlen);
+            pkt_length += tlen;
+        }
+    }
+    for (unsigned int i = 0; i < numAddrs; i++)
+    {
+        memcpy(buffer_ptr + pkt_length, addrList[i].GetRawHostAddress() + hlen, mlen);
+        pkt_length += mlen;
+    }
+    if (1 == prefixCount)
+    {
+        PutUINT8(prefixLengths[0]);
+    }
+    else if (0 != prefixCount)
+    {
+        memcpy(buffer_ptr + pkt_length, prefixLengths, numAddrs);
+        pkt_length += numAddrs;
+    }
+    OpenTlvBlock();
+    block_addr_count = numAddrs;
+    state = STATE_ADDR_TLV;
+    return true;
+}  // end ManetPktWriter::AppendAddressBlock()
+
+bool ManetPktWriter::EndMessage()
+{
+    if ((STATE_MSG_TLV != state) && (STATE_ADDR_TLV != state))
+    {
+        PLOG(PL_ERROR, "ManetPktWriter::EndMessage() error: no message\n");
+        return false;
+    }
+    CloseTlvBlock();
+    SetUINT16(msg_offset + 2, (UINT16)(pkt_length - msg_offset));
+    state = STATE_MSG_END;
+    return true;
+}  // end ManetPktWriter::EndMessage()
+
+unsigned int ManetPktWriter::Finish()
+{
+    switch (state)
+    {
+        case STATE_IDLE:
+            return 0;
+        case STATE_PKT_TLV:
+            CloseTlvBlock();
+            break;
+        case STATE_MSG_TLV:
+        case STATE_ADDR_TLV:
+            EndMessage();
+            break;
+        default:
+            break;
+    }
+    buffer_ptr[0] = pkt_flags;
+    state = STATE_IDLE;
+    return pkt_length;
+}  // end ManetPktWriter::Finish()
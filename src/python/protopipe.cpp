@@ -44,6 +44,8 @@ extern "C" {
             self->thisptr = new ProtoPipe(ProtoPipe::MESSAGE);
         else if (strcmp(typestr, "STREAM") == 0)
             self->thisptr = new ProtoPipe(ProtoPipe::STREAM);
+        else if (strcmp(typestr, "SEQPACKET") == 0)
+            self->thisptr = new ProtoPipe(ProtoPipe::SEQPACKET);
         else
             return -2;
 
@@ -62,6 +64,10 @@ extern "C" {
                 return Py_BuildValue("s", "STREAM");
                 break;
 
+            case ProtoPipe::SEQPACKET:
+                return Py_BuildValue("s", "SEQPACKET");
+                break;
+
             default:
                 PyErr_SetString(ProtoError, "Invalid Pipe Type");
                 return NULL;
@@ -0,0 +1,973 @@
+/**
+* @file nativeProtoSim.cpp
+*
+* @brief In-process discrete event network simulator for ProtoSimAgent code
+*/
+#include "nativeProtoSim.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy()
+
+/**
+ * @class NativeProtoSim::Event
+ *
+ * @brief A timer or packet arrival event.  Each agent has one timer event
+ * (for its ProtoTimerMgr "system timer") that is updated in place, and
+ * packet events (with their buffers) are recycled by the partitions.
+ */
+class NativeProtoSim::Event
+{
+    public:
+        enum Type {TIMER, PACKET};
+
+        Event(Type theType, NativeProtoSimAgent* theAgent = NULL);
+        ~Event();
+
+        bool IsQueued() const
+            {return (heap_index >= 0);}
+        bool SetData(const char* data, unsigned int numBytes);
+
+        // Events are ordered by time, then by originating agent and its
+        // sequence, so the order does not depend upon the partitioning
+        bool Precedes(const Event& theEvent) const
+        {
+            if (time != theEvent.time)
+                return (time < theEvent.time);
+            else if (origin != theEvent.origin)
+                return (origin < theEvent.origin);
+            else
+                return (seq < theEvent.seq);
+        }
+
+        Type                    type;
+        double                  time;
+        SIMADDR                 origin;
+        UINT32                  seq;
+        int                     heap_index;
+        NativeProtoSimAgent*    agent;      // (destination agent)
+        SIMADDR                 src_addr;
+        SIMADDR                 dst_addr;
+        UINT16                  src_port;
+        UINT16                  dst_port;
+        char*                   buffer;
+        unsigned int            buffer_size;
+        unsigned int            length;
+        Event*                  next;       // (for pool and inbox lists)
+};  // end class NativeProtoSim::Event
+
+NativeProtoSim::Event::Event(Type theType, NativeProtoSimAgent* theAgent)
+ : type(theType), time(0.0), origin(0), seq(0), heap_index(-1), agent(theAgent),
+   src_addr(0), dst_addr(0), src_port(0), dst_port(0),
+   buffer(NULL), buffer_size(0), length(0), next(NULL)
+{
+}
+
+NativeProtoSim::Event::~Event()
+{
+    if (NULL != buffer)
+    {
+        delete[] buffer;
+        buffer = NULL;
+    }
+}
+
+bool NativeProtoSim::Event::SetData(const char* data, unsigned int numBytes)
+{
+    if (numBytes > buffer_size)
+    {
+        char* newBuffer = new char[numBytes];
+        if (NULL == newBuffer)
+        {
+            PLOG(PL_ERROR, "NativeProtoSim::Event::SetData() new buffer error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL != buffer) delete[] buffer;
+        buffer = newBuffer;
+        buffer_size = numBytes;
+    }
+    memcpy(buffer, data, numBytes);
+    length = numBytes;
+    return true;
+}  // end NativeProtoSim::Event::SetData()
+
+/**
+ * @class NativeProtoSim::Partition
+ *
+ * @brief A set of agents with their own event queue (an indexed binary
+ * heap), clock and thread.  Events from agents in other partitions arrive
+ * via the "inbox" and are merged into the heap between windows.
+ */
+class NativeProtoSim::Partition : public ProtoThread
+{
+    public:
+        Partition(NativeProtoSim& theSim);
+        ~Partition();
+
+        bool Insert(Event& theEvent);
+        void Remove(Event& theEvent);
+        Event* GetHead() const
+            {return ((0 != heap_count) ? heap[0] : NULL);}
+
+        Event* GetPacketEvent();
+        void PutPacketEvent(Event& theEvent)
+        {
+            theEvent.next = event_pool;
+            event_pool = &theEvent;
+        }
+        void Post(Event& theEvent);  // (from other partitions)
+        bool MergeInbox();
+
+        void RunUntil(double endTime);
+        int RunThread();
+
+        double          now;
+        unsigned long   event_count;
+        unsigned long   sent_count;
+        unsigned long   delivered_count;
+        unsigned long   lost_count;
+        unsigned long   unroutable_count;
+
+    private:
+        void Place(Event& theEvent, unsigned int index)
+        {
+            heap[index] = &theEvent;
+            theEvent.heap_index = (int)index;
+        }
+        void SiftUp(unsigned int index);
+        void SiftDown(unsigned int index);
+
+        NativeProtoSim& sim;
+        Event**         heap;
+        unsigned int    heap_count;
+        unsigned int    heap_size;
+        Event*          event_pool;
+        ProtoMutex      inbox_mutex;
+        Event*          inbox_head;
+};  // end class NativeProtoSim::Partition
+
+// The partition whose events are being processed by the calling thread
+#ifdef WIN32
+static __declspec(thread) NativeProtoSim::Partition* current_partition = NULL;
+#else
+static __thread NativeProtoSim::Partition* current_partition = NULL;
+#endif // if/else WIN32
+
+double NativeProtoSimClock()
+{
+    return ((NULL != current_partition) ? current_partition->now : 0.0);
+}  // end NativeProtoSimClock()
+
+NativeProtoSim::Partition::Partition(NativeProtoSim& theSim)
+ : now(0.0), event_count(0), sent_count(0), delivered_count(0), lost_count(0),
+   unroutable_count(0), sim(theSim), heap(NULL), heap_count(0), heap_size(0),
+   event_pool(NULL), inbox_head(NULL)
+{
+}
+
+NativeProtoSim::Partition::~Partition()
+{
+    MergeInbox();
+    for (unsigned int i = 0; i < heap_count; i++)
+    {
+        // (agents' timer events have been removed by now)
+        delete heap[i];
+    }
+    heap_count = 0;
+    if (NULL != heap)
+    {
+        delete[] heap;
+        heap = NULL;
+    }
+    while (NULL != event_pool)
+    {
+        Event* event = event_pool;
+        event_pool = event->next;
+        delete event;
+    }
+}
+
+bool NativeProtoSim::Partition::Insert(Event& theEvent)
+{
+    ASSERT(!theEvent.IsQueued());
+    if (heap_count == heap_size)
+    {
+        unsigned int newSize = (0 != heap_size) ? (2 * heap_size) : 256;
+        Event** newHeap = new Event*[newSize];
+        if (NULL == newHeap)
+        {
+            PLOG(PL_ERROR, "NativeProtoSim::Partition::Insert() new heap error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL != heap)
+        {
+            memcpy(newHeap, heap, heap_count * sizeof(Event*));
+            delete[] heap;
+        }
+        heap = newHeap;
+        heap_size = newSize;
+    }
+    Place(theEvent, heap_count++);
+    SiftUp(theEvent.heap_index);
+    return true;
+}  // end NativeProtoSim::Partition::Insert()
+
+void NativeProtoSim::Partition::Remove(Event& theEvent)
+{
+    ASSERT(theEvent.IsQueued());
+    unsigned int index = (unsigned int)theEvent.heap_index;
+    theEvent.heap_index = -1;
+    if (index != --heap_count)
+    {
+        // Move the last event into the hole and restore the heap order
+        Event* moved = heap[heap_count];
+        Place(*moved, index);
+        SiftUp(index);
+        SiftDown(moved->heap_index);
+    }
+}  // end NativeProtoSim::Partition::Remove()
+
+void NativeProtoSim::Partition::SiftUp(unsigned int index)
+{
+    Event* event = heap[index];
+    while (0 != index)
+    {
+        unsigned int parent = (index - 1) >> 1;
+        if (!event->Precedes(*heap[parent])) break;
+        Place(*heap[parent], index);
+        index = parent;
+    }
+    Place(*event, index);
+}  // end NativeProtoSim::Partition::SiftUp()
+
+void NativeProtoSim::Partition::SiftDown(unsigned int index)
+{
+    Event* event = heap[index];
+    while (true)
+    {
+        unsigned int child = (index << 1) + 1;
+        if (child >= heap_count) break;
+        if (((child + 1) < heap_count) && heap[child + 1]->Precedes(*heap[child]))
+            child++;
+        if (!heap[child]->Precedes(*event)) break;
+        Place(*heap[child], index);
+        index = child;
+    }
+    Place(*event, index);
+}  // end NativeProtoSim::Partition::SiftDown()
+
+NativeProtoSim::Event* NativeProtoSim::Partition::GetPacketEvent()
+{
+    Event* event = event_pool;
+    if (NULL != event)
+    {
+        event_pool = event->next;
+        event->next = NULL;
+    }
+    else if (NULL == (event = new Event(Event::PACKET)))
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::Partition::GetPacketEvent() new event error: %s\n", GetErrorString());
+    }
+    return event;
+}  // end NativeProtoSim::Partition::GetPacketEvent()
+
+void NativeProtoSim::Partition::Post(Event& theEvent)
+{
+    inbox_mutex.Lock();
+    theEvent.next = inbox_head;
+    inbox_head = &theEvent;
+    inbox_mutex.Unlock();
+}  // end NativeProtoSim::Partition::Post()
+
+bool NativeProtoSim::Partition::MergeInbox()
+{
+    inbox_mutex.Lock();
+    Event* event = inbox_head;
+    inbox_head = NULL;
+    inbox_mutex.Unlock();
+    bool result = true;
+    while (NULL != event)
+    {
+        Event* next = event->next;
+        event->next = NULL;
+        if (!Insert(*event))
+        {
+            delete event;
+            result = false;
+        }
+        event = next;
+    }
+    return result;
+}  // end NativeProtoSim::Partition::MergeInbox()
+
+void NativeProtoSim::Partition::RunUntil(double endTime)
+{
+    Event* event;
+    while (!sim.stopped && (NULL != (event = GetHead())) && (event->time < endTime))
+    {
+        Remove(*event);
+        now = event->time;
+        event_count++;
+        if (Event::TIMER == event->type)
+        {
+            event->agent->OnSystemTimeout();  // (may reschedule the event)
+        }
+        else
+        {
+            event->agent->Deliver(*event);
+            PutPacketEvent(*event);
+        }
+    }
+}  // end NativeProtoSim::Partition::RunUntil()
+
+int NativeProtoSim::Partition::RunThread()
+{
+    current_partition = this;
+    unsigned int windowId = 0;
+    double windowEnd;
+    while (sim.WaitWindow(windowId, windowEnd))
+    {
+        RunUntil(windowEnd);
+        sim.OnWindowDone();
+    }
+    return 0;
+}  // end NativeProtoSim::Partition::RunThread()
+
+NativeProtoSim::NativeProtoSim(unsigned int numPartitions)
+ : partition_list(NULL), partition_count(0), agent_list(NULL), agent_count(0),
+   agent_size(0), rand_seed(1), lookahead(-1.0), stopped(false),
+   window_id(0), window_end(0.0), running_count(0), exiting(false)
+{
+    if (0 == numPartitions) numPartitions = 1;
+    if (NULL == (partition_list = new Partition*[numPartitions]))
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::NativeProtoSim() new partition list error: %s\n", GetErrorString());
+        return;
+    }
+    for (unsigned int i = 0; i < numPartitions; i++)
+    {
+        if (NULL == (partition_list[i] = new Partition(*this)))
+        {
+            PLOG(PL_ERROR, "NativeProtoSim::NativeProtoSim() new partition error: %s\n", GetErrorString());
+            break;
+        }
+        partition_count++;
+    }
+}
+
+NativeProtoSim::~NativeProtoSim()
+{
+    for (unsigned int i = 0; i < agent_count; i++)
+    {
+        NativeProtoSimAgent* agent = agent_list[i];
+        if (NULL == agent) continue;  // (agent already deleted)
+        if (agent->timer_event->IsQueued()) agent->partition->Remove(*agent->timer_event);
+        agent->simulator = NULL;
+        agent->partition = NULL;
+    }
+    if (NULL != agent_list)
+    {
+        delete[] agent_list;
+        agent_list = NULL;
+    }
+    agent_count = agent_size = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        delete partition_list[i];
+    if (NULL != partition_list)
+    {
+        delete[] partition_list;
+        partition_list = NULL;
+    }
+    partition_count = 0;
+}
+
+SIMADDR NativeProtoSim::AddAgent(NativeProtoSimAgent& theAgent, unsigned int partition)
+{
+    if (NULL != theAgent.simulator)
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::AddAgent() error: agent already added\n");
+        return 0;
+    }
+    if (partition >= partition_count)
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::AddAgent() error: invalid partition %u\n", partition);
+        return 0;
+    }
+    if (agent_count == agent_size)
+    {
+        unsigned int newSize = (0 != agent_size) ? (2 * agent_size) : 64;
+        NativeProtoSimAgent** newList = new NativeProtoSimAgent*[newSize];
+        if (NULL == newList)
+        {
+            PLOG(PL_ERROR, "NativeProtoSim::AddAgent() new agent list error: %s\n", GetErrorString());
+            return 0;
+        }
+        if (NULL != agent_list)
+        {
+            memcpy(newList, agent_list, agent_count * sizeof(NativeProtoSimAgent*));
+            delete[] agent_list;
+        }
+        agent_list = newList;
+        agent_size = newSize;
+    }
+    agent_list[agent_count++] = &theAgent;
+    theAgent.simulator = this;
+    theAgent.partition = partition_list[partition];
+    theAgent.sim_addr = agent_count;
+    // Seed the agent's generator from the simulation seed and its address ("splitmix" step)
+    uint64_t state = ((uint64_t)rand_seed << 32) + agent_count + 0x9e3779b97f4a7c15ULL;
+    state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    state = (state ^ (state >> 27)) * 0x94d049bb133111ebULL;
+    theAgent.rand_state = (0 != state) ? state : 1;
+    return theAgent.sim_addr;
+}  // end NativeProtoSim::AddAgent()
+
+bool NativeProtoSim::Link(SIMADDR addr1, SIMADDR addr2, double delay,
+                          double lossRate, double bitsPerSecond)
+{
+    NativeProtoSimAgent* agent1 = GetAgent(addr1);
+    NativeProtoSimAgent* agent2 = GetAgent(addr2);
+    if ((NULL == agent1) || (NULL == agent2) || (agent1 == agent2))
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::Link() error: invalid agent address\n");
+        return false;
+    }
+    if (delay < 0.0)
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::Link() error: invalid delay\n");
+        return false;
+    }
+    if (!agent1->AddLink(*agent2, delay, lossRate, bitsPerSecond) ||
+        !agent2->AddLink(*agent1, delay, lossRate, bitsPerSecond))
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::Link() error: unable to add link\n");
+        return false;
+    }
+    if ((agent1->partition != agent2->partition) && ((lookahead < 0.0) || (delay < lookahead)))
+        lookahead = delay;
+    return true;
+}  // end NativeProtoSim::Link()
+
+bool NativeProtoSim::Run(double duration)
+{
+    if (0 == partition_count) return false;
+    stopped = false;
+    double endTime = GetTime() + duration;
+    bool result = true;
+    if (1 == partition_count)
+    {
+        Partition* partition = partition_list[0];
+        current_partition = partition;
+        partition->MergeInbox();
+        partition->RunUntil(endTime);
+    }
+    else
+    {
+        result = RunWindows(endTime);
+    }
+    if (!stopped)
+    {
+        for (unsigned int i = 0; i < partition_count; i++)
+            partition_list[i]->now = endTime;
+    }
+    return result;
+}  // end NativeProtoSim::Run()
+
+bool NativeProtoSim::RunWindows(double endTime)
+{
+    if (0.0 == lookahead)
+    {
+        PLOG(PL_ERROR, "NativeProtoSim::Run() error: zero delay link between partitions\n");
+        return false;
+    }
+    // (with no links between partitions, they can run independently)
+    double windowSize = (lookahead > 0.0) ? lookahead : (endTime - GetTime());
+    window_mutex.Lock();
+    exiting = false;
+    window_id = 0;
+    window_mutex.Unlock();
+    bool result = true;
+    unsigned int started = 0;
+    for (; started < partition_count; started++)
+    {
+        if (!partition_list[started]->StartThread())
+        {
+            PLOG(PL_ERROR, "NativeProtoSim::Run() error: unable to start partition thread\n");
+            result = false;
+            break;
+        }
+    }
+    while (result && !stopped)
+    {
+        // Find the earliest pending event over all partitions
+        Event* next = NULL;
+        for (unsigned int i = 0; i < partition_count; i++)
+        {
+            Partition* partition = partition_list[i];
+            if (!partition->MergeInbox()) result = false;
+            Event* head = partition->GetHead();
+            if ((NULL != head) && ((NULL == next) || head->Precedes(*next)))
+                next = head;
+        }
+        if ((NULL == next) || (next->time >= endTime)) break;
+        // No partition can receive an event for this window from another
+        double windowEnd = next->time + windowSize;
+        if (windowEnd > endTime) windowEnd = endTime;
+        window_mutex.Lock();
+        window_end = windowEnd;
+        window_id++;
+        running_count = started;
+        start_cond.Broadcast();
+        while (0 != running_count)
+            done_cond.Wait(window_mutex);
+        window_mutex.Unlock();
+    }
+    window_mutex.Lock();
+    exiting = true;
+    start_cond.Broadcast();
+    window_mutex.Unlock();
+    for (unsigned int i = 0; i < started; i++)
+        partition_list[i]->StopThread();  // (joins the thread)
+    return result;
+}  // end NativeProtoSim::RunWindows()
+
+bool NativeProtoSim::WaitWindow(unsigned int& windowId, double& windowEnd)
+{
+    window_mutex.Lock();
+    while ((windowId == window_id) && !exiting)
+        start_cond.Wait(window_mutex);
+    bool result = !exiting;
+    windowId = window_id;
+    windowEnd = window_end;
+    window_mutex.Unlock();
+    return result;
+}  // end NativeProtoSim::WaitWindow()
+
+void NativeProtoSim::OnWindowDone()
+{
+    window_mutex.Lock();
+    if (0 == --running_count) done_cond.Signal();
+    window_mutex.Unlock();
+}  // end NativeProtoSim::OnWindowDone()
+
+void NativeProtoSim::Stop()
+{
+    stopped = true;
+}  // end NativeProtoSim::Stop()
+
+double NativeProtoSim::GetTime() const
+{
+    double now = 0.0;
+    for (unsigned int i = 0; i < partition_count; i++)
+    {
+        if (partition_list[i]->now > now)
+            now = partition_list[i]->now;
+    }
+    return now;
+}  // end NativeProtoSim::GetTime()
+
+unsigned long NativeProtoSim::GetEventCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        count += partition_list[i]->event_count;
+    return count;
+}  // end NativeProtoSim::GetEventCount()
+
+unsigned long NativeProtoSim::GetSentCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        count += partition_list[i]->sent_count;
+    return count;
+}  // end NativeProtoSim::GetSentCount()
+
+unsigned long NativeProtoSim::GetDeliveredCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        count += partition_list[i]->delivered_count;
+    return count;
+}  // end NativeProtoSim::GetDeliveredCount()
+
+unsigned long NativeProtoSim::GetLostCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        count += partition_list[i]->lost_count;
+    return count;
+}  // end NativeProtoSim::GetLostCount()
+
+unsigned long NativeProtoSim::GetUnroutableCount() const
+{
+    unsigned long count = 0;
+    for (unsigned int i = 0; i < partition_count; i++)
+        count += partition_list[i]->unroutable_count;
+    return count;
+}  // end NativeProtoSim::GetUnroutableCount()
+
+NativeProtoSimAgent::NativeProtoSimAgent()
+ : simulator(NULL), partition(NULL), sim_addr(0),
+   timer_event(new NativeProtoSim::Event(NativeProtoSim::Event::TIMER, this)),
+   link_list(NULL), link_count(0), link_size(0), next_port(49152),
+   event_seq(0), rand_state(1)
+{
+}
+
+NativeProtoSimAgent::~NativeProtoSimAgent()
+{
+    if (NULL != simulator)
+    {
+        if (timer_event->IsQueued()) partition->Remove(*timer_event);
+        simulator->agent_list[sim_addr - 1] = NULL;
+        simulator = NULL;
+        partition = NULL;
+    }
+    if (NULL != timer_event)
+    {
+        delete timer_event;
+        timer_event = NULL;
+    }
+    if (NULL != link_list)
+    {
+        delete[] link_list;
+        link_list = NULL;
+    }
+    link_count = link_size = 0;
+}
+
+void NativeProtoSimAgent::SetContext()
+{
+    current_partition = partition;
+}  // end NativeProtoSimAgent::SetContext()
+
+bool NativeProtoSimAgent::Startup(int argc, const char*const* argv)
+{
+    if (NULL == partition)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::Startup() error: agent not added to a simulator\n");
+        return false;
+    }
+    SetContext();
+    return OnStartup(argc, argv);
+}  // end NativeProtoSimAgent::Startup()
+
+bool NativeProtoSimAgent::Command(int argc, const char*const* argv)
+{
+    if (NULL == partition)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::Command() error: agent not added to a simulator\n");
+        return false;
+    }
+    SetContext();
+    return ProcessCommands(argc, argv);
+}  // end NativeProtoSimAgent::Command()
+
+void NativeProtoSimAgent::Shutdown()
+{
+    if (NULL != partition) SetContext();
+    OnShutdown();
+}  // end NativeProtoSimAgent::Shutdown()
+
+bool NativeProtoSimAgent::GetLocalAddress(ProtoAddress& localAddr)
+{
+    if (0 == sim_addr) return false;
+    localAddr.SimSetAddress(sim_addr);
+    return true;
+}  // end NativeProtoSimAgent::GetLocalAddress()
+
+double NativeProtoSimAgent::UniformRandom()
+{
+    // xorshift64* generator
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return (double)((rand_state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}  // end NativeProtoSimAgent::UniformRandom()
+
+bool NativeProtoSimAgent::UpdateSystemTimer(ProtoTimer::Command command, double delay)
+{
+    if (NULL == partition)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UpdateSystemTimer() error: agent not added to a simulator\n");
+        return false;
+    }
+    if (timer_event->IsQueued()) partition->Remove(*timer_event);
+    switch (command)
+    {
+        case ProtoTimer::INSTALL:
+        case ProtoTimer::MODIFY:
+            timer_event->time = partition->now + ((delay > 0.0) ? delay : 0.0);
+            timer_event->origin = sim_addr;
+            timer_event->seq = event_seq++;
+            return partition->Insert(*timer_event);
+        case ProtoTimer::REMOVE:
+            break;
+    }
+    return true;
+}  // end NativeProtoSimAgent::UpdateSystemTimer()
+
+ProtoSimAgent::SocketProxy* NativeProtoSimAgent::OpenSocket(ProtoSocket& theSocket)
+{
+    if (ProtoSocket::UDP != theSocket.GetProtocol())
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::OpenSocket() error: only UDP sockets are supported\n");
+        return NULL;
+    }
+    UdpSocketProxy* proxy = new UdpSocketProxy(*this);
+    if (NULL == proxy)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::OpenSocket() new socket proxy error: %s\n", GetErrorString());
+        return NULL;
+    }
+    proxy->AttachSocket(theSocket);
+    socket_proxy_list.Prepend(*proxy);
+    return proxy;
+}  // end NativeProtoSimAgent::OpenSocket()
+
+void NativeProtoSimAgent::CloseSocket(ProtoSocket& theSocket)
+{
+    ASSERT(theSocket.IsOpen());
+    UdpSocketProxy* proxy = static_cast<UdpSocketProxy*>(theSocket.GetHandle());
+    socket_proxy_list.Remove(*proxy);
+    delete proxy;
+}  // end NativeProtoSimAgent::CloseSocket()
+
+bool NativeProtoSimAgent::AddLink(NativeProtoSimAgent& peer, double delay,
+                                  double lossRate, double bitsPerSecond)
+{
+    if (link_count == link_size)
+    {
+        unsigned int newSize = (0 != link_size) ? (2 * link_size) : 8;
+        Link* newList = new Link[newSize];
+        if (NULL == newList)
+        {
+            PLOG(PL_ERROR, "NativeProtoSimAgent::AddLink() new link list error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL != link_list)
+        {
+            memcpy(newList, link_list, link_count * sizeof(Link));
+            delete[] link_list;
+        }
+        link_list = newList;
+        link_size = newSize;
+    }
+    Link& link = link_list[link_count++];
+    link.peer = &peer;
+    link.delay = delay;
+    link.loss_rate = lossRate;
+    link.bits_per_second = bitsPerSecond;
+    link.busy_until = 0.0;
+    return true;
+}  // end NativeProtoSimAgent::AddLink()
+
+static inline bool IsGroupAddress(SIMADDR theAddr)
+{
+    return ((0 != (theAddr & 0x80000000)) && (0xffffffff != theAddr));
+}  // end IsGroupAddress()
+
+bool NativeProtoSimAgent::SendPacket(const char* buffer, unsigned int numBytes, UINT16 srcPort,
+                                     const ProtoAddress& dstAddr, bool loopback)
+{
+    if (NULL == partition)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::SendPacket() error: agent not added to a simulator\n");
+        return false;
+    }
+    SIMADDR dst = dstAddr.SimGetAddress();
+    UINT16 dstPort = dstAddr.GetPort();
+    double now = partition->now;
+    Link* link = link_list;
+    Link* linkEnd = link_list + link_count;
+    if ((0xffffffff == dst) || IsGroupAddress(dst))
+    {
+        if (loopback && IsGroupAddress(dst))
+            Schedule(*this, now, dst, srcPort, dstPort, buffer, numBytes);
+    }
+    else if (dst == sim_addr)
+    {
+        Schedule(*this, now, dst, srcPort, dstPort, buffer, numBytes);
+        return true;
+    }
+    else
+    {
+        // Unicast only reaches a linked neighbor
+        for (; link < linkEnd; link++)
+        {
+            if (dst == link->peer->sim_addr) break;
+        }
+        if (link == linkEnd)
+        {
+            partition->unroutable_count++;
+            return true;  // (silently dropped, as by the network)
+        }
+        linkEnd = link + 1;
+    }
+    for (; link < linkEnd; link++)
+    {
+        partition->sent_count++;
+        // Packets queue for transmission when the link has finite bandwidth
+        double start = (link->busy_until > now) ? link->busy_until : now;
+        if (link->bits_per_second > 0.0)
+            link->busy_until = start + (8.0 * numBytes) / link->bits_per_second;
+        else
+            link->busy_until = start;
+        if ((link->loss_rate > 0.0) && (UniformRandom() < link->loss_rate))
+        {
+            partition->lost_count++;
+            continue;
+        }
+        Schedule(*link->peer, link->busy_until + link->delay, dst, srcPort, dstPort, buffer, numBytes);
+    }
+    return true;
+}  // end NativeProtoSimAgent::SendPacket()
+
+void NativeProtoSimAgent::Schedule(NativeProtoSimAgent& dst, double arrival, SIMADDR dstAddr,
+                                   UINT16 srcPort, UINT16 dstPort, const char* buffer, unsigned int numBytes)
+{
+    NativeProtoSim::Event* event = partition->GetPacketEvent();
+    if (NULL == event) return;
+    if (!event->SetData(buffer, numBytes))
+    {
+        partition->PutPacketEvent(*event);
+        return;
+    }
+    event->time = arrival;
+    event->origin = sim_addr;
+    event->seq = event_seq++;
+    event->agent = &dst;
+    event->src_addr = sim_addr;
+    event->dst_addr = dstAddr;
+    event->src_port = srcPort;
+    event->dst_port = dstPort;
+    if (dst.partition == partition)
+    {
+        if (!partition->Insert(*event)) partition->PutPacketEvent(*event);
+    }
+    else
+    {
+        dst.partition->Post(*event);
+    }
+}  // end NativeProtoSimAgent::Schedule()
+
+void NativeProtoSimAgent::Deliver(NativeProtoSim::Event& theEvent)
+{
+    UdpSocketProxy* proxy = static_cast<UdpSocketProxy*>(socket_proxy_list.FindProxyByPort(theEvent.dst_port));
+    if (NULL == proxy) return;
+    if (IsGroupAddress(theEvent.dst_addr) && !proxy->IsMember(theEvent.dst_addr)) return;
+    partition->delivered_count++;
+    proxy->recv_data = theEvent.buffer;
+    proxy->recv_len = theEvent.length;
+    proxy->recv_addr.SimSetAddress(theEvent.src_addr);
+    proxy->recv_addr.SetPort(theEvent.src_port);
+    proxy->GetSocket()->OnNotify(ProtoNotify::NOTIFY_INPUT);
+    // (the socket may have been closed by its listener)
+    proxy = static_cast<UdpSocketProxy*>(socket_proxy_list.FindProxyByPort(theEvent.dst_port));
+    if (NULL != proxy) proxy->recv_data = NULL;
+}  // end NativeProtoSimAgent::Deliver()
+
+NativeProtoSimAgent::UdpSocketProxy::UdpSocketProxy(NativeProtoSimAgent& theAgent)
+ : agent(theAgent), mcast_loopback(false), group_count(0),
+   recv_data(NULL), recv_len(0)
+{
+}
+
+NativeProtoSimAgent::UdpSocketProxy::~UdpSocketProxy()
+{
+}
+
+bool NativeProtoSimAgent::UdpSocketProxy::Bind(UINT16& thePort)
+{
+    if (0 == thePort)
+    {
+        // Pick an unused ephemeral port (65535 is the port of unbound sockets)
+        for (unsigned int i = 49152; i < 65535; i++)
+        {
+            UINT16 port = agent.next_port++;
+            if (agent.next_port >= 65535) agent.next_port = 49152;
+            if (NULL == agent.socket_proxy_list.FindProxyByPort(port))
+            {
+                thePort = port;
+                return true;
+            }
+        }
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UdpSocketProxy::Bind() error: no free ports\n");
+        return false;
+    }
+    SocketProxy* proxy = agent.socket_proxy_list.FindProxyByPort(thePort);
+    if ((NULL != proxy) && (this != proxy))
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UdpSocketProxy::Bind() error: port %hu in use\n", thePort);
+        return false;
+    }
+    return true;
+}  // end NativeProtoSimAgent::UdpSocketProxy::Bind()
+
+bool NativeProtoSimAgent::UdpSocketProxy::SendTo(const char*         buffer,
+                                                 unsigned int&       numBytes,
+                                                 const ProtoAddress& dstAddr)
+{
+    if (ProtoAddress::SIM != dstAddr.GetType())
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UdpSocketProxy::SendTo() error: invalid destination address\n");
+        return false;
+    }
+    return agent.SendPacket(buffer, numBytes, GetPort(), dstAddr, mcast_loopback);
+}  // end NativeProtoSimAgent::UdpSocketProxy::SendTo()
+
+bool NativeProtoSimAgent::UdpSocketProxy::RecvFrom(char*         buffer,
+                                                   unsigned int& numBytes,
+                                                   ProtoAddress& srcAddr)
+{
+    if (NULL == recv_data)
+    {
+        numBytes = 0;  // (nothing to read, as with a non-blocking socket)
+        return true;
+    }
+    if (recv_len < numBytes) numBytes = recv_len;  // (else truncated, as with UDP)
+    memcpy(buffer, recv_data, numBytes);
+    srcAddr = recv_addr;
+    recv_data = NULL;
+    return true;
+}  // end NativeProtoSimAgent::UdpSocketProxy::RecvFrom()
+
+bool NativeProtoSimAgent::UdpSocketProxy::JoinGroup(const ProtoAddress& groupAddr)
+{
+    SIMADDR group = groupAddr.SimGetAddress();
+    if (!IsGroupAddress(group))
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UdpSocketProxy::JoinGroup() error: invalid group address\n");
+        return false;
+    }
+    if (IsMember(group)) return true;
+    if (group_count >= GROUP_MAX)
+    {
+        PLOG(PL_ERROR, "NativeProtoSimAgent::UdpSocketProxy::JoinGroup() error: too many groups\n");
+        return false;
+    }
+    group_list[group_count++] = group;
+    return true;
+}  // end NativeProtoSimAgent::UdpSocketProxy::JoinGroup()
+
+bool NativeProtoSimAgent::UdpSocketProxy::LeaveGroup(const ProtoAddress& groupAddr)
+{
+    SIMADDR group = groupAddr.SimGetAddress();
+    for (unsigned int i = 0; i < group_count; i++)
+    {
+        if (group == group_list[i])
+        {
+            group_list[i] = group_list[--group_count];
+            return true;
+        }
+    }
+    return false;
+}  // end NativeProtoSimAgent::UdpSocketProxy::LeaveGroup()
+
+bool NativeProtoSimAgent::UdpSocketProxy::IsMember(SIMADDR groupAddr) const
+{
+    for (unsigned int i = 0; i < group_count; i++)
+    {
+        if (groupAddr == group_list[i]) return true;
+    }
+    return false;
+}  // end NativeProtoSimAgent::UdpSocketProxy::IsMember()
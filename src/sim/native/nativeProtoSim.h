@@ -0,0 +1,210 @@
+#ifndef _NATIVE_PROTO_SIM
+#define _NATIVE_PROTO_SIM
+
+#include "protoSimAgent.h"
+#include "protoSocket.h"
+#include "protoTimer.h"
+#include "protoThread.h"
+
+/**
+ * @class NativeProtoSim
+ *
+ * @brief A lightweight, in-process discrete event network simulator that
+ * hosts NativeProtoSimAgent instances (Protolib-based code built with
+ * SIMULATE and NATIVE_SIM defined) without ns-2, ns-3 or OPNET.
+ *
+ * Agents are added to the simulator, which assigns their SIM addresses
+ * (1, 2, ...), and connected by point-to-point links, each with a delay,
+ * loss rate and (optional) bandwidth.  Links are one hop:  unicast packets
+ * reach linked neighbors only, and broadcast and multicast packets reach
+ * the linked neighbors with a socket bound to the destination port (and,
+ * for multicast, joined to the group).  Forwarding beyond one hop is left
+ * to the protocol, as with the MANET wireless models of ns-2.  Only UDP
+ * sockets are supported.
+ *
+ * Timers and packet arrivals are events in a binary heap per "partition".
+ * With more than one partition, each runs in its own thread in lockstep
+ * windows bounded by the smallest delay of the links between partitions
+ * (the "lookahead"), so partitions never see an event out of order.  Since
+ * events are ordered by (time, originating agent, sequence) and each agent
+ * has its own random number generator, the results for a given seed are
+ * the same regardless of the partitioning.
+ */
+
+class NativeProtoSimAgent;
+
+class NativeProtoSim
+{
+    public:
+        NativeProtoSim(unsigned int numPartitions = 1);
+        ~NativeProtoSim();
+
+        // Returns the agent's address (or 0 upon error)
+        SIMADDR AddAgent(NativeProtoSimAgent& theAgent, unsigned int partition = 0);
+        // Connects two agents in both directions ("bitsPerSecond" of zero is unlimited)
+        bool Link(SIMADDR addr1, SIMADDR addr2, double delay,
+                  double lossRate = 0.0, double bitsPerSecond = 0.0);
+        unsigned int GetAgentCount() const
+            {return agent_count;}
+        NativeProtoSimAgent* GetAgent(SIMADDR theAddr) const
+            {return ((theAddr > 0) && (theAddr <= agent_count)) ? agent_list[theAddr - 1] : NULL;}
+
+        // (set before adding agents)
+        void SetSeed(unsigned int seed)
+            {rand_seed = seed;}
+
+        // Runs the simulation for "duration" seconds (or until Stop())
+        bool Run(double duration);
+        void Stop();
+        double GetTime() const;
+
+        // Statistics (totals over all partitions)
+        unsigned long GetEventCount() const;
+        unsigned long GetSentCount() const;     // packets put on links
+        unsigned long GetDeliveredCount() const;// packets delivered to sockets
+        unsigned long GetLostCount() const;     // packets dropped by link loss
+        unsigned long GetUnroutableCount() const;
+
+        class Event;
+        class Partition;
+
+    private:
+        friend class NativeProtoSimAgent;
+        bool RunWindows(double endTime);
+        bool WaitWindow(unsigned int& windowId, double& windowEnd);
+        void OnWindowDone();
+
+        Partition**             partition_list;
+        unsigned int            partition_count;
+        NativeProtoSimAgent**   agent_list;
+        unsigned int            agent_count;
+        unsigned int            agent_size;
+        unsigned int            rand_seed;
+        double                  lookahead;
+        volatile bool           stopped;
+        // Window coordination (multiple partitions)
+        ProtoMutex              window_mutex;
+        ProtoCondition          start_cond;
+        ProtoCondition          done_cond;
+        unsigned int            window_id;
+        double                  window_end;
+        unsigned int            running_count;
+        bool                    exiting;
+};  // end class NativeProtoSim
+
+/**
+ * @class NativeProtoSimAgent
+ *
+ * @brief Base class for Protolib-based agents run by NativeProtoSim.  As
+ * with NsProtoSimAgent, ProtoSockets used by the agent must have their
+ * notifier set to the agent (GetSocketNotifier()) and ProtoTimers are
+ * activated with the agent's timer manager.
+ */
+class NativeProtoSimAgent : public ProtoSimAgent
+{
+    public:
+        virtual ~NativeProtoSimAgent();
+
+        virtual bool OnStartup(int argc, const char*const* argv) = 0;
+        virtual bool ProcessCommands(int argc, const char*const* argv) = 0;
+        virtual void OnShutdown() = 0;
+
+        // These call the above in the agent's simulation context
+        // (the agent must have been added to a NativeProtoSim first)
+        bool Startup(int argc, const char*const* argv);
+        bool Command(int argc, const char*const* argv);
+        void Shutdown();
+
+        // Some helper methods
+        void ActivateTimer(ProtoTimer& theTimer)
+            {ProtoSimAgent::ActivateTimer(theTimer);}
+        void DeactivateTimer(ProtoTimer& theTimer)
+            {ProtoSimAgent::DeactivateTimer(theTimer);}
+        ProtoSocket::Notifier& GetSocketNotifier()
+            {return ProtoSimAgent::GetSocketNotifier();}
+        ProtoTimerMgr& GetTimerMgr()
+            {return ProtoSimAgent::GetTimerMgr();}
+
+        bool GetLocalAddress(ProtoAddress& localAddr);
+        SIMADDR GetAddress() const
+            {return sim_addr;}
+        NativeProtoSim* GetSimulator() const
+            {return simulator;}
+        unsigned int GetNeighborCount() const
+            {return link_count;}
+        // Reproducible uniform random number in [0.0, 1.0)
+        double UniformRandom();
+
+    protected:
+        NativeProtoSimAgent();
+
+        bool UpdateSystemTimer(ProtoTimer::Command command, double delay);
+        ProtoSimAgent::SocketProxy* OpenSocket(ProtoSocket& theSocket);
+        void CloseSocket(ProtoSocket& theSocket);
+
+    private:
+        friend class NativeProtoSim;
+        friend class NativeProtoSim::Partition;
+
+        class UdpSocketProxy : public ProtoSimAgent::SocketProxy
+        {
+            friend class NativeProtoSimAgent;
+            public:
+                UdpSocketProxy(NativeProtoSimAgent& theAgent);
+                ~UdpSocketProxy();
+
+                bool Bind(UINT16& thePort);
+                bool Connect(const ProtoAddress& /*theAddress*/) {return false;}
+                bool Accept(ProtoSocket* /*theSocket*/) {return false;}
+                bool Listen(UINT16 /*thePort*/) {return false;}
+                bool Shutdown() {return false;}
+                bool SendTo(const char* buffer, unsigned int& numBytes, const ProtoAddress& dstAddr);
+                bool RecvFrom(char* buffer, unsigned int& numBytes, ProtoAddress& srcAddr);
+                bool JoinGroup(const ProtoAddress& groupAddr);
+                bool LeaveGroup(const ProtoAddress& groupAddr);
+                void SetTTL(unsigned char /*ttl*/) {}
+                void SetLoopback(bool loopback) {mcast_loopback = loopback;}
+
+                bool IsMember(SIMADDR groupAddr) const;
+
+            private:
+                enum {GROUP_MAX = 16};
+                NativeProtoSimAgent&    agent;
+                bool                    mcast_loopback;
+                SIMADDR                 group_list[GROUP_MAX];
+                unsigned int            group_count;
+                const char*             recv_data;  // (valid during input notification)
+                unsigned int            recv_len;
+                ProtoAddress            recv_addr;
+        };  // end class NativeProtoSimAgent::UdpSocketProxy
+
+        struct Link
+        {
+            NativeProtoSimAgent*    peer;
+            double                  delay;
+            double                  loss_rate;
+            double                  bits_per_second;
+            double                  busy_until;  // (end of last transmission)
+        };
+        bool AddLink(NativeProtoSimAgent& peer, double delay, double lossRate, double bitsPerSecond);
+        bool SendPacket(const char* buffer, unsigned int numBytes, UINT16 srcPort,
+                        const ProtoAddress& dstAddr, bool loopback);
+        void Schedule(NativeProtoSimAgent& dst, double arrival, SIMADDR dstAddr,
+                      UINT16 srcPort, UINT16 dstPort, const char* buffer, unsigned int numBytes);
+        void Deliver(NativeProtoSim::Event& theEvent);
+        void SetContext();
+
+        NativeProtoSim*             simulator;
+        NativeProtoSim::Partition*  partition;
+        SIMADDR                     sim_addr;
+        NativeProtoSim::Event*      timer_event;
+        Link*                       link_list;
+        unsigned int                link_count;
+        unsigned int                link_size;
+        UdpSocketProxy::List        socket_proxy_list;
+        UINT16                      next_port;
+        UINT32                      event_seq;
+        uint64_t                    rand_state;
+};  // end class NativeProtoSimAgent
+
+#endif // _NATIVE_PROTO_SIM